@@ -30,6 +30,7 @@
 #define MCXW71C_TIMER_INIT     mm_mcxw71c_timers_init
 #define MCXW71C_TIMER_RESET    mm_mcxw71c_timers_reset
 #define MCXW71C_TIMER_TICK     mm_mcxw71c_timers_tick
+#define MCXW71C_TIMER_NEXT_EVENT mm_mcxw71c_timers_next_event
 
 #define MCXW71C_FLAGS 0u
 
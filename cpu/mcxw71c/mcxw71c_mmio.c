@@ -499,6 +499,7 @@ mm_bool mm_mcxw71c_register_mmio(struct mmio_bus *bus)
     struct mmio_region reg;
     if (bus == 0) return MM_FALSE;
 
+    memset(&reg, 0, sizeof(reg));
     reg.base = MRCC_BASE;
     reg.size = MRCC_SIZE;
     reg.opaque = &mrcc;
@@ -145,6 +145,7 @@ void mm_mcxw71c_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic)
         s->bus_index = (int)i;
         s->mrcc_offset = mrcc_offsets[i];
         s->regs[LPSPI_SR / 4] = SR_TDF;
+        memset(&reg, 0, sizeof(reg));
         reg.base = bases[i];
         reg.size = 0x1000u;
         reg.opaque = s;
@@ -170,12 +170,34 @@ void mm_mcxw71c_timers_tick(mm_u64 cycles)
     }
 }
 
+mm_u64 mm_mcxw71c_timers_next_event(void)
+{
+    mm_u64 next = (mm_u64)-1;
+    int i;
+
+    if (!mm_mcxw71c_mrcc_clock_on(MCXW71C_MRCC_LPIT0) ||
+        !mm_mcxw71c_mrcc_reset_released(MCXW71C_MRCC_LPIT0)) {
+        return next;
+    }
+    if ((lpit0.regs[LPIT_MCR / 4] & MCR_M_CEN) == 0u) return next;
+
+    for (i = 0; i < 4; ++i) {
+        mm_u64 due;
+        if ((lpit0.tctrl[i] & TCTRL_T_EN) == 0u) continue;
+        if ((lpit0.tctrl[i] & TCTRL_CHAIN) != 0u) continue;
+        due = (lpit0.cval[i] != 0u) ? lpit0.cval[i] : 1u;
+        if (due < next) next = due;
+    }
+    return next;
+}
+
 void mm_mcxw71c_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic)
 {
     struct mmio_region reg;
     g_nvic = nvic;
     mm_mcxw71c_gpio_set_nvic(nvic);
     memset(&lpit0, 0, sizeof(lpit0));
+    memset(&reg, 0, sizeof(reg));
     reg.base = LPIT0_BASE;
     reg.size = LPIT_SIZE;
     reg.opaque = &lpit0;
@@ -9,5 +9,6 @@ struct mm_nvic;
 void mm_mcxw71c_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_mcxw71c_timers_reset(void);
 void mm_mcxw71c_timers_tick(mm_u64 cycles);
+mm_u64 mm_mcxw71c_timers_next_event(void);
 
 #endif /* M33MU_MCXW71C_TIMERS_H */
@@ -66,6 +66,13 @@ static mm_bool uart_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     return MM_TRUE;
 }
 
+/* STAT is a plain copy; DATA pops the receive FIFO and clears RDRF. */
+static mm_bool uart_read_is_pure(void *opaque, mm_u32 offset, mm_u32 size_bytes)
+{
+    (void)opaque;
+    return offset >= LPUART_STAT && offset + size_bytes <= LPUART_STAT + 4u;
+}
+
 static mm_bool uart_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
 {
     struct lpuart_inst *u = (struct lpuart_inst *)opaque;
@@ -123,11 +130,13 @@ void mm_mcxw71c_usart_init(struct mmio_bus *bus, struct mm_nvic *nvic)
         sprintf(u->label, "LPUART%u", (unsigned)i);
         u->regs[LPUART_STAT / 4] = STAT_TDRE | STAT_TC | STAT_IDLE;
 
+        memset(&reg, 0, sizeof(reg));
         reg.base = bases[i];
         reg.size = 0x1000u;
         reg.opaque = u;
         reg.read = uart_read;
         reg.write = uart_write;
+        reg.read_is_pure = uart_read_is_pure;
         mmio_bus_register_region(bus, &reg);
         reg.base = bases[i] + 0x10000000u;
         mmio_bus_register_region(bus, &reg);
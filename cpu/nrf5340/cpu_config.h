@@ -27,6 +27,7 @@
 #define NRF5340_TIMER_INIT     mm_nrf5340_timers_init
 #define NRF5340_TIMER_RESET    mm_nrf5340_timers_reset
 #define NRF5340_TIMER_TICK     mm_nrf5340_timers_tick
+#define NRF5340_TIMER_NEXT_EVENT mm_nrf5340_timers_next_event
 
 #define NRF5340_FLAGS 0u
 
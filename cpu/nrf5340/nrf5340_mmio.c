@@ -10,6 +10,7 @@
 #include "m33mu/memmap.h"
 #include "m33mu/flash_persist.h"
 #include "m33mu/gpio.h"
+#include "m33mu/replay.h"
 
 extern void mm_system_request_reset(void);
 
@@ -456,7 +457,7 @@ static mm_bool rng_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *
             *value_out = (mm_u32)rng->value;
             return MM_TRUE;
         }
-        (void)getrandom(&rng->value, sizeof(rng->value), 0);
+        (void)mm_replay_getrandom(&rng->value, sizeof(rng->value), 0);
         rng->regs[RNG_EVENTS_VALRDY / 4] = 1u;
         *value_out = (mm_u32)rng->value;
         return MM_TRUE;
@@ -475,7 +476,7 @@ static mm_bool rng_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     if (offset == RNG_TASKS_START && size_bytes == 4) {
         if ((value & 1u) != 0u) {
             rng->running = MM_TRUE;
-            (void)getrandom(&rng->value, sizeof(rng->value), 0);
+            (void)mm_replay_getrandom(&rng->value, sizeof(rng->value), 0);
             rng->regs[RNG_EVENTS_VALRDY / 4] = 1u;
         }
         return MM_TRUE;
@@ -538,6 +539,7 @@ mm_bool mm_nrf5340_register_mmio(struct mmio_bus *bus)
     memset(&rng_state, 0, sizeof(rng_state));
     memset(&spu_state, 0, sizeof(spu_state));
 
+    memset(&reg, 0, sizeof(reg));
     reg.base = CLOCK_BASE_NS;
     reg.size = CLOCK_SIZE;
     reg.opaque = &clock_state;
@@ -6,6 +6,7 @@
 #include "nrf5340/nrf5340_timers.h"
 #include "nrf5340/nrf5340_mmio.h"
 #include "nrf5340/nrf5340_wdt.h"
+#include "nrf5340/nrf5340_uart_spi.h"
 #include "m33mu/mmio.h"
 #include "m33mu/nvic.h"
 
@@ -170,6 +171,7 @@ void mm_nrf5340_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic)
         timers[i].irq = irqs[i];
     }
 
+    memset(&reg, 0, sizeof(reg));
     reg.size = TIMER_SIZE;
     reg.read = timer_read;
     reg.write = timer_write;
@@ -232,4 +234,34 @@ void mm_nrf5340_timers_tick(mm_u64 cycles)
     }
 
     mm_nrf5340_wdt_tick(cycles);
+    mm_nrf5340_serial_tick(cycles);
+}
+
+mm_u64 mm_nrf5340_timers_next_event(void)
+{
+    mm_u64 next = mm_nrf5340_wdt_next_event();
+    mm_u64 due;
+    size_t i;
+    due = mm_nrf5340_serial_next_event();
+    if (due < next) next = due;
+    if (!mm_nrf5340_clock_hf_running()) return next;
+    for (i = 0; i < 3; ++i) {
+        const struct timer_state *t = &timers[i];
+        mm_u64 div;
+        mm_u32 mask;
+        mm_u32 ch;
+
+        if (!t->running) continue;
+        div = 1ull << (t->regs[TIMER_PRESCALER / 4] & 0xFu);
+        mask = timer_bitmask(t);
+        for (ch = 0; ch < TIMER_MAX_CC; ++ch) {
+            /* COMPARE[ch] fires when the counter steps onto CC[ch]. */
+            mm_u64 ticks = (mm_u64)((t->cc[ch] - t->counter) & mask);
+            if (ticks == 0u) ticks = (mm_u64)mask + 1u;
+            due = ticks * div;
+            due = (due > t->accum) ? (due - t->accum) : 1u;
+            if (due < next) next = due;
+        }
+    }
+    return next;
 }
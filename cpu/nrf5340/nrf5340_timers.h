@@ -7,5 +7,6 @@
 void mm_nrf5340_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_nrf5340_timers_reset(void);
 void mm_nrf5340_timers_tick(mm_u64 cycles);
+mm_u64 mm_nrf5340_timers_next_event(void);
 
 #endif /* M33MU_NRF5340_TIMERS_H */
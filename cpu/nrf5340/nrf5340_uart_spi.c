@@ -32,6 +32,8 @@
 #define EVENTS_ENDTX   0x120u
 #define EVENTS_ERROR   0x124u
 #define EVENTS_RXTO    0x144u
+#define EVENTS_TXSTARTED 0x150u
+#define EVENTS_TXSTOPPED 0x158u
 
 #define SPIM_EVENTS_STOPPED 0x104u
 #define SPIM_EVENTS_ENDRX   0x110u
@@ -60,8 +62,15 @@
 #define TXD_AMOUNT 0x54Cu
 
 #define CONFIG 0x554u
+#define UARTE_CONFIG 0x56Cu
 #define ORC 0x5C0u
 
+#define UARTE_CONFIG_PARITY (7u << 1)
+#define UARTE_CONFIG_STOP   (1u << 4)
+
+#define SPIM_FREQ_M16 0x0A000000u
+#define SPIM_FREQ_M32 0x14000000u
+
 #define ENABLE_SPIM  7u
 #define ENABLE_UARTE 8u
 
@@ -70,6 +79,8 @@
 #define INT_TXDRDY (1u << 7)
 #define INT_ENDTX  (1u << 8)
 #define INT_ERROR  (1u << 9)
+#define INT_TXSTARTED (1u << 20)
+#define INT_TXSTOPPED (1u << 22)
 
 struct serial_inst {
     mm_u32 base;
@@ -78,6 +89,14 @@ struct serial_inst {
     int irq;
     mm_bool has_uarte;
     mm_bool rx_running;
+    mm_bool tx_pending;     /* UARTE ENDTX waiting for the line to drain */
+    mm_bool tx_queued;      /* STARTTX re-triggered: next buffer waits behind */
+    mm_bool end_pending;    /* SPIM ENDTX/ENDRX/END waiting for the clock */
+    mm_u64 tx_wait;
+    mm_u64 tx_queued_wait;
+    mm_u32 tx_count;        /* TXD.AMOUNT once the in-flight buffer ends */
+    mm_u32 tx_queued_count;
+    mm_u64 end_wait;
     struct mm_uart_io io;
     char label[16];
 };
@@ -105,6 +124,45 @@ static mm_bool dma_write8(mm_u32 addr, mm_u8 value)
     return mm_memmap_write8(map, mmio_active_sec(), addr, value);
 }
 
+/* EasyDMA only masters data RAM: resolve PTR/MAXCNT once and check the
+ * whole range against SAU/MPU instead of going through the memory map per
+ * byte. NULL sends the caller to the byte path (flash, MMIO, faults). */
+static const mm_u8 *easydma_src(mm_u32 addr, mm_u32 len)
+{
+    struct mm_memmap *map = serial_map();
+    const mm_u8 *p;
+    if (map == 0 || len == 0u) return 0;
+    p = mm_memmap_host_write_ptr(map, addr, len);
+    if (p == 0 || !mm_memmap_access_ok(map, MM_ACCESS_READ, mmio_active_sec(), addr, len)) {
+        return 0;
+    }
+    return p;
+}
+
+static mm_u8 *easydma_dst(mm_u32 addr, mm_u32 len)
+{
+    struct mm_memmap *map = serial_map();
+    if (map == 0 || len == 0u) return 0;
+    return mm_memmap_guest_write_ptr(map, mmio_active_sec(), addr, len);
+}
+
+/* CPU cycles needed to shift bits at the rate encoded in a nRF
+ * BAUDRATE/FREQUENCY register (rate = reg * 16 MHz / 2^32). */
+static mm_u64 serial_wire_cycles(mm_u32 rate_reg, mm_u64 bits)
+{
+    mm_u64 hz = mm_nrf5340_cpu_hz();
+    mm_u64 rate;
+    if (rate_reg == SPIM_FREQ_M16) {
+        rate = 16000000u;
+    } else if (rate_reg == SPIM_FREQ_M32) {
+        rate = 32000000u;
+    } else {
+        rate = ((mm_u64)rate_reg * 16000000u) >> 32;
+    }
+    if (rate == 0u || hz == 0u) return 0u;
+    return (bits * hz + rate - 1u) / rate;
+}
+
 static void serial_raise_irq(struct serial_inst *s, mm_u32 mask)
 {
     if (s == 0 || g_nvic == 0) return;
@@ -118,6 +176,14 @@ static void serial_event_set(struct serial_inst *s, mm_u32 offset, mm_u32 mask)
     serial_raise_irq(s, mask);
 }
 
+static void serial_spim_end(struct serial_inst *s)
+{
+    s->end_pending = MM_FALSE;
+    serial_event_set(s, SPIM_EVENTS_ENDTX, INT_ENDTX);
+    serial_event_set(s, SPIM_EVENTS_ENDRX, INT_ENDRX);
+    serial_event_set(s, SPIM_EVENTS_END, INT_ENDTX | INT_ENDRX);
+}
+
 static void serial_spim_run(struct serial_inst *s)
 {
     mm_u32 tx_cnt;
@@ -127,6 +193,8 @@ static void serial_spim_run(struct serial_inst *s)
     mm_u32 i;
     mm_u32 total;
     mm_u8 orc;
+    const mm_u8 *tx;
+    mm_u8 *rx;
 
     if (s == 0) return;
     if (!mm_nrf5340_clock_hf_running()) return;
@@ -137,28 +205,54 @@ static void serial_spim_run(struct serial_inst *s)
     tx_ptr = s->regs[TXD_PTR / 4];
     rx_ptr = s->regs[RXD_PTR / 4];
     orc = (mm_u8)(s->regs[ORC / 4] & 0xFFu);
+    tx = easydma_src(tx_ptr, tx_cnt);
+    rx = easydma_dst(rx_ptr, rx_cnt);
 
     total = (tx_cnt > rx_cnt) ? tx_cnt : rx_cnt;
-    for (i = 0; i < total; ++i) {
+    if ((tx != 0 || tx_cnt == 0u) && (rx != 0 || rx_cnt == 0u)) {
+        /* Both buffers resolved: shared part, then the longer tail with
+         * ORC or discarded RX, each as one bus burst. */
+        mm_u32 both = (tx_cnt < rx_cnt) ? tx_cnt : rx_cnt;
+        mm_spi_bus_xfer_buf((int)s->bus_index, tx, orc, rx, (size_t)both);
+        if (tx_cnt > both) {
+            mm_spi_bus_xfer_buf((int)s->bus_index, tx + both, orc, 0, (size_t)(tx_cnt - both));
+        } else if (rx_cnt > both) {
+            mm_spi_bus_xfer_buf((int)s->bus_index, 0, orc, rx + both, (size_t)(rx_cnt - both));
+        }
+        i = total;
+    } else {
+        i = 0u;
+    }
+    for (; i < total; ++i) {
         mm_u8 out = orc;
         mm_u8 in;
         if (i < tx_cnt) {
-            (void)dma_read8(tx_ptr + i, &out);
+            if (tx != 0) {
+                out = tx[i];
+            } else {
+                (void)dma_read8(tx_ptr + i, &out);
+            }
         }
         in = mm_spi_bus_xfer((int)s->bus_index, out);
         if (i < rx_cnt) {
-            (void)dma_write8(rx_ptr + i, in);
+            if (rx != 0) {
+                rx[i] = in;
+            } else {
+                (void)dma_write8(rx_ptr + i, in);
+            }
         }
     }
 
     s->regs[TXD_AMOUNT / 4] = tx_cnt;
     s->regs[RXD_AMOUNT / 4] = rx_cnt;
-
-    serial_event_set(s, SPIM_EVENTS_ENDTX, INT_ENDTX);
-    serial_event_set(s, SPIM_EVENTS_ENDRX, INT_ENDRX);
-    serial_event_set(s, SPIM_EVENTS_END, INT_ENDTX | INT_ENDRX);
-
     mm_spi_bus_end((int)s->bus_index);
+
+    /* Data has moved; the END events follow after SCK has clocked it. */
+    s->end_wait = serial_wire_cycles(s->regs[BAUDRATE / 4], (mm_u64)total * 8u);
+    s->end_pending = MM_TRUE;
+    if (s->end_wait == 0u) {
+        serial_spim_end(s);
+    }
 }
 
 static void serial_uarte_try_rx(struct serial_inst *s)
@@ -166,6 +260,7 @@ static void serial_uarte_try_rx(struct serial_inst *s)
     mm_u32 rx_cnt;
     mm_u32 rx_ptr;
     mm_u32 amount;
+    mm_u8 *rx;
 
     if (s == 0) return;
     if (!s->rx_running) return;
@@ -175,10 +270,16 @@ static void serial_uarte_try_rx(struct serial_inst *s)
     rx_cnt = s->regs[RXD_MAXCNT / 4];
     rx_ptr = s->regs[RXD_PTR / 4];
     amount = s->regs[RXD_AMOUNT / 4];
+    if (amount >= rx_cnt || !mm_uart_io_has_rx(&s->io)) return;
+    rx = easydma_dst(rx_ptr + amount, rx_cnt - amount);
 
     while (amount < rx_cnt && mm_uart_io_has_rx(&s->io)) {
         mm_u8 byte = mm_uart_io_read(&s->io);
-        (void)dma_write8(rx_ptr + amount, byte);
+        if (rx != 0) {
+            *rx++ = byte;
+        } else {
+            (void)dma_write8(rx_ptr + amount, byte);
+        }
         amount++;
         serial_event_set(s, EVENTS_RXDRDY, INT_RXDRDY);
     }
@@ -190,11 +291,55 @@ static void serial_uarte_try_rx(struct serial_inst *s)
     }
 }
 
+/* Character time on the wire: start bit, 8 data bits, parity, stop bits. */
+static mm_u64 serial_uarte_frame_bits(const struct serial_inst *s)
+{
+    mm_u32 cfg = s->regs[UARTE_CONFIG / 4];
+    mm_u64 bits = 10u;
+    if ((cfg & UARTE_CONFIG_PARITY) != 0u) bits++;
+    if ((cfg & UARTE_CONFIG_STOP) != 0u) bits++;
+    return bits;
+}
+
+/* ENDTX for the in-flight buffer; a buffer queued by a re-triggered
+ * STARTTX then starts shifting out. */
+static void serial_uarte_end_tx(struct serial_inst *s)
+{
+    s->tx_pending = MM_FALSE;
+    s->regs[TXD_AMOUNT / 4] = s->tx_count;
+    serial_event_set(s, EVENTS_ENDTX, INT_ENDTX);
+    if (!s->tx_queued) return;
+    s->tx_queued = MM_FALSE;
+    s->tx_pending = MM_TRUE;
+    s->tx_wait = s->tx_queued_wait;
+    s->tx_count = s->tx_queued_count;
+    serial_event_set(s, EVENTS_TXSTARTED, INT_TXSTARTED);
+}
+
+/* STOPTX: the transmitter halts mid-buffer. ENDTX is generated explicitly
+ * if it has not happened yet, with TXD.AMOUNT counting the bytes that made
+ * it onto the wire, then TXSTOPPED. A queued buffer never starts. */
+static void serial_uarte_stop_tx(struct serial_inst *s)
+{
+    mm_u64 frame;
+    mm_u64 unsent;
+    s->tx_queued = MM_FALSE;
+    if (s->tx_pending) {
+        frame = serial_wire_cycles(s->regs[BAUDRATE / 4], serial_uarte_frame_bits(s));
+        unsent = (frame != 0u) ? s->tx_wait / frame : 0u;
+        s->tx_count = (unsent < s->tx_count) ? s->tx_count - (mm_u32)unsent : 0u;
+        serial_uarte_end_tx(s);
+    }
+    serial_event_set(s, EVENTS_TXSTOPPED, INT_TXSTOPPED);
+}
+
 static void serial_uarte_start_tx(struct serial_inst *s)
 {
     mm_u32 tx_cnt;
     mm_u32 tx_ptr;
     mm_u32 i;
+    mm_u64 wait;
+    const mm_u8 *tx;
     if (s == 0) return;
     if (!mm_nrf5340_clock_hf_running()) return;
     if ((s->regs[ENABLE / 4] & 0xFu) != ENABLE_UARTE) return;
@@ -202,15 +347,35 @@ static void serial_uarte_start_tx(struct serial_inst *s)
     tx_cnt = s->regs[TXD_MAXCNT / 4];
     tx_ptr = s->regs[TXD_PTR / 4];
 
+    tx = easydma_src(tx_ptr, tx_cnt);
     for (i = 0; i < tx_cnt; ++i) {
         mm_u8 out = 0;
-        (void)dma_read8(tx_ptr + i, &out);
+        if (tx != 0) {
+            out = tx[i];
+        } else {
+            (void)dma_read8(tx_ptr + i, &out);
+        }
         mm_uart_io_queue_tx(&s->io, out);
     }
     (void)mm_uart_io_flush(&s->io);
 
-    s->regs[TXD_AMOUNT / 4] = tx_cnt;
-    serial_event_set(s, EVENTS_ENDTX, INT_ENDTX);
+    wait = serial_wire_cycles(s->regs[BAUDRATE / 4], (mm_u64)tx_cnt * serial_uarte_frame_bits(s));
+    if (s->tx_pending) {
+        /* TXD.PTR is double buffered: the new buffer follows the one on
+         * the wire, which keeps its own ENDTX. A further re-trigger before
+         * that extends the queued buffer. */
+        s->tx_queued_wait = s->tx_queued ? s->tx_queued_wait + wait : wait;
+        s->tx_queued_count = tx_cnt;
+        s->tx_queued = MM_TRUE;
+        return;
+    }
+    s->tx_wait = wait;
+    s->tx_count = tx_cnt;
+    s->tx_pending = MM_TRUE;
+    serial_event_set(s, EVENTS_TXSTARTED, INT_TXSTARTED);
+    if (s->tx_wait == 0u) {
+        serial_uarte_end_tx(s);
+    }
 }
 
 static mm_bool serial_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
@@ -266,6 +431,9 @@ static mm_bool serial_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u
         return MM_TRUE;
     }
     if (offset == UARTE_TASKS_STOPTX && size_bytes == 4) {
+        if ((value & 1u) != 0u) {
+            serial_uarte_stop_tx(s);
+        }
         return MM_TRUE;
     }
     if (offset == UARTE_TASKS_FLUSHRX && size_bytes == 4) {
@@ -288,7 +456,7 @@ static mm_bool serial_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u
         return MM_TRUE;
     }
 
-    if (offset >= EVENTS_CTS && offset <= EVENTS_RXTO && size_bytes == 4) {
+    if (offset >= EVENTS_CTS && offset <= EVENTS_TXSTOPPED && size_bytes == 4) {
         if (value == 0u) {
             s->regs[offset / 4] = 0u;
         } else {
@@ -321,6 +489,7 @@ static void serial_register_all(struct mmio_bus *bus, struct mm_nvic *nvic)
     g_nvic = nvic;
     memset(&serials, 0, sizeof(serials));
 
+    memset(&reg, 0, sizeof(reg));
     reg.size = SERIAL_SIZE;
     reg.read = serial_read;
     reg.write = serial_write;
@@ -388,6 +557,45 @@ void mm_nrf5340_usart_poll(void)
     }
 }
 
+void mm_nrf5340_serial_tick(mm_u64 cycles)
+{
+    size_t i;
+    if (!serials_init_done) return;
+    for (i = 0; i < sizeof(serials) / sizeof(serials[0]); ++i) {
+        struct serial_inst *s = &serials[i];
+        if (s->tx_pending) {
+            mm_u64 left = cycles;
+            while (s->tx_pending && s->tx_wait <= left) {
+                left -= s->tx_wait;
+                serial_uarte_end_tx(s);
+            }
+            if (s->tx_pending) {
+                s->tx_wait -= left;
+            }
+        }
+        if (s->end_pending) {
+            if (s->end_wait <= cycles) {
+                serial_spim_end(s);
+            } else {
+                s->end_wait -= cycles;
+            }
+        }
+    }
+}
+
+mm_u64 mm_nrf5340_serial_next_event(void)
+{
+    mm_u64 next = (mm_u64)-1;
+    size_t i;
+    if (!serials_init_done) return next;
+    for (i = 0; i < sizeof(serials) / sizeof(serials[0]); ++i) {
+        const struct serial_inst *s = &serials[i];
+        if (s->tx_pending && s->tx_wait < next) next = s->tx_wait;
+        if (s->end_pending && s->end_wait < next) next = s->end_wait;
+    }
+    return next;
+}
+
 void mm_nrf5340_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic)
 {
     serial_register_all(bus, nvic);
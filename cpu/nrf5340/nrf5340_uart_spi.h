@@ -12,4 +12,10 @@ void mm_nrf5340_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_nrf5340_spi_reset(void);
 void mm_nrf5340_spi_poll(void);
 
+/* Delivers UARTE ENDTX and SPIM END events once the bytes have had time
+ * to cross the wire at the programmed baud rate / SCK frequency. */
+void mm_nrf5340_serial_tick(mm_u64 cycles);
+/* Cycles until the next of those events is due; (mm_u64)-1 when idle. */
+mm_u64 mm_nrf5340_serial_next_event(void);
+
 #endif /* M33MU_NRF5340_UART_SPI_H */
@@ -152,6 +152,7 @@ mm_bool mm_nrf5340_wdt_register(struct mmio_bus *bus)
         wdts[i].regs[WDT_RREN / 4] = 1u;
     }
 
+    memset(&reg, 0, sizeof(reg));
     reg.size = WDT_SIZE;
     reg.read = wdt_read;
     reg.write = wdt_write;
@@ -208,3 +209,21 @@ void mm_nrf5340_wdt_tick(mm_u64 cycles)
         }
     }
 }
+
+mm_u64 mm_nrf5340_wdt_next_event(void)
+{
+    mm_u64 div = wdt_cycles_per_tick();
+    mm_u64 next = (mm_u64)-1;
+    size_t i;
+    if (div == 0u) div = 1u;
+
+    for (i = 0; i < 2; ++i) {
+        const struct wdt_state *w = &wdts[i];
+        mm_u64 due;
+        if (!w->running) continue;
+        due = ((w->counter > 0u) ? (mm_u64)w->counter : 1u) * div;
+        due = (due > w->accum) ? (due - w->accum) : 1u;
+        if (due < next) next = due;
+    }
+    return next;
+}
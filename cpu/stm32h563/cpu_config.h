@@ -64,6 +64,7 @@ static const struct mm_ram_region STM32H563_RAM_REGIONS[] = {
 #define STM32H563_TIMER_INIT  mm_stm32h563_timers_init
 #define STM32H563_TIMER_RESET mm_stm32h563_timers_reset
 #define STM32H563_TIMER_TICK  mm_stm32h563_timers_tick
+#define STM32H563_TIMER_NEXT_EVENT mm_stm32h563_timers_next_event
 
 #define STM32H563_FLAGS MM_TARGET_FLAG_NVM_WRITEONCE
 
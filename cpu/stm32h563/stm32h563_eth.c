@@ -9,8 +9,10 @@
 #include "stm32h563/stm32h563_eth.h"
 #include "stm32h563/stm32h563_mmio.h"
 #include "m33mu/eth_backend.h"
+#include "m33mu/pcap.h"
 #include "m33mu/memmap.h"
 #include "m33mu/mmio.h"
+#include "m33mu/replay.h"
 
 #define ETH_BASE     0x40028000u
 #define ETH_SEC_BASE 0x50028000u
@@ -193,7 +195,7 @@ static mm_u32 eth_desc_count(mm_u32 rlr)
 static void eth_generate_mac(mm_u8 mac[6])
 {
     mm_u64 v = 0;
-    ssize_t n = getrandom(&v, sizeof(v), GRND_NONBLOCK);
+    ssize_t n = mm_replay_getrandom(&v, sizeof(v), GRND_NONBLOCK);
     if (n != (ssize_t)sizeof(v)) {
         v = ((mm_u64)rand() << 32) ^ (mm_u64)rand();
     }
@@ -386,7 +388,11 @@ static void eth_tx_poll(void)
             b = (mm_u8)((desc.des1 >> ((j & 3u) * 8u)) & 0xFFu);
             buf[j] = b;
         }
-        (void)mm_eth_backend_send(buf, len);
+        if (mm_eth_backend_send(buf, len) || !mm_eth_backend_is_up()) {
+            mm_eth_capture(MM_PCAP_OUT, 0, buf, len);
+        } else {
+            mm_eth_capture(MM_PCAP_OUT | MM_PCAP_DROPPED, "backend did not accept frame", buf, len);
+        }
         desc.des3 &= ~ETH_TDES3_OWN;
         eth_dma_write_desc(addr, &desc);
         g_eth.regs[ETH_DMACSR / 4u] |= ETH_DMACSR_TI;
@@ -428,8 +434,12 @@ static void eth_rx_poll(void)
     base = g_eth.regs[ETH_DMACRXDLAR / 4u];
     count = eth_desc_count(g_eth.regs[ETH_DMACRXRLR / 4u]);
     addr = base + (g_eth.rx_idx * 16u);
-    if (!eth_dma_read_desc(addr, &desc)) return;
+    if (!eth_dma_read_desc(addr, &desc)) {
+        mm_eth_capture(MM_PCAP_IN | MM_PCAP_DROPPED, "rx descriptor unreadable", buf, (mm_u32)n);
+        return;
+    }
     if ((desc.des3 & ETH_RDES3_OWN) == 0u) {
+        mm_eth_capture(MM_PCAP_IN | MM_PCAP_DROPPED, "no rx descriptor owned by DMA", buf, (mm_u32)n);
         g_eth.regs[ETH_DMACSR / 4u] |= ETH_DMACSR_RBU;
         eth_update_irq();
         return;
@@ -437,8 +447,16 @@ static void eth_rx_poll(void)
     {
         mm_u32 buf1v = desc.des3 & ETH_RDES3_BUF1V;
         len = eth_rx_buf_len(&desc);
-        if (len == 0u) return;
-        if ((mm_u32)n > len) n = (int)len;
+        if (len == 0u) {
+            mm_eth_capture(MM_PCAP_IN | MM_PCAP_DROPPED, "rx buffer length 0", buf, (mm_u32)n);
+            return;
+        }
+        if ((mm_u32)n > len) {
+            mm_eth_capture(MM_PCAP_IN, "truncated to rx buffer", buf, (mm_u32)n);
+            n = (int)len;
+        } else {
+            mm_eth_capture(MM_PCAP_IN, 0, buf, (mm_u32)n);
+        }
         for (i = 0; i < (mm_u32)n; ++i) {
             mm_u32 word_addr = desc.des0 + (i & ~3u);
             mm_u32 word;
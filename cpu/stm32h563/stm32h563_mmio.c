@@ -26,9 +26,14 @@
 #include "stm32h563/stm32h563_mmio.h"
 #include "stm32h563/stm32h563_usb.h"
 #include "stm32h563/stm32h563_eth.h"
+#include "stm32h563/stm32h563_usart.h"
+#include "stm32h563/stm32h563_spi.h"
 #include "m33mu/memmap.h"
 #include "m33mu/flash_persist.h"
 #include "m33mu/gpio.h"
+#include "m33mu/stm32_crypto.h"
+#include "m33mu/gpdma.h"
+#include "m33mu/replay.h"
 
 extern void mm_system_request_reset(void);
 
@@ -216,10 +221,6 @@ struct gpio_state {
     mm_u32 regs[0x34 / 4]; /* up to SECCFGR */
 };
 
-struct gpdma_state {
-    mm_u32 regs[0x1000 / 4];
-};
-
 /* uintptr_t substitute for C90 */
 typedef unsigned long mm_uptr;
 
@@ -241,8 +242,8 @@ static struct iwdg_state iwdg;
 static struct wwdg_state wwdg;
 static struct flash_state flash_ctl;
 static struct gpio_state gpio[9]; /* A..I */
-static struct gpdma_state gpdma1;
-static struct gpdma_state gpdma2;
+static struct mm_gpdma gpdma1;
+static struct mm_gpdma gpdma2;
 static void *gpio_ctx[18][4];
 static void *rng_ctx[2][4];
 static struct mm_nvic *g_rng_nvic = 0;
@@ -250,6 +251,16 @@ static struct mm_nvic *g_exti_nvic = 0;
 static struct mm_nvic *g_wdg_nvic = 0;
 
 #define RNG_IRQ 114
+
+/* Crypto engines: AES, HASH, SAES, PKA (secure aliases at +0x10000000) */
+#define AES_BASE     0x420c0000u
+#define HASH_BASE    0x420c0400u
+#define SAES_BASE    0x420c0c00u
+#define PKA_BASE     0x420c2000u
+#define AES_IRQ  120
+#define HASH_IRQ 116
+#define SAES_IRQ 119
+#define PKA_IRQ  118
 static const mm_u32 mpcbb_words[] = { 32u, 32u, 32u };
 
 static mm_u32 stm32h563_gpio_bank_read(void *opaque, int bank);
@@ -305,8 +316,9 @@ void mm_stm32h563_mmio_reset(void)
     memset(&wwdg, 0, sizeof(wwdg));
     memset(&flash_ctl, 0, sizeof(flash_ctl));
     mpcbb_init_defaults();
-    memset(&gpdma1, 0, sizeof(gpdma1));
-    memset(&gpdma2, 0, sizeof(gpdma2));
+    mm_gpdma_reset(&gpdma1);
+    mm_stm32_crypto_reset();
+    mm_gpdma_reset(&gpdma2);
     for (i = 0; i < sizeof(gpio) / sizeof(gpio[0]); ++i) {
         memset(&gpio[i], 0, sizeof(gpio[i]));
     }
@@ -391,6 +403,8 @@ struct rcc_clk_name {
 };
 
 static const struct rcc_clk_name rcc_clk_names[] = {
+    { "GPDMA1", RCC_BUS_AHB1, 0u },
+    { "GPDMA2", RCC_BUS_AHB1, 1u },
     { "ETH", RCC_BUS_AHB1, 19u },
     { "ETHTX", RCC_BUS_AHB1, 20u },
     { "ETHRX", RCC_BUS_AHB1, 21u },
@@ -403,7 +417,11 @@ static const struct rcc_clk_name rcc_clk_names[] = {
     { "GPIOG", RCC_BUS_AHB2, 6u },
     { "GPIOH", RCC_BUS_AHB2, 7u },
     { "GPIOI", RCC_BUS_AHB2, 8u },
+    { "AES", RCC_BUS_AHB2, 16u },
+    { "HASH", RCC_BUS_AHB2, 17u },
     { "RNG", RCC_BUS_AHB2, 18u },
+    { "PKA", RCC_BUS_AHB2, 19u },
+    { "SAES", RCC_BUS_AHB2, 20u },
     { "TIM2", RCC_BUS_APB1L, 0u },
     { "TIM3", RCC_BUS_APB1L, 1u },
     { "TIM4", RCC_BUS_APB1L, 2u },
@@ -548,7 +566,7 @@ static mm_bool rng_requires_secure(const struct simple_blk *tzsc)
 static void rng_fill(struct rng_state *r)
 {
     mm_u32 v = 0;
-    ssize_t n = getrandom(&v, sizeof(v), GRND_NONBLOCK);
+    ssize_t n = mm_replay_getrandom(&v, sizeof(v), GRND_NONBLOCK);
     if (n != (ssize_t)sizeof(v)) {
         v = 0;
     }
@@ -1068,22 +1086,32 @@ static mm_bool gpio_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     return MM_TRUE;
 }
 
-static mm_bool gpdma_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
-{
-    struct gpdma_state *d = (struct gpdma_state *)opaque;
-    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
-    if ((offset + size_bytes) > sizeof(d->regs)) return MM_FALSE;
-    memcpy(value_out, (mm_u8 *)d->regs + offset, size_bytes);
-    return MM_TRUE;
-}
+/* GPDMA request lines (REQSEL) backed by modelled peripherals. */
+#define GPDMA_REQ_SPI1_RX 6u
+#define GPDMA_REQ_USART1_RX 21u
+#define GPDMA_REQ_UART12_TX 44u
+#define GPDMA_REQ_SPI4_RX 47u
+#define GPDMA_REQ_SPI6_TX 52u
 
-static mm_bool gpdma_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+/* HASH/AES/SAES DMA requests are not modelled: firmware has to feed the
+ * crypto engines by CPU polling or interrupts. */
+
+static mm_bool gpdma_dreq(void *opaque, mm_u32 reqsel)
 {
-    struct gpdma_state *d = (struct gpdma_state *)opaque;
-    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
-    if ((offset + size_bytes) > sizeof(d->regs)) return MM_FALSE;
-    memcpy((mm_u8 *)d->regs + offset, &value, size_bytes);
-    return MM_TRUE;
+    (void)opaque;
+    if (reqsel >= GPDMA_REQ_SPI1_RX && reqsel < GPDMA_REQ_SPI1_RX + 6u) {
+        return mm_stm32h563_spi_dma_request((reqsel - GPDMA_REQ_SPI1_RX) / 2u,
+                                            ((reqsel - GPDMA_REQ_SPI1_RX) & 1u) != 0u);
+    }
+    if (reqsel >= GPDMA_REQ_USART1_RX && reqsel <= GPDMA_REQ_UART12_TX) {
+        return mm_stm32h563_usart_dma_request((reqsel - GPDMA_REQ_USART1_RX) / 2u,
+                                              ((reqsel - GPDMA_REQ_USART1_RX) & 1u) != 0u);
+    }
+    if (reqsel >= GPDMA_REQ_SPI4_RX && reqsel <= GPDMA_REQ_SPI6_TX) {
+        return mm_stm32h563_spi_dma_request(3u + (reqsel - GPDMA_REQ_SPI4_RX) / 2u,
+                                            ((reqsel - GPDMA_REQ_SPI4_RX) & 1u) != 0u);
+    }
+    return MM_FALSE;
 }
 
 static mm_bool flash_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
@@ -1426,14 +1454,54 @@ void mm_stm32h563_exti_set_nvic(struct mm_nvic *nvic)
     g_wdg_nvic = nvic;
 }
 
-void mm_stm32h563_watchdog_tick(mm_u64 cycles)
+/* Serve asserted hardware DMA requests. SPI TXDR frames fed during the
+ * pass are clocked in bulk and settled before the CPU runs again. */
+void mm_stm32h563_dma_service(void)
+{
+    mm_stm32h563_spi_dma_begin();
+    mm_gpdma_service(&gpdma1);
+    mm_gpdma_service(&gpdma2);
+    mm_stm32h563_spi_dma_end();
+}
+
+static mm_bool wwdg_running(void)
+{
+    return wwdg_clock_enabled() && wwdg.counter != 0u && (wwdg.regs[WWDG_CR / 4u] & 0x80u) != 0u;
+}
+
+static mm_u64 wwdg_cycles_per_step(void)
+{
+    mm_u32 wdgtb = (wwdg.regs[WWDG_CFR / 4u] >> 11) & 0x7u;
+    return 4096u * (mm_u64)(1u << wdgtb);
+}
+
+static mm_u64 iwdg_cycles_per_tick(void)
 {
     static const mm_u32 iwdg_presc_div[8] = { 4u, 8u, 16u, 32u, 64u, 128u, 256u, 256u };
     mm_u64 cpu_hz = mm_stm32h563_cpu_hz();
+    mm_u32 pr = iwdg.regs[IWDG_PR / 4u] & 0x7u;
+    mm_u64 ticks_per_sec;
+    mm_u64 cycles_per_tick;
+    mm_u64 lsi = 32000u;
+    mm_u32 div = iwdg_presc_div[pr];
+    ticks_per_sec = lsi / (mm_u64)div;
+    if (ticks_per_sec == 0) ticks_per_sec = 1;
+    if (cpu_hz == 0) cpu_hz = 1;
+    cycles_per_tick = cpu_hz / ticks_per_sec;
+    if (cycles_per_tick == 0) cycles_per_tick = 1;
+    return cycles_per_tick;
+}
+
+static mm_u64 wdg_cycles_until(mm_u64 steps, mm_u64 per_step, mm_u64 accum)
+{
+    mm_u64 due = steps * per_step;
+    return (due > accum) ? (due - accum) : 1u;
+}
 
-    if (wwdg_clock_enabled() && wwdg.counter != 0u && (wwdg.regs[WWDG_CR / 4u] & 0x80u) != 0u) {
-        mm_u32 wdgtb = (wwdg.regs[WWDG_CFR / 4u] >> 11) & 0x7u;
-        mm_u64 step = 4096u * (mm_u64)(1u << wdgtb);
+void mm_stm32h563_watchdog_tick(mm_u64 cycles)
+{
+    if (wwdg_running()) {
+        mm_u64 step = wwdg_cycles_per_step();
         wwdg.accum += cycles;
         while (wwdg.accum >= step) {
             wwdg.accum -= step;
@@ -1455,16 +1523,7 @@ void mm_stm32h563_watchdog_tick(mm_u64 cycles)
     }
 
     if (iwdg.running) {
-        mm_u32 pr = iwdg.regs[IWDG_PR / 4u] & 0x7u;
-        mm_u64 ticks_per_sec;
-        mm_u64 cycles_per_tick;
-        mm_u64 lsi = 32000u;
-        mm_u32 div = iwdg_presc_div[pr];
-        ticks_per_sec = lsi / (mm_u64)div;
-        if (ticks_per_sec == 0) ticks_per_sec = 1;
-        if (cpu_hz == 0) cpu_hz = 1;
-        cycles_per_tick = cpu_hz / ticks_per_sec;
-        if (cycles_per_tick == 0) cycles_per_tick = 1;
+        mm_u64 cycles_per_tick = iwdg_cycles_per_tick();
         iwdg.accum += cycles;
         while (iwdg.accum >= cycles_per_tick) {
             iwdg.accum -= cycles_per_tick;
@@ -1479,9 +1538,43 @@ void mm_stm32h563_watchdog_tick(mm_u64 cycles)
     }
 }
 
+mm_u64 mm_stm32h563_watchdog_next_event(void)
+{
+    mm_u64 next = (mm_u64)-1;
+    if (wwdg_running()) {
+        /* Early wakeup at 0x40 (when enabled), reset at 0x3F. */
+        mm_u32 target = ((wwdg.regs[WWDG_CFR / 4u] & (1u << 9)) != 0u && wwdg.counter > 0x40u) ? 0x40u : 0x3Fu;
+        if (wwdg.counter > target) {
+            next = wdg_cycles_until(wwdg.counter - target, wwdg_cycles_per_step(), wwdg.accum);
+        }
+    }
+    if (iwdg.running) {
+        mm_u64 steps = (iwdg.counter > 0u) ? iwdg.counter : 1u;
+        mm_u64 due = wdg_cycles_until(steps, iwdg_cycles_per_tick(), iwdg.accum);
+        if (due < next) {
+            next = due;
+        }
+    }
+    return next;
+}
+
+/* RCC, PWR and FLASH reads are plain register copies, so firmware polling
+ * a ready or busy bit there may be fast-forwarded. */
+static mm_bool plain_read_is_pure(void *opaque, mm_u32 offset, mm_u32 size_bytes)
+{
+    (void)opaque;
+    (void)offset;
+    (void)size_bytes;
+    return MM_TRUE;
+}
+
 mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
 {
     struct mmio_region reg;
+    struct mm_stm32_crypto_cfg crypto_cfg;
+    struct mm_gpdma_cfg dma_cfg;
+    static const int gpdma1_irqs[8] = { 27, 28, 29, 30, 31, 32, 33, 34 };
+    static const int gpdma2_irqs[8] = { 90, 91, 92, 93, 94, 95, 96, 97 };
 
     memset(&rcc, 0, sizeof(rcc));
     memset(&pwr, 0, sizeof(pwr));
@@ -1496,8 +1589,6 @@ mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
     memset(&flash_ctl, 0, sizeof(flash_ctl));
     memset(gpio, 0, sizeof(gpio));
     mpcbb_init_defaults();
-    memset(&gpdma1, 0, sizeof(gpdma1));
-    memset(&gpdma2, 0, sizeof(gpdma2));
     rcc.regs[RCC_CR / 4] |= 1u;
     rcc_update_ready(&rcc);
     rcc_update_sysclk(&rcc);
@@ -1514,11 +1605,13 @@ mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
     exti.regs[EXTI_IMR1 / 4u] = 0xFFFE0000u;
 
     /* RCC */
+    memset(&reg, 0, sizeof(reg));
     reg.base = RCC_BASE;
     reg.size = RCC_SIZE;
     reg.opaque = &rcc;
     reg.read = rcc_read;
     reg.write = rcc_write;
+    reg.read_is_pure = plain_read_is_pure;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
     /* RCC secure alias */
     reg.base = RCC_SEC_BASE;
@@ -1552,6 +1645,7 @@ mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
     reg.opaque = &tzsc_s;
     reg.read = simple_blk_read;
     reg.write = simple_blk_write;
+    reg.read_is_pure = 0;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
 
     /* GTZC TZSC non-secure alias */
@@ -1592,6 +1686,21 @@ mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
     reg.base = MPCBB3_SEC_BASE;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
 
+    /* HASH/AES/SAES/PKA (non-secure and secure aliases) */
+    memset(&crypto_cfg, 0, sizeof(crypto_cfg));
+    crypto_cfg.variant = MM_STM32_CRYPTO_H5;
+    crypto_cfg.aes_base = AES_BASE;
+    crypto_cfg.hash_base = HASH_BASE;
+    crypto_cfg.saes_base = SAES_BASE;
+    crypto_cfg.pka_base = PKA_BASE;
+    crypto_cfg.sec_offset = 0x10000000u;
+    crypto_cfg.aes_irq = AES_IRQ;
+    crypto_cfg.hash_irq = HASH_IRQ;
+    crypto_cfg.saes_irq = SAES_IRQ;
+    crypto_cfg.pka_irq = PKA_IRQ;
+    crypto_cfg.clk_reg = &rcc.regs[0x8c / 4];
+    if (!mm_stm32_crypto_register(bus, &crypto_cfg)) return MM_FALSE;
+
     /* RNG (non-secure and secure aliases) */
     reg.base = RNG_BASE;
     reg.size = RNG_SIZE;
@@ -1642,21 +1751,21 @@ mm_bool mm_stm32h563_register_mmio(struct mmio_bus *bus)
     reg.base = WWDG_SEC_BASE;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
 
-    /* GPDMA1/GPDMA2 (non-secure and secure aliases) */
-    reg.size = 0x1000u;
-    reg.read = gpdma_read;
-    reg.write = gpdma_write;
-    reg.base = 0x40020000u; /* GPDMA1 */
-    reg.opaque = &gpdma1;
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
-    reg.base = 0x50020000u; /* SEC_GPDMA1 */
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
-
-    reg.base = 0x40021000u; /* GPDMA2 */
-    reg.opaque = &gpdma2;
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
-    reg.base = 0x50021000u; /* SEC_GPDMA2 */
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    /* GPDMA1/GPDMA2 (non-secure and secure aliases); channels 6-7 are 2D */
+    memset(&dma_cfg, 0, sizeof(dma_cfg));
+    dma_cfg.base = 0x40020000u; /* GPDMA1 */
+    dma_cfg.sec_offset = 0x10000000u;
+    dma_cfg.channels = 8u;
+    dma_cfg.first_2d = 6u;
+    dma_cfg.irqs = gpdma1_irqs;
+    dma_cfg.clk_reg = &rcc.regs[0x88 / 4];
+    dma_cfg.clk_bit = 0u;
+    dma_cfg.dreq = gpdma_dreq;
+    if (!mm_gpdma_register(bus, &gpdma1, &dma_cfg)) return MM_FALSE;
+    dma_cfg.base = 0x40021000u; /* GPDMA2 */
+    dma_cfg.irqs = gpdma2_irqs;
+    dma_cfg.clk_bit = 1u;
+    if (!mm_gpdma_register(bus, &gpdma2, &dma_cfg)) return MM_FALSE;
 
     /* GPIO A..I: NS alias 0x4202xxxx, Secure alias 0x5202xxxx */
     {
@@ -1713,4 +1822,6 @@ void mm_stm32h563_flash_bind(struct mm_memmap *map,
 void mm_stm32h563_rng_set_nvic(struct mm_nvic *nvic)
 {
     g_rng_nvic = nvic;
+    mm_gpdma_set_nvic(&gpdma1, nvic);
+    mm_gpdma_set_nvic(&gpdma2, nvic);
 }
@@ -47,6 +47,9 @@ void mm_stm32h563_eth_set_nvic(struct mm_nvic *nvic);
 void mm_stm32h563_eth_reset(void);
 void mm_stm32h563_eth_poll(void);
 void mm_stm32h563_watchdog_tick(mm_u64 cycles);
+/* Cycles until the watchdogs next raise EWI or request a reset. */
+mm_u64 mm_stm32h563_watchdog_next_event(void);
+void mm_stm32h563_dma_service(void);
 mm_bool mm_stm32h563_mpcbb_block_secure(int bank, mm_u32 block_index);
 void mm_stm32h563_mmio_reset(void);
 
@@ -19,6 +19,9 @@
 #define SPI_TXDR  0x20u
 #define SPI_RXDR  0x30u
 
+#define CFG1_RXDMAEN (1u << 14)
+#define CFG1_TXDMAEN (1u << 15)
+
 #define CR1_SPE    (1u << 0)
 #define CR1_CSTART (1u << 9)
 
@@ -38,6 +41,9 @@
 #define SR_RXPLVL_SHIFT 13
 #define SR_RXWNE (1u << 15)
 
+#define SPI_FIFO_BYTES 31u      /* rx_fifo ring keeps one slot free */
+#define SPI_DMA_BATCH 256u
+
 struct spi_inst {
     mm_u32 base;
     mm_u32 regs[0x50 / 4];
@@ -50,11 +56,15 @@ struct spi_inst {
     mm_u32 tsize_rem;
     int irq;
     int bus_index;
+    mm_u8 tx_batch[SPI_DMA_BATCH];  /* DMA TXDR bytes not clocked yet */
+    mm_u32 tx_batch_len;
+    mm_bool tx_asked;               /* TX request polled since the last RX one */
 };
 
 static struct spi_inst spis[6];
 static size_t spi_count = 0;
 static struct mm_nvic *g_nvic = 0;
+static mm_bool g_dma_batching = MM_FALSE;
 
 static mm_bool spi_trace_enabled(void)
 {
@@ -152,25 +162,16 @@ static void spi_start_transfer(struct spi_inst *s)
     s->regs[SPI_SR / 4] &= ~(SR_EOT | SR_TXTF | SR_TXC);
 }
 
-static mm_u8 spi_xfer_byte(struct spi_inst *s, mm_u8 out)
-{
-    return mm_spi_bus_xfer(s->bus_index, out);
-}
-
-static void spi_handle_tx(struct spi_inst *s, mm_u32 value, mm_u32 size_bytes)
+/* Clock len bytes as one bus burst and queue what comes back. */
+static void spi_clock(struct spi_inst *s, const mm_u8 *out, mm_u32 len)
 {
     mm_u32 i;
-    mm_u32 send_bytes = spi_frame_bytes(s);
-    if (!s->enabled) return;
-    if (send_bytes > size_bytes) {
-        send_bytes = size_bytes;
-    }
-    for (i = 0; i < send_bytes; ++i) {
-        mm_u8 out = (mm_u8)((value >> (i * 8u)) & 0xFFu);
-        mm_u8 in = spi_xfer_byte(s, out);
-        (void)fifo_push(s, in);
+    mm_u8 in[SPI_DMA_BATCH];
+    mm_spi_bus_xfer_buf(s->bus_index, out, 0xFFu, in, (size_t)len);
+    for (i = 0; i < len; ++i) {
+        (void)fifo_push(s, in[i]);
         if (spi_trace_enabled()) {
-            printf("[SPI] SPI%d TX=0x%02x RX=0x%02x\n", s->bus_index, out, in);
+            printf("[SPI] SPI%d TX=0x%02x RX=0x%02x\n", s->bus_index, out[i], in[i]);
         }
         if (s->transfer_active && s->tsize_rem != 0u) {
             s->tsize_rem--;
@@ -184,11 +185,58 @@ static void spi_handle_tx(struct spi_inst *s, mm_u32 value, mm_u32 size_bytes)
     update_sr(s);
 }
 
+static void spi_batch_flush(struct spi_inst *s)
+{
+    mm_u32 len = s->tx_batch_len;
+    if (len == 0u) return;
+    s->tx_batch_len = 0;
+    spi_clock(s, s->tx_batch, len);
+}
+
+static void spi_handle_tx(struct spi_inst *s, mm_u32 value, mm_u32 size_bytes)
+{
+    mm_u32 i;
+    mm_u32 send_bytes = spi_frame_bytes(s);
+    mm_u32 limit;
+    mm_u8 out[4];
+    if (!s->enabled) return;
+    if (send_bytes > size_bytes) {
+        send_bytes = size_bytes;
+    }
+    for (i = 0; i < send_bytes; ++i) {
+        out[i] = (mm_u8)((value >> (i * 8u)) & 0xFFu);
+    }
+    if (!g_dma_batching || (s->regs[SPI_CFG1 / 4] & CFG1_TXDMAEN) == 0u) {
+        /* A 16/32-bit TXDR write clocks the whole frame as one burst. */
+        spi_clock(s, out, send_bytes);
+        return;
+    }
+    /* DMA-fed frames collect until the RX FIFO's worth (full duplex), the
+     * batch or TSIZE is full, then go out in one bus burst. Nothing else
+     * runs before the DMA pass ends, so the deferral is not observable. */
+    limit = ((s->regs[SPI_CFG1 / 4] & CFG1_RXDMAEN) != 0u) ? SPI_FIFO_BYTES : SPI_DMA_BATCH;
+    if (fifo_count(s) > 0u && limit == SPI_FIFO_BYTES) {
+        spi_batch_flush(s);
+        spi_clock(s, out, send_bytes);
+        return;
+    }
+    if (s->tx_batch_len + send_bytes > limit) {
+        spi_batch_flush(s);
+    }
+    memcpy(s->tx_batch + s->tx_batch_len, out, send_bytes);
+    s->tx_batch_len += send_bytes;
+    if (s->tx_batch_len + send_bytes > limit ||
+        (s->transfer_active && s->tx_batch_len >= s->tsize_rem)) {
+        spi_batch_flush(s);
+    }
+}
+
 static mm_bool spi_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
 {
     struct spi_inst *s = (struct spi_inst *)opaque;
     if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
     if (offset >= sizeof(s->regs)) return MM_FALSE;
+    spi_batch_flush(s);
     if (offset == SPI_RXDR) {
         mm_u32 v = 0;
         mm_u8 b;
@@ -223,6 +271,11 @@ static mm_bool spi_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     struct spi_inst *s = (struct spi_inst *)opaque;
     if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
     if (offset >= sizeof(s->regs)) return MM_FALSE;
+    if (offset == SPI_TXDR) {
+        spi_handle_tx(s, value, size_bytes);
+        return MM_TRUE;
+    }
+    spi_batch_flush(s);
     if (offset == SPI_CR1) {
         mm_u32 prev = s->regs[SPI_CR1 / 4];
         mm_bool was_enabled = (prev & CR1_SPE) != 0u;
@@ -245,10 +298,6 @@ static mm_bool spi_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
         }
         return MM_TRUE;
     }
-    if (offset == SPI_TXDR) {
-        spi_handle_tx(s, value, size_bytes);
-        return MM_TRUE;
-    }
     if (offset == SPI_IFCR) {
         mm_u32 sr = s->regs[SPI_SR / 4];
         if ((value & (1u << 3)) != 0u) {
@@ -298,6 +347,52 @@ void mm_stm32h563_spi_poll(void)
     }
 }
 
+mm_bool mm_stm32h563_spi_dma_request(mm_u32 index, mm_bool tx)
+{
+    struct spi_inst *s;
+    mm_u32 cfg1;
+    if (index >= spi_count) return MM_FALSE;
+    s = &spis[index];
+    if (!s->enabled) return MM_FALSE;
+    cfg1 = s->regs[SPI_CFG1 / 4];
+    if (tx) {
+        if ((cfg1 & CFG1_TXDMAEN) == 0u) return MM_FALSE;
+        if (g_dma_batching && (cfg1 & CFG1_RXDMAEN) != 0u) {
+            /* Full duplex: hold TX while RX drains the last batch, and
+             * clock a batch that would no longer fit the RX FIFO. */
+            s->tx_asked = MM_TRUE;
+            if (fifo_count(s) > 0u) return MM_FALSE;
+            if (s->tx_batch_len + spi_frame_bytes(s) > SPI_FIFO_BYTES) {
+                spi_batch_flush(s);
+                return MM_FALSE;
+            }
+        }
+        return MM_TRUE;
+    }
+    if ((cfg1 & CFG1_RXDMAEN) == 0u) return MM_FALSE;
+    if (fifo_count(s) == 0u && !s->tx_asked) {
+        /* TX stopped asking since the last RX poll: clock what it left. */
+        spi_batch_flush(s);
+    }
+    s->tx_asked = MM_FALSE;
+    return fifo_count(s) > 0u ? MM_TRUE : MM_FALSE;
+}
+
+void mm_stm32h563_spi_dma_begin(void)
+{
+    g_dma_batching = MM_TRUE;
+}
+
+void mm_stm32h563_spi_dma_end(void)
+{
+    size_t i;
+    for (i = 0; i < spi_count; ++i) {
+        spi_batch_flush(&spis[i]);
+        spis[i].tx_asked = MM_FALSE;
+    }
+    g_dma_batching = MM_FALSE;
+}
+
 void mm_stm32h563_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic)
 {
     static const mm_u32 bases[] = {
@@ -320,6 +415,7 @@ void mm_stm32h563_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic)
         s->bus_index = (int)(i + 1u);
         s->irq = (i < (sizeof(irq_map) / sizeof(irq_map[0]))) ? irq_map[i] : -1;
         s->regs[SPI_SR / 4] = SR_TXP;
+        memset(&reg, 0, sizeof(reg));
         reg.base = bases[i];
         reg.size = 0x400u;
         reg.opaque = s;
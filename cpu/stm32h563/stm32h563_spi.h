@@ -11,5 +11,12 @@
 void mm_stm32h563_spi_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_stm32h563_spi_poll(void);
 void mm_stm32h563_spi_reset(void);
+/* DMA request line of instance index (0 = SPI1): CFG1.TXDMAEN for tx,
+ * CFG1.RXDMAEN with data in the RX FIFO otherwise. */
+mm_bool mm_stm32h563_spi_dma_request(mm_u32 index, mm_bool tx);
+/* Bracket a DMA service pass: TXDR frames written by DMA in between are
+ * clocked onto the bus in bulk, and all of them by the end call. */
+void mm_stm32h563_spi_dma_begin(void);
+void mm_stm32h563_spi_dma_end(void);
 
 #endif /* M33MU_STM32H563_SPI_H */
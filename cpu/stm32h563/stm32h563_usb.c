@@ -542,6 +542,7 @@ mm_bool mm_stm32h563_usb_register_mmio(struct mmio_bus *bus)
     }
     usb_trace("register mmio USB base=0x%08x size=0x%x PMA base=0x%08x size=0x%x",
               USB_BASE, USB_SIZE, USB_PMA_BASE, USB_PMA_SIZE);
+    memset(&reg, 0, sizeof(reg));
     reg.base = USB_BASE;
     reg.size = USB_SIZE;
     reg.opaque = &g_usb;
@@ -55,6 +55,7 @@
 #define STM32L552_TIMER_INIT  mm_stm32l552_timers_init
 #define STM32L552_TIMER_RESET mm_stm32l552_timers_reset
 #define STM32L552_TIMER_TICK  mm_stm32l552_timers_tick
+#define STM32L552_TIMER_NEXT_EVENT mm_stm32l552_timers_next_event
 
 #define STM32L552_FLAGS MM_TARGET_FLAG_NVM_WRITEONCE
 
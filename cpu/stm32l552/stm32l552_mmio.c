@@ -24,9 +24,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "stm32l552/stm32l552_mmio.h"
+#include "stm32l552/stm32l552_usart.h"
+#include "stm32l552/stm32l552_spi.h"
 #include "m33mu/memmap.h"
 #include "m33mu/flash_persist.h"
 #include "m33mu/gpio.h"
+#include "m33mu/stm32_dma.h"
+#include "m33mu/replay.h"
 
 extern void mm_system_request_reset(void);
 
@@ -210,10 +214,6 @@ struct gpio_state {
     mm_u32 regs[0x34 / 4]; /* up to SECCFGR */
 };
 
-struct gpdma_state {
-    mm_u32 regs[0x1000 / 4];
-};
-
 /* uintptr_t substitute for C90 */
 typedef unsigned long mm_uptr;
 
@@ -235,7 +235,7 @@ static struct iwdg_state iwdg;
 static struct wwdg_state wwdg;
 static struct flash_state flash_ctl;
 static struct gpio_state gpio[9]; /* A..I */
-static struct gpdma_state gpdma1;
+static struct mm_stm32_dma dma12;
 static void *gpio_ctx[18][4];
 static void *rng_ctx[2][4];
 static struct mm_nvic *g_rng_nvic = 0;
@@ -298,7 +298,7 @@ void mm_stm32l552_mmio_reset(void)
     memset(&wwdg, 0, sizeof(wwdg));
     memset(&flash_ctl, 0, sizeof(flash_ctl));
     mpcbb_init_defaults();
-    memset(&gpdma1, 0, sizeof(gpdma1));
+    mm_stm32_dma_reset(&dma12);
     for (i = 0; i < sizeof(gpio) / sizeof(gpio[0]); ++i) {
         memset(&gpio[i], 0, sizeof(gpio[i]));
     }
@@ -523,7 +523,7 @@ static mm_bool rng_requires_secure(const struct simple_blk *tzsc)
 static void rng_fill(struct rng_state *r)
 {
     mm_u32 v = 0;
-    ssize_t n = getrandom(&v, sizeof(v), GRND_NONBLOCK);
+    ssize_t n = mm_replay_getrandom(&v, sizeof(v), GRND_NONBLOCK);
     if (n != (ssize_t)sizeof(v)) {
         v = 0;
     }
@@ -1065,22 +1065,24 @@ static mm_bool gpio_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     return MM_TRUE;
 }
 
-static mm_bool gpdma_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
-{
-    struct gpdma_state *d = (struct gpdma_state *)opaque;
-    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
-    if ((offset + size_bytes) > sizeof(d->regs)) return MM_FALSE;
-    memcpy(value_out, (mm_u8 *)d->regs + offset, size_bytes);
-    return MM_TRUE;
-}
+/* DMAMUX request IDs backed by modelled peripherals. */
+#define DMAMUX_REQ_SPI1_RX 11u
+#define DMAMUX_REQ_SPI3_TX 16u
+#define DMAMUX_REQ_USART1_RX 25u
+#define DMAMUX_REQ_LPUART1_TX 36u
 
-static mm_bool gpdma_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+static mm_bool dmamux_dreq(void *opaque, mm_u32 reqid)
 {
-    struct gpdma_state *d = (struct gpdma_state *)opaque;
-    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
-    if ((offset + size_bytes) > sizeof(d->regs)) return MM_FALSE;
-    memcpy((mm_u8 *)d->regs + offset, &value, size_bytes);
-    return MM_TRUE;
+    (void)opaque;
+    if (reqid >= DMAMUX_REQ_SPI1_RX && reqid <= DMAMUX_REQ_SPI3_TX) {
+        return mm_stm32l552_spi_dma_request((reqid - DMAMUX_REQ_SPI1_RX) / 2u,
+                                            ((reqid - DMAMUX_REQ_SPI1_RX) & 1u) != 0u);
+    }
+    if (reqid >= DMAMUX_REQ_USART1_RX && reqid <= DMAMUX_REQ_LPUART1_TX) {
+        return mm_stm32l552_usart_dma_request((reqid - DMAMUX_REQ_USART1_RX) / 2u,
+                                              ((reqid - DMAMUX_REQ_USART1_RX) & 1u) != 0u);
+    }
+    return MM_FALSE;
 }
 
 static mm_bool flash_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
@@ -1423,14 +1425,53 @@ void mm_stm32l552_exti_set_nvic(struct mm_nvic *nvic)
     g_wdg_nvic = nvic;
 }
 
-void mm_stm32l552_watchdog_tick(mm_u64 cycles)
+/* Serve asserted hardware DMA requests. SPI TXDR frames fed during the
+ * pass are clocked in bulk and settled before the CPU runs again. */
+void mm_stm32l552_dma_service(void)
+{
+    mm_stm32l552_spi_dma_begin();
+    mm_stm32_dma_service(&dma12);
+    mm_stm32l552_spi_dma_end();
+}
+
+static mm_bool wwdg_running(void)
+{
+    return wwdg_clock_enabled() && wwdg.counter != 0u && (wwdg.regs[WWDG_CR / 4u] & 0x80u) != 0u;
+}
+
+static mm_u64 wwdg_cycles_per_step(void)
+{
+    mm_u32 wdgtb = (wwdg.regs[WWDG_CFR / 4u] >> 11) & 0x7u;
+    return 4096u * (mm_u64)(1u << wdgtb);
+}
+
+static mm_u64 iwdg_cycles_per_tick(void)
 {
     static const mm_u32 iwdg_presc_div[8] = { 4u, 8u, 16u, 32u, 64u, 128u, 256u, 256u };
     mm_u64 cpu_hz = mm_stm32l552_cpu_hz();
+    mm_u32 pr = iwdg.regs[IWDG_PR / 4u] & 0x7u;
+    mm_u64 ticks_per_sec;
+    mm_u64 cycles_per_tick;
+    mm_u64 lsi = 32000u;
+    mm_u32 div = iwdg_presc_div[pr];
+    ticks_per_sec = lsi / (mm_u64)div;
+    if (ticks_per_sec == 0) ticks_per_sec = 1;
+    if (cpu_hz == 0) cpu_hz = 1;
+    cycles_per_tick = cpu_hz / ticks_per_sec;
+    if (cycles_per_tick == 0) cycles_per_tick = 1;
+    return cycles_per_tick;
+}
+
+static mm_u64 wdg_cycles_until(mm_u64 steps, mm_u64 per_step, mm_u64 accum)
+{
+    mm_u64 due = steps * per_step;
+    return (due > accum) ? (due - accum) : 1u;
+}
 
-    if (wwdg_clock_enabled() && wwdg.counter != 0u && (wwdg.regs[WWDG_CR / 4u] & 0x80u) != 0u) {
-        mm_u32 wdgtb = (wwdg.regs[WWDG_CFR / 4u] >> 11) & 0x7u;
-        mm_u64 step = 4096u * (mm_u64)(1u << wdgtb);
+void mm_stm32l552_watchdog_tick(mm_u64 cycles)
+{
+    if (wwdg_running()) {
+        mm_u64 step = wwdg_cycles_per_step();
         wwdg.accum += cycles;
         while (wwdg.accum >= step) {
             wwdg.accum -= step;
@@ -1452,16 +1493,7 @@ void mm_stm32l552_watchdog_tick(mm_u64 cycles)
     }
 
     if (iwdg.running) {
-        mm_u32 pr = iwdg.regs[IWDG_PR / 4u] & 0x7u;
-        mm_u64 ticks_per_sec;
-        mm_u64 cycles_per_tick;
-        mm_u64 lsi = 32000u;
-        mm_u32 div = iwdg_presc_div[pr];
-        ticks_per_sec = lsi / (mm_u64)div;
-        if (ticks_per_sec == 0) ticks_per_sec = 1;
-        if (cpu_hz == 0) cpu_hz = 1;
-        cycles_per_tick = cpu_hz / ticks_per_sec;
-        if (cycles_per_tick == 0) cycles_per_tick = 1;
+        mm_u64 cycles_per_tick = iwdg_cycles_per_tick();
         iwdg.accum += cycles;
         while (iwdg.accum >= cycles_per_tick) {
             iwdg.accum -= cycles_per_tick;
@@ -1476,9 +1508,43 @@ void mm_stm32l552_watchdog_tick(mm_u64 cycles)
     }
 }
 
+mm_u64 mm_stm32l552_watchdog_next_event(void)
+{
+    mm_u64 next = (mm_u64)-1;
+    if (wwdg_running()) {
+        /* Early wakeup at 0x40 (when enabled), reset at 0x3F. */
+        mm_u32 target = ((wwdg.regs[WWDG_CFR / 4u] & (1u << 9)) != 0u && wwdg.counter > 0x40u) ? 0x40u : 0x3Fu;
+        if (wwdg.counter > target) {
+            next = wdg_cycles_until(wwdg.counter - target, wwdg_cycles_per_step(), wwdg.accum);
+        }
+    }
+    if (iwdg.running) {
+        mm_u64 steps = (iwdg.counter > 0u) ? iwdg.counter : 1u;
+        mm_u64 due = wdg_cycles_until(steps, iwdg_cycles_per_tick(), iwdg.accum);
+        if (due < next) {
+            next = due;
+        }
+    }
+    return next;
+}
+
+/* RCC, PWR and FLASH reads are plain register copies, so firmware polling
+ * a ready or busy bit there may be fast-forwarded. */
+static mm_bool plain_read_is_pure(void *opaque, mm_u32 offset, mm_u32 size_bytes)
+{
+    (void)opaque;
+    (void)offset;
+    (void)size_bytes;
+    return MM_TRUE;
+}
+
 mm_bool mm_stm32l552_register_mmio(struct mmio_bus *bus)
 {
     struct mmio_region reg;
+    struct mm_stm32_dma_cfg dma_cfg;
+    static const int dma_irqs[16] = {
+        29, 30, 31, 32, 33, 34, 35, 36, 80, 81, 82, 83, 84, 85, 86, 87
+    };
 
     memset(&rcc, 0, sizeof(rcc));
     memset(&pwr, 0, sizeof(pwr));
@@ -1493,7 +1559,6 @@ mm_bool mm_stm32l552_register_mmio(struct mmio_bus *bus)
     memset(&flash_ctl, 0, sizeof(flash_ctl));
     memset(gpio, 0, sizeof(gpio));
     mpcbb_init_defaults();
-    memset(&gpdma1, 0, sizeof(gpdma1));
     rcc.regs[RCC_CR / 4] = 0x00000063u;
     rcc_update_ready(&rcc);
     rcc_update_sysclk(&rcc);
@@ -1510,11 +1575,13 @@ mm_bool mm_stm32l552_register_mmio(struct mmio_bus *bus)
     exti.regs[EXTI_IMR1 / 4u] = 0xFFFE0000u;
 
     /* RCC */
+    memset(&reg, 0, sizeof(reg));
     reg.base = RCC_BASE;
     reg.size = RCC_SIZE;
     reg.opaque = &rcc;
     reg.read = rcc_read;
     reg.write = rcc_write;
+    reg.read_is_pure = plain_read_is_pure;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
     /* RCC secure alias */
     reg.base = RCC_SEC_BASE;
@@ -1548,6 +1615,7 @@ mm_bool mm_stm32l552_register_mmio(struct mmio_bus *bus)
     reg.opaque = &tzsc_s;
     reg.read = simple_blk_read;
     reg.write = simple_blk_write;
+    reg.read_is_pure = 0;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
 
     /* GTZC TZSC non-secure alias */
@@ -1633,15 +1701,14 @@ mm_bool mm_stm32l552_register_mmio(struct mmio_bus *bus)
     reg.base = WWDG_SEC_BASE;
     if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
 
-    /* GPDMA1 (non-secure and secure aliases) */
-    reg.size = 0x1000u;
-    reg.read = gpdma_read;
-    reg.write = gpdma_write;
-    reg.base = 0x40020000u; /* GPDMA1 */
-    reg.opaque = &gpdma1;
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
-    reg.base = 0x50020000u; /* SEC_GPDMA1 */
-    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    /* DMA1, DMA2 and DMAMUX1 (non-secure and secure aliases) */
+    memset(&dma_cfg, 0, sizeof(dma_cfg));
+    dma_cfg.base = 0x40020000u;
+    dma_cfg.sec_offset = 0x10000000u;
+    dma_cfg.irqs = dma_irqs;
+    dma_cfg.clk_reg = &rcc.regs[0x48 / 4];
+    dma_cfg.dreq = dmamux_dreq;
+    if (!mm_stm32_dma_register(bus, &dma12, &dma_cfg)) return MM_FALSE;
 
     /* GPIO A..I: NS alias 0x4202xxxx, Secure alias 0x5202xxxx */
     {
@@ -1696,4 +1763,5 @@ void mm_stm32l552_flash_bind(struct mm_memmap *map,
 void mm_stm32l552_rng_set_nvic(struct mm_nvic *nvic)
 {
     g_rng_nvic = nvic;
+    mm_stm32_dma_set_nvic(&dma12, nvic);
 }
@@ -40,6 +40,9 @@ mm_u32 *mm_stm32l552_tzsc_regs(void);
 void mm_stm32l552_rng_set_nvic(struct mm_nvic *nvic);
 void mm_stm32l552_exti_set_nvic(struct mm_nvic *nvic);
 void mm_stm32l552_watchdog_tick(mm_u64 cycles);
+/* Cycles until the watchdogs next raise EWI or request a reset. */
+mm_u64 mm_stm32l552_watchdog_next_event(void);
+void mm_stm32l552_dma_service(void);
 mm_bool mm_stm32l552_mpcbb_block_secure(int bank, mm_u32 block_index);
 void mm_stm32l552_mmio_reset(void);
 
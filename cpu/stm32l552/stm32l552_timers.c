@@ -202,6 +202,26 @@ static void tim_tick(struct tim_inst *t, mm_u64 cycles)
     }
 }
 
+/* Cycles until the counter next overflows (or underflows) and sets UIF. */
+static mm_u64 tim_next_update(const struct tim_inst *t)
+{
+    mm_u64 arr;
+    mm_u64 cnt;
+    mm_u64 ticks;
+    mm_u64 div;
+    if ((t->cr1 & CR1_CEN) == 0u || (t->cr1 & CR1_UDIS) != 0u) return (mm_u64)-1;
+    if (!tim_clock_enabled(t)) return (mm_u64)-1;
+    div = (mm_u64)(t->psc + 1u);
+    arr = (mm_u64)(t->arr & t->arr_mask);
+    cnt = (mm_u64)(t->cnt & t->arr_mask);
+    if (cnt > arr) {
+        cnt = arr;
+    }
+    ticks = ((t->cr1 & CR1_DIR) != 0u) ? (cnt + 1u) : (arr - cnt + 1u);
+    /* PSC may have shrunk below the accumulated remainder. */
+    return (ticks * div > t->psc_accum) ? (ticks * div - t->psc_accum) : 1u;
+}
+
 static mm_bool tim_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
 {
     struct tim_inst *t = (struct tim_inst *)opaque;
@@ -310,6 +330,19 @@ void mm_stm32l552_timers_tick(mm_u64 cycles)
         tim_tick(&timers[i], cycles);
     }
     mm_stm32l552_watchdog_tick(cycles);
+    mm_stm32l552_dma_service();
+}
+
+mm_u64 mm_stm32l552_timers_next_event(void)
+{
+    mm_u64 next = mm_stm32l552_watchdog_next_event();
+    mm_u64 due;
+    size_t i;
+    for (i = 0; i < sizeof(timers) / sizeof(timers[0]); ++i) {
+        due = tim_next_update(&timers[i]);
+        if (due < next) next = due;
+    }
+    return next;
 }
 
 void mm_stm32l552_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic)
@@ -339,6 +372,7 @@ void mm_stm32l552_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic)
         t->sec_bitmask = (1u << i);
         t->current_sec = MM_SECURE;
 
+        memset(&reg, 0, sizeof(reg));
         reg.base = bases[i];
         reg.size = 0x400u;
         reg.opaque = t;
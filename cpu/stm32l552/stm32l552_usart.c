@@ -42,6 +42,9 @@
 #define CR1_RXNEIE (1u << 5)
 #define CR1_TXEIE (1u << 7)
 
+#define CR3_DMAR (1u << 6)
+#define CR3_DMAT (1u << 7)
+
 #define ISR_RXNE (1u << 5)
 #define ISR_TXE  (1u << 7)
 
@@ -144,6 +147,14 @@ static mm_bool usart_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
     return MM_TRUE;
 }
 
+/* Polling ISR changes nothing (TXE is already forced on by the first read);
+ * RDR pops the receive FIFO and clears RXNE. */
+static mm_bool usart_read_is_pure(void *opaque, mm_u32 offset, mm_u32 size_bytes)
+{
+    (void)opaque;
+    return offset >= USART_ISR && offset + size_bytes <= USART_ISR + 4u;
+}
+
 static mm_bool usart_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
 {
     struct usart_inst *u = (struct usart_inst *)opaque;
@@ -216,6 +227,21 @@ void mm_stm32l552_usart_poll(void)
     }
 }
 
+mm_bool mm_stm32l552_usart_dma_request(mm_u32 index, mm_bool tx)
+{
+    struct usart_inst *u;
+    mm_u32 cr3;
+    if (index >= usart_count) return MM_FALSE;
+    u = &usarts[index];
+    if (!u->enabled) return MM_FALSE;
+    cr3 = u->regs[USART_CR3 / 4];
+    if (tx) {
+        return ((cr3 & CR3_DMAT) != 0u && (u->regs[USART_ISR / 4] & ISR_TXE) != 0u) ? MM_TRUE : MM_FALSE;
+    }
+    if ((cr3 & CR3_DMAR) == 0u) return MM_FALSE;
+    return ((u->regs[USART_ISR / 4] & ISR_RXNE) != 0u || mm_uart_io_has_rx(&u->io)) ? MM_TRUE : MM_FALSE;
+}
+
 void mm_stm32l552_usart_init(struct mmio_bus *bus, struct mm_nvic *nvic)
 {
     static const mm_u32 bases[] = {
@@ -281,11 +307,13 @@ void mm_stm32l552_usart_init(struct mmio_bus *bus, struct mm_nvic *nvic)
             u->sec_reg = tz1_cfgr1;
             u->sec_bitmask = (1u << 21); /* TZSC_SECCFGR1 LPUART1SEC bit21 */
         }
+        memset(&reg, 0, sizeof(reg));
         reg.base = bases[i];
         reg.size = 0x400u;
         reg.opaque = u;
         reg.read = usart_read;
         reg.write = usart_write;
+        reg.read_is_pure = usart_read_is_pure;
         mmio_bus_register_region(bus, &reg);
     }
 }
@@ -28,5 +28,8 @@
 void mm_stm32l552_usart_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_stm32l552_usart_poll(void);
 void mm_stm32l552_usart_reset(void);
+/* DMA request line of instance index (0 = USART1): TXE with CR3.DMAT for
+ * tx, received data with CR3.DMAR otherwise. */
+mm_bool mm_stm32l552_usart_dma_request(mm_u32 index, mm_bool tx);
 
 #endif /* M33MU_STM32L552_USART_H */
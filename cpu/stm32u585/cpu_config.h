@@ -61,6 +61,7 @@ static const struct mm_ram_region STM32U585_RAM_REGIONS[] = {
 #define STM32U585_TIMER_INIT  mm_stm32u585_timers_init
 #define STM32U585_TIMER_RESET mm_stm32u585_timers_reset
 #define STM32U585_TIMER_TICK  mm_stm32u585_timers_tick
+#define STM32U585_TIMER_NEXT_EVENT mm_stm32u585_timers_next_event
 
 #define STM32U585_FLAGS MM_TARGET_FLAG_NVM_WRITEONCE
 
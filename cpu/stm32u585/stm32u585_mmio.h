@@ -41,6 +41,9 @@ mm_u32 *mm_stm32u585_tzsc2_regs(void);
 void mm_stm32u585_rng_set_nvic(struct mm_nvic *nvic);
 void mm_stm32u585_exti_set_nvic(struct mm_nvic *nvic);
 void mm_stm32u585_watchdog_tick(mm_u64 cycles);
+/* Cycles until the watchdogs next raise EWI or request a reset. */
+mm_u64 mm_stm32u585_watchdog_next_event(void);
+void mm_stm32u585_dma_service(void);
 mm_bool mm_stm32u585_mpcbb_block_secure(int bank, mm_u32 block_index);
 void mm_stm32u585_mmio_reset(void);
 
@@ -29,5 +29,6 @@
 void mm_stm32u585_timers_init(struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_stm32u585_timers_reset(void);
 void mm_stm32u585_timers_tick(mm_u64 cycles);
+mm_u64 mm_stm32u585_timers_next_event(void);
 
 #endif /* M33MU_STM32U585_TIMERS_H */
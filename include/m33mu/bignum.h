@@ -0,0 +1,86 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#ifndef M33MU_BIGNUM_H
+#define M33MU_BIGNUM_H
+
+#include "m33mu/types.h"
+
+/* Multi-precision helpers behind the PKA model. Numbers are arrays of
+ * 32-bit words, least significant word first. Modular arithmetic uses
+ * Montgomery multiplication, so every modulus must be odd. Nothing here is
+ * constant time: it only has to be correct and fast on the host.
+ */
+
+#define MM_BN_MAX_WORDS 132u    /* 4160-bit operands plus headroom */
+#define MM_EC_MAX_WORDS 20u     /* 640-bit curves */
+
+struct mm_mont {
+    mm_u32 n;                   /* words */
+    mm_u32 m0inv;               /* -m^-1 mod 2^32 */
+    mm_u32 m[MM_BN_MAX_WORDS];
+    mm_u32 rr[MM_BN_MAX_WORDS]; /* R^2 mod m, R = 2^(32n) */
+    mm_u32 one[MM_BN_MAX_WORDS];/* R mod m */
+};
+
+int mm_bn_cmp(const mm_u32 *a, const mm_u32 *b, mm_u32 n);
+mm_bool mm_bn_is_zero(const mm_u32 *a, mm_u32 n);
+mm_u32 mm_bn_bits(const mm_u32 *a, mm_u32 n);
+/* r = a mod m, with a of a_words words and m of m_words words. */
+void mm_bn_mod(mm_u32 *r, const mm_u32 *a, mm_u32 a_words, const mm_u32 *m, mm_u32 m_words);
+
+mm_bool mm_mont_init(struct mm_mont *ctx, const mm_u32 *mod, mm_u32 n);
+void mm_mont_mul(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a, const mm_u32 *b);
+void mm_mont_to(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a);
+void mm_mont_from(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a);
+/* r = a^e in the Montgomery domain; e has e_bits significant bits. */
+void mm_mont_exp(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a, const mm_u32 *e, mm_u32 e_bits);
+/* r = base^e mod m, plain representation. Returns MM_FALSE for an even or
+ * trivial modulus. */
+mm_bool mm_bn_modexp(mm_u32 *r, const mm_u32 *base, const mm_u32 *e, mm_u32 e_bits,
+                     const mm_u32 *mod, mm_u32 n);
+
+/* Short Weierstrass curve y^2 = x^3 + ax + b over GF(p). Coordinates passed
+ * in and out are plain, p->n words wide. */
+struct mm_ec_curve {
+    struct mm_mont p;
+    mm_u32 a[MM_EC_MAX_WORDS];  /* Montgomery form */
+    mm_u32 b[MM_EC_MAX_WORDS];
+};
+
+mm_bool mm_ec_curve_init(struct mm_ec_curve *c, const mm_u32 *p, const mm_u32 *a, const mm_u32 *b, mm_u32 n);
+mm_bool mm_ec_on_curve(const struct mm_ec_curve *c, const mm_u32 *x, const mm_u32 *y);
+/* (rx, ry) = k * (x, y). Returns MM_FALSE when the result is the point at
+ * infinity. */
+mm_bool mm_ec_mul(const struct mm_ec_curve *c, mm_u32 *rx, mm_u32 *ry,
+                  const mm_u32 *k, mm_u32 k_bits, const mm_u32 *x, const mm_u32 *y);
+/* ECDSA; order, d, k, r, s and e are n_words wide. The public key is not
+ * checked against the curve (mm_ec_on_curve does that). */
+mm_bool mm_ecdsa_verify(const struct mm_ec_curve *c, const mm_u32 *order, mm_u32 n_words,
+                        const mm_u32 *gx, const mm_u32 *gy, const mm_u32 *qx, const mm_u32 *qy,
+                        const mm_u32 *r, const mm_u32 *s, const mm_u32 *e);
+mm_bool mm_ecdsa_sign(const struct mm_ec_curve *c, const mm_u32 *order, mm_u32 n_words,
+                      const mm_u32 *gx, const mm_u32 *gy, const mm_u32 *d, const mm_u32 *k,
+                      const mm_u32 *e, mm_u32 *r, mm_u32 *s);
+
+#endif /* M33MU_BIGNUM_H */
@@ -0,0 +1,54 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_BREAKPOINT_H
+#define M33MU_BREAKPOINT_H
+
+#include "m33mu/types.h"
+
+/*
+ * Out-of-band breakpoint set keyed on PC (bit0 ignored).
+ * Breakpoints never touch guest memory: the run loop asks the set whether
+ * the next PC is armed. A small bitmap filters out the common "no breakpoint
+ * here" case with a single load; hits are confirmed in an open-addressing
+ * hash table that grows on demand, so there is no fixed breakpoint limit.
+ */
+#define MM_BP_FILTER_BITS 4096u
+
+struct mm_bp_set {
+    mm_u32 *slots;    /* 0 = empty, 1 = tombstone, otherwise (pc | 1) */
+    mm_u32 cap;       /* power of two, 0 when unallocated */
+    mm_u32 count;
+    mm_u32 used;      /* live entries + tombstones */
+    mm_u32 filter[MM_BP_FILTER_BITS / 32u];
+};
+
+void mm_bp_set_init(struct mm_bp_set *set);
+void mm_bp_set_free(struct mm_bp_set *set);
+void mm_bp_set_clear(struct mm_bp_set *set);
+mm_bool mm_bp_set_add(struct mm_bp_set *set, mm_u32 pc);
+mm_bool mm_bp_set_remove(struct mm_bp_set *set, mm_u32 pc);
+/* Hot-path query: one bitmap load when no breakpoint shares the filter bit. */
+mm_bool mm_bp_set_lookup(const struct mm_bp_set *set, mm_u32 pc);
+mm_u32 mm_bp_set_count(const struct mm_bp_set *set);
+
+#endif /* M33MU_BREAKPOINT_H */
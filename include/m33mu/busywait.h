@@ -0,0 +1,117 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_BUSYWAIT_H
+#define M33MU_BUSYWAIT_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+#include "m33mu/decode.h"
+
+/* Busy-wait fast-forward. A taken backward branch closes a candidate loop
+ * [head, tail]; its body qualifies when every instruction is a load without
+ * writeback, a register ALU op, a compare or a branch (no stores, no SP/PC
+ * or system register writes, no IT blocks). Load address registers must not
+ * be written inside the body, and every load must resolve to flash, RAM or
+ * an MMIO register whose region marks it read_is_pure (status registers
+ * such as USART ISR, RCC CR or FLASH SR); registers that clear flags or pop
+ * FIFOs on read are never skipped. Such a loop is a pure function
+ * of the registers and the memory it reads, so once two consecutive
+ * iterations reach the head with identical registers and flags, it keeps
+ * spinning until something outside the CPU changes: an interrupt, a timer,
+ * DMA or host I/O.
+ *
+ * mm_busywait_backedge() then returns a number of cycles the caller may
+ * advance virtual time by (ticking SysTick and the SoC timers exactly as
+ * for WFI) before letting the loop run one more iteration. The chunk starts
+ * at MM_BUSYWAIT_CHUNK_MIN and doubles, up to MM_BUSYWAIT_CHUNK_MAX, while
+ * the loop stays at the same fixpoint, so a loop polling a slow counter
+ * exits at most about one counter tick late. Decisions depend only on guest
+ * state; a skip cut short by host input is recorded for --replay like a WFI
+ * sleep, so replayed runs stay deterministic.
+ */
+
+#define MM_BUSYWAIT_MAX_INSNS 16
+#define MM_BUSYWAIT_MAX_SPAN 64u
+#define MM_BUSYWAIT_CHUNK_MIN 64u
+#define MM_BUSYWAIT_CHUNK_MAX 16384u
+#define MM_BUSYWAIT_VERDICTS 8
+#define MM_BUSYWAIT_MAX_LOADS 4
+#define MM_BUSYWAIT_NO_REG 0xffu
+
+/* Address of a load in the body: imm + r[rn] + (r[rm] << shift), with
+ * MM_BUSYWAIT_NO_REG for an absent register (literal loads keep the
+ * absolute address in imm). */
+struct mm_busywait_load {
+    mm_u32 imm;
+    mm_u8 rn;
+    mm_u8 rm;
+    mm_u8 shift;
+    mm_u8 size;
+};
+
+struct mm_busywait_verdict {
+    mm_u32 head;
+    mm_u32 tail;
+    mm_bool pure;
+    struct mm_busywait_load loads[MM_BUSYWAIT_MAX_LOADS];
+    int load_count;
+};
+
+struct mm_busywait {
+    mm_bool enabled;
+    /* Loop currently being watched and its state at the last back edge. */
+    mm_bool tracking;
+    mm_u32 head;
+    mm_u32 tail;
+    struct mm_busywait_verdict loop;
+    mm_u32 regs[15];
+    mm_u32 xpsr;
+    enum mm_sec_state sec;
+    enum mm_mode mode;
+    mm_u32 chunk;
+    /* Body classifications, replaced round-robin. */
+    struct mm_busywait_verdict verdicts[MM_BUSYWAIT_VERDICTS];
+    int verdict_count;
+    int verdict_next;
+    mm_u64 skipped_cycles;
+    mm_u64 skips;
+};
+
+void mm_busywait_init(struct mm_busywait *bw, mm_bool enabled);
+/* Forget the watched loop and cached verdicts (reset, new image). */
+void mm_busywait_reset(struct mm_busywait *bw);
+/* Called after an executed branch at pc_fetch. Returns the number of cycles
+ * that may be skipped (0: keep interpreting). The caller polls the backends
+ * first, clamps it to the next SysTick, SoC timer and sync deadline, cuts it
+ * short when paced and host input arrives, and reports what it used with
+ * mm_busywait_skipped(). The skip counts toward the poll interval, so the
+ * backends are polled again right after it.
+ */
+mm_u32 mm_busywait_backedge(struct mm_busywait *bw, const struct mm_cpu *cpu,
+                            const struct mm_memmap *map, const struct mm_decoded *d,
+                            mm_u32 pc_fetch);
+void mm_busywait_skipped(struct mm_busywait *bw, mm_u64 cycles);
+void mm_busywait_report(const struct mm_busywait *bw);
+
+#endif /* M33MU_BUSYWAIT_H */
@@ -25,8 +25,8 @@
 #include "m33mu/mmio.h"
 
 /* Register dummy MMIO regions for generic Cortex-M33 core blocks so debugger
- * reads to NVIC/SysTick/MPU/ITM/DWT/FPB/SAU do not fault. Actual behavior
- * is minimal (reads return zero, writes are accepted).
+ * reads to the FPB do not fault. Actual behavior is minimal (reads return
+ * zero, writes are accepted). ITM/DWT live in scs.c.
  */
 mm_bool mm_core_sys_register(struct mmio_bus *bus);
 
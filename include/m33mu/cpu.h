@@ -38,6 +38,14 @@ enum mm_mode {
     MM_HANDLER = 1
 };
 
+/* Stack pointer banks; zero is the reset selection (Secure Thread, SPSEL=0). */
+enum mm_sp_bank {
+    MM_SP_MSP_S = 0,
+    MM_SP_PSP_S,
+    MM_SP_MSP_NS,
+    MM_SP_PSP_NS
+};
+
 /*
  * CPU state with banked special registers and stack pointers for Secure/Non-secure.
  * PC is r[15] and should keep bit0 set for Thumb state.
@@ -51,11 +59,19 @@ struct mm_cpu {
     mm_bool priv_s;   /* 0 = privileged, 1 = unprivileged (CONTROL.nPRIV) */
     mm_bool priv_ns;
 
-    /* Banked stack pointers */
+    /* Banked stack pointers. r[13] is the active SP; writes through
+     * mm_cpu_set_active_sp() also land in the active bank, so these stay
+     * current for debuggers and exception stacking. sp_bank and sp_lim cache
+     * the active bank and its limit; mm_cpu_sp_rebank() recomputes them (and
+     * reloads r[13]) whenever mode, security state, CONTROL.SPSEL or a
+     * stack limit changes.
+     */
     mm_u32 msp_s;
     mm_u32 psp_s;
     mm_u32 msp_ns;
     mm_u32 psp_ns;
+    enum mm_sp_bank sp_bank;
+    mm_u32 sp_lim;
 
     /* MSP stack usage tracking */
     mm_u32 msp_top_s;
@@ -117,12 +133,30 @@ struct mm_cpu {
     enum mm_sec_state excl_sec;
     mm_u32 excl_addr;
     mm_u32 excl_size;
+
+    /* Floating-point extension (FPv5, single precision). S registers hold raw
+     * IEEE-754 bits. CONTROL.FPCA (bit 2) is not banked and is mirrored in
+     * control_s/control_ns. The SCB registers below are exposed through the
+     * SCS window (CPACR/NSACR at 0xE000ED88, FPCCR/FPCAR/FPDSCR at 0xE000EF34).
+     */
+    mm_u32 s[32];
+    mm_u32 fpscr;
+    mm_u32 cpacr_s;
+    mm_u32 cpacr_ns;
+    mm_u32 nsacr;
+    mm_u32 fpccr;
+    mm_u32 fpcar;
+    mm_u32 fpdscr_s;
+    mm_u32 fpdscr_ns;
 };
 
 /* Accessors for banked SP and SPLIM based on mode and security. */
 mm_u32 mm_cpu_get_active_sp(const struct mm_cpu *cpu);
 void mm_cpu_set_active_sp(struct mm_cpu *cpu, mm_u32 value);
 mm_u32 mm_cpu_get_active_splim(const struct mm_cpu *cpu);
+/* Select the bank for the current mode/security/SPSEL and load r[13] from
+ * it. Call after changing any of them (or a stack limit) directly. */
+void mm_cpu_sp_rebank(struct mm_cpu *cpu);
 
 mm_u32 mm_cpu_get_msp(const struct mm_cpu *cpu, enum mm_sec_state sec);
 void mm_cpu_set_msp(struct mm_cpu *cpu, enum mm_sec_state sec, mm_u32 value);
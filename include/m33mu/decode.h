@@ -186,7 +186,67 @@ enum mm_op_kind {
     /* Barriers: decoded distinctly but currently executed as no-ops. */
     MM_OP_DSB,
     MM_OP_DMB,
-    MM_OP_ISB
+    MM_OP_ISB,
+
+    /* Floating-point extension (FPv5-SP), executed by mm_fpu_execute().
+     * Single-precision register numbers (Vd:D etc.) are in rd/rn/rm.
+     */
+    MM_OP_VLDR,         /* rn=base, rd=first S reg, imm=signed offset, ra=word count */
+    MM_OP_VSTR,
+    MM_OP_VLDM,         /* rn=base, rd=first S reg, ra=word count, imm=byte span */
+    MM_OP_VSTM,
+    MM_OP_VMOV_CR,      /* rd=Rt, rn=Sn, imm=1 for Sn->Rt */
+    MM_OP_VMOV_CR2,     /* rd=Rt, ra=Rt2, rm=Sm (pair), imm=1 for S->core */
+    MM_OP_VMRS,         /* rd=Rt (15 = APSR_nzcv), imm=system register */
+    MM_OP_VMSR,
+    MM_OP_VMOV_IMM,     /* imm=expanded single-precision constant */
+    MM_OP_VMOV_REG,
+    MM_OP_VABS,
+    MM_OP_VNEG,
+    MM_OP_VSQRT,
+    MM_OP_VADD,
+    MM_OP_VSUB,
+    MM_OP_VMUL,
+    MM_OP_VNMUL,
+    MM_OP_VDIV,
+    MM_OP_VMLA,
+    MM_OP_VMLS,
+    MM_OP_VNMLA,
+    MM_OP_VNMLS,
+    MM_OP_VFMA,
+    MM_OP_VFMS,
+    MM_OP_VFNMA,
+    MM_OP_VFNMS,
+    MM_OP_VCMP,         /* imm bit0=E (quiet NaNs signal), bit1=compare with zero */
+    MM_OP_VCVT_F32_INT, /* imm bit0=signed source */
+    MM_OP_VCVT_INT_F32, /* imm bit0=signed result, bit1=round toward zero */
+    MM_OP_VCVT_FIXED,   /* imm[5:0]=fraction bits, bit8=to fixed, bit9=unsigned, bit10=32-bit */
+    MM_OP_VCVT_HALF,    /* imm bit0=single->half, bit1=top half (VCVTT) */
+    MM_OP_VRINT,        /* imm=MM_FPU_RM_* rounding selector */
+    MM_OP_VCVT_RM,      /* imm[2:0]=MM_FPU_RM_*, bit3=signed result */
+    MM_OP_VSEL,         /* imm=cc (EQ, VS, GE, GT) */
+    MM_OP_VMAXNM,
+    MM_OP_VMINNM,
+
+    /* DSP extension, executed by mm_dsp_execute(). ra=15 selects the
+     * non-accumulating form (SMUAD, SMULWy, SMMUL, USAD8).
+     */
+    MM_OP_PAS,          /* parallel add/sub: imm[6:4]=op (ADD8,ADD16,ASX,-,SUB8,SUB16,SAX), imm[2:0]=S,Q,SH,-,U,UQ,UH */
+    MM_OP_QADDSUB,      /* imm=0 QADD, 1 QDADD, 2 QSUB, 3 QDSUB */
+    MM_OP_SEL,
+    MM_OP_SSAT,         /* imm[5:0]=saturate to bits, bit6=ASR, imm[12:8]=shift */
+    MM_OP_USAT,
+    MM_OP_SSAT16,       /* imm[3:0]=sat bits */
+    MM_OP_USAT16,
+    MM_OP_PKH,          /* imm[4:0]=shift, bit5=PKHTB */
+    MM_OP_SXTB16,       /* imm like SXTB: rotation in imm[4:3], bit31=add Rn */
+    MM_OP_UXTB16,
+    MM_OP_SMLAD,        /* imm bit0=X (swap Rm halves), bit1=subtract (SMLSD) */
+    MM_OP_SMLALD,       /* rd=RdLo, ra=RdHi; imm bit0=X, bit1=subtract (SMLSLD) */
+    MM_OP_SMLAW,        /* imm bit0=top half of Rm */
+    MM_OP_SMMLA,        /* imm bit0=round, bit1=subtract (SMMLS) */
+    MM_OP_SMLAL_XY,     /* rd=RdLo, ra=RdHi; imm like MM_OP_SMLA */
+    MM_OP_USAD8
 };
 
 struct mm_decoded {
@@ -25,7 +25,9 @@
 #include "types.h"
 
 /*
- * DMA bus-master stub interface. Peripherals can request host-driven transfers.
+ * DMA bus-master interface. Peripherals can request host-driven transfers.
+ * The optional resolver hands out a host pointer for ranges that are plain
+ * memory, so bulk transfers can skip the per-beat request path.
  */
 
 typedef mm_bool (*mm_dma_request_fn)(void *opaque,
@@ -34,12 +36,30 @@ typedef mm_bool (*mm_dma_request_fn)(void *opaque,
                                      size_t length_bytes,
                                      mm_bool write_direction); /* MM_TRUE = write to memory */
 
+/* Returns a host pointer covering [addr, addr+length_bytes) or NULL when the
+ * range is MMIO, split across regions or not writable (write_direction). */
+typedef mm_u8 *(*mm_dma_resolve_fn)(void *opaque,
+                                    mm_u32 addr,
+                                    size_t length_bytes,
+                                    mm_bool write_direction);
+
+/* Peripheral request line state as seen by a DMA controller; done is told
+ * when the transfer fed by (or feeding) the line completes. */
+typedef mm_bool (*mm_dma_dreq_fn)(void *opaque, mm_u32 reqsel);
+typedef void (*mm_dma_done_fn)(void *opaque, mm_u32 reqsel);
+
 struct mm_dma_master {
     mm_dma_request_fn request;
+    mm_dma_resolve_fn resolve;
     void *opaque;
 };
 
 void mm_dma_master_init(struct mm_dma_master *dma, mm_dma_request_fn request_fn, void *opaque);
+void mm_dma_master_set_resolver(struct mm_dma_master *dma, mm_dma_resolve_fn resolve_fn);
 mm_bool mm_dma_transfer(struct mm_dma_master *dma, mm_u32 addr, void *buffer, size_t length_bytes, mm_bool write_direction);
+mm_u8 *mm_dma_resolve(struct mm_dma_master *dma, mm_u32 addr, size_t length_bytes, mm_bool write_direction);
+/* Memory-to-memory copy: one memmove when both ranges resolve, otherwise
+ * bounced through the request path. */
+mm_bool mm_dma_copy(struct mm_dma_master *dma, mm_u32 dst, mm_u32 src, size_t length_bytes);
 
 #endif /* M33MU_DMA_H */
@@ -0,0 +1,53 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_DSP_H
+#define M33MU_DSP_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/decode.h"
+
+/* Armv8-M DSP extension. The packed 8x8/2x16 saturating kernels and USAD8
+ * use host SSE2 or NEON when the compiler targets them; everything else,
+ * and hosts without either, use the scalar lane model.
+ */
+
+#define MM_XPSR_Q (1u << 27)
+#define MM_XPSR_GE_SHIFT 16u
+#define MM_XPSR_GE_MASK (0xfu << MM_XPSR_GE_SHIFT)
+
+/* Executes a decoded DSP instruction (MM_OP_PAS ... MM_OP_USAD8 and the
+ * SMULxy form of MM_OP_SMLA). Updates Rd (RdLo/RdHi), GE and Q in xPSR.
+ * Returns MM_FALSE for kinds it does not handle.
+ */
+mm_bool mm_dsp_execute(struct mm_cpu *cpu, const struct mm_decoded *d);
+
+/* Parallel add/sub kernel; op is MM_OP_PAS imm. *ge_io is updated for the
+ * GE-setting (S/U) forms only.
+ */
+mm_u32 mm_dsp_pas(mm_u32 op, mm_u32 a, mm_u32 b, mm_u32 *ge_io);
+
+/* Name of the host SIMD backend in use ("sse2", "neon" or "scalar"). */
+const char *mm_dsp_backend(void);
+
+#endif /* M33MU_DSP_H */
@@ -0,0 +1,49 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_ELFSYM_H
+#define M33MU_ELFSYM_H
+
+#include "m33mu/types.h"
+
+/* Function symbols from an ELF32 .symtab, sorted by address. Thumb bit is
+ * stripped from addresses. Symbols with size 0 extend to the next symbol.
+ */
+struct mm_elfsym {
+    mm_u32 addr;
+    mm_u32 size;
+    const char *name;
+};
+
+struct mm_elfsym_table {
+    struct mm_elfsym *syms;
+    int count;
+    char *strtab;
+};
+
+void mm_elfsym_init(struct mm_elfsym_table *t);
+mm_bool mm_elfsym_load(struct mm_elfsym_table *t, const char *path);
+void mm_elfsym_free(struct mm_elfsym_table *t);
+const struct mm_elfsym *mm_elfsym_lookup(const struct mm_elfsym_table *t, mm_u32 addr);
+const struct mm_elfsym *mm_elfsym_find(const struct mm_elfsym_table *t, const char *name);
+
+#endif /* M33MU_ELFSYM_H */
@@ -10,7 +10,8 @@
 enum mm_eth_backend_type {
     MM_ETH_BACKEND_NONE = 0,
     MM_ETH_BACKEND_TAP,
-    MM_ETH_BACKEND_VDE
+    MM_ETH_BACKEND_VDE,
+    MM_ETH_BACKEND_SHM
 };
 
 mm_bool mm_eth_backend_config(enum mm_eth_backend_type type, const char *spec);
@@ -21,5 +22,16 @@ int mm_eth_backend_recv(mm_u8 *data, mm_u32 len);
 mm_bool mm_eth_backend_is_up(void);
 enum mm_eth_backend_type mm_eth_backend_type_get(void);
 const char *mm_eth_backend_spec(void);
+/* Virtual time and cycle count of the current poll, used to stamp shm
+ * frames and captures. */
+void mm_eth_backend_set_now(mm_u64 vtime_ns, mm_u64 cycles);
+/* Current vsync epoch; only the shm backend uses it. */
+void mm_eth_backend_set_epoch(mm_u32 epoch);
+
+/* --eth-pcap: record frames where the MAC model hands them to or takes them
+ * from the backend. spec is "<file>[,rotate=<MiB>]"; flags are MM_PCAP_*. */
+mm_bool mm_eth_capture_open(const char *spec);
+void mm_eth_capture(mm_u32 flags, const char *note, const mm_u8 *data, mm_u32 len);
+void mm_eth_capture_close(void);
 
 #endif /* M33MU_ETH_BACKEND_H */
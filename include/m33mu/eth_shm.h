@@ -0,0 +1,82 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_ETH_SHM_H
+#define M33MU_ETH_SHM_H
+
+#include "m33mu/types.h"
+
+/* Shared-memory Ethernet switch. Every m33mu process attached to the same
+ * switch name maps one POSIX shm segment holding a fixed array of ports.
+ * Each port owns a ring of frame slots that only its process writes; the
+ * other ports pull from it with private cursors and a per-slot sequence
+ * number, so no lock is ever taken and a dead process cannot wedge the
+ * switch. Forwarding is decided at the receiver from a shared MAC learning
+ * table: multicast and unknown destinations are flooded, unicast frames
+ * whose destination was learned on another live port are skipped.
+ *
+ * Frames are stamped with the sender's virtual time. A configured latency
+ * holds a frame until the receiver's virtual clock has caught up with the
+ * stamp, and loss is a deterministic hash of (sender, receiver, sequence)
+ * so a lossy run is reproducible.
+ *
+ * An idle receiver arms a doorbell (an abstract-namespace datagram socket)
+ * before blocking in mm_hostwait_block(); the next sender to publish a frame
+ * disarms it and sends one byte.
+ */
+
+#define MM_ETH_SHM_PORTS     64u
+#define MM_ETH_SHM_SLOTS     128u  /* per port, power of two */
+#define MM_ETH_SHM_FRAME_MAX 1536u
+#define MM_ETH_SHM_NAME_MAX  48u
+
+struct mm_eth_shm_cfg {
+    char name[MM_ETH_SHM_NAME_MAX];
+    mm_u64 latency_ns;
+    mm_u32 loss_ppm;
+    char pcap[256];
+};
+
+struct mm_eth_shm;
+
+/* Parse "NAME[,latency_us=N][,loss=P%][,pcap=FILE]". */
+mm_bool mm_eth_shm_parse(const char *spec, struct mm_eth_shm_cfg *cfg);
+/* Map (creating if needed) the switch segment and claim a free port. */
+struct mm_eth_shm *mm_eth_shm_attach(const struct mm_eth_shm_cfg *cfg);
+void mm_eth_shm_detach(struct mm_eth_shm *sw);
+/* Remove the segment name; attached processes keep their mapping. */
+void mm_eth_shm_unlink(const char *name);
+
+mm_bool mm_eth_shm_send(struct mm_eth_shm *sw, const mm_u8 *frame, mm_u32 len, mm_u64 now_ns);
+/* Next frame due at now_ns, or 0 when none is. */
+mm_u32 mm_eth_shm_recv(struct mm_eth_shm *sw, mm_u8 *buf, mm_u32 max, mm_u64 now_ns);
+
+int mm_eth_shm_port(const struct mm_eth_shm *sw);
+/* Doorbell descriptor for mm_hostwait_watch(); -1 when unavailable. */
+const int *mm_eth_shm_bell_fd(const struct mm_eth_shm *sw);
+/* Enter synchronised mode (see vsync.h): frames are tagged with the
+ * current epoch and a receiver only takes frames from earlier epochs. */
+void mm_eth_shm_set_epoch(struct mm_eth_shm *sw, mm_u32 epoch);
+/* Frames lost to ring overrun or injected loss. */
+mm_u64 mm_eth_shm_drops(const struct mm_eth_shm *sw);
+
+#endif /* M33MU_ETH_SHM_H */
@@ -29,6 +29,7 @@
 #include "m33mu/memmap.h"
 #include "m33mu/scs.h"
 #include "m33mu/gdbstub.h"
+#include "m33mu/semihost.h"
 
 enum mm_exec_status {
     MM_EXEC_OK = 0,
@@ -44,6 +45,8 @@ struct mm_execute_ctx {
     const struct mm_decoded *dec;
     mm_bool opt_dump;
     mm_bool opt_gdb;
+    /* NULL or disabled: BKPT 0xAB stops like any other breakpoint. */
+    struct mm_semihost *semihost;
     mm_u8 *it_pattern;
     mm_u8 *it_remaining;
     mm_u8 *it_cond;
@@ -0,0 +1,103 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_FPU_H
+#define M33MU_FPU_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/decode.h"
+#include "m33mu/memmap.h"
+
+/* FPv5 single-precision floating-point extension (Cortex-M33).
+ * Arithmetic runs on host floats under the FPSCR rounding mode; NaN
+ * propagation, default-NaN and flush-to-zero follow the Arm rules rather
+ * than the host's, and host exception flags are folded into FPSCR.
+ */
+
+#define MM_FPSCR_IOC (1u << 0)
+#define MM_FPSCR_DZC (1u << 1)
+#define MM_FPSCR_OFC (1u << 2)
+#define MM_FPSCR_UFC (1u << 3)
+#define MM_FPSCR_IXC (1u << 4)
+#define MM_FPSCR_IDC (1u << 7)
+#define MM_FPSCR_RMODE_SHIFT 22u
+#define MM_FPSCR_FZ (1u << 24)
+#define MM_FPSCR_DN (1u << 25)
+#define MM_FPSCR_AHP (1u << 26)
+#define MM_FPSCR_WRITE_MASK 0xF7C0009Fu
+
+#define MM_FPCCR_LSPACT (1u << 0)
+#define MM_FPCCR_USER (1u << 1)
+#define MM_FPCCR_S (1u << 2)
+#define MM_FPCCR_THREAD (1u << 3)
+#define MM_FPCCR_LSPEN (1u << 30)
+#define MM_FPCCR_ASPEN (1u << 31)
+#define MM_FPCCR_RESET (MM_FPCCR_ASPEN | MM_FPCCR_LSPEN)
+
+#define MM_FPU_MVFR0 0x10110021u
+#define MM_FPU_MVFR1 0x11000011u
+#define MM_FPU_MVFR2 0x00000040u
+
+/* Bytes added to an exception frame for S0-S15, FPSCR and a reserved word. */
+#define MM_FPU_FRAME_EXT 0x48u
+
+/* Rounding selectors for VRINT/VCVT{A,N,P,M}. */
+#define MM_FPU_RM_A 0u      /* to nearest, ties away */
+#define MM_FPU_RM_N 1u      /* to nearest, ties to even */
+#define MM_FPU_RM_P 2u      /* toward +inf */
+#define MM_FPU_RM_M 3u      /* toward -inf */
+#define MM_FPU_RM_FPSCR 4u  /* FPSCR.RMode (VRINTR) */
+#define MM_FPU_RM_Z 5u      /* toward zero (VRINTZ) */
+#define MM_FPU_RM_X 6u      /* FPSCR.RMode, signals inexact (VRINTX) */
+
+enum mm_fpu_status {
+    MM_FPU_OK = 0,
+    MM_FPU_UNDEFINED,   /* UsageFault UNDEFINSTR */
+    MM_FPU_NOCP,        /* UsageFault NOCP: CPACR/NSACR deny CP10 */
+    MM_FPU_MEM_FAULT    /* data access fault at *fault_addr */
+};
+
+void mm_fpu_reset(struct mm_cpu *cpu);
+
+/* Executes one decoded FP instruction (MM_OP_V*): access checks, lazy state
+ * preservation, then the operation. VLDM/VSTM base writeback is left to the
+ * caller so SP updates go through the stack-limit checks.
+ */
+enum mm_fpu_status mm_fpu_execute(struct mm_cpu *cpu, struct mm_memmap *map,
+                                  const struct mm_decoded *d, mm_u32 pc, mm_u32 *fault_addr);
+
+/* Exception entry with CONTROL.FPCA set: reserves the extended frame above
+ * the basic frame at *sp_io (lazily when FPCCR.LSPEN), clears EXC_RETURN.FType
+ * and CONTROL.FPCA. Call before pushing the basic frame.
+ */
+mm_bool mm_fpu_exception_entry(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec,
+                               mm_u32 *sp_io, mm_u32 *exc_ret_io);
+
+/* Exception return: restores S0-S15/FPSCR from an extended frame at frame_sp
+ * (basic frame start) unless lazy stacking never happened, and sets
+ * CONTROL.FPCA from EXC_RETURN.FType. Returns MM_FALSE on a read fault.
+ */
+mm_bool mm_fpu_exception_return(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec,
+                                mm_u32 frame_sp, mm_bool basic_frame);
+
+#endif /* M33MU_FPU_H */
@@ -0,0 +1,78 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_FUSE_H
+#define M33MU_FUSE_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+#include "m33mu/decode.h"
+#include "m33mu/predecode.h"
+
+/* Superinstruction pairs. Compiled Cortex-M code is dominated by a few fixed
+ * two-instruction idioms; when the first half of one retires, the second
+ * half is run straight away instead of going around the whole main loop
+ * (pending-exception scan, peripheral poll, debugger and TUI checks).
+ *
+ * The halves still retire one at a time, each charged its own cycle, so
+ * every architectural effect is unchanged. The caller only fuses when the loop
+ * iteration it skips would have done nothing: no exception pending after
+ * the first half, no peripheral poll or reset due, and no debugger
+ * attached. Otherwise the pair is split and the exception is taken between
+ * the two halves, exactly as without fusion.
+ */
+
+enum mm_fuse_kind {
+    MM_FUSE_NONE = 0,
+    MM_FUSE_MOVW_MOVT,  /* 32-bit constant */
+    MM_FUSE_CMP_BCC,    /* compare and branch */
+    MM_FUSE_IT_OP,      /* IT with a single conditional instruction */
+    MM_FUSE_LDR_ADDS,   /* pointer/accumulator loops */
+    MM_FUSE_SUBS_BNE,   /* counted loops */
+    MM_FUSE_KINDS
+};
+
+struct mm_fuse {
+    mm_bool enabled;
+    mm_u64 pairs[MM_FUSE_KINDS];
+};
+
+void mm_fuse_init(struct mm_fuse *fu, mm_bool enabled);
+/* Classify the retired instruction 'first' against the decode of the one
+ * that follows it in memory. */
+enum mm_fuse_kind mm_fuse_classify(const struct mm_decoded *first, const struct mm_decoded *next);
+/* Same, taking the follower from the pre-decode table at next_pc. The table
+ * is only consulted when 'first' can start a pair. */
+enum mm_fuse_kind mm_fuse_pair_at(const struct mm_decoded *first, const struct mm_predecode *pd,
+                                  mm_u32 next_pc);
+/* MOVT and conditional-branch second halves only touch registers and need
+ * no trip through fetch/decode/execute at all: mm_fuse_can_direct() checks
+ * that 'next' (the table entry at next_pc) still matches guest memory and
+ * shares the first half's protection granule, so its fetch could not have
+ * faulted; mm_fuse_exec_direct() then retires it, PC included.
+ */
+mm_bool mm_fuse_can_direct(enum mm_fuse_kind kind, const struct mm_memmap *map,
+                           const struct mm_decoded *next, mm_u32 first_pc, mm_u32 next_pc);
+void mm_fuse_exec_direct(struct mm_cpu *cpu, const struct mm_decoded *next, mm_u32 next_pc);
+
+#endif /* M33MU_FUSE_H */
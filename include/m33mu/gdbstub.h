@@ -25,10 +25,17 @@
 #include "m33mu/types.h"
 #include "m33mu/cpu.h"
 #include "m33mu/memmap.h"
+#include "m33mu/breakpoint.h"
 
 struct mm_gdb_stub {
     int listen_fd;
     int client_fd;
+    /* Buffered receive side of the RSP connection. */
+    mm_u8 rx_buf[4096];
+    size_t rx_len;
+    size_t rx_pos;
+    mm_u64 rx_oversized; /* packets dropped for exceeding PacketSize */
+    mm_bool no_ack;   /* QStartNoAckMode negotiated */
     mm_bool connected;
     mm_bool to_interrupt;
     mm_bool running;
@@ -36,12 +43,9 @@ struct mm_gdb_stub {
     mm_bool alive;
     mm_bool request_reset;
     mm_bool request_quit;
-    struct {
-        mm_u32 addr;
-        mm_u8 len;
-        mm_u8 orig[4];
-        mm_bool valid;
-    } breakpoints[16];
+    /* Breakpoints live outside guest memory; see m33mu/breakpoint.h. */
+    struct mm_bp_set breakpoints;
+    /* Breakpoint PC to step over once when resuming from it. */
     mm_bool rearm_valid;
     mm_u32 rearm_addr;
     char exec_path[256];
@@ -58,7 +62,7 @@ mm_bool mm_gdb_stub_should_run(const struct mm_gdb_stub *stub);
 mm_bool mm_gdb_stub_should_step(const struct mm_gdb_stub *stub);
 mm_bool mm_gdb_stub_breakpoint_hit(const struct mm_gdb_stub *stub, mm_u32 pc);
 void mm_gdb_stub_set_exec_path(struct mm_gdb_stub *stub, const char *path);
-void mm_gdb_stub_maybe_rearm(struct mm_gdb_stub *stub, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 pc);
+void mm_gdb_stub_maybe_rearm(struct mm_gdb_stub *stub, mm_u32 pc);
 mm_bool mm_gdb_stub_poll(struct mm_gdb_stub *stub, int timeout_ms);
 void mm_gdb_stub_set_cpu_name(struct mm_gdb_stub *stub, const char *name);
 mm_bool mm_gdb_stub_take_reset(struct mm_gdb_stub *stub);
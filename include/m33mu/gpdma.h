@@ -0,0 +1,94 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_GPDMA_H
+#define M33MU_GPDMA_H
+
+#include "m33mu/types.h"
+#include "m33mu/mmio.h"
+#include "m33mu/nvic.h"
+#include "m33mu/dma.h"
+
+/* GPDMA controller of the STM32H5/U5 families: linear and 2D channels,
+ * linked-list items, TC/HT/error flags with one IRQ per channel.
+ * Software-request channels (memory to memory) run as soon as they are
+ * enabled, a whole block per step; hardware-request channels move one
+ * burst each time mm_gpdma_service() finds their request line asserted.
+ * Data moves through a struct mm_dma_master, so plain memory is copied
+ * with one memmove per block and peripherals see ordinary bus writes.
+ */
+
+#define MM_GPDMA_MAX_CHANNELS 16u
+
+struct mm_gpdma_cfg {
+    mm_u32 base;                /* non-secure alias */
+    mm_u32 sec_offset;          /* secure alias = base + sec_offset; 0 = none */
+    mm_u32 channels;
+    mm_u32 first_2d;            /* channels >= first_2d have CTR3/CBR2 */
+    const int *irqs;            /* one per channel, -1 = not wired */
+    const mm_u32 *clk_reg;      /* RCC enable register, NULL = always on */
+    mm_u32 clk_bit;
+    mm_dma_dreq_fn dreq;        /* indexed by CTR2.REQSEL */
+    mm_dma_done_fn done;        /* channel completed on a hardware request */
+    void *dreq_opaque;
+    struct mm_dma_master *bus;  /* NULL = the current memory map */
+};
+
+struct mm_gpdma_channel {
+    mm_u32 lbar;
+    mm_u32 sr;
+    mm_u32 cr;
+    mm_u32 tr1;
+    mm_u32 tr2;
+    mm_u32 br1;
+    mm_u32 sar;
+    mm_u32 dar;
+    mm_u32 tr3;
+    mm_u32 br2;
+    mm_u32 llr;
+    mm_u32 block_bytes;         /* BNDT at block start, for HT and repeats */
+    mm_bool ht_done;
+    mm_u8 pack[4];              /* PAM packing carry between beats */
+    mm_u32 pack_len;
+    mm_u32 src_beats;           /* beats into the current source burst */
+    mm_u32 dst_beats;           /* beats into the current destination burst */
+};
+
+struct mm_gpdma {
+    struct mm_gpdma_cfg cfg;
+    struct mm_dma_master own_bus;
+    struct mm_nvic *nvic;
+    mm_u32 seccfgr;
+    mm_u32 privcfgr;
+    mm_u32 rcfglockr;
+    mm_u32 active;              /* bitmask of channels with EN set */
+    struct mm_gpdma_channel ch[MM_GPDMA_MAX_CHANNELS];
+};
+
+mm_bool mm_gpdma_register(struct mmio_bus *bus, struct mm_gpdma *dma, const struct mm_gpdma_cfg *cfg);
+void mm_gpdma_reset(struct mm_gpdma *dma);
+void mm_gpdma_set_nvic(struct mm_gpdma *dma, struct mm_nvic *nvic);
+/* Run hardware-request channels whose request line is asserted. Cheap
+ * when no channel is enabled. */
+void mm_gpdma_service(struct mm_gpdma *dma);
+
+#endif /* M33MU_GPDMA_H */
@@ -0,0 +1,81 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#ifndef M33MU_HOSTCRYPTO_H
+#define M33MU_HOSTCRYPTO_H
+
+#include "m33mu/types.h"
+
+/* Host implementations behind the crypto accelerator models: streaming
+ * MD5/SHA-1/SHA-2 and the AES block cipher. AES uses AES-NI when the host
+ * CPU has it (x86-64 GCC/Clang, detected at run time) and T-tables
+ * otherwise.
+ */
+
+enum mm_hash_algo {
+    MM_HASH_SHA1 = 0,
+    MM_HASH_MD5,
+    MM_HASH_SHA224,
+    MM_HASH_SHA256,
+    MM_HASH_SHA384,
+    MM_HASH_SHA512_224,
+    MM_HASH_SHA512_256,
+    MM_HASH_SHA512
+};
+
+#define MM_HASH_MAX_DIGEST 64u
+#define MM_HASH_MAX_BLOCK 128u
+
+struct mm_hash_ctx {
+    enum mm_hash_algo algo;
+    mm_u32 h32[8];
+    mm_u64 h64[8];
+    mm_u8 buf[MM_HASH_MAX_BLOCK];
+    mm_u32 buf_len;
+    mm_u64 total;       /* bytes hashed so far */
+    mm_u64 blocks;      /* compression function invocations */
+};
+
+void mm_hash_init(struct mm_hash_ctx *ctx, enum mm_hash_algo algo);
+void mm_hash_update(struct mm_hash_ctx *ctx, const mm_u8 *data, size_t len);
+/* Writes the digest and returns its length in bytes. */
+mm_u32 mm_hash_final(struct mm_hash_ctx *ctx, mm_u8 *out);
+mm_u32 mm_hash_block_size(enum mm_hash_algo algo);
+mm_u32 mm_hash_digest_size(enum mm_hash_algo algo);
+
+struct mm_aes_ctx {
+    mm_u32 rounds;
+    mm_u32 ek[60];          /* encryption round keys, big-endian words */
+    mm_u32 dk[60];          /* equivalent inverse cipher round keys */
+    mm_u8 ek_bytes[240];
+    mm_u8 dk_bytes[240];    /* AESIMC-transformed, for AES-NI decryption */
+};
+
+/* key_len is 16, 24 or 32 bytes. */
+mm_bool mm_aes_setkey(struct mm_aes_ctx *ctx, const mm_u8 *key, mm_u32 key_len);
+void mm_aes_encrypt(const struct mm_aes_ctx *ctx, const mm_u8 in[16], mm_u8 out[16]);
+void mm_aes_decrypt(const struct mm_aes_ctx *ctx, const mm_u8 in[16], mm_u8 out[16]);
+/* "aesni" or "table". */
+const char *mm_aes_backend(void);
+
+#endif /* M33MU_HOSTCRYPTO_H */
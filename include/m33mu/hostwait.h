@@ -0,0 +1,57 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_HOSTWAIT_H
+#define M33MU_HOSTWAIT_H
+
+#include "m33mu/types.h"
+
+/* Host-side idle wait. Descriptors serviced on the CPU thread (the GDB
+ * sockets) are registered by address; the main loop then blocks in ppoll()
+ * on whichever of them are currently open instead of napping and polling
+ * every peripheral. Descriptors are read through the registered pointer at
+ * wait time, so a backend that closes or reopens an fd only has to keep the
+ * int up to date. Threads that feed the CPU thread (the I/O reactor, the
+ * TUI) call mm_hostwait_wake() instead.
+ *
+ * A PTY master with no slave attached reports POLLHUP continuously; such
+ * descriptors are dropped from the set for the rest of the wait and the
+ * wait is capped at MM_HOSTWAIT_HUP_RECHECK_NS so a late reader is still
+ * noticed.
+ */
+
+#define MM_HOSTWAIT_FOREVER ((mm_u64)-1)
+#define MM_HOSTWAIT_MAX_FDS 32
+#define MM_HOSTWAIT_HUP_RECHECK_NS 100000000ull /* 100 ms */
+
+/* Start watching *fdp (negative values are skipped). Idempotent. */
+mm_bool mm_hostwait_watch(const int *fdp);
+void mm_hostwait_unwatch(const int *fdp);
+/* Drop every watch (tests, teardown). */
+void mm_hostwait_clear(void);
+/* Interrupt a concurrent or the next mm_hostwait_block(). */
+void mm_hostwait_wake(void);
+/* Block until a watched descriptor is readable, mm_hostwait_wake() is
+ * called or timeout_ns elapses. Returns MM_TRUE when woken by I/O. */
+mm_bool mm_hostwait_block(mm_u64 timeout_ns);
+
+#endif /* M33MU_HOSTWAIT_H */
@@ -0,0 +1,101 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#ifndef M33MU_INTERCEPT_H
+#define M33MU_INTERCEPT_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+#include "m33mu/elfsym.h"
+
+/* Host-native replacements for hot guest library routines. Each routine is
+ * opted in by name and bound to its ELF symbol. When the PC reaches the
+ * entry point outside an IT block, the host implementation works directly
+ * on the guest backing store (every buffer must resolve through
+ * mm_memmap_guest_read_ptr/mm_memmap_guest_write_ptr, so SAU/MPU rules
+ * apply), sets r0, returns through LR and charges
+ * base + per_unit * units cycles. Calls it cannot serve (MMIO buffers,
+ * protection failures, EXC_RETURN/FNC_RETURN in LR) fall through to the
+ * emulated code.
+ *
+ * In verify mode the native result is computed, the guest memory restored,
+ * and the emulated routine runs; its result is compared when it returns
+ * to the caller with the entry SP.
+ */
+
+#define MM_INTERCEPT_MAX 32
+#define MM_INTERCEPT_FILTER_BITS 4096u
+
+struct mm_intercept_impl;
+
+struct mm_intercept_entry {
+    const struct mm_intercept_impl *impl;
+    mm_u32 addr;
+    mm_bool bound;
+    mm_u32 base_cycles;
+    mm_u32 unit_q16;        /* cycles per unit, 16.16 fixed point */
+    mm_u64 calls;
+    mm_u64 units;
+    mm_u64 cycles;
+    mm_u64 verified;
+    mm_u64 mismatches;
+};
+
+struct mm_intercept {
+    mm_bool enabled;
+    mm_bool verify;
+    struct mm_intercept_entry entries[MM_INTERCEPT_MAX];
+    int count;
+    mm_u32 filter[MM_INTERCEPT_FILTER_BITS / 32u];
+    /* Verify mode: the call whose emulated result is being awaited. */
+    mm_bool pending;
+    int pending_idx;
+    mm_u32 ret_pc;
+    mm_u32 ret_sp;
+    enum mm_sec_state ret_sec;
+    mm_u32 expect_r0;
+    mm_u32 span_addr;
+    mm_u32 span_len;
+    mm_u8 *expect;
+    mm_u32 expect_cap;
+};
+
+void mm_intercept_init(struct mm_intercept *ic);
+void mm_intercept_free(struct mm_intercept *ic);
+/* Parse "name[:base[+per_unit]][,name...]". Unknown routine names fail. */
+mm_bool mm_intercept_parse(struct mm_intercept *ic, const char *spec);
+/* Resolve the requested routines; returns the number of bound entry points. */
+int mm_intercept_bind(struct mm_intercept *ic, const struct mm_elfsym_table *syms);
+/* Drop any outstanding verification (system reset). */
+void mm_intercept_reset(struct mm_intercept *ic);
+/* Called before each fetch. Returns the cycles consumed when a native
+ * implementation ran (PC is then the caller's return address), 0 to let the
+ * instruction at PC execute normally.
+ */
+mm_u32 mm_intercept_step(struct mm_intercept *ic, struct mm_cpu *cpu, struct mm_memmap *map);
+void mm_intercept_report(const struct mm_intercept *ic);
+/* Names accepted by mm_intercept_parse(), NULL terminated. */
+const char *mm_intercept_routine_name(int idx);
+
+#endif /* M33MU_INTERCEPT_H */
@@ -0,0 +1,74 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_ITM_H
+#define M33MU_ITM_H
+
+#include "m33mu/types.h"
+
+/*
+ * Host side of the ITM stimulus ports.
+ * Stimulus writes are appended to an in-memory ring and drained in bulk to
+ * a file, a TCP client or a pty (optionally shown in the TUI serial pane),
+ * so firmware logging costs one memcpy per write instead of a syscall.
+ * Only the payload bytes are emitted (no SWO framing).
+ */
+
+#define MM_ITM_RING_SIZE 0x10000u          /* must be a power of two */
+#define MM_ITM_DRAIN_THRESHOLD 0x1000u     /* drain early once this much is queued */
+#define MM_ITM_DRAIN_CYCLES 1000000u       /* ...or after this many virtual cycles */
+
+enum mm_itm_sink_kind {
+    MM_ITM_SINK_NONE = 0,
+    MM_ITM_SINK_FILE,
+    MM_ITM_SINK_TCP,
+    MM_ITM_SINK_PTY
+};
+
+struct mm_itm_sink {
+    enum mm_itm_sink_kind kind;
+    int fd;           /* output fd (-1 while no TCP client is connected) */
+    int listen_fd;    /* TCP listener */
+    mm_bool own_fd;   /* close fd on mm_itm_sink_close() */
+    mm_u8 ring[MM_ITM_RING_SIZE];
+    mm_u32 head;      /* free-running read index */
+    mm_u32 tail;      /* free-running write index */
+    mm_u64 dropped;   /* bytes lost to a full ring */
+    mm_u64 last_drain_cycle;
+    char name[64];
+};
+
+void mm_itm_sink_init(struct mm_itm_sink *sink);
+
+/* spec: "<file>" ("-" for stdout), "tcp:<port>" or "pty". */
+mm_bool mm_itm_sink_open(struct mm_itm_sink *sink, const char *spec);
+void mm_itm_sink_close(struct mm_itm_sink *sink);
+mm_bool mm_itm_sink_active(const struct mm_itm_sink *sink);
+
+/* Append stimulus payload bytes. Never blocks; overflow is counted in dropped. */
+void mm_itm_sink_push(struct mm_itm_sink *sink, const mm_u8 *data, mm_u32 len);
+mm_u32 mm_itm_sink_pending(const struct mm_itm_sink *sink);
+
+/* Drain if enough data is queued or enough virtual time has passed; force drains now. */
+void mm_itm_sink_poll(struct mm_itm_sink *sink, mm_u64 now_cycles, mm_bool force);
+
+#endif /* M33MU_ITM_H */
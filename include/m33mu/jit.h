@@ -0,0 +1,127 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_JIT_H
+#define M33MU_JIT_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+#include "m33mu/decode.h"
+
+/* Block translator to x86-64 host code (built when M33MU_HAS_JIT is
+ * defined). A block starts at a guest PC that has been reached
+ * MM_JIT_HOT_COUNT times outside an IT block and covers straight-line
+ * 16-bit instructions up to and including the first branch (B, B<c>, CBZ,
+ * CBNZ). It never crosses a 32-byte boundary, so the execute permission the
+ * interpreter checked when fetching the first instruction (SAU/MPU regions
+ * are 32-byte granular) holds for the whole block.
+ *
+ * Translated: MOV, ADD/SUB/CMP (immediate and register), AND/EOR/ORR/TST
+ * and 16-bit LDR/STR{B,H} with an immediate offset. Anything else ends the
+ * block before it. Guest registers and xPSR stay in struct mm_cpu; flags are
+ * written back after every flag-setting instruction with the same results
+ * as src/execute.c. Loads and stores call back into mm_memmap_read/write
+ * (so SAU/MPU checks apply) but only for RAM, flash and XIP ROM: an access
+ * that would reach MMIO or fault exits the block before the instruction,
+ * leaving it to the interpreter. A store into the running block's own code
+ * exits right after the store.
+ *
+ * Blocks keep a copy of the guest code they were built from and are
+ * dropped when the backing memory no longer matches, which covers flash
+ * programming, SPI flash XIP updates, DMA and code copied to RAM.
+ *
+ * The code cache is mapped twice: host code is emitted through a writable
+ * view and run through a separate read/execute view, so no page is ever
+ * writable and executable at once.
+ */
+
+#define MM_JIT_HOT_COUNT 16u
+#define MM_JIT_MAX_INSNS 16u
+#define MM_JIT_SPAN MM_MEMMAP_PROT_GRANULE
+#define MM_JIT_TABLE_SIZE 4096u
+#define MM_JIT_CODE_SIZE (4u * 1024u * 1024u)
+
+enum mm_jit_state {
+    MM_JIT_EMPTY = 0,
+    MM_JIT_COUNTING,
+    MM_JIT_READY,
+    MM_JIT_REJECTED
+};
+
+struct mm_jit_block {
+    mm_u32 pc;
+    mm_u8 sec;
+    mm_u8 state;
+    mm_u16 hits;
+    mm_u32 insns;        /* guest instructions when run to the end */
+    mm_u32 span;         /* guest bytes covered */
+    const mm_u8 *guest;  /* host view of the guest code */
+    mm_u8 code[MM_JIT_SPAN];
+    void *host;
+    /* Final branch, for callers that look at the last executed instruction. */
+    struct mm_decoded last;
+    mm_u32 last_pc;
+};
+
+struct mm_jit {
+    mm_bool enabled;
+    struct mm_memmap *map;
+    enum mm_sec_state sec;
+    /* Guest range of the block being run (self-modification check). */
+    mm_u32 run_lo;
+    mm_u32 run_hi;
+    mm_u8 *code;         /* writable view of the code cache */
+    mm_u8 *exec;         /* executable view of the same pages */
+    mm_u32 code_used;
+    struct mm_jit_block *table;
+    /* Set by mm_jit_exec() when a block ran to its final branch. */
+    const struct mm_decoded *last;
+    mm_u32 last_pc;
+    mm_u64 blocks_built;
+    mm_u64 blocks_run;
+    mm_u64 insns_run;
+    mm_u64 flushes;
+};
+
+/* Returns MM_FALSE (and leaves the translator disabled) when the host has
+ * no JIT backend or executable memory cannot be mapped.
+ */
+mm_bool mm_jit_init(struct mm_jit *jit, struct mm_memmap *map);
+void mm_jit_free(struct mm_jit *jit);
+/* Drop every translation (reset, image reload). */
+void mm_jit_flush(struct mm_jit *jit);
+/* Drop the blocks overlapping [addr, addr+len), e.g. reprogrammed XIP flash. */
+void mm_jit_invalidate(struct mm_jit *jit, mm_u32 addr, mm_u32 len);
+/* Count an execution of the instruction at pc_fetch and return its block
+ * once it is hot and translated, 0 otherwise. The caller has just fetched
+ * that instruction (R15 points past it) and charged one cycle for it.
+ */
+struct mm_jit_block *mm_jit_lookup(struct mm_jit *jit, const struct mm_cpu *cpu, mm_u32 pc_fetch);
+/* Run a block returned by mm_jit_lookup(). Returns the number of
+ * instructions retired, with R15 at the next one, or 0 when the first
+ * instruction has to go through the interpreter after all.
+ */
+mm_u32 mm_jit_exec(struct mm_jit *jit, struct mm_cpu *cpu, struct mm_jit_block *blk);
+void mm_jit_report(const struct mm_jit *jit);
+
+#endif /* M33MU_JIT_H */
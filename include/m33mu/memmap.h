@@ -46,6 +46,17 @@ typedef mm_bool (*mm_flash_write_cb)(void *opaque,
                                      mm_u32 size_bytes,
                                      mm_u32 value);
 
+/* Extra read-only backing (e.g. memory-mapped SPI flash). Data reads and
+ * instruction fetch are served straight from buffer; while *locked is set
+ * the window falls through to MMIO as if no backing were present. */
+#define MM_MEMMAP_ROM_MAX 4
+struct mm_memmap_rom {
+    mm_u32 base;
+    mm_u32 size;
+    const mm_u8 *buffer;
+    const mm_bool *locked;
+};
+
 struct mm_memmap {
     struct mm_mem flash;
     struct mm_mem ram;
@@ -66,6 +77,8 @@ struct mm_memmap {
     void *interceptor_opaque;
     mm_flash_write_cb flash_write;
     void *flash_write_opaque;
+    struct mm_memmap_rom rom[MM_MEMMAP_ROM_MAX];
+    mm_u32 rom_count;
 };
 
 void mm_memmap_init(struct mm_memmap *map, struct mmio_region *regions, size_t region_capacity);
@@ -74,6 +87,7 @@ void mm_memmap_set_interceptor(struct mm_memmap *map, mm_access_interceptor fn,
 void mm_memmap_set_flash_writer(struct mm_memmap *map, mm_flash_write_cb fn, void *opaque);
 mm_bool mm_memmap_configure_flash(struct mm_memmap *map, const struct mm_target_cfg *cfg, const mm_u8 *backing, mm_bool secure_view);
 mm_bool mm_memmap_configure_ram(struct mm_memmap *map, const struct mm_target_cfg *cfg, mm_u8 *backing, mm_bool secure_view);
+mm_bool mm_memmap_add_rom(struct mm_memmap *map, mm_u32 base, mm_u32 size, const mm_u8 *buffer, const mm_bool *locked);
 
 /* Accessors that go through interceptors and fall back to MMIO for unmapped regions. */
 mm_bool mm_memmap_read(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 size, mm_u32 *value_out);
@@ -81,8 +95,45 @@ mm_bool mm_memmap_write(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 add
 void mm_memmap_set_watch(mm_u32 addr, mm_u32 size);
 void mm_memmap_clear_watch(void);
 void mm_memmap_set_last_pc(mm_u32 pc);
+/* Optional observer for writes committed by mm_memmap_write (execution trace);
+ * rejected or faulting stores are not reported. */
+typedef void (*mm_memmap_write_observer)(void *opaque, mm_u32 addr, mm_u32 size, mm_u32 value);
+void mm_memmap_set_write_observer(mm_memmap_write_observer fn, void *opaque);
+/* Optional observer for code that changed behind the CPU's back (SPI flash
+ * program/erase under an XIP window); anything caching decoded
+ * instructions drops [addr, addr+len). */
+typedef void (*mm_memmap_code_observer)(void *opaque, mm_u32 addr, mm_u32 len);
+void mm_memmap_set_code_observer(mm_memmap_code_observer fn, void *opaque);
+void mm_memmap_code_changed(mm_u32 addr, mm_u32 len);
 mm_bool mm_memmap_fetch_read16(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 *value_out);
 mm_bool mm_memmap_read8(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u8 *value_out);
 mm_bool mm_memmap_write8(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u8 value);
 
+/* Bulk access helpers.
+ * mm_memmap_host_read_ptr/mm_memmap_host_write_ptr resolve [addr, addr+len)
+ * to a host pointer when the whole range lies in one flash/RAM backing buffer
+ * (flash is never writable this way). They do not consult the interceptor:
+ * callers validate the range with mm_memmap_access_ok(), which checks it once
+ * per protection granule (SAU/MPU regions are 32-byte aligned).
+ */
+#define MM_MEMMAP_PROT_GRANULE 32u
+const mm_u8 *mm_memmap_host_read_ptr(const struct mm_memmap *map, mm_u32 addr, mm_u32 len);
+mm_u8 *mm_memmap_host_write_ptr(const struct mm_memmap *map, mm_u32 addr, mm_u32 len);
+mm_bool mm_memmap_access_ok(const struct mm_memmap *map, enum mm_access_type type, enum mm_sec_state sec, mm_u32 addr, mm_u32 len);
+/* Host pointer for a guest buffer that lies in one backing store and passes
+ * mm_memmap_access_ok(); NULL for MMIO, split ranges or faulting accesses. */
+const mm_u8 *mm_memmap_guest_read_ptr(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 len);
+mm_u8 *mm_memmap_guest_write_ptr(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 len);
+/* MM_TRUE if reading [addr, addr+len) changes nothing: flash, RAM, XIP, or
+ * an MMIO register its device declares side-effect free. */
+mm_bool mm_memmap_read_is_pure(const struct mm_memmap *map, mm_u32 addr, mm_u32 len);
+
+/* DMA bus-master view of the map: flash/RAM ranges resolve to host memory,
+ * everything else goes to the MMIO bus beat by beat. Bus masters sit behind
+ * the CPU's SAU/MPU, so the interceptor is not consulted; the security of
+ * an MMIO beat follows the address alias (bit 28). A NULL map follows
+ * mm_memmap_current() at transfer time. */
+struct mm_dma_master;
+void mm_memmap_dma_master_init(struct mm_memmap *map, struct mm_dma_master *dma);
+
 #endif /* M33MU_MEMMAP_H */
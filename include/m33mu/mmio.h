@@ -33,6 +33,9 @@
 
 typedef mm_bool (*mmio_read_fn)(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out);
 typedef mm_bool (*mmio_write_fn)(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value);
+/* MM_TRUE if reading offset has no side effect on the device (no flag
+ * cleared, no FIFO popped), so a guest polling it may be fast-forwarded. */
+typedef mm_bool (*mmio_read_is_pure_fn)(void *opaque, mm_u32 offset, mm_u32 size_bytes);
 
 struct mmio_region {
     mm_u32 base;
@@ -40,6 +43,7 @@ struct mmio_region {
     void *opaque;
     mmio_read_fn read;
     mmio_write_fn write;
+    mmio_read_is_pure_fn read_is_pure; /* optional; NULL: every read may have side effects */
 };
 
 struct mmio_bus {
@@ -56,6 +60,8 @@ mm_bool mmio_bus_register_region(struct mmio_bus *bus, const struct mmio_region
 /* Returns MM_TRUE on handled access, MM_FALSE on unmapped/fault. */
 mm_bool mmio_bus_read(const struct mmio_bus *bus, mm_u32 addr, mm_u32 size_bytes, mm_u32 *value_out);
 mm_bool mmio_bus_write(const struct mmio_bus *bus, mm_u32 addr, mm_u32 size_bytes, mm_u32 value);
+/* MM_TRUE if addr lies in a region whose read_is_pure hook accepts it. */
+mm_bool mmio_bus_read_is_pure(const struct mmio_bus *bus, mm_u32 addr, mm_u32 size_bytes);
 
 /* Current security state of the in-flight MMIO access (set by memmap.c). */
 void mmio_set_active_sec(enum mm_sec_state sec);
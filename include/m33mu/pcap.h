@@ -0,0 +1,76 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_PCAP_H
+#define M33MU_PCAP_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "m33mu/types.h"
+#include "m33mu/ring.h"
+
+/* Ethernet capture writer producing pcapng (LINKTYPE_ETHERNET, nanosecond
+ * timestamps). Timestamps are supplied by the caller, normally virtual
+ * time, so a capture lines up with the guest's notion of time rather than
+ * the host's. Each packet also carries its direction and a comment with
+ * the emulator cycle count and, for frames the model discarded, why.
+ *
+ * Recording only copies the frame into an in-memory ring; a background
+ * thread formats and writes it. If the writer falls behind, frames are
+ * counted in `lost` rather than stalling the caller. With a rotation size
+ * set, the capture continues in <path>.1, <path>.2, ... once a file would
+ * grow past it; each file is a complete pcapng section.
+ */
+
+#define MM_PCAP_RING_SIZE (1u << 20) /* power of two */
+#define MM_PCAP_SNAPLEN   2048u
+#define MM_PCAP_NOTE_MAX  48u
+#define MM_PCAP_NO_CYCLES ((mm_u64)-1)
+
+/* flags */
+#define MM_PCAP_IN      0x1u
+#define MM_PCAP_OUT     0x2u
+#define MM_PCAP_DROPPED 0x4u
+
+struct mm_pcap {
+    struct mm_ring ring;
+    FILE *f;
+    char path[256];
+    mm_u64 rotate_bytes; /* 0: never rotate */
+    mm_u64 file_bytes;
+    mm_u32 file_index;
+    mm_bool running;
+    int stop;
+    pthread_t thread;
+    mm_u8 *work;         /* writer thread scratch */
+    mm_u64 frames;       /* written by the background thread */
+    mm_u64 lost;         /* dropped on a full ring */
+};
+
+mm_bool mm_pcap_open(struct mm_pcap *p, const char *path, mm_u64 rotate_bytes);
+/* note may be 0; it is copied. */
+void mm_pcap_record(struct mm_pcap *p, mm_u64 ts_ns, mm_u64 cycles, mm_u32 flags,
+                    const char *note, const mm_u8 *data, mm_u32 len);
+/* Writes out everything recorded so far and closes the file. */
+void mm_pcap_close(struct mm_pcap *p);
+
+#endif /* M33MU_PCAP_H */
@@ -0,0 +1,79 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_PREDECODE_H
+#define M33MU_PREDECODE_H
+
+#include <stddef.h>
+#include "m33mu/types.h"
+#include "m33mu/fetch.h"
+#include "m33mu/decode.h"
+
+/* Load-time pre-decoding of the flash image. Every halfword of the loaded
+ * range is decoded once, whichever Thumb alignment the code actually runs
+ * at, into a side table indexed by flash offset. Both the secure and the
+ * non-secure flash alias map onto the same table.
+ *
+ * The decoder is a pure function of the fetched bits, so an entry is used
+ * only when its raw bits and length match the fetch being decoded; flash
+ * that has been reprogrammed since the table was built simply misses and
+ * is decoded (and cached) again. Fetches outside the table are decoded as
+ * usual.
+ *
+ * The table can be persisted next to a key made of the image contents, the
+ * --cpu name and the running executable, so a repeated run of the same
+ * firmware skips the decode pass entirely.
+ */
+
+struct mm_predecode {
+    mm_bool enabled;
+    mm_u32 base_s;
+    mm_u32 base_ns;
+    mm_u32 size;                /* bytes of flash covered */
+    struct mm_decoded *table;   /* one entry per halfword; len == 0: empty */
+    mm_u64 hits;
+    mm_u64 misses;
+};
+
+void mm_predecode_init(struct mm_predecode *pd);
+void mm_predecode_free(struct mm_predecode *pd);
+/* Decode flash[0, size) for execution at base_s / base_ns. */
+mm_bool mm_predecode_build(struct mm_predecode *pd, const mm_u8 *flash, size_t size,
+                           mm_u32 base_s, mm_u32 base_ns);
+/* Drop-in replacement for mm_decode_t32() on the execution path. */
+struct mm_decoded mm_predecode_decode(struct mm_predecode *pd, const struct mm_fetch_result *f);
+/* Table entry for addr, or 0 when outside the table. The entry reflects the
+ * flash contents at build time (or at its last refill) and is only a hint. */
+const struct mm_decoded *mm_predecode_peek(const struct mm_predecode *pd, mm_u32 addr);
+/* Forget the entries covering [addr, addr+len) in either alias. */
+void mm_predecode_invalidate(struct mm_predecode *pd, mm_u32 addr, mm_u32 len);
+
+/* Cache file handling. mm_predecode_cache_path() derives a file name in dir
+ * from the image and cpu name; load/store return MM_FALSE on any mismatch or
+ * I/O error, leaving the table to be built from scratch. */
+mm_bool mm_predecode_cache_path(char *out, size_t out_len, const char *dir,
+                                const mm_u8 *flash, size_t size, const char *cpu_name);
+mm_bool mm_predecode_load(struct mm_predecode *pd, const char *path, const mm_u8 *flash,
+                          size_t size, mm_u32 base_s, mm_u32 base_ns);
+mm_bool mm_predecode_store(const struct mm_predecode *pd, const char *path, const mm_u8 *flash);
+
+#endif /* M33MU_PREDECODE_H */
@@ -0,0 +1,83 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_PROFILE_H
+#define M33MU_PROFILE_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+#include "m33mu/elfsym.h"
+
+/* Sampling guest profiler. Every `period` virtual cycles the current call
+ * stack is captured: the interrupted contexts recorded in cpu->exc_sp[],
+ * one pseudo-frame per active exception, and the current PC/LR plus an
+ * AAPCS frame-record chain (r7 or r11). Frames are reduced to function
+ * start addresses and aggregated, so the cost is one compare per
+ * instruction between samples. Unwinding is best effort: code built
+ * without frame pointers yields PC and LR only.
+ */
+
+#define MM_PROFILE_DEFAULT_PERIOD 1000u
+#define MM_PROFILE_MAX_DEPTH 64
+
+struct mm_profile_stack {
+    mm_u32 hash;
+    mm_u32 off;
+    mm_u32 depth;
+    mm_u64 samples;
+};
+
+struct mm_profile {
+    mm_bool enabled;
+    mm_u64 period;
+    mm_u64 next_sample;
+    mm_u64 total_samples;
+    struct mm_elfsym_table syms;
+    mm_bool have_syms;
+    /* Distinct stacks; frames live in a shared pool, root first. */
+    struct mm_profile_stack *stacks;
+    mm_u32 stack_count;
+    mm_u32 stack_cap;
+    mm_u32 *frames;
+    mm_u32 frame_len;
+    mm_u32 frame_cap;
+    mm_u32 *index;
+    mm_u32 index_cap;
+};
+
+void mm_profile_init(struct mm_profile *p);
+/* Enable sampling every `period` cycles; elf may be NULL for raw addresses. */
+mm_bool mm_profile_start(struct mm_profile *p, mm_u64 period, const char *elf);
+/* Restart the sampling clock after the cycle counter is reset. */
+void mm_profile_rebase(struct mm_profile *p, mm_u64 now_cycles);
+/* Record the current stack for every sample point in (last, now_cycles].
+ * Callers test now_cycles >= p->next_sample first so idle periods that are
+ * fast-forwarded in one step still receive their full weight.
+ */
+void mm_profile_sample(struct mm_profile *p, const struct mm_cpu *cpu,
+                       const struct mm_memmap *map, mm_u64 now_cycles);
+/* Write folded stacks to `path` and a per-function table to `path`.txt. */
+mm_bool mm_profile_write(const struct mm_profile *p, const char *path);
+void mm_profile_free(struct mm_profile *p);
+
+#endif /* M33MU_PROFILE_H */
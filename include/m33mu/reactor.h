@@ -0,0 +1,102 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_REACTOR_H
+#define M33MU_REACTOR_H
+
+#include "m33mu/types.h"
+
+/* Host I/O reactor. One background thread owns the backend descriptors
+ * (UART PTYs, the TAP/VDE link, the USB/IP socket) and moves data between
+ * them and a pair of SPSC rings per channel with epoll. Device models on
+ * the CPU thread only touch the rings, so a slow PTY reader or a busy link
+ * never stalls guest execution on a syscall. Channel setup and teardown
+ * take a mutex; the data path is lock-free.
+ *
+ * Stream channels carry bytes, frame channels carry whole packets (one
+ * read() or write() each); a frame that does not fit the receive ring is
+ * dropped, as a NIC would.
+ *
+ * Listen channels accept one client at a time. The state moves
+ * LISTENING -> UP on accept, UP -> DOWN when the peer goes away or after
+ * mm_chan_drop(); the CPU side acknowledges DOWN with mm_chan_rearm(),
+ * which empties the rings and resumes accepting.
+ *
+ * Descriptors that hang up without being a client (a PTY nobody has
+ * opened) are parked and re-armed every MM_REACTOR_RECHECK_MS. Whenever
+ * received data or a state change becomes visible, the reactor calls
+ * mm_hostwait_wake() so an idle CPU thread re-polls its devices.
+ */
+
+#define MM_REACTOR_MAX_CHANS 32
+#define MM_REACTOR_RECHECK_MS 100
+#define MM_REACTOR_FRAME_MAX 16384u
+
+enum mm_chan_kind {
+    MM_CHAN_STREAM = 0,
+    MM_CHAN_FRAME
+};
+
+enum mm_chan_state {
+    MM_CHAN_UP = 0,
+    MM_CHAN_LISTENING,
+    MM_CHAN_CLOSING,
+    MM_CHAN_DOWN
+};
+
+/* Optional I/O hooks for backends that are not plain fds (VDE). They run
+ * on the reactor thread and return the byte count, 0 when nothing moved,
+ * or -1 on error. With hooks set the reactor only polls fd and leaves
+ * closing it to the caller. */
+struct mm_chan_io {
+    int (*recv)(void *ctx, mm_u8 *buf, mm_u32 len);
+    int (*send)(void *ctx, const mm_u8 *buf, mm_u32 len);
+    void *ctx;
+};
+
+struct mm_chan;
+
+/* Hand fd (non-blocking) to the reactor, which starts on first use. Ring
+ * sizes must be powers of two. Returns 0 on failure; fd is then still the
+ * caller's. */
+struct mm_chan *mm_reactor_open(enum mm_chan_kind kind, int fd, const struct mm_chan_io *io,
+                                mm_u32 rx_size, mm_u32 tx_size);
+struct mm_chan *mm_reactor_open_listen(int listen_fd, mm_u32 rx_size, mm_u32 tx_size);
+/* Remove the channel, close its descriptors and free it. */
+void mm_reactor_close(struct mm_chan *ch);
+/* Close every channel and join the thread. */
+void mm_reactor_stop(void);
+
+/* CPU-thread side. */
+mm_u32 mm_chan_write(struct mm_chan *ch, const void *data, mm_u32 len);
+mm_bool mm_chan_send_frame(struct mm_chan *ch, const void *data, mm_u32 len);
+mm_u32 mm_chan_read(struct mm_chan *ch, void *data, mm_u32 len);
+mm_u32 mm_chan_recv_frame(struct mm_chan *ch, void *data, mm_u32 max);
+mm_u32 mm_chan_rx_avail(const struct mm_chan *ch);
+mm_u32 mm_chan_tx_space(const struct mm_chan *ch);
+mm_bool mm_chan_tx_idle(const struct mm_chan *ch);
+enum mm_chan_state mm_chan_state(const struct mm_chan *ch);
+void mm_chan_drop(struct mm_chan *ch);
+void mm_chan_rearm(struct mm_chan *ch);
+mm_u64 mm_chan_rx_drops(const struct mm_chan *ch);
+
+#endif /* M33MU_REACTOR_H */
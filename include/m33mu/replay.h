@@ -0,0 +1,110 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_REPLAY_H
+#define M33MU_REPLAY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "m33mu/types.h"
+
+/* Deterministic record/replay of host inputs.
+ *
+ * Everything the guest can observe that does not follow from its own
+ * execution enters through a handful of places: bytes read from a UART
+ * PTY, Ethernet frames, USB/IP traffic, the RNG models, semihosting console
+ * and clock calls, and the moments at which the host decided to poll or to
+ * cut a WFI sleep short. With --record each of these is appended to a log,
+ * stamped with the virtual cycle at which the guest saw it. With --replay
+ * the same call sites take their input from the log instead of the host,
+ * so the run repeats cycle for cycle with no backend and no pacing.
+ *
+ * The log is a sequence of records consumed strictly in order. A source
+ * only gets the next record if kind, channel and cycle all match; a record
+ * left behind once its cycle has passed means the run diverged.
+ *
+ * Format: "M33MURR" magic, a version byte, then per record the kind byte
+ * followed by LEB128 varints for the cycle delta, channel and payload
+ * length, then the payload.
+ */
+
+#define MM_REPLAY_VERSION 1u
+#define MM_REPLAY_PAYLOAD_MAX (1u << 20)
+
+enum mm_replay_mode {
+    MM_REPLAY_OFF = 0,
+    MM_REPLAY_RECORD,
+    MM_REPLAY_PLAY
+};
+
+enum mm_replay_kind {
+    MM_REPLAY_END = 0,       /* recording stopped at this cycle */
+    MM_REPLAY_UART_RX,       /* chan: UART base; one received byte */
+    MM_REPLAY_UART_BUSY,     /* chan: UART base; host TX queue was full */
+    MM_REPLAY_ETH_RX,        /* one received frame */
+    MM_REPLAY_USB_STATE,     /* USB/IP client came or went (enum mm_chan_state) */
+    MM_REPLAY_USB_RX,        /* USB/IP bytes from the client */
+    MM_REPLAY_RANDOM,        /* getrandom() result */
+    MM_REPLAY_CONSOLE,       /* semihosting; chan: MM_REPLAY_CONSOLE_* */
+    MM_REPLAY_POLL,          /* I/O poll while the target was stopped */
+    MM_REPLAY_IDLE_POLL,     /* I/O poll repeated while idle without a timer */
+    MM_REPLAY_IDLE,          /* WFI sleep or busy-wait skip cut short; payload: cycles */
+    MM_REPLAY_CONTROL,       /* TUI action; payload: MM_REPLAY_CTL_* */
+    MM_REPLAY_KIND_COUNT
+};
+
+#define MM_REPLAY_CONSOLE_READ 0u
+#define MM_REPLAY_CONSOLE_READC 1u
+#define MM_REPLAY_CONSOLE_TIME 2u
+
+#define MM_REPLAY_CTL_QUIT 0x01u
+#define MM_REPLAY_CTL_RESET 0x02u
+
+mm_bool mm_replay_open(enum mm_replay_mode mode, const char *path);
+/* Writes the END record if mm_replay_bind_clock(0, ...) marked the final
+ * cycle, then prints a summary. */
+void mm_replay_close(void);
+mm_bool mm_replay_recording(void);
+mm_bool mm_replay_playing(void);
+
+/* Records are stamped with base + *cycles. Rebind after every reset with
+ * the cycles run so far as base; pass cycles == 0 to freeze the clock at
+ * base once the run is over. */
+void mm_replay_bind_clock(const mm_u64 *cycles, mm_u64 base);
+mm_u64 mm_replay_now(void);
+
+/* Recording side; no-ops in any other mode. */
+void mm_replay_put(enum mm_replay_kind kind, mm_u32 chan, const void *data, mm_u32 len);
+void mm_replay_put_u64(enum mm_replay_kind kind, mm_u32 chan, mm_u64 value);
+
+/* Replay side: consume the next record if it matches kind, chan and the
+ * current cycle. The payload is truncated to max bytes. */
+mm_bool mm_replay_take(enum mm_replay_kind kind, mm_u32 chan, void *buf, mm_u32 max, mm_u32 *len_out);
+mm_bool mm_replay_take_u64(enum mm_replay_kind kind, mm_u32 chan, mm_u64 *value);
+/* True once the log is used up, the END cycle is reached or a record was
+ * missed; the run should stop. */
+mm_bool mm_replay_finished(void);
+
+/* getrandom() for device models: recorded, or served from the log. */
+ssize_t mm_replay_getrandom(void *buf, size_t len, unsigned int flags);
+
+#endif /* M33MU_REPLAY_H */
@@ -0,0 +1,64 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_RING_H
+#define M33MU_RING_H
+
+#include "m33mu/types.h"
+
+/* Single-producer/single-consumer byte ring. head and tail run freely and
+ * are published with acquire/release ordering, so exactly one thread may
+ * call the producer functions and one other thread the consumer functions
+ * without any lock. Frames are stored as a 32-bit little-endian length
+ * followed by the payload and become visible to the consumer atomically.
+ */
+
+struct mm_ring {
+    mm_u8 *buf;
+    mm_u32 size; /* power of two */
+    mm_u32 head; /* advanced by the consumer */
+    mm_u32 tail; /* advanced by the producer */
+};
+
+mm_bool mm_ring_init(struct mm_ring *r, mm_u32 size);
+void mm_ring_free(struct mm_ring *r);
+/* Only valid while neither side is using the ring. */
+void mm_ring_reset(struct mm_ring *r);
+mm_u32 mm_ring_used(const struct mm_ring *r);
+mm_u32 mm_ring_space(const struct mm_ring *r);
+
+/* Producer side. */
+mm_u32 mm_ring_write(struct mm_ring *r, const void *data, mm_u32 len);
+mm_bool mm_ring_put_frame(struct mm_ring *r, const void *data, mm_u32 len);
+/* Contiguous free space for a zero-copy fill, then publish n bytes of it. */
+mm_u32 mm_ring_write_ptr(struct mm_ring *r, mm_u8 **p);
+void mm_ring_commit(struct mm_ring *r, mm_u32 n);
+
+/* Consumer side. */
+mm_u32 mm_ring_read(struct mm_ring *r, void *data, mm_u32 len);
+/* Returns the frame length (0: none queued) and copies up to max bytes. */
+mm_u32 mm_ring_get_frame(struct mm_ring *r, void *data, mm_u32 max);
+/* Contiguous readable bytes for a zero-copy drain, then release n of them. */
+mm_u32 mm_ring_read_ptr(struct mm_ring *r, const mm_u8 **p);
+void mm_ring_consume(struct mm_ring *r, mm_u32 n);
+
+#endif /* M33MU_RING_H */
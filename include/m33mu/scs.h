@@ -26,6 +26,9 @@
 #include "m33mu/mmio.h"
 #include "m33mu/cpu.h"
 #include "m33mu/nvic.h"
+#include "m33mu/itm.h"
+
+#define MM_DWT_NUM_COMP 4u
 
 struct mm_scs {
     mm_u32 cpuid;
@@ -90,6 +93,26 @@ struct mm_scs {
     mm_bool pend_sv;
     mm_bool pend_st;
     mm_bool trace_enabled;
+    /* Virtual core cycles seen by mm_scs_systick_advance(); DWT time base. */
+    mm_u64 cycles;
+    /* Debug/trace blocks, gated by DEMCR.TRCENA. */
+    mm_u32 demcr;
+    mm_u32 dwt_ctrl;
+    mm_u32 dwt_cyccnt;        /* CYCCNT latched at dwt_cyccnt_sync */
+    mm_u64 dwt_cyccnt_sync;
+    mm_u32 dwt_cpicnt;
+    mm_u32 dwt_exccnt;
+    mm_u32 dwt_sleepcnt;
+    mm_u32 dwt_lsucnt;
+    mm_u32 dwt_foldcnt;
+    mm_u32 dwt_comp[MM_DWT_NUM_COMP];
+    mm_u32 dwt_function[MM_DWT_NUM_COMP];
+    mm_u32 dwt_match_last;    /* CYCCNT last compared against cycle comparators */
+    mm_u32 itm_ter;
+    mm_u32 itm_tpr;
+    mm_u32 itm_tcr;
+    struct mm_itm_sink *itm_sink; /* stimulus port output; 0 discards */
+    struct mm_cpu *cpu;           /* FP control registers live in the core; 0 makes them RAZ/WI */
 };
 
 void mm_scs_init(struct mm_scs *scs, mm_u32 cpuid_const);
@@ -97,13 +120,30 @@ void mm_scs_init(struct mm_scs *scs, mm_u32 cpuid_const);
 /* Registers MMIO regions for secure and non-secure SCS views. */
 mm_bool mm_scs_register_regions(struct mm_scs *scs, struct mmio_bus *bus, mm_u32 base_secure, mm_u32 base_nonsecure, struct mm_nvic *nvic);
 
+/* Registers the ITM (0xE0000000) and DWT (0xE0001000) blocks. */
+mm_bool mm_scs_register_debug_regions(struct mm_scs *scs, struct mmio_bus *bus);
+
+/* Route ITM stimulus port writes to a host sink (0 discards them). */
+void mm_scs_set_itm_sink(struct mm_scs *scs, struct mm_itm_sink *sink);
+
+/* Expose the core's CPACR/NSACR/FPCCR/FPCAR/FPDSCR through the SCB window. */
+void mm_scs_set_cpu(struct mm_scs *scs, struct mm_cpu *cpu);
+
+/* Current DWT_CYCCNT value. */
+mm_u32 mm_scs_dwt_cyccnt(const struct mm_scs *scs);
+
+/* DWT profiling events: exception entries (EXCCNT) and cycles spent asleep (SLEEPCNT). */
+void mm_scs_dwt_exception(struct mm_scs *scs);
+void mm_scs_dwt_sleep(struct mm_scs *scs, mm_u64 cycles);
+
 /* Enable/disable verbose MPU/SAU setup logging. */
 void mm_scs_set_meminfo(mm_bool enabled);
 
 /* Advance SysTick by one "tick" (instruction-step granularity). */
 void mm_scs_systick_step(struct mm_scs *scs);
 
-/* Advance SysTick by an arbitrary number of core cycles (virtual time). */
+/* Advance SysTick by an arbitrary number of core cycles (virtual time).
+ * Also advances the DWT cycle counter. */
 mm_u32 mm_scs_systick_advance(struct mm_scs *scs, mm_u64 cycles);
 
 /* Return cycles until the next SysTick wrap; (mm_u64)-1 if SysTick is disabled. */
@@ -0,0 +1,102 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_SEMIHOST_H
+#define M33MU_SEMIHOST_H
+
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+#include "m33mu/memmap.h"
+
+/* Arm semihosting (BKPT 0xAB). The operation number is taken from r0 and
+ * the parameter block address from r1; the result is returned in r0. File
+ * names are resolved inside a host root directory: absolute names and ".."
+ * components are rejected, so a guest cannot reach outside the sandbox.
+ * Buffers are moved with one host read()/write() on the guest backing
+ * store when the range is plain flash/RAM, byte by byte otherwise.
+ */
+
+#define MM_SEMIHOST_BKPT_IMM 0xABu
+#define MM_SEMIHOST_MAX_FILES 16
+
+#define MM_SEMIHOST_SYS_OPEN 0x01u
+#define MM_SEMIHOST_SYS_CLOSE 0x02u
+#define MM_SEMIHOST_SYS_WRITEC 0x03u
+#define MM_SEMIHOST_SYS_WRITE0 0x04u
+#define MM_SEMIHOST_SYS_WRITE 0x05u
+#define MM_SEMIHOST_SYS_READ 0x06u
+#define MM_SEMIHOST_SYS_READC 0x07u
+#define MM_SEMIHOST_SYS_ISERROR 0x08u
+#define MM_SEMIHOST_SYS_ISTTY 0x09u
+#define MM_SEMIHOST_SYS_SEEK 0x0Au
+#define MM_SEMIHOST_SYS_FLEN 0x0Cu
+#define MM_SEMIHOST_SYS_REMOVE 0x0Eu
+#define MM_SEMIHOST_SYS_CLOCK 0x10u
+#define MM_SEMIHOST_SYS_TIME 0x11u
+#define MM_SEMIHOST_SYS_ERRNO 0x13u
+#define MM_SEMIHOST_SYS_GET_CMDLINE 0x15u
+#define MM_SEMIHOST_SYS_HEAPINFO 0x16u
+#define MM_SEMIHOST_SYS_EXIT 0x18u
+#define MM_SEMIHOST_SYS_EXIT_EXTENDED 0x20u
+#define MM_SEMIHOST_SYS_ELAPSED 0x30u
+#define MM_SEMIHOST_SYS_TICKFREQ 0x31u
+
+#define MM_SEMIHOST_ADP_APPLICATION_EXIT 0x20026u
+
+enum mm_semihost_file_kind {
+    MM_SEMIHOST_FILE_FREE = 0,
+    MM_SEMIHOST_FILE_HOST,     /* regular file inside the root */
+    MM_SEMIHOST_FILE_CONSOLE,  /* ":tt" mapped to stdin/stdout/stderr */
+    MM_SEMIHOST_FILE_FEATURES  /* ":semihosting-features" */
+};
+
+struct mm_semihost_file {
+    enum mm_semihost_file_kind kind;
+    int fd;
+    mm_u32 pos;
+};
+
+struct mm_semihost {
+    mm_bool enabled;
+    char root[512];
+    struct mm_semihost_file files[MM_SEMIHOST_MAX_FILES];
+    int last_errno;
+    mm_u64 host0_ns;
+    /* Virtual clock for SYS_ELAPSED/SYS_TICKFREQ, owned by the run loop. */
+    const mm_u64 *cycles;
+    const mm_u64 *cpu_hz;
+    mm_bool exit_requested;
+    int exit_code;
+};
+
+void mm_semihost_init(struct mm_semihost *sh);
+/* Enable semihosting with file access confined to `root` (NULL means ".") */
+mm_bool mm_semihost_enable(struct mm_semihost *sh, const char *root);
+void mm_semihost_bind_clock(struct mm_semihost *sh, const mm_u64 *cycles, const mm_u64 *cpu_hz);
+/* Close every guest file and clear the exit request (system reset). */
+void mm_semihost_reset(struct mm_semihost *sh);
+/* Service the request in r0/r1. Returns MM_FALSE for unknown operations,
+ * which are reported to the guest as -1 in r0.
+ */
+mm_bool mm_semihost_call(struct mm_semihost *sh, struct mm_cpu *cpu, struct mm_memmap *map);
+
+#endif /* M33MU_SEMIHOST_H */
@@ -22,22 +22,29 @@
 #ifndef M33MU_SPI_BUS_H
 #define M33MU_SPI_BUS_H
 
+#include <stddef.h>
 #include "types.h"
 
 typedef mm_u8 (*mm_spi_xfer_fn)(void *opaque, mm_u8 out);
 typedef void (*mm_spi_end_fn)(void *opaque);
 typedef mm_u8 (*mm_spi_cs_level_fn)(void *opaque);
+/* Clock len bytes in one call. out == NULL shifts out the fill byte,
+ * in == NULL discards what the device returns. */
+typedef void (*mm_spi_xfer_buf_fn)(void *opaque, const mm_u8 *out, mm_u8 fill,
+                                   mm_u8 *in, size_t len);
 
 struct mm_spi_device {
     int bus;
     mm_spi_xfer_fn xfer;
     mm_spi_end_fn end;
     mm_spi_cs_level_fn cs_level;
+    mm_spi_xfer_buf_fn xfer_buf; /* optional, falls back to xfer per byte */
     void *opaque;
 };
 
 mm_bool mm_spi_bus_register_device(const struct mm_spi_device *dev);
 mm_u8 mm_spi_bus_xfer(int bus, mm_u8 out);
+void mm_spi_bus_xfer_buf(int bus, const mm_u8 *out, mm_u8 fill, mm_u8 *in, size_t len);
 void mm_spi_bus_end(int bus);
 
 #endif /* M33MU_SPI_BUS_H */
@@ -9,6 +9,7 @@
 
 struct mmio_bus;
 struct mm_prot_ctx;
+struct mm_memmap;
 
 struct mm_spiflash_cfg {
     int bus; /* 1-based SPI index (SPI1 == 1) */
@@ -38,6 +39,8 @@ void mm_spiflash_reset_all(void);
 void mm_spiflash_shutdown_all(void);
 void mm_spiflash_register_mmap_regions(struct mmio_bus *bus);
 void mm_spiflash_register_prot_regions(struct mm_prot_ctx *prot);
+/* Map mmap= windows as read-only XIP backings (direct data and fetch). */
+void mm_spiflash_register_xip_regions(struct mm_memmap *map);
 size_t mm_spiflash_count(void);
 mm_bool mm_spiflash_get_info(size_t index, struct mm_spiflash_info *out);
 
@@ -0,0 +1,77 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#ifndef M33MU_STM32_CRYPTO_H
+#define M33MU_STM32_CRYPTO_H
+
+#include "m33mu/types.h"
+#include "m33mu/mmio.h"
+#include "m33mu/nvic.h"
+
+/* HASH, AES, SAES and PKA engines of the STM32H5/U5 families. Register
+ * layouts follow the reference manuals; the work itself is done on the
+ * host (hostcrypto.c, bignum.c) as soon as the guest starts an operation,
+ * while BUSY, the completion flags and the IRQ are held back until the
+ * cycle cost from the timing model has elapsed in virtual time.
+ */
+
+enum mm_stm32_crypto_variant {
+    MM_STM32_CRYPTO_H5 = 0,    /* 4-bit HASH ALGO field, SHA-384/512 */
+    MM_STM32_CRYPTO_U5         /* ALGO in CR bits 18/7, MD5/SHA-1/SHA-2 */
+};
+
+struct mm_stm32_crypto_cfg {
+    enum mm_stm32_crypto_variant variant;
+    mm_u32 aes_base;            /* non-secure aliases; 0 leaves the block out */
+    mm_u32 hash_base;
+    mm_u32 saes_base;
+    mm_u32 pka_base;
+    mm_u32 sec_offset;          /* secure alias = base + sec_offset */
+    int aes_irq;
+    int hash_irq;
+    int saes_irq;
+    int pka_irq;
+    const mm_u32 *clk_reg;      /* RCC AHB2ENR: AESEN 16, HASHEN 17, PKAEN 19, SAESEN 20 */
+};
+
+/* Cycle model: cost per compressed HASH block and per AES block, and a
+ * percentage scale on the PKA operation estimate. */
+struct mm_stm32_crypto_timing {
+    mm_u32 hash_block;
+    mm_u32 aes_block;
+    mm_u32 pka_pct;
+};
+
+mm_bool mm_stm32_crypto_register(struct mmio_bus *bus, const struct mm_stm32_crypto_cfg *cfg);
+void mm_stm32_crypto_reset(void);
+void mm_stm32_crypto_set_nvic(struct mm_nvic *nvic);
+void mm_stm32_crypto_tick(mm_u64 cycles);
+/* Cycles until the first busy engine completes; (mm_u64)-1 when idle. */
+mm_u64 mm_stm32_crypto_next_event(void);
+
+/* "hash:N,aes:N,pka:PCT"; any subset, in any order. */
+mm_bool mm_stm32_crypto_parse_timing(const char *spec, struct mm_stm32_crypto_timing *out);
+void mm_stm32_crypto_set_timing(const struct mm_stm32_crypto_timing *t);
+void mm_stm32_crypto_get_timing(struct mm_stm32_crypto_timing *out);
+
+#endif /* M33MU_STM32_CRYPTO_H */
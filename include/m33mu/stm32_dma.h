@@ -0,0 +1,77 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_STM32_DMA_H
+#define M33MU_STM32_DMA_H
+
+#include "m33mu/types.h"
+#include "m33mu/mmio.h"
+#include "m33mu/nvic.h"
+#include "m33mu/dma.h"
+
+/* DMA1/DMA2 with DMAMUX1 as found on the STM32L5: eight channels per
+ * controller, item counters (CNDTR), circular mode and TC/HT/TE flags.
+ * DMAMUX channel n feeds DMA1 channel n+1 (n < 8) or DMA2 channel n-7.
+ * Scheduling follows the GPDMA model (gpdma.h): memory-to-memory
+ * channels run when enabled, peripheral channels move one item per
+ * asserted request in mm_stm32_dma_service().
+ */
+
+#define MM_STM32_DMA_CHANNELS 16u
+
+struct mm_stm32_dma_cfg {
+    mm_u32 base;                /* DMA1; DMA2 at +0x400, DMAMUX1 at +0x800 */
+    mm_u32 sec_offset;          /* secure alias = base + sec_offset; 0 = none */
+    const int *irqs;            /* DMA1 ch1..8 then DMA2 ch1..8, -1 = none */
+    const mm_u32 *clk_reg;      /* RCC AHB1ENR: DMA1EN 0, DMA2EN 1, DMAMUX1EN 2 */
+    mm_dma_dreq_fn dreq;        /* indexed by DMAMUX CxCR.DMAREQ_ID */
+    void *dreq_opaque;
+    struct mm_dma_master *bus;  /* NULL = the current memory map */
+};
+
+struct mm_stm32_dma_channel {
+    mm_u32 ccr;
+    mm_u32 cndtr;
+    mm_u32 cpar;
+    mm_u32 cm0ar;
+    mm_u32 cm1ar;
+    mm_u32 ndt;                 /* programmed item count for HT/circular */
+    mm_u32 cur_par;
+    mm_u32 cur_mar;
+};
+
+struct mm_stm32_dma {
+    struct mm_stm32_dma_cfg cfg;
+    struct mm_dma_master own_bus;
+    struct mm_nvic *nvic;
+    mm_u32 isr[2];
+    mm_u32 active;
+    struct mm_stm32_dma_channel ch[MM_STM32_DMA_CHANNELS];
+    mm_u32 mux[0x400 / 4];
+};
+
+mm_bool mm_stm32_dma_register(struct mmio_bus *bus, struct mm_stm32_dma *dma, const struct mm_stm32_dma_cfg *cfg);
+void mm_stm32_dma_reset(struct mm_stm32_dma *dma);
+void mm_stm32_dma_set_nvic(struct mm_stm32_dma *dma, struct mm_nvic *nvic);
+void mm_stm32_dma_service(struct mm_stm32_dma *dma);
+
+#endif /* M33MU_STM32_DMA_H */
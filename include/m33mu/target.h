@@ -77,6 +77,9 @@ struct mm_target_cfg {
     void (*timer_init)(struct mmio_bus *bus, struct mm_nvic *nvic);
     void (*timer_reset)(void);
     void (*timer_tick)(mm_u64 cycles);
+    /* Cycles until the next timer_tick() would raise an interrupt, set a
+     * status flag or reset the system; (mm_u64)-1 when nothing is armed. */
+    mm_u64 (*timer_next_event)(void);
 };
 
 #define MM_TARGET_FLAG_NVM_WRITEONCE (1u << 0)
@@ -25,8 +25,16 @@
 #include "m33mu/target.h"
 #include "m33mu/types.h"
 
+struct mm_chan;
+
+/* Host side of a UART. PTYs are serviced by the I/O reactor: the byte
+ * functions below only touch its rings, and tx_empty() reports that the
+ * ring can take another byte. The stdout sink writes synchronously to
+ * keep ordering with the emulator's own messages. */
 struct mm_uart_io {
     int fd;
+    struct mm_chan *chan;
+    mm_u32 base;           /* identifies the port in record/replay logs */
     char name[64];
     mm_u8 tx_buf[1024];
     size_t tx_head;
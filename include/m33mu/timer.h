@@ -27,5 +27,8 @@
 void mm_timer_init(const struct mm_target_cfg *cfg, struct mmio_bus *bus, struct mm_nvic *nvic);
 void mm_timer_reset(const struct mm_target_cfg *cfg);
 void mm_timer_tick(const struct mm_target_cfg *cfg, mm_u64 cycles);
+/* Longest advance that keeps every SoC timer event at its exact cycle:
+ * ticking by at most this many cycles fires nothing before its due time. */
+mm_u64 mm_timer_next_event(const struct mm_target_cfg *cfg);
 
 #endif /* M33MU_TIMER_H */
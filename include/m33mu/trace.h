@@ -0,0 +1,138 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_TRACE_H
+#define M33MU_TRACE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "m33mu/types.h"
+#include "m33mu/cpu.h"
+
+/*
+ * Binary execution trace.
+ *
+ * The emulator thread appends compact records to a single-producer /
+ * single-consumer ring; a background thread drains it to a file, optionally
+ * zstd-compressed (builds with M33MU_HAS_ZSTD). Use m33mu-trace to decode.
+ *
+ * File layout: 16-byte header ("M33TRACE", u16 version, u16 flags, u32 0)
+ * followed by a record stream (compressed as a whole when flags has ZSTD).
+ * All fields are little-endian.
+ *
+ *   SYNC  tag, u64 icount, u8 state, 17 x u32 (r0-r15, xPSR)
+ *   INSN  tag, u8 state, u32 pc, u16|u32 insn, u16 mask, u32 value per mask bit
+ *   MEMW  tag, u8 size, u32 addr, size bytes of value
+ *   EXC   tag, u16 exception number
+ *
+ * An INSN record describes the instruction about to execute: mask bits 0-14
+ * are r0-r14 and bit 15 is xPSR, carrying every register that changed since
+ * the previous record (i.e. the effect of the previous instruction plus any
+ * exception entry/return). MEMW records following an INSN belong to it.
+ * state: bit0 = 32-bit encoding, bit1 = Non-secure, bit2 = Handler mode.
+ * r13 is the active stack pointer.
+ */
+
+#define MM_TRACE_MAGIC "M33TRACE"
+#define MM_TRACE_VERSION 1u
+#define MM_TRACE_FLAG_ZSTD 0x0001u
+#define MM_TRACE_HEADER_SIZE 16u
+
+#define MM_TRACE_REC_SYNC 0x01u
+#define MM_TRACE_REC_INSN 0x02u
+#define MM_TRACE_REC_MEMW 0x03u
+#define MM_TRACE_REC_EXC 0x04u
+
+#define MM_TRACE_STATE_T32 0x01u
+#define MM_TRACE_STATE_NS 0x02u
+#define MM_TRACE_STATE_HANDLER 0x04u
+
+#define MM_TRACE_NREGS 17u            /* r0-r15 + xPSR */
+#define MM_TRACE_REG_XPSR 16u
+#define MM_TRACE_SYNC_INTERVAL 65536u /* full register snapshot period (instructions) */
+#define MM_TRACE_RING_SIZE (16u * 1024u * 1024u) /* power of two */
+
+struct mm_trace_writer {
+    mm_u8 *ring;
+    mm_u32 head;                /* consumer index (free-running) */
+    mm_u32 tail;                /* producer index (free-running) */
+    int fd;
+    mm_bool compress;
+    mm_bool running;
+    int stop;
+    pthread_t thread;
+    void *zctx;
+    mm_u32 regs[MM_TRACE_NREGS];
+    mm_bool have_regs;
+    mm_u64 icount;
+    mm_u32 since_sync;
+    mm_u64 stalls;              /* producer waits on a full ring */
+};
+
+/* Compression requires a build with zstd; returns MM_FALSE otherwise. */
+mm_bool mm_trace_open(struct mm_trace_writer *tw, const char *path, mm_bool compress);
+void mm_trace_close(struct mm_trace_writer *tw);
+mm_bool mm_trace_zstd_available(void);
+
+void mm_trace_insn(struct mm_trace_writer *tw, const struct mm_cpu *cpu, mm_u32 pc, mm_u32 insn, mm_u8 len);
+void mm_trace_mem_write(struct mm_trace_writer *tw, mm_u32 addr, mm_u32 size, mm_u32 value);
+void mm_trace_exception(struct mm_trace_writer *tw, mm_u32 exc_num);
+/* Force a full register snapshot with the next instruction (e.g. after reset). */
+void mm_trace_resync(struct mm_trace_writer *tw);
+
+/* Decoder side. */
+struct mm_trace_event {
+    mm_u8 kind;                 /* MM_TRACE_REC_* */
+    mm_u8 state;
+    mm_u8 len;                  /* INSN: 2 or 4 */
+    mm_u16 changed;             /* INSN: mask of registers updated by this record */
+    mm_u32 pc;
+    mm_u32 insn;
+    mm_u32 addr;                /* MEMW */
+    mm_u32 size;                /* MEMW */
+    mm_u32 value;               /* MEMW */
+    mm_u32 exc_num;             /* EXC */
+    mm_u64 icount;              /* INSN/SYNC: instruction index */
+};
+
+struct mm_trace_reader {
+    FILE *f;
+    mm_bool compressed;
+    void *zctx;
+    mm_u8 *in;
+    size_t in_len;
+    size_t in_pos;
+    mm_u8 *buf;
+    size_t buf_len;
+    size_t buf_pos;
+    mm_bool eof;
+    mm_u32 regs[MM_TRACE_NREGS]; /* reconstructed state at the last INSN/SYNC */
+    mm_bool have_regs;
+    mm_u64 icount;
+};
+
+mm_bool mm_trace_reader_open(struct mm_trace_reader *tr, const char *path);
+/* Returns 1 for an event, 0 at end of trace, -1 on a malformed stream. */
+int mm_trace_reader_next(struct mm_trace_reader *tr, struct mm_trace_event *ev);
+void mm_trace_reader_close(struct mm_trace_reader *tr);
+
+#endif /* M33MU_TRACE_H */
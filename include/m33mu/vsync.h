@@ -0,0 +1,73 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#ifndef M33MU_VSYNC_H
+#define M33MU_VSYNC_H
+
+#include "m33mu/types.h"
+
+/* Conservative virtual-time synchronisation between emulator instances.
+ *
+ * A coordinator (m33mu-sync) listens on a Unix seqpacket socket and waits
+ * for a fixed number of instances to join. It then hands out grants: every
+ * instance runs until its virtual clock reaches the granted limit, reports
+ * the time it actually reached and stops. Once all have reported, the next
+ * grant is min(reported) + quantum. No instance is ever more than one
+ * quantum ahead of the slowest, and none waits on the wall clock, so a
+ * network of nodes runs as fast as its slowest member.
+ *
+ * Each grant also carries an epoch number. Frames exchanged through
+ * --eth-shm are tagged with the sender's epoch and only become visible to
+ * receivers in a later epoch, by which time every frame of that epoch has
+ * been published. Delivery therefore depends only on virtual time and the
+ * run is reproducible.
+ */
+
+#define MM_VSYNC_DEFAULT_QUANTUM_NS 100000ull /* 100 us */
+#define MM_VSYNC_MAX_NODES 64u
+
+enum mm_vsync_status {
+    MM_VSYNC_GRANTED = 0,
+    MM_VSYNC_WAITING,
+    MM_VSYNC_LOST
+};
+
+struct mm_vsync {
+    int fd;
+    mm_u32 epoch;
+    mm_u64 limit_ns;  /* run until virtual time reaches this */
+    mm_bool reported;
+};
+
+/* Join the coordinator at path and wait for the first grant. The fd is
+ * registered with hostwait, so vs must stay at a fixed address. */
+mm_bool mm_vsync_connect(struct mm_vsync *vs, const char *path);
+/* Call once virtual time has reached vs->limit_ns: reports now_ns the first
+ * time, then returns MM_VSYNC_GRANTED when the next grant has arrived. */
+enum mm_vsync_status mm_vsync_step(struct mm_vsync *vs, mm_u64 now_ns);
+void mm_vsync_close(struct mm_vsync *vs);
+
+/* Coordinator main loop: wait for nodes instances, then run barriers until
+ * every one of them has disconnected. Returns 0 on success. */
+int mm_vsync_coordinate(const char *path, mm_u32 nodes, mm_u64 quantum_ns);
+
+#endif /* M33MU_VSYNC_H */
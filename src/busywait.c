@@ -0,0 +1,363 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/busywait.h"
+#include "m33mu/fetch.h"
+
+static mm_bool is_branch(enum mm_op_kind kind)
+{
+    switch (kind) {
+    case MM_OP_B_COND:
+    case MM_OP_B_COND_WIDE:
+    case MM_OP_B_UNCOND:
+    case MM_OP_B_UNCOND_WIDE:
+    case MM_OP_CBZ:
+    case MM_OP_CBNZ:
+        return MM_TRUE;
+    default:
+        return MM_FALSE;
+    }
+}
+
+/* Instructions whose only effect is on r0-r12 and the flags; registers
+ * they write are added to *written. */
+static mm_bool insn_is_pure(const struct mm_decoded *d, mm_u32 *written)
+{
+    if (is_branch(d->kind)) {
+        return MM_TRUE;
+    }
+    switch (d->kind) {
+    case MM_OP_NOP:
+    case MM_OP_DSB:
+    case MM_OP_DMB:
+    case MM_OP_ISB:
+    case MM_OP_CMP_IMM:
+    case MM_OP_CMP_REG:
+    case MM_OP_CMN_IMM:
+    case MM_OP_CMN_REG:
+    case MM_OP_TST_IMM:
+    case MM_OP_TST_REG:
+        return MM_TRUE;
+    case MM_OP_ADR:
+    case MM_OP_MOV_IMM:
+    case MM_OP_MOV_REG:
+    case MM_OP_MVN_IMM:
+    case MM_OP_MVN_REG:
+    case MM_OP_MOVW:
+    case MM_OP_MOVT:
+    case MM_OP_ADD_IMM:
+    case MM_OP_ADD_REG:
+    case MM_OP_SUB_IMM:
+    case MM_OP_SUB_IMM_NF:
+    case MM_OP_SUB_REG:
+    case MM_OP_RSB_IMM:
+    case MM_OP_RSB_REG:
+    case MM_OP_NEG:
+    case MM_OP_AND_REG:
+    case MM_OP_EOR_REG:
+    case MM_OP_ORR_REG:
+    case MM_OP_ORN_REG:
+    case MM_OP_ORN_IMM:
+    case MM_OP_BIC_REG:
+    case MM_OP_LSL_IMM:
+    case MM_OP_LSL_REG:
+    case MM_OP_LSR_IMM:
+    case MM_OP_LSR_REG:
+    case MM_OP_ASR_IMM:
+    case MM_OP_ASR_REG:
+    case MM_OP_ROR_IMM:
+    case MM_OP_ROR_REG:
+    case MM_OP_UXTB:
+    case MM_OP_UXTH:
+    case MM_OP_SXTB:
+    case MM_OP_SXTH:
+    case MM_OP_UBFX:
+    case MM_OP_SBFX:
+    case MM_OP_CLZ:
+    case MM_OP_RBIT:
+    case MM_OP_REV:
+    case MM_OP_REV16:
+    case MM_OP_REVSH:
+        if (d->rd >= 13u) {
+            return MM_FALSE;
+        }
+        *written |= 1u << d->rd;
+        return MM_TRUE;
+    default:
+        return MM_FALSE;
+    }
+}
+
+/* Loads without writeback into r0-r12. Their addresses are checked against
+ * the memory map before every skip (see loads_are_pure()). */
+static mm_u32 load_size(enum mm_op_kind kind)
+{
+    switch (kind) {
+    case MM_OP_LDR_IMM:
+    case MM_OP_LDR_REG:
+    case MM_OP_LDR_LITERAL:
+        return 4u;
+    case MM_OP_LDRH_IMM:
+    case MM_OP_LDRH_REG:
+    case MM_OP_LDRSH_IMM:
+    case MM_OP_LDRSH_REG:
+        return 2u;
+    case MM_OP_LDRB_IMM:
+    case MM_OP_LDRB_REG:
+    case MM_OP_LDRSB_IMM:
+    case MM_OP_LDRSB_REG:
+        return 1u;
+    default:
+        return 0u;
+    }
+}
+
+static mm_bool add_load(struct mm_busywait_verdict *v, const struct mm_decoded *d, mm_u32 pc)
+{
+    struct mm_busywait_load *ld;
+    if (d->rd >= 13u || v->load_count >= MM_BUSYWAIT_MAX_LOADS) {
+        return MM_FALSE;
+    }
+    ld = &v->loads[v->load_count++];
+    ld->size = (mm_u8)load_size(d->kind);
+    ld->rn = MM_BUSYWAIT_NO_REG;
+    ld->rm = MM_BUSYWAIT_NO_REG;
+    ld->shift = 0;
+    switch (d->kind) {
+    case MM_OP_LDR_LITERAL:
+        ld->imm = ((pc + 4u) & ~3u) + d->imm;
+        return MM_TRUE;
+    case MM_OP_LDR_REG:
+    case MM_OP_LDRH_REG:
+    case MM_OP_LDRSH_REG:
+    case MM_OP_LDRB_REG:
+        ld->rm = d->rm;
+        ld->shift = (mm_u8)(d->imm & 0x3u);
+        break;
+    case MM_OP_LDRSB_REG:
+        ld->rm = d->rm;
+        break;
+    default:
+        break;
+    }
+    ld->rn = d->rn;
+    ld->imm = (ld->rm == MM_BUSYWAIT_NO_REG) ? d->imm : 0u;
+    return d->rn != 15u && ld->rm != 15u;
+}
+
+static mm_bool classify_body(struct mm_busywait_verdict *v, const struct mm_memmap *map,
+                             enum mm_sec_state sec, mm_u32 head, mm_u32 tail)
+{
+    mm_u32 pc = head;
+    mm_u32 written = 0;
+    int n;
+    int i;
+    v->load_count = 0;
+    for (n = 0; n < MM_BUSYWAIT_MAX_INSNS; ++n) {
+        struct mm_fetch_result f;
+        struct mm_decoded d;
+        mm_u32 hw1 = 0;
+        mm_u32 hw2 = 0;
+        if (!mm_memmap_fetch_read16(map, sec, pc, &hw1)) {
+            return MM_FALSE;
+        }
+        f.insn = hw1;
+        f.len = 2;
+        if (t32_is_32bit_prefix((mm_u16)hw1)) {
+            if (!mm_memmap_fetch_read16(map, sec, pc + 2u, &hw2)) {
+                return MM_FALSE;
+            }
+            f.insn = (hw1 << 16) | hw2;
+            f.len = 4;
+        }
+        f.fault = MM_FALSE;
+        f.fault_addr = 0;
+        f.pc_fetch = pc;
+        d = mm_decode_t32(&f);
+        if (d.undefined) {
+            return MM_FALSE;
+        }
+        if (load_size(d.kind) != 0u) {
+            if (!add_load(v, &d, pc)) {
+                return MM_FALSE;
+            }
+            written |= 1u << d.rd;
+        } else if (!insn_is_pure(&d, &written)) {
+            return MM_FALSE;
+        }
+        if (pc == tail) {
+            /* Address registers must hold their head-of-loop values. */
+            for (i = 0; i < v->load_count; ++i) {
+                const struct mm_busywait_load *ld = &v->loads[i];
+                if (ld->rn != MM_BUSYWAIT_NO_REG && (written & (1u << ld->rn)) != 0u) {
+                    return MM_FALSE;
+                }
+                if (ld->rm != MM_BUSYWAIT_NO_REG && (written & (1u << ld->rm)) != 0u) {
+                    return MM_FALSE;
+                }
+            }
+            return MM_TRUE;
+        }
+        pc += f.len;
+        if (pc > tail) {
+            return MM_FALSE;
+        }
+    }
+    return MM_FALSE;
+}
+
+/* Every load must hit flash, RAM or an MMIO register its device declares
+ * side-effect free (a status register, not one that clears a flag or pops
+ * a FIFO on read): skipping any other read changes what the device sees. */
+static mm_bool loads_are_pure(const struct mm_busywait_verdict *v, const struct mm_cpu *cpu,
+                                const struct mm_memmap *map)
+{
+    int i;
+    for (i = 0; i < v->load_count; ++i) {
+        const struct mm_busywait_load *ld = &v->loads[i];
+        mm_u32 addr = ld->imm;
+        if (ld->rn != MM_BUSYWAIT_NO_REG) {
+            addr += cpu->r[ld->rn];
+        }
+        if (ld->rm != MM_BUSYWAIT_NO_REG) {
+            addr += cpu->r[ld->rm] << ld->shift;
+        }
+        if (!mm_memmap_read_is_pure(map, addr, ld->size)) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static const struct mm_busywait_verdict *verdict_for(struct mm_busywait *bw, const struct mm_memmap *map,
+                                                     enum mm_sec_state sec, mm_u32 head, mm_u32 tail)
+{
+    struct mm_busywait_verdict *v;
+    int i;
+    for (i = 0; i < bw->verdict_count; ++i) {
+        if (bw->verdicts[i].head == head && bw->verdicts[i].tail == tail) {
+            return &bw->verdicts[i];
+        }
+    }
+    v = &bw->verdicts[bw->verdict_next];
+    bw->verdict_next = (bw->verdict_next + 1) % MM_BUSYWAIT_VERDICTS;
+    if (bw->verdict_count < MM_BUSYWAIT_VERDICTS) {
+        bw->verdict_count++;
+    }
+    v->head = head;
+    v->tail = tail;
+    v->pure = classify_body(v, map, sec, head, tail);
+    return v;
+}
+
+static void snapshot(struct mm_busywait *bw, const struct mm_cpu *cpu)
+{
+    memcpy(bw->regs, cpu->r, sizeof(bw->regs));
+    bw->xpsr = cpu->xpsr;
+    bw->sec = cpu->sec_state;
+    bw->mode = cpu->mode;
+}
+
+static mm_bool same_state(const struct mm_busywait *bw, const struct mm_cpu *cpu)
+{
+    return memcmp(bw->regs, cpu->r, sizeof(bw->regs)) == 0 &&
+           bw->xpsr == cpu->xpsr &&
+           bw->sec == cpu->sec_state &&
+           bw->mode == cpu->mode;
+}
+
+void mm_busywait_init(struct mm_busywait *bw, mm_bool enabled)
+{
+    memset(bw, 0, sizeof(*bw));
+    bw->enabled = enabled;
+    bw->chunk = MM_BUSYWAIT_CHUNK_MIN;
+}
+
+void mm_busywait_reset(struct mm_busywait *bw)
+{
+    bw->tracking = MM_FALSE;
+    bw->chunk = MM_BUSYWAIT_CHUNK_MIN;
+    bw->verdict_count = 0;
+    bw->verdict_next = 0;
+}
+
+mm_u32 mm_busywait_backedge(struct mm_busywait *bw, const struct mm_cpu *cpu,
+                            const struct mm_memmap *map, const struct mm_decoded *d,
+                            mm_u32 pc_fetch)
+{
+    const struct mm_busywait_verdict *v;
+    mm_u32 head = cpu->r[15] & ~1u;
+    if (!bw->enabled || !is_branch(d->kind)) {
+        return 0;
+    }
+    if (head > pc_fetch || pc_fetch - head > MM_BUSYWAIT_MAX_SPAN) {
+        return 0;
+    }
+    if (!bw->tracking || bw->head != head || bw->tail != pc_fetch) {
+        bw->tracking = MM_FALSE;
+        bw->chunk = MM_BUSYWAIT_CHUNK_MIN;
+        v = verdict_for(bw, map, cpu->sec_state, head, pc_fetch);
+        if (!v->pure) {
+            return 0;
+        }
+        bw->loop = *v;
+        bw->tracking = MM_TRUE;
+        bw->head = head;
+        bw->tail = pc_fetch;
+        snapshot(bw, cpu);
+        return 0;
+    }
+    if (!same_state(bw, cpu)) {
+        bw->chunk = MM_BUSYWAIT_CHUNK_MIN;
+        snapshot(bw, cpu);
+        return 0;
+    }
+    if (!loads_are_pure(&bw->loop, cpu, map)) {
+        return 0;
+    }
+    return bw->chunk;
+}
+
+void mm_busywait_skipped(struct mm_busywait *bw, mm_u64 cycles)
+{
+    if (cycles == 0u) {
+        return;
+    }
+    bw->skipped_cycles += cycles;
+    bw->skips++;
+    if (bw->chunk < MM_BUSYWAIT_CHUNK_MAX) {
+        bw->chunk <<= 1;
+    }
+}
+
+void mm_busywait_report(const struct mm_busywait *bw)
+{
+    if (!bw->enabled || bw->skips == 0u) {
+        return;
+    }
+    fprintf(stderr, "[BUSYWAIT] skipped %llu cycles in %llu fast-forwards\n",
+            (unsigned long long)bw->skipped_cycles, (unsigned long long)bw->skips);
+}
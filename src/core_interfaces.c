@@ -19,6 +19,7 @@
  *
  */
 
+#include <string.h>
 #include "m33mu/mmio.h"
 #include "m33mu/irq.h"
 #include "m33mu/scheduler.h"
@@ -115,6 +116,23 @@ mm_bool mmio_bus_write(const struct mmio_bus *bus, mm_u32 addr, mm_u32 size_byte
     return region->write(region->opaque, offset, size_bytes, value);
 }
 
+mm_bool mmio_bus_read_is_pure(const struct mmio_bus *bus, mm_u32 addr, mm_u32 size_bytes)
+{
+    const struct mmio_region *region;
+    mm_u32 offset;
+
+    region = mmio_bus_find(bus, addr);
+    if (region == 0 || region->read_is_pure == 0) {
+        return MM_FALSE;
+    }
+
+    offset = addr - region->base;
+    if (offset + size_bytes > region->size) {
+        return MM_FALSE;
+    }
+    return region->read_is_pure(region->opaque, offset, size_bytes);
+}
+
 void mm_irq_line_init(struct mm_irq_line *line, mm_irq_sink_fn sink, void *opaque)
 {
     line->sink = sink;
@@ -360,9 +378,15 @@ mm_bool mm_gpio_bank_info(int bank, char *name_out, size_t name_len, int *pins_o
 void mm_dma_master_init(struct mm_dma_master *dma, mm_dma_request_fn request_fn, void *opaque)
 {
     dma->request = request_fn;
+    dma->resolve = 0;
     dma->opaque = opaque;
 }
 
+void mm_dma_master_set_resolver(struct mm_dma_master *dma, mm_dma_resolve_fn resolve_fn)
+{
+    dma->resolve = resolve_fn;
+}
+
 mm_bool mm_dma_transfer(struct mm_dma_master *dma, mm_u32 addr, void *buffer, size_t length_bytes, mm_bool write_direction)
 {
     if (dma->request == 0) {
@@ -370,3 +394,37 @@ mm_bool mm_dma_transfer(struct mm_dma_master *dma, mm_u32 addr, void *buffer, si
     }
     return dma->request(dma->opaque, addr, buffer, length_bytes, write_direction);
 }
+
+mm_u8 *mm_dma_resolve(struct mm_dma_master *dma, mm_u32 addr, size_t length_bytes, mm_bool write_direction)
+{
+    if (dma->resolve == 0 || length_bytes == 0u) {
+        return 0;
+    }
+    return dma->resolve(dma->opaque, addr, length_bytes, write_direction);
+}
+
+mm_bool mm_dma_copy(struct mm_dma_master *dma, mm_u32 dst, mm_u32 src, size_t length_bytes)
+{
+    mm_u8 bounce[64];
+    const mm_u8 *s;
+    mm_u8 *d;
+    s = mm_dma_resolve(dma, src, length_bytes, MM_FALSE);
+    d = mm_dma_resolve(dma, dst, length_bytes, MM_TRUE);
+    if (s != 0 && d != 0) {
+        memmove(d, s, length_bytes);
+        return MM_TRUE;
+    }
+    while (length_bytes > 0u) {
+        size_t chunk = length_bytes > sizeof(bounce) ? sizeof(bounce) : length_bytes;
+        if (!mm_dma_transfer(dma, src, bounce, chunk, MM_FALSE)) {
+            return MM_FALSE;
+        }
+        if (!mm_dma_transfer(dma, dst, bounce, chunk, MM_TRUE)) {
+            return MM_FALSE;
+        }
+        src += (mm_u32)chunk;
+        dst += (mm_u32)chunk;
+        length_bytes -= chunk;
+    }
+    return MM_TRUE;
+}
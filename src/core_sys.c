@@ -19,6 +19,7 @@
  *
  */
 
+#include <string.h>
 #include "m33mu/core_sys.h"
 
 struct mm_core_stub {
@@ -53,28 +54,17 @@ static mm_bool stub_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
 mm_bool mm_core_sys_register(struct mmio_bus *bus)
 {
     static struct mm_core_stub stub;
-    struct mmio_region regs[3];
+    struct mmio_region reg;
 
-    /* ITM */
-    regs[0].base = 0xE0000000u;
-    regs[0].size = 0x1000u;
-    /* DWT */
-    regs[1].base = 0xE0001000u;
-    regs[1].size = 0x1000u;
-    /* FPB */
-    regs[2].base = 0xE0002000u;
-    regs[2].size = 0x1000u;
-
-    {
-        int i;
-        for (i = 0; i < 3; ++i) {
-            regs[i].opaque = &stub;
-            regs[i].read = stub_read;
-            regs[i].write = stub_write;
-            if (!mmio_bus_register_region(bus, &regs[i])) {
-                return MM_FALSE;
-            }
-        }
+    /* FPB (ITM and DWT are modelled in scs.c) */
+    memset(&reg, 0, sizeof(reg));
+    reg.base = 0xE0002000u;
+    reg.size = 0x1000u;
+    reg.opaque = &stub;
+    reg.read = stub_read;
+    reg.write = stub_write;
+    if (!mmio_bus_register_region(bus, &reg)) {
+        return MM_FALSE;
     }
     return MM_TRUE;
 }
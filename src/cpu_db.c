@@ -84,7 +84,8 @@ static const struct mm_cpu_entry cpu_table[] = {
             STM32H563_ETH_POLL,
             STM32H563_TIMER_INIT,
             STM32H563_TIMER_RESET,
-            STM32H563_TIMER_TICK
+            STM32H563_TIMER_TICK,
+            STM32H563_TIMER_NEXT_EVENT
         }
     },
     {
@@ -118,7 +119,8 @@ static const struct mm_cpu_entry cpu_table[] = {
             0,
             STM32U585_TIMER_INIT,
             STM32U585_TIMER_RESET,
-            STM32U585_TIMER_TICK
+            STM32U585_TIMER_TICK,
+            STM32U585_TIMER_NEXT_EVENT
         }
     },
     {
@@ -152,7 +154,8 @@ static const struct mm_cpu_entry cpu_table[] = {
             0,
             STM32L552_TIMER_INIT,
             STM32L552_TIMER_RESET,
-            STM32L552_TIMER_TICK
+            STM32L552_TIMER_TICK,
+            STM32L552_TIMER_NEXT_EVENT
         }
     },
     {
@@ -186,7 +189,8 @@ static const struct mm_cpu_entry cpu_table[] = {
             0,
             MCXW71C_TIMER_INIT,
             MCXW71C_TIMER_RESET,
-            MCXW71C_TIMER_TICK
+            MCXW71C_TIMER_TICK,
+            MCXW71C_TIMER_NEXT_EVENT
         }
     },
     {
@@ -220,7 +224,8 @@ static const struct mm_cpu_entry cpu_table[] = {
             0,
             NRF5340_TIMER_INIT,
             NRF5340_TIMER_RESET,
-            NRF5340_TIMER_TICK
+            NRF5340_TIMER_TICK,
+            NRF5340_TIMER_NEXT_EVENT
         }
     }
 };
@@ -0,0 +1,216 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/elfsym.h"
+
+#define ELF_SHT_SYMTAB 2u
+#define ELF_STT_FUNC 2u
+#define ELF_SHN_UNDEF 0u
+
+static mm_u32 rd16(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8);
+}
+
+static mm_u32 rd32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static mm_u8 *read_file(const char *path, size_t *len_out)
+{
+    FILE *f;
+    long sz;
+    mm_u8 *buf;
+    f = fopen(path, "rb");
+    if (f == 0) {
+        return 0;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (sz = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return 0;
+    }
+    buf = (mm_u8 *)malloc((size_t)sz);
+    if (buf == 0) {
+        fclose(f);
+        return 0;
+    }
+    if (fread(buf, 1, (size_t)sz, f) != (size_t)sz) {
+        free(buf);
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+    *len_out = (size_t)sz;
+    return buf;
+}
+
+static int sym_cmp(const void *a, const void *b)
+{
+    const struct mm_elfsym *sa = (const struct mm_elfsym *)a;
+    const struct mm_elfsym *sb = (const struct mm_elfsym *)b;
+    if (sa->addr != sb->addr) {
+        return (sa->addr < sb->addr) ? -1 : 1;
+    }
+    /* Prefer sized symbols so aliases with size 0 sort after them. */
+    if (sa->size != sb->size) {
+        return (sa->size > sb->size) ? -1 : 1;
+    }
+    return 0;
+}
+
+void mm_elfsym_init(struct mm_elfsym_table *t)
+{
+    if (t == 0) return;
+    memset(t, 0, sizeof(*t));
+}
+
+mm_bool mm_elfsym_load(struct mm_elfsym_table *t, const char *path)
+{
+    mm_u8 *img;
+    size_t len = 0;
+    mm_u32 shoff;
+    mm_u32 shentsize;
+    mm_u32 shnum;
+    mm_u32 i;
+    int out = 0;
+
+    if (t == 0 || path == 0) return MM_FALSE;
+    mm_elfsym_free(t);
+    img = read_file(path, &len);
+    if (img == 0) return MM_FALSE;
+    /* ELF32, little-endian. */
+    if (len < 52u || memcmp(img, "\177ELF", 4) != 0 || img[4] != 1u || img[5] != 1u) {
+        free(img);
+        return MM_FALSE;
+    }
+    shoff = rd32(img + 32);
+    shentsize = rd16(img + 46);
+    shnum = rd16(img + 48);
+    if (shentsize < 40u || shoff > len || (size_t)shnum * shentsize > len - shoff) {
+        free(img);
+        return MM_FALSE;
+    }
+    for (i = 0; i < shnum; ++i) {
+        const mm_u8 *sh = img + shoff + i * shentsize;
+        const mm_u8 *strsh;
+        mm_u32 sym_off;
+        mm_u32 sym_size;
+        mm_u32 sym_ent;
+        mm_u32 str_off;
+        mm_u32 str_size;
+        mm_u32 link;
+        mm_u32 n;
+        mm_u32 j;
+        struct mm_elfsym *syms;
+
+        if (rd32(sh + 4) != ELF_SHT_SYMTAB) continue;
+        sym_off = rd32(sh + 16);
+        sym_size = rd32(sh + 20);
+        link = rd32(sh + 24);
+        sym_ent = rd32(sh + 36);
+        if (sym_ent < 16u || link >= shnum || sym_off > len || sym_size > len - sym_off) break;
+        strsh = img + shoff + link * shentsize;
+        str_off = rd32(strsh + 16);
+        str_size = rd32(strsh + 20);
+        if (str_off > len || str_size > len - str_off || str_size == 0u) break;
+
+        t->strtab = (char *)malloc(str_size + 1u);
+        n = sym_size / sym_ent;
+        syms = (struct mm_elfsym *)malloc((size_t)(n ? n : 1u) * sizeof(*syms));
+        if (t->strtab == 0 || syms == 0) {
+            free(syms);
+            break;
+        }
+        memcpy(t->strtab, img + str_off, str_size);
+        t->strtab[str_size] = '\0';
+        for (j = 0; j < n; ++j) {
+            const mm_u8 *s = img + sym_off + j * sym_ent;
+            mm_u32 name = rd32(s);
+            mm_u32 value = rd32(s + 4);
+            mm_u32 size = rd32(s + 8);
+            mm_u8 info = s[12];
+            mm_u32 shndx = rd16(s + 14);
+            if ((info & 0x0fu) != ELF_STT_FUNC || shndx == ELF_SHN_UNDEF) continue;
+            if (name >= str_size || t->strtab[name] == '\0') continue;
+            syms[out].addr = value & ~1u;
+            syms[out].size = size;
+            syms[out].name = t->strtab + name;
+            out++;
+        }
+        qsort(syms, (size_t)out, sizeof(*syms), sym_cmp);
+        t->syms = syms;
+        t->count = out;
+        break;
+    }
+    free(img);
+    if (t->syms == 0) {
+        mm_elfsym_free(t);
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_elfsym_free(struct mm_elfsym_table *t)
+{
+    if (t == 0) return;
+    free(t->syms);
+    free(t->strtab);
+    memset(t, 0, sizeof(*t));
+}
+
+const struct mm_elfsym *mm_elfsym_lookup(const struct mm_elfsym_table *t, mm_u32 addr)
+{
+    int lo;
+    int hi;
+    const struct mm_elfsym *s;
+    if (t == 0 || t->count == 0) return 0;
+    addr &= ~1u;
+    lo = 0;
+    hi = t->count - 1;
+    if (addr < t->syms[0].addr) return 0;
+    /* Find the last symbol starting at or below addr. */
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (t->syms[mid].addr <= addr) lo = mid; else hi = mid - 1;
+    }
+    /* Step back to the first (sized) alias at this address. */
+    while (lo > 0 && t->syms[lo - 1].addr == t->syms[lo].addr) lo--;
+    s = &t->syms[lo];
+    if (s->size != 0u) {
+        return (addr - s->addr < s->size) ? s : 0;
+    }
+    return s;
+}
+
+const struct mm_elfsym *mm_elfsym_find(const struct mm_elfsym_table *t, const char *name)
+{
+    int i;
+    if (t == 0 || name == 0) return 0;
+    for (i = 0; i < t->count; ++i) {
+        if (strcmp(t->syms[i].name, name) == 0) return &t->syms[i];
+    }
+    return 0;
+}
@@ -26,6 +26,8 @@
 #include "m33mu/tz.h"
 #include "m33mu/target_hal.h"
 #include "m33mu/mem_prot.h"
+#include "m33mu/fpu.h"
+#include "m33mu/dsp.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -53,6 +55,7 @@ static mm_bool splim_trace_enabled(void)
 #define CCR_DIV_0_TRP (1u << 4)
 #define UFSR_DIVBYZERO (1u << 25)
 #define UFSR_STKOF (1u << 20)
+#define UFSR_NOCP (1u << 19)
 
 static mm_bool exec_set_active_sp(struct mm_cpu *cpu,
                                   struct mm_memmap *map,
@@ -230,6 +233,37 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                         case MM_OP_ISB:
                             /* Barriers are modeled as no-ops for now. */
                             break;
+                        case MM_OP_VLDR: case MM_OP_VSTR: case MM_OP_VLDM: case MM_OP_VSTM:
+                        case MM_OP_VMOV_CR: case MM_OP_VMOV_CR2: case MM_OP_VMRS: case MM_OP_VMSR:
+                        case MM_OP_VMOV_IMM: case MM_OP_VMOV_REG: case MM_OP_VABS: case MM_OP_VNEG:
+                        case MM_OP_VSQRT: case MM_OP_VADD: case MM_OP_VSUB: case MM_OP_VMUL:
+                        case MM_OP_VNMUL: case MM_OP_VDIV: case MM_OP_VMLA: case MM_OP_VMLS:
+                        case MM_OP_VNMLA: case MM_OP_VNMLS: case MM_OP_VFMA: case MM_OP_VFMS:
+                        case MM_OP_VFNMA: case MM_OP_VFNMS: case MM_OP_VCMP: case MM_OP_VCVT_F32_INT:
+                        case MM_OP_VCVT_INT_F32: case MM_OP_VCVT_FIXED: case MM_OP_VCVT_HALF: case MM_OP_VRINT:
+                        case MM_OP_VCVT_RM: case MM_OP_VSEL: case MM_OP_VMAXNM: case MM_OP_VMINNM: {
+                            enum mm_fpu_status st;
+                            mm_u32 fault_addr = 0;
+                            st = mm_fpu_execute(&cpu, &map, &d, f.pc_fetch, &fault_addr);
+                            if (st == MM_FPU_NOCP || st == MM_FPU_UNDEFINED) {
+                                if (!raise_usage_fault(&cpu, &map, &scs, f.pc_fetch, cpu.xpsr,
+                                                       (st == MM_FPU_NOCP) ? UFSR_NOCP : (1u << 16))) done = MM_TRUE;
+                                return MM_EXEC_CONTINUE;
+                            }
+                            if (st == MM_FPU_MEM_FAULT) {
+                                if (!raise_mem_fault(&cpu, &map, &scs, f.pc_fetch, cpu.xpsr, fault_addr, MM_FALSE)) done = MM_TRUE;
+                                return MM_EXEC_CONTINUE;
+                            }
+                            /* VLDM/VSTM (incl. VPUSH/VPOP) base writeback, W = bit 21. */
+                            if ((d.kind == MM_OP_VLDM || d.kind == MM_OP_VSTM) && ((d.raw >> 21) & 1u) != 0u) {
+                                mm_u32 nb = ((d.raw >> 23) & 1u) ? (cpu.r[d.rn] + d.imm) : (cpu.r[d.rn] - d.imm);
+                                if (d.rn == 13u) {
+                                    EXEC_SET_SP(nb);
+                                } else {
+                                    cpu.r[d.rn] = nb;
+                                }
+                            }
+                        } break;
                         case MM_OP_B_UNCOND:
                         case MM_OP_B_UNCOND_WIDE:
                             cpu.r[15] = (f.pc_fetch + 4u + d.imm) | 1u;
@@ -300,6 +334,7 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                                                cpu.tz_depth--;
                                                cpu.sec_state = cpu.tz_ret_sec[cpu.tz_depth];
                                                cpu.mode = cpu.tz_ret_mode[cpu.tz_depth];
+                                               mm_cpu_sp_rebank(&cpu);
                                                cpu.r[15] = cpu.tz_ret_pc[cpu.tz_depth] | 1u;
                                                cpu.r[14] = cpu.tz_ret_pc[cpu.tz_depth] | 1u;
                                                EXEC_SET_SP(mm_cpu_get_active_sp(&cpu));
@@ -1024,15 +1059,14 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                                             mm_u32 prod = cpu.r[d.rn] * cpu.r[d.rm];
                                             cpu.r[d.rd] = prod + cpu.r[d.ra];
                                         } break;
-                        case MM_OP_SMLA: {
-                                            mm_u32 rn_val = cpu.r[d.rn];
-                                            mm_u32 rm_val = cpu.r[d.rm];
-                                            mm_i32 rn_half = (mm_i16)(((d.imm & 0x2u) != 0u) ? (rn_val >> 16) : (rn_val & 0xffffu));
-                                            mm_i32 rm_half = (mm_i16)(((d.imm & 0x1u) != 0u) ? (rm_val >> 16) : (rm_val & 0xffffu));
-                                            mm_i32 prod = rn_half * rm_half;
-                                            mm_i32 acc = prod + (mm_i32)cpu.r[d.ra];
-                                            cpu.r[d.rd] = (mm_u32)acc;
-                                        } break;
+                        case MM_OP_SMLA:
+                        case MM_OP_PAS: case MM_OP_QADDSUB: case MM_OP_SEL:
+                        case MM_OP_SSAT: case MM_OP_USAT: case MM_OP_SSAT16: case MM_OP_USAT16:
+                        case MM_OP_PKH: case MM_OP_SXTB16: case MM_OP_UXTB16:
+                        case MM_OP_SMLAD: case MM_OP_SMLALD: case MM_OP_SMLAW: case MM_OP_SMMLA:
+                        case MM_OP_SMLAL_XY: case MM_OP_USAD8:
+                            (void)mm_dsp_execute(&cpu, &d);
+                            break;
                         case MM_OP_MLS: {
                                             mm_u32 prod = cpu.r[d.rn] * cpu.r[d.rm];
                                             cpu.r[d.rd] = cpu.r[d.ra] - prod;
@@ -1140,6 +1174,7 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                                                 break;
                                             }
                                             switch (sysm) {
+                                                case 0x00: val = cpu.xpsr & 0xf80f0000u; break; /* APSR: NZCVQ, GE */
                                                 case 0x08: val = mm_cpu_get_active_sp(&cpu); break; /* MSP */
                                                 case 0x09: val = (cpu.sec_state == MM_NONSECURE) ? cpu.psp_ns : cpu.psp_s; break; /* PSP */
                                                 case 0x0a: val = (cpu.sec_state == MM_NONSECURE) ? cpu.msplim_ns : cpu.msplim_s; break; /* MSPLIM */
@@ -1217,12 +1252,17 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                                                     default:
                                                         break;
                                                 }
+                                                /* New SP, limit or SPSEL: refresh the active bank. */
+                                                mm_cpu_sp_rebank(&cpu);
                                             } else if (sysm == 0x00u) {
                                                 /* APSR field write: honor NZCVQ group when selected.
                                                  * Only these bits are writable; IT/T/exception number remain unchanged. */
                                                 if ((mask & 8u) != 0u) {
                                                     cpu.xpsr = mm_xpsr_write_nzcvq(cpu.xpsr, val);
                                                 }
+                                                if ((mask & 4u) != 0u) {
+                                                    cpu.xpsr = (cpu.xpsr & ~MM_XPSR_GE_MASK) | (val & MM_XPSR_GE_MASK);
+                                                }
                                             }
                                             /* MSR does not affect PC; fall through with normal PC increment. */
                                         } break;
@@ -1454,6 +1494,14 @@ enum mm_exec_status mm_execute_decoded(struct mm_execute_ctx *ctx)
                                                 if (vflag) cpu.xpsr |= (1u << 28);
                                             } break;
                         case MM_OP_BKPT:
+                                            if (d.imm == MM_SEMIHOST_BKPT_IMM &&
+                                                ctx->semihost != 0 && ctx->semihost->enabled) {
+                                                mm_semihost_call(ctx->semihost, &cpu, &map);
+                                                if (ctx->semihost->exit_requested) {
+                                                    done = MM_TRUE;
+                                                }
+                                                break;
+                                            }
                                             if (opt_gdb) {
                                                 mm_gdb_stub_notify_stop(&gdb, 5);
                                             } else {
@@ -0,0 +1,151 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <string.h>
+#include "m33mu/fuse.h"
+
+void mm_fuse_init(struct mm_fuse *fu, mm_bool enabled)
+{
+    memset(fu, 0, sizeof(*fu));
+    fu->enabled = enabled;
+}
+
+static mm_bool is_cond_branch(const struct mm_decoded *d)
+{
+    return d->kind == MM_OP_B_COND || d->kind == MM_OP_B_COND_WIDE;
+}
+
+enum mm_fuse_kind mm_fuse_classify(const struct mm_decoded *first, const struct mm_decoded *next)
+{
+    if (first == 0 || next == 0 || first->undefined || next->undefined || next->len == 0u) {
+        return MM_FUSE_NONE;
+    }
+    switch (first->kind) {
+    case MM_OP_MOVW:
+        if (next->kind == MM_OP_MOVT && next->rd == first->rd && first->rd < 13u) {
+            return MM_FUSE_MOVW_MOVT;
+        }
+        break;
+    case MM_OP_CMP_IMM:
+    case MM_OP_CMP_REG:
+        if (is_cond_branch(next)) {
+            return MM_FUSE_CMP_BCC;
+        }
+        break;
+    case MM_OP_IT:
+        /* Mask 0b1000: the block holds exactly one instruction. */
+        if ((first->imm & 0x0fu) == 0x8u && next->kind != MM_OP_IT) {
+            return MM_FUSE_IT_OP;
+        }
+        break;
+    case MM_OP_LDR_IMM:
+    case MM_OP_LDR_REG:
+        if (first->rd < 13u && (next->kind == MM_OP_ADD_IMM || next->kind == MM_OP_ADD_REG) &&
+            next->rd < 13u) {
+            return MM_FUSE_LDR_ADDS;
+        }
+        break;
+    case MM_OP_SUB_IMM:
+        if (first->rd < 13u && is_cond_branch(next) && next->cond == MM_COND_NE) {
+            return MM_FUSE_SUBS_BNE;
+        }
+        break;
+    default:
+        break;
+    }
+    return MM_FUSE_NONE;
+}
+
+enum mm_fuse_kind mm_fuse_pair_at(const struct mm_decoded *first, const struct mm_predecode *pd,
+                                  mm_u32 next_pc)
+{
+    switch (first->kind) {
+    case MM_OP_MOVW:
+    case MM_OP_CMP_IMM:
+    case MM_OP_CMP_REG:
+    case MM_OP_IT:
+    case MM_OP_LDR_IMM:
+    case MM_OP_LDR_REG:
+    case MM_OP_SUB_IMM:
+        return mm_fuse_classify(first, mm_predecode_peek(pd, next_pc));
+    default:
+        return MM_FUSE_NONE;
+    }
+}
+
+mm_bool mm_fuse_can_direct(enum mm_fuse_kind kind, const struct mm_memmap *map,
+                           const struct mm_decoded *next, mm_u32 first_pc, mm_u32 next_pc)
+{
+    const mm_u8 *p;
+    mm_u32 raw;
+    if (kind != MM_FUSE_MOVW_MOVT && kind != MM_FUSE_CMP_BCC && kind != MM_FUSE_SUBS_BNE) {
+        return MM_FALSE;
+    }
+    if (((first_pc ^ (next_pc + next->len - 1u)) & ~(MM_MEMMAP_PROT_GRANULE - 1u)) != 0u) {
+        return MM_FALSE;
+    }
+    p = mm_memmap_host_read_ptr(map, next_pc, next->len);
+    if (p == 0) {
+        return MM_FALSE;
+    }
+    raw = (mm_u32)p[0] | ((mm_u32)p[1] << 8);
+    if (next->len == 4u) {
+        raw = (raw << 16) | (mm_u32)p[2] | ((mm_u32)p[3] << 8);
+    }
+    return raw == next->raw;
+}
+
+static mm_bool cond_passed(mm_u32 xpsr, enum mm_cond cond)
+{
+    mm_bool n = (xpsr & (1u << 31)) != 0u;
+    mm_bool z = (xpsr & (1u << 30)) != 0u;
+    mm_bool c = (xpsr & (1u << 29)) != 0u;
+    mm_bool v = (xpsr & (1u << 28)) != 0u;
+    switch (cond) {
+        case MM_COND_EQ: return z;
+        case MM_COND_NE: return !z;
+        case MM_COND_CS: return c;
+        case MM_COND_CC: return !c;
+        case MM_COND_MI: return n;
+        case MM_COND_PL: return !n;
+        case MM_COND_VS: return v;
+        case MM_COND_VC: return !v;
+        case MM_COND_HI: return c && !z;
+        case MM_COND_LS: return !c || z;
+        case MM_COND_GE: return n == v;
+        case MM_COND_LT: return n != v;
+        case MM_COND_GT: return !z && (n == v);
+        case MM_COND_LE: return z || (n != v);
+        case MM_COND_AL: return MM_TRUE;
+        default: return MM_FALSE;
+    }
+}
+
+void mm_fuse_exec_direct(struct mm_cpu *cpu, const struct mm_decoded *next, mm_u32 next_pc)
+{
+    cpu->r[15] = (next_pc + next->len) | 1u;
+    if (next->kind == MM_OP_MOVT) {
+        cpu->r[next->rd] = (cpu->r[next->rd] & 0x0000ffffu) | ((next->imm & 0xffffu) << 16);
+    } else if (cond_passed(cpu->xpsr, next->cond)) {
+        cpu->r[15] = (next_pc + 4u + next->imm) | 1u;
+    }
+}
@@ -23,6 +23,7 @@
 #include "m33mu/gdbstub.h"
 #include "m33mu/fetch.h"
 #include "m33mu/capstone.h"
+#include "m33mu/hostwait.h"
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -35,6 +36,14 @@
 
 #define GDB_BUF_SIZE 1024
 #define GDB_REG_COUNT 25
+/* Largest packet accepted from the client; advertised as PacketSize. */
+#define GDB_PACKET_SIZE 0x10000u
+
+/* Packet buffers are too large for the stack; the stub is single-threaded. */
+static char g_pkt_buf[GDB_PACKET_SIZE + 1u];
+static char g_tx_frame[GDB_PACKET_SIZE * 2u + 8u];
+static char g_reply_buf[GDB_PACKET_SIZE + 1u];
+static mm_u8 g_mem_buf[GDB_PACKET_SIZE];
 
 static int hex_to_nibble(int c)
 {
@@ -113,23 +122,51 @@ static int parse_hex_u32(const char *s, size_t len, mm_u32 *out)
     return 0;
 }
 
-static void gdb_send_packet(int fd, const char *payload)
+static void gdb_write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0u) {
+        ssize_t w = write(fd, buf, len);
+        if (w <= 0) {
+            return;
+        }
+        buf += (size_t)w;
+        len -= (size_t)w;
+    }
+}
+
+/* Frame and send a payload, escaping bytes that collide with RSP framing
+ * so binary replies (x packets) survive the trip. */
+static void gdb_send_packet_bin(int fd, const char *payload, size_t len)
 {
     unsigned char csum = 0;
-    char buf[GDB_BUF_SIZE];
-    size_t len = strlen(payload);
     size_t i;
     size_t pos = 0;
 
-    buf[pos++] = '$';
-    for (i = 0; i < len && pos < sizeof(buf) - 4; ++i) {
-        buf[pos++] = payload[i];
-        csum += (unsigned char)payload[i];
-    }
-    buf[pos++] = '#';
-    buf[pos++] = nibble_to_hex((mm_u8)((csum >> 4) & 0x0fu));
-    buf[pos++] = nibble_to_hex((mm_u8)(csum & 0x0fu));
-    (void)write(fd, buf, pos);
+    if (len > GDB_PACKET_SIZE) {
+        fprintf(stderr, "[GDB] reply truncated from %lu to %lu bytes\n",
+                (unsigned long)len, (unsigned long)GDB_PACKET_SIZE);
+        len = GDB_PACKET_SIZE;
+    }
+    g_tx_frame[pos++] = '$';
+    for (i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)payload[i];
+        if (c == '$' || c == '#' || c == '}' || c == '*') {
+            g_tx_frame[pos++] = '}';
+            csum += (unsigned char)'}';
+            c ^= 0x20u;
+        }
+        g_tx_frame[pos++] = (char)c;
+        csum += c;
+    }
+    g_tx_frame[pos++] = '#';
+    g_tx_frame[pos++] = nibble_to_hex((mm_u8)((csum >> 4) & 0x0fu));
+    g_tx_frame[pos++] = nibble_to_hex((mm_u8)(csum & 0x0fu));
+    gdb_write_all(fd, g_tx_frame, pos);
+}
+
+static void gdb_send_packet(int fd, const char *payload)
+{
+    gdb_send_packet_bin(fd, payload, strlen(payload));
 }
 
 static void gdb_send_console(struct mm_gdb_stub *stub, const char *msg)
@@ -159,6 +196,10 @@ void mm_gdb_stub_init(struct mm_gdb_stub *stub)
 {
     stub->listen_fd = -1;
     stub->client_fd = -1;
+    stub->rx_len = 0;
+    stub->rx_pos = 0;
+    stub->rx_oversized = 0;
+    stub->no_ack = MM_FALSE;
     stub->connected = MM_FALSE;
     stub->to_interrupt = MM_FALSE;
     stub->running = MM_FALSE;
@@ -166,14 +207,7 @@ void mm_gdb_stub_init(struct mm_gdb_stub *stub)
     stub->alive = MM_TRUE;
     stub->request_reset = MM_FALSE;
     stub->request_quit = MM_FALSE;
-    {
-        size_t i;
-        for (i = 0; i < sizeof(stub->breakpoints) / sizeof(stub->breakpoints[0]); ++i) {
-            stub->breakpoints[i].valid = MM_FALSE;
-            stub->breakpoints[i].len = 0;
-            stub->breakpoints[i].addr = 0;
-        }
-    }
+    mm_bp_set_init(&stub->breakpoints);
     stub->rearm_valid = MM_FALSE;
     stub->rearm_addr = 0;
     stub->exec_path[0] = '\0';
@@ -254,6 +288,8 @@ mm_bool mm_gdb_stub_start(struct mm_gdb_stub *stub, int port)
         return MM_FALSE;
     }
     stub->listen_fd = fd;
+    mm_hostwait_watch(&stub->listen_fd);
+    mm_hostwait_watch(&stub->client_fd);
     return MM_TRUE;
 }
 
@@ -273,6 +309,9 @@ mm_bool mm_gdb_stub_wait_client(struct mm_gdb_stub *stub)
         return MM_FALSE;
     }
     stub->client_fd = cfd;
+    stub->rx_len = 0;
+    stub->rx_pos = 0;
+    stub->no_ack = MM_FALSE;
     stub->connected = MM_TRUE;
     stub->running = MM_FALSE;
     stub->step_pending = MM_FALSE;
@@ -303,8 +342,15 @@ void mm_gdb_stub_close(struct mm_gdb_stub *stub)
         close(stub->listen_fd);
         stub->listen_fd = -1;
     }
+    mm_hostwait_unwatch(&stub->listen_fd);
+    mm_hostwait_unwatch(&stub->client_fd);
     stub->connected = MM_FALSE;
     stub->running = MM_FALSE;
+    stub->rx_len = 0;
+    stub->rx_pos = 0;
+    stub->no_ack = MM_FALSE;
+    mm_bp_set_free(&stub->breakpoints);
+    stub->rearm_valid = MM_FALSE;
 }
 
 static void gdb_send_ok(struct mm_gdb_stub *stub)
@@ -365,10 +411,35 @@ static size_t gdb_encode_registers(struct mm_cpu *cpu, char *out, size_t out_cap
 
 static mm_bool gdb_read_bytes(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u8 *dst, size_t len)
 {
+    enum mm_sec_state alt = (sec == MM_SECURE) ? MM_NONSECURE : MM_SECURE;
+    const mm_u8 *src;
     size_t i;
+
+    if (len == 0u) {
+        return MM_TRUE;
+    }
+    /* Flash/RAM fast path: resolve the host pointer once for the whole
+     * range, check permissions per protection granule, then copy. */
+    src = mm_memmap_host_read_ptr(map, addr, (mm_u32)len);
+    if (src != 0) {
+        size_t done = 0;
+        while (done < len) {
+            mm_u32 a = addr + (mm_u32)done;
+            size_t chunk = MM_MEMMAP_PROT_GRANULE - (a & (MM_MEMMAP_PROT_GRANULE - 1u));
+            if (chunk > len - done) {
+                chunk = len - done;
+            }
+            if (!mm_memmap_access_ok(map, MM_ACCESS_READ, sec, a, (mm_u32)chunk) &&
+                !mm_memmap_access_ok(map, MM_ACCESS_READ, alt, a, (mm_u32)chunk)) {
+                return MM_FALSE;
+            }
+            done += chunk;
+        }
+        memcpy(dst, src, len);
+        return MM_TRUE;
+    }
     for (i = 0; i < len; ++i) {
         if (!mm_memmap_read8(map, sec, addr + (mm_u32)i, &dst[i])) {
-            enum mm_sec_state alt = (sec == MM_SECURE) ? MM_NONSECURE : MM_SECURE;
             if (!mm_memmap_read8(map, alt, addr + (mm_u32)i, &dst[i])) {
                 return MM_FALSE;
             }
@@ -403,14 +474,12 @@ static mm_bool gdb_write_bytes(struct mm_memmap *map, enum mm_sec_state sec, mm_
         }
         if (addr >= base && (addr - base) + len <= size) {
             buf = (mm_u8 *)map->ram.buffer;
-            for (i = 0; i < len; ++i) {
-                buf[addr - base + i] = src[i];
-            }
+            memcpy(buf + (addr - base), src, len);
             return MM_TRUE;
         }
     }
 
-    /* Flash patching for breakpoints */
+    /* Direct flash writes (e.g. GDB `load`) */
     if (map->flash.buffer != 0) {
         if (sec == MM_NONSECURE) {
             base = map->flash_base_ns;
@@ -425,9 +494,7 @@ static mm_bool gdb_write_bytes(struct mm_memmap *map, enum mm_sec_state sec, mm_
         }
         if (addr >= base && (addr - base) + len <= size) {
             buf = (mm_u8 *)map->flash.buffer;
-            for (i = 0; i < len; ++i) {
-                buf[addr - base + i] = src[i];
-            }
+            memcpy(buf + (addr - base), src, len);
             return MM_TRUE;
         }
     }
@@ -443,179 +510,142 @@ static mm_bool gdb_write_bytes(struct mm_memmap *map, enum mm_sec_state sec, mm_
     return MM_TRUE;
 }
 
+static mm_bool gdb_parse_addr_len(const char *s, mm_u32 *addr_out, mm_u32 *len_out)
+{
+    unsigned long taddr = 0;
+    unsigned long tlen = 0;
+    if (sscanf(s, "%lx,%lx", &taddr, &tlen) != 2) {
+        return MM_FALSE;
+    }
+    *addr_out = (mm_u32)taddr;
+    *len_out = (mm_u32)tlen;
+    return MM_TRUE;
+}
+
+/* 'm' (hex) and 'x' (binary) memory reads. */
 static void gdb_handle_memory_read(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_memmap *map, const char *payload)
 {
-    char buf[GDB_BUF_SIZE];
     mm_u32 addr = 0;
     mm_u32 len = 0;
+    mm_bool binary = (payload[0] == 'x') ? MM_TRUE : MM_FALSE;
     size_t i;
-    unsigned long taddr = 0;
-    unsigned long tlen = 0;
 
-    if (sscanf(payload + 1, "%lx,%lx", &taddr, &tlen) != 2) {
+    if (!gdb_parse_addr_len(payload + 1, &addr, &len)) {
         gdb_send_error(stub, 1);
         return;
     }
-    addr = (mm_u32)taddr;
-    len = (mm_u32)tlen;
-    printf("[GDB] mem read addr=0x%08lx len=%lu\n", (unsigned long)addr, (unsigned long)len);
-    if (len * 2u + 4u >= sizeof(buf)) {
-        len = (mm_u32)((sizeof(buf) - 4u) / 2u);
+    if (binary) {
+        if (len > GDB_PACKET_SIZE - 1u) {
+            len = GDB_PACKET_SIZE - 1u;
+        }
+    } else if (len > (GDB_PACKET_SIZE - 4u) / 2u) {
+        len = (GDB_PACKET_SIZE - 4u) / 2u;
     }
-    if (!gdb_read_bytes(map, cpu->sec_state, addr, (mm_u8 *)buf, len)) {
+    if (!gdb_read_bytes(map, cpu->sec_state, addr, g_mem_buf, len)) {
         gdb_send_error(stub, 2);
         return;
     }
-    {
-        char hexbuf[GDB_BUF_SIZE];
-        for (i = 0; i < len; ++i) {
-            mm_u8 v = (mm_u8)buf[i];
-            hexbuf[i * 2u] = nibble_to_hex((mm_u8)(v >> 4));
-            hexbuf[i * 2u + 1u] = nibble_to_hex((mm_u8)(v & 0x0f));
-        }
-        hexbuf[len * 2u] = '\0';
-        gdb_send_packet(stub->client_fd, hexbuf);
+    if (binary) {
+        g_reply_buf[0] = 'b';
+        memcpy(g_reply_buf + 1, g_mem_buf, len);
+        gdb_send_packet_bin(stub->client_fd, g_reply_buf, (size_t)len + 1u);
+        return;
     }
+    for (i = 0; i < len; ++i) {
+        mm_u8 v = g_mem_buf[i];
+        g_reply_buf[i * 2u] = nibble_to_hex((mm_u8)(v >> 4));
+        g_reply_buf[i * 2u + 1u] = nibble_to_hex((mm_u8)(v & 0x0f));
+    }
+    gdb_send_packet_bin(stub->client_fd, g_reply_buf, (size_t)len * 2u);
 }
 
-static void gdb_handle_memory_write(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_memmap *map, const char *payload)
+/* 'M' (hex) and 'X' (binary) memory writes. */
+static void gdb_handle_memory_write(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_memmap *map, const char *payload, size_t pkt_len)
 {
     mm_u32 addr = 0;
     mm_u32 len = 0;
     const char *data;
+    size_t avail;
     size_t i;
-    mm_u8 bytes[256];
-    unsigned long taddr = 0;
-    unsigned long tlen = 0;
 
-    data = strchr(payload, ':');
-    if (data == 0) {
+    data = memchr(payload, ':', pkt_len);
+    if (data == 0 || !gdb_parse_addr_len(payload + 1, &addr, &len)) {
         gdb_send_error(stub, 1);
         return;
     }
-    if (sscanf(payload, "M%lx,%lx", &taddr, &tlen) != 2) {
-        gdb_send_error(stub, 1);
-        return;
-    }
-    addr = (mm_u32)taddr;
-    len = (mm_u32)tlen;
-    printf("[GDB] mem write addr=0x%08lx len=%lu\n", (unsigned long)addr, (unsigned long)len);
     data += 1; /* skip ':' */
-    if (len > (mm_u32)(sizeof(bytes))) {
-        len = (mm_u32)sizeof(bytes);
-    }
-    for (i = 0; i < len; ++i) {
-        int h1;
-        int h2;
-        h1 = hex_to_nibble(data[i * 2u]);
-        h2 = hex_to_nibble(data[i * 2u + 1u]);
-        if (h1 < 0 || h2 < 0) {
+    avail = pkt_len - (size_t)(data - payload);
+    if (payload[0] == 'X') {
+        if (len > avail) {
             gdb_send_error(stub, 1);
             return;
         }
-        bytes[i] = (mm_u8)((h1 << 4) | h2);
+        memcpy(g_mem_buf, data, len);
+    } else {
+        if ((size_t)len * 2u > avail) {
+            gdb_send_error(stub, 1);
+            return;
+        }
+        for (i = 0; i < len; ++i) {
+            int h1 = hex_to_nibble(data[i * 2u]);
+            int h2 = hex_to_nibble(data[i * 2u + 1u]);
+            if (h1 < 0 || h2 < 0) {
+                gdb_send_error(stub, 1);
+                return;
+            }
+            g_mem_buf[i] = (mm_u8)((h1 << 4) | h2);
+        }
     }
-    if (!gdb_write_bytes(map, cpu->sec_state, addr, bytes, len)) {
+    if (len > 0u && !gdb_write_bytes(map, cpu->sec_state, addr, g_mem_buf, len)) {
         gdb_send_error(stub, 3);
         return;
     }
     gdb_send_ok(stub);
 }
 
-static mm_bool gdb_fetch_hw1(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u16 *out_hw)
+static mm_bool gdb_install_breakpoint(struct mm_gdb_stub *stub, mm_u32 addr)
 {
-    mm_u8 b0;
-    mm_u8 b1;
-    if (!mm_memmap_read8(map, sec, addr, &b0)) {
-        enum mm_sec_state alt = (sec == MM_SECURE) ? MM_NONSECURE : MM_SECURE;
-        if (!mm_memmap_read8(map, alt, addr, &b0)) {
-            return MM_FALSE;
-        }
-    }
-    if (!mm_memmap_read8(map, sec, addr + 1u, &b1)) {
-        enum mm_sec_state alt = (sec == MM_SECURE) ? MM_NONSECURE : MM_SECURE;
-        if (!mm_memmap_read8(map, alt, addr + 1u, &b1)) {
-            return MM_FALSE;
-        }
+    mm_u32 pc = (addr & ~1u) | 1u;
+    if (!mm_bp_set_add(&stub->breakpoints, pc)) {
+        return MM_FALSE;
     }
-    *out_hw = (mm_u16)(b0 | ((mm_u16)b1 << 8));
+    printf("[GDB] Breakpoint set at 0x%08lx\n", (unsigned long)pc);
     return MM_TRUE;
 }
 
-static mm_bool gdb_install_breakpoint(struct mm_gdb_stub *stub, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr)
+static mm_bool gdb_remove_breakpoint(struct mm_gdb_stub *stub, mm_u32 addr)
 {
-    size_t i;
-    mm_u32 even_addr = addr & ~1u;
-    mm_u16 hw1;
-    mm_u8 len = 2;
-    mm_u8 patch[4];
-    mm_u8 orig[4];
-
-    for (i = 0; i < sizeof(stub->breakpoints) / sizeof(stub->breakpoints[0]); ++i) {
-        if (stub->breakpoints[i].valid && stub->breakpoints[i].addr == even_addr) {
-            return MM_TRUE;
-        }
-    }
-
-    if (!gdb_fetch_hw1(map, sec, even_addr, &hw1)) {
-        return MM_FALSE;
-    }
-    if (t32_is_32bit_prefix(hw1)) {
-        len = 4;
-    }
-    if (!gdb_read_bytes(map, sec, even_addr, orig, len)) {
-        return MM_FALSE;
-    }
-
-    patch[0] = 0x00;
-    patch[1] = 0xBE;
-    patch[2] = 0x00;
-    patch[3] = 0xBE;
-
-    if (!gdb_write_bytes(map, sec, even_addr, patch, len)) {
+    mm_u32 pc = (addr & ~1u) | 1u;
+    if (!mm_bp_set_remove(&stub->breakpoints, pc)) {
         return MM_FALSE;
     }
-    printf("[GDB] Breakpoint set at 0x%08lx len=%u\n", (unsigned long)(even_addr | 1u), (unsigned)len);
-
-    for (i = 0; i < sizeof(stub->breakpoints) / sizeof(stub->breakpoints[0]); ++i) {
-        if (!stub->breakpoints[i].valid) {
-            stub->breakpoints[i].valid = MM_TRUE;
-            stub->breakpoints[i].addr = even_addr | 1u;
-            stub->breakpoints[i].len = len;
-            memcpy(stub->breakpoints[i].orig, orig, len);
-            return MM_TRUE;
-        }
+    if (stub->rearm_valid && stub->rearm_addr == pc) {
+        stub->rearm_valid = MM_FALSE;
     }
-    return MM_FALSE;
+    printf("[GDB] Breakpoint cleared at 0x%08lx\n", (unsigned long)pc);
+    return MM_TRUE;
 }
 
-static mm_bool gdb_remove_breakpoint(struct mm_gdb_stub *stub, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr)
+/* Resuming from a PC that holds a breakpoint must execute that instruction
+ * once before the breakpoint can trigger again. */
+static void gdb_resume_from(struct mm_gdb_stub *stub, mm_u32 pc)
 {
-    size_t i;
-    mm_u32 even_addr = addr & ~1u;
-    for (i = 0; i < sizeof(stub->breakpoints) / sizeof(stub->breakpoints[0]); ++i) {
-        if (stub->breakpoints[i].valid && stub->breakpoints[i].addr == (even_addr | 1u)) {
-            if (!gdb_write_bytes(map, sec, even_addr, stub->breakpoints[i].orig, stub->breakpoints[i].len)) {
-                return MM_FALSE;
-            }
-            stub->breakpoints[i].valid = MM_FALSE;
-            stub->breakpoints[i].len = 0;
-            printf("[GDB] Breakpoint cleared at 0x%08lx\n", (unsigned long)(even_addr | 1u));
-            return MM_TRUE;
-        }
+    stub->rearm_valid = MM_FALSE;
+    if (mm_bp_set_lookup(&stub->breakpoints, pc)) {
+        stub->rearm_valid = MM_TRUE;
+        stub->rearm_addr = pc | 1u;
     }
-    return MM_FALSE;
 }
 
 mm_bool mm_gdb_stub_breakpoint_hit(const struct mm_gdb_stub *stub, mm_u32 pc)
 {
-    size_t i;
-    for (i = 0; i < sizeof(stub->breakpoints) / sizeof(stub->breakpoints[0]); ++i) {
-        if (stub->breakpoints[i].valid && stub->breakpoints[i].addr == (pc | 1u)) {
-            return MM_TRUE;
-        }
+    if (!mm_bp_set_lookup(&stub->breakpoints, pc)) {
+        return MM_FALSE;
     }
-    return MM_FALSE;
+    if (stub->rearm_valid && stub->rearm_addr == (pc | 1u)) {
+        return MM_FALSE;
+    }
+    return MM_TRUE;
 }
 
 mm_bool mm_gdb_stub_should_run(const struct mm_gdb_stub *stub)
@@ -628,7 +658,7 @@ mm_bool mm_gdb_stub_should_step(const struct mm_gdb_stub *stub)
     return stub->step_pending;
 }
 
-void mm_gdb_stub_maybe_rearm(struct mm_gdb_stub *stub, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 pc)
+void mm_gdb_stub_maybe_rearm(struct mm_gdb_stub *stub, mm_u32 pc)
 {
     if (stub == 0 || !stub->rearm_valid) {
         return;
@@ -636,10 +666,7 @@ void mm_gdb_stub_maybe_rearm(struct mm_gdb_stub *stub, struct mm_memmap *map, en
     if ((pc | 1u) == stub->rearm_addr) {
         return;
     }
-    if (gdb_install_breakpoint(stub, map, sec, stub->rearm_addr)) {
-        stub->rearm_valid = MM_FALSE;
-        printf("[GDB] Breakpoint rearmed at 0x%08lx\n", (unsigned long)stub->rearm_addr);
-    }
+    stub->rearm_valid = MM_FALSE;
 }
 
 static const char target_xml[] =
@@ -676,22 +703,37 @@ static const char target_xml[] =
 "</feature>"
 "</target>";
 
-static mm_bool gdb_recv_packet(struct mm_gdb_stub *stub, char *out, size_t out_cap)
+/* Buffered byte reader: one read(2) per socket chunk instead of per byte. */
+static mm_bool gdb_getc(struct mm_gdb_stub *stub, char *ch)
+{
+    if (stub->rx_pos >= stub->rx_len) {
+        ssize_t r = read(stub->client_fd, stub->rx_buf, sizeof(stub->rx_buf));
+        if (r <= 0) {
+            mm_gdb_stub_close(stub);
+            return MM_FALSE;
+        }
+        stub->rx_len = (size_t)r;
+        stub->rx_pos = 0;
+    }
+    *ch = (char)stub->rx_buf[stub->rx_pos++];
+    return MM_TRUE;
+}
+
+static mm_bool gdb_recv_packet(struct mm_gdb_stub *stub, char *out, size_t out_cap, size_t *len_out)
 {
     char ch;
     unsigned char sum = 0;
     unsigned char expect = 0;
     size_t len = 0;
-    ssize_t r;
+    size_t overflow = 0;
+    mm_bool escape = MM_FALSE;
 
     if (stub->client_fd < 0) {
         return MM_FALSE;
     }
-    /* Wait for '$' */
+    /* Wait for '$' (acks and stray bytes are skipped) */
     do {
-        r = read(stub->client_fd, &ch, 1);
-        if (r <= 0) {
-            mm_gdb_stub_close(stub);
+        if (!gdb_getc(stub, &ch)) {
             return MM_FALSE;
         }
         if (ch == 0x03) {
@@ -701,39 +743,56 @@ static mm_bool gdb_recv_packet(struct mm_gdb_stub *stub, char *out, size_t out_c
     } while (ch != '$');
 
     while (1) {
-        r = read(stub->client_fd, &ch, 1);
-        if (r <= 0) {
-            mm_gdb_stub_close(stub);
-            return MM_FALSE;
-        }
-        if (ch == 0x03) {
-            stub->to_interrupt = MM_TRUE;
+        if (!gdb_getc(stub, &ch)) {
             return MM_FALSE;
         }
         if (ch == '#') {
             break;
         }
+        sum += (unsigned char)ch;
+        if (escape) {
+            ch = (char)((unsigned char)ch ^ 0x20u);
+            escape = MM_FALSE;
+        } else if (ch == '}') {
+            escape = MM_TRUE;
+            continue;
+        }
         if (len + 1u < out_cap) {
             out[len++] = ch;
+        } else {
+            overflow++;
         }
-        sum += (unsigned char)ch;
     }
     out[len] = '\0';
-    if (read(stub->client_fd, &ch, 1) <= 0) {
-        mm_gdb_stub_close(stub);
+    if (!gdb_getc(stub, &ch)) {
         return MM_FALSE;
     }
     expect = (unsigned char)(hex_to_nibble(ch) << 4);
-    if (read(stub->client_fd, &ch, 1) <= 0) {
-        mm_gdb_stub_close(stub);
+    if (!gdb_getc(stub, &ch)) {
         return MM_FALSE;
     }
     expect |= (unsigned char)hex_to_nibble(ch);
     if (sum != expect) {
-        (void)write(stub->client_fd, "-", 1);
+        if (!stub->no_ack) {
+            gdb_write_all(stub->client_fd, "-", 1);
+        }
         return MM_FALSE;
     }
-    (void)write(stub->client_fd, "+", 1);
+    if (!stub->no_ack) {
+        gdb_write_all(stub->client_fd, "+", 1);
+    }
+    if (overflow != 0u) {
+        /* A truncated command must not run; answer so GDB does not hang. */
+        stub->rx_oversized++;
+        fprintf(stderr, "[GDB] dropped %lu-byte packet over the %lu-byte limit (%llu dropped)\n",
+                (unsigned long)(len + overflow), (unsigned long)(out_cap - 1u),
+                (unsigned long long)stub->rx_oversized);
+        gdb_send_error(stub, 0x0e);
+        return MM_FALSE;
+    }
+    if (len_out != 0) {
+        *len_out = len;
+    }
     return MM_TRUE;
 }
 
@@ -744,6 +803,9 @@ mm_bool mm_gdb_stub_poll(struct mm_gdb_stub *stub, int timeout_ms)
     if (stub == 0 || stub->client_fd < 0) {
         return MM_FALSE;
     }
+    if (stub->rx_pos < stub->rx_len) {
+        return MM_TRUE;
+    }
     pfd.fd = stub->client_fd;
     pfd.events = POLLIN;
     rc = poll(&pfd, 1, timeout_ms);
@@ -755,12 +817,14 @@ mm_bool mm_gdb_stub_poll(struct mm_gdb_stub *stub, int timeout_ms)
 
 void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_memmap *map)
 {
-    char buf[GDB_BUF_SIZE];
+    char *buf = g_pkt_buf;
+    const size_t buf_cap = sizeof(g_pkt_buf);
+    size_t pkt_len = 0;
 
     if (stub == 0 || !stub->connected || stub->client_fd < 0) {
         return;
     }
-    if (!gdb_recv_packet(stub, buf, sizeof(buf))) {
+    if (!gdb_recv_packet(stub, buf, buf_cap, &pkt_len)) {
         return;
     }
 
@@ -771,7 +835,12 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
     switch (buf[0]) {
     case 'q':
         if (strncmp(buf, "qSupported", 10) == 0) {
-            gdb_send_packet(stub->client_fd, "PacketSize=3ff;qXfer:features:read+;qXfer:exec-file:read+;swbreak+;hwbreak+");
+            char features[160];
+            snprintf(features, sizeof(features),
+                     "PacketSize=%x;QStartNoAckMode+;binary-upload+;"
+                     "qXfer:features:read+;qXfer:exec-file:read+;swbreak+;hwbreak+",
+                     (unsigned)GDB_PACKET_SIZE);
+            gdb_send_packet(stub->client_fd, features);
         } else if (strncmp(buf, "qRcmd,", 6) == 0) {
             char cmd[256];
             if (hex_decode_bytes(buf + 6, cmd, sizeof(cmd)) == 0) {
@@ -837,7 +906,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
                     } else {
                         length = (mm_u32)(xml_len - offset);
                     }
-                    if (length + 2u < sizeof(buf)) {
+                    if (length + 2u < buf_cap) {
                         memcpy(buf + 1, chunk, length);
                         buf[0] = hdr;
                         buf[length + 1u] = '\0';
@@ -873,7 +942,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
             if (offset + length > path_len) {
                 length = (mm_u32)(path_len - offset);
             }
-            if (length + 2u < sizeof(buf)) {
+            if (length + 2u < buf_cap) {
                 buf[0] = (offset + length < path_len) ? 'm' : 'l';
                 memcpy(buf + 1, path + offset, length);
                 buf[length + 1u] = '\0';
@@ -889,7 +958,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
         mm_gdb_stub_notify_stop(stub, 5);
         break;
     case 'g': {
-        size_t n = gdb_encode_registers(cpu, buf, sizeof(buf));
+        size_t n = gdb_encode_registers(cpu, buf, buf_cap);
         if (n > 0) {
             gdb_send_packet(stub->client_fd, buf);
         }
@@ -950,23 +1019,29 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
             gdb_send_error(stub, 1);
         }
     } break;
+    case 'Q':
+        if (strcmp(buf, "QStartNoAckMode") == 0) {
+            /* The OK reply is still acked; everything after is not. */
+            gdb_send_ok(stub);
+            stub->no_ack = MM_TRUE;
+        } else {
+            gdb_send_packet(stub->client_fd, "");
+        }
+        break;
     case 'm':
+    case 'x':
         gdb_handle_memory_read(stub, cpu, map, buf);
         break;
     case 'M':
-        gdb_handle_memory_write(stub, cpu, map, buf);
+    case 'X':
+        gdb_handle_memory_write(stub, cpu, map, buf, pkt_len);
         break;
     case 'c': {
         mm_u32 addr;
         if (strlen(buf) > 1 && parse_hex_u32(buf + 1, strlen(buf + 1), &addr) == 0) {
             cpu->r[15] = addr | 1u;
         }
-        if (mm_gdb_stub_breakpoint_hit(stub, cpu->r[15])) {
-            if (gdb_remove_breakpoint(stub, map, cpu->sec_state, cpu->r[15])) {
-                stub->rearm_valid = MM_TRUE;
-                stub->rearm_addr = cpu->r[15];
-            }
-        }
+        gdb_resume_from(stub, cpu->r[15]);
         stub->running = MM_TRUE;
         stub->step_pending = MM_FALSE;
         printf("[GDB] Continue\n");
@@ -976,12 +1051,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
         if (strlen(buf) > 1 && parse_hex_u32(buf + 1, strlen(buf + 1), &addr) == 0) {
             cpu->r[15] = addr | 1u;
         }
-        if (mm_gdb_stub_breakpoint_hit(stub, cpu->r[15])) {
-            if (gdb_remove_breakpoint(stub, map, cpu->sec_state, cpu->r[15])) {
-                stub->rearm_valid = MM_TRUE;
-                stub->rearm_addr = cpu->r[15];
-            }
-        }
+        gdb_resume_from(stub, cpu->r[15]);
         stub->running = MM_TRUE;
         stub->step_pending = MM_TRUE;
         printf("[GDB] Step\n");
@@ -992,7 +1062,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
             unsigned long taddr = 0;
             if (sscanf(buf + 2, ",%lx", &taddr) == 1) {
                 addr = (mm_u32)taddr;
-                if (gdb_install_breakpoint(stub, map, cpu->sec_state, addr)) {
+                if (gdb_install_breakpoint(stub, addr)) {
                     gdb_send_ok(stub);
                 } else {
                     gdb_send_error(stub, 1);
@@ -1008,7 +1078,7 @@ void mm_gdb_stub_handle(struct mm_gdb_stub *stub, struct mm_cpu *cpu, struct mm_
             unsigned long taddr = 0;
             if (sscanf(buf + 2, ",%lx", &taddr) == 1) {
                 addr = (mm_u32)taddr;
-                if (gdb_remove_breakpoint(stub, map, cpu->sec_state, addr)) {
+                if (gdb_remove_breakpoint(stub, addr)) {
                     gdb_send_ok(stub);
                 } else {
                     gdb_send_error(stub, 1);
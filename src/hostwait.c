@@ -0,0 +1,195 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "m33mu/hostwait.h"
+
+static const int *g_watch[MM_HOSTWAIT_MAX_FDS];
+static int g_watch_count = 0;
+static int g_wake_pipe[2] = { -1, -1 };
+static pthread_once_t g_wake_once = PTHREAD_ONCE_INIT;
+
+static void wake_pipe_create(void)
+{
+    if (pipe2(g_wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        g_wake_pipe[0] = g_wake_pipe[1] = -1;
+    }
+}
+
+/* mm_hostwait_wake() may run on the TUI thread before the first wait. */
+static void wake_pipe_open(void)
+{
+    (void)pthread_once(&g_wake_once, wake_pipe_create);
+}
+
+static void wake_pipe_drain(void)
+{
+    char buf[64];
+    while (read(g_wake_pipe[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+mm_bool mm_hostwait_watch(const int *fdp)
+{
+    int i;
+    if (fdp == 0) {
+        return MM_FALSE;
+    }
+    for (i = 0; i < g_watch_count; ++i) {
+        if (g_watch[i] == fdp) {
+            return MM_TRUE;
+        }
+    }
+    if (g_watch_count >= MM_HOSTWAIT_MAX_FDS) {
+        return MM_FALSE;
+    }
+    g_watch[g_watch_count++] = fdp;
+    return MM_TRUE;
+}
+
+void mm_hostwait_unwatch(const int *fdp)
+{
+    int i;
+    for (i = 0; i < g_watch_count; ++i) {
+        if (g_watch[i] == fdp) {
+            g_watch[i] = g_watch[--g_watch_count];
+            return;
+        }
+    }
+}
+
+void mm_hostwait_clear(void)
+{
+    g_watch_count = 0;
+}
+
+void mm_hostwait_wake(void)
+{
+    char c = 1;
+    wake_pipe_open();
+    if (g_wake_pipe[1] >= 0) {
+        (void)write(g_wake_pipe[1], &c, 1);
+    }
+}
+
+static void ns_to_timespec(mm_u64 ns, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)(ns / 1000000000ull);
+    ts->tv_nsec = (long)(ns % 1000000000ull);
+}
+
+static mm_u64 mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mm_u64)ts.tv_sec * 1000000000ull + (mm_u64)ts.tv_nsec;
+}
+
+mm_bool mm_hostwait_block(mm_u64 timeout_ns)
+{
+    struct pollfd pfds[MM_HOSTWAIT_MAX_FDS + 1];
+    mm_bool hung[MM_HOSTWAIT_MAX_FDS + 1];
+    mm_u64 start;
+    int pass;
+    int i;
+
+    wake_pipe_open();
+    for (i = 0; i <= MM_HOSTWAIT_MAX_FDS; ++i) {
+        hung[i] = MM_FALSE;
+    }
+    start = mono_ns();
+    /* Each extra pass drops at least one hung-up descriptor. */
+    for (pass = 0; pass <= MM_HOSTWAIT_MAX_FDS; ++pass) {
+        struct timespec ts;
+        struct timespec *tsp = 0;
+        mm_u64 elapsed;
+        mm_u64 left = timeout_ns;
+        int map[MM_HOSTWAIT_MAX_FDS + 1];
+        int n = 0;
+        int rc;
+        mm_bool any_hung = MM_FALSE;
+
+        if (g_wake_pipe[0] >= 0) {
+            pfds[n].fd = g_wake_pipe[0];
+            pfds[n].events = POLLIN;
+            pfds[n].revents = 0;
+            map[n] = -1;
+            ++n;
+        }
+        for (i = 0; i < g_watch_count; ++i) {
+            if (*g_watch[i] < 0) continue;
+            if (hung[i]) {
+                any_hung = MM_TRUE;
+                continue;
+            }
+            pfds[n].fd = *g_watch[i];
+            pfds[n].events = POLLIN;
+            pfds[n].revents = 0;
+            map[n] = i;
+            ++n;
+        }
+
+        elapsed = mono_ns() - start;
+        if (timeout_ns != MM_HOSTWAIT_FOREVER) {
+            left = (elapsed < timeout_ns) ? (timeout_ns - elapsed) : 0u;
+        }
+        if (any_hung && (left == MM_HOSTWAIT_FOREVER || left > MM_HOSTWAIT_HUP_RECHECK_NS)) {
+            left = MM_HOSTWAIT_HUP_RECHECK_NS;
+        }
+        if (left != MM_HOSTWAIT_FOREVER) {
+            ns_to_timespec(left, &ts);
+            tsp = &ts;
+        }
+
+        rc = ppoll(pfds, (nfds_t)n, tsp, 0);
+        if (rc <= 0) {
+            /* Timeout, or a signal (SIGINT, SIGWINCH) the caller should see. */
+            return (rc < 0 && errno == EINTR) ? MM_TRUE : MM_FALSE;
+        }
+        {
+            mm_bool ready = MM_FALSE;
+            mm_bool dropped = MM_FALSE;
+            for (i = 0; i < n; ++i) {
+                if (pfds[i].revents == 0) continue;
+                if (map[i] < 0) {
+                    wake_pipe_drain();
+                    ready = MM_TRUE;
+                } else if ((pfds[i].revents & POLLIN) != 0) {
+                    ready = MM_TRUE;
+                } else {
+                    hung[map[i]] = MM_TRUE;
+                    dropped = MM_TRUE;
+                }
+            }
+            if (ready || !dropped) {
+                return MM_TRUE;
+            }
+        }
+    }
+    return MM_FALSE;
+}
@@ -0,0 +1,599 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/intercept.h"
+
+#define IC_STR_MAX (1u << 20)
+#define IC_VERIFY_MAX (1u << 20)
+
+enum ic_ret {
+    IC_RET_NONE = 0,
+    IC_RET_VALUE,
+    IC_RET_SIGN     /* memcmp/strcmp: only the sign of r0 is defined */
+};
+
+struct mm_intercept_impl {
+    const char *name;
+    mm_bool (*run)(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units);
+    /* Guest memory written by the routine, compared in verify mode. */
+    void (*span)(const struct mm_cpu *cpu, const struct mm_memmap *map, mm_u32 *addr, mm_u32 *len);
+    enum ic_ret ret;
+    mm_u32 base_cycles;
+    mm_u32 unit_q16;
+};
+
+static mm_u32 rd32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static void wr32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+    p[2] = (mm_u8)(v >> 16);
+    p[3] = (mm_u8)(v >> 24);
+}
+
+/* Byte copy with memmove semantics: r0 = dst, r1 = src, r2 = n. */
+static mm_bool ic_copy(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 dst, mm_u32 src, mm_u32 n)
+{
+    const mm_u8 *s;
+    mm_u8 *d;
+    if (n == 0u) {
+        return MM_TRUE;
+    }
+    s = mm_memmap_guest_read_ptr(map, sec, src, n);
+    d = mm_memmap_guest_write_ptr(map, sec, dst, n);
+    if (s == 0 || d == 0) {
+        return MM_FALSE;
+    }
+    memmove(d, s, n);
+    return MM_TRUE;
+}
+
+static mm_bool ic_fill(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 dst, mm_u8 c, mm_u32 n)
+{
+    mm_u8 *d;
+    if (n == 0u) {
+        return MM_TRUE;
+    }
+    d = mm_memmap_guest_write_ptr(map, sec, dst, n);
+    if (d == 0) {
+        return MM_FALSE;
+    }
+    memset(d, c, n);
+    return MM_TRUE;
+}
+
+/* Length of the NUL-terminated string at addr, checked granule by granule. */
+static mm_bool ic_strlen(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 *len)
+{
+    mm_u32 n = 0;
+    while (n < IC_STR_MAX) {
+        mm_u32 a = addr + n;
+        mm_u32 chunk = MM_MEMMAP_PROT_GRANULE - (a & (MM_MEMMAP_PROT_GRANULE - 1u));
+        const mm_u8 *p = mm_memmap_guest_read_ptr(map, sec, a, chunk);
+        const mm_u8 *z;
+        if (p == 0) {
+            return MM_FALSE;
+        }
+        z = (const mm_u8 *)memchr(p, 0, chunk);
+        if (z != 0) {
+            *len = n + (mm_u32)(z - p);
+            return MM_TRUE;
+        }
+        n += chunk;
+    }
+    return MM_FALSE;
+}
+
+static mm_bool run_memcpy(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    *units = cpu->r[2];
+    return ic_copy(map, sec, cpu->r[0], cpu->r[1], cpu->r[2]);
+}
+
+static mm_bool run_memset(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    *units = cpu->r[2];
+    return ic_fill(map, sec, cpu->r[0], (mm_u8)cpu->r[1], cpu->r[2]);
+}
+
+/* __aeabi_memset(dest, n, c) swaps the last two arguments. */
+static mm_bool run_aeabi_memset(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    *units = cpu->r[1];
+    return ic_fill(map, sec, cpu->r[0], (mm_u8)cpu->r[2], cpu->r[1]);
+}
+
+static mm_bool run_aeabi_memclr(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    *units = cpu->r[1];
+    return ic_fill(map, sec, cpu->r[0], 0u, cpu->r[1]);
+}
+
+static mm_bool run_memcmp(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    mm_u32 n = cpu->r[2];
+    const mm_u8 *a;
+    const mm_u8 *b;
+    mm_u32 i;
+    *units = n;
+    if (n == 0u) {
+        cpu->r[0] = 0u;
+        return MM_TRUE;
+    }
+    a = mm_memmap_guest_read_ptr(map, sec, cpu->r[0], n);
+    b = mm_memmap_guest_read_ptr(map, sec, cpu->r[1], n);
+    if (a == 0 || b == 0) {
+        return MM_FALSE;
+    }
+    for (i = 0; i < n && a[i] == b[i]; ++i) {
+    }
+    *units = (i < n) ? i + 1u : n;
+    cpu->r[0] = (i < n) ? (mm_u32)((int)a[i] - (int)b[i]) : 0u;
+    return MM_TRUE;
+}
+
+static mm_bool run_strlen(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    mm_u32 len;
+    if (!ic_strlen(map, sec, cpu->r[0], &len)) {
+        return MM_FALSE;
+    }
+    *units = len;
+    cpu->r[0] = len;
+    return MM_TRUE;
+}
+
+static mm_bool run_strcmp(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    mm_u32 la;
+    mm_u32 lb;
+    const mm_u8 *a;
+    const mm_u8 *b;
+    mm_u32 i;
+    if (!ic_strlen(map, sec, cpu->r[0], &la) || !ic_strlen(map, sec, cpu->r[1], &lb)) {
+        return MM_FALSE;
+    }
+    a = mm_memmap_guest_read_ptr(map, sec, cpu->r[0], la + 1u);
+    b = mm_memmap_guest_read_ptr(map, sec, cpu->r[1], lb + 1u);
+    if (a == 0 || b == 0) {
+        return MM_FALSE;
+    }
+    for (i = 0; a[i] != 0u && a[i] == b[i]; ++i) {
+    }
+    *units = i + 1u;
+    cpu->r[0] = (mm_u32)((int)a[i] - (int)b[i]);
+    return MM_TRUE;
+}
+
+/* wolfCrypt SP (Cortex-M build) sp_256_mont_mul_8(r, a, b, m, mp):
+ * r = a * b / 2^256 mod m on 8 x 32-bit little-endian digits, with the
+ * final subtraction of m driven by the carry out of the reduction. */
+static mm_bool run_sp_256_mont_mul_8(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 *units)
+{
+    const mm_u8 *pa = mm_memmap_guest_read_ptr(map, sec, cpu->r[1], 32u);
+    const mm_u8 *pb = mm_memmap_guest_read_ptr(map, sec, cpu->r[2], 32u);
+    const mm_u8 *pm = mm_memmap_guest_read_ptr(map, sec, cpu->r[3], 32u);
+    const mm_u8 *psp = mm_memmap_guest_read_ptr(map, sec, mm_cpu_get_active_sp(cpu), 4u);
+    mm_u8 *pr = mm_memmap_guest_write_ptr(map, sec, cpu->r[0], 32u);
+    mm_u32 a[8];
+    mm_u32 b[8];
+    mm_u32 m[8];
+    mm_u32 t[16];
+    mm_u32 top = 0;
+    mm_u32 mp;
+    mm_u64 c;
+    int i;
+    int j;
+
+    if (pa == 0 || pb == 0 || pm == 0 || psp == 0 || pr == 0) {
+        return MM_FALSE;
+    }
+    mp = rd32(psp);
+    for (i = 0; i < 8; ++i) {
+        a[i] = rd32(pa + 4 * i);
+        b[i] = rd32(pb + 4 * i);
+        m[i] = rd32(pm + 4 * i);
+    }
+    memset(t, 0, sizeof(t));
+    for (i = 0; i < 8; ++i) {
+        c = 0;
+        for (j = 0; j < 8; ++j) {
+            c += (mm_u64)t[i + j] + (mm_u64)a[i] * b[j];
+            t[i + j] = (mm_u32)c;
+            c >>= 32;
+        }
+        t[i + 8] = (mm_u32)c;
+    }
+    for (i = 0; i < 8; ++i) {
+        mm_u32 mu = t[i] * mp;
+        c = 0;
+        for (j = 0; j < 8; ++j) {
+            c += (mm_u64)t[i + j] + (mm_u64)mu * m[j];
+            t[i + j] = (mm_u32)c;
+            c >>= 32;
+        }
+        for (j = i + 8; j < 16 && c != 0u; ++j) {
+            c += t[j];
+            t[j] = (mm_u32)c;
+            c >>= 32;
+        }
+        top += (mm_u32)c;
+    }
+    if (top != 0u) {
+        mm_u64 borrow = 0;
+        for (i = 0; i < 8; ++i) {
+            mm_u64 d = (mm_u64)t[8 + i] - m[i] - borrow;
+            t[8 + i] = (mm_u32)d;
+            borrow = (d >> 32) & 1u;
+        }
+    }
+    for (i = 0; i < 8; ++i) {
+        wr32(pr + 4 * i, t[8 + i]);
+    }
+    *units = 1u;
+    return MM_TRUE;
+}
+
+static void span_r0_r2(const struct mm_cpu *cpu, const struct mm_memmap *map, mm_u32 *addr, mm_u32 *len)
+{
+    (void)map;
+    *addr = cpu->r[0];
+    *len = cpu->r[2];
+}
+
+static void span_r0_r1(const struct mm_cpu *cpu, const struct mm_memmap *map, mm_u32 *addr, mm_u32 *len)
+{
+    (void)map;
+    *addr = cpu->r[0];
+    *len = cpu->r[1];
+}
+
+static void span_r0_32(const struct mm_cpu *cpu, const struct mm_memmap *map, mm_u32 *addr, mm_u32 *len)
+{
+    (void)map;
+    *addr = cpu->r[0];
+    *len = 32u;
+}
+
+/* Default costs approximate a Cortex-M33 word-at-a-time library routine. */
+#define Q16(x) ((mm_u32)((x) * 65536.0))
+static const struct mm_intercept_impl g_impls[] = {
+    { "memcpy", run_memcpy, span_r0_r2, IC_RET_VALUE, 16u, Q16(0.5) },
+    { "memmove", run_memcpy, span_r0_r2, IC_RET_VALUE, 20u, Q16(0.5) },
+    { "memset", run_memset, span_r0_r2, IC_RET_VALUE, 12u, Q16(0.25) },
+    { "memcmp", run_memcmp, 0, IC_RET_SIGN, 12u, Q16(2.0) },
+    { "strlen", run_strlen, 0, IC_RET_VALUE, 8u, Q16(1.0) },
+    { "strcmp", run_strcmp, 0, IC_RET_SIGN, 10u, Q16(2.0) },
+    { "__aeabi_memcpy", run_memcpy, span_r0_r2, IC_RET_NONE, 14u, Q16(0.5) },
+    { "__aeabi_memcpy4", run_memcpy, span_r0_r2, IC_RET_NONE, 12u, Q16(0.5) },
+    { "__aeabi_memcpy8", run_memcpy, span_r0_r2, IC_RET_NONE, 12u, Q16(0.5) },
+    { "__aeabi_memmove", run_memcpy, span_r0_r2, IC_RET_NONE, 18u, Q16(0.5) },
+    { "__aeabi_memset", run_aeabi_memset, span_r0_r1, IC_RET_NONE, 12u, Q16(0.25) },
+    { "__aeabi_memset4", run_aeabi_memset, span_r0_r1, IC_RET_NONE, 10u, Q16(0.25) },
+    { "__aeabi_memclr", run_aeabi_memclr, span_r0_r1, IC_RET_NONE, 12u, Q16(0.25) },
+    { "__aeabi_memclr4", run_aeabi_memclr, span_r0_r1, IC_RET_NONE, 10u, Q16(0.25) },
+    { "sp_256_mont_mul_8", run_sp_256_mont_mul_8, span_r0_32, IC_RET_NONE, 650u, 0u },
+};
+#undef Q16
+
+#define IC_IMPL_COUNT ((int)(sizeof(g_impls) / sizeof(g_impls[0])))
+
+const char *mm_intercept_routine_name(int idx)
+{
+    if (idx < 0 || idx >= IC_IMPL_COUNT) {
+        return 0;
+    }
+    return g_impls[idx].name;
+}
+
+static mm_u32 filter_bit(mm_u32 addr)
+{
+    return (addr >> 1) & (MM_INTERCEPT_FILTER_BITS - 1u);
+}
+
+void mm_intercept_init(struct mm_intercept *ic)
+{
+    memset(ic, 0, sizeof(*ic));
+    ic->pending_idx = -1;
+}
+
+void mm_intercept_free(struct mm_intercept *ic)
+{
+    free(ic->expect);
+    ic->expect = 0;
+    ic->expect_cap = 0;
+}
+
+void mm_intercept_reset(struct mm_intercept *ic)
+{
+    ic->pending = MM_FALSE;
+    ic->pending_idx = -1;
+}
+
+static mm_bool parse_cost(const char *s, const char *end, mm_u32 *base, mm_u32 *unit_q16)
+{
+    char buf[64];
+    char *p;
+    unsigned long b;
+    double u = 0.0;
+    size_t n = (size_t)(end - s);
+    if (n == 0u || n >= sizeof(buf)) {
+        return MM_FALSE;
+    }
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    b = strtoul(buf, &p, 0);
+    if (p == buf) {
+        return MM_FALSE;
+    }
+    if (*p == '+') {
+        char *q;
+        u = strtod(p + 1, &q);
+        if (q == p + 1 || u < 0.0 || u > 65535.0) {
+            return MM_FALSE;
+        }
+        p = q;
+    }
+    if (*p != '\0') {
+        return MM_FALSE;
+    }
+    *base = (mm_u32)b;
+    *unit_q16 = (mm_u32)(u * 65536.0);
+    return MM_TRUE;
+}
+
+mm_bool mm_intercept_parse(struct mm_intercept *ic, const char *spec)
+{
+    const char *s = spec;
+    while (*s != '\0') {
+        const char *end = strchr(s, ',');
+        const char *colon;
+        size_t name_len;
+        struct mm_intercept_entry *e;
+        int i;
+        if (end == 0) {
+            end = s + strlen(s);
+        }
+        colon = (const char *)memchr(s, ':', (size_t)(end - s));
+        name_len = (size_t)(((colon != 0) ? colon : end) - s);
+        for (i = 0; i < IC_IMPL_COUNT; ++i) {
+            if (strlen(g_impls[i].name) == name_len && strncmp(g_impls[i].name, s, name_len) == 0) {
+                break;
+            }
+        }
+        if (i == IC_IMPL_COUNT || ic->count >= MM_INTERCEPT_MAX) {
+            return MM_FALSE;
+        }
+        e = &ic->entries[ic->count];
+        memset(e, 0, sizeof(*e));
+        e->impl = &g_impls[i];
+        e->base_cycles = g_impls[i].base_cycles;
+        e->unit_q16 = g_impls[i].unit_q16;
+        if (colon != 0 && !parse_cost(colon + 1, end, &e->base_cycles, &e->unit_q16)) {
+            return MM_FALSE;
+        }
+        ic->count++;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return ic->count > 0;
+}
+
+int mm_intercept_bind(struct mm_intercept *ic, const struct mm_elfsym_table *syms)
+{
+    int i;
+    int bound = 0;
+    memset(ic->filter, 0, sizeof(ic->filter));
+    for (i = 0; i < ic->count; ++i) {
+        struct mm_intercept_entry *e = &ic->entries[i];
+        const struct mm_elfsym *sym = (syms != 0) ? mm_elfsym_find(syms, e->impl->name) : 0;
+        e->bound = (sym != 0) ? MM_TRUE : MM_FALSE;
+        if (!e->bound) {
+            fprintf(stderr, "[INTERCEPT] %s: symbol not found\n", e->impl->name);
+            continue;
+        }
+        e->addr = sym->addr & ~1u;
+        ic->filter[filter_bit(e->addr) >> 5] |= 1u << (filter_bit(e->addr) & 31u);
+        bound++;
+    }
+    ic->enabled = (bound > 0) ? MM_TRUE : MM_FALSE;
+    return bound;
+}
+
+static mm_u32 entry_cost(const struct mm_intercept_entry *e, mm_u32 units)
+{
+    mm_u64 c = (mm_u64)e->base_cycles + (((mm_u64)units * e->unit_q16) >> 16);
+    if (c == 0u) {
+        c = 1u;
+    }
+    return (c > 0xFFFFFFFFull) ? 0xFFFFFFFFu : (mm_u32)c;
+}
+
+static mm_bool ret_matches(enum ic_ret kind, mm_u32 host, mm_u32 guest)
+{
+    switch (kind) {
+    case IC_RET_VALUE:
+        return host == guest;
+    case IC_RET_SIGN: {
+        int h = ((mm_i32)host > 0) - ((mm_i32)host < 0);
+        int g = ((mm_i32)guest > 0) - ((mm_i32)guest < 0);
+        return h == g;
+    }
+    default:
+        return MM_TRUE;
+    }
+}
+
+static void verify_finish(struct mm_intercept *ic, struct mm_cpu *cpu, struct mm_memmap *map)
+{
+    struct mm_intercept_entry *e = &ic->entries[ic->pending_idx];
+    const mm_u8 *got = 0;
+    mm_bool ok = ret_matches(e->impl->ret, ic->expect_r0, cpu->r[0]);
+    if (ic->span_len > 0u) {
+        got = mm_memmap_host_read_ptr(map, ic->span_addr, ic->span_len);
+        if (got == 0 || memcmp(got, ic->expect, ic->span_len) != 0) {
+            ok = MM_FALSE;
+        }
+    }
+    e->verified++;
+    if (!ok) {
+        e->mismatches++;
+        fprintf(stderr, "[INTERCEPT] %s mismatch (caller 0x%08lx): r0 native=0x%08lx emulated=0x%08lx",
+                e->impl->name, (unsigned long)ic->ret_pc,
+                (unsigned long)ic->expect_r0, (unsigned long)cpu->r[0]);
+        if (ic->span_len > 0u) {
+            fprintf(stderr, " buffer 0x%08lx+%lu %s", (unsigned long)ic->span_addr,
+                    (unsigned long)ic->span_len,
+                    (got != 0 && memcmp(got, ic->expect, ic->span_len) == 0) ? "equal" : "differs");
+        }
+        fprintf(stderr, "\n");
+    }
+    ic->pending = MM_FALSE;
+    ic->pending_idx = -1;
+}
+
+/* Run the native routine on scratch state: record its r0 and the bytes it
+ * would write, then put the guest memory back for the emulated run. */
+static void verify_start(struct mm_intercept *ic, int idx, struct mm_cpu *cpu, struct mm_memmap *map)
+{
+    struct mm_intercept_entry *e = &ic->entries[idx];
+    enum mm_sec_state sec = cpu->sec_state;
+    mm_u32 r0 = cpu->r[0];
+    mm_u32 addr = 0;
+    mm_u32 len = 0;
+    mm_u32 units = 0;
+    mm_u8 *live = 0;
+    mm_u8 *saved = 0;
+
+    if (e->impl->span != 0) {
+        e->impl->span(cpu, map, &addr, &len);
+    }
+    if (len > IC_VERIFY_MAX) {
+        return;
+    }
+    if (len > 0u) {
+        live = mm_memmap_guest_write_ptr(map, sec, addr, len);
+        if (live == 0) {
+            return;
+        }
+        saved = (mm_u8 *)malloc(len);
+        if (saved == 0) {
+            return;
+        }
+        if (len > ic->expect_cap) {
+            mm_u8 *p = (mm_u8 *)realloc(ic->expect, len);
+            if (p == 0) {
+                free(saved);
+                return;
+            }
+            ic->expect = p;
+            ic->expect_cap = len;
+        }
+        memcpy(saved, live, len);
+    }
+    if (e->impl->run(cpu, map, sec, &units)) {
+        ic->expect_r0 = cpu->r[0];
+        if (len > 0u) {
+            memcpy(ic->expect, live, len);
+        }
+        ic->pending = MM_TRUE;
+        ic->pending_idx = idx;
+        ic->ret_pc = cpu->r[14] & ~1u;
+        ic->ret_sp = mm_cpu_get_active_sp(cpu);
+        ic->ret_sec = sec;
+        ic->span_addr = addr;
+        ic->span_len = len;
+    }
+    if (len > 0u) {
+        memcpy(live, saved, len);
+        free(saved);
+    }
+    cpu->r[0] = r0;
+}
+
+mm_u32 mm_intercept_step(struct mm_intercept *ic, struct mm_cpu *cpu, struct mm_memmap *map)
+{
+    mm_u32 pc = cpu->r[15] & ~1u;
+    mm_u32 bit;
+    mm_u32 units = 0;
+    mm_u32 cost;
+    int i;
+
+    if (ic->pending && pc == ic->ret_pc && cpu->sec_state == ic->ret_sec &&
+        mm_cpu_get_active_sp(cpu) == ic->ret_sp) {
+        verify_finish(ic, cpu, map);
+    }
+    bit = filter_bit(pc);
+    if ((ic->filter[bit >> 5] & (1u << (bit & 31u))) == 0u) {
+        return 0;
+    }
+    for (i = 0; i < ic->count; ++i) {
+        if (ic->entries[i].bound && ic->entries[i].addr == pc) {
+            break;
+        }
+    }
+    /* EXC_RETURN and FNC_RETURN need the emulated return path. */
+    if (i == ic->count || cpu->r[14] >= 0xFE000000u) {
+        return 0;
+    }
+    if (ic->verify) {
+        if (!ic->pending) {
+            verify_start(ic, i, cpu, map);
+        }
+        return 0;
+    }
+    if (!ic->entries[i].impl->run(cpu, map, cpu->sec_state, &units)) {
+        return 0;
+    }
+    cost = entry_cost(&ic->entries[i], units);
+    ic->entries[i].calls++;
+    ic->entries[i].units += units;
+    ic->entries[i].cycles += cost;
+    cpu->r[15] = cpu->r[14] | 1u;
+    return cost;
+}
+
+void mm_intercept_report(const struct mm_intercept *ic)
+{
+    int i;
+    for (i = 0; i < ic->count; ++i) {
+        const struct mm_intercept_entry *e = &ic->entries[i];
+        if (!e->bound) {
+            continue;
+        }
+        if (ic->verify) {
+            fprintf(stderr, "[INTERCEPT] %-20s verified=%llu mismatches=%llu\n", e->impl->name,
+                    (unsigned long long)e->verified, (unsigned long long)e->mismatches);
+        } else {
+            fprintf(stderr, "[INTERCEPT] %-20s calls=%llu units=%llu cycles=%llu\n", e->impl->name,
+                    (unsigned long long)e->calls, (unsigned long long)e->units,
+                    (unsigned long long)e->cycles);
+        }
+    }
+}
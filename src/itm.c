@@ -0,0 +1,267 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _XOPEN_SOURCE 600
+#include "m33mu/itm.h"
+#include "m33mu/target_hal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+void mm_itm_sink_init(struct mm_itm_sink *sink)
+{
+    if (sink == 0) return;
+    sink->kind = MM_ITM_SINK_NONE;
+    sink->fd = -1;
+    sink->listen_fd = -1;
+    sink->own_fd = MM_FALSE;
+    sink->head = 0;
+    sink->tail = 0;
+    sink->dropped = 0;
+    sink->last_drain_cycle = 0;
+    sink->name[0] = '\0';
+}
+
+static void itm_set_nonblock(int fd)
+{
+    int fl = fcntl(fd, F_GETFL, 0);
+    if (fl >= 0) {
+        (void)fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+    }
+}
+
+static int itm_open_tcp(int port)
+{
+    int fd;
+    int opt = 1;
+    struct sockaddr_in addr;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        perror("[ITM] tcp");
+        close(fd);
+        return -1;
+    }
+    itm_set_nonblock(fd);
+    return fd;
+}
+
+static int itm_open_pty(char *out, size_t outlen)
+{
+    int fd;
+    const char *name;
+    struct termios tio;
+
+    fd = open("/dev/ptmx", O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    if (grantpt(fd) != 0 || unlockpt(fd) != 0 || (name = ptsname(fd)) == 0) {
+        close(fd);
+        return -1;
+    }
+    snprintf(out, outlen, "%s", name);
+    if (tcgetattr(fd, &tio) == 0) {
+        tio.c_lflag &= ~(ICANON | ECHO);
+        tio.c_oflag &= ~(OPOST | ONLCR);
+        (void)tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+mm_bool mm_itm_sink_open(struct mm_itm_sink *sink, const char *spec)
+{
+    if (sink == 0 || spec == 0 || spec[0] == '\0') {
+        return MM_FALSE;
+    }
+    mm_itm_sink_close(sink);
+    if (strncmp(spec, "tcp:", 4) == 0) {
+        int port = atoi(spec + 4);
+        if (port <= 0 || port > 65535) {
+            return MM_FALSE;
+        }
+        sink->listen_fd = itm_open_tcp(port);
+        if (sink->listen_fd < 0) {
+            return MM_FALSE;
+        }
+        sink->kind = MM_ITM_SINK_TCP;
+        sink->own_fd = MM_TRUE;
+        snprintf(sink->name, sizeof(sink->name), "tcp:%d", port);
+    } else if (strcmp(spec, "pty") == 0) {
+        sink->fd = itm_open_pty(sink->name, sizeof(sink->name));
+        if (sink->fd < 0) {
+            return MM_FALSE;
+        }
+        sink->kind = MM_ITM_SINK_PTY;
+        sink->own_fd = MM_TRUE;
+        mm_tui_attach_uart("ITM", sink->name);
+    } else if (strcmp(spec, "-") == 0) {
+        sink->fd = STDOUT_FILENO;
+        sink->kind = MM_ITM_SINK_FILE;
+        sink->own_fd = MM_FALSE;
+        snprintf(sink->name, sizeof(sink->name), "stdout");
+    } else {
+        sink->fd = open(spec, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (sink->fd < 0) {
+            perror("[ITM] open");
+            return MM_FALSE;
+        }
+        sink->kind = MM_ITM_SINK_FILE;
+        sink->own_fd = MM_TRUE;
+        snprintf(sink->name, sizeof(sink->name), "%s", spec);
+    }
+    printf("[ITM] stimulus ports attached to %s\n", sink->name);
+    return MM_TRUE;
+}
+
+void mm_itm_sink_close(struct mm_itm_sink *sink)
+{
+    if (sink == 0) return;
+    if (sink->kind != MM_ITM_SINK_NONE) {
+        mm_itm_sink_poll(sink, 0, MM_TRUE);
+        if (sink->dropped != 0u) {
+            printf("[ITM] %llu byte(s) dropped (ring full)\n", (unsigned long long)sink->dropped);
+        }
+    }
+    if (sink->fd >= 0 && (sink->own_fd || sink->kind == MM_ITM_SINK_TCP)) {
+        close(sink->fd);
+    }
+    if (sink->listen_fd >= 0) {
+        close(sink->listen_fd);
+    }
+    mm_itm_sink_init(sink);
+}
+
+mm_bool mm_itm_sink_active(const struct mm_itm_sink *sink)
+{
+    return (sink != 0 && sink->kind != MM_ITM_SINK_NONE) ? MM_TRUE : MM_FALSE;
+}
+
+void mm_itm_sink_push(struct mm_itm_sink *sink, const mm_u8 *data, mm_u32 len)
+{
+    mm_u32 space;
+    mm_u32 pos;
+    mm_u32 first;
+
+    if (sink == 0 || sink->kind == MM_ITM_SINK_NONE || len == 0u) {
+        return;
+    }
+    space = MM_ITM_RING_SIZE - (sink->tail - sink->head);
+    if (len > space) {
+        sink->dropped += (mm_u64)(len - space);
+        len = space;
+    }
+    pos = sink->tail & (MM_ITM_RING_SIZE - 1u);
+    first = MM_ITM_RING_SIZE - pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&sink->ring[pos], data, first);
+    memcpy(&sink->ring[0], data + first, len - first);
+    sink->tail += len;
+}
+
+mm_u32 mm_itm_sink_pending(const struct mm_itm_sink *sink)
+{
+    if (sink == 0) return 0;
+    return sink->tail - sink->head;
+}
+
+static void itm_accept(struct mm_itm_sink *sink)
+{
+    int cfd;
+    if (sink->listen_fd < 0 || sink->fd >= 0) {
+        return;
+    }
+    cfd = accept(sink->listen_fd, 0, 0);
+    if (cfd >= 0) {
+        itm_set_nonblock(cfd);
+        sink->fd = cfd;
+    }
+}
+
+void mm_itm_sink_poll(struct mm_itm_sink *sink, mm_u64 now_cycles, mm_bool force)
+{
+    mm_u32 pending;
+
+    if (sink == 0 || sink->kind == MM_ITM_SINK_NONE) {
+        return;
+    }
+    pending = sink->tail - sink->head;
+    if (pending == 0u) {
+        sink->last_drain_cycle = now_cycles;
+        return;
+    }
+    if (!force && pending < MM_ITM_DRAIN_THRESHOLD &&
+        now_cycles - sink->last_drain_cycle < MM_ITM_DRAIN_CYCLES) {
+        return;
+    }
+    sink->last_drain_cycle = now_cycles;
+    if (sink->kind == MM_ITM_SINK_TCP) {
+        itm_accept(sink);
+        if (sink->fd < 0) {
+            return; /* keep buffering until a client connects */
+        }
+    }
+    while (sink->head != sink->tail) {
+        mm_u32 pos = sink->head & (MM_ITM_RING_SIZE - 1u);
+        mm_u32 chunk = sink->tail - sink->head;
+        ssize_t n;
+        if (chunk > MM_ITM_RING_SIZE - pos) {
+            chunk = MM_ITM_RING_SIZE - pos;
+        }
+        if (sink->kind == MM_ITM_SINK_TCP) {
+            n = send(sink->fd, &sink->ring[pos], chunk, MSG_NOSIGNAL);
+        } else {
+            n = write(sink->fd, &sink->ring[pos], chunk);
+        }
+        if (n > 0) {
+            sink->head += (mm_u32)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return;
+        }
+        if (sink->kind == MM_ITM_SINK_TCP) {
+            /* Client went away: wait for the next one. */
+            close(sink->fd);
+            sink->fd = -1;
+            return;
+        }
+        sink->head = sink->tail;
+        return;
+    }
+}
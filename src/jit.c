@@ -0,0 +1,724 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "m33mu/jit.h"
+#include "m33mu/fetch.h"
+
+#if defined(M33MU_HAS_JIT) && defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef mm_u32 (*jit_block_fn)(struct mm_cpu *cpu, struct mm_jit *jit);
+
+/* Host registers: rbx holds the guest CPU, r12 the translator; both are
+ * callee-saved so they survive the memory helpers. eax/ecx/edx/esi/edi and
+ * r8 are scratch.
+ */
+enum {
+    X_EAX = 0,
+    X_ECX = 1,
+    X_EDX = 2,
+    X_ESI = 6,
+    X_EDI = 7
+};
+
+#define OFF_R(n) ((mm_u32)(offsetof(struct mm_cpu, r) + 4u * (mm_u32)(n)))
+#define OFF_XPSR ((mm_u32)offsetof(struct mm_cpu, xpsr))
+/* Upper bound on the host code of one block (about 100 bytes per guest
+ * instruction at worst).
+ */
+#define MM_JIT_BLOCK_MAX 4096u
+
+struct emit {
+    mm_u8 *p;
+    mm_u8 *end;
+    mm_bool full;
+};
+
+static void e8(struct emit *e, mm_u32 b)
+{
+    if (e->p >= e->end) {
+        e->full = MM_TRUE;
+        return;
+    }
+    *e->p++ = (mm_u8)b;
+}
+
+static void e32(struct emit *e, mm_u32 v)
+{
+    e8(e, v & 0xffu);
+    e8(e, (v >> 8) & 0xffu);
+    e8(e, (v >> 16) & 0xffu);
+    e8(e, v >> 24);
+}
+
+static void e64(struct emit *e, mm_u64 v)
+{
+    e32(e, (mm_u32)v);
+    e32(e, (mm_u32)(v >> 32));
+}
+
+/* mov r32, [rbx+off] */
+static void ld_cpu(struct emit *e, int reg, mm_u32 off)
+{
+    e8(e, 0x8b);
+    e8(e, 0x80u | ((mm_u32)reg << 3) | 3u);
+    e32(e, off);
+}
+
+/* mov [rbx+off], r32 */
+static void st_cpu(struct emit *e, int reg, mm_u32 off)
+{
+    e8(e, 0x89);
+    e8(e, 0x80u | ((mm_u32)reg << 3) | 3u);
+    e32(e, off);
+}
+
+/* mov dword [rbx+off], imm32 */
+static void st_cpu_imm(struct emit *e, mm_u32 off, mm_u32 imm)
+{
+    e8(e, 0xc7);
+    e8(e, 0x83);
+    e32(e, off);
+    e32(e, imm);
+}
+
+/* mov r32, imm32 */
+static void mov_imm(struct emit *e, int reg, mm_u32 imm)
+{
+    e8(e, 0xb8u + (mm_u32)reg);
+    e32(e, imm);
+}
+
+static void emit_prologue(struct emit *e)
+{
+    e8(e, 0x53);                                /* push rbx */
+    e8(e, 0x41); e8(e, 0x54);                   /* push r12 */
+    e8(e, 0x48); e8(e, 0x83); e8(e, 0xec); e8(e, 0x08); /* sub rsp, 8 */
+    e8(e, 0x48); e8(e, 0x89); e8(e, 0xfb);      /* mov rbx, rdi */
+    e8(e, 0x49); e8(e, 0x89); e8(e, 0xf4);      /* mov r12, rsi */
+}
+
+static void emit_return(struct emit *e, mm_u32 retired)
+{
+    mov_imm(e, X_EAX, retired);
+    e8(e, 0x48); e8(e, 0x83); e8(e, 0xc4); e8(e, 0x08); /* add rsp, 8 */
+    e8(e, 0x41); e8(e, 0x5c);                   /* pop r12 */
+    e8(e, 0x5b);                                /* pop rbx */
+    e8(e, 0xc3);                                /* ret */
+}
+
+/* Leave the block with 'retired' instructions done and R15 at next_pc.
+ * With nothing retired R15 still holds the caller's post-fetch value.
+ */
+static void emit_exit(struct emit *e, mm_u32 next_pc, mm_u32 retired)
+{
+    if (retired != 0u) {
+        st_cpu_imm(e, OFF_R(15), next_pc | 1u);
+    }
+    emit_return(e, retired);
+}
+
+static void emit_call(struct emit *e, mm_u64 fn)
+{
+    e8(e, 0x48); e8(e, 0xb8); e64(e, fn);       /* mov rax, fn */
+    e8(e, 0xff); e8(e, 0xd0);                   /* call rax */
+}
+
+/* jcc rel8 with the displacement patched by jump_here(). */
+static mm_u8 *jump_fwd(struct emit *e, mm_u32 opcode)
+{
+    mm_u8 *at;
+    e8(e, opcode);
+    at = e->p;
+    e8(e, 0);
+    return at;
+}
+
+static void jump_here(struct emit *e, mm_u8 *at)
+{
+    if (!e->full && at < e->end) {
+        *at = (mm_u8)(e->p - (at + 1));
+    }
+}
+
+/* Merge eax (new flag bits) into xPSR, keeping the bits in 'keep'. */
+static void emit_merge_flags(struct emit *e, mm_u32 keep)
+{
+    ld_cpu(e, X_ECX, OFF_XPSR);
+    e8(e, 0x81); e8(e, 0xe1); e32(e, keep);     /* and ecx, keep */
+    e8(e, 0x09); e8(e, 0xc1);                   /* or ecx, eax */
+    st_cpu(e, X_ECX, OFF_XPSR);
+}
+
+/* NZCV from the host flags of the preceding add/sub/cmp. ARM's C is the
+ * host carry for additions and its complement (no borrow) for subtractions.
+ */
+static void emit_flags_nzcv(struct emit *e, mm_bool sub)
+{
+    e8(e, 0x0f); e8(e, 0x98); e8(e, 0xc0);      /* sets al */
+    e8(e, 0x0f); e8(e, 0x94); e8(e, 0xc1);      /* setz cl */
+    e8(e, 0x0f); e8(e, sub ? 0x93 : 0x92); e8(e, 0xc2); /* setae/setb dl */
+    e8(e, 0x41); e8(e, 0x0f); e8(e, 0x90); e8(e, 0xc0); /* seto r8b */
+    e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xc0);      /* movzx eax, al */
+    e8(e, 0xc1); e8(e, 0xe0); e8(e, 31);        /* shl eax, 31 */
+    e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xc9);      /* movzx ecx, cl */
+    e8(e, 0xc1); e8(e, 0xe1); e8(e, 30);        /* shl ecx, 30 */
+    e8(e, 0x09); e8(e, 0xc8);                   /* or eax, ecx */
+    e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xd2);      /* movzx edx, dl */
+    e8(e, 0xc1); e8(e, 0xe2); e8(e, 29);        /* shl edx, 29 */
+    e8(e, 0x09); e8(e, 0xd0);                   /* or eax, edx */
+    e8(e, 0x41); e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xc8); /* movzx ecx, r8b */
+    e8(e, 0xc1); e8(e, 0xe1); e8(e, 28);        /* shl ecx, 28 */
+    e8(e, 0x09); e8(e, 0xc8);                   /* or eax, ecx */
+    emit_merge_flags(e, 0x0fffffffu);
+}
+
+/* NZ only; C and V are kept, as the interpreter does for 16-bit logic ops. */
+static void emit_flags_nz(struct emit *e)
+{
+    e8(e, 0x0f); e8(e, 0x98); e8(e, 0xc0);      /* sets al */
+    e8(e, 0x0f); e8(e, 0x94); e8(e, 0xc1);      /* setz cl */
+    e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xc0);      /* movzx eax, al */
+    e8(e, 0xc1); e8(e, 0xe0); e8(e, 31);        /* shl eax, 31 */
+    e8(e, 0x0f); e8(e, 0xb6); e8(e, 0xc9);      /* movzx ecx, cl */
+    e8(e, 0xc1); e8(e, 0xe1); e8(e, 30);        /* shl ecx, 30 */
+    e8(e, 0x09); e8(e, 0xc8);                   /* or eax, ecx */
+    emit_merge_flags(e, 0x3fffffffu);
+}
+
+/* Memory helpers called from translated code. Only RAM, flash and XIP ROM
+ * are handled here; MMIO and faulting accesses return "not done" and the
+ * instruction is left to the interpreter.
+ */
+static mm_u64 jit_load(struct mm_jit *jit, mm_u32 addr, mm_u32 size)
+{
+    mm_u32 val = 0;
+    if (mm_memmap_host_read_ptr(jit->map, addr, size) == 0 ||
+        !mm_memmap_read(jit->map, jit->sec, addr, size, &val)) {
+        return 0;
+    }
+    if (size == 1u) {
+        val &= 0xffu;
+    } else if (size == 2u) {
+        val &= 0xffffu;
+    }
+    return (1ull << 32) | val;
+}
+
+/* 0: not done, 1: stored, 2: stored into the running block's code. */
+static mm_u32 jit_store(struct mm_jit *jit, mm_u32 addr, mm_u32 value, mm_u32 size)
+{
+    if (mm_memmap_host_write_ptr(jit->map, addr, size) == 0 ||
+        !mm_memmap_write(jit->map, jit->sec, addr, size, value)) {
+        return 0;
+    }
+    if (addr < jit->run_hi && addr + size > jit->run_lo) {
+        return 2;
+    }
+    return 1;
+}
+
+static mm_u32 jit_cond(mm_u32 xpsr, mm_u32 cond)
+{
+    mm_bool n = (xpsr & (1u << 31)) != 0u;
+    mm_bool z = (xpsr & (1u << 30)) != 0u;
+    mm_bool c = (xpsr & (1u << 29)) != 0u;
+    mm_bool v = (xpsr & (1u << 28)) != 0u;
+    mm_bool take;
+    switch (cond) {
+        case MM_COND_EQ: take = z; break;
+        case MM_COND_NE: take = !z; break;
+        case MM_COND_CS: take = c; break;
+        case MM_COND_CC: take = !c; break;
+        case MM_COND_MI: take = n; break;
+        case MM_COND_PL: take = !n; break;
+        case MM_COND_VS: take = v; break;
+        case MM_COND_VC: take = !v; break;
+        case MM_COND_HI: take = c && !z; break;
+        case MM_COND_LS: take = !c || z; break;
+        case MM_COND_GE: take = (n == v); break;
+        case MM_COND_LT: take = (n != v); break;
+        case MM_COND_GT: take = !z && (n == v); break;
+        case MM_COND_LE: take = z || (n != v); break;
+        case MM_COND_AL: take = MM_TRUE; break;
+        default: take = MM_FALSE; break;
+    }
+    return take ? 1u : 0u;
+}
+
+/* Exit taken when a helper declines an access: instruction 'k' (at pc) has
+ * not executed.
+ */
+static void emit_bail(struct emit *e, mm_u32 pc, mm_u32 k)
+{
+    mm_u8 *skip;
+    e8(e, 0x85); e8(e, 0xd2);                   /* test edx, edx */
+    skip = jump_fwd(e, 0x75);                   /* jnz */
+    emit_exit(e, pc, k);
+    jump_here(e, skip);
+}
+
+static void emit_load(struct emit *e, const struct mm_decoded *d, mm_u32 size, mm_u32 pc, mm_u32 k)
+{
+    e8(e, 0x4c); e8(e, 0x89); e8(e, 0xe7);      /* mov rdi, r12 */
+    ld_cpu(e, X_ESI, OFF_R(d->rn));
+    e8(e, 0x81); e8(e, 0xc6); e32(e, d->imm);   /* add esi, imm */
+    mov_imm(e, X_EDX, size);
+    emit_call(e, (mm_u64)(size_t)jit_load);
+    e8(e, 0x48); e8(e, 0x89); e8(e, 0xc2);      /* mov rdx, rax */
+    e8(e, 0x48); e8(e, 0xc1); e8(e, 0xea); e8(e, 32); /* shr rdx, 32 */
+    emit_bail(e, pc, k);
+    st_cpu(e, X_EAX, OFF_R(d->rd));
+}
+
+static void emit_store(struct emit *e, const struct mm_decoded *d, mm_u32 size, mm_u32 pc, mm_u32 k)
+{
+    mm_u8 *cont;
+    e8(e, 0x4c); e8(e, 0x89); e8(e, 0xe7);      /* mov rdi, r12 */
+    ld_cpu(e, X_ESI, OFF_R(d->rn));
+    e8(e, 0x81); e8(e, 0xc6); e32(e, d->imm);   /* add esi, imm */
+    ld_cpu(e, X_EDX, OFF_R(d->rd));
+    mov_imm(e, X_ECX, size);
+    emit_call(e, (mm_u64)(size_t)jit_store);
+    e8(e, 0x89); e8(e, 0xc2);                   /* mov edx, eax */
+    emit_bail(e, pc, k);
+    e8(e, 0x83); e8(e, 0xf8); e8(e, 0x01);      /* cmp eax, 1 */
+    cont = jump_fwd(e, 0x74);                   /* je */
+    emit_exit(e, pc + 2u, k + 1u);
+    jump_here(e, cont);
+}
+
+/* eax = Rn op (Rm or imm), optional store to Rd. */
+static void emit_alu(struct emit *e, const struct mm_decoded *d, mm_u32 op_reg, mm_u32 op_imm,
+                     mm_bool use_imm, mm_bool write)
+{
+    ld_cpu(e, X_EAX, OFF_R(d->rn));
+    if (use_imm) {
+        e8(e, op_imm);
+        e32(e, d->imm);
+    } else {
+        ld_cpu(e, X_ECX, OFF_R(d->rm));
+        e8(e, op_reg);
+        e8(e, 0xc8);                            /* eax, ecx */
+    }
+    if (write) {
+        st_cpu(e, X_EAX, OFF_R(d->rd));
+    }
+}
+
+static mm_bool low_regs_ok(const struct mm_decoded *d, mm_bool uses_rm)
+{
+    return d->rd < 13u && d->rn < 15u && (!uses_rm || d->rm < 15u);
+}
+
+/* Emit one non-branch instruction; MM_FALSE when it is not translated. */
+static mm_bool emit_insn(struct emit *e, const struct mm_decoded *d, mm_u32 pc, mm_u32 k)
+{
+    switch (d->kind) {
+    case MM_OP_MOV_IMM:
+        if (d->rd >= 13u) return MM_FALSE;
+        st_cpu_imm(e, OFF_R(d->rd), d->imm);
+        return MM_TRUE;
+    case MM_OP_MOV_REG:
+        if (d->rd >= 13u || d->rm >= 15u) return MM_FALSE;
+        ld_cpu(e, X_EAX, OFF_R(d->rm));
+        st_cpu(e, X_EAX, OFF_R(d->rd));
+        return MM_TRUE;
+    case MM_OP_ADD_IMM:
+        if (!low_regs_ok(d, MM_FALSE)) return MM_FALSE;
+        emit_alu(e, d, 0, 0x05, MM_TRUE, MM_TRUE);
+        emit_flags_nzcv(e, MM_FALSE);
+        return MM_TRUE;
+    case MM_OP_SUB_IMM:
+        if (!low_regs_ok(d, MM_FALSE)) return MM_FALSE;
+        emit_alu(e, d, 0, 0x2d, MM_TRUE, MM_TRUE);
+        emit_flags_nzcv(e, MM_TRUE);
+        return MM_TRUE;
+    case MM_OP_CMP_IMM:
+        if (d->rn >= 15u) return MM_FALSE;
+        emit_alu(e, d, 0, 0x3d, MM_TRUE, MM_FALSE);
+        emit_flags_nzcv(e, MM_TRUE);
+        return MM_TRUE;
+    case MM_OP_ADD_REG:
+        if (!low_regs_ok(d, MM_TRUE)) return MM_FALSE;
+        emit_alu(e, d, 0x01, 0, MM_FALSE, MM_TRUE);
+        /* ADD (high registers) leaves the flags alone. */
+        if ((d->raw & 0xfc00u) != 0x4400u) {
+            emit_flags_nzcv(e, MM_FALSE);
+        }
+        return MM_TRUE;
+    case MM_OP_SUB_REG:
+        if (!low_regs_ok(d, MM_TRUE)) return MM_FALSE;
+        emit_alu(e, d, 0x29, 0, MM_FALSE, MM_TRUE);
+        emit_flags_nzcv(e, MM_TRUE);
+        return MM_TRUE;
+    case MM_OP_CMP_REG:
+        if (d->rn >= 15u || d->rm >= 15u) return MM_FALSE;
+        emit_alu(e, d, 0x39, 0, MM_FALSE, MM_FALSE);
+        emit_flags_nzcv(e, MM_TRUE);
+        return MM_TRUE;
+    case MM_OP_AND_REG:
+    case MM_OP_EOR_REG:
+    case MM_OP_ORR_REG:
+        if (!low_regs_ok(d, MM_TRUE)) return MM_FALSE;
+        emit_alu(e, d, (d->kind == MM_OP_AND_REG) ? 0x21 : (d->kind == MM_OP_EOR_REG) ? 0x31 : 0x09,
+                 0, MM_FALSE, MM_TRUE);
+        emit_flags_nz(e);
+        return MM_TRUE;
+    case MM_OP_TST_REG:
+        if (d->rn >= 15u || d->rm >= 15u) return MM_FALSE;
+        emit_alu(e, d, 0x85, 0, MM_FALSE, MM_FALSE);
+        emit_flags_nz(e);
+        return MM_TRUE;
+    case MM_OP_LDR_IMM:
+    case MM_OP_LDRB_IMM:
+    case MM_OP_LDRH_IMM:
+        if (!low_regs_ok(d, MM_FALSE)) return MM_FALSE;
+        emit_load(e, d, (d->kind == MM_OP_LDR_IMM) ? 4u : (d->kind == MM_OP_LDRH_IMM) ? 2u : 1u, pc, k);
+        return MM_TRUE;
+    case MM_OP_STR_IMM:
+    case MM_OP_STRB_IMM:
+    case MM_OP_STRH_IMM:
+        if (d->rd >= 15u || d->rn >= 15u) return MM_FALSE;
+        emit_store(e, d, (d->kind == MM_OP_STR_IMM) ? 4u : (d->kind == MM_OP_STRH_IMM) ? 2u : 1u, pc, k);
+        return MM_TRUE;
+    default:
+        return MM_FALSE;
+    }
+}
+
+/* Emit the block-ending branch at pc as instruction 'k'. */
+static mm_bool emit_branch(struct emit *e, const struct mm_decoded *d, mm_u32 pc, mm_u32 k)
+{
+    mm_u32 target = (pc + 4u + d->imm) | 1u;
+    mm_u32 next = (pc + d->len) | 1u;
+    switch (d->kind) {
+    case MM_OP_B_UNCOND:
+    case MM_OP_B_UNCOND_WIDE:
+        emit_exit(e, target, k + 1u);
+        return MM_TRUE;
+    case MM_OP_B_COND:
+    case MM_OP_B_COND_WIDE:
+        ld_cpu(e, X_EDI, OFF_XPSR);
+        mov_imm(e, X_ESI, (mm_u32)d->cond);
+        emit_call(e, (mm_u64)(size_t)jit_cond);
+        mov_imm(e, X_ECX, next);
+        mov_imm(e, X_EDX, target);
+        e8(e, 0x85); e8(e, 0xc0);               /* test eax, eax */
+        e8(e, 0x0f); e8(e, 0x45); e8(e, 0xca);  /* cmovnz ecx, edx */
+        st_cpu(e, X_ECX, OFF_R(15));
+        emit_return(e, k + 1u);
+        return MM_TRUE;
+    case MM_OP_CBZ:
+    case MM_OP_CBNZ:
+        ld_cpu(e, X_EAX, OFF_R(d->rn));
+        mov_imm(e, X_ECX, next);
+        mov_imm(e, X_EDX, target);
+        e8(e, 0x85); e8(e, 0xc0);               /* test eax, eax */
+        e8(e, 0x0f); e8(e, (d->kind == MM_OP_CBZ) ? 0x44 : 0x45); e8(e, 0xca); /* cmovz/cmovnz ecx, edx */
+        st_cpu(e, X_ECX, OFF_R(15));
+        emit_return(e, k + 1u);
+        return MM_TRUE;
+    default:
+        return MM_FALSE;
+    }
+}
+
+static mm_bool translate(struct mm_jit *jit, struct mm_jit_block *blk)
+{
+    struct emit e;
+    const mm_u8 *guest;
+    mm_u32 window = (blk->pc & ~(MM_JIT_SPAN - 1u)) + MM_JIT_SPAN;
+    mm_u32 avail = window - blk->pc;
+    mm_u32 pc = blk->pc;
+    mm_u32 k = 0;
+    mm_bool ended = MM_FALSE;
+
+    /* Code comes straight from the backing store: the caller's fetch of the
+     * first instruction already passed the execute check for this granule.
+     */
+    guest = mm_memmap_host_read_ptr(jit->map, blk->pc, avail);
+    if (guest == 0) {
+        return MM_FALSE;
+    }
+    e.p = jit->code + jit->code_used;
+    e.end = jit->code + MM_JIT_CODE_SIZE;
+    e.full = MM_FALSE;
+    /* Emitted code is position independent (calls go through rax), so it
+     * is written through one view and run through the other. */
+    blk->host = jit->exec + jit->code_used;
+    emit_prologue(&e);
+    while (k < MM_JIT_MAX_INSNS && pc + 2u <= window) {
+        struct mm_fetch_result f;
+        struct mm_decoded d;
+        mm_u32 off = pc - blk->pc;
+        mm_u32 hw1 = (mm_u32)guest[off] | ((mm_u32)guest[off + 1u] << 8);
+        memset(&f, 0, sizeof(f));
+        f.insn = hw1;
+        f.len = 2;
+        f.pc_fetch = pc;
+        if (t32_is_32bit_prefix((mm_u16)hw1)) {
+            if (pc + 4u > window) {
+                break;
+            }
+            f.insn = (hw1 << 16) | (mm_u32)guest[off + 2u] | ((mm_u32)guest[off + 3u] << 8);
+            f.len = 4;
+        }
+        d = mm_decode_t32(&f);
+        if (d.undefined) {
+            break;
+        }
+        if (emit_branch(&e, &d, pc, k)) {
+            blk->last = d;
+            blk->last_pc = pc;
+            pc += d.len;
+            k++;
+            ended = MM_TRUE;
+            break;
+        }
+        if (d.len != 2u || !emit_insn(&e, &d, pc, k)) {
+            break;
+        }
+        pc += 2u;
+        k++;
+    }
+    if (k == 0u || e.full) {
+        return MM_FALSE;
+    }
+    if (!ended) {
+        emit_exit(&e, pc, k);
+        blk->last_pc = 0;
+    }
+    if (e.full) {
+        return MM_FALSE;
+    }
+    blk->insns = k;
+    blk->span = pc - blk->pc;
+    blk->guest = guest;
+    memcpy(blk->code, guest, blk->span);
+    jit->code_used = (mm_u32)(e.p - jit->code);
+    /* Keep entry points 16-byte aligned. */
+    jit->code_used = (jit->code_used + 15u) & ~15u;
+    jit->blocks_built++;
+    return MM_TRUE;
+}
+
+mm_bool mm_jit_init(struct mm_jit *jit, struct mm_memmap *map)
+{
+    void *code = MAP_FAILED;
+    void *exec = MAP_FAILED;
+    int fd;
+    memset(jit, 0, sizeof(*jit));
+    jit->map = map;
+    jit->table = (struct mm_jit_block *)calloc(MM_JIT_TABLE_SIZE, sizeof(*jit->table));
+    if (jit->table == 0) {
+        return MM_FALSE;
+    }
+    /* W^X: one shared buffer mapped twice, writable for the emitter and
+     * executable for the host CPU; no page is ever both. */
+    fd = memfd_create("m33mu-jit", MFD_CLOEXEC);
+    if (fd >= 0 && ftruncate(fd, MM_JIT_CODE_SIZE) == 0) {
+        code = mmap(0, MM_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        exec = mmap(0, MM_JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (code == MAP_FAILED || exec == MAP_FAILED) {
+        if (code != MAP_FAILED) {
+            munmap(code, MM_JIT_CODE_SIZE);
+        }
+        if (exec != MAP_FAILED) {
+            munmap(exec, MM_JIT_CODE_SIZE);
+        }
+        free(jit->table);
+        jit->table = 0;
+        return MM_FALSE;
+    }
+    jit->code = (mm_u8 *)code;
+    jit->exec = (mm_u8 *)exec;
+    jit->enabled = MM_TRUE;
+    return MM_TRUE;
+}
+
+void mm_jit_free(struct mm_jit *jit)
+{
+    if (jit->code != 0) {
+        munmap(jit->code, MM_JIT_CODE_SIZE);
+    }
+    if (jit->exec != 0) {
+        munmap(jit->exec, MM_JIT_CODE_SIZE);
+    }
+    free(jit->table);
+    memset(jit, 0, sizeof(*jit));
+}
+
+void mm_jit_flush(struct mm_jit *jit)
+{
+    if (jit->table == 0) {
+        return;
+    }
+    memset(jit->table, 0, MM_JIT_TABLE_SIZE * sizeof(*jit->table));
+    if (jit->code_used != 0u) {
+        jit->flushes++;
+    }
+    jit->code_used = 0;
+}
+
+void mm_jit_invalidate(struct mm_jit *jit, mm_u32 addr, mm_u32 len)
+{
+    mm_u32 i;
+    mm_u64 end = (mm_u64)addr + len;
+    if (jit->table == 0) {
+        return;
+    }
+    for (i = 0; i < MM_JIT_TABLE_SIZE; ++i) {
+        struct mm_jit_block *blk = &jit->table[i];
+        if (blk->state == MM_JIT_READY && blk->pc < end && addr < blk->pc + blk->span) {
+            blk->state = MM_JIT_EMPTY;
+        }
+    }
+}
+
+struct mm_jit_block *mm_jit_lookup(struct mm_jit *jit, const struct mm_cpu *cpu, mm_u32 pc_fetch)
+{
+    struct mm_jit_block *blk;
+    if (!jit->enabled) {
+        return 0;
+    }
+    blk = &jit->table[(pc_fetch >> 1) & (MM_JIT_TABLE_SIZE - 1u)];
+    if (blk->state == MM_JIT_EMPTY || blk->pc != pc_fetch || blk->sec != (mm_u8)cpu->sec_state) {
+        memset(blk, 0, sizeof(*blk));
+        blk->pc = pc_fetch;
+        blk->sec = (mm_u8)cpu->sec_state;
+        blk->state = MM_JIT_COUNTING;
+        blk->hits = 1;
+        return 0;
+    }
+    if (blk->state == MM_JIT_READY) {
+        if (memcmp(blk->guest, blk->code, blk->span) == 0) {
+            return blk;
+        }
+        /* The guest code changed underneath: count it up again. */
+        blk->state = MM_JIT_COUNTING;
+        blk->hits = 0;
+    }
+    if (blk->state != MM_JIT_COUNTING || ++blk->hits < MM_JIT_HOT_COUNT) {
+        return 0;
+    }
+    if (jit->code_used + MM_JIT_BLOCK_MAX > MM_JIT_CODE_SIZE) {
+        mm_jit_flush(jit);
+        blk->pc = pc_fetch;
+        blk->sec = (mm_u8)cpu->sec_state;
+    }
+    jit->sec = cpu->sec_state;
+    blk->state = translate(jit, blk) ? MM_JIT_READY : MM_JIT_REJECTED;
+    return (blk->state == MM_JIT_READY) ? blk : 0;
+}
+
+mm_u32 mm_jit_exec(struct mm_jit *jit, struct mm_cpu *cpu, struct mm_jit_block *blk)
+{
+    jit_block_fn fn;
+    mm_u32 retired;
+    memcpy(&fn, &blk->host, sizeof(fn));
+    jit->sec = cpu->sec_state;
+    jit->run_lo = blk->pc;
+    jit->run_hi = blk->pc + blk->span;
+    retired = fn(cpu, jit);
+    jit->blocks_run++;
+    jit->insns_run += retired;
+    if (retired == blk->insns && blk->last_pc != 0u) {
+        jit->last = &blk->last;
+        jit->last_pc = blk->last_pc;
+    } else {
+        jit->last = 0;
+        jit->last_pc = 0;
+    }
+    return retired;
+}
+
+void mm_jit_report(const struct mm_jit *jit)
+{
+    if (!jit->enabled || jit->blocks_run == 0u) {
+        return;
+    }
+    fprintf(stderr, "[JIT] %llu blocks translated, %llu block runs, %llu instructions, %llu flushes\n",
+            (unsigned long long)jit->blocks_built,
+            (unsigned long long)jit->blocks_run,
+            (unsigned long long)jit->insns_run,
+            (unsigned long long)jit->flushes);
+}
+
+#else /* no host backend */
+
+mm_bool mm_jit_init(struct mm_jit *jit, struct mm_memmap *map)
+{
+    memset(jit, 0, sizeof(*jit));
+    jit->map = map;
+    return MM_FALSE;
+}
+
+void mm_jit_free(struct mm_jit *jit)
+{
+    memset(jit, 0, sizeof(*jit));
+}
+
+void mm_jit_flush(struct mm_jit *jit)
+{
+    (void)jit;
+}
+
+void mm_jit_invalidate(struct mm_jit *jit, mm_u32 addr, mm_u32 len)
+{
+    (void)jit;
+    (void)addr;
+    (void)len;
+}
+
+struct mm_jit_block *mm_jit_lookup(struct mm_jit *jit, const struct mm_cpu *cpu, mm_u32 pc_fetch)
+{
+    (void)jit;
+    (void)cpu;
+    (void)pc_fetch;
+    return 0;
+}
+
+mm_u32 mm_jit_exec(struct mm_jit *jit, struct mm_cpu *cpu, struct mm_jit_block *blk)
+{
+    (void)jit;
+    (void)cpu;
+    (void)blk;
+    return 0;
+}
+
+void mm_jit_report(const struct mm_jit *jit)
+{
+    (void)jit;
+}
+
+#endif
@@ -0,0 +1,515 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <string.h>
+#include "m33mu/bignum.h"
+
+int mm_bn_cmp(const mm_u32 *a, const mm_u32 *b, mm_u32 n)
+{
+    while (n > 0u) {
+        --n;
+        if (a[n] != b[n]) {
+            return (a[n] > b[n]) ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+mm_bool mm_bn_is_zero(const mm_u32 *a, mm_u32 n)
+{
+    mm_u32 i;
+    for (i = 0; i < n; ++i) {
+        if (a[i] != 0u) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+mm_u32 mm_bn_bits(const mm_u32 *a, mm_u32 n)
+{
+    while (n > 0u) {
+        mm_u32 w = a[--n];
+        if (w != 0u) {
+            mm_u32 bits = 32u * n;
+            while (w != 0u) {
+                bits++;
+                w >>= 1;
+            }
+            return bits;
+        }
+    }
+    return 0;
+}
+
+static mm_u32 bn_add(mm_u32 *r, const mm_u32 *a, const mm_u32 *b, mm_u32 n)
+{
+    mm_u64 c = 0;
+    mm_u32 i;
+    for (i = 0; i < n; ++i) {
+        c += (mm_u64)a[i] + b[i];
+        r[i] = (mm_u32)c;
+        c >>= 32;
+    }
+    return (mm_u32)c;
+}
+
+static mm_u32 bn_sub(mm_u32 *r, const mm_u32 *a, const mm_u32 *b, mm_u32 n)
+{
+    mm_u64 borrow = 0;
+    mm_u32 i;
+    for (i = 0; i < n; ++i) {
+        mm_u64 d = (mm_u64)a[i] - b[i] - borrow;
+        r[i] = (mm_u32)d;
+        borrow = (d >> 32) & 1u;
+    }
+    return (mm_u32)borrow;
+}
+
+void mm_bn_mod(mm_u32 *r, const mm_u32 *a, mm_u32 a_words, const mm_u32 *m, mm_u32 m_words)
+{
+    mm_u32 acc[MM_BN_MAX_WORDS + 1];
+    mm_u32 mm[MM_BN_MAX_WORDS + 1];
+    mm_u32 bits = mm_bn_bits(a, a_words);
+    mm_u32 i;
+
+    memset(acc, 0, sizeof(acc));
+    memset(mm, 0, sizeof(mm));
+    memcpy(mm, m, m_words * 4u);
+    /* Shift-and-subtract; acc stays below m, so one spare word is enough. */
+    while (bits > 0u) {
+        mm_u32 carry;
+        --bits;
+        carry = (a[bits / 32u] >> (bits % 32u)) & 1u;
+        for (i = 0; i <= m_words; ++i) {
+            mm_u32 next = acc[i] >> 31;
+            acc[i] = (acc[i] << 1) | carry;
+            carry = next;
+        }
+        if (mm_bn_cmp(acc, mm, m_words + 1u) >= 0) {
+            bn_sub(acc, acc, mm, m_words + 1u);
+        }
+    }
+    memcpy(r, acc, m_words * 4u);
+}
+
+mm_bool mm_mont_init(struct mm_mont *ctx, const mm_u32 *mod, mm_u32 n)
+{
+    mm_u32 inv = 1;
+    mm_u32 i;
+    mm_u32 one[MM_BN_MAX_WORDS];
+
+    if (n == 0u || n > MM_BN_MAX_WORDS || (mod[0] & 1u) == 0u || mm_bn_bits(mod, n) < 2u) {
+        return MM_FALSE;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->n = n;
+    memcpy(ctx->m, mod, n * 4u);
+    for (i = 0; i < 5u; ++i) {
+        inv *= 2u - mod[0] * inv;
+    }
+    ctx->m0inv = (mm_u32)(0u - inv);
+    /* R^2 mod m by doubling 1 2*32*n times. */
+    ctx->rr[0] = 1u;
+    for (i = 0; i < 64u * n; ++i) {
+        mm_u32 carry = bn_add(ctx->rr, ctx->rr, ctx->rr, n);
+        if (carry != 0u || mm_bn_cmp(ctx->rr, ctx->m, n) >= 0) {
+            bn_sub(ctx->rr, ctx->rr, ctx->m, n);
+        }
+    }
+    memset(one, 0, sizeof(one));
+    one[0] = 1u;
+    mm_mont_mul(ctx, ctx->one, ctx->rr, one);
+    return MM_TRUE;
+}
+
+void mm_mont_mul(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a, const mm_u32 *b)
+{
+    mm_u32 t[MM_BN_MAX_WORDS + 2];
+    mm_u32 n = ctx->n;
+    mm_u32 i;
+    mm_u32 j;
+
+    memset(t, 0, (n + 2u) * 4u);
+    for (i = 0; i < n; ++i) {
+        mm_u64 c = 0;
+        mm_u32 q;
+        for (j = 0; j < n; ++j) {
+            c += (mm_u64)t[j] + (mm_u64)a[j] * b[i];
+            t[j] = (mm_u32)c;
+            c >>= 32;
+        }
+        c += t[n];
+        t[n] = (mm_u32)c;
+        t[n + 1u] = (mm_u32)(c >> 32);
+        q = t[0] * ctx->m0inv;
+        c = ((mm_u64)t[0] + (mm_u64)q * ctx->m[0]) >> 32;
+        for (j = 1; j < n; ++j) {
+            c += (mm_u64)t[j] + (mm_u64)q * ctx->m[j];
+            t[j - 1u] = (mm_u32)c;
+            c >>= 32;
+        }
+        c += t[n];
+        t[n - 1u] = (mm_u32)c;
+        t[n] = t[n + 1u] + (mm_u32)(c >> 32);
+    }
+    if (t[n] != 0u || mm_bn_cmp(t, ctx->m, n) >= 0) {
+        bn_sub(t, t, ctx->m, n);
+    }
+    memcpy(r, t, n * 4u);
+}
+
+void mm_mont_to(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a)
+{
+    mm_mont_mul(ctx, r, a, ctx->rr);
+}
+
+void mm_mont_from(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a)
+{
+    mm_u32 one[MM_BN_MAX_WORDS];
+    memset(one, 0, ctx->n * 4u);
+    one[0] = 1u;
+    mm_mont_mul(ctx, r, a, one);
+}
+
+void mm_mont_exp(const struct mm_mont *ctx, mm_u32 *r, const mm_u32 *a, const mm_u32 *e, mm_u32 e_bits)
+{
+    mm_u32 acc[MM_BN_MAX_WORDS];
+    mm_u32 base[MM_BN_MAX_WORDS];
+
+    memcpy(base, a, ctx->n * 4u);
+    memcpy(acc, ctx->one, ctx->n * 4u);
+    while (e_bits > 0u) {
+        --e_bits;
+        mm_mont_mul(ctx, acc, acc, acc);
+        if ((e[e_bits / 32u] >> (e_bits % 32u)) & 1u) {
+            mm_mont_mul(ctx, acc, acc, base);
+        }
+    }
+    memcpy(r, acc, ctx->n * 4u);
+}
+
+mm_bool mm_bn_modexp(mm_u32 *r, const mm_u32 *base, const mm_u32 *e, mm_u32 e_bits,
+                     const mm_u32 *mod, mm_u32 n)
+{
+    static struct mm_mont ctx;
+    mm_u32 b[MM_BN_MAX_WORDS];
+
+    if (!mm_mont_init(&ctx, mod, n)) {
+        return MM_FALSE;
+    }
+    mm_bn_mod(b, base, n, mod, n);
+    mm_mont_to(&ctx, b, b);
+    mm_mont_exp(&ctx, b, b, e, e_bits);
+    mm_mont_from(&ctx, r, b);
+    return MM_TRUE;
+}
+
+/* ---- elliptic curves ------------------------------------------------- */
+
+struct ec_jac {
+    mm_u32 x[MM_EC_MAX_WORDS];
+    mm_u32 y[MM_EC_MAX_WORDS];
+    mm_u32 z[MM_EC_MAX_WORDS];  /* zero for the point at infinity */
+};
+
+static void fadd(const struct mm_mont *p, mm_u32 *r, const mm_u32 *a, const mm_u32 *b)
+{
+    mm_u32 carry = bn_add(r, a, b, p->n);
+    if (carry != 0u || mm_bn_cmp(r, p->m, p->n) >= 0) {
+        bn_sub(r, r, p->m, p->n);
+    }
+}
+
+static void fsub(const struct mm_mont *p, mm_u32 *r, const mm_u32 *a, const mm_u32 *b)
+{
+    if (bn_sub(r, a, b, p->n) != 0u) {
+        bn_add(r, r, p->m, p->n);
+    }
+}
+
+static void ec_double(const struct mm_ec_curve *c, struct ec_jac *r, const struct ec_jac *pt)
+{
+    const struct mm_mont *p = &c->p;
+    mm_u32 xx[MM_EC_MAX_WORDS], yy[MM_EC_MAX_WORDS], yyyy[MM_EC_MAX_WORDS], zz[MM_EC_MAX_WORDS];
+    mm_u32 s[MM_EC_MAX_WORDS], m[MM_EC_MAX_WORDS], t[MM_EC_MAX_WORDS];
+    mm_u32 x3[MM_EC_MAX_WORDS], y3[MM_EC_MAX_WORDS], z3[MM_EC_MAX_WORDS];
+
+    if (mm_bn_is_zero(pt->z, p->n) || mm_bn_is_zero(pt->y, p->n)) {
+        memset(r, 0, sizeof(*r));
+        return;
+    }
+    mm_mont_mul(p, xx, pt->x, pt->x);
+    mm_mont_mul(p, yy, pt->y, pt->y);
+    mm_mont_mul(p, yyyy, yy, yy);
+    mm_mont_mul(p, zz, pt->z, pt->z);
+    /* S = 4*X*YY */
+    mm_mont_mul(p, s, pt->x, yy);
+    fadd(p, s, s, s);
+    fadd(p, s, s, s);
+    /* M = 3*XX + a*ZZ^2 */
+    fadd(p, m, xx, xx);
+    fadd(p, m, m, xx);
+    mm_mont_mul(p, t, zz, zz);
+    mm_mont_mul(p, t, t, c->a);
+    fadd(p, m, m, t);
+    /* X3 = M^2 - 2S */
+    mm_mont_mul(p, x3, m, m);
+    fsub(p, x3, x3, s);
+    fsub(p, x3, x3, s);
+    /* Y3 = M*(S - X3) - 8*YYYY */
+    fsub(p, t, s, x3);
+    mm_mont_mul(p, y3, m, t);
+    fadd(p, yyyy, yyyy, yyyy);
+    fadd(p, yyyy, yyyy, yyyy);
+    fadd(p, yyyy, yyyy, yyyy);
+    fsub(p, y3, y3, yyyy);
+    /* Z3 = 2*Y*Z */
+    mm_mont_mul(p, z3, pt->y, pt->z);
+    fadd(p, z3, z3, z3);
+    memcpy(r->x, x3, sizeof(x3));
+    memcpy(r->y, y3, sizeof(y3));
+    memcpy(r->z, z3, sizeof(z3));
+}
+
+static void ec_add(const struct mm_ec_curve *c, struct ec_jac *r, const struct ec_jac *a, const struct ec_jac *b)
+{
+    const struct mm_mont *p = &c->p;
+    mm_u32 z1z1[MM_EC_MAX_WORDS], z2z2[MM_EC_MAX_WORDS], u1[MM_EC_MAX_WORDS], u2[MM_EC_MAX_WORDS];
+    mm_u32 s1[MM_EC_MAX_WORDS], s2[MM_EC_MAX_WORDS], h[MM_EC_MAX_WORDS], rr[MM_EC_MAX_WORDS];
+    mm_u32 hh[MM_EC_MAX_WORDS], hhh[MM_EC_MAX_WORDS], v[MM_EC_MAX_WORDS], t[MM_EC_MAX_WORDS];
+    struct ec_jac out;
+
+    if (mm_bn_is_zero(a->z, p->n)) {
+        *r = *b;
+        return;
+    }
+    if (mm_bn_is_zero(b->z, p->n)) {
+        *r = *a;
+        return;
+    }
+    mm_mont_mul(p, z1z1, a->z, a->z);
+    mm_mont_mul(p, z2z2, b->z, b->z);
+    mm_mont_mul(p, u1, a->x, z2z2);
+    mm_mont_mul(p, u2, b->x, z1z1);
+    mm_mont_mul(p, s1, a->y, b->z);
+    mm_mont_mul(p, s1, s1, z2z2);
+    mm_mont_mul(p, s2, b->y, a->z);
+    mm_mont_mul(p, s2, s2, z1z1);
+    fsub(p, h, u2, u1);
+    fsub(p, rr, s2, s1);
+    if (mm_bn_is_zero(h, p->n)) {
+        if (mm_bn_is_zero(rr, p->n)) {
+            ec_double(c, r, a);
+        } else {
+            memset(r, 0, sizeof(*r));
+        }
+        return;
+    }
+    memset(&out, 0, sizeof(out));
+    mm_mont_mul(p, hh, h, h);
+    mm_mont_mul(p, hhh, hh, h);
+    mm_mont_mul(p, v, u1, hh);
+    /* X3 = R^2 - H^3 - 2*U1*H^2 */
+    mm_mont_mul(p, out.x, rr, rr);
+    fsub(p, out.x, out.x, hhh);
+    fsub(p, out.x, out.x, v);
+    fsub(p, out.x, out.x, v);
+    /* Y3 = R*(V - X3) - S1*H^3 */
+    fsub(p, t, v, out.x);
+    mm_mont_mul(p, out.y, rr, t);
+    mm_mont_mul(p, t, s1, hhh);
+    fsub(p, out.y, out.y, t);
+    /* Z3 = H*Z1*Z2 */
+    mm_mont_mul(p, out.z, a->z, b->z);
+    mm_mont_mul(p, out.z, out.z, h);
+    *r = out;
+}
+
+static void ec_scalar(const struct mm_ec_curve *c, struct ec_jac *r, const mm_u32 *k, mm_u32 k_bits,
+                      const struct ec_jac *pt)
+{
+    struct ec_jac acc;
+    memset(&acc, 0, sizeof(acc));
+    while (k_bits > 0u) {
+        --k_bits;
+        ec_double(c, &acc, &acc);
+        if ((k[k_bits / 32u] >> (k_bits % 32u)) & 1u) {
+            ec_add(c, &acc, &acc, pt);
+        }
+    }
+    *r = acc;
+}
+
+static void ec_from_affine(const struct mm_ec_curve *c, struct ec_jac *r, const mm_u32 *x, const mm_u32 *y)
+{
+    memset(r, 0, sizeof(*r));
+    mm_mont_to(&c->p, r->x, x);
+    mm_mont_to(&c->p, r->y, y);
+    memcpy(r->z, c->p.one, c->p.n * 4u);
+}
+
+static mm_bool ec_to_affine(const struct mm_ec_curve *c, mm_u32 *x, mm_u32 *y, const struct ec_jac *pt)
+{
+    const struct mm_mont *p = &c->p;
+    mm_u32 e[MM_EC_MAX_WORDS], zi[MM_EC_MAX_WORDS], zi2[MM_EC_MAX_WORDS], t[MM_EC_MAX_WORDS];
+    mm_u32 two[MM_EC_MAX_WORDS];
+
+    if (mm_bn_is_zero(pt->z, p->n)) {
+        return MM_FALSE;
+    }
+    memset(two, 0, sizeof(two));
+    two[0] = 2u;
+    bn_sub(e, p->m, two, p->n);
+    mm_mont_exp(p, zi, pt->z, e, mm_bn_bits(e, p->n));
+    mm_mont_mul(p, zi2, zi, zi);
+    mm_mont_mul(p, t, pt->x, zi2);
+    mm_mont_from(p, x, t);
+    mm_mont_mul(p, t, pt->y, zi2);
+    mm_mont_mul(p, t, t, zi);
+    mm_mont_from(p, y, t);
+    return MM_TRUE;
+}
+
+mm_bool mm_ec_curve_init(struct mm_ec_curve *c, const mm_u32 *p, const mm_u32 *a, const mm_u32 *b, mm_u32 n)
+{
+    mm_u32 t[MM_EC_MAX_WORDS];
+    if (n > MM_EC_MAX_WORDS || !mm_mont_init(&c->p, p, n)) {
+        return MM_FALSE;
+    }
+    memset(c->a, 0, sizeof(c->a));
+    memset(c->b, 0, sizeof(c->b));
+    mm_bn_mod(t, a, n, p, n);
+    mm_mont_to(&c->p, c->a, t);
+    mm_bn_mod(t, b, n, p, n);
+    mm_mont_to(&c->p, c->b, t);
+    return MM_TRUE;
+}
+
+mm_bool mm_ec_on_curve(const struct mm_ec_curve *c, const mm_u32 *x, const mm_u32 *y)
+{
+    const struct mm_mont *p = &c->p;
+    mm_u32 xm[MM_EC_MAX_WORDS], ym[MM_EC_MAX_WORDS], lhs[MM_EC_MAX_WORDS], rhs[MM_EC_MAX_WORDS];
+    mm_u32 t[MM_EC_MAX_WORDS];
+
+    if (mm_bn_cmp(x, p->m, p->n) >= 0 || mm_bn_cmp(y, p->m, p->n) >= 0) {
+        return MM_FALSE;
+    }
+    mm_mont_to(p, xm, x);
+    mm_mont_to(p, ym, y);
+    mm_mont_mul(p, lhs, ym, ym);
+    mm_mont_mul(p, rhs, xm, xm);
+    mm_mont_mul(p, rhs, rhs, xm);
+    mm_mont_mul(p, t, c->a, xm);
+    fadd(p, rhs, rhs, t);
+    fadd(p, rhs, rhs, c->b);
+    return (mm_bn_cmp(lhs, rhs, p->n) == 0) ? MM_TRUE : MM_FALSE;
+}
+
+mm_bool mm_ec_mul(const struct mm_ec_curve *c, mm_u32 *rx, mm_u32 *ry,
+                  const mm_u32 *k, mm_u32 k_bits, const mm_u32 *x, const mm_u32 *y)
+{
+    struct ec_jac pt;
+    ec_from_affine(c, &pt, x, y);
+    ec_scalar(c, &pt, k, k_bits, &pt);
+    return ec_to_affine(c, rx, ry, &pt);
+}
+
+mm_bool mm_ecdsa_verify(const struct mm_ec_curve *c, const mm_u32 *order, mm_u32 n_words,
+                        const mm_u32 *gx, const mm_u32 *gy, const mm_u32 *qx, const mm_u32 *qy,
+                        const mm_u32 *r, const mm_u32 *s, const mm_u32 *e)
+{
+    static struct mm_mont nctx;
+    mm_u32 w[MM_BN_MAX_WORDS], u1[MM_BN_MAX_WORDS], u2[MM_BN_MAX_WORDS], t[MM_BN_MAX_WORDS];
+    mm_u32 two[MM_BN_MAX_WORDS];
+    mm_u32 x[MM_EC_MAX_WORDS], y[MM_EC_MAX_WORDS];
+    struct ec_jac g, q, a, b;
+
+    if (n_words > MM_EC_MAX_WORDS + 1u || !mm_mont_init(&nctx, order, n_words)) {
+        return MM_FALSE;
+    }
+    if (mm_bn_is_zero(r, n_words) || mm_bn_is_zero(s, n_words) ||
+        mm_bn_cmp(r, order, n_words) >= 0 || mm_bn_cmp(s, order, n_words) >= 0) {
+        return MM_FALSE;
+    }
+    /* w = s^(n-2) mod n; the order is prime. */
+    memset(two, 0, sizeof(two));
+    two[0] = 2u;
+    bn_sub(t, order, two, n_words);
+    mm_mont_to(&nctx, w, s);
+    mm_mont_exp(&nctx, w, w, t, mm_bn_bits(t, n_words));
+    mm_bn_mod(t, e, n_words, order, n_words);
+    mm_mont_mul(&nctx, u1, t, w);       /* plain * mont -> plain */
+    mm_mont_mul(&nctx, u2, r, w);
+
+    ec_from_affine(c, &g, gx, gy);
+    ec_from_affine(c, &q, qx, qy);
+    ec_scalar(c, &a, u1, mm_bn_bits(u1, n_words), &g);
+    ec_scalar(c, &b, u2, mm_bn_bits(u2, n_words), &q);
+    ec_add(c, &a, &a, &b);
+    if (!ec_to_affine(c, x, y, &a)) {
+        return MM_FALSE;
+    }
+    memset(t, 0, sizeof(t));
+    mm_bn_mod(t, x, c->p.n, order, n_words);
+    return (mm_bn_cmp(t, r, n_words) == 0) ? MM_TRUE : MM_FALSE;
+}
+
+mm_bool mm_ecdsa_sign(const struct mm_ec_curve *c, const mm_u32 *order, mm_u32 n_words,
+                      const mm_u32 *gx, const mm_u32 *gy, const mm_u32 *d, const mm_u32 *k,
+                      const mm_u32 *e, mm_u32 *r, mm_u32 *s)
+{
+    static struct mm_mont nctx;
+    mm_u32 kinv[MM_BN_MAX_WORDS], t[MM_BN_MAX_WORDS], u[MM_BN_MAX_WORDS], two[MM_BN_MAX_WORDS];
+    mm_u32 x[MM_EC_MAX_WORDS], y[MM_EC_MAX_WORDS];
+
+    if (n_words > MM_EC_MAX_WORDS + 1u || !mm_mont_init(&nctx, order, n_words)) {
+        return MM_FALSE;
+    }
+    if (mm_bn_is_zero(k, n_words) || mm_bn_cmp(k, order, n_words) >= 0) {
+        return MM_FALSE;
+    }
+    if (!mm_ec_mul(c, x, y, k, mm_bn_bits(k, n_words), gx, gy)) {
+        return MM_FALSE;
+    }
+    memset(r, 0, n_words * 4u);
+    mm_bn_mod(r, x, c->p.n, order, n_words);
+    if (mm_bn_is_zero(r, n_words)) {
+        return MM_FALSE;
+    }
+    /* s = k^-1 * (e + r*d) mod n */
+    memset(two, 0, sizeof(two));
+    two[0] = 2u;
+    bn_sub(t, order, two, n_words);
+    mm_mont_to(&nctx, kinv, k);
+    mm_mont_exp(&nctx, kinv, kinv, t, mm_bn_bits(t, n_words));
+    mm_bn_mod(u, d, n_words, order, n_words);
+    mm_mont_to(&nctx, u, u);
+    mm_mont_mul(&nctx, t, r, u);            /* r*d, plain */
+    mm_bn_mod(u, e, n_words, order, n_words);
+    if (bn_add(t, t, u, n_words) != 0u || mm_bn_cmp(t, order, n_words) >= 0) {
+        bn_sub(t, t, order, n_words);
+    }
+    mm_mont_mul(&nctx, s, t, kinv);
+    return mm_bn_is_zero(s, n_words) ? MM_FALSE : MM_TRUE;
+}
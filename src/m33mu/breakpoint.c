@@ -0,0 +1,207 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include "m33mu/breakpoint.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BP_EMPTY 0u
+#define BP_TOMB  1u
+
+static mm_u32 bp_key(mm_u32 pc)
+{
+    /* Thumb PCs always carry bit0 so a valid key is never EMPTY/TOMB. */
+    return (pc & ~1u) | 1u;
+}
+
+static mm_u32 bp_hash(mm_u32 key)
+{
+    mm_u32 h = key >> 1;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+static mm_u32 bp_filter_bit(mm_u32 key)
+{
+    return (key >> 1) & (MM_BP_FILTER_BITS - 1u);
+}
+
+static void bp_filter_rebuild(struct mm_bp_set *set)
+{
+    mm_u32 i;
+    memset(set->filter, 0, sizeof(set->filter));
+    for (i = 0; i < set->cap; ++i) {
+        mm_u32 k = set->slots[i];
+        if (k != BP_EMPTY && k != BP_TOMB) {
+            mm_u32 bit = bp_filter_bit(k);
+            set->filter[bit >> 5] |= (1u << (bit & 31u));
+        }
+    }
+}
+
+static mm_u32 *bp_find(const struct mm_bp_set *set, mm_u32 key)
+{
+    mm_u32 mask;
+    mm_u32 idx;
+    mm_u32 n;
+    if (set->cap == 0u) {
+        return 0;
+    }
+    mask = set->cap - 1u;
+    idx = bp_hash(key) & mask;
+    for (n = 0; n < set->cap; ++n) {
+        mm_u32 k = set->slots[idx];
+        if (k == key) {
+            return &set->slots[idx];
+        }
+        if (k == BP_EMPTY) {
+            return 0;
+        }
+        idx = (idx + 1u) & mask;
+    }
+    return 0;
+}
+
+static mm_bool bp_rehash(struct mm_bp_set *set, mm_u32 new_cap)
+{
+    mm_u32 *old = set->slots;
+    mm_u32 old_cap = set->cap;
+    mm_u32 i;
+    mm_u32 *slots = (mm_u32 *)calloc(new_cap, sizeof(mm_u32));
+    if (slots == 0) {
+        return MM_FALSE;
+    }
+    set->slots = slots;
+    set->cap = new_cap;
+    set->used = set->count;
+    for (i = 0; i < old_cap; ++i) {
+        mm_u32 k = old[i];
+        if (k != BP_EMPTY && k != BP_TOMB) {
+            mm_u32 idx = bp_hash(k) & (new_cap - 1u);
+            while (slots[idx] != BP_EMPTY) {
+                idx = (idx + 1u) & (new_cap - 1u);
+            }
+            slots[idx] = k;
+        }
+    }
+    free(old);
+    return MM_TRUE;
+}
+
+void mm_bp_set_init(struct mm_bp_set *set)
+{
+    if (set == 0) return;
+    set->slots = 0;
+    set->cap = 0;
+    set->count = 0;
+    set->used = 0;
+    memset(set->filter, 0, sizeof(set->filter));
+}
+
+void mm_bp_set_free(struct mm_bp_set *set)
+{
+    if (set == 0) return;
+    free(set->slots);
+    mm_bp_set_init(set);
+}
+
+void mm_bp_set_clear(struct mm_bp_set *set)
+{
+    if (set == 0) return;
+    if (set->slots != 0) {
+        memset(set->slots, 0, (size_t)set->cap * sizeof(mm_u32));
+    }
+    set->count = 0;
+    set->used = 0;
+    memset(set->filter, 0, sizeof(set->filter));
+}
+
+mm_bool mm_bp_set_add(struct mm_bp_set *set, mm_u32 pc)
+{
+    mm_u32 key = bp_key(pc);
+    mm_u32 idx;
+    mm_u32 mask;
+    mm_u32 bit;
+    if (set == 0) {
+        return MM_FALSE;
+    }
+    if (bp_find(set, key) != 0) {
+        return MM_TRUE;
+    }
+    /* Keep load (including tombstones) under 50%. */
+    if (set->cap == 0u || (set->used + 1u) * 2u > set->cap) {
+        mm_u32 new_cap = (set->cap == 0u) ? 32u : set->cap;
+        while ((set->count + 1u) * 2u > new_cap) {
+            new_cap <<= 1;
+        }
+        if (!bp_rehash(set, new_cap)) {
+            return MM_FALSE;
+        }
+    }
+    mask = set->cap - 1u;
+    idx = bp_hash(key) & mask;
+    while (set->slots[idx] != BP_EMPTY && set->slots[idx] != BP_TOMB) {
+        idx = (idx + 1u) & mask;
+    }
+    if (set->slots[idx] == BP_EMPTY) {
+        set->used++;
+    }
+    set->slots[idx] = key;
+    set->count++;
+    bit = bp_filter_bit(key);
+    set->filter[bit >> 5] |= (1u << (bit & 31u));
+    return MM_TRUE;
+}
+
+mm_bool mm_bp_set_remove(struct mm_bp_set *set, mm_u32 pc)
+{
+    mm_u32 *slot;
+    if (set == 0) {
+        return MM_FALSE;
+    }
+    slot = bp_find(set, bp_key(pc));
+    if (slot == 0) {
+        return MM_FALSE;
+    }
+    *slot = BP_TOMB;
+    set->count--;
+    /* Other breakpoints may share the filter bit; removals are rare. */
+    bp_filter_rebuild(set);
+    return MM_TRUE;
+}
+
+mm_bool mm_bp_set_lookup(const struct mm_bp_set *set, mm_u32 pc)
+{
+    mm_u32 key = bp_key(pc);
+    mm_u32 bit = bp_filter_bit(key);
+    if (((set->filter[bit >> 5] >> (bit & 31u)) & 1u) == 0u) {
+        return MM_FALSE;
+    }
+    return (bp_find(set, key) != 0) ? MM_TRUE : MM_FALSE;
+}
+
+mm_u32 mm_bp_set_count(const struct mm_bp_set *set)
+{
+    return (set != 0) ? set->count : 0u;
+}
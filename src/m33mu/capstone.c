@@ -450,7 +450,36 @@ static mm_bool cross_check_kind(const cs_insn *insn, const struct mm_decoded *de
         case ARM_INS_SMLABT:
         case ARM_INS_SMLATB:
         case ARM_INS_SMLATT:
+        case ARM_INS_SMULBB:
+        case ARM_INS_SMULBT:
+        case ARM_INS_SMULTB:
+        case ARM_INS_SMULTT:
             return dec->kind == MM_OP_SMLA;
+        case ARM_INS_SSAT: return dec->kind == MM_OP_SSAT;
+        case ARM_INS_USAT: return dec->kind == MM_OP_USAT;
+        case ARM_INS_SSAT16: return dec->kind == MM_OP_SSAT16;
+        case ARM_INS_USAT16: return dec->kind == MM_OP_USAT16;
+        case ARM_INS_SEL: return dec->kind == MM_OP_SEL;
+        case ARM_INS_PKHBT:
+        case ARM_INS_PKHTB:
+            return dec->kind == MM_OP_PKH;
+        case ARM_INS_QADD:
+        case ARM_INS_QSUB:
+        case ARM_INS_QDADD:
+        case ARM_INS_QDSUB:
+            return dec->kind == MM_OP_QADDSUB;
+        case ARM_INS_USAD8:
+        case ARM_INS_USADA8:
+            return dec->kind == MM_OP_USAD8;
+        case ARM_INS_SMLAD:
+        case ARM_INS_SMUAD:
+        case ARM_INS_SMLSD:
+        case ARM_INS_SMUSD:
+            return dec->kind == MM_OP_SMLAD;
+        case ARM_INS_SMMLA:
+        case ARM_INS_SMMUL:
+        case ARM_INS_SMMLS:
+            return dec->kind == MM_OP_SMMLA;
         case ARM_INS_BXNS: return dec->kind == MM_OP_BXNS;
         case ARM_INS_BLXNS: return dec->kind == MM_OP_BLXNS;
         case ARM_INS_SG: return dec->kind == MM_OP_SG;
@@ -22,6 +22,7 @@
 #include "m33mu/cpu.h"
 
 #define CONTROL_SPSEL_MASK 0x2u
+#define CONTROL_FPCA_MASK 0x4u
 
 static mm_bool control_sp_sel(const struct mm_cpu *cpu)
 {
@@ -69,67 +70,73 @@ void mm_cpu_note_msp_top(struct mm_cpu *cpu, enum mm_sec_state sec)
     cpu_init_msp_top(cpu, sec, value);
 }
 
-mm_u32 mm_cpu_get_active_sp(const struct mm_cpu *cpu)
+static enum mm_sp_bank active_bank(const struct mm_cpu *cpu)
 {
-    mm_bool use_psp;
-    if (cpu == 0) {
-        return 0;
+    mm_bool use_psp = (cpu->mode != MM_HANDLER) && control_sp_sel(cpu);
+    if (cpu->sec_state == MM_NONSECURE) {
+        return use_psp ? MM_SP_PSP_NS : MM_SP_MSP_NS;
     }
-    if (cpu->mode == MM_HANDLER) {
-        use_psp = MM_FALSE;
-    } else {
-        use_psp = control_sp_sel(cpu);
+    return use_psp ? MM_SP_PSP_S : MM_SP_MSP_S;
+}
+
+static mm_u32 *bank_slot(struct mm_cpu *cpu, enum mm_sp_bank bank)
+{
+    switch (bank) {
+    case MM_SP_PSP_S: return &cpu->psp_s;
+    case MM_SP_MSP_NS: return &cpu->msp_ns;
+    case MM_SP_PSP_NS: return &cpu->psp_ns;
+    default: return &cpu->msp_s;
     }
-    if (use_psp) {
-        return (cpu->sec_state == MM_NONSECURE) ? cpu->psp_ns : cpu->psp_s;
+}
+
+static mm_u32 bank_limit(const struct mm_cpu *cpu, enum mm_sp_bank bank)
+{
+    switch (bank) {
+    case MM_SP_PSP_S: return cpu->psplim_s;
+    case MM_SP_MSP_NS: return cpu->msplim_ns;
+    case MM_SP_PSP_NS: return cpu->psplim_ns;
+    default: return cpu->msplim_s;
     }
-    return (cpu->sec_state == MM_NONSECURE) ? cpu->msp_ns : cpu->msp_s;
 }
 
-void mm_cpu_set_active_sp(struct mm_cpu *cpu, mm_u32 value)
+void mm_cpu_sp_rebank(struct mm_cpu *cpu)
 {
-    mm_bool use_psp;
     if (cpu == 0) {
         return;
     }
-    if (cpu->mode == MM_HANDLER) {
-        use_psp = MM_FALSE;
-    } else {
-        use_psp = control_sp_sel(cpu);
+    cpu->sp_bank = active_bank(cpu);
+    cpu->sp_lim = bank_limit(cpu, cpu->sp_bank);
+    cpu->r[13] = *bank_slot(cpu, cpu->sp_bank);
+}
+
+mm_u32 mm_cpu_get_active_sp(const struct mm_cpu *cpu)
+{
+    if (cpu == 0) {
+        return 0;
     }
-    if (use_psp) {
-        if (cpu->sec_state == MM_NONSECURE) cpu->psp_ns = value;
-        else cpu->psp_s = value;
-    } else {
-        if (cpu->sec_state == MM_NONSECURE) {
-            cpu->msp_ns = value;
-        } else {
-            cpu->msp_s = value;
-        }
-        cpu_init_msp_top(cpu, cpu->sec_state, value);
-        cpu_update_msp_min(cpu, cpu->sec_state, value);
+    return cpu->r[13];
+}
+
+void mm_cpu_set_active_sp(struct mm_cpu *cpu, mm_u32 value)
+{
+    if (cpu == 0) {
+        return;
     }
-    /* Mirror active SP into general-purpose R13 so push/pop style instructions
-     * operate on the currently selected stack pointer.
-     */
     cpu->r[13] = value;
+    *bank_slot(cpu, cpu->sp_bank) = value;
+    if (cpu->sp_bank == MM_SP_MSP_S || cpu->sp_bank == MM_SP_MSP_NS) {
+        enum mm_sec_state sec = (cpu->sp_bank == MM_SP_MSP_NS) ? MM_NONSECURE : MM_SECURE;
+        cpu_init_msp_top(cpu, sec, value);
+        cpu_update_msp_min(cpu, sec, value);
+    }
 }
 
 mm_u32 mm_cpu_get_active_splim(const struct mm_cpu *cpu)
 {
-    mm_bool use_psp;
     if (cpu == 0) {
         return 0;
     }
-    if (cpu->mode == MM_HANDLER) {
-        use_psp = MM_FALSE;
-    } else {
-        use_psp = control_sp_sel(cpu);
-    }
-    if (use_psp) {
-        return (cpu->sec_state == MM_NONSECURE) ? cpu->psplim_ns : cpu->psplim_s;
-    }
-    return (cpu->sec_state == MM_NONSECURE) ? cpu->msplim_ns : cpu->msplim_s;
+    return cpu->sp_lim;
 }
 
 mm_u32 mm_cpu_get_msp(const struct mm_cpu *cpu, enum mm_sec_state sec)
@@ -151,6 +158,9 @@ void mm_cpu_set_msp(struct mm_cpu *cpu, enum mm_sec_state sec, mm_u32 value)
         cpu_init_msp_top(cpu, sec, value);
     }
     cpu_update_msp_min(cpu, sec, value);
+    if (cpu->sp_bank == ((sec == MM_NONSECURE) ? MM_SP_MSP_NS : MM_SP_MSP_S)) {
+        cpu->r[13] = value;
+    }
 }
 
 mm_u32 mm_cpu_get_psp(const struct mm_cpu *cpu, enum mm_sec_state sec)
@@ -168,6 +178,9 @@ void mm_cpu_set_psp(struct mm_cpu *cpu, enum mm_sec_state sec, mm_u32 value)
     }
     if (sec == MM_NONSECURE) cpu->psp_ns = value;
     else cpu->psp_s = value;
+    if (cpu->sp_bank == ((sec == MM_NONSECURE) ? MM_SP_PSP_NS : MM_SP_PSP_S)) {
+        cpu->r[13] = value;
+    }
 }
 
 mm_u32 mm_cpu_get_control(const struct mm_cpu *cpu, enum mm_sec_state sec)
@@ -185,11 +198,15 @@ void mm_cpu_set_control(struct mm_cpu *cpu, enum mm_sec_state sec, mm_u32 value)
     }
     if (sec == MM_NONSECURE) cpu->control_ns = value;
     else cpu->control_s = value;
+    /* CONTROL.FPCA is shared between the Secure and Non-secure views. */
+    cpu->control_s = (cpu->control_s & ~CONTROL_FPCA_MASK) | (value & CONTROL_FPCA_MASK);
+    cpu->control_ns = (cpu->control_ns & ~CONTROL_FPCA_MASK) | (value & CONTROL_FPCA_MASK);
     if (sec == MM_NONSECURE) {
         cpu->priv_ns = (value & 0x1u) != 0u;
     } else {
         cpu->priv_s = (value & 0x1u) != 0u;
     }
+    mm_cpu_sp_rebank(cpu);
 }
 
 mm_u32 mm_cpu_get_vtor(const struct mm_cpu *cpu, enum mm_sec_state sec)
@@ -213,6 +230,7 @@ void mm_cpu_set_mode(struct mm_cpu *cpu, enum mm_mode mode)
 {
     if (cpu != 0) {
         cpu->mode = mode;
+        mm_cpu_sp_rebank(cpu);
     }
 }
 
@@ -228,6 +246,7 @@ void mm_cpu_set_security(struct mm_cpu *cpu, enum mm_sec_state sec)
 {
     if (cpu != 0) {
         cpu->sec_state = sec;
+        mm_cpu_sp_rebank(cpu);
     }
 }
 
@@ -21,6 +21,7 @@
 
 #include "m33mu/decode.h"
 #include "m33mu/fetch.h"
+#include "m33mu/fpu.h"
 #include <stdio.h>
 
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L)
@@ -733,6 +734,343 @@ static struct mm_decoded decode_16(mm_u16 hw1)
     return d;
 }
 
+/* Floating-point extension (coprocessors 10/11), FPv5 single precision.
+ * Double-precision data processing is UNDEFINED on this FPU; D registers are
+ * only reachable through loads/stores and core-register moves.
+ */
+static mm_u8 vfp_sreg(mm_u32 v4, mm_u32 bit)
+{
+    return (mm_u8)(((v4 & 0x0fu) << 1) | (bit & 1u));
+}
+
+static mm_u8 vfp_dreg_as_s(mm_u32 v4, mm_u32 bit)
+{
+    return (mm_u8)((((bit & 1u) << 4) | (v4 & 0x0fu)) << 1);
+}
+
+static mm_bool decode_vfp(mm_u32 insn, struct mm_decoded *d)
+{
+    mm_u32 sz = (insn >> 8) & 1u;
+    mm_u8 sd = vfp_sreg(insn >> 12, insn >> 22);
+    mm_u8 sn = vfp_sreg(insn >> 16, insn >> 7);
+    mm_u8 sm = vfp_sreg(insn, insn >> 5);
+    mm_u32 op6 = (insn >> 6) & 1u;
+
+    if ((insn & 0xf0000000u) == 0xe0000000u && (insn & 0x0e000000u) == 0x0c000000u) {
+        /* Extension register load/store and 64-bit core transfers: 1110 110P UDWL Rn */
+        mm_u32 p = (insn >> 24) & 1u;
+        mm_u32 u = (insn >> 23) & 1u;
+        mm_u32 w = (insn >> 21) & 1u;
+        mm_u32 l = (insn >> 20) & 1u;
+        mm_u32 imm8 = insn & 0xffu;
+        mm_u8 first = sz ? vfp_dreg_as_s(insn >> 12, insn >> 22) : sd;
+
+        if ((insn & 0x01e00000u) == 0x00400000u) {
+            /* VMOV two core registers <-> two S registers / one D register */
+            if ((insn & 0xd0u) != 0x10u) return MM_FALSE;
+            d->rm = sz ? vfp_dreg_as_s(insn, insn >> 5) : sm;
+            if (d->rm >= 31u) return MM_FALSE;
+            d->kind = MM_OP_VMOV_CR2;
+            d->rd = (mm_u8)((insn >> 12) & 0x0fu);
+            d->ra = (mm_u8)((insn >> 16) & 0x0fu);
+            d->imm = l;
+            return MM_TRUE;
+        }
+        d->rn = (mm_u8)((insn >> 16) & 0x0fu);
+        d->rd = first;
+        if (p == 1u && w == 0u) {
+            d->kind = l ? MM_OP_VLDR : MM_OP_VSTR;
+            d->ra = (mm_u8)(sz ? 2u : 1u);
+            d->imm = u ? imm8 * 4u : (mm_u32)(0u - imm8 * 4u);
+            return MM_TRUE;
+        }
+        if (p == u || (p == 0u && u == 0u)) {
+            return MM_FALSE;
+        }
+        /* VLDM/VSTM (IA or DB!); VPUSH/VPOP are the SP forms. Odd imm8 with
+         * sz=1 is FLDMX/FSTMX: the extra word is skipped but still counted. */
+        d->ra = (mm_u8)(sz ? (imm8 & ~1u) : imm8);
+        if (d->ra == 0u || (mm_u32)first + d->ra > 32u) return MM_FALSE;
+        if (d->rn == 15u && w) return MM_FALSE;
+        d->kind = l ? MM_OP_VLDM : MM_OP_VSTM;
+        d->imm = imm8 * 4u;
+        return MM_TRUE;
+    }
+
+    if ((insn & 0xff000000u) == 0xee000000u && (insn & 0x10u) != 0u) {
+        /* 8/16/32-bit transfers between core and extension registers */
+        mm_u32 l = (insn >> 20) & 1u;
+        mm_u32 opa = (insn >> 21) & 0x7u;
+        d->rd = (mm_u8)((insn >> 12) & 0x0fu);
+        if ((insn & 0x6fu) != 0u) return MM_FALSE;
+        if (sz == 0u && opa == 0u) {
+            d->kind = MM_OP_VMOV_CR;
+            d->rn = sn;
+            d->imm = l;
+            return MM_TRUE;
+        }
+        if (sz == 0u && opa == 7u) {
+            d->kind = l ? MM_OP_VMRS : MM_OP_VMSR;
+            d->imm = (insn >> 16) & 0x0fu;
+            return MM_TRUE;
+        }
+        if (sz == 1u && (opa & 0x6u) == 0u) {
+            /* VMOV Dn[x] <-> Rt (32-bit scalar) */
+            d->kind = MM_OP_VMOV_CR;
+            d->rn = (mm_u8)(vfp_dreg_as_s(insn >> 16, insn >> 7) + (opa & 1u));
+            d->imm = l;
+            return MM_TRUE;
+        }
+        return MM_FALSE;
+    }
+
+    if ((insn & 0xff000000u) == 0xee000000u) {
+        /* Data processing: 1110 1110 opc1 opc2 | Vd 101 sz opc3 M 0 Vm */
+        mm_u32 opc1 = ((insn >> 20) & 0x3u) | ((insn >> 21) & 0x4u);
+        mm_u32 opc2 = (insn >> 16) & 0x0fu;
+        mm_u32 t = (insn >> 7) & 1u;
+        if (sz != 0u) return MM_FALSE;
+        d->rd = sd;
+        d->rn = sn;
+        d->rm = sm;
+        switch (opc1) {
+        case 0x0: d->kind = op6 ? MM_OP_VMLS : MM_OP_VMLA; return MM_TRUE;
+        case 0x1: d->kind = op6 ? MM_OP_VNMLA : MM_OP_VNMLS; return MM_TRUE;
+        case 0x2: d->kind = op6 ? MM_OP_VNMUL : MM_OP_VMUL; return MM_TRUE;
+        case 0x3: d->kind = op6 ? MM_OP_VSUB : MM_OP_VADD; return MM_TRUE;
+        case 0x4:
+            if (op6) return MM_FALSE;
+            d->kind = MM_OP_VDIV;
+            return MM_TRUE;
+        case 0x5: d->kind = op6 ? MM_OP_VFNMA : MM_OP_VFNMS; return MM_TRUE;
+        case 0x6: d->kind = op6 ? MM_OP_VFMS : MM_OP_VFMA; return MM_TRUE;
+        default: break;
+        }
+        if (op6 == 0u) {
+            /* VMOV (immediate): VFPExpandImm(imm4H:imm4L) */
+            mm_u32 imm8 = ((opc2 << 4) | (insn & 0x0fu));
+            if ((insn & 0xa0u) != 0u) return MM_FALSE;
+            d->kind = MM_OP_VMOV_IMM;
+            d->imm = ((imm8 & 0x80u) << 24) | (((imm8 & 0x40u) != 0u) ? 0x3e000000u : 0x40000000u) |
+                     ((imm8 & 0x3fu) << 19);
+            return MM_TRUE;
+        }
+        switch (opc2) {
+        case 0x0: d->kind = t ? MM_OP_VABS : MM_OP_VMOV_REG; return MM_TRUE;
+        case 0x1: d->kind = t ? MM_OP_VSQRT : MM_OP_VNEG; return MM_TRUE;
+        case 0x2:
+        case 0x3:
+            d->kind = MM_OP_VCVT_HALF;
+            d->imm = (opc2 & 1u) | (t << 1);
+            return MM_TRUE;
+        case 0x4:
+        case 0x5:
+            if (opc2 == 0x5u && (insn & 0x2fu) != 0u) return MM_FALSE;
+            d->kind = MM_OP_VCMP;
+            d->imm = t | ((opc2 & 1u) << 1);
+            return MM_TRUE;
+        case 0x6:
+            d->kind = MM_OP_VRINT;
+            d->imm = t ? MM_FPU_RM_Z : MM_FPU_RM_FPSCR;
+            return MM_TRUE;
+        case 0x7:
+            if (t) return MM_FALSE; /* VCVT between single and double */
+            d->kind = MM_OP_VRINT;
+            d->imm = MM_FPU_RM_X;
+            return MM_TRUE;
+        case 0x8:
+            d->kind = MM_OP_VCVT_F32_INT;
+            d->imm = t;
+            return MM_TRUE;
+        case 0xa:
+        case 0xb:
+        case 0xe:
+        case 0xf: {
+            mm_u32 size = t ? 32u : 16u;
+            mm_u32 imm5 = ((insn & 0x0fu) << 1) | ((insn >> 5) & 1u);
+            if (imm5 > size) return MM_FALSE;
+            d->kind = MM_OP_VCVT_FIXED;
+            d->imm = (size - imm5) | (((opc2 >> 2) & 1u) << 8) | ((opc2 & 1u) << 9) | (t << 10);
+            return MM_TRUE;
+        }
+        case 0xc:
+        case 0xd:
+            d->kind = MM_OP_VCVT_INT_F32;
+            d->imm = (opc2 & 1u) | (t << 1);
+            return MM_TRUE;
+        default:
+            return MM_FALSE;
+        }
+    }
+
+    if ((insn & 0xff000010u) == 0xfe000000u) {
+        /* FPv5 additions, unconditional: VSEL, VMAXNM/VMINNM, VRINT{A,N,P,M}, VCVT{A,N,P,M} */
+        if (sz != 0u) return MM_FALSE;
+        d->rd = sd;
+        d->rn = sn;
+        d->rm = sm;
+        if ((insn & 0x00800000u) == 0u) {
+            if (op6) return MM_FALSE;
+            d->kind = MM_OP_VSEL;
+            d->imm = (insn >> 20) & 0x3u;
+            return MM_TRUE;
+        }
+        if ((insn & 0x00300000u) == 0u) {
+            d->kind = op6 ? MM_OP_VMINNM : MM_OP_VMAXNM;
+            return MM_TRUE;
+        }
+        if ((insn & 0x00300000u) == 0x00300000u && op6) {
+            mm_u32 rmode = (insn >> 16) & 0x3u;
+            if (((insn >> 18) & 0x3u) == 0x2u && ((insn >> 7) & 1u) == 0u) {
+                d->kind = MM_OP_VRINT;
+                d->imm = rmode;
+                return MM_TRUE;
+            }
+            if (((insn >> 18) & 0x3u) == 0x3u) {
+                d->kind = MM_OP_VCVT_RM;
+                d->imm = rmode | (((insn >> 7) & 1u) << 3);
+                return MM_TRUE;
+            }
+        }
+    }
+    return MM_FALSE;
+}
+
+/* DSP extension: packed SIMD, saturation and the extra multiplies. Only
+ * claims encodings no other decoder path handles; returns MM_FALSE without
+ * touching d otherwise.
+ */
+static mm_bool decode_dsp(mm_u32 insn, struct mm_decoded *d)
+{
+    mm_u32 hw1 = insn >> 16;
+    mm_u32 hw2 = insn & 0xffffu;
+    mm_u8 rn = (mm_u8)(hw1 & 0x0fu);
+    mm_u8 ra = (mm_u8)((hw2 >> 12) & 0x0fu);
+    mm_u8 rd = (mm_u8)((hw2 >> 8) & 0x0fu);
+    mm_u8 rm = (mm_u8)(hw2 & 0x0fu);
+    enum mm_op_kind kind = MM_OP_UNDEFINED;
+    mm_u32 imm = 0;
+
+    /* Parallel add/sub, QADD/QSUB family, SEL: 1111 1010 1 op1 Rn | 1111 Rd op2 Rm */
+    if ((hw1 & 0xff80u) == 0xfa80u && (hw2 & 0xf000u) == 0xf000u) {
+        mm_u32 op1 = (hw1 >> 4) & 0x7u;
+        mm_u32 op2 = (hw2 >> 4) & 0xfu;
+        if ((op2 & 0x8u) == 0u) {
+            if (op1 == 3u || op1 == 7u || (op2 & 0x3u) == 0x3u) return MM_FALSE;
+            kind = MM_OP_PAS;
+            imm = (op1 << 4) | op2;
+        } else if (op1 == 0u && (op2 & 0xcu) == 0x8u) {
+            kind = MM_OP_QADDSUB;
+            imm = op2 & 0x3u;
+        } else if (op1 == 2u && op2 == 0x8u) {
+            kind = MM_OP_SEL;
+        } else {
+            return MM_FALSE;
+        }
+        if (rd == 15u || rn == 15u || rm == 15u) return MM_FALSE;
+        ra = 15u;
+    }
+    /* SXTB16/UXTB16 and the accumulating forms: 1111 1010 001U Rn | 1111 Rd 10 rot Rm */
+    else if ((hw1 & 0xffe0u) == 0xfa20u && (hw2 & 0xf0c0u) == 0xf080u) {
+        if (rd == 15u || rm == 15u) return MM_FALSE;
+        kind = ((hw1 & 0x10u) != 0u) ? MM_OP_UXTB16 : MM_OP_SXTB16;
+        imm = (((hw2 >> 4) & 0x3u) << 3) | ((rn != 15u) ? 0x80000000u : 0u);
+        ra = 15u;
+    }
+    /* Multiply group: 1111 1011 0 op1 Rn | Ra Rd 00 op2 Rm */
+    else if ((hw1 & 0xff80u) == 0xfb00u && (hw2 & 0x00c0u) == 0u) {
+        mm_u32 op1 = (hw1 >> 4) & 0x7u;
+        mm_u32 op2 = (hw2 >> 4) & 0x3u;
+        switch (op1) {
+        case 1u:
+            if (ra != 15u) return MM_FALSE;     /* SMLAxy is decoded below */
+            kind = MM_OP_SMLA;                  /* SMULxy */
+            imm = op2;
+            break;
+        case 2u:
+        case 4u:
+            if ((op2 & 0x2u) != 0u) return MM_FALSE;
+            kind = MM_OP_SMLAD;
+            imm = op2 | ((op1 == 4u) ? 0x2u : 0u);
+            break;
+        case 3u:
+            if ((op2 & 0x2u) != 0u) return MM_FALSE;
+            kind = MM_OP_SMLAW;
+            imm = op2;
+            break;
+        case 5u:
+        case 6u:
+            if ((op2 & 0x2u) != 0u || (op1 == 6u && ra == 15u)) return MM_FALSE;
+            kind = MM_OP_SMMLA;
+            imm = op2 | ((op1 == 6u) ? 0x2u : 0u);
+            break;
+        case 7u:
+            if (op2 != 0u) return MM_FALSE;
+            kind = MM_OP_USAD8;
+            break;
+        default:
+            return MM_FALSE;
+        }
+        if (rd == 15u || rn == 15u || rm == 15u) return MM_FALSE;
+    }
+    /* SMLALxy, SMLALD, SMLSLD: 1111 1011 110x Rn | RdLo RdHi op2 Rm */
+    else if ((hw1 & 0xffe0u) == 0xfbc0u) {
+        mm_u32 op2 = (hw2 >> 4) & 0xfu;
+        if ((hw1 & 0x10u) == 0u && (op2 & 0xcu) == 0x8u) {
+            kind = MM_OP_SMLAL_XY;
+            imm = op2 & 0x3u;
+        } else if ((op2 & 0xeu) == 0xcu) {
+            kind = MM_OP_SMLALD;
+            imm = (op2 & 0x1u) | (((hw1 & 0x10u) != 0u) ? 0x2u : 0u);
+        } else {
+            return MM_FALSE;
+        }
+        if (ra == 15u || rd == 15u || rn == 15u || rm == 15u || ra == rd) return MM_FALSE;
+        /* rd=RdLo, ra=RdHi as for the other long multiplies */
+        {
+            mm_u8 lo = ra;
+            ra = rd;
+            rd = lo;
+        }
+    }
+    /* SSAT/USAT(16): 1111 0011 U0 sh 0 Rn | 0 imm3 Rd imm2 0 sat_imm */
+    else if (((hw1 & 0xffd0u) == 0xf300u || (hw1 & 0xffd0u) == 0xf380u) && (hw2 & 0x8020u) == 0u) {
+        mm_bool is_unsigned = (hw1 & 0x80u) != 0u;
+        mm_u32 sh = (hw1 >> 5) & 0x1u;
+        mm_u32 imm5 = (((hw2 >> 12) & 0x7u) << 2) | ((hw2 >> 6) & 0x3u);
+        mm_u32 sat = hw2 & 0x1fu;
+        if (rd == 15u || rn == 15u) return MM_FALSE;
+        if (sh != 0u && imm5 == 0u) {
+            if ((sat & 0x10u) != 0u) return MM_FALSE;
+            kind = is_unsigned ? MM_OP_USAT16 : MM_OP_SSAT16;
+            imm = is_unsigned ? sat : sat + 1u;
+        } else {
+            kind = is_unsigned ? MM_OP_USAT : MM_OP_SSAT;
+            imm = (is_unsigned ? sat : sat + 1u) | (sh << 6) | (imm5 << 8);
+        }
+        rm = 15u;
+        ra = 15u;
+    }
+    /* PKHBT/PKHTB: 1110 1010 1100 Rn | 0 imm3 Rd imm2 tb 0 Rm */
+    else if ((hw1 & 0xfff0u) == 0xeac0u && (hw2 & 0x8010u) == 0u) {
+        mm_u32 imm5 = (((hw2 >> 12) & 0x7u) << 2) | ((hw2 >> 6) & 0x3u);
+        if (rd == 15u || rn == 15u || rm == 15u) return MM_FALSE;
+        kind = MM_OP_PKH;
+        imm = imm5 | (hw2 & 0x20u);
+        ra = 15u;
+    } else {
+        return MM_FALSE;
+    }
+
+    d->kind = kind;
+    d->rd = rd;
+    d->rn = rn;
+    d->rm = rm;
+    d->ra = ra;
+    d->imm = imm;
+    return MM_TRUE;
+}
+
 static struct mm_decoded decode_32(mm_u32 insn)
 {
     struct mm_decoded d;
@@ -740,6 +1078,18 @@ static struct mm_decoded decode_32(mm_u32 insn)
     d.len = 4;
     d.raw = insn;
 
+    /* Coprocessor 10/11 space: 111x 11xx .... | .... 101x .... */
+    if ((insn & 0xec000e00u) == 0xec000a00u) {
+        if (decode_vfp(insn, &d)) {
+            d.undefined = MM_FALSE;
+        }
+        return d;
+    }
+    if (decode_dsp(insn, &d)) {
+        d.undefined = MM_FALSE;
+        return d;
+    }
+
     /* LDR (literal), Thumb-2 T3:
      * 1111 1000 U101 1111 Rt imm12
      * Used by CMSE import veneers: e.g. "ldr.w pc, [pc]" then a literal word.
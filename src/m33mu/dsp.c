@@ -0,0 +1,373 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include "m33mu/dsp.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MM_DSP_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MM_DSP_NEON 1
+#endif
+
+/* MM_OP_PAS shapes (imm[6:4]) and forms (imm[2:0]). */
+#define PAS_ADD8  0u
+#define PAS_ADD16 1u
+#define PAS_ASX   2u
+#define PAS_SUB8  4u
+#define PAS_SUB16 5u
+#define PAS_SAX   6u
+
+#define PAS_MODULAR  0u
+#define PAS_SATURATE 1u
+#define PAS_HALVING  2u
+#define PAS_UNSIGNED 4u
+
+const char *mm_dsp_backend(void)
+{
+#if defined(MM_DSP_SSE2)
+    return "sse2";
+#elif defined(MM_DSP_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+static mm_i32 lane_get(mm_u32 v, mm_u32 idx, mm_u32 bits, mm_bool is_signed)
+{
+    mm_u32 mask = (bits == 8u) ? 0xffu : 0xffffu;
+    mm_u32 x = (v >> (idx * bits)) & mask;
+    if (is_signed && (x & (1u << (bits - 1u))) != 0u) {
+        return (mm_i32)x - (mm_i32)(mask + 1u);
+    }
+    return (mm_i32)x;
+}
+
+/* Arithmetic shift right that does not rely on implementation-defined >>. */
+static mm_i64 asr64(mm_i64 v, mm_u32 n)
+{
+    if (v >= 0) return v >> n;
+    return -(((-v) - 1) >> n) - 1;
+}
+
+static mm_i64 sat_signed(mm_i64 v, mm_u32 bits, mm_bool *sat)
+{
+    mm_i64 hi = ((mm_i64)1 << (bits - 1u)) - 1;
+    mm_i64 lo = -hi - 1;
+    if (v > hi) { *sat = MM_TRUE; return hi; }
+    if (v < lo) { *sat = MM_TRUE; return lo; }
+    return v;
+}
+
+static mm_i64 sat_unsigned(mm_i64 v, mm_u32 bits, mm_bool *sat)
+{
+    mm_i64 hi = ((mm_i64)1 << bits) - 1;
+    if (v > hi) { *sat = MM_TRUE; return hi; }
+    if (v < 0) { *sat = MM_TRUE; return 0; }
+    return v;
+}
+
+#if defined(MM_DSP_SSE2) || defined(MM_DSP_NEON)
+/* Lane-parallel saturating add/sub on the host vector unit. */
+static mm_u32 pas_saturate_simd(mm_u32 shape, mm_bool is_signed, mm_u32 a, mm_u32 b)
+{
+#if defined(MM_DSP_SSE2)
+    __m128i x = _mm_cvtsi32_si128((int)a);
+    __m128i y = _mm_cvtsi32_si128((int)b);
+    __m128i r;
+    switch (shape) {
+    case PAS_ADD8: r = is_signed ? _mm_adds_epi8(x, y) : _mm_adds_epu8(x, y); break;
+    case PAS_SUB8: r = is_signed ? _mm_subs_epi8(x, y) : _mm_subs_epu8(x, y); break;
+    case PAS_ADD16: r = is_signed ? _mm_adds_epi16(x, y) : _mm_adds_epu16(x, y); break;
+    default: r = is_signed ? _mm_subs_epi16(x, y) : _mm_subs_epu16(x, y); break;
+    }
+    return (mm_u32)_mm_cvtsi128_si32(r);
+#else
+    uint32x2_t x = vdup_n_u32(a);
+    uint32x2_t y = vdup_n_u32(b);
+    uint32x2_t r;
+    switch (shape) {
+    case PAS_ADD8:
+        r = is_signed ? vreinterpret_u32_s8(vqadd_s8(vreinterpret_s8_u32(x), vreinterpret_s8_u32(y)))
+                      : vreinterpret_u32_u8(vqadd_u8(vreinterpret_u8_u32(x), vreinterpret_u8_u32(y)));
+        break;
+    case PAS_SUB8:
+        r = is_signed ? vreinterpret_u32_s8(vqsub_s8(vreinterpret_s8_u32(x), vreinterpret_s8_u32(y)))
+                      : vreinterpret_u32_u8(vqsub_u8(vreinterpret_u8_u32(x), vreinterpret_u8_u32(y)));
+        break;
+    case PAS_ADD16:
+        r = is_signed ? vreinterpret_u32_s16(vqadd_s16(vreinterpret_s16_u32(x), vreinterpret_s16_u32(y)))
+                      : vreinterpret_u32_u16(vqadd_u16(vreinterpret_u16_u32(x), vreinterpret_u16_u32(y)));
+        break;
+    default:
+        r = is_signed ? vreinterpret_u32_s16(vqsub_s16(vreinterpret_s16_u32(x), vreinterpret_s16_u32(y)))
+                      : vreinterpret_u32_u16(vqsub_u16(vreinterpret_u16_u32(x), vreinterpret_u16_u32(y)));
+        break;
+    }
+    return vget_lane_u32(r, 0);
+#endif
+}
+#endif
+
+mm_u32 mm_dsp_pas(mm_u32 op, mm_u32 a, mm_u32 b, mm_u32 *ge_io)
+{
+    mm_u32 shape = (op >> 4) & 0x7u;
+    mm_u32 form = op & 0x7u;
+    mm_bool is_signed = (form & PAS_UNSIGNED) == 0u;
+    mm_u32 variant = form & 0x3u;
+    mm_u32 bits = (shape == PAS_ADD8 || shape == PAS_SUB8) ? 8u : 16u;
+    mm_u32 mask = (bits == 8u) ? 0xffu : 0xffffu;
+    mm_u32 lanes = 32u / bits;
+    mm_u32 res = 0;
+    mm_u32 ge = 0;
+    mm_u32 i;
+
+#if defined(MM_DSP_SSE2) || defined(MM_DSP_NEON)
+    if (variant == PAS_SATURATE && shape != PAS_ASX && shape != PAS_SAX) {
+        return pas_saturate_simd(shape, is_signed, a, b);
+    }
+#endif
+    for (i = 0; i < lanes; ++i) {
+        mm_i64 x = lane_get(a, i, bits, is_signed);
+        mm_i64 y;
+        mm_bool sub;
+        mm_bool sat = MM_FALSE;
+        mm_i64 r;
+        if (shape == PAS_ASX || shape == PAS_SAX) {
+            y = lane_get(b, 1u - i, bits, is_signed);
+            sub = (shape == PAS_ASX) ? (i == 0u) : (i == 1u);
+        } else {
+            y = lane_get(b, i, bits, is_signed);
+            sub = (shape >= PAS_SUB8);
+        }
+        r = sub ? (x - y) : (x + y);
+        switch (variant) {
+        case PAS_MODULAR: {
+            mm_bool lane_ge;
+            if (is_signed || sub) lane_ge = (r >= 0);
+            else lane_ge = (r >= ((mm_i64)1 << bits));
+            if (lane_ge) ge |= ((bits == 8u) ? 0x1u : 0x3u) << (i * (bits / 8u));
+            break;
+        }
+        case PAS_SATURATE:
+            r = is_signed ? sat_signed(r, bits, &sat) : sat_unsigned(r, bits, &sat);
+            break;
+        default:
+            r = asr64(r, 1u);
+            break;
+        }
+        res |= ((mm_u32)r & mask) << (i * bits);
+    }
+    if (variant == PAS_MODULAR && ge_io != 0) {
+        *ge_io = ge;
+    }
+    return res;
+}
+
+static mm_u32 usad8(mm_u32 a, mm_u32 b)
+{
+#if defined(MM_DSP_SSE2)
+    return (mm_u32)_mm_cvtsi128_si32(_mm_sad_epu8(_mm_cvtsi32_si128((int)a), _mm_cvtsi32_si128((int)b)));
+#elif defined(MM_DSP_NEON)
+    uint8x8_t d8 = vabd_u8(vreinterpret_u8_u32(vdup_n_u32(a)), vreinterpret_u8_u32(vdup_n_u32(b)));
+    return vget_lane_u32(vpaddl_u16(vpaddl_u8(d8)), 0);
+#else
+    mm_u32 sum = 0;
+    mm_u32 i;
+    for (i = 0; i < 4u; ++i) {
+        mm_i32 x = lane_get(a, i, 8u, MM_FALSE);
+        mm_i32 y = lane_get(b, i, 8u, MM_FALSE);
+        sum += (mm_u32)((x > y) ? (x - y) : (y - x));
+    }
+    return sum;
+#endif
+}
+
+static mm_i32 half_of(mm_u32 v, mm_bool top)
+{
+    return (mm_i32)(mm_i16)(top ? (v >> 16) : (v & 0xffffu));
+}
+
+static mm_u32 ror32(mm_u32 v, mm_u32 n)
+{
+    n &= 31u;
+    return (n == 0u) ? v : ((v >> n) | (v << (32u - n)));
+}
+
+mm_bool mm_dsp_execute(struct mm_cpu *cpu, const struct mm_decoded *d)
+{
+    mm_u32 a;
+    mm_u32 b;
+    mm_bool q = MM_FALSE;
+    mm_bool acc = MM_FALSE;
+
+    if (cpu == 0 || d == 0) return MM_FALSE;
+    a = cpu->r[d->rn];
+    b = cpu->r[d->rm];
+    acc = (d->ra != 15u);
+
+    switch (d->kind) {
+    case MM_OP_PAS: {
+        mm_u32 ge = (cpu->xpsr & MM_XPSR_GE_MASK) >> MM_XPSR_GE_SHIFT;
+        cpu->r[d->rd] = mm_dsp_pas(d->imm, a, b, &ge);
+        cpu->xpsr = (cpu->xpsr & ~MM_XPSR_GE_MASK) | (ge << MM_XPSR_GE_SHIFT);
+        break;
+    }
+    case MM_OP_QADDSUB: {
+        /* QADD Rd, Rm, Rn: the first operand is Rm. */
+        mm_i64 y = (mm_i32)a;
+        mm_i64 r;
+        if ((d->imm & 1u) != 0u) y = sat_signed(y * 2, 32u, &q);
+        r = ((d->imm & 2u) != 0u) ? ((mm_i64)(mm_i32)b - y) : ((mm_i64)(mm_i32)b + y);
+        cpu->r[d->rd] = (mm_u32)(mm_i32)sat_signed(r, 32u, &q);
+        break;
+    }
+    case MM_OP_SEL: {
+        mm_u32 ge = (cpu->xpsr & MM_XPSR_GE_MASK) >> MM_XPSR_GE_SHIFT;
+        mm_u32 res = 0;
+        mm_u32 i;
+        for (i = 0; i < 4u; ++i) {
+            mm_u32 src = ((ge >> i) & 1u) ? a : b;
+            res |= src & (0xffu << (i * 8u));
+        }
+        cpu->r[d->rd] = res;
+        break;
+    }
+    case MM_OP_SSAT:
+    case MM_OP_USAT: {
+        mm_u32 shift = (d->imm >> 8) & 0x1fu;
+        mm_i64 v = ((d->imm & 0x40u) != 0u) ? asr64((mm_i32)a, shift) : (mm_i64)(mm_i32)(a << shift);
+        mm_u32 bits = d->imm & 0x3fu;
+        v = (d->kind == MM_OP_SSAT) ? sat_signed(v, bits, &q) : sat_unsigned(v, bits, &q);
+        cpu->r[d->rd] = (mm_u32)v;
+        break;
+    }
+    case MM_OP_SSAT16:
+    case MM_OP_USAT16: {
+        mm_u32 bits = d->imm & 0x1fu;
+        mm_i64 lo = half_of(a, MM_FALSE);
+        mm_i64 hi = half_of(a, MM_TRUE);
+        if (d->kind == MM_OP_SSAT16) {
+            lo = sat_signed(lo, bits, &q);
+            hi = sat_signed(hi, bits, &q);
+        } else {
+            lo = sat_unsigned(lo, bits, &q);
+            hi = sat_unsigned(hi, bits, &q);
+        }
+        cpu->r[d->rd] = ((mm_u32)lo & 0xffffu) | (((mm_u32)hi & 0xffffu) << 16);
+        break;
+    }
+    case MM_OP_PKH: {
+        mm_u32 shift = d->imm & 0x1fu;
+        if ((d->imm & 0x20u) != 0u) {
+            /* PKHTB: ASR #0 encodes ASR #32. */
+            mm_u32 lo = (mm_u32)asr64((mm_i32)b, (shift == 0u) ? 32u : shift);
+            cpu->r[d->rd] = (a & 0xffff0000u) | (lo & 0xffffu);
+        } else {
+            cpu->r[d->rd] = (a & 0xffffu) | ((b << shift) & 0xffff0000u);
+        }
+        break;
+    }
+    case MM_OP_SXTB16:
+    case MM_OP_UXTB16: {
+        mm_u32 rot = ror32(b, ((d->imm >> 3) & 0x3u) * 8u);
+        mm_u32 lo = rot & 0xffu;
+        mm_u32 hi = (rot >> 16) & 0xffu;
+        if (d->kind == MM_OP_SXTB16) {
+            lo = (mm_u32)(mm_i32)(mm_i8)lo;
+            hi = (mm_u32)(mm_i32)(mm_i8)hi;
+        }
+        if ((d->imm & 0x80000000u) != 0u) {
+            lo += a & 0xffffu;
+            hi += a >> 16;
+        }
+        cpu->r[d->rd] = (lo & 0xffffu) | ((hi & 0xffffu) << 16);
+        break;
+    }
+    case MM_OP_SMLA: {
+        /* SMLAxy / SMULxy: imm bit1 selects the top half of Rn, bit0 of Rm. */
+        mm_i64 r = (mm_i64)half_of(a, (d->imm & 2u) != 0u) * half_of(b, (d->imm & 1u) != 0u);
+        if (acc) {
+            r += (mm_i32)cpu->r[d->ra];
+            if (r != (mm_i32)r) q = MM_TRUE;
+        }
+        cpu->r[d->rd] = (mm_u32)r;
+        break;
+    }
+    case MM_OP_SMLAD: {
+        mm_u32 bs = ((d->imm & 1u) != 0u) ? ror32(b, 16u) : b;
+        mm_i64 p1 = (mm_i64)half_of(a, MM_FALSE) * half_of(bs, MM_FALSE);
+        mm_i64 p2 = (mm_i64)half_of(a, MM_TRUE) * half_of(bs, MM_TRUE);
+        mm_i64 r = ((d->imm & 2u) != 0u) ? (p1 - p2) : (p1 + p2);
+        if (acc) r += (mm_i32)cpu->r[d->ra];
+        if (r != (mm_i32)r) q = MM_TRUE;
+        cpu->r[d->rd] = (mm_u32)r;
+        break;
+    }
+    case MM_OP_SMLALD: {
+        mm_u32 bs = ((d->imm & 1u) != 0u) ? ror32(b, 16u) : b;
+        mm_i64 p1 = (mm_i64)half_of(a, MM_FALSE) * half_of(bs, MM_FALSE);
+        mm_i64 p2 = (mm_i64)half_of(a, MM_TRUE) * half_of(bs, MM_TRUE);
+        mm_u64 r = ((mm_u64)cpu->r[d->ra] << 32) | cpu->r[d->rd];
+        r += (mm_u64)(((d->imm & 2u) != 0u) ? (p1 - p2) : (p1 + p2));
+        cpu->r[d->rd] = (mm_u32)r;
+        cpu->r[d->ra] = (mm_u32)(r >> 32);
+        break;
+    }
+    case MM_OP_SMLAW: {
+        mm_i64 r = asr64((mm_i64)(mm_i32)a * half_of(b, (d->imm & 1u) != 0u), 16u);
+        if (acc) {
+            r += (mm_i32)cpu->r[d->ra];
+            if (r != (mm_i32)r) q = MM_TRUE;
+        }
+        cpu->r[d->rd] = (mm_u32)r;
+        break;
+    }
+    case MM_OP_SMMLA: {
+        mm_u64 p = (mm_u64)((mm_i64)(mm_i32)a * (mm_i32)b);
+        mm_u64 r = acc ? ((mm_u64)cpu->r[d->ra] << 32) : 0u;
+        r = ((d->imm & 2u) != 0u) ? (r - p) : (r + p);
+        if ((d->imm & 1u) != 0u) r += 0x80000000u;
+        cpu->r[d->rd] = (mm_u32)(r >> 32);
+        break;
+    }
+    case MM_OP_SMLAL_XY: {
+        mm_i64 p = (mm_i64)half_of(a, (d->imm & 2u) != 0u) * half_of(b, (d->imm & 1u) != 0u);
+        mm_u64 r = ((mm_u64)cpu->r[d->ra] << 32) | cpu->r[d->rd];
+        r += (mm_u64)p;
+        cpu->r[d->rd] = (mm_u32)r;
+        cpu->r[d->ra] = (mm_u32)(r >> 32);
+        break;
+    }
+    case MM_OP_USAD8:
+        cpu->r[d->rd] = usad8(a, b) + (acc ? cpu->r[d->ra] : 0u);
+        break;
+    default:
+        return MM_FALSE;
+    }
+    if (q) {
+        cpu->xpsr |= MM_XPSR_Q;
+    }
+    return MM_TRUE;
+}
@@ -15,15 +15,27 @@
 #include <linux/if.h>
 #include <linux/if_tun.h>
 #include "m33mu/eth_backend.h"
+#include "m33mu/eth_shm.h"
+#include "m33mu/hostwait.h"
+#include "m33mu/pcap.h"
+#include "m33mu/reactor.h"
+#include "m33mu/replay.h"
 
 #ifdef M33MU_HAS_VDE
 #include <libvdeplug.h>
 #endif
 
+/* Frames queued in each direction between the MAC model and the reactor. */
+#define ETH_RING_SIZE 262144u
+
 struct eth_backend_state {
     enum mm_eth_backend_type type;
     int fd;
     char spec[128];
+    struct mm_chan *chan;
+    struct mm_eth_shm *shm;
+    mm_u64 now_ns;
+    mm_u64 cycles;
 #ifdef M33MU_HAS_VDE
     VDECONN *vde;
 #endif
@@ -32,12 +44,20 @@ struct eth_backend_state {
 static struct eth_backend_state g_backend = {
     MM_ETH_BACKEND_NONE,
     -1,
-    { 0 }
+    { 0 },
+    0,
+    0,
+    0,
+    0
 #ifdef M33MU_HAS_VDE
     , 0
 #endif
 };
 
+/* Kept apart from g_backend: the capture outlives backend reconfiguration. */
+static struct mm_pcap g_capture;
+static mm_bool g_capture_on = MM_FALSE;
+
 static void eth_backend_reset(void)
 {
     memset(&g_backend, 0, sizeof(g_backend));
@@ -58,6 +78,17 @@ const char *mm_eth_backend_spec(void)
     return g_backend.spec;
 }
 
+void mm_eth_backend_set_now(mm_u64 vtime_ns, mm_u64 cycles)
+{
+    g_backend.now_ns = vtime_ns;
+    g_backend.cycles = cycles;
+}
+
+void mm_eth_backend_set_epoch(mm_u32 epoch)
+{
+    mm_eth_shm_set_epoch(g_backend.shm, epoch);
+}
+
 mm_bool mm_eth_backend_config(enum mm_eth_backend_type type, const char *spec)
 {
     if (type == MM_ETH_BACKEND_NONE) {
@@ -67,6 +98,10 @@ mm_bool mm_eth_backend_config(enum mm_eth_backend_type type, const char *spec)
     if (spec == 0 || spec[0] == '\0') {
         return MM_FALSE;
     }
+    if (type == MM_ETH_BACKEND_SHM) {
+        struct mm_eth_shm_cfg shm_cfg;
+        if (!mm_eth_shm_parse(spec, &shm_cfg)) return MM_FALSE;
+    }
     g_backend.type = type;
     g_backend.fd = -1;
     snprintf(g_backend.spec, sizeof(g_backend.spec), "%s", spec);
@@ -103,6 +138,19 @@ static mm_bool eth_backend_open_tap(const char *name)
 }
 
 #ifdef M33MU_HAS_VDE
+/* Run on the reactor thread once the VDE data fd is readable. */
+static int eth_vde_recv(void *ctx, mm_u8 *buf, mm_u32 len)
+{
+    ssize_t n = vde_recv((VDECONN *)ctx, buf, len, 0);
+    return (n > 0) ? (int)n : 0;
+}
+
+static int eth_vde_send(void *ctx, const mm_u8 *buf, mm_u32 len)
+{
+    ssize_t n = vde_send((VDECONN *)ctx, buf, len, 0);
+    return (n > 0) ? (int)n : 0;
+}
+
 static mm_bool eth_backend_open_vde(const char *sock)
 {
     g_backend.vde = vde_open(sock, "m33mu", 0);
@@ -120,11 +168,41 @@ mm_bool mm_eth_backend_start(void)
         return MM_TRUE;
     }
     if (g_backend.type == MM_ETH_BACKEND_TAP) {
-        return eth_backend_open_tap(g_backend.spec);
+        if (!eth_backend_open_tap(g_backend.spec)) return MM_FALSE;
+        g_backend.chan = mm_reactor_open(MM_CHAN_FRAME, g_backend.fd, 0, ETH_RING_SIZE, ETH_RING_SIZE);
+        if (g_backend.chan == 0) {
+            close(g_backend.fd);
+            g_backend.fd = -1;
+            return MM_FALSE;
+        }
+        return MM_TRUE;
+    }
+    if (g_backend.type == MM_ETH_BACKEND_SHM) {
+        struct mm_eth_shm_cfg shm_cfg;
+        if (!mm_eth_shm_parse(g_backend.spec, &shm_cfg)) return MM_FALSE;
+        g_backend.shm = mm_eth_shm_attach(&shm_cfg);
+        if (g_backend.shm == 0) return MM_FALSE;
+        (void)mm_hostwait_watch(mm_eth_shm_bell_fd(g_backend.shm));
+        return MM_TRUE;
     }
     if (g_backend.type == MM_ETH_BACKEND_VDE) {
 #ifdef M33MU_HAS_VDE
-        return eth_backend_open_vde(g_backend.spec);
+        {
+            struct mm_chan_io io;
+            if (!eth_backend_open_vde(g_backend.spec)) return MM_FALSE;
+            io.recv = eth_vde_recv;
+            io.send = eth_vde_send;
+            io.ctx = g_backend.vde;
+            /* The data fd is only polled; libvdeplug does the I/O. */
+            g_backend.chan = mm_reactor_open(MM_CHAN_FRAME, vde_datafd(g_backend.vde), &io,
+                                             ETH_RING_SIZE, ETH_RING_SIZE);
+            if (g_backend.chan == 0) {
+                vde_close(g_backend.vde);
+                g_backend.vde = 0;
+                return MM_FALSE;
+            }
+            return MM_TRUE;
+        }
 #else
         fprintf(stderr, "VDE backend requested but vde-2 not available at build time\n");
         return MM_FALSE;
@@ -135,12 +213,15 @@ mm_bool mm_eth_backend_start(void)
 
 void mm_eth_backend_stop(void)
 {
-    if (g_backend.type == MM_ETH_BACKEND_TAP) {
-        if (g_backend.fd >= 0) {
-            close(g_backend.fd);
-            g_backend.fd = -1;
-        }
+    if (g_backend.shm != 0) {
+        mm_hostwait_unwatch(mm_eth_shm_bell_fd(g_backend.shm));
+        mm_eth_shm_detach(g_backend.shm);
+        g_backend.shm = 0;
     }
+    /* Closes the TAP fd; VDE is closed below. */
+    mm_reactor_close(g_backend.chan);
+    g_backend.chan = 0;
+    g_backend.fd = -1;
 #ifdef M33MU_HAS_VDE
     if (g_backend.type == MM_ETH_BACKEND_VDE) {
         if (g_backend.vde != 0) {
@@ -155,7 +236,11 @@ void mm_eth_backend_stop(void)
 mm_bool mm_eth_backend_is_up(void)
 {
     if (g_backend.type == MM_ETH_BACKEND_NONE) return MM_FALSE;
+    /* A replayed run configures the backend but never starts it; a
+     * recording only gets this far if it did start. */
+    if (mm_replay_playing()) return MM_TRUE;
     if (g_backend.type == MM_ETH_BACKEND_TAP) return (g_backend.fd >= 0) ? MM_TRUE : MM_FALSE;
+    if (g_backend.type == MM_ETH_BACKEND_SHM) return (g_backend.shm != 0) ? MM_TRUE : MM_FALSE;
 #ifdef M33MU_HAS_VDE
     if (g_backend.type == MM_ETH_BACKEND_VDE) return (g_backend.vde != 0) ? MM_TRUE : MM_FALSE;
 #endif
@@ -164,44 +249,72 @@ mm_bool mm_eth_backend_is_up(void)
 
 mm_bool mm_eth_backend_send(const mm_u8 *data, mm_u32 len)
 {
-    ssize_t n;
     if (data == 0 || len == 0) return MM_FALSE;
-    if (g_backend.type == MM_ETH_BACKEND_TAP) {
-        if (g_backend.fd < 0) return MM_FALSE;
-        n = write(g_backend.fd, data, len);
-        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            return MM_FALSE;
-        }
-        return (n == (ssize_t)len) ? MM_TRUE : MM_FALSE;
-    }
-#ifdef M33MU_HAS_VDE
-    if (g_backend.type == MM_ETH_BACKEND_VDE) {
-        if (g_backend.vde == 0) return MM_FALSE;
-        n = vde_send(g_backend.vde, data, len, 0);
-        return (n == (ssize_t)len) ? MM_TRUE : MM_FALSE;
-    }
-#endif
-    return MM_FALSE;
+    if (mm_replay_playing()) return MM_TRUE;
+    if (g_backend.shm != 0) return mm_eth_shm_send(g_backend.shm, data, len, g_backend.now_ns);
+    return mm_chan_send_frame(g_backend.chan, data, len);
 }
 
 int mm_eth_backend_recv(mm_u8 *data, mm_u32 len)
 {
-    ssize_t n;
+    mm_u32 n;
     if (data == 0 || len == 0) return 0;
-    if (g_backend.type == MM_ETH_BACKEND_TAP) {
-        if (g_backend.fd < 0) return 0;
-        n = read(g_backend.fd, data, len);
-        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            return 0;
-        }
-        return (n > 0) ? (int)n : 0;
+    if (mm_replay_playing()) {
+        return mm_replay_take(MM_REPLAY_ETH_RX, 0, data, len, &n) ? (int)n : 0;
     }
-#ifdef M33MU_HAS_VDE
-    if (g_backend.type == MM_ETH_BACKEND_VDE) {
-        if (g_backend.vde == 0) return 0;
-        n = vde_recv(g_backend.vde, data, len, 0);
-        return (n > 0) ? (int)n : 0;
+    if (g_backend.shm != 0) {
+        n = mm_eth_shm_recv(g_backend.shm, data, len, g_backend.now_ns);
+    } else {
+        n = mm_chan_recv_frame(g_backend.chan, data, len);
+        if (n > len) n = len;
     }
-#endif
-    return 0;
+    if (n > 0u) mm_replay_put(MM_REPLAY_ETH_RX, 0, data, n);
+    return (int)n;
+}
+
+mm_bool mm_eth_capture_open(const char *spec)
+{
+    char path[256];
+    const char *comma;
+    size_t len;
+    mm_u64 rotate = 0;
+    if (spec == 0 || spec[0] == '\0') return MM_FALSE;
+    comma = strchr(spec, ',');
+    len = (comma != 0) ? (size_t)(comma - spec) : strlen(spec);
+    if (len == 0 || len >= sizeof(path)) return MM_FALSE;
+    memcpy(path, spec, len);
+    path[len] = '\0';
+    if (comma != 0) {
+        char *end = 0;
+        unsigned long long mib;
+        if (strncmp(comma + 1, "rotate=", 7) != 0) return MM_FALSE;
+        mib = strtoull(comma + 8, &end, 10);
+        if (end == comma + 8 || *end != '\0' || mib == 0) return MM_FALSE;
+        rotate = (mm_u64)mib * 1024u * 1024u;
+    }
+    if (!mm_pcap_open(&g_capture, path, rotate)) return MM_FALSE;
+    g_capture_on = MM_TRUE;
+    return MM_TRUE;
+}
+
+void mm_eth_capture(mm_u32 flags, const char *note, const mm_u8 *data, mm_u32 len)
+{
+    if (!g_capture_on) return;
+    mm_pcap_record(&g_capture, g_backend.now_ns, g_backend.cycles, flags, note, data, len);
+}
+
+void mm_eth_capture_close(void)
+{
+    if (!g_capture_on) return;
+    g_capture_on = MM_FALSE;
+    mm_pcap_close(&g_capture);
+    fprintf(stderr, "[PCAP] %llu frames written to %s",
+            (unsigned long long)g_capture.frames, g_capture.path);
+    if (g_capture.file_index != 0u) {
+        fprintf(stderr, " (+%u rotated)", (unsigned)g_capture.file_index);
+    }
+    if (g_capture.lost != 0u) {
+        fprintf(stderr, ", %llu lost", (unsigned long long)g_capture.lost);
+    }
+    fprintf(stderr, "\n");
 }
@@ -0,0 +1,610 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include "m33mu/eth_shm.h"
+#include "m33mu/pcap.h"
+
+#define ETH_SHM_MAGIC     0x6874652d756d3333ull /* "33mu-eth" */
+#define ETH_SHM_VERSION   1u
+#define ETH_SHM_MACS      256u
+#define ETH_SHM_MAC_PROBE 16u
+#define ETH_SHM_INIT_WAIT_MS 1000
+
+enum {
+    SHM_STATE_EMPTY = 0,
+    SHM_STATE_INIT = 1,
+    SHM_STATE_READY = 2
+};
+
+/* Slot seq is odd while the owner writes it and 2 * index + 2 once the
+ * frame with that ring index is complete. */
+struct shm_slot {
+    mm_u64 seq;
+    mm_u64 vtime_ns;
+    mm_u32 len;
+    mm_u32 epoch;      /* sender's sync epoch, 0 when unsynchronised */
+    mm_u8 data[MM_ETH_SHM_FRAME_MAX];
+};
+
+struct shm_port {
+    mm_u32 owner;      /* pid, 0 when free */
+    mm_u32 gen;        /* bumped on every claim */
+    mm_u32 bell_armed; /* receiver is about to block */
+    mm_u32 pad;
+    mm_u64 tail;       /* frames published; owner writes only */
+    mm_u64 pad2[6];
+    struct shm_slot slots[MM_ETH_SHM_SLOTS];
+};
+
+/* key is the 48-bit address with bit 63 set; where packs gen << 32 | port. */
+struct shm_mac {
+    mm_u64 key;
+    mm_u64 where;
+};
+
+struct shm_segment {
+    mm_u64 magic;
+    mm_u32 version;
+    mm_u32 state;
+    mm_u32 ports;
+    mm_u32 slots;
+    mm_u32 frame_max;
+    mm_u32 pad;
+    struct shm_mac macs[ETH_SHM_MACS];
+    struct shm_port port[MM_ETH_SHM_PORTS];
+};
+
+struct mm_eth_shm {
+    struct shm_segment *seg;
+    mm_u32 port;
+    mm_u32 gen;
+    int bell_fd;
+    mm_bool armed;
+    mm_u64 latency_ns;
+    mm_u32 loss_ppm;
+    mm_u32 next_scan;
+    mm_u64 last_now;
+    mm_u32 epoch;
+    mm_bool synced;
+    mm_u64 drops;
+    mm_u32 peer_gen[MM_ETH_SHM_PORTS];
+    mm_u64 cursor[MM_ETH_SHM_PORTS];
+    mm_u8 scratch[MM_ETH_SHM_FRAME_MAX];
+    char name[MM_ETH_SHM_NAME_MAX];
+    struct mm_pcap pcap;
+};
+
+static mm_bool shm_name_ok(const char *s, size_t len)
+{
+    size_t i;
+    if (len == 0 || len >= MM_ETH_SHM_NAME_MAX) return MM_FALSE;
+    for (i = 0; i < len; ++i) {
+        char c = s[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.')) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+mm_bool mm_eth_shm_parse(const char *spec, struct mm_eth_shm_cfg *cfg)
+{
+    const char *p;
+    size_t len;
+    if (spec == 0 || cfg == 0) return MM_FALSE;
+    memset(cfg, 0, sizeof(*cfg));
+    p = strchr(spec, ',');
+    len = (p != 0) ? (size_t)(p - spec) : strlen(spec);
+    if (!shm_name_ok(spec, len)) return MM_FALSE;
+    memcpy(cfg->name, spec, len);
+    cfg->name[len] = '\0';
+    while (p != 0) {
+        const char *opt = p + 1;
+        const char *end = strchr(opt, ',');
+        size_t olen = (end != 0) ? (size_t)(end - opt) : strlen(opt);
+        char tmp[256];
+        char *stop = 0;
+        if (olen >= sizeof(tmp)) return MM_FALSE;
+        memcpy(tmp, opt, olen);
+        tmp[olen] = '\0';
+        if (strncmp(tmp, "latency_us=", 11) == 0) {
+            unsigned long long us = strtoull(tmp + 11, &stop, 10);
+            if (stop == tmp + 11 || *stop != '\0') return MM_FALSE;
+            cfg->latency_ns = (mm_u64)us * 1000ull;
+        } else if (strncmp(tmp, "loss=", 5) == 0) {
+            double pct = strtod(tmp + 5, &stop);
+            if (stop == tmp + 5 || (*stop != '\0' && strcmp(stop, "%") != 0)) return MM_FALSE;
+            if (pct < 0.0 || pct > 100.0) return MM_FALSE;
+            cfg->loss_ppm = (mm_u32)(pct * 10000.0 + 0.5);
+        } else if (strncmp(tmp, "pcap=", 5) == 0) {
+            if (tmp[5] == '\0') return MM_FALSE;
+            snprintf(cfg->pcap, sizeof(cfg->pcap), "%s", tmp + 5);
+        } else {
+            return MM_FALSE;
+        }
+        p = end;
+    }
+    return MM_TRUE;
+}
+
+static void shm_path(char *out, size_t len, const char *name)
+{
+    snprintf(out, len, "/m33mu-eth-%s", name);
+}
+
+void mm_eth_shm_unlink(const char *name)
+{
+    char path[96];
+    if (name == 0) return;
+    shm_path(path, sizeof(path), name);
+    (void)shm_unlink(path);
+}
+
+static mm_bool shm_wait_ready(struct shm_segment *seg)
+{
+    int waited = 0;
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 1000000L;
+    while (__atomic_load_n(&seg->state, __ATOMIC_ACQUIRE) != SHM_STATE_READY) {
+        if (waited++ >= ETH_SHM_INIT_WAIT_MS) return MM_FALSE;
+        nanosleep(&ts, 0);
+    }
+    return MM_TRUE;
+}
+
+static struct shm_segment *shm_map(const char *name)
+{
+    char path[96];
+    struct stat st;
+    struct shm_segment *seg;
+    mm_u32 expect = SHM_STATE_EMPTY;
+    int fd;
+    shm_path(path, sizeof(path), name);
+    fd = shm_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        perror("eth-shm open");
+        return 0;
+    }
+    if (fstat(fd, &st) < 0) {
+        perror("eth-shm stat");
+        close(fd);
+        return 0;
+    }
+    /* Growing is idempotent, so every attacher may do it. */
+    if ((mm_u64)st.st_size < (mm_u64)sizeof(*seg) &&
+        ftruncate(fd, (off_t)sizeof(*seg)) < 0) {
+        perror("eth-shm truncate");
+        close(fd);
+        return 0;
+    }
+    seg = (struct shm_segment *)mmap(0, sizeof(*seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        perror("eth-shm mmap");
+        return 0;
+    }
+    if (__atomic_compare_exchange_n(&seg->state, &expect, SHM_STATE_INIT, MM_FALSE,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        seg->magic = ETH_SHM_MAGIC;
+        seg->version = ETH_SHM_VERSION;
+        seg->ports = MM_ETH_SHM_PORTS;
+        seg->slots = MM_ETH_SHM_SLOTS;
+        seg->frame_max = MM_ETH_SHM_FRAME_MAX;
+        __atomic_store_n(&seg->state, SHM_STATE_READY, __ATOMIC_RELEASE);
+    } else if (!shm_wait_ready(seg)) {
+        fprintf(stderr, "eth-shm %s: segment never became ready\n", name);
+        munmap(seg, sizeof(*seg));
+        return 0;
+    }
+    if (seg->magic != ETH_SHM_MAGIC || seg->version != ETH_SHM_VERSION ||
+        seg->ports != MM_ETH_SHM_PORTS || seg->slots != MM_ETH_SHM_SLOTS ||
+        seg->frame_max != MM_ETH_SHM_FRAME_MAX) {
+        fprintf(stderr, "eth-shm %s: incompatible segment layout\n", name);
+        munmap(seg, sizeof(*seg));
+        return 0;
+    }
+    return seg;
+}
+
+static mm_bool shm_owner_dead(mm_u32 pid)
+{
+    return (kill((pid_t)pid, 0) < 0 && errno == ESRCH) ? MM_TRUE : MM_FALSE;
+}
+
+/* Claim a free port, or one whose owner has exited without detaching. */
+static int shm_claim(struct shm_segment *seg, mm_u32 self)
+{
+    mm_u32 i;
+    for (i = 0; i < MM_ETH_SHM_PORTS; ++i) {
+        struct shm_port *pt = &seg->port[i];
+        mm_u32 owner = __atomic_load_n(&pt->owner, __ATOMIC_ACQUIRE);
+        if (owner != 0 && (owner == self || !shm_owner_dead(owner))) continue;
+        if (__atomic_compare_exchange_n(&pt->owner, &owner, self, MM_FALSE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&pt->bell_armed, 0u, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&pt->gen, 1u, __ATOMIC_RELEASE);
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static socklen_t shm_bell_addr(struct sockaddr_un *sa, const char *name, mm_u32 port)
+{
+    int n;
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    /* Abstract namespace: vanishes with the process, nothing to clean up. */
+    n = snprintf(sa->sun_path + 1, sizeof(sa->sun_path) - 1, "m33mu-eth-%s.%u", name, (unsigned)port);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1u + (size_t)n);
+}
+
+static int shm_bell_open(const char *name, mm_u32 port)
+{
+    struct sockaddr_un sa;
+    socklen_t sl = shm_bell_addr(&sa, name, port);
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&sa, sl) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct mm_eth_shm *mm_eth_shm_attach(const struct mm_eth_shm_cfg *cfg)
+{
+    struct mm_eth_shm *sw;
+    int port;
+    mm_u32 i;
+    if (cfg == 0 || !shm_name_ok(cfg->name, strlen(cfg->name))) return 0;
+    sw = (struct mm_eth_shm *)calloc(1, sizeof(*sw));
+    if (sw == 0) return 0;
+    sw->seg = shm_map(cfg->name);
+    if (sw->seg == 0) {
+        free(sw);
+        return 0;
+    }
+    port = shm_claim(sw->seg, (mm_u32)getpid());
+    if (port < 0) {
+        fprintf(stderr, "eth-shm %s: all %u ports in use\n", cfg->name, (unsigned)MM_ETH_SHM_PORTS);
+        munmap(sw->seg, sizeof(*sw->seg));
+        free(sw);
+        return 0;
+    }
+    sw->port = (mm_u32)port;
+    sw->gen = __atomic_load_n(&sw->seg->port[port].gen, __ATOMIC_ACQUIRE);
+    sw->latency_ns = cfg->latency_ns;
+    sw->loss_ppm = cfg->loss_ppm;
+    snprintf(sw->name, sizeof(sw->name), "%s", cfg->name);
+    /* Without a doorbell the receiver simply never arms and is polled. */
+    sw->bell_fd = shm_bell_open(sw->name, sw->port);
+    /* Start from the present: frames published before we joined are not ours. */
+    for (i = 0; i < MM_ETH_SHM_PORTS; ++i) {
+        struct shm_port *pt = &sw->seg->port[i];
+        sw->peer_gen[i] = __atomic_load_n(&pt->gen, __ATOMIC_ACQUIRE);
+        sw->cursor[i] = __atomic_load_n(&pt->tail, __ATOMIC_ACQUIRE);
+    }
+    sw->next_scan = (sw->port + 1u) % MM_ETH_SHM_PORTS;
+    if (cfg->pcap[0] != '\0' && !mm_pcap_open(&sw->pcap, cfg->pcap, 0)) {
+        mm_eth_shm_detach(sw);
+        return 0;
+    }
+    return sw;
+}
+
+void mm_eth_shm_detach(struct mm_eth_shm *sw)
+{
+    struct shm_port *pt;
+    if (sw == 0) return;
+    pt = &sw->seg->port[sw->port];
+    __atomic_store_n(&pt->bell_armed, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&pt->owner, 0u, __ATOMIC_RELEASE);
+    if (sw->bell_fd >= 0) close(sw->bell_fd);
+    mm_pcap_close(&sw->pcap);
+    munmap(sw->seg, sizeof(*sw->seg));
+    free(sw);
+}
+
+int mm_eth_shm_port(const struct mm_eth_shm *sw)
+{
+    return (sw != 0) ? (int)sw->port : -1;
+}
+
+const int *mm_eth_shm_bell_fd(const struct mm_eth_shm *sw)
+{
+    return (sw != 0) ? &sw->bell_fd : 0;
+}
+
+void mm_eth_shm_set_epoch(struct mm_eth_shm *sw, mm_u32 epoch)
+{
+    if (sw == 0) return;
+    sw->epoch = epoch;
+    sw->synced = MM_TRUE;
+}
+
+mm_u64 mm_eth_shm_drops(const struct mm_eth_shm *sw)
+{
+    return (sw != 0) ? sw->drops : 0u;
+}
+
+static mm_u64 shm_mac_of(const mm_u8 *m)
+{
+    return ((mm_u64)m[0] << 40) | ((mm_u64)m[1] << 32) | ((mm_u64)m[2] << 24) |
+           ((mm_u64)m[3] << 16) | ((mm_u64)m[4] << 8) | (mm_u64)m[5];
+}
+
+static mm_u32 shm_mac_hash(mm_u64 mac)
+{
+    return (mm_u32)((mac * 0x9e3779b97f4a7c15ull) >> 56) & (ETH_SHM_MACS - 1u);
+}
+
+static void shm_learn(struct shm_segment *seg, const mm_u8 *src, mm_u32 port, mm_u32 gen)
+{
+    mm_u64 key;
+    mm_u64 where = ((mm_u64)gen << 32) | port;
+    mm_u32 h;
+    mm_u32 i;
+    if (src[0] & 1u) return; /* never learn a group address */
+    key = shm_mac_of(src) | (1ull << 63);
+    h = shm_mac_hash(key);
+    for (i = 0; i < ETH_SHM_MAC_PROBE; ++i) {
+        struct shm_mac *e = &seg->macs[(h + i) & (ETH_SHM_MACS - 1u)];
+        mm_u64 k = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+        if (k == 0 &&
+            __atomic_compare_exchange_n(&e->key, &k, key, MM_FALSE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            k = key;
+        }
+        /* On a lost race k now holds the winner's key. */
+        if (k == key) {
+            if (__atomic_load_n(&e->where, __ATOMIC_RELAXED) != where) {
+                __atomic_store_n(&e->where, where, __ATOMIC_RELEASE);
+            }
+            return;
+        }
+    }
+    /* Table neighbourhood full: the address keeps being flooded. */
+}
+
+/* Unicast to an address learned on another live port is not for us. */
+static mm_bool shm_wanted(const struct mm_eth_shm *sw, const mm_u8 *frame, mm_u32 len)
+{
+    mm_u64 key;
+    mm_u32 h;
+    mm_u32 i;
+    if (len < 6u || (frame[0] & 1u)) return MM_TRUE;
+    key = shm_mac_of(frame) | (1ull << 63);
+    h = shm_mac_hash(key);
+    for (i = 0; i < ETH_SHM_MAC_PROBE; ++i) {
+        const struct shm_mac *e = &sw->seg->macs[(h + i) & (ETH_SHM_MACS - 1u)];
+        mm_u64 k = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+        if (k == 0) return MM_TRUE;
+        if (k == key) {
+            mm_u64 where = __atomic_load_n(&e->where, __ATOMIC_ACQUIRE);
+            mm_u32 port = (mm_u32)(where & 0xffffffffu);
+            mm_u32 gen = (mm_u32)(where >> 32);
+            const struct shm_port *pt;
+            if (port == sw->port || port >= MM_ETH_SHM_PORTS) return MM_TRUE;
+            pt = &sw->seg->port[port];
+            if (__atomic_load_n(&pt->owner, __ATOMIC_ACQUIRE) == 0) return MM_TRUE;
+            return (__atomic_load_n(&pt->gen, __ATOMIC_ACQUIRE) == gen) ? MM_FALSE : MM_TRUE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static mm_bool shm_lost(const struct mm_eth_shm *sw, mm_u32 from, mm_u64 seq)
+{
+    mm_u64 z;
+    if (sw->loss_ppm == 0) return MM_FALSE;
+    /* splitmix64 finaliser */
+    z = seq ^ ((mm_u64)from << 56) ^ ((mm_u64)sw->port << 48);
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return ((z % 1000000ull) < sw->loss_ppm) ? MM_TRUE : MM_FALSE;
+}
+
+static void shm_ring_bells(struct mm_eth_shm *sw)
+{
+    mm_u32 i;
+    mm_u8 b = 0;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (i = 0; i < MM_ETH_SHM_PORTS; ++i) {
+        struct shm_port *pt = &sw->seg->port[i];
+        if (i == sw->port) continue;
+        if (__atomic_load_n(&pt->bell_armed, __ATOMIC_RELAXED) == 0) continue;
+        if (__atomic_exchange_n(&pt->bell_armed, 0u, __ATOMIC_ACQ_REL) != 0 && sw->bell_fd >= 0) {
+            struct sockaddr_un sa;
+            socklen_t sl = shm_bell_addr(&sa, sw->name, i);
+            (void)sendto(sw->bell_fd, &b, 1, MSG_DONTWAIT, (struct sockaddr *)&sa, sl);
+        }
+    }
+}
+
+mm_bool mm_eth_shm_send(struct mm_eth_shm *sw, const mm_u8 *frame, mm_u32 len, mm_u64 now_ns)
+{
+    struct shm_port *pt;
+    struct shm_slot *slot;
+    mm_u64 t;
+    if (sw == 0 || frame == 0 || len == 0 || len > MM_ETH_SHM_FRAME_MAX) return MM_FALSE;
+    pt = &sw->seg->port[sw->port];
+    t = __atomic_load_n(&pt->tail, __ATOMIC_RELAXED);
+    slot = &pt->slots[t & (MM_ETH_SHM_SLOTS - 1u)];
+    __atomic_store_n(&slot->seq, 2u * t + 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->vtime_ns = now_ns;
+    slot->len = len;
+    slot->epoch = sw->epoch;
+    memcpy(slot->data, frame, len);
+    __atomic_store_n(&slot->seq, 2u * t + 2u, __ATOMIC_RELEASE);
+    __atomic_store_n(&pt->tail, t + 1u, __ATOMIC_RELEASE);
+    if (len >= 12u) {
+        shm_learn(sw->seg, frame + 6, sw->port, sw->gen);
+    }
+    mm_pcap_record(&sw->pcap, now_ns, MM_PCAP_NO_CYCLES, MM_PCAP_OUT, 0, frame, len);
+    shm_ring_bells(sw);
+    return MM_TRUE;
+}
+
+/* Copy ring index idx of a peer into scratch. Returns 1 on success, 0 if the
+ * owner has not finished it yet and -1 if it was overwritten under us. */
+static int shm_read_slot(struct mm_eth_shm *sw, const struct shm_port *pt, mm_u64 idx,
+                         mm_u64 *vtime, mm_u32 *epoch, mm_u32 *len)
+{
+    const struct shm_slot *slot = &pt->slots[idx & (MM_ETH_SHM_SLOTS - 1u)];
+    mm_u64 want = 2u * idx + 2u;
+    mm_u64 s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    mm_u64 s2;
+    mm_u32 n;
+    if (s1 < want) return 0;
+    if (s1 != want) return -1;
+    *vtime = slot->vtime_ns;
+    *epoch = slot->epoch;
+    n = slot->len;
+    if (n > MM_ETH_SHM_FRAME_MAX) n = MM_ETH_SHM_FRAME_MAX;
+    memcpy(sw->scratch, slot->data, n);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    s2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if (s2 != want) return -1;
+    *len = n;
+    return 1;
+}
+
+/* One pass over every peer. *held is set when a frame exists but is not
+ * due yet. */
+static mm_u32 shm_scan(struct mm_eth_shm *sw, mm_u64 now_ns, mm_bool stalled, mm_bool *held)
+{
+    mm_u32 n;
+    for (n = 0; n < MM_ETH_SHM_PORTS; ++n) {
+        mm_u32 p = (sw->next_scan + n) % MM_ETH_SHM_PORTS;
+        const struct shm_port *pt = &sw->seg->port[p];
+        mm_u32 gen;
+        mm_u64 tail;
+        if (p == sw->port) continue;
+        gen = __atomic_load_n(&pt->gen, __ATOMIC_ACQUIRE);
+        if (gen != sw->peer_gen[p]) {
+            /* New owner: its history belongs to the previous occupant. */
+            sw->peer_gen[p] = gen;
+            sw->cursor[p] = __atomic_load_n(&pt->tail, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        tail = __atomic_load_n(&pt->tail, __ATOMIC_ACQUIRE);
+        while (sw->cursor[p] < tail) {
+            mm_u64 idx = sw->cursor[p];
+            mm_u64 vtime = 0;
+            mm_u32 epoch = 0;
+            mm_u32 len = 0;
+            int r;
+            if (tail - idx > MM_ETH_SHM_SLOTS) {
+                sw->drops += tail - idx - MM_ETH_SHM_SLOTS;
+                sw->cursor[p] = tail - MM_ETH_SHM_SLOTS;
+                continue;
+            }
+            r = shm_read_slot(sw, pt, idx, &vtime, &epoch, &len);
+            if (r == 0) break;
+            if (r < 0) {
+                sw->drops++;
+                sw->cursor[p] = idx + 1u;
+                continue;
+            }
+            if (sw->synced && (mm_i32)(epoch - sw->epoch) >= 0) {
+                /* Sent during the current quantum: peers may still be
+                 * behind it, so it only becomes visible after the barrier. */
+                *held = MM_TRUE;
+                break;
+            }
+            if (!stalled && sw->latency_ns != 0 && now_ns < vtime + sw->latency_ns) {
+                /* Keep per-sender order: nothing behind it is due either. */
+                *held = MM_TRUE;
+                break;
+            }
+            sw->cursor[p] = idx + 1u;
+            if (shm_lost(sw, p, idx)) {
+                sw->drops++;
+                continue;
+            }
+            if (!shm_wanted(sw, sw->scratch, len)) continue;
+            sw->next_scan = (p + 1u) % MM_ETH_SHM_PORTS;
+            return len;
+        }
+    }
+    return 0;
+}
+
+static void shm_drain_bell(struct mm_eth_shm *sw)
+{
+    mm_u8 buf[16];
+    while (recv(sw->bell_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+    }
+}
+
+mm_u32 mm_eth_shm_recv(struct mm_eth_shm *sw, mm_u8 *buf, mm_u32 max, mm_u64 now_ns)
+{
+    struct shm_port *me;
+    mm_bool held = MM_FALSE;
+    mm_bool stalled;
+    mm_u32 len;
+    if (sw == 0 || buf == 0 || max == 0) return 0;
+    me = &sw->seg->port[sw->port];
+    if (sw->armed && __atomic_load_n(&me->bell_armed, __ATOMIC_ACQUIRE) == 0) {
+        shm_drain_bell(sw);
+        sw->armed = MM_FALSE;
+    }
+    /* A core asleep with no timer armed does not advance virtual time, so
+     * latency cannot be measured; release held frames instead of waiting
+     * for a clock that will not move. Under vsync time always moves. */
+    stalled = (!sw->synced && now_ns == sw->last_now) ? MM_TRUE : MM_FALSE;
+    sw->last_now = now_ns;
+    len = shm_scan(sw, now_ns, stalled, &held);
+    if (len == 0 && !held && !sw->armed && sw->bell_fd >= 0) {
+        /* Arm, then look once more so a frame published between the scan
+         * and the arm is not left waiting for the next doorbell. */
+        __atomic_store_n(&me->bell_armed, 1u, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        sw->armed = MM_TRUE;
+        len = shm_scan(sw, now_ns, stalled, &held);
+    }
+    if (len == 0) return 0;
+    if (len > max) len = max;
+    memcpy(buf, sw->scratch, len);
+    mm_pcap_record(&sw->pcap, now_ns, MM_PCAP_NO_CYCLES, MM_PCAP_IN, 0, buf, len);
+    return len;
+}
@@ -0,0 +1,821 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <fenv.h>
+#include <math.h>
+#include <string.h>
+#include "m33mu/fpu.h"
+
+#define CONTROL_FPCA (1u << 2)
+#define F32_DEFAULT_NAN 0x7fc00000u
+#define F32_QUIET_BIT 0x00400000u
+
+static float bits_to_f(mm_u32 v)
+{
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+static mm_u32 f_to_bits(float f)
+{
+    mm_u32 v;
+    memcpy(&v, &f, sizeof(v));
+    return v;
+}
+
+static mm_bool f32_is_nan(mm_u32 v)
+{
+    return (v & 0x7f800000u) == 0x7f800000u && (v & 0x007fffffu) != 0u;
+}
+
+static mm_bool f32_is_snan(mm_u32 v)
+{
+    return f32_is_nan(v) && (v & F32_QUIET_BIT) == 0u;
+}
+
+static mm_bool f32_is_denormal(mm_u32 v)
+{
+    return (v & 0x7f800000u) == 0u && (v & 0x007fffffu) != 0u;
+}
+
+static mm_bool fpca_get(const struct mm_cpu *cpu)
+{
+    return ((cpu->control_s | cpu->control_ns) & CONTROL_FPCA) != 0u;
+}
+
+static void fpca_set(struct mm_cpu *cpu, mm_bool on)
+{
+    if (on) {
+        cpu->control_s |= CONTROL_FPCA;
+        cpu->control_ns |= CONTROL_FPCA;
+    } else {
+        cpu->control_s &= ~CONTROL_FPCA;
+        cpu->control_ns &= ~CONTROL_FPCA;
+    }
+}
+
+/* ---- FPSCR-controlled evaluation on host floats ---- */
+
+static int host_round_mode(mm_u32 rmode)
+{
+    switch (rmode & 3u) {
+    case 1u: return FE_UPWARD;
+    case 2u: return FE_DOWNWARD;
+    case 3u: return FE_TOWARDZERO;
+    default: return FE_TONEAREST;
+    }
+}
+
+/* Host rounding mode to restore after the guest op, and whether IXC was
+ * already set (FZ flushing suppresses only this op's inexact). */
+static int g_host_round = FE_TONEAREST;
+static int g_guest_round = FE_TONEAREST;
+static mm_bool g_ixc_before = MM_FALSE;
+
+static void fp_begin(const struct mm_cpu *cpu)
+{
+    g_guest_round = host_round_mode(cpu->fpscr >> MM_FPSCR_RMODE_SHIFT);
+    g_host_round = fegetround();
+    if (g_guest_round != g_host_round) {
+        fesetround(g_guest_round);
+    }
+    g_ixc_before = (cpu->fpscr & MM_FPSCR_IXC) != 0u;
+    feclearexcept(FE_ALL_EXCEPT);
+}
+
+static void fp_end(struct mm_cpu *cpu)
+{
+    int ex = fetestexcept(FE_ALL_EXCEPT);
+    if (g_guest_round != g_host_round) {
+        fesetround(g_host_round);
+    }
+    if (ex & FE_INVALID) cpu->fpscr |= MM_FPSCR_IOC;
+    if (ex & FE_DIVBYZERO) cpu->fpscr |= MM_FPSCR_DZC;
+    if (ex & FE_OVERFLOW) cpu->fpscr |= MM_FPSCR_OFC;
+    if (ex & FE_UNDERFLOW) cpu->fpscr |= MM_FPSCR_UFC;
+    if (ex & FE_INEXACT) cpu->fpscr |= MM_FPSCR_IXC;
+}
+
+/* Operand fetch with flush-to-zero of denormal inputs. */
+static mm_u32 fp_in(struct mm_cpu *cpu, mm_u32 v)
+{
+    if ((cpu->fpscr & MM_FPSCR_FZ) != 0u && f32_is_denormal(v)) {
+        cpu->fpscr |= MM_FPSCR_IDC;
+        return v & 0x80000000u;
+    }
+    return v;
+}
+
+/* Result write-back: generated NaNs become the Arm default NaN (the host
+ * produces a negative one), and FZ flushes tiny results. */
+static mm_u32 fp_out(struct mm_cpu *cpu, float r)
+{
+    mm_u32 v = f_to_bits(r);
+    if (f32_is_nan(v)) {
+        return F32_DEFAULT_NAN;
+    }
+    if ((cpu->fpscr & MM_FPSCR_FZ) != 0u && f32_is_denormal(v)) {
+        cpu->fpscr |= MM_FPSCR_UFC;
+        if (!g_ixc_before) {
+            cpu->fpscr &= ~MM_FPSCR_IXC;
+        }
+        return v & 0x80000000u;
+    }
+    return v;
+}
+
+static mm_u32 nan_result(struct mm_cpu *cpu, mm_u32 v)
+{
+    if (f32_is_snan(v)) {
+        cpu->fpscr |= MM_FPSCR_IOC;
+    }
+    if ((cpu->fpscr & MM_FPSCR_DN) != 0u) {
+        return F32_DEFAULT_NAN;
+    }
+    return v | F32_QUIET_BIT;
+}
+
+/* FPProcessNaNs: signalling NaNs first, then quiet NaNs, in operand order. */
+static mm_bool process_nans(struct mm_cpu *cpu, const mm_u32 *ops, int n, mm_u32 *out)
+{
+    int i;
+    for (i = 0; i < n; ++i) {
+        if (f32_is_snan(ops[i])) {
+            *out = nan_result(cpu, ops[i]);
+            return MM_TRUE;
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        if (f32_is_nan(ops[i])) {
+            *out = nan_result(cpu, ops[i]);
+            return MM_TRUE;
+        }
+    }
+    return MM_FALSE;
+}
+
+enum fp_binop { FP_ADD, FP_SUB, FP_MUL, FP_DIV };
+
+static mm_u32 fp_binop(struct mm_cpu *cpu, enum fp_binop op, mm_u32 a, mm_u32 b)
+{
+    mm_u32 ops[2];
+    mm_u32 res;
+    volatile float x;
+    volatile float y;
+    volatile float r;
+    ops[0] = a = fp_in(cpu, a);
+    ops[1] = b = fp_in(cpu, b);
+    if (process_nans(cpu, ops, 2, &res)) {
+        return res;
+    }
+    x = bits_to_f(a);
+    y = bits_to_f(b);
+    fp_begin(cpu);
+    switch (op) {
+    case FP_ADD: r = x + y; break;
+    case FP_SUB: r = x - y; break;
+    case FP_MUL: r = x * y; break;
+    default: r = x / y; break;
+    }
+    fp_end(cpu);
+    return fp_out(cpu, r);
+}
+
+/* Fused multiply-add: addend + op1 * op2 with a single rounding. */
+static mm_u32 fp_muladd(struct mm_cpu *cpu, mm_u32 addend, mm_u32 op1, mm_u32 op2)
+{
+    mm_u32 ops[3];
+    mm_u32 res;
+    volatile float a;
+    volatile float x;
+    volatile float y;
+    volatile float r;
+    ops[0] = addend = fp_in(cpu, addend);
+    ops[1] = op1 = fp_in(cpu, op1);
+    ops[2] = op2 = fp_in(cpu, op2);
+    if (process_nans(cpu, ops, 3, &res)) {
+        /* A quiet-NaN addend with inf*0 still signals Invalid. */
+        if (!f32_is_nan(op1) && !f32_is_nan(op2) &&
+            (((op1 & 0x7fffffffu) == 0x7f800000u && (op2 & 0x7fffffffu) == 0u) ||
+             ((op2 & 0x7fffffffu) == 0x7f800000u && (op1 & 0x7fffffffu) == 0u))) {
+            cpu->fpscr |= MM_FPSCR_IOC;
+            return F32_DEFAULT_NAN;
+        }
+        return res;
+    }
+    a = bits_to_f(addend);
+    x = bits_to_f(op1);
+    y = bits_to_f(op2);
+    fp_begin(cpu);
+    r = fmaf(x, y, a);
+    fp_end(cpu);
+    return fp_out(cpu, r);
+}
+
+static mm_u32 fp_sqrt(struct mm_cpu *cpu, mm_u32 a)
+{
+    mm_u32 res;
+    volatile float x;
+    volatile float r;
+    a = fp_in(cpu, a);
+    if (process_nans(cpu, &a, 1, &res)) {
+        return res;
+    }
+    x = bits_to_f(a);
+    fp_begin(cpu);
+    r = sqrtf(x);
+    fp_end(cpu);
+    return fp_out(cpu, r);
+}
+
+static void fp_compare(struct mm_cpu *cpu, mm_u32 a, mm_u32 b, mm_bool quiet_nan_exc)
+{
+    mm_u32 nzcv;
+    a = fp_in(cpu, a);
+    b = fp_in(cpu, b);
+    if (f32_is_nan(a) || f32_is_nan(b)) {
+        if (quiet_nan_exc || f32_is_snan(a) || f32_is_snan(b)) {
+            cpu->fpscr |= MM_FPSCR_IOC;
+        }
+        nzcv = 0x3u;
+    } else {
+        float x = bits_to_f(a);
+        float y = bits_to_f(b);
+        if (x == y) nzcv = 0x6u;
+        else if (x < y) nzcv = 0x8u;
+        else nzcv = 0x2u;
+    }
+    cpu->fpscr = (cpu->fpscr & 0x0fffffffu) | (nzcv << 28);
+}
+
+/* IEEE 754-2008 maxNum/minNum: a single quiet NaN loses to a number. */
+static mm_u32 fp_maxmin_num(struct mm_cpu *cpu, mm_u32 a, mm_u32 b, mm_bool is_max)
+{
+    mm_u32 ops[2];
+    mm_u32 res;
+    float x;
+    float y;
+    a = fp_in(cpu, a);
+    b = fp_in(cpu, b);
+    if (f32_is_nan(a) && !f32_is_snan(a) && !f32_is_nan(b)) a = b;
+    if (f32_is_nan(b) && !f32_is_snan(b) && !f32_is_nan(a)) b = a;
+    ops[0] = a;
+    ops[1] = b;
+    if (process_nans(cpu, ops, 2, &res)) {
+        return res;
+    }
+    x = bits_to_f(a);
+    y = bits_to_f(b);
+    if (x == y) {
+        /* +0 > -0 */
+        return is_max ? (a & b) : (a | b);
+    }
+    if (is_max) return (x > y) ? a : b;
+    return (x < y) ? a : b;
+}
+
+/* Rounds v to an integral value; rmode is an MM_FPU_RM_* selector. */
+static double round_integral(double v, mm_u32 rmode, mm_u32 fpscr)
+{
+    double t;
+    double diff;
+    if (rmode == MM_FPU_RM_FPSCR || rmode == MM_FPU_RM_X) {
+        switch ((fpscr >> MM_FPSCR_RMODE_SHIFT) & 3u) {
+        case 1u: rmode = MM_FPU_RM_P; break;
+        case 2u: rmode = MM_FPU_RM_M; break;
+        case 3u: rmode = MM_FPU_RM_Z; break;
+        default: rmode = MM_FPU_RM_N; break;
+        }
+    }
+    t = floor(v);
+    diff = v - t;
+    switch (rmode) {
+    case MM_FPU_RM_A:
+        return (v < 0.0) ? -floor(-v + 0.5) : floor(v + 0.5);
+    case MM_FPU_RM_P:
+        return (diff > 0.0) ? t + 1.0 : t;
+    case MM_FPU_RM_M:
+        return t;
+    case MM_FPU_RM_Z:
+        return (v < 0.0) ? -floor(-v) : t;
+    default:
+        if (diff > 0.5 || (diff == 0.5 && fmod(t, 2.0) != 0.0)) {
+            return t + 1.0;
+        }
+        return t;
+    }
+}
+
+static mm_u32 fp_round_int(struct mm_cpu *cpu, mm_u32 a, mm_u32 rmode)
+{
+    mm_u32 res;
+    double v;
+    double r;
+    float f;
+    a = fp_in(cpu, a);
+    if (process_nans(cpu, &a, 1, &res)) {
+        return res;
+    }
+    if ((a & 0x7f800000u) == 0x7f800000u || (a & 0x7fffffffu) == 0u) {
+        return a;
+    }
+    v = (double)bits_to_f(a);
+    r = round_integral(v, rmode, cpu->fpscr);
+    if (rmode == MM_FPU_RM_X && r != v) {
+        cpu->fpscr |= MM_FPSCR_IXC;
+    }
+    f = (float)r;
+    res = f_to_bits(f);
+    /* Keep the sign of the operand for results that round to zero. */
+    return (r == 0.0) ? (a & 0x80000000u) : res;
+}
+
+/* Float to integer/fixed point with saturation. frac_bits scales first. */
+static mm_u32 fp_to_fixed(struct mm_cpu *cpu, mm_u32 a, mm_bool is_signed, mm_u32 frac_bits,
+                          mm_u32 size, mm_u32 rmode)
+{
+    double v;
+    double r;
+    double lo;
+    double hi;
+    a = fp_in(cpu, a);
+    if (f32_is_nan(a)) {
+        cpu->fpscr |= MM_FPSCR_IOC;
+        return 0u;
+    }
+    v = ldexp((double)bits_to_f(a), (int)frac_bits);
+    r = round_integral(v, rmode, cpu->fpscr);
+    lo = is_signed ? -ldexp(1.0, (int)size - 1) : 0.0;
+    hi = is_signed ? ldexp(1.0, (int)size - 1) - 1.0 : ldexp(1.0, (int)size) - 1.0;
+    if (r < lo) {
+        r = lo;
+        cpu->fpscr |= MM_FPSCR_IOC;
+    } else if (r > hi) {
+        r = hi;
+        cpu->fpscr |= MM_FPSCR_IOC;
+    } else if (r != v) {
+        cpu->fpscr |= MM_FPSCR_IXC;
+    }
+    if (is_signed) {
+        return (mm_u32)(mm_i32)r;
+    }
+    return (mm_u32)r;
+}
+
+static mm_u32 fixed_to_fp(struct mm_cpu *cpu, mm_u32 a, mm_bool is_signed, mm_u32 frac_bits, mm_u32 size)
+{
+    double v;
+    volatile double x;
+    volatile float r;
+    if (size == 16u) {
+        a = is_signed ? (mm_u32)(mm_i32)(mm_i16)(a & 0xffffu) : (a & 0xffffu);
+    }
+    v = is_signed ? (double)(mm_i32)a : (double)a;
+    x = ldexp(v, -(int)frac_bits);
+    fp_begin(cpu);
+    r = (float)x;
+    fp_end(cpu);
+    return fp_out(cpu, r);
+}
+
+/* ---- Half precision (VCVTB/VCVTT) ---- */
+
+static mm_u32 half_to_single(struct mm_cpu *cpu, mm_u32 h)
+{
+    mm_u32 sign = (h & 0x8000u) << 16;
+    mm_u32 exp = (h >> 10) & 0x1fu;
+    mm_u32 frac = h & 0x3ffu;
+    mm_bool ahp = (cpu->fpscr & MM_FPSCR_AHP) != 0u;
+    if (exp == 0x1fu && !ahp) {
+        if (frac == 0u) return sign | 0x7f800000u;
+        if ((frac & 0x200u) == 0u) cpu->fpscr |= MM_FPSCR_IOC;
+        if ((cpu->fpscr & MM_FPSCR_DN) != 0u) return F32_DEFAULT_NAN;
+        return sign | 0x7fc00000u | (frac << 13);
+    }
+    if (exp == 0u) {
+        int e = -14;
+        if (frac == 0u) return sign;
+        while ((frac & 0x400u) == 0u) {
+            frac <<= 1;
+            e--;
+        }
+        return sign | ((mm_u32)(e + 127) << 23) | ((frac & 0x3ffu) << 13);
+    }
+    return sign | ((exp - 15u + 127u) << 23) | (frac << 13);
+}
+
+static mm_u32 single_to_half(struct mm_cpu *cpu, mm_u32 a)
+{
+    mm_u32 sign = (a >> 16) & 0x8000u;
+    mm_u32 rmode = (cpu->fpscr >> MM_FPSCR_RMODE_SHIFT) & 3u;
+    mm_bool ahp = (cpu->fpscr & MM_FPSCR_AHP) != 0u;
+    mm_u32 exp;
+    mm_u32 m;
+    int e;
+    int shift;
+    mm_u32 q;
+    mm_u32 rem;
+    mm_u32 halfway;
+    mm_bool up = MM_FALSE;
+    int max_biased = ahp ? 31 : 30;
+    int biased;
+
+    a = fp_in(cpu, a);
+    exp = (a >> 23) & 0xffu;
+    if (exp == 0xffu) {
+        if ((a & 0x007fffffu) != 0u) {
+            if (ahp) {
+                cpu->fpscr |= MM_FPSCR_IOC;
+                return sign;
+            }
+            if (f32_is_snan(a)) cpu->fpscr |= MM_FPSCR_IOC;
+            if ((cpu->fpscr & MM_FPSCR_DN) != 0u) return 0x7e00u;
+            return sign | 0x7e00u | ((a >> 13) & 0x3ffu);
+        }
+        if (ahp) {
+            cpu->fpscr |= MM_FPSCR_IOC;
+            return sign | 0x7fffu;
+        }
+        return sign | 0x7c00u;
+    }
+    if ((a & 0x7fffffffu) == 0u) {
+        return sign;
+    }
+    if (exp == 0u) {
+        e = -126;
+        m = a & 0x007fffffu;
+    } else {
+        e = (int)exp - 127;
+        m = (a & 0x007fffffu) | 0x00800000u;
+    }
+    shift = (e < -14) ? (-e - 1) : 13;
+    if (shift >= 32) {
+        q = 0u;
+        rem = m;
+        halfway = 0xffffffffu;
+    } else {
+        q = m >> shift;
+        rem = m & ((1u << shift) - 1u);
+        halfway = 1u << (shift - 1);
+    }
+    if (rem != 0u) {
+        switch (rmode) {
+        case 0u: up = (rem > halfway || (rem == halfway && (q & 1u) != 0u)) ? MM_TRUE : MM_FALSE; break;
+        case 1u: up = (sign == 0u) ? MM_TRUE : MM_FALSE; break;
+        case 2u: up = (sign != 0u) ? MM_TRUE : MM_FALSE; break;
+        default: break;
+        }
+        cpu->fpscr |= MM_FPSCR_IXC;
+    }
+    q += up ? 1u : 0u;
+    if (e < -14) {
+        if (rem != 0u) cpu->fpscr |= MM_FPSCR_UFC;
+        return sign | q;   /* q == 0x400 is the smallest normal */
+    }
+    if (q == 0x800u) {
+        q >>= 1;
+        e++;
+    }
+    biased = e + 15;
+    if (biased > max_biased) {
+        if (ahp) {
+            cpu->fpscr |= MM_FPSCR_IOC;
+            return sign | 0x7fffu;
+        }
+        cpu->fpscr |= MM_FPSCR_OFC | MM_FPSCR_IXC;
+        if (rmode == 0u || (rmode == 1u && sign == 0u) || (rmode == 2u && sign != 0u)) {
+            return sign | 0x7c00u;
+        }
+        return sign | 0x7bffu;
+    }
+    return sign | ((mm_u32)biased << 10) | (q & 0x3ffu);
+}
+
+/* ---- Access control, lazy preservation ---- */
+
+static mm_bool cp10_enabled(const struct mm_cpu *cpu)
+{
+    mm_u32 cpacr = (cpu->sec_state == MM_NONSECURE) ? cpu->cpacr_ns : cpu->cpacr_s;
+    mm_u32 cp10 = (cpacr >> 20) & 0x3u;
+    if (cpu->sec_state == MM_NONSECURE && (cpu->nsacr & (1u << 10)) == 0u) {
+        return MM_FALSE;
+    }
+    if (cp10 == 3u) {
+        return MM_TRUE;
+    }
+    if (cp10 == 1u) {
+        return (cpu->mode == MM_HANDLER || mm_cpu_get_privileged(cpu)) ? MM_TRUE : MM_FALSE;
+    }
+    return MM_FALSE;
+}
+
+static mm_bool write_fp_frame(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec,
+                              mm_u32 addr, mm_u32 *fault_addr)
+{
+    mm_u32 i;
+    for (i = 0; i < 16u; ++i) {
+        if (!mm_memmap_write(map, sec, addr + i * 4u, 4u, cpu->s[i])) {
+            if (fault_addr) *fault_addr = addr + i * 4u;
+            return MM_FALSE;
+        }
+    }
+    if (!mm_memmap_write(map, sec, addr + 64u, 4u, cpu->fpscr)) {
+        if (fault_addr) *fault_addr = addr + 64u;
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+/* ExecuteFPCheck: complete a pending lazy save, then open a new FP context. */
+static mm_bool fp_preserve(struct mm_cpu *cpu, struct mm_memmap *map, mm_u32 *fault_addr)
+{
+    if ((cpu->fpccr & MM_FPCCR_LSPACT) != 0u) {
+        enum mm_sec_state sec = ((cpu->fpccr & MM_FPCCR_S) != 0u) ? MM_SECURE : MM_NONSECURE;
+        if (!write_fp_frame(cpu, map, sec, cpu->fpcar & ~0x7u, fault_addr)) {
+            return MM_FALSE;
+        }
+        cpu->fpccr &= ~MM_FPCCR_LSPACT;
+    }
+    if ((cpu->fpccr & MM_FPCCR_ASPEN) != 0u && !fpca_get(cpu)) {
+        mm_u32 dscr = (cpu->sec_state == MM_NONSECURE) ? cpu->fpdscr_ns : cpu->fpdscr_s;
+        cpu->fpscr = (cpu->fpscr & ~0x07c00000u) | (dscr & 0x07c00000u);
+        fpca_set(cpu, MM_TRUE);
+    }
+    return MM_TRUE;
+}
+
+void mm_fpu_reset(struct mm_cpu *cpu)
+{
+    if (cpu == 0) return;
+    memset(cpu->s, 0, sizeof(cpu->s));
+    cpu->fpscr = 0;
+    cpu->cpacr_s = 0;
+    cpu->cpacr_ns = 0;
+    cpu->nsacr = 0;
+    cpu->fpccr = MM_FPCCR_RESET;
+    cpu->fpcar = 0;
+    cpu->fpdscr_s = 0;
+    cpu->fpdscr_ns = 0;
+    fpca_set(cpu, MM_FALSE);
+}
+
+mm_bool mm_fpu_exception_entry(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec,
+                               mm_u32 *sp_io, mm_u32 *exc_ret_io)
+{
+    mm_u32 sp;
+    if (cpu == 0 || sp_io == 0 || exc_ret_io == 0) return MM_FALSE;
+    if (!fpca_get(cpu)) {
+        return MM_TRUE;
+    }
+    sp = *sp_io - MM_FPU_FRAME_EXT;
+    if ((cpu->fpccr & MM_FPCCR_LSPEN) != 0u) {
+        cpu->fpcar = sp;
+        cpu->fpccr &= ~(MM_FPCCR_USER | MM_FPCCR_S | MM_FPCCR_THREAD);
+        cpu->fpccr |= MM_FPCCR_LSPACT;
+        if (sec == MM_SECURE) cpu->fpccr |= MM_FPCCR_S;
+        if (cpu->mode == MM_THREAD) cpu->fpccr |= MM_FPCCR_THREAD;
+        if (cpu->mode == MM_THREAD && !mm_cpu_get_privileged(cpu)) cpu->fpccr |= MM_FPCCR_USER;
+    } else if (!write_fp_frame(cpu, map, sec, sp, 0)) {
+        return MM_FALSE;
+    }
+    *sp_io = sp;
+    *exc_ret_io &= ~(1u << 4);
+    fpca_set(cpu, MM_FALSE);
+    return MM_TRUE;
+}
+
+mm_bool mm_fpu_exception_return(struct mm_cpu *cpu, struct mm_memmap *map, enum mm_sec_state sec,
+                                mm_u32 frame_sp, mm_bool basic_frame)
+{
+    mm_u32 i;
+    mm_u32 v;
+    if (cpu == 0) return MM_FALSE;
+    if (basic_frame) {
+        fpca_set(cpu, MM_FALSE);
+        return MM_TRUE;
+    }
+    if ((cpu->fpccr & MM_FPCCR_LSPACT) != 0u) {
+        /* The handler never touched the FPU: registers still hold the context. */
+        cpu->fpccr &= ~MM_FPCCR_LSPACT;
+    } else {
+        for (i = 0; i < 16u; ++i) {
+            if (!mm_memmap_read(map, sec, frame_sp + 32u + i * 4u, 4u, &v)) return MM_FALSE;
+            cpu->s[i] = v;
+        }
+        if (!mm_memmap_read(map, sec, frame_sp + 32u + 64u, 4u, &v)) return MM_FALSE;
+        cpu->fpscr = v;
+    }
+    fpca_set(cpu, MM_TRUE);
+    return MM_TRUE;
+}
+
+/* ---- Instruction execution ---- */
+
+static mm_bool vsel_cond(mm_u32 xpsr, mm_u32 cc)
+{
+    mm_bool n = (xpsr >> 31) & 1u;
+    mm_bool z = (xpsr >> 30) & 1u;
+    mm_bool v = (xpsr >> 28) & 1u;
+    switch (cc & 3u) {
+    case 0u: return z;
+    case 1u: return v;
+    case 2u: return n == v;
+    default: return !z && n == v;
+    }
+}
+
+static enum mm_fpu_status fp_load_store(struct mm_cpu *cpu, struct mm_memmap *map,
+                                        const struct mm_decoded *d, mm_u32 pc, mm_u32 *fault_addr)
+{
+    mm_u32 base = (d->rn == 15u) ? ((pc + 4u) & ~3u) : cpu->r[d->rn];
+    mm_u32 addr;
+    mm_u32 i;
+    mm_bool load = (d->kind == MM_OP_VLDR || d->kind == MM_OP_VLDM);
+
+    if (d->kind == MM_OP_VLDR || d->kind == MM_OP_VSTR) {
+        addr = base + d->imm;
+    } else {
+        mm_bool add = ((d->raw >> 23) & 1u) != 0u;
+        addr = add ? base : base - d->imm;
+    }
+    for (i = 0; i < d->ra; ++i) {
+        mm_u32 a = addr + i * 4u;
+        mm_u32 r = (mm_u32)d->rd + i;
+        if (load) {
+            mm_u32 v = 0;
+            if (!mm_memmap_read(map, cpu->sec_state, a, 4u, &v)) {
+                *fault_addr = a;
+                return MM_FPU_MEM_FAULT;
+            }
+            cpu->s[r] = v;
+        } else if (!mm_memmap_write(map, cpu->sec_state, a, 4u, cpu->s[r])) {
+            *fault_addr = a;
+            return MM_FPU_MEM_FAULT;
+        }
+    }
+    return MM_FPU_OK;
+}
+
+enum mm_fpu_status mm_fpu_execute(struct mm_cpu *cpu, struct mm_memmap *map,
+                                  const struct mm_decoded *d, mm_u32 pc, mm_u32 *fault_addr)
+{
+    mm_u32 *s;
+    mm_u32 imm;
+    mm_u32 dummy = 0;
+
+    if (cpu == 0 || map == 0 || d == 0) return MM_FPU_UNDEFINED;
+    if (fault_addr == 0) fault_addr = &dummy;
+    if (!cp10_enabled(cpu)) return MM_FPU_NOCP;
+    if (!fp_preserve(cpu, map, fault_addr)) return MM_FPU_MEM_FAULT;
+    s = cpu->s;
+    imm = d->imm;
+
+    switch (d->kind) {
+    case MM_OP_VLDR:
+    case MM_OP_VSTR:
+    case MM_OP_VLDM:
+    case MM_OP_VSTM:
+        return fp_load_store(cpu, map, d, pc, fault_addr);
+    case MM_OP_VMOV_CR:
+        if (imm) {
+            if (d->rd == 15u) return MM_FPU_UNDEFINED;
+            cpu->r[d->rd] = s[d->rn];
+        } else {
+            s[d->rn] = cpu->r[d->rd];
+        }
+        break;
+    case MM_OP_VMOV_CR2:
+        if (imm) {
+            if (d->rd == 15u || d->ra == 15u || d->rd == d->ra) return MM_FPU_UNDEFINED;
+            cpu->r[d->rd] = s[d->rm];
+            cpu->r[d->ra] = s[d->rm + 1u];
+        } else {
+            s[d->rm] = cpu->r[d->rd];
+            s[d->rm + 1u] = cpu->r[d->ra];
+        }
+        break;
+    case MM_OP_VMRS: {
+        mm_u32 v;
+        switch (imm) {
+        case 0x1u: v = cpu->fpscr; break;
+        case 0x5u: v = MM_FPU_MVFR2; break;
+        case 0x6u: v = MM_FPU_MVFR1; break;
+        case 0x7u: v = MM_FPU_MVFR0; break;
+        default: return MM_FPU_UNDEFINED;
+        }
+        if (d->rd == 15u) {
+            if (imm != 0x1u) return MM_FPU_UNDEFINED;
+            cpu->xpsr = (cpu->xpsr & 0x0fffffffu) | (v & 0xf0000000u);
+        } else {
+            cpu->r[d->rd] = v;
+        }
+        break;
+    }
+    case MM_OP_VMSR:
+        if (imm != 0x1u || d->rd == 15u) return MM_FPU_UNDEFINED;
+        cpu->fpscr = cpu->r[d->rd] & MM_FPSCR_WRITE_MASK;
+        break;
+    case MM_OP_VMOV_IMM: s[d->rd] = imm; break;
+    case MM_OP_VMOV_REG: s[d->rd] = s[d->rm]; break;
+    case MM_OP_VABS: s[d->rd] = s[d->rm] & 0x7fffffffu; break;
+    case MM_OP_VNEG: s[d->rd] = s[d->rm] ^ 0x80000000u; break;
+    case MM_OP_VSQRT: s[d->rd] = fp_sqrt(cpu, s[d->rm]); break;
+    case MM_OP_VADD: s[d->rd] = fp_binop(cpu, FP_ADD, s[d->rn], s[d->rm]); break;
+    case MM_OP_VSUB: s[d->rd] = fp_binop(cpu, FP_SUB, s[d->rn], s[d->rm]); break;
+    case MM_OP_VMUL: s[d->rd] = fp_binop(cpu, FP_MUL, s[d->rn], s[d->rm]); break;
+    case MM_OP_VDIV: s[d->rd] = fp_binop(cpu, FP_DIV, s[d->rn], s[d->rm]); break;
+    case MM_OP_VNMUL: {
+        mm_u32 p = fp_binop(cpu, FP_MUL, s[d->rn], s[d->rm]);
+        s[d->rd] = f32_is_nan(p) ? p : (p ^ 0x80000000u);
+        break;
+    }
+    case MM_OP_VMLA:
+    case MM_OP_VMLS:
+    case MM_OP_VNMLA:
+    case MM_OP_VNMLS: {
+        /* Chained: the product is rounded before the accumulate. */
+        mm_u32 p = fp_binop(cpu, FP_MUL, s[d->rn], s[d->rm]);
+        mm_u32 acc = s[d->rd];
+        if ((d->kind == MM_OP_VMLS || d->kind == MM_OP_VNMLA) && !f32_is_nan(p)) p ^= 0x80000000u;
+        if ((d->kind == MM_OP_VNMLA || d->kind == MM_OP_VNMLS) && !f32_is_nan(acc)) acc ^= 0x80000000u;
+        s[d->rd] = fp_binop(cpu, FP_ADD, acc, p);
+        break;
+    }
+    case MM_OP_VFMA:
+    case MM_OP_VFMS:
+    case MM_OP_VFNMA:
+    case MM_OP_VFNMS: {
+        mm_u32 op1 = s[d->rn];
+        mm_u32 acc = s[d->rd];
+        if ((d->kind == MM_OP_VFMS || d->kind == MM_OP_VFNMA) && !f32_is_nan(op1)) op1 ^= 0x80000000u;
+        if ((d->kind == MM_OP_VFNMA || d->kind == MM_OP_VFNMS) && !f32_is_nan(acc)) acc ^= 0x80000000u;
+        s[d->rd] = fp_muladd(cpu, acc, op1, s[d->rm]);
+        break;
+    }
+    case MM_OP_VCMP:
+        fp_compare(cpu, s[d->rd], (imm & 2u) ? 0u : s[d->rm], (imm & 1u) != 0u);
+        break;
+    case MM_OP_VCVT_F32_INT:
+        s[d->rd] = fixed_to_fp(cpu, s[d->rm], (imm & 1u) != 0u, 0u, 32u);
+        break;
+    case MM_OP_VCVT_INT_F32:
+        s[d->rd] = fp_to_fixed(cpu, s[d->rm], (imm & 1u) != 0u, 0u, 32u,
+                               (imm & 2u) ? MM_FPU_RM_Z : MM_FPU_RM_FPSCR);
+        break;
+    case MM_OP_VCVT_FIXED: {
+        mm_u32 frac = imm & 0x3fu;
+        mm_bool is_signed = (imm & (1u << 9)) == 0u;
+        mm_u32 size = (imm & (1u << 10)) ? 32u : 16u;
+        if (imm & (1u << 8)) {
+            mm_u32 v = fp_to_fixed(cpu, s[d->rd], is_signed, frac, size, MM_FPU_RM_Z);
+            if (size == 16u) {
+                v = is_signed ? (mm_u32)(mm_i32)(mm_i16)(v & 0xffffu) : (v & 0xffffu);
+            }
+            s[d->rd] = v;
+        } else {
+            s[d->rd] = fixed_to_fp(cpu, s[d->rd], is_signed, frac, size);
+        }
+        break;
+    }
+    case MM_OP_VCVT_HALF: {
+        mm_u32 top = (imm & 2u) ? 16u : 0u;
+        if (imm & 1u) {
+            mm_u32 h = single_to_half(cpu, s[d->rm]);
+            s[d->rd] = (s[d->rd] & ~(0xffffu << top)) | (h << top);
+        } else {
+            s[d->rd] = half_to_single(cpu, (s[d->rm] >> top) & 0xffffu);
+        }
+        break;
+    }
+    case MM_OP_VRINT: s[d->rd] = fp_round_int(cpu, s[d->rm], imm); break;
+    case MM_OP_VCVT_RM:
+        s[d->rd] = fp_to_fixed(cpu, s[d->rm], (imm & 8u) != 0u, 0u, 32u, imm & 7u);
+        break;
+    case MM_OP_VSEL: s[d->rd] = vsel_cond(cpu->xpsr, imm) ? s[d->rn] : s[d->rm]; break;
+    case MM_OP_VMAXNM: s[d->rd] = fp_maxmin_num(cpu, s[d->rn], s[d->rm], MM_TRUE); break;
+    case MM_OP_VMINNM: s[d->rd] = fp_maxmin_num(cpu, s[d->rn], s[d->rm], MM_FALSE); break;
+    default:
+        return MM_FPU_UNDEFINED;
+    }
+    return MM_FPU_OK;
+}
@@ -0,0 +1,621 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <string.h>
+#include "m33mu/gpdma.h"
+#include "m33mu/memmap.h"
+
+#define GPDMA_SIZE 0x1000u
+
+/* Global registers */
+#define GPDMA_SECCFGR 0x00u
+#define GPDMA_PRIVCFGR 0x04u
+#define GPDMA_RCFGLOCKR 0x08u
+#define GPDMA_MISR 0x0Cu
+#define GPDMA_SMISR 0x10u
+
+/* Channel x registers, relative to 0x50 + 0x80 * x */
+#define CH_BASE 0x50u
+#define CH_STRIDE 0x80u
+#define CH_LBAR 0x00u
+#define CH_FCR 0x0Cu
+#define CH_SR 0x10u
+#define CH_CR 0x14u
+#define CH_TR1 0x40u
+#define CH_TR2 0x44u
+#define CH_BR1 0x48u
+#define CH_SAR 0x4Cu
+#define CH_DAR 0x50u
+#define CH_TR3 0x54u
+#define CH_BR2 0x58u
+#define CH_LLR 0x7Cu
+
+#define CR_EN (1u << 0)
+#define CR_RESET (1u << 1)
+#define CR_SUSP (1u << 2)
+#define CR_LSM (1u << 16)
+#define CR_MASK 0x00C37F05u
+
+/* SR flags share their bit position with the CR enables. */
+#define SR_IDLEF (1u << 0)
+#define SR_TCF (1u << 8)
+#define SR_HTF (1u << 9)
+#define SR_DTEF (1u << 10)
+#define SR_ULEF (1u << 11)
+#define SR_USEF (1u << 12)
+#define SR_SUSPF (1u << 13)
+#define SR_TOF (1u << 14)
+#define SR_FLAGS 0x7F00u
+
+#define TR1_SINC (1u << 3)
+#define TR1_DINC (1u << 19)
+#define TR2_SWREQ (1u << 9)
+#define TR2_DREQ (1u << 10)
+#define TR3_SAO 0x1FFFu
+#define TR3_DAO 0x1FFFu
+#define TR3_DAO_SHIFT 16u
+#define BR1_BNDT 0xFFFFu
+#define BR1_SDEC (1u << 28)
+#define BR1_DDEC (1u << 29)
+#define BR1_BRSDEC (1u << 30)
+#define BR1_BRDDEC (1u << 31)
+
+#define LLR_LA 0xFFFCu
+#define LLR_ULL (1u << 16)
+#define LLR_UB2 (1u << 25)
+#define LLR_UT3 (1u << 26)
+#define LLR_UDA (1u << 27)
+#define LLR_USA (1u << 28)
+#define LLR_UB1 (1u << 29)
+#define LLR_UT2 (1u << 30)
+#define LLR_UT1 (1u << 31)
+
+/* Bursts moved per mm_gpdma_service() call across all channels. */
+#define SERVICE_ROUNDS 4096u
+
+static mm_bool clock_on(const struct mm_gpdma *dma)
+{
+    if (dma->cfg.clk_reg == 0) return MM_TRUE;
+    return ((*dma->cfg.clk_reg >> dma->cfg.clk_bit) & 1u) != 0u;
+}
+
+static mm_bool is_2d(const struct mm_gpdma *dma, mm_u32 idx)
+{
+    return idx >= dma->cfg.first_2d;
+}
+
+static void raise_flags(struct mm_gpdma *dma, mm_u32 idx, mm_u32 flags)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    int irq;
+    ch->sr |= flags;
+    if ((ch->cr & flags & SR_FLAGS) == 0u) return;
+    if (dma->nvic == 0 || dma->cfg.irqs == 0) return;
+    irq = dma->cfg.irqs[idx];
+    if (irq >= 0) {
+        mm_nvic_set_pending(dma->nvic, (mm_u32)irq, MM_TRUE);
+    }
+}
+
+static void channel_stop(struct mm_gpdma *dma, mm_u32 idx, mm_u32 flags)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    ch->cr &= ~(CR_EN | CR_SUSP);
+    ch->sr |= SR_IDLEF;
+    dma->active &= ~(1u << idx);
+    if (flags != 0u) {
+        raise_flags(dma, idx, flags);
+    }
+}
+
+static mm_u32 sdw_bytes(const struct mm_gpdma_channel *ch)
+{
+    return 1u << (ch->tr1 & 3u);
+}
+
+static mm_u32 ddw_bytes(const struct mm_gpdma_channel *ch)
+{
+    return 1u << ((ch->tr1 >> 16) & 3u);
+}
+
+static mm_u32 tcem(const struct mm_gpdma_channel *ch)
+{
+    return (ch->tr2 >> 30) & 3u;
+}
+
+static mm_u32 step_addr(mm_u32 addr, mm_u32 bytes, mm_bool dec)
+{
+    return dec ? addr - bytes : addr + bytes;
+}
+
+/* Count one beat of a programmed burst; when the burst completes, 2D
+ * channels move the address by the CTR3 offset (SDEC/DDEC: downwards). */
+static mm_u32 burst_beat(mm_u32 addr, mm_u32 *beats, mm_u32 burst_len, mm_u32 offset, mm_bool dec)
+{
+    if (++*beats < burst_len) return addr;
+    *beats = 0;
+    return step_addr(addr, offset, dec);
+}
+
+static mm_bool write_beat(struct mm_gpdma *dma, struct mm_gpdma_channel *ch, const mm_u8 *data, mm_u32 len)
+{
+    if (!mm_dma_transfer(dma->cfg.bus, ch->dar, (void *)data, len, MM_TRUE)) {
+        return MM_FALSE;
+    }
+    if ((ch->tr1 & TR1_DINC) != 0u) {
+        ch->dar += len;
+    }
+    ch->dar = burst_beat(ch->dar, &ch->dst_beats, ((ch->tr1 >> 20) & 0x3Fu) + 1u,
+                         (ch->tr3 >> TR3_DAO_SHIFT) & TR3_DAO, (ch->br1 & BR1_DDEC) != 0u);
+    return MM_TRUE;
+}
+
+/* Move n source bytes from SAR to DAR, applying data width conversion
+ * (PAM) beat by beat unless both sides are incrementing memory of the
+ * same width, in which case the whole run is one mm_dma_copy(). */
+static mm_bool move_bytes(struct mm_gpdma *dma, struct mm_gpdma_channel *ch, mm_u32 n)
+{
+    mm_u32 sdw = sdw_bytes(ch);
+    mm_u32 ddw = ddw_bytes(ch);
+    mm_u32 pam = (ch->tr1 >> 11) & 3u;
+    mm_u32 sbl = ((ch->tr1 >> 4) & 0x3Fu) + 1u;
+    mm_bool sinc = (ch->tr1 & TR1_SINC) != 0u;
+    mm_bool sdec = (ch->br1 & BR1_SDEC) != 0u;
+    mm_u8 beat[4];
+    mm_u8 out[4];
+    mm_u32 i;
+
+    if (sdw == ddw && sinc && (ch->tr1 & TR1_DINC) != 0u &&
+        ch->tr3 == 0u && ch->pack_len == 0u) {
+        if (!mm_dma_copy(dma->cfg.bus, ch->dar, ch->sar, n)) {
+            return MM_FALSE;
+        }
+        ch->sar += n;
+        ch->dar += n;
+        return MM_TRUE;
+    }
+    while (n >= sdw) {
+        if (!mm_dma_transfer(dma->cfg.bus, ch->sar, beat, sdw, MM_FALSE)) {
+            return MM_FALSE;
+        }
+        if (sinc) {
+            ch->sar += sdw;
+        }
+        ch->sar = burst_beat(ch->sar, &ch->src_beats, sbl, ch->tr3 & TR3_SAO, sdec);
+        n -= sdw;
+        if (sdw == ddw) {
+            if (!write_beat(dma, ch, beat, ddw)) return MM_FALSE;
+        } else if (pam >= 2u) {
+            /* Packed/unpacked: the beats form a byte stream. */
+            for (i = 0; i < sdw; ++i) {
+                ch->pack[ch->pack_len++] = beat[i];
+                if (ch->pack_len == ddw) {
+                    if (!write_beat(dma, ch, ch->pack, ddw)) return MM_FALSE;
+                    ch->pack_len = 0;
+                }
+            }
+        } else if (sdw < ddw) {
+            /* Right aligned, zero (PAM=0) or sign (PAM=1) extended. */
+            mm_u8 fill = (pam == 1u && (beat[sdw - 1u] & 0x80u) != 0u) ? 0xFFu : 0x00u;
+            for (i = 0; i < ddw; ++i) {
+                out[i] = (i < sdw) ? beat[i] : fill;
+            }
+            if (!write_beat(dma, ch, out, ddw)) return MM_FALSE;
+        } else {
+            /* Left truncated (PAM=0) or right truncated (PAM=1). */
+            const mm_u8 *src = (pam == 1u) ? beat + (sdw - ddw) : beat;
+            if (!write_beat(dma, ch, src, ddw)) return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static mm_bool flush_pack(struct mm_gpdma *dma, struct mm_gpdma_channel *ch)
+{
+    mm_u32 i;
+    for (i = 0; i < ch->pack_len; ++i) {
+        if (!write_beat(dma, ch, &ch->pack[i], 1u)) return MM_FALSE;
+    }
+    ch->pack_len = 0;
+    return MM_TRUE;
+}
+
+/* Fetch the next linked-list item: one word per CLLR update bit, in
+ * register order, from LBAR[31:16] | LA. */
+static mm_bool load_lli(struct mm_gpdma *dma, mm_u32 idx)
+{
+    static const mm_u32 ubits[8] = {
+        LLR_UT1, LLR_UT2, LLR_UB1, LLR_USA, LLR_UDA, LLR_UT3, LLR_UB2, LLR_ULL
+    };
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    mm_u32 *dst[8];
+    mm_u32 llr = ch->llr;
+    mm_u32 addr = (ch->lbar & 0xFFFF0000u) | (llr & LLR_LA);
+    mm_u32 i;
+
+    dst[0] = &ch->tr1;
+    dst[1] = &ch->tr2;
+    dst[2] = &ch->br1;
+    dst[3] = &ch->sar;
+    dst[4] = &ch->dar;
+    dst[5] = &ch->tr3;
+    dst[6] = &ch->br2;
+    dst[7] = &ch->llr;
+    ch->llr = 0;
+    for (i = 0; i < 8u; ++i) {
+        mm_u8 w[4];
+        if ((llr & ubits[i]) == 0u) continue;
+        if ((i == 5u || i == 6u) && !is_2d(dma, idx)) continue;
+        if (!mm_dma_transfer(dma->cfg.bus, addr, w, 4u, MM_FALSE)) {
+            return MM_FALSE;
+        }
+        *dst[i] = (mm_u32)w[0] | ((mm_u32)w[1] << 8) | ((mm_u32)w[2] << 16) | ((mm_u32)w[3] << 24);
+        addr += 4u;
+    }
+    if ((llr & LLR_UB1) == 0u) {
+        ch->br1 = (ch->br1 & ~BR1_BNDT) | ch->block_bytes;
+    }
+    ch->block_bytes = ch->br1 & BR1_BNDT;
+    ch->ht_done = MM_FALSE;
+    ch->src_beats = 0;
+    ch->dst_beats = 0;
+    return MM_TRUE;
+}
+
+/* Block finished: repeat it (2D), chain to the next LLI or complete the
+ * channel. Returns MM_TRUE while the channel has more work. */
+static mm_bool block_end(struct mm_gpdma *dma, mm_u32 idx)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    mm_u32 brc = (ch->br1 >> 16) & 0x7FFu;
+    mm_u32 reqsel = ch->tr2 & 0xFFu;
+    mm_bool hw = (ch->tr2 & TR2_SWREQ) == 0u;
+
+    if (!flush_pack(dma, ch)) {
+        channel_stop(dma, idx, SR_DTEF);
+        return MM_FALSE;
+    }
+    if (is_2d(dma, idx) && brc != 0u) {
+        ch->br1 = (ch->br1 & ~(0x7FFu << 16)) | ((brc - 1u) << 16);
+        ch->sar = step_addr(ch->sar, ch->br2 & 0xFFFFu, (ch->br1 & BR1_BRSDEC) != 0u);
+        ch->dar = step_addr(ch->dar, ch->br2 >> 16, (ch->br1 & BR1_BRDDEC) != 0u);
+        ch->br1 = (ch->br1 & ~BR1_BNDT) | ch->block_bytes;
+        ch->ht_done = MM_FALSE;
+        ch->src_beats = 0;
+        ch->dst_beats = 0;
+        if (tcem(ch) == 0u) {
+            raise_flags(dma, idx, SR_TCF);
+        }
+        return MM_TRUE;
+    }
+    if (ch->llr != 0u) {
+        if (!load_lli(dma, idx)) {
+            channel_stop(dma, idx, SR_ULEF);
+            return MM_FALSE;
+        }
+        if (tcem(ch) != 3u) {
+            raise_flags(dma, idx, SR_TCF);
+        }
+        if ((ch->cr & CR_LSM) != 0u || (ch->br1 & BR1_BNDT) == 0u) {
+            channel_stop(dma, idx, 0u);
+            return MM_FALSE;
+        }
+        return MM_TRUE;
+    }
+    channel_stop(dma, idx, SR_TCF);
+    if (hw && dma->cfg.done != 0) {
+        dma->cfg.done(dma->cfg.dreq_opaque, reqsel);
+    }
+    return MM_FALSE;
+}
+
+/* One scheduling step: a burst for hardware requests, the rest of the
+ * block for software requests. Returns MM_TRUE if data moved. */
+static mm_bool channel_step(struct mm_gpdma *dma, mm_u32 idx)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    mm_u32 bndt = ch->br1 & BR1_BNDT;
+    mm_u32 sdw = sdw_bytes(ch);
+    mm_u32 n;
+
+    if ((ch->cr & (CR_EN | CR_SUSP)) != CR_EN) return MM_FALSE;
+    if ((ch->tr2 & TR2_SWREQ) != 0u) {
+        n = bndt;
+    } else {
+        if (dma->cfg.dreq == 0 || !dma->cfg.dreq(dma->cfg.dreq_opaque, ch->tr2 & 0xFFu)) {
+            return MM_FALSE;
+        }
+        if ((ch->tr2 & TR2_DREQ) != 0u) {
+            n = (((ch->tr1 >> 20) & 0x3Fu) + 1u) * ddw_bytes(ch);
+        } else {
+            n = (((ch->tr1 >> 4) & 0x3Fu) + 1u) * sdw;
+        }
+        if (n < sdw) n = sdw;
+        if (n > bndt) n = bndt;
+    }
+    if (!move_bytes(dma, ch, n)) {
+        channel_stop(dma, idx, SR_DTEF);
+        return MM_FALSE;
+    }
+    bndt -= n;
+    ch->br1 = (ch->br1 & ~BR1_BNDT) | bndt;
+    if (!ch->ht_done && tcem(ch) != 3u && bndt <= ch->block_bytes / 2u) {
+        ch->ht_done = MM_TRUE;
+        raise_flags(dma, idx, SR_HTF);
+    }
+    if (bndt == 0u) {
+        (void)block_end(dma, idx);
+    }
+    return MM_TRUE;
+}
+
+static void channel_run(struct mm_gpdma *dma, mm_u32 idx)
+{
+    mm_u32 steps;
+    for (steps = 0; steps < SERVICE_ROUNDS; ++steps) {
+        if (!channel_step(dma, idx)) break;
+    }
+}
+
+static void channel_start(struct mm_gpdma *dma, mm_u32 idx)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    mm_u32 sdw = sdw_bytes(ch);
+    ch->cr |= CR_EN;
+    ch->sr &= ~(SR_IDLEF | SR_SUSPF);
+    ch->pack_len = 0;
+    ch->src_beats = 0;
+    ch->dst_beats = 0;
+    ch->ht_done = MM_FALSE;
+    ch->block_bytes = ch->br1 & BR1_BNDT;
+    dma->active |= 1u << idx;
+    if (ch->block_bytes == 0u) {
+        /* Link-first start: program the channel from the first LLI. */
+        if (ch->llr == 0u) {
+            channel_stop(dma, idx, SR_USEF);
+            return;
+        }
+        if (!load_lli(dma, idx)) {
+            channel_stop(dma, idx, SR_ULEF);
+            return;
+        }
+        sdw = sdw_bytes(ch);
+    }
+    if (sdw > 4u || ddw_bytes(ch) > 4u || (ch->block_bytes % sdw) != 0u) {
+        channel_stop(dma, idx, SR_USEF);
+        return;
+    }
+    if ((ch->tr2 & TR2_SWREQ) != 0u) {
+        channel_run(dma, idx);
+    }
+}
+
+static void channel_reset(struct mm_gpdma *dma, mm_u32 idx)
+{
+    struct mm_gpdma_channel *ch = &dma->ch[idx];
+    ch->cr &= ~(CR_EN | CR_SUSP);
+    ch->sr = SR_IDLEF | (ch->sr & SR_FLAGS & ~SR_SUSPF);
+    ch->pack_len = 0;
+    dma->active &= ~(1u << idx);
+}
+
+static mm_u32 *chan_reg(struct mm_gpdma_channel *ch, mm_u32 rel)
+{
+    switch (rel) {
+    case CH_LBAR: return &ch->lbar;
+    case CH_SR: return &ch->sr;
+    case CH_CR: return &ch->cr;
+    case CH_TR1: return &ch->tr1;
+    case CH_TR2: return &ch->tr2;
+    case CH_BR1: return &ch->br1;
+    case CH_SAR: return &ch->sar;
+    case CH_DAR: return &ch->dar;
+    case CH_TR3: return &ch->tr3;
+    case CH_BR2: return &ch->br2;
+    case CH_LLR: return &ch->llr;
+    default: return 0;
+    }
+}
+
+static mm_u32 read_word(struct mm_gpdma *dma, mm_u32 offset)
+{
+    mm_u32 idx;
+    mm_u32 rel;
+    mm_u32 *r;
+    if (offset < CH_BASE) {
+        switch (offset) {
+        case GPDMA_SECCFGR: return dma->seccfgr;
+        case GPDMA_PRIVCFGR: return dma->privcfgr;
+        case GPDMA_RCFGLOCKR: return dma->rcfglockr;
+        case GPDMA_MISR:
+        case GPDMA_SMISR: {
+            mm_u32 v = 0;
+            mm_u32 want = (offset == GPDMA_SMISR) ? 1u : 0u;
+            for (idx = 0; idx < dma->cfg.channels; ++idx) {
+                const struct mm_gpdma_channel *ch = &dma->ch[idx];
+                if (((dma->seccfgr >> idx) & 1u) != want) continue;
+                if ((ch->sr & ch->cr & SR_FLAGS) != 0u) v |= 1u << idx;
+            }
+            return v;
+        }
+        default: return 0;
+        }
+    }
+    idx = (offset - CH_BASE) / CH_STRIDE;
+    rel = (offset - CH_BASE) % CH_STRIDE;
+    if (idx >= dma->cfg.channels) return 0;
+    if ((rel == CH_TR3 || rel == CH_BR2) && !is_2d(dma, idx)) return 0;
+    r = chan_reg(&dma->ch[idx], rel);
+    return (r != 0) ? *r : 0u;
+}
+
+static void write_word(struct mm_gpdma *dma, mm_u32 offset, mm_u32 value)
+{
+    struct mm_gpdma_channel *ch;
+    mm_u32 idx;
+    mm_u32 rel;
+    mm_u32 *r;
+    if (offset < CH_BASE) {
+        if (offset == GPDMA_SECCFGR) dma->seccfgr = value & ((1u << dma->cfg.channels) - 1u);
+        else if (offset == GPDMA_PRIVCFGR) dma->privcfgr = value & ((1u << dma->cfg.channels) - 1u);
+        else if (offset == GPDMA_RCFGLOCKR) dma->rcfglockr |= value & ((1u << dma->cfg.channels) - 1u);
+        return;
+    }
+    idx = (offset - CH_BASE) / CH_STRIDE;
+    rel = (offset - CH_BASE) % CH_STRIDE;
+    if (idx >= dma->cfg.channels) return;
+    ch = &dma->ch[idx];
+    switch (rel) {
+    case CH_FCR:
+        ch->sr &= ~(value & SR_FLAGS);
+        return;
+    case CH_SR:
+        return;
+    case CH_LBAR:
+        ch->lbar = value & 0xFFFF0000u;
+        return;
+    case CH_CR: {
+        mm_u32 old = ch->cr;
+        if ((value & CR_RESET) != 0u) {
+            channel_reset(dma, idx);
+            return;
+        }
+        ch->cr = (value & CR_MASK & ~CR_EN) | (old & CR_EN);
+        if ((old & CR_EN) == 0u && (value & CR_EN) != 0u) {
+            channel_start(dma, idx);
+        } else if ((old & CR_EN) != 0u && (old & CR_SUSP) == 0u && (value & CR_SUSP) != 0u) {
+            ch->sr |= SR_IDLEF;
+            raise_flags(dma, idx, SR_SUSPF);
+        } else if ((old & CR_EN) != 0u && (old & CR_SUSP) != 0u && (value & CR_SUSP) == 0u) {
+            ch->sr &= ~SR_IDLEF;
+            if ((ch->tr2 & TR2_SWREQ) != 0u) {
+                channel_run(dma, idx);
+            }
+        }
+        return;
+    }
+    default:
+        break;
+    }
+    if ((rel == CH_TR3 || rel == CH_BR2) && !is_2d(dma, idx)) return;
+    if (rel == CH_LLR) value &= is_2d(dma, idx) ? 0xFE01FFFCu : 0xF801FFFCu;
+    r = chan_reg(ch, rel);
+    if (r != 0) *r = value;
+}
+
+static mm_bool gpdma_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct mm_gpdma *dma = (struct mm_gpdma *)opaque;
+    mm_u32 word;
+    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > GPDMA_SIZE) return MM_FALSE;
+    if (!clock_on(dma)) {
+        *value_out = 0;
+        return MM_TRUE;
+    }
+    word = read_word(dma, offset & ~3u) >> (8u * (offset & 3u));
+    *value_out = (size_bytes == 4u) ? word : (word & ((1u << (8u * size_bytes)) - 1u));
+    return MM_TRUE;
+}
+
+static mm_bool gpdma_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct mm_gpdma *dma = (struct mm_gpdma *)opaque;
+    mm_u32 shift;
+    mm_u32 mask;
+    mm_u32 word;
+    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > GPDMA_SIZE) return MM_FALSE;
+    if (!clock_on(dma)) return MM_TRUE;
+    if (size_bytes < 4u) {
+        /* Narrow writes merge into the current register value; FCR and
+         * CR are write-sensitive, so only the written lanes count. */
+        shift = 8u * (offset & 3u);
+        mask = ((1u << (8u * size_bytes)) - 1u) << shift;
+        offset &= ~3u;
+        word = read_word(dma, offset);
+        if (offset >= CH_BASE && ((offset - CH_BASE) % CH_STRIDE) == CH_FCR) word = 0;
+        if (offset >= CH_BASE && ((offset - CH_BASE) % CH_STRIDE) == CH_CR) word &= ~CR_EN;
+        value = (word & ~mask) | ((value << shift) & mask);
+    }
+    write_word(dma, offset, value);
+    return MM_TRUE;
+}
+
+void mm_gpdma_reset(struct mm_gpdma *dma)
+{
+    mm_u32 i;
+    dma->seccfgr = 0;
+    dma->privcfgr = 0;
+    dma->rcfglockr = 0;
+    dma->active = 0;
+    memset(dma->ch, 0, sizeof(dma->ch));
+    for (i = 0; i < MM_GPDMA_MAX_CHANNELS; ++i) {
+        dma->ch[i].sr = SR_IDLEF;
+    }
+}
+
+mm_bool mm_gpdma_register(struct mmio_bus *bus, struct mm_gpdma *dma, const struct mm_gpdma_cfg *cfg)
+{
+    struct mmio_region reg;
+    dma->cfg = *cfg;
+    if (dma->cfg.channels > MM_GPDMA_MAX_CHANNELS) {
+        dma->cfg.channels = MM_GPDMA_MAX_CHANNELS;
+    }
+    if (dma->cfg.bus == 0) {
+        mm_memmap_dma_master_init(0, &dma->own_bus);
+        dma->cfg.bus = &dma->own_bus;
+    }
+    mm_gpdma_reset(dma);
+    memset(&reg, 0, sizeof(reg));
+    reg.base = cfg->base;
+    reg.size = GPDMA_SIZE;
+    reg.opaque = dma;
+    reg.read = gpdma_read;
+    reg.write = gpdma_write;
+    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    if (cfg->sec_offset != 0u) {
+        reg.base = cfg->base + cfg->sec_offset;
+        if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_gpdma_set_nvic(struct mm_gpdma *dma, struct mm_nvic *nvic)
+{
+    dma->nvic = nvic;
+}
+
+void mm_gpdma_service(struct mm_gpdma *dma)
+{
+    mm_u32 round;
+    mm_u32 idx;
+    mm_bool progress = MM_TRUE;
+    if (dma->active == 0u || !clock_on(dma)) return;
+    for (round = 0; round < SERVICE_ROUNDS && progress; ++round) {
+        progress = MM_FALSE;
+        for (idx = 0; idx < dma->cfg.channels; ++idx) {
+            if ((dma->active & (1u << idx)) == 0u) continue;
+            if (channel_step(dma, idx)) progress = MM_TRUE;
+        }
+    }
+}
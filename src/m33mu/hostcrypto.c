@@ -0,0 +1,634 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <string.h>
+#include "m33mu/hostcrypto.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <wmmintrin.h>
+#define MM_AES_NI 1
+#endif
+
+/* ---- hashing ---------------------------------------------------------- */
+
+static mm_u32 rol32(mm_u32 x, unsigned n)
+{
+    return (x << n) | (x >> (32u - n));
+}
+
+static mm_u32 ror32(mm_u32 x, unsigned n)
+{
+    return (x >> n) | (x << (32u - n));
+}
+
+static mm_u64 ror64(mm_u64 x, unsigned n)
+{
+    return (x >> n) | (x << (64u - n));
+}
+
+static mm_u32 be32(const mm_u8 *p)
+{
+    return ((mm_u32)p[0] << 24) | ((mm_u32)p[1] << 16) | ((mm_u32)p[2] << 8) | (mm_u32)p[3];
+}
+
+static mm_u32 le32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static mm_u64 be64(const mm_u8 *p)
+{
+    return ((mm_u64)be32(p) << 32) | be32(p + 4);
+}
+
+static void put_be32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v >> 24);
+    p[1] = (mm_u8)(v >> 16);
+    p[2] = (mm_u8)(v >> 8);
+    p[3] = (mm_u8)v;
+}
+
+static void put_be64(mm_u8 *p, mm_u64 v)
+{
+    put_be32(p, (mm_u32)(v >> 32));
+    put_be32(p + 4, (mm_u32)v);
+}
+
+static const mm_u32 k256[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+    0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+    0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+    0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+    0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+    0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+    0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u
+};
+
+static const mm_u64 k512[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull
+};
+
+static void sha256_block(mm_u32 *h, const mm_u8 *p)
+{
+    mm_u32 w[64];
+    mm_u32 a, b, c, d, e, f, g, hh;
+    int i;
+    for (i = 0; i < 16; ++i) {
+        w[i] = be32(p + 4 * i);
+    }
+    for (i = 16; i < 64; ++i) {
+        mm_u32 s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        mm_u32 s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+    for (i = 0; i < 64; ++i) {
+        mm_u32 t1 = hh + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) + ((e & f) ^ (~e & g)) + k256[i] + w[i];
+        mm_u32 t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void sha512_block(mm_u64 *h, const mm_u8 *p)
+{
+    mm_u64 w[80];
+    mm_u64 a, b, c, d, e, f, g, hh;
+    int i;
+    for (i = 0; i < 16; ++i) {
+        w[i] = be64(p + 8 * i);
+    }
+    for (i = 16; i < 80; ++i) {
+        mm_u64 s0 = ror64(w[i - 15], 1) ^ ror64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        mm_u64 s1 = ror64(w[i - 2], 19) ^ ror64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+    for (i = 0; i < 80; ++i) {
+        mm_u64 t1 = hh + (ror64(e, 14) ^ ror64(e, 18) ^ ror64(e, 41)) + ((e & f) ^ (~e & g)) + k512[i] + w[i];
+        mm_u64 t2 = (ror64(a, 28) ^ ror64(a, 34) ^ ror64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void sha1_block(mm_u32 *h, const mm_u8 *p)
+{
+    mm_u32 w[80];
+    mm_u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    int i;
+    for (i = 0; i < 16; ++i) {
+        w[i] = be32(p + 4 * i);
+    }
+    for (i = 16; i < 80; ++i) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    for (i = 0; i < 80; ++i) {
+        mm_u32 f;
+        mm_u32 k;
+        mm_u32 t;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999u;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1u;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdcu;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6u;
+        }
+        t = rol32(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = rol32(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void md5_block(mm_u32 *h, const mm_u8 *p)
+{
+    static const mm_u32 k[64] = {
+        0xd76aa478u, 0xe8c7b756u, 0x242070dbu, 0xc1bdceeeu, 0xf57c0fafu, 0x4787c62au, 0xa8304613u, 0xfd469501u,
+        0x698098d8u, 0x8b44f7afu, 0xffff5bb1u, 0x895cd7beu, 0x6b901122u, 0xfd987193u, 0xa679438eu, 0x49b40821u,
+        0xf61e2562u, 0xc040b340u, 0x265e5a51u, 0xe9b6c7aau, 0xd62f105du, 0x02441453u, 0xd8a1e681u, 0xe7d3fbc8u,
+        0x21e1cde6u, 0xc33707d6u, 0xf4d50d87u, 0x455a14edu, 0xa9e3e905u, 0xfcefa3f8u, 0x676f02d9u, 0x8d2a4c8au,
+        0xfffa3942u, 0x8771f681u, 0x6d9d6122u, 0xfde5380cu, 0xa4beea44u, 0x4bdecfa9u, 0xf6bb4b60u, 0xbebfbc70u,
+        0x289b7ec6u, 0xeaa127fau, 0xd4ef3085u, 0x04881d05u, 0xd9d4d039u, 0xe6db99e5u, 0x1fa27cf8u, 0xc4ac5665u,
+        0xf4292244u, 0x432aff97u, 0xab9423a7u, 0xfc93a039u, 0x655b59c3u, 0x8f0ccc92u, 0xffeff47du, 0x85845dd1u,
+        0x6fa87e4fu, 0xfe2ce6e0u, 0xa3014314u, 0x4e0811a1u, 0xf7537e82u, 0xbd3af235u, 0x2ad7d2bbu, 0xeb86d391u
+    };
+    static const mm_u8 r[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+    };
+    mm_u32 m[16];
+    mm_u32 a = h[0], b = h[1], c = h[2], d = h[3];
+    int i;
+    for (i = 0; i < 16; ++i) {
+        m[i] = le32(p + 4 * i);
+    }
+    for (i = 0; i < 64; ++i) {
+        mm_u32 f;
+        int g;
+        mm_u32 t;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+        t = d;
+        d = c;
+        c = b;
+        b = b + rol32(a + f + k[i] + m[g], r[i]);
+        a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+}
+
+mm_u32 mm_hash_block_size(enum mm_hash_algo algo)
+{
+    return (algo >= MM_HASH_SHA384) ? 128u : 64u;
+}
+
+mm_u32 mm_hash_digest_size(enum mm_hash_algo algo)
+{
+    switch (algo) {
+    case MM_HASH_SHA1: return 20u;
+    case MM_HASH_MD5: return 16u;
+    case MM_HASH_SHA224: return 28u;
+    case MM_HASH_SHA256: return 32u;
+    case MM_HASH_SHA384: return 48u;
+    case MM_HASH_SHA512_224: return 28u;
+    case MM_HASH_SHA512_256: return 32u;
+    default: return 64u;
+    }
+}
+
+void mm_hash_init(struct mm_hash_ctx *ctx, enum mm_hash_algo algo)
+{
+    static const mm_u32 iv224[8] = { 0xc1059ed8u, 0x367cd507u, 0x3070dd17u, 0xf70e5939u,
+                                     0xffc00b31u, 0x68581511u, 0x64f98fa7u, 0xbefa4fa4u };
+    static const mm_u32 iv256[8] = { 0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+                                     0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u };
+    static const mm_u64 iv384[8] = { 0xcbbb9d5dc1059ed8ull, 0x629a292a367cd507ull, 0x9159015a3070dd17ull,
+                                     0x152fecd8f70e5939ull, 0x67332667ffc00b31ull, 0x8eb44a8768581511ull,
+                                     0xdb0c2e0d64f98fa7ull, 0x47b5481dbefa4fa4ull };
+    static const mm_u64 iv512[8] = { 0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull,
+                                     0xa54ff53a5f1d36f1ull, 0x510e527fade682d1ull, 0x9b05688c2b3e6c1full,
+                                     0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull };
+    static const mm_u64 iv512_224[8] = { 0x8c3d37c819544da2ull, 0x73e1996689dcd4d6ull, 0x1dfab7ae32ff9c82ull,
+                                         0x679dd514582f9fcfull, 0x0f6d2b697bd44da8ull, 0x77e36f7304c48942ull,
+                                         0x3f9d85a86a1d36c8ull, 0x1112e6ad91d692a1ull };
+    static const mm_u64 iv512_256[8] = { 0x22312194fc2bf72cull, 0x9f555fa3c84c64c2ull, 0x2393b86b6f53b151ull,
+                                         0x963877195940eabdull, 0x96283ee2a88effe3ull, 0xbe5e1e2553863992ull,
+                                         0x2b0199fc2c85b8aaull, 0x0eb72ddc81c52ca2ull };
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->algo = algo;
+    switch (algo) {
+    case MM_HASH_SHA1:
+        ctx->h32[0] = 0x67452301u;
+        ctx->h32[1] = 0xefcdab89u;
+        ctx->h32[2] = 0x98badcfeu;
+        ctx->h32[3] = 0x10325476u;
+        ctx->h32[4] = 0xc3d2e1f0u;
+        break;
+    case MM_HASH_MD5:
+        ctx->h32[0] = 0x67452301u;
+        ctx->h32[1] = 0xefcdab89u;
+        ctx->h32[2] = 0x98badcfeu;
+        ctx->h32[3] = 0x10325476u;
+        break;
+    case MM_HASH_SHA224:
+        memcpy(ctx->h32, iv224, sizeof(iv224));
+        break;
+    case MM_HASH_SHA256:
+        memcpy(ctx->h32, iv256, sizeof(iv256));
+        break;
+    case MM_HASH_SHA384:
+        memcpy(ctx->h64, iv384, sizeof(iv384));
+        break;
+    case MM_HASH_SHA512_224:
+        memcpy(ctx->h64, iv512_224, sizeof(iv512_224));
+        break;
+    case MM_HASH_SHA512_256:
+        memcpy(ctx->h64, iv512_256, sizeof(iv512_256));
+        break;
+    default:
+        memcpy(ctx->h64, iv512, sizeof(iv512));
+        break;
+    }
+}
+
+static void hash_block(struct mm_hash_ctx *ctx, const mm_u8 *p)
+{
+    switch (ctx->algo) {
+    case MM_HASH_SHA1: sha1_block(ctx->h32, p); break;
+    case MM_HASH_MD5: md5_block(ctx->h32, p); break;
+    case MM_HASH_SHA224:
+    case MM_HASH_SHA256: sha256_block(ctx->h32, p); break;
+    default: sha512_block(ctx->h64, p); break;
+    }
+    ctx->blocks++;
+}
+
+void mm_hash_update(struct mm_hash_ctx *ctx, const mm_u8 *data, size_t len)
+{
+    mm_u32 bs = mm_hash_block_size(ctx->algo);
+    ctx->total += len;
+    if (ctx->buf_len > 0u) {
+        size_t n = bs - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buf + ctx->buf_len, data, n);
+        ctx->buf_len += (mm_u32)n;
+        data += n;
+        len -= n;
+        if (ctx->buf_len < bs) {
+            return;
+        }
+        hash_block(ctx, ctx->buf);
+        ctx->buf_len = 0;
+    }
+    while (len >= bs) {
+        hash_block(ctx, data);
+        data += bs;
+        len -= bs;
+    }
+    memcpy(ctx->buf, data, len);
+    ctx->buf_len = (mm_u32)len;
+}
+
+mm_u32 mm_hash_final(struct mm_hash_ctx *ctx, mm_u8 *out)
+{
+    mm_u32 bs = mm_hash_block_size(ctx->algo);
+    mm_u32 len_bytes = (bs == 128u) ? 16u : 8u;
+    mm_u64 bits = ctx->total * 8u;
+    mm_u32 dlen = mm_hash_digest_size(ctx->algo);
+    mm_u8 full[MM_HASH_MAX_DIGEST];
+    mm_u32 i;
+
+    ctx->buf[ctx->buf_len++] = 0x80u;
+    if (ctx->buf_len > bs - len_bytes) {
+        memset(ctx->buf + ctx->buf_len, 0, bs - ctx->buf_len);
+        hash_block(ctx, ctx->buf);
+        ctx->buf_len = 0;
+    }
+    memset(ctx->buf + ctx->buf_len, 0, bs - ctx->buf_len);
+    if (ctx->algo == MM_HASH_MD5) {
+        for (i = 0; i < 8u; ++i) {
+            ctx->buf[56 + i] = (mm_u8)(bits >> (8u * i));
+        }
+    } else {
+        put_be64(ctx->buf + bs - 8u, bits);
+    }
+    hash_block(ctx, ctx->buf);
+    ctx->buf_len = 0;
+
+    if (ctx->algo == MM_HASH_MD5) {
+        for (i = 0; i < 4u; ++i) {
+            full[4 * i] = (mm_u8)ctx->h32[i];
+            full[4 * i + 1] = (mm_u8)(ctx->h32[i] >> 8);
+            full[4 * i + 2] = (mm_u8)(ctx->h32[i] >> 16);
+            full[4 * i + 3] = (mm_u8)(ctx->h32[i] >> 24);
+        }
+    } else if (bs == 64u) {
+        for (i = 0; i < 8u; ++i) {
+            put_be32(full + 4 * i, ctx->h32[i]);
+        }
+    } else {
+        for (i = 0; i < 8u; ++i) {
+            put_be64(full + 8 * i, ctx->h64[i]);
+        }
+    }
+    memcpy(out, full, dlen);
+    return dlen;
+}
+
+/* ---- AES ----------------------------------------------------------------- */
+
+static mm_u8 aes_sbox[256];
+static mm_u8 aes_isbox[256];
+static mm_u32 aes_te[4][256];
+static mm_u32 aes_td[4][256];
+static mm_bool aes_tables_ready = MM_FALSE;
+#if defined(MM_AES_NI)
+static int aes_ni = -1;
+#endif
+
+static mm_u8 xtime(mm_u8 x)
+{
+    return (mm_u8)((x << 1) ^ ((x & 0x80u) ? 0x1bu : 0u));
+}
+
+static mm_u8 gmul(mm_u8 a, mm_u8 b)
+{
+    mm_u8 r = 0;
+    while (b != 0u) {
+        if (b & 1u) {
+            r ^= a;
+        }
+        a = xtime(a);
+        b >>= 1;
+    }
+    return r;
+}
+
+static void aes_build_tables(void)
+{
+    mm_u8 p = 1;
+    mm_u8 q = 1;
+    int i;
+    int t;
+    /* Walk the multiplicative group with generator 3 to get inverses. */
+    do {
+        mm_u8 x;
+        p = (mm_u8)(p ^ xtime(p));
+        q ^= (mm_u8)(q << 1);
+        q ^= (mm_u8)(q << 2);
+        q ^= (mm_u8)(q << 4);
+        if (q & 0x80u) {
+            q ^= 0x09u;
+        }
+        x = (mm_u8)(q ^ (mm_u8)((q << 1) | (q >> 7)) ^ (mm_u8)((q << 2) | (q >> 6)) ^
+                    (mm_u8)((q << 3) | (q >> 5)) ^ (mm_u8)((q << 4) | (q >> 4)));
+        aes_sbox[p] = (mm_u8)(x ^ 0x63u);
+    } while (p != 1u);
+    aes_sbox[0] = 0x63u;
+    for (i = 0; i < 256; ++i) {
+        aes_isbox[aes_sbox[i]] = (mm_u8)i;
+    }
+    for (i = 0; i < 256; ++i) {
+        mm_u8 s = aes_sbox[i];
+        mm_u8 is = aes_isbox[i];
+        mm_u32 e = ((mm_u32)xtime(s) << 24) | ((mm_u32)s << 16) | ((mm_u32)s << 8) | (mm_u32)(xtime(s) ^ s);
+        mm_u32 d = ((mm_u32)gmul(is, 14) << 24) | ((mm_u32)gmul(is, 9) << 16) |
+                   ((mm_u32)gmul(is, 13) << 8) | (mm_u32)gmul(is, 11);
+        for (t = 0; t < 4; ++t) {
+            aes_te[t][i] = (t == 0) ? e : ror32(e, 8u * (unsigned)t);
+            aes_td[t][i] = (t == 0) ? d : ror32(d, 8u * (unsigned)t);
+        }
+    }
+    aes_tables_ready = MM_TRUE;
+}
+
+#if defined(MM_AES_NI)
+static mm_bool aes_ni_available(void)
+{
+    if (aes_ni < 0) {
+        __builtin_cpu_init();
+        aes_ni = __builtin_cpu_supports("aes") ? 1 : 0;
+    }
+    return aes_ni ? MM_TRUE : MM_FALSE;
+}
+
+__attribute__((target("aes,sse2")))
+static void aes_ni_encrypt(const struct mm_aes_ctx *ctx, const mm_u8 *in, mm_u8 *out)
+{
+    const __m128i *rk = (const __m128i *)(const void *)ctx->ek_bytes;
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(const void *)in), _mm_loadu_si128(rk));
+    mm_u32 r;
+    for (r = 1; r < ctx->rounds; ++r) {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(rk + r));
+    }
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(rk + ctx->rounds));
+    _mm_storeu_si128((__m128i *)(void *)out, s);
+}
+
+__attribute__((target("aes,sse2")))
+static void aes_ni_decrypt(const struct mm_aes_ctx *ctx, const mm_u8 *in, mm_u8 *out)
+{
+    const __m128i *rk = (const __m128i *)(const void *)ctx->dk_bytes;
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(const void *)in), _mm_loadu_si128(rk));
+    mm_u32 r;
+    for (r = 1; r < ctx->rounds; ++r) {
+        s = _mm_aesdec_si128(s, _mm_loadu_si128(rk + r));
+    }
+    s = _mm_aesdeclast_si128(s, _mm_loadu_si128(rk + ctx->rounds));
+    _mm_storeu_si128((__m128i *)(void *)out, s);
+}
+#endif
+
+const char *mm_aes_backend(void)
+{
+#if defined(MM_AES_NI)
+    if (aes_ni_available()) {
+        return "aesni";
+    }
+#endif
+    return "table";
+}
+
+static mm_u32 sub_word(mm_u32 w)
+{
+    return ((mm_u32)aes_sbox[w >> 24] << 24) | ((mm_u32)aes_sbox[(w >> 16) & 0xffu] << 16) |
+           ((mm_u32)aes_sbox[(w >> 8) & 0xffu] << 8) | (mm_u32)aes_sbox[w & 0xffu];
+}
+
+mm_bool mm_aes_setkey(struct mm_aes_ctx *ctx, const mm_u8 *key, mm_u32 key_len)
+{
+    mm_u32 nk = key_len / 4u;
+    mm_u32 total;
+    mm_u32 rcon = 1;
+    mm_u32 i;
+    mm_u32 r;
+
+    if (key_len != 16u && key_len != 24u && key_len != 32u) {
+        return MM_FALSE;
+    }
+    if (!aes_tables_ready) {
+        aes_build_tables();
+    }
+    ctx->rounds = nk + 6u;
+    total = 4u * (ctx->rounds + 1u);
+    for (i = 0; i < nk; ++i) {
+        ctx->ek[i] = be32(key + 4u * i);
+    }
+    for (i = nk; i < total; ++i) {
+        mm_u32 t = ctx->ek[i - 1u];
+        if (i % nk == 0u) {
+            t = sub_word(rol32(t, 8)) ^ (rcon << 24);
+            rcon = xtime((mm_u8)rcon);
+        } else if (nk > 6u && i % nk == 4u) {
+            t = sub_word(t);
+        }
+        ctx->ek[i] = ctx->ek[i - nk] ^ t;
+    }
+    /* Equivalent inverse cipher: reversed round keys, InvMixColumns on the
+     * inner ones. */
+    for (r = 0; r <= ctx->rounds; ++r) {
+        for (i = 0; i < 4u; ++i) {
+            mm_u32 w = ctx->ek[4u * (ctx->rounds - r) + i];
+            if (r != 0u && r != ctx->rounds) {
+                w = aes_td[0][aes_sbox[w >> 24]] ^ aes_td[1][aes_sbox[(w >> 16) & 0xffu]] ^
+                    aes_td[2][aes_sbox[(w >> 8) & 0xffu]] ^ aes_td[3][aes_sbox[w & 0xffu]];
+            }
+            ctx->dk[4u * r + i] = w;
+        }
+    }
+    for (i = 0; i < total; ++i) {
+        put_be32(ctx->ek_bytes + 4u * i, ctx->ek[i]);
+        put_be32(ctx->dk_bytes + 4u * i, ctx->dk[i]);
+    }
+    return MM_TRUE;
+}
+
+void mm_aes_encrypt(const struct mm_aes_ctx *ctx, const mm_u8 in[16], mm_u8 out[16])
+{
+    const mm_u32 *rk = ctx->ek;
+    mm_u32 s0, s1, s2, s3, t0, t1, t2, t3;
+    mm_u32 r;
+#if defined(MM_AES_NI)
+    if (aes_ni_available()) {
+        aes_ni_encrypt(ctx, in, out);
+        return;
+    }
+#endif
+    s0 = be32(in) ^ rk[0];
+    s1 = be32(in + 4) ^ rk[1];
+    s2 = be32(in + 8) ^ rk[2];
+    s3 = be32(in + 12) ^ rk[3];
+    for (r = 1; r < ctx->rounds; ++r) {
+        rk += 4;
+        t0 = aes_te[0][s0 >> 24] ^ aes_te[1][(s1 >> 16) & 0xffu] ^ aes_te[2][(s2 >> 8) & 0xffu] ^ aes_te[3][s3 & 0xffu] ^ rk[0];
+        t1 = aes_te[0][s1 >> 24] ^ aes_te[1][(s2 >> 16) & 0xffu] ^ aes_te[2][(s3 >> 8) & 0xffu] ^ aes_te[3][s0 & 0xffu] ^ rk[1];
+        t2 = aes_te[0][s2 >> 24] ^ aes_te[1][(s3 >> 16) & 0xffu] ^ aes_te[2][(s0 >> 8) & 0xffu] ^ aes_te[3][s1 & 0xffu] ^ rk[2];
+        t3 = aes_te[0][s3 >> 24] ^ aes_te[1][(s0 >> 16) & 0xffu] ^ aes_te[2][(s1 >> 8) & 0xffu] ^ aes_te[3][s2 & 0xffu] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+    rk += 4;
+    put_be32(out, (((mm_u32)aes_sbox[s0 >> 24] << 24) | ((mm_u32)aes_sbox[(s1 >> 16) & 0xffu] << 16) |
+                   ((mm_u32)aes_sbox[(s2 >> 8) & 0xffu] << 8) | aes_sbox[s3 & 0xffu]) ^ rk[0]);
+    put_be32(out + 4, (((mm_u32)aes_sbox[s1 >> 24] << 24) | ((mm_u32)aes_sbox[(s2 >> 16) & 0xffu] << 16) |
+                       ((mm_u32)aes_sbox[(s3 >> 8) & 0xffu] << 8) | aes_sbox[s0 & 0xffu]) ^ rk[1]);
+    put_be32(out + 8, (((mm_u32)aes_sbox[s2 >> 24] << 24) | ((mm_u32)aes_sbox[(s3 >> 16) & 0xffu] << 16) |
+                       ((mm_u32)aes_sbox[(s0 >> 8) & 0xffu] << 8) | aes_sbox[s1 & 0xffu]) ^ rk[2]);
+    put_be32(out + 12, (((mm_u32)aes_sbox[s3 >> 24] << 24) | ((mm_u32)aes_sbox[(s0 >> 16) & 0xffu] << 16) |
+                        ((mm_u32)aes_sbox[(s1 >> 8) & 0xffu] << 8) | aes_sbox[s2 & 0xffu]) ^ rk[3]);
+}
+
+void mm_aes_decrypt(const struct mm_aes_ctx *ctx, const mm_u8 in[16], mm_u8 out[16])
+{
+    const mm_u32 *rk = ctx->dk;
+    mm_u32 s0, s1, s2, s3, t0, t1, t2, t3;
+    mm_u32 r;
+#if defined(MM_AES_NI)
+    if (aes_ni_available()) {
+        aes_ni_decrypt(ctx, in, out);
+        return;
+    }
+#endif
+    s0 = be32(in) ^ rk[0];
+    s1 = be32(in + 4) ^ rk[1];
+    s2 = be32(in + 8) ^ rk[2];
+    s3 = be32(in + 12) ^ rk[3];
+    for (r = 1; r < ctx->rounds; ++r) {
+        rk += 4;
+        t0 = aes_td[0][s0 >> 24] ^ aes_td[1][(s3 >> 16) & 0xffu] ^ aes_td[2][(s2 >> 8) & 0xffu] ^ aes_td[3][s1 & 0xffu] ^ rk[0];
+        t1 = aes_td[0][s1 >> 24] ^ aes_td[1][(s0 >> 16) & 0xffu] ^ aes_td[2][(s3 >> 8) & 0xffu] ^ aes_td[3][s2 & 0xffu] ^ rk[1];
+        t2 = aes_td[0][s2 >> 24] ^ aes_td[1][(s1 >> 16) & 0xffu] ^ aes_td[2][(s0 >> 8) & 0xffu] ^ aes_td[3][s3 & 0xffu] ^ rk[2];
+        t3 = aes_td[0][s3 >> 24] ^ aes_td[1][(s2 >> 16) & 0xffu] ^ aes_td[2][(s1 >> 8) & 0xffu] ^ aes_td[3][s0 & 0xffu] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+    rk += 4;
+    put_be32(out, (((mm_u32)aes_isbox[s0 >> 24] << 24) | ((mm_u32)aes_isbox[(s3 >> 16) & 0xffu] << 16) |
+                   ((mm_u32)aes_isbox[(s2 >> 8) & 0xffu] << 8) | aes_isbox[s1 & 0xffu]) ^ rk[0]);
+    put_be32(out + 4, (((mm_u32)aes_isbox[s1 >> 24] << 24) | ((mm_u32)aes_isbox[(s0 >> 16) & 0xffu] << 16) |
+                       ((mm_u32)aes_isbox[(s3 >> 8) & 0xffu] << 8) | aes_isbox[s2 & 0xffu]) ^ rk[1]);
+    put_be32(out + 8, (((mm_u32)aes_isbox[s2 >> 24] << 24) | ((mm_u32)aes_isbox[(s1 >> 16) & 0xffu] << 16) |
+                       ((mm_u32)aes_isbox[(s0 >> 8) & 0xffu] << 8) | aes_isbox[s3 & 0xffu]) ^ rk[2]);
+    put_be32(out + 12, (((mm_u32)aes_isbox[s3 >> 24] << 24) | ((mm_u32)aes_isbox[(s2 >> 16) & 0xffu] << 16) |
+                        ((mm_u32)aes_isbox[(s1 >> 8) & 0xffu] << 8) | aes_isbox[s0 & 0xffu]) ^ rk[3]);
+}
@@ -0,0 +1,295 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "m33mu/pcap.h"
+
+#define PCAPNG_SHB        0x0a0d0d0au
+#define PCAPNG_IDB        0x00000001u
+#define PCAPNG_EPB        0x00000006u
+#define PCAPNG_BOM        0x1a2b3c4du
+#define PCAPNG_LINK_ETH   1u
+
+#define PCAPNG_OPT_END       0u
+#define PCAPNG_OPT_COMMENT   1u
+#define PCAPNG_SHB_USERAPPL  4u
+#define PCAPNG_IF_TSRESOL    9u
+#define PCAPNG_EPB_FLAGS     2u
+
+/* Ring record: ts, cycles, flags, original length, note length, note, data. */
+#define PCAP_REC_HDR 28u
+#define PCAP_REC_MAX (PCAP_REC_HDR + MM_PCAP_NOTE_MAX + MM_PCAP_SNAPLEN)
+
+/* Largest EPB: header, data, flags option, comment option, end, trailer. */
+#define PCAP_BLOCK_MAX (28u + MM_PCAP_SNAPLEN + 8u + 4u + 96u + 4u + 4u)
+
+static void pcap_put16(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v & 0xffu);
+    p[1] = (mm_u8)((v >> 8) & 0xffu);
+}
+
+static void pcap_put32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v & 0xffu);
+    p[1] = (mm_u8)((v >> 8) & 0xffu);
+    p[2] = (mm_u8)((v >> 16) & 0xffu);
+    p[3] = (mm_u8)((v >> 24) & 0xffu);
+}
+
+static void pcap_put64(mm_u8 *p, mm_u64 v)
+{
+    pcap_put32(p, (mm_u32)(v & 0xffffffffu));
+    pcap_put32(p + 4, (mm_u32)(v >> 32));
+}
+
+static mm_u32 pcap_get32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static mm_u64 pcap_get64(const mm_u8 *p)
+{
+    return (mm_u64)pcap_get32(p) | ((mm_u64)pcap_get32(p + 4) << 32);
+}
+
+static mm_u32 pcap_pad4(mm_u32 n)
+{
+    return (n + 3u) & ~3u;
+}
+
+/* Append option code/len/value (zero padded) at blk + off; returns new off. */
+static mm_u32 pcap_opt(mm_u8 *blk, mm_u32 off, mm_u32 code, const void *val, mm_u32 len)
+{
+    pcap_put16(blk + off, code);
+    pcap_put16(blk + off + 2u, len);
+    memset(blk + off + 4u, 0, pcap_pad4(len));
+    if (len != 0u) memcpy(blk + off + 4u, val, len);
+    return off + 4u + pcap_pad4(len);
+}
+
+/* Close the block started at blk: end-of-options, trailer, both lengths. */
+static mm_u32 pcap_finish(mm_u8 *blk, mm_u32 off)
+{
+    off = pcap_opt(blk, off, PCAPNG_OPT_END, 0, 0);
+    off += 4u;
+    pcap_put32(blk + 4, off);
+    pcap_put32(blk + off - 4u, off);
+    return off;
+}
+
+static void pcap_emit(struct mm_pcap *p, const mm_u8 *blk, mm_u32 len)
+{
+    if (p->f == 0) return;
+    if (fwrite(blk, 1, len, p->f) == len) {
+        p->file_bytes += len;
+    }
+}
+
+static void pcap_write_headers(struct mm_pcap *p)
+{
+    mm_u8 blk[64];
+    mm_u32 off;
+    mm_u8 tsresol = 9u; /* 10^-9 s */
+    pcap_put32(blk, PCAPNG_SHB);
+    pcap_put32(blk + 8, PCAPNG_BOM);
+    pcap_put16(blk + 12, 1u);
+    pcap_put16(blk + 14, 0u);
+    pcap_put64(blk + 16, (mm_u64)-1); /* section length unknown */
+    off = pcap_opt(blk, 24u, PCAPNG_SHB_USERAPPL, "m33mu", 5u);
+    pcap_emit(p, blk, pcap_finish(blk, off));
+    pcap_put32(blk, PCAPNG_IDB);
+    pcap_put16(blk + 8, PCAPNG_LINK_ETH);
+    pcap_put16(blk + 10, 0u);
+    pcap_put32(blk + 12, MM_PCAP_SNAPLEN);
+    off = pcap_opt(blk, 16u, PCAPNG_IF_TSRESOL, &tsresol, 1u);
+    pcap_emit(p, blk, pcap_finish(blk, off));
+}
+
+static mm_bool pcap_open_file(struct mm_pcap *p)
+{
+    char name[280];
+    if (p->file_index == 0u) {
+        snprintf(name, sizeof(name), "%s", p->path);
+    } else {
+        snprintf(name, sizeof(name), "%s.%u", p->path, (unsigned)p->file_index);
+    }
+    p->f = fopen(name, "wb");
+    if (p->f == 0) {
+        perror("pcap open");
+        return MM_FALSE;
+    }
+    p->file_bytes = 0;
+    pcap_write_headers(p);
+    return MM_TRUE;
+}
+
+static void pcap_write_record(struct mm_pcap *p, const mm_u8 *rec, mm_u32 rec_len)
+{
+    mm_u8 *blk = p->work + PCAP_REC_MAX;
+    char comment[96];
+    mm_u64 ts = pcap_get64(rec);
+    mm_u64 cycles = pcap_get64(rec + 8);
+    mm_u32 flags = pcap_get32(rec + 16);
+    mm_u32 orig_len = pcap_get32(rec + 20);
+    mm_u32 note_len = pcap_get32(rec + 24);
+    const mm_u8 *data = rec + PCAP_REC_HDR + note_len;
+    mm_u32 cap_len = rec_len - PCAP_REC_HDR - note_len;
+    mm_u32 off;
+    mm_u32 dir;
+    int clen = 0;
+
+    if (cycles != MM_PCAP_NO_CYCLES) {
+        clen = snprintf(comment, sizeof(comment), "cycle=%llu", (unsigned long long)cycles);
+    }
+    if (flags & MM_PCAP_DROPPED) {
+        clen += snprintf(comment + clen, sizeof(comment) - (size_t)clen, "%sdropped",
+                         (clen != 0) ? " " : "");
+    }
+    if (note_len != 0u) {
+        clen += snprintf(comment + clen, sizeof(comment) - (size_t)clen, "%s%.*s",
+                         (clen != 0) ? ": " : "", (int)note_len, (const char *)(rec + PCAP_REC_HDR));
+    }
+    if (clen >= (int)sizeof(comment)) clen = (int)sizeof(comment) - 1;
+
+    pcap_put32(blk, PCAPNG_EPB);
+    pcap_put32(blk + 8, 0u); /* interface */
+    pcap_put32(blk + 12, (mm_u32)(ts >> 32));
+    pcap_put32(blk + 16, (mm_u32)(ts & 0xffffffffu));
+    pcap_put32(blk + 20, cap_len);
+    pcap_put32(blk + 24, orig_len);
+    memcpy(blk + 28, data, cap_len);
+    memset(blk + 28 + cap_len, 0, pcap_pad4(cap_len) - cap_len);
+    off = 28u + pcap_pad4(cap_len);
+    dir = (flags & MM_PCAP_IN) ? 1u : ((flags & MM_PCAP_OUT) ? 2u : 0u);
+    if (dir != 0u) {
+        mm_u8 v[4];
+        pcap_put32(v, dir);
+        off = pcap_opt(blk, off, PCAPNG_EPB_FLAGS, v, 4u);
+    }
+    if (clen > 0) {
+        off = pcap_opt(blk, off, PCAPNG_OPT_COMMENT, comment, (mm_u32)clen);
+    }
+    off = pcap_finish(blk, off);
+
+    if (p->rotate_bytes != 0u && p->file_bytes + off > p->rotate_bytes) {
+        fclose(p->f);
+        p->f = 0;
+        p->file_index++;
+        if (!pcap_open_file(p)) return;
+    }
+    pcap_emit(p, blk, off);
+    p->frames++;
+}
+
+static void pcap_sleep_us(long us)
+{
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = us * 1000L;
+    nanosleep(&ts, 0);
+}
+
+static void *pcap_thread_main(void *arg)
+{
+    struct mm_pcap *p = (struct mm_pcap *)arg;
+    mm_u8 *rec = p->work;
+    for (;;) {
+        mm_u32 n = mm_ring_get_frame(&p->ring, rec, PCAP_REC_MAX);
+        if (n == 0u) {
+            if (__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE)) {
+                /* Recheck: a record may have landed just before stop. */
+                n = mm_ring_get_frame(&p->ring, rec, PCAP_REC_MAX);
+                if (n == 0u) break;
+            } else {
+                if (p->f != 0) fflush(p->f);
+                pcap_sleep_us(1000);
+                continue;
+            }
+        }
+        if (n >= PCAP_REC_HDR && n <= PCAP_REC_MAX) {
+            pcap_write_record(p, rec, n);
+        }
+    }
+    return 0;
+}
+
+mm_bool mm_pcap_open(struct mm_pcap *p, const char *path, mm_u64 rotate_bytes)
+{
+    if (p == 0 || path == 0 || path[0] == '\0') return MM_FALSE;
+    memset(p, 0, sizeof(*p));
+    snprintf(p->path, sizeof(p->path), "%s", path);
+    p->rotate_bytes = rotate_bytes;
+    p->work = (mm_u8 *)malloc(PCAP_REC_MAX + PCAP_BLOCK_MAX);
+    if (p->work == 0) return MM_FALSE;
+    if (!mm_ring_init(&p->ring, MM_PCAP_RING_SIZE) || !pcap_open_file(p) ||
+        pthread_create(&p->thread, 0, pcap_thread_main, p) != 0) {
+        mm_pcap_close(p);
+        return MM_FALSE;
+    }
+    p->running = MM_TRUE;
+    return MM_TRUE;
+}
+
+void mm_pcap_record(struct mm_pcap *p, mm_u64 ts_ns, mm_u64 cycles, mm_u32 flags,
+                    const char *note, const mm_u8 *data, mm_u32 len)
+{
+    mm_u8 rec[PCAP_REC_MAX];
+    mm_u32 note_len = 0;
+    mm_u32 cap_len;
+    if (p == 0 || !p->running || data == 0) return;
+    if (note != 0) {
+        note_len = (mm_u32)strlen(note);
+        if (note_len > MM_PCAP_NOTE_MAX) note_len = MM_PCAP_NOTE_MAX;
+    }
+    cap_len = (len > MM_PCAP_SNAPLEN) ? MM_PCAP_SNAPLEN : len;
+    pcap_put64(rec, ts_ns);
+    pcap_put64(rec + 8, cycles);
+    pcap_put32(rec + 16, flags);
+    pcap_put32(rec + 20, len);
+    pcap_put32(rec + 24, note_len);
+    if (note_len != 0u) memcpy(rec + PCAP_REC_HDR, note, note_len);
+    memcpy(rec + PCAP_REC_HDR + note_len, data, cap_len);
+    if (!mm_ring_put_frame(&p->ring, rec, PCAP_REC_HDR + note_len + cap_len)) {
+        p->lost++;
+    }
+}
+
+void mm_pcap_close(struct mm_pcap *p)
+{
+    if (p == 0) return;
+    if (p->running) {
+        __atomic_store_n(&p->stop, 1, __ATOMIC_RELEASE);
+        pthread_join(p->thread, 0);
+        p->running = MM_FALSE;
+    }
+    if (p->f != 0) {
+        fclose(p->f);
+        p->f = 0;
+    }
+    mm_ring_free(&p->ring);
+    free(p->work);
+    p->work = 0;
+}
@@ -73,6 +73,32 @@ mm_u8 mm_spi_bus_xfer(int bus, mm_u8 out)
     return dev->xfer(dev->opaque, out);
 }
 
+void mm_spi_bus_xfer_buf(int bus, const mm_u8 *out, mm_u8 fill, mm_u8 *in, size_t len)
+{
+    struct mm_spi_device *dev;
+    size_t i;
+    if (len == 0u) {
+        return;
+    }
+    dev = spi_bus_select(bus);
+    if (dev == 0) {
+        if (in != 0) {
+            memset(in, 0xFF, len);
+        }
+        return;
+    }
+    if (dev->xfer_buf != 0) {
+        dev->xfer_buf(dev->opaque, out, fill, in, len);
+        return;
+    }
+    for (i = 0; i < len; ++i) {
+        mm_u8 v = dev->xfer(dev->opaque, (out != 0) ? out[i] : fill);
+        if (in != 0) {
+            in[i] = v;
+        }
+    }
+}
+
 void mm_spi_bus_end(int bus)
 {
     size_t i;
@@ -8,6 +8,7 @@
 #include "m33mu/spiflash.h"
 #include "m33mu/spi_bus.h"
 #include "m33mu/mmio.h"
+#include "m33mu/memmap.h"
 #include "m33mu/mem_prot.h"
 #include "m33mu/gpio.h"
 
@@ -232,6 +233,9 @@ static void spiflash_erase_range(struct mm_spiflash *flash, mm_u32 addr, mm_u32
     memset(flash->data + addr, 0xFF, (size_t)(end - addr));
     flash->dirty = MM_TRUE;
     spiflash_sync(flash);
+    if (flash->mmap) {
+        mm_memmap_code_changed(flash->mmap_base + addr, end - addr);
+    }
 }
 
 static mm_u8 spiflash_read_byte(const struct mm_spiflash *flash, mm_u32 addr)
@@ -259,6 +263,47 @@ static mm_u8 spiflash_bus_xfer(void *opaque, mm_u8 out)
     return mm_spiflash_xfer(flash, out);
 }
 
+/* Copy the data phase of READ/FAST_READ straight out of the backing
+ * buffer; everything else still walks the byte state machine. */
+static void spiflash_bus_xfer_buf(void *opaque, const mm_u8 *out, mm_u8 fill,
+                                  mm_u8 *in, size_t len)
+{
+    struct mm_spiflash *flash = (struct mm_spiflash *)opaque;
+    size_t i = 0;
+    if (flash == 0) {
+        if (in != 0) memset(in, 0xFF, len);
+        return;
+    }
+    if (flash->cs_valid && spiflash_sample_cs(flash) != 0u) {
+        if (in != 0) memset(in, 0xFF, len);
+        return;
+    }
+    while (i < len) {
+        if (flash->state == SPIFLASH_READ && flash->dummy_left == 0 &&
+            (flash->cmd == 0x03 || flash->cmd == 0x0B) &&
+            flash->data != 0 && flash->size != 0u) {
+            mm_u32 off = flash->addr % flash->size;
+            size_t n = len - i;
+            if (n > (size_t)(flash->size - off)) {
+                n = (size_t)(flash->size - off);
+            }
+            if (in != 0) {
+                memcpy(in + i, flash->data + off, n);
+            }
+            flash->addr = off + (mm_u32)n;
+            i += n;
+            continue;
+        }
+        {
+            mm_u8 v = mm_spiflash_xfer(flash, (out != 0) ? out[i] : fill);
+            if (in != 0) {
+                in[i] = v;
+            }
+        }
+        i++;
+    }
+}
+
 static void spiflash_bus_end(void *opaque)
 {
     struct mm_spiflash *flash = (struct mm_spiflash *)opaque;
@@ -378,6 +423,9 @@ mm_u8 mm_spiflash_xfer(struct mm_spiflash *flash, mm_u8 out)
             if (next != cur) {
                 flash->data[idx] = next;
                 flash->dirty = MM_TRUE;
+                if (flash->mmap) {
+                    mm_memmap_code_changed(flash->mmap_base + idx, 1u);
+                }
             }
         }
         flash->addr++;
@@ -603,6 +651,7 @@ mm_bool mm_spiflash_register_cfg(const struct mm_spiflash_cfg *cfg)
     dev.xfer = spiflash_bus_xfer;
     dev.end = spiflash_bus_end;
     dev.cs_level = spiflash_cs_level;
+    dev.xfer_buf = spiflash_bus_xfer_buf;
     dev.opaque = flash;
     if (!mm_spi_bus_register_device(&dev)) {
         fprintf(stderr, "[SPI_FLASH] failed to register SPI%d device\n", flash->bus);
@@ -689,6 +738,21 @@ void mm_spiflash_register_mmap_regions(struct mmio_bus *bus)
     }
 }
 
+void mm_spiflash_register_xip_regions(struct mm_memmap *map)
+{
+    size_t i;
+    if (map == 0) return;
+    for (i = 0; i < g_spiflash_count; ++i) {
+        struct mm_spiflash *flash = &g_spiflash[i];
+        if (!flash->mmap || flash->data == 0) continue;
+        if (!mm_memmap_add_rom(map, flash->mmap_base, flash->size, flash->data, &flash->locked)) {
+            fprintf(stderr, "[SPI_FLASH] no XIP backing for SPI%d @0x%08lx, using MMIO\n",
+                    flash->bus,
+                    (unsigned long)flash->mmap_base);
+        }
+    }
+}
+
 void mm_spiflash_register_prot_regions(struct mm_prot_ctx *prot)
 {
     size_t i;
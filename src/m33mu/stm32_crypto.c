@@ -0,0 +1,1327 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/stm32_crypto.h"
+#include "m33mu/hostcrypto.h"
+#include "m33mu/bignum.h"
+
+#define HASH_SIZE 0x400u
+#define AES_SIZE 0x400u
+#define PKA_SIZE 0x2000u
+#define PKA_RAM_OFFSET 0x400u
+#define PKA_RAM_WORDS ((PKA_SIZE - PKA_RAM_OFFSET) / 4u)
+
+/* RCC AHB2ENR clock enable bits */
+#define CLK_AES 16u
+#define CLK_HASH 17u
+#define CLK_PKA 19u
+#define CLK_SAES 20u
+
+/* HASH registers */
+#define HASH_CR 0x00u
+#define HASH_DIN 0x04u
+#define HASH_STR 0x08u
+#define HASH_HRA0 0x0Cu
+#define HASH_IMR 0x20u
+#define HASH_SR 0x24u
+#define HASH_CSR0 0xF8u
+#define HASH_HR0 0x310u
+#define HASH_CR_INIT (1u << 2)
+#define HASH_CR_DMAE (1u << 3)
+#define HASH_CR_MODE (1u << 6)
+#define HASH_STR_DCAL (1u << 8)
+#define HASH_SR_DINIS (1u << 0)
+#define HASH_SR_DCIS (1u << 1)
+#define HASH_SR_DMAS (1u << 2)
+#define HASH_SR_BUSY (1u << 3)
+#define HASH_CSR_WORDS ((HASH_HR0 - HASH_CSR0) / 4u)
+
+/* AES/SAES registers */
+#define AES_CR 0x00u
+#define AES_SR 0x04u
+#define AES_DINR 0x08u
+#define AES_DOUTR 0x0Cu
+#define AES_KEYR0 0x10u
+#define AES_IVR0 0x20u
+#define AES_KEYR4 0x30u
+#define AES_SUSPR0 0x40u
+#define AES_IER 0x300u
+#define AES_ISR 0x304u
+#define AES_ICR 0x308u
+#define AES_CR_EN (1u << 0)
+#define AES_CR_KEYSIZE (1u << 18)
+#define AES_CR_IPRST (1u << 31)
+#define AES_ISR_CCF (1u << 0)
+#define AES_SR_BUSY (1u << 3)
+#define AES_SR_KEYVALID (1u << 7)
+
+#define AES_CHMOD_ECB 0u
+#define AES_CHMOD_CBC 1u
+#define AES_CHMOD_CTR 2u
+#define AES_CHMOD_GCM 3u
+
+/* PKA registers */
+#define PKA_CR 0x00u
+#define PKA_SR 0x04u
+#define PKA_CLRFR 0x08u
+#define PKA_CR_EN (1u << 0)
+#define PKA_CR_START (1u << 1)
+#define PKA_CR_PROCENDIE (1u << 17)
+#define PKA_SR_INITOK (1u << 0)
+#define PKA_SR_BUSY (1u << 16)
+#define PKA_SR_PROCENDF (1u << 17)
+#define PKA_SR_ADDRERRF (1u << 20)
+#define PKA_SR_OPERRF (1u << 21)
+#define PKA_SR_FLAGS (PKA_SR_PROCENDF | (1u << 19) | PKA_SR_ADDRERRF | PKA_SR_OPERRF)
+
+#define PKA_OK 0xD60Du
+#define PKA_FAIL 0xCBC9u
+#define PKA_REJECT 0xA3B7u
+
+struct hash_state {
+    mm_u32 cr;
+    mm_u32 str;
+    mm_u32 imr;
+    mm_u32 sr;
+    mm_u32 csr[HASH_CSR_WORDS];
+    mm_u32 hr[16];
+    enum mm_hash_algo algo;
+    struct mm_hash_ctx ctx;
+    struct mm_hash_ctx key_ctx;     /* HMAC key, when longer than a block */
+    mm_u8 key[MM_HASH_MAX_BLOCK];   /* K0 */
+    mm_u8 digest[MM_HASH_MAX_DIGEST];
+    mm_u32 phase;                   /* 0 hash; HMAC 1 key, 2 message, 3 outer key */
+    mm_u32 last;                    /* most recent DIN word, held until the next one */
+    mm_bool have_last;
+    mm_u32 words;                   /* words since the last block boundary */
+    mm_u64 blocks_seen;
+    mm_u64 busy;
+    mm_bool dinis_pending;
+    mm_bool dcis_pending;
+};
+
+struct aes_state {
+    mm_bool saes;
+    mm_u32 clk_bit;
+    int irq;
+    mm_u32 cr;
+    mm_u32 ier;
+    mm_u32 isr;
+    mm_u32 keyr[8];
+    mm_u32 ivr[4];
+    mm_u32 suspr[8];
+    mm_u32 key_written;
+    mm_bool key_dirty;
+    struct mm_aes_ctx ctx;
+    mm_u32 din[4];
+    mm_u32 din_count;
+    mm_u32 dout[4];
+    mm_u32 dout_count;
+    mm_u32 dout_idx;
+    mm_u8 gh_h[16];
+    mm_u8 gh_acc[16];
+    mm_u64 busy;
+    mm_bool ccf_pending;
+    mm_bool en_clear_pending;
+};
+
+struct pka_state {
+    mm_u32 cr;
+    mm_u32 sr;
+    mm_u32 ram[PKA_RAM_WORDS];
+    mm_u64 busy;
+    mm_bool end_pending;
+};
+
+static struct mm_stm32_crypto_cfg g_cfg;
+static mm_bool g_registered = MM_FALSE;
+static struct mm_nvic *g_nvic = 0;
+static struct mm_stm32_crypto_timing g_timing = { 66u, 14u, 100u };
+static struct hash_state g_hash;
+static struct aes_state g_aes;
+static struct aes_state g_saes;
+static struct pka_state g_pka;
+
+static mm_bool clk_on(mm_u32 bit)
+{
+    if (g_cfg.clk_reg == 0) {
+        return MM_TRUE;
+    }
+    return ((*g_cfg.clk_reg >> bit) & 1u) != 0u;
+}
+
+static void raise_irq(int irq)
+{
+    if (g_nvic != 0 && irq >= 0) {
+        mm_nvic_set_pending(g_nvic, (mm_u32)irq, MM_TRUE);
+    }
+}
+
+static mm_u32 rd_be32(const mm_u8 *p)
+{
+    return ((mm_u32)p[0] << 24) | ((mm_u32)p[1] << 16) | ((mm_u32)p[2] << 8) | (mm_u32)p[3];
+}
+
+static void wr_be32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v >> 24);
+    p[1] = (mm_u8)(v >> 16);
+    p[2] = (mm_u8)(v >> 8);
+    p[3] = (mm_u8)v;
+}
+
+/* DATATYPE: 0 none, 1 half-word, 2 byte, 3 bit swap. After the swap the
+ * word is taken big-endian, first message byte in bits 31:24. */
+static mm_u32 swap_data(mm_u32 v, mm_u32 datatype)
+{
+    mm_u32 r;
+    int i;
+    switch (datatype & 3u) {
+    case 1u:
+        return (v << 16) | (v >> 16);
+    case 2u:
+        return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+    case 3u:
+        r = 0;
+        for (i = 0; i < 32; ++i) {
+            r = (r << 1) | ((v >> i) & 1u);
+        }
+        return r;
+    default:
+        return v;
+    }
+}
+
+/* Sub-word accesses read the containing register. */
+static mm_u32 sub_read(mm_u32 value, mm_u32 offset, mm_u32 size_bytes)
+{
+    value >>= 8u * (offset & 3u);
+    if (size_bytes < 4u) {
+        value &= (1u << (8u * size_bytes)) - 1u;
+    }
+    return value;
+}
+
+/* ---- HASH ------------------------------------------------------------ */
+
+static mm_bool hash_algo(mm_u32 cr, enum mm_hash_algo *out)
+{
+    mm_u32 a;
+    if (g_cfg.variant == MM_STM32_CRYPTO_U5) {
+        static const enum mm_hash_algo u5[4] = { MM_HASH_SHA1, MM_HASH_MD5, MM_HASH_SHA224, MM_HASH_SHA256 };
+        a = (((cr >> 18) & 1u) << 1) | ((cr >> 7) & 1u);
+        *out = u5[a];
+        return MM_TRUE;
+    }
+    a = (cr >> 17) & 0xFu;
+    switch (a) {
+    case 0x0u: *out = MM_HASH_SHA1; return MM_TRUE;
+    case 0x2u: *out = MM_HASH_SHA224; return MM_TRUE;
+    case 0x3u: *out = MM_HASH_SHA256; return MM_TRUE;
+    case 0xCu: *out = MM_HASH_SHA384; return MM_TRUE;
+    case 0xDu: *out = MM_HASH_SHA512_224; return MM_TRUE;
+    case 0xEu: *out = MM_HASH_SHA512_256; return MM_TRUE;
+    case 0xFu: *out = MM_HASH_SHA512; return MM_TRUE;
+    default: return MM_FALSE;
+    }
+}
+
+static void hash_charge(struct hash_state *h)
+{
+    mm_u64 blocks = h->ctx.blocks + h->key_ctx.blocks;
+    if (blocks > h->blocks_seen) {
+        h->busy += (blocks - h->blocks_seen) * (mm_u64)g_timing.hash_block;
+        h->blocks_seen = blocks;
+    }
+}
+
+static void hash_settle(struct hash_state *h)
+{
+    if (h->busy != 0u) {
+        return;
+    }
+    if (h->dinis_pending) {
+        h->dinis_pending = MM_FALSE;
+        h->sr |= HASH_SR_DINIS;
+        if ((h->imr & 1u) != 0u) {
+            raise_irq(g_cfg.hash_irq);
+        }
+    }
+    if (h->dcis_pending) {
+        mm_u32 dlen = mm_hash_digest_size(h->algo);
+        mm_u32 i;
+        h->dcis_pending = MM_FALSE;
+        memset(h->hr, 0, sizeof(h->hr));
+        for (i = 0; i < dlen / 4u; ++i) {
+            h->hr[i] = rd_be32(h->digest + 4u * i);
+        }
+        h->sr |= HASH_SR_DCIS;
+        if ((h->imr & 2u) != 0u) {
+            raise_irq(g_cfg.hash_irq);
+        }
+    }
+}
+
+static void hash_feed(struct hash_state *h, const mm_u8 *p, mm_u32 len)
+{
+    mm_u32 bs = mm_hash_block_size(h->algo);
+    if (h->phase == 1u) {
+        if (h->key_ctx.total + len <= bs) {
+            memcpy(h->key + h->key_ctx.total, p, len);
+        }
+        mm_hash_update(&h->key_ctx, p, len);
+    } else if (h->phase != 3u) {
+        mm_hash_update(&h->ctx, p, len);
+    }
+}
+
+static void hash_init_op(struct hash_state *h)
+{
+    if (!hash_algo(h->cr, &h->algo)) {
+        h->algo = MM_HASH_SHA256;
+    }
+    mm_hash_init(&h->ctx, h->algo);
+    mm_hash_init(&h->key_ctx, h->algo);
+    memset(h->key, 0, sizeof(h->key));
+    memset(h->hr, 0, sizeof(h->hr));
+    h->phase = (h->cr & HASH_CR_MODE) ? 1u : 0u;
+    h->have_last = MM_FALSE;
+    h->words = 0;
+    h->blocks_seen = 0;
+    h->busy = 0;
+    h->dinis_pending = MM_FALSE;
+    h->dcis_pending = MM_FALSE;
+    h->str &= ~0x1Fu;
+    h->sr = HASH_SR_DINIS;
+}
+
+static void hash_din(struct hash_state *h, mm_u32 value)
+{
+    mm_u8 b[4];
+    if (h->have_last) {
+        wr_be32(b, h->last);
+        hash_feed(h, b, 4u);
+    }
+    h->last = swap_data(value, (h->cr >> 4) & 3u);
+    h->have_last = MM_TRUE;
+    h->sr &= ~HASH_SR_DINIS;
+    if (++h->words == mm_hash_block_size(h->algo) / 4u) {
+        h->words = 0;
+        h->dinis_pending = MM_TRUE;
+    }
+    hash_charge(h);
+    hash_settle(h);
+}
+
+static void hash_pad_key(struct hash_state *h, mm_u8 pad, mm_u8 *out)
+{
+    mm_u32 bs = mm_hash_block_size(h->algo);
+    mm_u32 i;
+    for (i = 0; i < bs; ++i) {
+        out[i] = (mm_u8)(h->key[i] ^ pad);
+    }
+}
+
+static void hash_dcal(struct hash_state *h)
+{
+    mm_u8 blk[MM_HASH_MAX_BLOCK];
+    mm_u8 inner[MM_HASH_MAX_DIGEST];
+    mm_u32 bs = mm_hash_block_size(h->algo);
+    mm_u32 dlen;
+
+    if (h->have_last) {
+        mm_u32 nblw = h->str & 0x1Fu;
+        mm_u8 b[4];
+        wr_be32(b, h->last);
+        hash_feed(h, b, (nblw == 0u) ? 4u : (nblw + 7u) / 8u);
+        h->have_last = MM_FALSE;
+    }
+    h->words = 0;
+    switch (h->phase) {
+    case 1u:
+        if (h->key_ctx.total > bs) {
+            memset(h->key, 0, sizeof(h->key));
+            mm_hash_final(&h->key_ctx, h->key);
+        }
+        hash_pad_key(h, 0x36u, blk);
+        mm_hash_update(&h->ctx, blk, bs);
+        h->phase = 2u;
+        h->dinis_pending = MM_TRUE;
+        break;
+    case 2u:
+        dlen = mm_hash_final(&h->ctx, inner);
+        hash_charge(h);
+        mm_hash_init(&h->ctx, h->algo);
+        h->blocks_seen = h->key_ctx.blocks;
+        hash_pad_key(h, 0x5cu, blk);
+        mm_hash_update(&h->ctx, blk, bs);
+        mm_hash_update(&h->ctx, inner, dlen);
+        h->phase = 3u;
+        h->dinis_pending = MM_TRUE;
+        break;
+    default:
+        mm_hash_final(&h->ctx, h->digest);
+        h->dcis_pending = MM_TRUE;
+        break;
+    }
+    hash_charge(h);
+    hash_settle(h);
+}
+
+static mm_bool hash_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct hash_state *h = (struct hash_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+    mm_u32 v = 0;
+
+    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > HASH_SIZE) return MM_FALSE;
+    if (!clk_on(CLK_HASH)) {
+        *value_out = 0;
+        return MM_TRUE;
+    }
+    if (reg == HASH_CR) {
+        v = h->cr | ((h->words & 0xFu) << 8) | (h->have_last ? (1u << 12) : 0u);
+    } else if (reg == HASH_STR) {
+        v = h->str & 0x1Fu;
+    } else if (reg >= HASH_HRA0 && reg < HASH_IMR) {
+        v = h->hr[(reg - HASH_HRA0) / 4u];
+    } else if (reg == HASH_IMR) {
+        v = h->imr;
+    } else if (reg == HASH_SR) {
+        v = h->sr;
+        if (h->busy != 0u) v |= HASH_SR_BUSY;
+        if ((h->cr & HASH_CR_DMAE) != 0u) v |= HASH_SR_DMAS;
+    } else if (reg >= HASH_CSR0 && reg < HASH_HR0) {
+        v = h->csr[(reg - HASH_CSR0) / 4u];
+    } else if (reg >= HASH_HR0 && reg < HASH_HR0 + 64u) {
+        v = h->hr[(reg - HASH_HR0) / 4u];
+    }
+    *value_out = sub_read(v, offset, size_bytes);
+    return MM_TRUE;
+}
+
+static mm_bool hash_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct hash_state *h = (struct hash_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+
+    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > HASH_SIZE) return MM_FALSE;
+    if (!clk_on(CLK_HASH)) {
+        return MM_TRUE;
+    }
+    if (reg == HASH_CR) {
+        h->cr = value & ~(HASH_CR_INIT | 0x1F00u);
+        if ((value & HASH_CR_INIT) != 0u) {
+            hash_init_op(h);
+        }
+    } else if (reg == HASH_DIN) {
+        hash_din(h, value);
+    } else if (reg == HASH_STR) {
+        h->str = value & 0x1Fu;
+        if ((value & HASH_STR_DCAL) != 0u) {
+            hash_dcal(h);
+        }
+    } else if (reg == HASH_IMR) {
+        h->imr = value & 3u;
+    } else if (reg == HASH_SR) {
+        h->sr &= (value & (HASH_SR_DINIS | HASH_SR_DCIS)) | ~(HASH_SR_DINIS | HASH_SR_DCIS);
+    } else if (reg >= HASH_CSR0 && reg < HASH_HR0) {
+        h->csr[(reg - HASH_CSR0) / 4u] = value;
+    }
+    return MM_TRUE;
+}
+
+/* ---- AES / SAES -------------------------------------------------------- */
+
+static mm_u32 aes_chmod(mm_u32 cr)
+{
+    return ((cr >> 5) & 3u) | (((cr >> 16) & 1u) << 2);
+}
+
+static mm_u32 aes_mode(mm_u32 cr)
+{
+    return (cr >> 3) & 3u;
+}
+
+static mm_u32 aes_gcmph(mm_u32 cr)
+{
+    return (cr >> 13) & 3u;
+}
+
+static mm_bool aes_key_valid(const struct aes_state *a)
+{
+    mm_u32 need = (a->cr & AES_CR_KEYSIZE) ? 0xFFu : 0x0Fu;
+    if (a->saes && ((a->cr >> 28) & 7u) != 0u) {
+        return MM_TRUE;
+    }
+    return ((a->key_written & need) == need) ? MM_TRUE : MM_FALSE;
+}
+
+static void aes_load_key(struct aes_state *a)
+{
+    mm_u8 key[32];
+    mm_u32 len = (a->cr & AES_CR_KEYSIZE) ? 32u : 16u;
+    mm_u32 i;
+
+    if (!a->key_dirty) {
+        return;
+    }
+    if (a->saes && ((a->cr >> 28) & 7u) != 0u) {
+        /* KEYSEL hardware keys (DHUK/BHK) are a fixed per-emulator value:
+         * consistent across runs, so wrapped keys round-trip. */
+        struct mm_hash_ctx hc;
+        mm_u8 dig[MM_HASH_MAX_DIGEST];
+        mm_hash_init(&hc, MM_HASH_SHA256);
+        mm_hash_update(&hc, (const mm_u8 *)"m33mu-saes-hwkey", 16u);
+        key[0] = (mm_u8)((a->cr >> 28) & 7u);
+        mm_hash_update(&hc, key, 1u);
+        mm_hash_final(&hc, dig);
+        memcpy(key, dig, 32u);
+    } else {
+        /* KEYR3 (KEYR7 for 256-bit keys) holds the first key bytes. */
+        for (i = 0; i < len / 4u; ++i) {
+            wr_be32(key + 4u * i, a->keyr[len / 4u - 1u - i]);
+        }
+    }
+    mm_aes_setkey(&a->ctx, key, len);
+    a->key_dirty = MM_FALSE;
+}
+
+static void aes_iv_bytes(const struct aes_state *a, mm_u8 *iv)
+{
+    mm_u32 i;
+    for (i = 0; i < 4u; ++i) {
+        wr_be32(iv + 4u * i, a->ivr[3u - i]);
+    }
+}
+
+static void aes_set_iv(struct aes_state *a, const mm_u8 *iv)
+{
+    mm_u32 i;
+    for (i = 0; i < 4u; ++i) {
+        a->ivr[3u - i] = rd_be32(iv + 4u * i);
+    }
+}
+
+/* GHASH: acc = (acc ^ x) * H in GF(2^128), bit-reflected convention. */
+static void ghash(struct aes_state *a, const mm_u8 *x)
+{
+    mm_u8 z[16];
+    mm_u8 v[16];
+    mm_u8 y[16];
+    int i;
+    int j;
+
+    for (i = 0; i < 16; ++i) {
+        y[i] = (mm_u8)(a->gh_acc[i] ^ x[i]);
+    }
+    memset(z, 0, sizeof(z));
+    memcpy(v, a->gh_h, sizeof(v));
+    for (i = 0; i < 128; ++i) {
+        mm_u8 lsb;
+        if ((y[i / 8] >> (7 - (i % 8))) & 1u) {
+            for (j = 0; j < 16; ++j) {
+                z[j] ^= v[j];
+            }
+        }
+        lsb = (mm_u8)(v[15] & 1u);
+        for (j = 15; j > 0; --j) {
+            v[j] = (mm_u8)((v[j] >> 1) | (v[j - 1] << 7));
+        }
+        v[0] >>= 1;
+        if (lsb) {
+            v[0] ^= 0xE1u;
+        }
+    }
+    memcpy(a->gh_acc, z, sizeof(z));
+}
+
+static void aes_charge(struct aes_state *a)
+{
+    mm_u32 cost = g_timing.aes_block;
+    if ((a->cr & AES_CR_KEYSIZE) != 0u) {
+        cost = (cost * 14u + 9u) / 10u;
+    }
+    a->busy += cost;
+    a->ccf_pending = MM_TRUE;
+}
+
+static void aes_settle(struct aes_state *a)
+{
+    if (a->busy != 0u || !a->ccf_pending) {
+        return;
+    }
+    a->ccf_pending = MM_FALSE;
+    if (a->en_clear_pending) {
+        a->en_clear_pending = MM_FALSE;
+        a->cr &= ~AES_CR_EN;
+    }
+    a->isr |= AES_ISR_CCF;
+    if ((a->ier & 1u) != 0u) {
+        raise_irq(a->irq);
+    }
+}
+
+static void aes_ctr_step(struct aes_state *a, mm_u8 *ks)
+{
+    mm_u8 iv[16];
+    aes_iv_bytes(a, iv);
+    mm_aes_encrypt(&a->ctx, iv, ks);
+    a->ivr[0]++;
+}
+
+static void aes_block(struct aes_state *a)
+{
+    mm_u8 in[16];
+    mm_u8 out[16];
+    mm_u8 iv[16];
+    mm_u8 ks[16];
+    mm_u32 chmod = aes_chmod(a->cr);
+    mm_bool decrypt = (aes_mode(a->cr) >= 2u) ? MM_TRUE : MM_FALSE;
+    mm_u32 datatype = (a->cr >> 1) & 3u;
+    mm_bool output = MM_TRUE;
+    mm_u32 i;
+
+    for (i = 0; i < 4u; ++i) {
+        wr_be32(in + 4u * i, a->din[i]);
+    }
+    a->din_count = 0;
+    aes_load_key(a);
+    switch (chmod) {
+    case AES_CHMOD_ECB:
+        if (decrypt) {
+            mm_aes_decrypt(&a->ctx, in, out);
+        } else {
+            mm_aes_encrypt(&a->ctx, in, out);
+        }
+        break;
+    case AES_CHMOD_CBC:
+        aes_iv_bytes(a, iv);
+        if (decrypt) {
+            mm_aes_decrypt(&a->ctx, in, out);
+            for (i = 0; i < 16u; ++i) {
+                out[i] ^= iv[i];
+            }
+            aes_set_iv(a, in);
+        } else {
+            for (i = 0; i < 16u; ++i) {
+                iv[i] ^= in[i];
+            }
+            mm_aes_encrypt(&a->ctx, iv, out);
+            aes_set_iv(a, out);
+        }
+        break;
+    case AES_CHMOD_CTR:
+        aes_ctr_step(a, ks);
+        for (i = 0; i < 16u; ++i) {
+            out[i] = (mm_u8)(in[i] ^ ks[i]);
+        }
+        break;
+    case AES_CHMOD_GCM:
+        switch (aes_gcmph(a->cr)) {
+        case 1u:    /* header */
+            ghash(a, in);
+            output = MM_FALSE;
+            break;
+        case 2u: {  /* payload */
+            mm_u32 valid = 16u - ((a->cr >> 20) & 0xFu);
+            mm_u8 ct[16];
+            aes_ctr_step(a, ks);
+            for (i = 0; i < 16u; ++i) {
+                out[i] = (mm_u8)(in[i] ^ ks[i]);
+            }
+            memcpy(ct, decrypt ? in : out, 16u);
+            for (i = valid; i < 16u; ++i) {
+                ct[i] = 0;
+                out[i] = 0;
+            }
+            ghash(a, ct);
+            break;
+        }
+        case 3u:    /* final: lengths block in, tag out */
+            ghash(a, in);
+            aes_iv_bytes(a, iv);
+            wr_be32(iv + 12u, 1u);
+            mm_aes_encrypt(&a->ctx, iv, ks);
+            for (i = 0; i < 16u; ++i) {
+                out[i] = (mm_u8)(a->gh_acc[i] ^ ks[i]);
+            }
+            break;
+        default:
+            output = MM_FALSE;
+            break;
+        }
+        break;
+    default:
+        /* CCM is not modelled; data passes through unchanged. */
+        memcpy(out, in, 16u);
+        break;
+    }
+    if (output) {
+        for (i = 0; i < 4u; ++i) {
+            a->dout[i] = swap_data(rd_be32(out + 4u * i), datatype);
+        }
+        a->dout_count = 4u;
+        a->dout_idx = 0;
+    }
+    aes_charge(a);
+    aes_settle(a);
+}
+
+static void aes_enable(struct aes_state *a)
+{
+    mm_u8 zero[16];
+    a->din_count = 0;
+    a->dout_count = 0;
+    a->dout_idx = 0;
+    if (aes_mode(a->cr) == 1u) {
+        /* Key derivation: the host schedule already has both directions. */
+        aes_load_key(a);
+        a->en_clear_pending = MM_TRUE;
+        aes_charge(a);
+        aes_settle(a);
+        return;
+    }
+    if (aes_chmod(a->cr) == AES_CHMOD_GCM && aes_gcmph(a->cr) == 0u) {
+        aes_load_key(a);
+        memset(zero, 0, sizeof(zero));
+        mm_aes_encrypt(&a->ctx, zero, a->gh_h);
+        memset(a->gh_acc, 0, sizeof(a->gh_acc));
+        a->en_clear_pending = MM_TRUE;
+        aes_charge(a);
+        aes_settle(a);
+    }
+}
+
+static void aes_reset_state(struct aes_state *a)
+{
+    mm_bool saes = a->saes;
+    mm_u32 clk_bit = a->clk_bit;
+    int irq = a->irq;
+    memset(a, 0, sizeof(*a));
+    a->saes = saes;
+    a->clk_bit = clk_bit;
+    a->irq = irq;
+    a->key_dirty = MM_TRUE;
+}
+
+static mm_bool aes_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct aes_state *a = (struct aes_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+    mm_u32 v = 0;
+
+    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > AES_SIZE) return MM_FALSE;
+    if (!clk_on(a->clk_bit)) {
+        *value_out = 0;
+        return MM_TRUE;
+    }
+    if (reg == AES_CR) {
+        v = a->cr;
+    } else if (reg == AES_SR) {
+        v = a->isr & AES_ISR_CCF;
+        if (a->busy != 0u) v |= AES_SR_BUSY;
+        if (aes_key_valid(a)) v |= AES_SR_KEYVALID;
+    } else if (reg == AES_DOUTR) {
+        if (a->busy == 0u && a->dout_idx < a->dout_count) {
+            v = a->dout[a->dout_idx++];
+        }
+    } else if (reg >= AES_KEYR0 && reg < AES_IVR0) {
+        v = 0;      /* key registers are write-only */
+    } else if (reg >= AES_IVR0 && reg < AES_KEYR4) {
+        v = a->ivr[(reg - AES_IVR0) / 4u];
+    } else if (reg >= AES_SUSPR0 && reg < AES_SUSPR0 + 32u) {
+        v = a->suspr[(reg - AES_SUSPR0) / 4u];
+    } else if (reg == AES_IER) {
+        v = a->ier;
+    } else if (reg == AES_ISR) {
+        v = a->isr;
+    }
+    *value_out = sub_read(v, offset, size_bytes);
+    return MM_TRUE;
+}
+
+static mm_bool aes_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct aes_state *a = (struct aes_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+
+    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > AES_SIZE) return MM_FALSE;
+    if (!clk_on(a->clk_bit)) {
+        return MM_TRUE;
+    }
+    if (reg == AES_CR) {
+        mm_u32 old = a->cr;
+        if ((value & AES_CR_IPRST) != 0u) {
+            aes_reset_state(a);
+            a->cr = value;
+            return MM_TRUE;
+        }
+        a->cr = value;
+        if (((old ^ value) & (AES_CR_KEYSIZE | (7u << 28))) != 0u) {
+            a->key_dirty = MM_TRUE;
+        }
+        if ((old & AES_CR_EN) == 0u && (value & AES_CR_EN) != 0u) {
+            aes_enable(a);
+        } else if ((value & AES_CR_EN) == 0u) {
+            a->din_count = 0;
+        }
+    } else if (reg == AES_DINR) {
+        if ((a->cr & AES_CR_EN) != 0u) {
+            a->din[a->din_count++] = swap_data(value, (a->cr >> 1) & 3u);
+            if (a->din_count == 4u) {
+                aes_block(a);
+            }
+        }
+    } else if (reg >= AES_KEYR0 && reg < AES_IVR0) {
+        a->keyr[(reg - AES_KEYR0) / 4u] = value;
+        a->key_written |= 1u << ((reg - AES_KEYR0) / 4u);
+        a->key_dirty = MM_TRUE;
+    } else if (reg >= AES_IVR0 && reg < AES_KEYR4) {
+        a->ivr[(reg - AES_IVR0) / 4u] = value;
+    } else if (reg >= AES_KEYR4 && reg < AES_SUSPR0) {
+        a->keyr[4u + (reg - AES_KEYR4) / 4u] = value;
+        a->key_written |= 1u << (4u + (reg - AES_KEYR4) / 4u);
+        a->key_dirty = MM_TRUE;
+    } else if (reg >= AES_SUSPR0 && reg < AES_SUSPR0 + 32u) {
+        a->suspr[(reg - AES_SUSPR0) / 4u] = value;
+    } else if (reg == AES_IER) {
+        a->ier = value & 7u;
+    } else if (reg == AES_ICR) {
+        a->isr &= ~(value & 7u);
+    }
+    return MM_TRUE;
+}
+
+/* ---- PKA --------------------------------------------------------------- */
+
+/* PKA RAM operand offsets (register space, RM layout for the H5/U5 PKA). */
+#define PKA_MONT_IN_MOD_NB_BITS 0x0408u
+#define PKA_MONT_IN_MODULUS 0x1088u
+#define PKA_MONT_OUT_PARAMETER 0x0620u
+
+#define PKA_MODEXP_IN_EXP_NB_BITS 0x0400u
+#define PKA_MODEXP_IN_OP_NB_BITS 0x0408u
+#define PKA_MODEXP_IN_BASE 0x0C68u
+#define PKA_MODEXP_IN_EXPONENT 0x0E78u
+#define PKA_MODEXP_IN_MODULUS 0x1088u
+#define PKA_MODEXP_OUT_RESULT 0x0838u
+#define PKA_MODEXP_OUT_ERROR 0x1298u
+#define PKA_MODEXP_PROT_IN_BASE 0x16C8u
+#define PKA_MODEXP_PROT_IN_EXPONENT 0x14B8u
+#define PKA_MODEXP_PROT_IN_MODULUS 0x0838u
+
+#define PKA_ECC_IN_EXP_NB_BITS 0x0400u
+#define PKA_ECC_IN_OP_NB_BITS 0x0408u
+#define PKA_ECC_IN_A_COEFF_SIGN 0x0410u
+#define PKA_ECC_IN_A_COEFF 0x0418u
+#define PKA_ECC_IN_B_COEFF 0x0520u
+#define PKA_ECC_IN_MOD_GF 0x0470u
+#define PKA_ECC_IN_K 0x12A0u
+#define PKA_ECC_IN_POINT_X 0x0578u
+#define PKA_ECC_IN_POINT_Y 0x05D0u
+#define PKA_ECC_IN_ORDER_N 0x0B88u
+#define PKA_ECC_OUT_ERROR 0x0680u
+
+#define PKA_SIGN_IN_HASH_E 0x0FE8u
+#define PKA_SIGN_IN_PRIVATE_D 0x0F28u
+#define PKA_SIGN_OUT_ERROR 0x0FE0u
+#define PKA_SIGN_OUT_R 0x0700u
+#define PKA_SIGN_OUT_S 0x0758u
+#define PKA_SIGN_OUT_X 0x1400u
+#define PKA_SIGN_OUT_Y 0x1458u
+
+#define PKA_VERIF_IN_ORDER_NB_BITS 0x0408u
+#define PKA_VERIF_IN_MOD_NB_BITS 0x04C8u
+#define PKA_VERIF_IN_A_COEFF_SIGN 0x0468u
+#define PKA_VERIF_IN_A_COEFF 0x0470u
+#define PKA_VERIF_IN_MOD_GF 0x04D0u
+#define PKA_VERIF_IN_POINT_X 0x0678u
+#define PKA_VERIF_IN_POINT_Y 0x06D0u
+#define PKA_VERIF_IN_PUBKEY_X 0x12F8u
+#define PKA_VERIF_IN_PUBKEY_Y 0x1350u
+#define PKA_VERIF_IN_R 0x10E0u
+#define PKA_VERIF_IN_S 0x0C68u
+#define PKA_VERIF_IN_HASH_E 0x13A8u
+#define PKA_VERIF_IN_ORDER_N 0x1088u
+#define PKA_VERIF_OUT_RESULT 0x05D0u
+
+#define PKA_MODE_MODEXP 0x00u
+#define PKA_MODE_MONT_PARAM 0x01u
+#define PKA_MODE_MODEXP_FAST 0x02u
+#define PKA_MODE_MODEXP_PROT 0x03u
+#define PKA_MODE_ECC_MUL 0x20u
+#define PKA_MODE_ECDSA_SIGN 0x24u
+#define PKA_MODE_ECDSA_VERIF 0x26u
+#define PKA_MODE_POINT_CHECK 0x28u
+
+static mm_bool pka_get(const struct pka_state *p, mm_u32 off, mm_u32 *dst, mm_u32 words)
+{
+    if (off < PKA_RAM_OFFSET || off + 4u * words > PKA_SIZE) {
+        return MM_FALSE;
+    }
+    memcpy(dst, &p->ram[(off - PKA_RAM_OFFSET) / 4u], 4u * words);
+    return MM_TRUE;
+}
+
+static mm_u32 pka_word(const struct pka_state *p, mm_u32 off)
+{
+    return p->ram[(off - PKA_RAM_OFFSET) / 4u];
+}
+
+/* Results are followed by a zero 64-bit word, as the engine writes them. */
+static mm_bool pka_put(struct pka_state *p, mm_u32 off, const mm_u32 *src, mm_u32 words)
+{
+    mm_u32 pad = (words & 1u) ? 3u : 2u;
+    if (off < PKA_RAM_OFFSET || off + 4u * (words + pad) > PKA_SIZE) {
+        return MM_FALSE;
+    }
+    memcpy(&p->ram[(off - PKA_RAM_OFFSET) / 4u], src, 4u * words);
+    memset(&p->ram[(off - PKA_RAM_OFFSET) / 4u + words], 0, 4u * pad);
+    return MM_TRUE;
+}
+
+static void pka_put_word(struct pka_state *p, mm_u32 off, mm_u32 v)
+{
+    p->ram[(off - PKA_RAM_OFFSET) / 4u] = v;
+    p->ram[(off - PKA_RAM_OFFSET) / 4u + 1u] = 0;
+}
+
+static mm_u32 bits_words(mm_u32 bits)
+{
+    return (bits + 31u) / 32u;
+}
+
+/* Rough engine cost of one modular multiplication at this size. */
+static mm_u64 pka_mul_cost(mm_u32 bits)
+{
+    mm_u64 w = (bits + 63u) / 64u;
+    return 20u + 3u * w * w;
+}
+
+static mm_bool pka_curve(struct pka_state *p, struct mm_ec_curve *c, mm_u32 bits,
+                         mm_u32 off_sign, mm_u32 off_a, mm_u32 off_b, mm_u32 off_p)
+{
+    mm_u32 w = bits_words(bits);
+    mm_u32 pm[MM_EC_MAX_WORDS], a[MM_EC_MAX_WORDS], b[MM_EC_MAX_WORDS];
+
+    if (w == 0u || w > MM_EC_MAX_WORDS) {
+        return MM_FALSE;
+    }
+    memset(b, 0, sizeof(b));
+    if (!pka_get(p, off_p, pm, w) || !pka_get(p, off_a, a, w) ||
+        (off_b != 0u && !pka_get(p, off_b, b, w))) {
+        return MM_FALSE;
+    }
+    if (pka_word(p, off_sign) != 0u) {
+        /* a = -|a| mod p */
+        mm_u32 i;
+        mm_u64 borrow = 0;
+        for (i = 0; i < w; ++i) {
+            mm_u64 d = (mm_u64)pm[i] - a[i] - borrow;
+            a[i] = (mm_u32)d;
+            borrow = (d >> 32) & 1u;
+        }
+    }
+    return mm_ec_curve_init(c, pm, a, b, w);
+}
+
+static mm_u64 pka_run(struct pka_state *p, mm_u32 mode)
+{
+    static struct mm_ec_curve curve;
+    static mm_u32 x[MM_BN_MAX_WORDS], y[MM_BN_MAX_WORDS], m[MM_BN_MAX_WORDS], e[MM_BN_MAX_WORDS];
+    static mm_u32 r[MM_BN_MAX_WORDS], s[MM_BN_MAX_WORDS], k[MM_BN_MAX_WORDS], q[MM_BN_MAX_WORDS];
+    static struct mm_mont mont;
+    mm_u32 bits;
+    mm_u32 ebits;
+    mm_u32 w;
+    mm_u32 nw;
+    mm_bool ok;
+
+    memset(x, 0, sizeof(x));
+    memset(y, 0, sizeof(y));
+    memset(m, 0, sizeof(m));
+    memset(e, 0, sizeof(e));
+    memset(k, 0, sizeof(k));
+    switch (mode) {
+    case PKA_MODE_MONT_PARAM:
+        bits = pka_word(p, PKA_MONT_IN_MOD_NB_BITS);
+        w = 2u * ((bits + 63u) / 64u);
+        if (w == 0u || w > MM_BN_MAX_WORDS || !pka_get(p, PKA_MONT_IN_MODULUS, m, bits_words(bits)) ||
+            !mm_mont_init(&mont, m, w)) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        pka_put(p, PKA_MONT_OUT_PARAMETER, mont.rr, w);
+        return (mm_u64)bits * 8u;
+    case PKA_MODE_MODEXP:
+    case PKA_MODE_MODEXP_FAST:
+    case PKA_MODE_MODEXP_PROT: {
+        mm_bool prot = (mode == PKA_MODE_MODEXP_PROT) ? MM_TRUE : MM_FALSE;
+        ebits = pka_word(p, PKA_MODEXP_IN_EXP_NB_BITS);
+        bits = pka_word(p, PKA_MODEXP_IN_OP_NB_BITS);
+        w = bits_words(bits);
+        if (w == 0u || w > MM_BN_MAX_WORDS || bits_words(ebits) > MM_BN_MAX_WORDS ||
+            !pka_get(p, prot ? PKA_MODEXP_PROT_IN_BASE : PKA_MODEXP_IN_BASE, x, w) ||
+            !pka_get(p, prot ? PKA_MODEXP_PROT_IN_EXPONENT : PKA_MODEXP_IN_EXPONENT, e, bits_words(ebits)) ||
+            !pka_get(p, prot ? PKA_MODEXP_PROT_IN_MODULUS : PKA_MODEXP_IN_MODULUS, m, w)) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        ok = mm_bn_modexp(y, x, e, ebits, m, w);
+        pka_put(p, PKA_MODEXP_OUT_RESULT, y, w);
+        pka_put_word(p, PKA_MODEXP_OUT_ERROR, ok ? PKA_OK : PKA_FAIL);
+        return (mm_u64)ebits * (prot ? 3u : 2u) * pka_mul_cost(bits);
+    }
+    case PKA_MODE_ECC_MUL:
+    case PKA_MODE_POINT_CHECK:
+        ebits = pka_word(p, PKA_ECC_IN_EXP_NB_BITS);
+        bits = pka_word(p, PKA_ECC_IN_OP_NB_BITS);
+        w = bits_words(bits);
+        if (!pka_curve(p, &curve, bits, PKA_ECC_IN_A_COEFF_SIGN, PKA_ECC_IN_A_COEFF,
+                       PKA_ECC_IN_B_COEFF, PKA_ECC_IN_MOD_GF) ||
+            !pka_get(p, PKA_ECC_IN_POINT_X, x, w) || !pka_get(p, PKA_ECC_IN_POINT_Y, y, w)) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        if (mode == PKA_MODE_POINT_CHECK) {
+            ok = mm_ec_on_curve(&curve, x, y);
+            pka_put_word(p, PKA_ECC_OUT_ERROR, ok ? PKA_OK : PKA_REJECT);
+            return 10u * pka_mul_cost(bits);
+        }
+        if (bits_words(ebits) > MM_EC_MAX_WORDS + 1u || !pka_get(p, PKA_ECC_IN_K, k, bits_words(ebits))) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        ok = mm_ec_on_curve(&curve, x, y) && mm_ec_mul(&curve, r, s, k, ebits, x, y);
+        if (!ok) {
+            memset(r, 0, sizeof(r));
+            memset(s, 0, sizeof(s));
+        }
+        pka_put(p, PKA_ECC_IN_POINT_X, r, w);
+        pka_put(p, PKA_ECC_IN_POINT_Y, s, w);
+        pka_put_word(p, PKA_ECC_OUT_ERROR, ok ? PKA_OK : PKA_FAIL);
+        return (mm_u64)ebits * 16u * pka_mul_cost(bits);
+    case PKA_MODE_ECDSA_SIGN:
+        ebits = pka_word(p, PKA_ECC_IN_EXP_NB_BITS);
+        bits = pka_word(p, PKA_ECC_IN_OP_NB_BITS);
+        w = bits_words(bits);
+        nw = bits_words(ebits);
+        if (nw == 0u || nw > MM_EC_MAX_WORDS + 1u ||
+            !pka_curve(p, &curve, bits, PKA_ECC_IN_A_COEFF_SIGN, PKA_ECC_IN_A_COEFF,
+                       PKA_ECC_IN_B_COEFF, PKA_ECC_IN_MOD_GF) ||
+            !pka_get(p, PKA_ECC_IN_POINT_X, x, w) || !pka_get(p, PKA_ECC_IN_POINT_Y, y, w) ||
+            !pka_get(p, PKA_ECC_IN_K, k, nw) || !pka_get(p, PKA_ECC_IN_ORDER_N, q, nw) ||
+            !pka_get(p, PKA_SIGN_IN_HASH_E, e, nw) || !pka_get(p, PKA_SIGN_IN_PRIVATE_D, m, nw)) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        memset(r, 0, sizeof(r));
+        memset(s, 0, sizeof(s));
+        ok = mm_ecdsa_sign(&curve, q, nw, x, y, m, k, e, r, s);
+        pka_put(p, PKA_SIGN_OUT_R, r, nw);
+        pka_put(p, PKA_SIGN_OUT_S, s, nw);
+        if (ok) {
+            mm_ec_mul(&curve, x, y, k, ebits, x, y);
+        }
+        pka_put(p, PKA_SIGN_OUT_X, x, w);
+        pka_put(p, PKA_SIGN_OUT_Y, y, w);
+        pka_put_word(p, PKA_SIGN_OUT_ERROR, ok ? PKA_OK : PKA_FAIL);
+        return (mm_u64)ebits * 18u * pka_mul_cost(bits);
+    case PKA_MODE_ECDSA_VERIF:
+        ebits = pka_word(p, PKA_VERIF_IN_ORDER_NB_BITS);
+        bits = pka_word(p, PKA_VERIF_IN_MOD_NB_BITS);
+        w = bits_words(bits);
+        nw = bits_words(ebits);
+        if (nw == 0u || nw > MM_EC_MAX_WORDS + 1u ||
+            !pka_curve(p, &curve, bits, PKA_VERIF_IN_A_COEFF_SIGN, PKA_VERIF_IN_A_COEFF, 0u,
+                       PKA_VERIF_IN_MOD_GF) ||
+            !pka_get(p, PKA_VERIF_IN_POINT_X, x, w) || !pka_get(p, PKA_VERIF_IN_POINT_Y, y, w) ||
+            !pka_get(p, PKA_VERIF_IN_PUBKEY_X, k, w) || !pka_get(p, PKA_VERIF_IN_PUBKEY_Y, m, w) ||
+            !pka_get(p, PKA_VERIF_IN_R, r, nw) || !pka_get(p, PKA_VERIF_IN_S, s, nw) ||
+            !pka_get(p, PKA_VERIF_IN_HASH_E, e, nw) || !pka_get(p, PKA_VERIF_IN_ORDER_N, q, nw)) {
+            p->sr |= PKA_SR_OPERRF;
+            return 0;
+        }
+        ok = mm_ecdsa_verify(&curve, q, nw, x, y, k, m, r, s, e);
+        pka_put_word(p, PKA_VERIF_OUT_RESULT, ok ? PKA_OK : PKA_REJECT);
+        return (mm_u64)ebits * 32u * pka_mul_cost(bits);
+    default:
+        p->sr |= PKA_SR_OPERRF;
+        return 0;
+    }
+}
+
+static void pka_settle(struct pka_state *p)
+{
+    if (p->busy != 0u || !p->end_pending) {
+        return;
+    }
+    p->end_pending = MM_FALSE;
+    p->sr |= PKA_SR_PROCENDF;
+    if ((p->cr & PKA_CR_PROCENDIE) != 0u) {
+        raise_irq(g_cfg.pka_irq);
+    }
+}
+
+static void pka_start(struct pka_state *p)
+{
+    mm_u64 cost;
+    if (p->busy != 0u || p->end_pending) {
+        return;
+    }
+    cost = pka_run(p, (p->cr >> 8) & 0x3Fu);
+    if ((p->sr & PKA_SR_OPERRF) != 0u) {
+        if ((p->cr & (1u << 21)) != 0u) {
+            raise_irq(g_cfg.pka_irq);
+        }
+        return;
+    }
+    p->busy = cost * g_timing.pka_pct / 100u;
+    p->end_pending = MM_TRUE;
+    pka_settle(p);
+}
+
+static mm_bool pka_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct pka_state *p = (struct pka_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+    mm_u32 v = 0;
+
+    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > PKA_SIZE) return MM_FALSE;
+    if (!clk_on(CLK_PKA)) {
+        *value_out = 0;
+        return MM_TRUE;
+    }
+    if (reg == PKA_CR) {
+        v = p->cr & ~PKA_CR_START;
+    } else if (reg == PKA_SR) {
+        v = p->sr;
+        if (p->busy != 0u) v |= PKA_SR_BUSY;
+    } else if (reg >= PKA_RAM_OFFSET) {
+        v = p->ram[(reg - PKA_RAM_OFFSET) / 4u];
+    }
+    *value_out = sub_read(v, offset, size_bytes);
+    return MM_TRUE;
+}
+
+static mm_bool pka_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct pka_state *p = (struct pka_state *)opaque;
+    mm_u32 reg = offset & ~3u;
+
+    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > PKA_SIZE) return MM_FALSE;
+    if (!clk_on(CLK_PKA)) {
+        return MM_TRUE;
+    }
+    if (reg == PKA_CR) {
+        p->cr = value & ~PKA_CR_START;
+        if ((value & PKA_CR_EN) == 0u) {
+            p->sr &= ~PKA_SR_INITOK;
+            return MM_TRUE;
+        }
+        p->sr |= PKA_SR_INITOK;
+        if ((value & PKA_CR_START) != 0u) {
+            pka_start(p);
+        }
+    } else if (reg == PKA_CLRFR) {
+        p->sr &= ~(value & PKA_SR_FLAGS);
+    } else if (reg >= PKA_RAM_OFFSET) {
+        if (p->busy != 0u) {
+            p->sr |= 1u << 19;  /* RAMERRF */
+            return MM_TRUE;
+        }
+        p->ram[(reg - PKA_RAM_OFFSET) / 4u] = value;
+    }
+    return MM_TRUE;
+}
+
+/* ---- glue ------------------------------------------------------------ */
+
+static mm_bool register_pair(struct mmio_bus *bus, mm_u32 base, mm_u32 size, void *opaque,
+                             mmio_read_fn rd, mmio_write_fn wr)
+{
+    struct mmio_region reg;
+    if (base == 0u) {
+        return MM_TRUE;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.base = base;
+    reg.size = size;
+    reg.opaque = opaque;
+    reg.read = rd;
+    reg.write = wr;
+    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    if (g_cfg.sec_offset != 0u) {
+        reg.base = base + g_cfg.sec_offset;
+        if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_stm32_crypto_reset(void)
+{
+    memset(&g_hash, 0, sizeof(g_hash));
+    mm_hash_init(&g_hash.ctx, MM_HASH_SHA1);
+    mm_hash_init(&g_hash.key_ctx, MM_HASH_SHA1);
+    g_aes.saes = MM_FALSE;
+    g_aes.clk_bit = CLK_AES;
+    g_aes.irq = g_cfg.aes_irq;
+    aes_reset_state(&g_aes);
+    g_saes.saes = MM_TRUE;
+    g_saes.clk_bit = CLK_SAES;
+    g_saes.irq = g_cfg.saes_irq;
+    aes_reset_state(&g_saes);
+    memset(&g_pka, 0, sizeof(g_pka));
+}
+
+mm_bool mm_stm32_crypto_register(struct mmio_bus *bus, const struct mm_stm32_crypto_cfg *cfg)
+{
+    if (bus == 0 || cfg == 0) {
+        return MM_FALSE;
+    }
+    g_cfg = *cfg;
+    g_registered = MM_TRUE;
+    mm_stm32_crypto_reset();
+    if (!register_pair(bus, cfg->hash_base, HASH_SIZE, &g_hash, hash_read, hash_write)) return MM_FALSE;
+    if (!register_pair(bus, cfg->aes_base, AES_SIZE, &g_aes, aes_read, aes_write)) return MM_FALSE;
+    if (!register_pair(bus, cfg->saes_base, AES_SIZE, &g_saes, aes_read, aes_write)) return MM_FALSE;
+    if (!register_pair(bus, cfg->pka_base, PKA_SIZE, &g_pka, pka_read, pka_write)) return MM_FALSE;
+    return MM_TRUE;
+}
+
+void mm_stm32_crypto_set_nvic(struct mm_nvic *nvic)
+{
+    g_nvic = nvic;
+}
+
+static void drain(mm_u64 *busy, mm_u64 cycles)
+{
+    *busy = (*busy > cycles) ? (*busy - cycles) : 0u;
+}
+
+void mm_stm32_crypto_tick(mm_u64 cycles)
+{
+    if (!g_registered) {
+        return;
+    }
+    if (g_hash.busy != 0u) {
+        drain(&g_hash.busy, cycles);
+        hash_settle(&g_hash);
+    }
+    if (g_aes.busy != 0u) {
+        drain(&g_aes.busy, cycles);
+        aes_settle(&g_aes);
+    }
+    if (g_saes.busy != 0u) {
+        drain(&g_saes.busy, cycles);
+        aes_settle(&g_saes);
+    }
+    if (g_pka.busy != 0u) {
+        drain(&g_pka.busy, cycles);
+        pka_settle(&g_pka);
+    }
+}
+
+static void busy_min(mm_u64 busy, mm_u64 *next)
+{
+    if (busy != 0u && busy < *next) {
+        *next = busy;
+    }
+}
+
+mm_u64 mm_stm32_crypto_next_event(void)
+{
+    mm_u64 next = (mm_u64)-1;
+    if (!g_registered) {
+        return next;
+    }
+    busy_min(g_hash.busy, &next);
+    busy_min(g_aes.busy, &next);
+    busy_min(g_saes.busy, &next);
+    busy_min(g_pka.busy, &next);
+    return next;
+}
+
+mm_bool mm_stm32_crypto_parse_timing(const char *spec, struct mm_stm32_crypto_timing *out)
+{
+    const char *p = spec;
+    struct mm_stm32_crypto_timing t;
+
+    if (spec == 0 || out == 0) {
+        return MM_FALSE;
+    }
+    t = *out;
+    while (*p != '\0') {
+        mm_u32 *field;
+        char *end;
+        unsigned long v;
+        if (strncmp(p, "hash:", 5) == 0) {
+            field = &t.hash_block;
+            p += 5;
+        } else if (strncmp(p, "aes:", 4) == 0) {
+            field = &t.aes_block;
+            p += 4;
+        } else if (strncmp(p, "pka:", 4) == 0) {
+            field = &t.pka_pct;
+            p += 4;
+        } else {
+            return MM_FALSE;
+        }
+        v = strtoul(p, &end, 0);
+        if (end == p || v > 0xFFFFFFFFul) {
+            return MM_FALSE;
+        }
+        *field = (mm_u32)v;
+        p = end;
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0') {
+            return MM_FALSE;
+        }
+    }
+    *out = t;
+    return MM_TRUE;
+}
+
+void mm_stm32_crypto_set_timing(const struct mm_stm32_crypto_timing *t)
+{
+    if (t != 0) {
+        g_timing = *t;
+    }
+}
+
+void mm_stm32_crypto_get_timing(struct mm_stm32_crypto_timing *out)
+{
+    if (out != 0) {
+        *out = g_timing;
+    }
+}
@@ -0,0 +1,327 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <string.h>
+#include "m33mu/stm32_dma.h"
+#include "m33mu/memmap.h"
+
+#define DMA_REGION_SIZE 0x1000u
+#define DMA_BLOCK 0x400u
+#define DMAMUX_OFFSET 0x800u
+#define CLK_DMAMUX 2u
+
+#define DMA_ISR 0x00u
+#define DMA_IFCR 0x04u
+#define DMA_CH_BASE 0x08u
+#define DMA_CH_STRIDE 0x14u
+#define DMA_CCR 0x00u
+#define DMA_CNDTR 0x04u
+#define DMA_CPAR 0x08u
+#define DMA_CM0AR 0x0Cu
+#define DMA_CM1AR 0x10u
+
+#define CCR_EN (1u << 0)
+#define CCR_DIR (1u << 4)
+#define CCR_CIRC (1u << 5)
+#define CCR_PINC (1u << 6)
+#define CCR_MINC (1u << 7)
+#define CCR_MEM2MEM (1u << 14)
+
+/* ISR nibble per channel; TC/HT/TE sit at the same bit as their CCR
+ * interrupt enables. */
+#define ISR_GIF 1u
+#define ISR_TCIF 2u
+#define ISR_HTIF 4u
+#define ISR_TEIF 8u
+
+#define SERVICE_ROUNDS 4096u
+
+static mm_bool clock_on(const struct mm_stm32_dma *dma, mm_u32 bit)
+{
+    if (dma->cfg.clk_reg == 0) return MM_TRUE;
+    return ((*dma->cfg.clk_reg >> bit) & 1u) != 0u;
+}
+
+static void raise_flags(struct mm_stm32_dma *dma, mm_u32 g, mm_u32 flags)
+{
+    mm_u32 shift = 4u * (g & 7u);
+    int irq;
+    dma->isr[g >> 3] |= (flags | ISR_GIF) << shift;
+    if ((dma->ch[g].ccr & flags) == 0u) return;
+    if (dma->nvic == 0 || dma->cfg.irqs == 0) return;
+    irq = dma->cfg.irqs[g];
+    if (irq >= 0) {
+        mm_nvic_set_pending(dma->nvic, (mm_u32)irq, MM_TRUE);
+    }
+}
+
+static mm_u32 psize(const struct mm_stm32_dma_channel *ch)
+{
+    return 1u << ((ch->ccr >> 8) & 3u);
+}
+
+static mm_u32 msize(const struct mm_stm32_dma_channel *ch)
+{
+    return 1u << ((ch->ccr >> 10) & 3u);
+}
+
+/* Move n items; narrower sources are zero-extended and wider ones keep
+ * their low bytes, as on the real controller. */
+static mm_bool move_items(struct mm_stm32_dma *dma, struct mm_stm32_dma_channel *ch, mm_u32 n)
+{
+    mm_bool to_periph = (ch->ccr & CCR_DIR) != 0u;
+    mm_u32 *src = to_periph ? &ch->cur_mar : &ch->cur_par;
+    mm_u32 *dst = to_periph ? &ch->cur_par : &ch->cur_mar;
+    mm_u32 sw = to_periph ? msize(ch) : psize(ch);
+    mm_u32 dw = to_periph ? psize(ch) : msize(ch);
+    mm_bool sinc = (ch->ccr & (to_periph ? CCR_MINC : CCR_PINC)) != 0u;
+    mm_bool dinc = (ch->ccr & (to_periph ? CCR_PINC : CCR_MINC)) != 0u;
+    mm_u8 beat[4];
+
+    if (sw == dw && sinc && dinc) {
+        if (!mm_dma_copy(dma->cfg.bus, *dst, *src, (size_t)n * sw)) {
+            return MM_FALSE;
+        }
+        *src += n * sw;
+        *dst += n * dw;
+        return MM_TRUE;
+    }
+    while (n-- > 0u) {
+        memset(beat, 0, sizeof(beat));
+        if (!mm_dma_transfer(dma->cfg.bus, *src, beat, sw, MM_FALSE)) return MM_FALSE;
+        if (!mm_dma_transfer(dma->cfg.bus, *dst, beat, dw, MM_TRUE)) return MM_FALSE;
+        if (sinc) *src += sw;
+        if (dinc) *dst += dw;
+    }
+    return MM_TRUE;
+}
+
+static mm_bool channel_step(struct mm_stm32_dma *dma, mm_u32 g)
+{
+    struct mm_stm32_dma_channel *ch = &dma->ch[g];
+    mm_u32 before = ch->cndtr;
+    mm_u32 n;
+
+    if ((ch->ccr & CCR_EN) == 0u || ch->cndtr == 0u) return MM_FALSE;
+    if ((ch->ccr & CCR_MEM2MEM) != 0u) {
+        n = ch->cndtr;
+    } else {
+        mm_u32 reqid = dma->mux[g] & 0x7Fu;
+        if (reqid == 0u || dma->cfg.dreq == 0 || !dma->cfg.dreq(dma->cfg.dreq_opaque, reqid)) {
+            return MM_FALSE;
+        }
+        n = 1u;
+    }
+    if (!move_items(dma, ch, n)) {
+        ch->ccr &= ~CCR_EN;
+        dma->active &= ~(1u << g);
+        raise_flags(dma, g, ISR_TEIF);
+        return MM_FALSE;
+    }
+    ch->cndtr -= n;
+    if (before > ch->ndt / 2u && ch->cndtr <= ch->ndt / 2u) {
+        raise_flags(dma, g, ISR_HTIF);
+    }
+    if (ch->cndtr == 0u) {
+        if ((ch->ccr & CCR_CIRC) != 0u && (ch->ccr & CCR_MEM2MEM) == 0u) {
+            ch->cndtr = ch->ndt;
+            ch->cur_par = ch->cpar;
+            ch->cur_mar = ch->cm0ar;
+        } else {
+            dma->active &= ~(1u << g);
+        }
+        raise_flags(dma, g, ISR_TCIF);
+    }
+    return MM_TRUE;
+}
+
+static mm_u32 read_word(struct mm_stm32_dma *dma, mm_u32 offset)
+{
+    mm_u32 ctrl = offset / DMA_BLOCK;
+    mm_u32 rel = offset % DMA_BLOCK;
+    const struct mm_stm32_dma_channel *ch;
+    mm_u32 x;
+    if (offset >= DMAMUX_OFFSET) {
+        if (!clock_on(dma, CLK_DMAMUX)) return 0;
+        return dma->mux[(offset - DMAMUX_OFFSET) / 4u];
+    }
+    if (ctrl > 1u || !clock_on(dma, ctrl)) return 0;
+    if (rel == DMA_ISR) return dma->isr[ctrl];
+    if (rel < DMA_CH_BASE) return 0;
+    x = (rel - DMA_CH_BASE) / DMA_CH_STRIDE;
+    if (x >= 8u) return 0;
+    ch = &dma->ch[ctrl * 8u + x];
+    switch ((rel - DMA_CH_BASE) % DMA_CH_STRIDE) {
+    case DMA_CCR: return ch->ccr;
+    case DMA_CNDTR: return ch->cndtr;
+    case DMA_CPAR: return ch->cpar;
+    case DMA_CM0AR: return ch->cm0ar;
+    case DMA_CM1AR: return ch->cm1ar;
+    default: return 0;
+    }
+}
+
+static void write_ccr(struct mm_stm32_dma *dma, mm_u32 g, mm_u32 value)
+{
+    struct mm_stm32_dma_channel *ch = &dma->ch[g];
+    mm_u32 old = ch->ccr;
+    mm_u32 rounds;
+    ch->ccr = value & 0x001FFFFFu;
+    if ((old & CCR_EN) != 0u && (value & CCR_EN) == 0u) {
+        dma->active &= ~(1u << g);
+        return;
+    }
+    if ((old & CCR_EN) != 0u || (value & CCR_EN) == 0u) return;
+    ch->ndt = ch->cndtr;
+    ch->cur_par = ch->cpar;
+    ch->cur_mar = ch->cm0ar;
+    if (ch->cndtr == 0u) return;
+    dma->active |= 1u << g;
+    if ((value & CCR_MEM2MEM) != 0u) {
+        for (rounds = 0; rounds < SERVICE_ROUNDS; ++rounds) {
+            if (!channel_step(dma, g)) break;
+        }
+    }
+}
+
+static void write_word(struct mm_stm32_dma *dma, mm_u32 offset, mm_u32 value)
+{
+    mm_u32 ctrl = offset / DMA_BLOCK;
+    mm_u32 rel = offset % DMA_BLOCK;
+    struct mm_stm32_dma_channel *ch;
+    mm_u32 x;
+    mm_u32 reg;
+    if (offset >= DMAMUX_OFFSET) {
+        if (clock_on(dma, CLK_DMAMUX)) {
+            dma->mux[(offset - DMAMUX_OFFSET) / 4u] = value;
+        }
+        return;
+    }
+    if (ctrl > 1u || !clock_on(dma, ctrl)) return;
+    if (rel == DMA_IFCR) {
+        for (x = 0; x < 8u; ++x) {
+            mm_u32 nib = (value >> (4u * x)) & 0xFu;
+            if ((nib & ISR_GIF) != 0u) nib = 0xFu;
+            dma->isr[ctrl] &= ~(nib << (4u * x));
+        }
+        return;
+    }
+    if (rel < DMA_CH_BASE) return;
+    x = (rel - DMA_CH_BASE) / DMA_CH_STRIDE;
+    if (x >= 8u) return;
+    ch = &dma->ch[ctrl * 8u + x];
+    reg = (rel - DMA_CH_BASE) % DMA_CH_STRIDE;
+    if (reg == DMA_CCR) {
+        write_ccr(dma, ctrl * 8u + x, value);
+        return;
+    }
+    /* Address and count registers are locked while the channel runs. */
+    if ((ch->ccr & CCR_EN) != 0u) return;
+    switch (reg) {
+    case DMA_CNDTR: ch->cndtr = value & 0xFFFFu; break;
+    case DMA_CPAR: ch->cpar = value; break;
+    case DMA_CM0AR: ch->cm0ar = value; break;
+    case DMA_CM1AR: ch->cm1ar = value; break;
+    default: break;
+    }
+}
+
+static mm_bool dma_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct mm_stm32_dma *dma = (struct mm_stm32_dma *)opaque;
+    mm_u32 word;
+    if (value_out == 0 || size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > DMA_REGION_SIZE) return MM_FALSE;
+    word = read_word(dma, offset & ~3u) >> (8u * (offset & 3u));
+    *value_out = (size_bytes == 4u) ? word : (word & ((1u << (8u * size_bytes)) - 1u));
+    return MM_TRUE;
+}
+
+static mm_bool dma_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct mm_stm32_dma *dma = (struct mm_stm32_dma *)opaque;
+    if (size_bytes == 0 || size_bytes > 4) return MM_FALSE;
+    if ((offset + size_bytes) > DMA_REGION_SIZE) return MM_FALSE;
+    if (size_bytes < 4u) {
+        mm_u32 shift = 8u * (offset & 3u);
+        mm_u32 mask = ((1u << (8u * size_bytes)) - 1u) << shift;
+        mm_u32 word;
+        offset &= ~3u;
+        word = (offset % DMA_BLOCK == DMA_IFCR && offset < DMAMUX_OFFSET) ? 0u : read_word(dma, offset);
+        value = (word & ~mask) | ((value << shift) & mask);
+    }
+    write_word(dma, offset, value);
+    return MM_TRUE;
+}
+
+void mm_stm32_dma_reset(struct mm_stm32_dma *dma)
+{
+    dma->isr[0] = 0;
+    dma->isr[1] = 0;
+    dma->active = 0;
+    memset(dma->ch, 0, sizeof(dma->ch));
+    memset(dma->mux, 0, sizeof(dma->mux));
+}
+
+mm_bool mm_stm32_dma_register(struct mmio_bus *bus, struct mm_stm32_dma *dma, const struct mm_stm32_dma_cfg *cfg)
+{
+    struct mmio_region reg;
+    dma->cfg = *cfg;
+    if (dma->cfg.bus == 0) {
+        mm_memmap_dma_master_init(0, &dma->own_bus);
+        dma->cfg.bus = &dma->own_bus;
+    }
+    mm_stm32_dma_reset(dma);
+    memset(&reg, 0, sizeof(reg));
+    reg.base = cfg->base;
+    reg.size = DMA_REGION_SIZE;
+    reg.opaque = dma;
+    reg.read = dma_read;
+    reg.write = dma_write;
+    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    if (cfg->sec_offset != 0u) {
+        reg.base = cfg->base + cfg->sec_offset;
+        if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_stm32_dma_set_nvic(struct mm_stm32_dma *dma, struct mm_nvic *nvic)
+{
+    dma->nvic = nvic;
+}
+
+void mm_stm32_dma_service(struct mm_stm32_dma *dma)
+{
+    mm_u32 round;
+    mm_u32 g;
+    mm_bool progress = MM_TRUE;
+    if (dma->active == 0u) return;
+    for (round = 0; round < SERVICE_ROUNDS && progress; ++round) {
+        progress = MM_FALSE;
+        for (g = 0; g < MM_STM32_DMA_CHANNELS; ++g) {
+            if ((dma->active & (1u << g)) == 0u) continue;
+            if (!clock_on(dma, g >> 3)) continue;
+            if (channel_step(dma, g)) progress = MM_TRUE;
+        }
+    }
+}
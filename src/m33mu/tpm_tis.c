@@ -547,18 +547,8 @@ static void tpm_write_reg(struct mm_tpm_tis *tpm, mm_u16 addr, mm_u8 value)
     }
 }
 
-static mm_u8 tpm_spi_xfer(void *opaque, mm_u8 out)
+static mm_u8 tpm_spi_byte(struct mm_tpm_tis *tpm, mm_u8 out)
 {
-    struct mm_tpm_tis *tpm = (struct mm_tpm_tis *)opaque;
-    mm_u8 cs_level;
-    if (tpm == 0) {
-        return 0xFFu;
-    }
-    cs_level = tpm_sample_cs(tpm);
-    if (tpm->cs_valid && cs_level != 0u) {
-        return 0xFFu;
-    }
-
     if (tpm->hdr_have < 4u) {
         tpm->header[tpm->hdr_have++] = out;
         if (tpm->hdr_have == 4u) {
@@ -611,6 +601,62 @@ static mm_u8 tpm_spi_xfer(void *opaque, mm_u8 out)
     return 0xFFu;
 }
 
+static mm_u8 tpm_spi_xfer(void *opaque, mm_u8 out)
+{
+    struct mm_tpm_tis *tpm = (struct mm_tpm_tis *)opaque;
+    mm_u8 cs_level;
+    if (tpm == 0) {
+        return 0xFFu;
+    }
+    cs_level = tpm_sample_cs(tpm);
+    if (tpm->cs_valid && cs_level != 0u) {
+        return 0xFFu;
+    }
+    return tpm_spi_byte(tpm, out);
+}
+
+/* Burst path: CS is sampled once per burst and response reads from the
+ * data FIFO are copied out of rsp_buf in one go. */
+static void tpm_spi_xfer_buf(void *opaque, const mm_u8 *out, mm_u8 fill,
+                             mm_u8 *in, size_t len)
+{
+    struct mm_tpm_tis *tpm = (struct mm_tpm_tis *)opaque;
+    size_t i = 0;
+    if (tpm == 0 || (tpm->cs_valid && tpm_sample_cs(tpm) != 0u)) {
+        if (in != 0) memset(in, 0xFF, len);
+        return;
+    }
+    while (i < len) {
+        if (tpm->hdr_have == 4u && !tpm->wait_phase && tpm->is_read &&
+            tpm->addr >= TPM_DATA_FIFO && tpm->addr < (TPM_DATA_FIFO + 4u) &&
+            tpm->rsp_read < tpm->rsp_len && tpm->len > 1u) {
+            size_t n = len - i;
+            if (n > (size_t)(tpm->len - 1u)) {
+                n = (size_t)(tpm->len - 1u);
+            }
+            if (n > (size_t)(tpm->rsp_len - tpm->rsp_read - 1u)) {
+                n = (size_t)(tpm->rsp_len - tpm->rsp_read - 1u);
+            }
+            if (n > 0u) {
+                if (in != 0) {
+                    memcpy(in + i, tpm->rsp_buf + tpm->rsp_read, n);
+                }
+                tpm->rsp_read += (mm_u32)n;
+                tpm->len = (mm_u8)(tpm->len - n);
+                i += n;
+                continue;
+            }
+        }
+        {
+            mm_u8 v = tpm_spi_byte(tpm, (out != 0) ? out[i] : fill);
+            if (in != 0) {
+                in[i] = v;
+            }
+        }
+        i++;
+    }
+}
+
 static void tpm_spi_end(void *opaque)
 {
     struct mm_tpm_tis *tpm = (struct mm_tpm_tis *)opaque;
@@ -755,6 +801,7 @@ mm_bool mm_tpm_tis_register_cfg(const struct mm_tpm_tis_cfg *cfg)
     dev.xfer = tpm_spi_xfer;
     dev.end = tpm_spi_end;
     dev.cs_level = tpm_cs_level;
+    dev.xfer_buf = tpm_spi_xfer_buf;
     dev.opaque = tpm;
     if (!mm_spi_bus_register_device(&dev)) {
         fprintf(stderr, "[TPM] failed to register SPI%d device\n", tpm->bus);
@@ -32,6 +32,7 @@ static void tz_sync_r13_from_active_sp(struct mm_cpu *cpu)
     if (cpu == 0) {
         return;
     }
+    mm_cpu_sp_rebank(cpu);
     sp = mm_cpu_get_active_sp(cpu);
     mm_cpu_set_active_sp(cpu, sp);
 }
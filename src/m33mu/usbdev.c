@@ -13,6 +13,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include "m33mu/usbdev.h"
+#include "m33mu/reactor.h"
+#include "m33mu/replay.h"
 
 #define USBIP_VERSION 0x0111u
 
@@ -53,7 +55,8 @@ struct usbip_pending {
 
 struct usbip_server {
     int listen_fd;
-    int client_fd;
+    struct mm_chan *chan; /* owns listen_fd and the client socket */
+    mm_bool connected;
     int port;
     mm_bool running;
     mm_bool imported;
@@ -129,32 +132,16 @@ static mm_bool usbip_tx_queue(const void *data, size_t len)
 
 static void usbip_tx_flush(void)
 {
-    if (g_usbip.client_fd < 0 || g_usbip.tx_off >= g_usbip.tx_len) {
+    /* Replayed replies go nowhere; the recorded client took them all. */
+    if (!g_usbip.connected || g_usbip.tx_off >= g_usbip.tx_len || mm_replay_playing()) {
         g_usbip.tx_len = 0;
         g_usbip.tx_off = 0;
         return;
     }
-    while (g_usbip.tx_off < g_usbip.tx_len) {
-        ssize_t n = send(g_usbip.client_fd,
-                         g_usbip.tx_buf + g_usbip.tx_off,
-                         g_usbip.tx_len - g_usbip.tx_off,
-                         MSG_DONTWAIT);
-        if (n > 0) {
-            g_usbip.tx_off += (size_t)n;
-        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            break;
-        } else {
-            usb_trace("tx flush: send failed, closing client");
-            close(g_usbip.client_fd);
-            g_usbip.client_fd = -1;
-            g_usbip.imported = MM_FALSE;
-            g_usbip.tx_len = 0;
-            g_usbip.tx_off = 0;
-            g_usbip.rx_len = 0;
-            memset(g_usbip.pending, 0, sizeof(g_usbip.pending));
-            break;
-        }
-    }
+    /* Send errors surface as a DOWN channel in mm_usbdev_poll(). */
+    g_usbip.tx_off += mm_chan_write(g_usbip.chan,
+                                    g_usbip.tx_buf + g_usbip.tx_off,
+                                    (mm_u32)(g_usbip.tx_len - g_usbip.tx_off));
     if (g_usbip.tx_off >= g_usbip.tx_len) {
         g_usbip.tx_len = 0;
         g_usbip.tx_off = 0;
@@ -237,15 +224,15 @@ static mm_bool usbip_send_device_desc(mm_u32 busnum, mm_u32 devnum, mm_u32 speed
 
 static void usbip_reset_client(const char *reason)
 {
-    if (g_usbip.client_fd >= 0) {
+    if (g_usbip.connected) {
         usb_trace("reset client: %s", reason ? reason : "unknown");
         if (usb_trace_enabled()) {
             usbip_dump_packet("reset rx_buf", g_usbip.rx_buf, g_usbip.rx_len);
             usbip_dump_packet("reset tx_buf", g_usbip.tx_buf, g_usbip.tx_len);
         }
-        close(g_usbip.client_fd);
+        mm_chan_drop(g_usbip.chan);
     }
-    g_usbip.client_fd = -1;
+    g_usbip.connected = MM_FALSE;
     g_usbip.rx_len = 0;
     g_usbip.tx_len = 0;
     g_usbip.tx_off = 0;
@@ -791,13 +778,17 @@ mm_bool mm_usbdev_start(int port)
     usb_trace("usbdev start port=%d", port);
     memset(&g_usbip, 0, sizeof(g_usbip));
     g_usbip.listen_fd = -1;
-    g_usbip.client_fd = -1;
     g_usbip.port = port;
     g_usbip.busnum = 1u;
     g_usbip.devnum = 2u;
     g_usbip.devid = (g_usbip.busnum << 16) | g_usbip.devnum;
     snprintf(g_usbip.busid, sizeof(g_usbip.busid), "1-1");
 
+    if (mm_replay_playing()) {
+        g_usbip.running = MM_TRUE;
+        printf("[USB] USB/IP client traffic replayed from log\n");
+        return MM_TRUE;
+    }
     fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) {
         perror("usbip socket");
@@ -824,6 +815,12 @@ mm_bool mm_usbdev_start(int port)
         return MM_FALSE;
     }
     (void)set_nonblock(fd);
+    g_usbip.chan = mm_reactor_open_listen(fd, USBIP_RX_BUF, USBIP_TX_BUF);
+    if (g_usbip.chan == 0) {
+        fprintf(stderr, "usbip: failed to start I/O reactor\n");
+        close(fd);
+        return MM_FALSE;
+    }
     g_usbip.listen_fd = fd;
     g_usbip.running = MM_TRUE;
     printf("[USB] USB/IP server listening on 127.0.0.1:%d\n", port);
@@ -854,16 +851,54 @@ static void usbip_try_status_out(void)
     }
 }
 
+/* Client connects and disconnects as the guest saw them. Other state
+ * changes never reach the device and are not recorded. */
+static enum mm_chan_state usbip_chan_state(void)
+{
+    enum mm_chan_state state;
+    if (mm_replay_playing()) {
+        mm_u8 s = 0;
+        if (mm_replay_take(MM_REPLAY_USB_STATE, 0, &s, 1u, 0)) {
+            return (enum mm_chan_state)s;
+        }
+        return g_usbip.connected ? MM_CHAN_UP : MM_CHAN_LISTENING;
+    }
+    state = mm_chan_state(g_usbip.chan);
+    if ((state == MM_CHAN_DOWN && g_usbip.connected) ||
+        (state == MM_CHAN_UP && !g_usbip.connected)) {
+        mm_u8 s = (mm_u8)state;
+        mm_replay_put(MM_REPLAY_USB_STATE, 0, &s, 1u);
+    }
+    return state;
+}
+
+static mm_u32 usbip_chan_read(mm_u8 *buf, mm_u32 len)
+{
+    mm_u32 n = 0;
+    if (mm_replay_playing()) {
+        (void)mm_replay_take(MM_REPLAY_USB_RX, 0, buf, len, &n);
+        return n;
+    }
+    n = mm_chan_read(g_usbip.chan, buf, len);
+    if (n > 0u) mm_replay_put(MM_REPLAY_USB_RX, 0, buf, n);
+    return n;
+}
+
 void mm_usbdev_poll(void)
 {
+    enum mm_chan_state state;
     if (!g_usbip.running) return;
-    if (g_usbip.client_fd < 0) {
-        struct sockaddr_in addr;
-        socklen_t len = sizeof(addr);
-        int cfd = accept(g_usbip.listen_fd, (struct sockaddr *)&addr, &len);
-        if (cfd >= 0) {
-            (void)set_nonblock(cfd);
-            g_usbip.client_fd = cfd;
+    state = usbip_chan_state();
+    if (state == MM_CHAN_DOWN) {
+        if (g_usbip.connected) {
+            usbip_reset_client("peer closed");
+        }
+        mm_chan_rearm(g_usbip.chan);
+        return;
+    }
+    if (!g_usbip.connected) {
+        if (state == MM_CHAN_UP) {
+            g_usbip.connected = MM_TRUE;
             g_usbip.rx_len = 0;
             g_usbip.tx_len = 0;
             g_usbip.tx_off = 0;
@@ -873,21 +908,16 @@ void mm_usbdev_poll(void)
             usb_trace("client connected");
         }
     }
-    if (g_usbip.client_fd >= 0) {
-        ssize_t n;
+    if (g_usbip.connected) {
         size_t space = sizeof(g_usbip.rx_buf) - g_usbip.rx_len;
         if (space > 0) {
-            n = recv(g_usbip.client_fd, g_usbip.rx_buf + g_usbip.rx_len, space, MSG_DONTWAIT);
+            mm_u32 n = usbip_chan_read(g_usbip.rx_buf + g_usbip.rx_len, (mm_u32)space);
             if (n > 0) {
                 g_usbip.rx_len += (size_t)n;
                 usb_trace("rx %zu bytes (total=%zu)", (size_t)n, g_usbip.rx_len);
-            } else if (n == 0) {
-                usbip_reset_client("recv eof");
-            } else if (n < 0 && (errno != EAGAIN && errno != EWOULDBLOCK)) {
-                usbip_reset_client("recv error");
             }
         }
-        while (g_usbip.client_fd >= 0 && g_usbip.rx_len > 0) {
+        while (g_usbip.connected && g_usbip.rx_len > 0) {
             if (!g_usbip.imported) {
                 usbip_handle_mgmt();
             } else {
@@ -914,14 +944,11 @@ void mm_usbdev_poll(void)
 
 void mm_usbdev_stop(void)
 {
-    if (g_usbip.client_fd >= 0) {
-        close(g_usbip.client_fd);
-        g_usbip.client_fd = -1;
-    }
-    if (g_usbip.listen_fd >= 0) {
-        close(g_usbip.listen_fd);
-        g_usbip.listen_fd = -1;
-    }
+    /* Closes the listening and client sockets. */
+    mm_reactor_close(g_usbip.chan);
+    g_usbip.chan = 0;
+    g_usbip.listen_fd = -1;
+    g_usbip.connected = MM_FALSE;
     g_usbip.running = MM_FALSE;
     g_usbip.imported = MM_FALSE;
     g_usbip.rx_len = 0;
@@ -937,7 +964,7 @@ void mm_usbdev_get_status(struct mm_usbdev_status *out)
     }
     memset(out, 0, sizeof(*out));
     out->running = g_usbip.running;
-    out->connected = (g_usbip.client_fd >= 0) ? MM_TRUE : MM_FALSE;
+    out->connected = g_usbip.connected;
     out->imported = g_usbip.imported;
     out->port = g_usbip.port;
     out->devid = g_usbip.devid;
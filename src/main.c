@@ -38,9 +38,23 @@
 #include "m33mu/exec_helpers.h"
 #include "m33mu/execute.h"
 #include "m33mu/core_sys.h"
+#include "m33mu/itm.h"
+#include "m33mu/trace.h"
+#include "m33mu/profile.h"
+#include "m33mu/semihost.h"
+#include "m33mu/intercept.h"
+#include "m33mu/busywait.h"
+#include "m33mu/hostwait.h"
+#include "m33mu/vsync.h"
+#include "m33mu/reactor.h"
+#include "m33mu/jit.h"
+#include "m33mu/predecode.h"
+#include "m33mu/fuse.h"
+#include "m33mu/stm32_crypto.h"
 #include "m33mu/mem_prot.h"
 #include "m33mu/vector.h"
 #include "m33mu/exc_return.h"
+#include "m33mu/fpu.h"
 #include "m33mu/tz.h"
 #include "m33mu/exception.h"
 #include "m33mu/table_branch.h"
@@ -48,6 +62,7 @@
 #include "m33mu/target_hal.h"
 #include "m33mu/spiflash.h"
 #include "m33mu/usbdev.h"
+#include "m33mu/replay.h"
 #include "m33mu/eth_backend.h"
 #ifdef M33MU_HAS_LIBTPMS
 #include "m33mu/tpm_tis.h"
@@ -66,7 +81,7 @@
 #define NS_PER_SEC 1000000000ull
 #define DEFAULT_BATCH_CYCLES 64ull         /* ~1 us @ 64 MHz */
 #define DEFAULT_SYNC_GRANULARITY 640ull    /* ~10 us pacing interval */
-#define IDLE_SLEEP_NS 200000ull            /* 200 us host nap when fully idle */
+#define IDLE_RECHECK_NS 100000000ull      /* 100 ms cap on fd waits when fully idle */
 
 static mm_u64 host_now_ns(void)
 {
@@ -85,6 +100,48 @@ static mm_u64 deadline_ns(mm_u64 vcycles, mm_u64 host0_ns, mm_u64 cpu_hz)
     return host0_ns + (mm_u64)prod;
 }
 
+/* Inverse of deadline_ns(): virtual cycle count reached at host time now_ns. */
+static mm_u64 host_ns_to_vcycles(mm_u64 now_ns, mm_u64 host0_ns, mm_u64 cpu_hz)
+{
+    __int128 prod;
+    if (now_ns <= host0_ns) {
+        return 0;
+    }
+    if (cpu_hz == 0) {
+        cpu_hz = MM_CPU_HZ;
+    }
+    prod = (__int128)(now_ns - host0_ns) * (__int128)cpu_hz;
+    prod /= (__int128)NS_PER_SEC;
+    return (mm_u64)prod;
+}
+
+/* Cycle count at which this run reaches the virtual time granted by the
+ * sync coordinator. vns_base is virtual time spent before the last reset. */
+static mm_u64 vsync_limit_cycles(const struct mm_vsync *vs, mm_u64 vns_base, mm_u64 cpu_hz)
+{
+    return host_ns_to_vcycles(vs->limit_ns, vns_base, cpu_hz);
+}
+
+/* Cycles the core may advance in one step without stepping over a SysTick
+ * fire, a SoC timer event or the end of the --sync quantum (sync_limit is
+ * only meaningful when synced). */
+static mm_u64 cycles_until_deadline(const struct mm_scs *scs, const struct mm_target_cfg *cfg,
+                                    mm_bool synced, mm_u64 vcycles, mm_u64 sync_limit)
+{
+    mm_u64 until = mm_scs_systick_cycles_until_fire(scs);
+    mm_u64 due = mm_timer_next_event(cfg);
+    if (due < until) {
+        until = due;
+    }
+    if (synced) {
+        due = (sync_limit > vcycles) ? (sync_limit - vcycles) : 0u;
+        if (due < until) {
+            until = due;
+        }
+    }
+    return until;
+}
+
 static int load_file_at(const char *path, mm_u8 *dst, size_t max_len, mm_u32 offset, size_t *loaded);
 void mm_system_request_reset(void);
 
@@ -323,6 +380,17 @@ static mm_bool handle_tui(struct mm_tui *tui,
     mm_u32 actions;
     mm_bool running;
 
+    if (mm_replay_playing()) {
+        /* Replay runs headless; only the recorded quit/reset matter. */
+        mm_u8 ctl = 0;
+        if (!mm_replay_take(MM_REPLAY_CONTROL, 0, &ctl, 1u, 0)) {
+            return MM_FALSE;
+        }
+        if ((ctl & MM_REPLAY_CTL_RESET) != 0u) {
+            apply_reset_view(0, cpu, map, cycle_total, steps_offset, steps_latched);
+        }
+        return ((ctl & MM_REPLAY_CTL_QUIT) != 0u) ? MM_TRUE : MM_FALSE;
+    }
     if (!opt_tui || tui == 0) {
         return MM_FALSE;
     }
@@ -360,6 +428,18 @@ static mm_bool handle_tui(struct mm_tui *tui,
         mm_tui_set_memory_map(tui, map);
     }
     actions = mm_tui_take_actions(tui);
+    if (mm_replay_recording()) {
+        mm_u8 ctl = 0;
+        if ((actions & MM_TUI_ACTION_QUIT) != 0u) ctl |= MM_REPLAY_CTL_QUIT;
+        if ((actions & MM_TUI_ACTION_RESET) != 0u) ctl |= MM_REPLAY_CTL_RESET;
+        if (ctl != 0u) {
+            mm_replay_put(MM_REPLAY_CONTROL, 0, &ctl, 1u);
+        }
+        if ((actions & (MM_TUI_ACTION_RELOAD | MM_TUI_ACTION_LAUNCH_GDB)) != 0u) {
+            fprintf(stderr, "[REPLAY] image reload and GDB are not available while recording\n");
+            actions &= ~(mm_u32)(MM_TUI_ACTION_RELOAD | MM_TUI_ACTION_LAUNCH_GDB);
+        }
+    }
     if ((actions & MM_TUI_ACTION_QUIT) != 0u) {
         return MM_TRUE;
     }
@@ -632,6 +712,72 @@ static mm_bool parse_image_spec(const char *spec, char **path_out, mm_u32 *offse
 }
 
 static mm_bool g_quit_on_faults = MM_FALSE;
+static struct mm_itm_sink g_itm;
+static struct mm_trace_writer g_trace;
+static mm_bool g_trace_on = MM_FALSE;
+static struct mm_profile g_profile;
+static struct mm_semihost g_semihost;
+static struct mm_intercept g_intercept;
+static struct mm_busywait g_busywait;
+static struct mm_jit g_jit;
+static struct mm_predecode g_predecode;
+static struct mm_fuse g_fuse;
+static struct mm_vsync g_vsync = { -1, 0, 0, MM_FALSE };
+
+/* Decode the loaded flash range up front, reusing a cached table if one
+ * matches the image, cpu and emulator build. */
+/* SPI flash program/erase under an XIP window: drop cached decodes and
+ * translations of the bytes that changed. */
+static void code_changed(void *opaque, mm_u32 addr, mm_u32 len)
+{
+    (void)opaque;
+    mm_predecode_invalidate(&g_predecode, addr, len);
+    mm_jit_invalidate(&g_jit, addr, len);
+}
+
+static void predecode_flash(const char *cache_dir, const char *cpu_name,
+                            const struct mm_target_cfg *cfg, const mm_u8 *flash,
+                            size_t loaded_max_end)
+{
+    char path[1024];
+    mm_bool have_path = MM_FALSE;
+    if (cache_dir != 0) {
+        have_path = mm_predecode_cache_path(path, sizeof(path), cache_dir, flash,
+                                            loaded_max_end, cpu_name);
+        if (have_path && mm_predecode_load(&g_predecode, path, flash, loaded_max_end,
+                                           cfg->flash_base_s, cfg->flash_base_ns)) {
+            return;
+        }
+    }
+    if (!mm_predecode_build(&g_predecode, flash, loaded_max_end,
+                            cfg->flash_base_s, cfg->flash_base_ns)) {
+        return;
+    }
+    if (have_path && !mm_predecode_store(&g_predecode, path, flash)) {
+        fprintf(stderr, "[PREDECODE] cannot write cache %s\n", path);
+    }
+}
+
+/* ELF used for guest symbols: --gdb-symbols, else <image>.elf next to a .bin. */
+static const char *symbol_elf_path(const char *gdb_symbols, const char *image0, char *buf, size_t len)
+{
+    size_t plen = strlen(image0);
+    if (gdb_symbols != 0) {
+        return gdb_symbols;
+    }
+    if (plen > 4u && strcmp(image0 + plen - 4u, ".bin") == 0) {
+        snprintf(buf, len, "%.*s.elf", (int)(plen - 4u), image0);
+        if (access(buf, R_OK) == 0) {
+            return buf;
+        }
+    }
+    return 0;
+}
+
+static void trace_mem_observer(void *opaque, mm_u32 addr, mm_u32 size, mm_u32 value)
+{
+    mm_trace_mem_write((struct mm_trace_writer *)opaque, addr, size, value);
+}
 static mm_bool g_fault_pending = MM_FALSE;
 static int g_stack_trace = -1;
 
@@ -788,7 +934,10 @@ static mm_bool exc_return_unstack(struct mm_cpu *cpu, struct mm_memmap *map, mm_
         cpu->xpsr = frame[7];
     }
 
-    sp += 32u;
+    if (!mm_fpu_exception_return(cpu, map, info.target_sec, sp, info.basic_frame)) {
+        return MM_FALSE;
+    }
+    sp += info.basic_frame ? 32u : (32u + MM_FPU_FRAME_EXT);
     if (info.use_psp) {
         if (info.target_sec == MM_NONSECURE) cpu->psp_ns = sp;
         else cpu->psp_s = sp;
@@ -805,6 +954,7 @@ static mm_bool exc_return_unstack(struct mm_cpu *cpu, struct mm_memmap *map, mm_
 
     cpu->sec_state = info.target_sec;
     cpu->mode = info.to_thread ? MM_THREAD : MM_HANDLER;
+    mm_cpu_sp_rebank(cpu);
     if (stack_trace_enabled() && info.target_sec == MM_SECURE) {
         printf("[EXC_UNSTACK] new pc=0x%08lx sp=0x%08lx r13=0x%08lx mode=%d sec=%d\n",
                (unsigned long)cpu->r[15],
@@ -905,6 +1055,10 @@ static mm_bool raise_hard_fault(struct mm_cpu *cpu, struct mm_memmap *map, struc
 
     sp = use_psp_entry ? ((sec == MM_NONSECURE) ? cpu->psp_ns : cpu->psp_s)
                        : ((sec == MM_NONSECURE) ? cpu->msp_ns : cpu->msp_s);
+    if (!mm_fpu_exception_entry(cpu, map, sec, &sp, &exc_ret_val)) {
+        printf("HardFault: FP stacking failed at 0x%08lx\n", (unsigned long)sp);
+        return MM_FALSE;
+    }
     for (i = 7; i >= 0; --i) {
         sp -= 4u;
         if (!mm_memmap_write(map, sec, sp, 4u, frame[i])) {
@@ -928,6 +1082,7 @@ static mm_bool raise_hard_fault(struct mm_cpu *cpu, struct mm_memmap *map, struc
     cpu->xpsr = (fault_xpsr & 0xF8000000u) | 0x01000003u;
     cpu->r[14] = exc_ret_val;
     cpu->mode = MM_HANDLER;
+    mm_cpu_sp_rebank(cpu);
     cpu->r[15] = handler | 1u;
     return MM_TRUE;
 }
@@ -1134,6 +1289,10 @@ static mm_bool raise_usage_fault(struct mm_cpu *cpu, struct mm_memmap *map, stru
     if (g_quit_on_faults) {
         return MM_FALSE;
     }
+    if (!mm_fpu_exception_entry(cpu, map, sec, &sp, &exc_ret_val)) {
+        printf("HardFault: FP stacking failed at 0x%08lx\n", (unsigned long)sp);
+        return MM_FALSE;
+    }
     for (i = 7; i >= 0; --i) {
         mm_bool ok;
         sp -= 4u;
@@ -1163,6 +1322,7 @@ static mm_bool raise_usage_fault(struct mm_cpu *cpu, struct mm_memmap *map, stru
     cpu->xpsr = (fault_xpsr & 0xF8000000u) | 0x01000006u;
     cpu->r[14] = exc_ret_val;
     cpu->mode = MM_HANDLER;
+    mm_cpu_sp_rebank(cpu);
     cpu->r[15] = handler | 1u;
     return MM_TRUE;
 }
@@ -1202,6 +1362,10 @@ static mm_bool enter_exception_ex(struct mm_cpu *cpu,
 
     sec = cpu->sec_state;
     pre_mode = cpu->mode;
+    mm_scs_dwt_exception(scs);
+    if (g_trace_on) {
+        mm_trace_exception(&g_trace, exc_num);
+    }
 
     if (exc_num >= 16u) {
         vtor = (handler_sec == MM_NONSECURE) ? scs->vtor_ns : scs->vtor_s;
@@ -1268,6 +1432,10 @@ static mm_bool enter_exception_ex(struct mm_cpu *cpu,
                (unsigned long)cpu->control_s,
                (unsigned long)cpu->control_ns);
     }
+    if (!mm_fpu_exception_entry(cpu, map, sec, &sp, &exc_ret_val)) {
+        printf("HardFault: FP stacking failed at 0x%08lx\n", (unsigned long)sp);
+        return MM_FALSE;
+    }
     for (i = 7; i >= 0; --i) {
         sp -= 4u;
         if (!mm_memmap_write(map, sec, sp, 4u, frame[i])) {
@@ -1291,6 +1459,7 @@ static mm_bool enter_exception_ex(struct mm_cpu *cpu,
     cpu->r[14] = exc_ret_val;
     cpu->mode = MM_HANDLER;
     cpu->sec_state = handler_sec;
+    mm_cpu_sp_rebank(cpu);
     cpu->r[15] = handler | 1u;
     cpu->sleeping = MM_FALSE;
     cpu->event_reg = MM_FALSE;
@@ -1313,6 +1482,17 @@ int main(int argc, char **argv)
     mm_bool opt_uart_stdout = MM_FALSE;
     mm_bool opt_meminfo = MM_FALSE;
     const char *gdb_symbols = 0;
+    const char *opt_itm = 0;
+    const char *opt_trace = 0;
+    const char *opt_profile = 0;
+    mm_u64 opt_profile_period = MM_PROFILE_DEFAULT_PERIOD;
+    const char *opt_semihost = 0;
+    const char *opt_intercept = 0;
+    mm_bool opt_intercept_verify = MM_FALSE;
+    mm_bool opt_no_busywait = MM_FALSE;
+    mm_bool opt_no_fuse = MM_FALSE;
+    mm_bool opt_jit = MM_FALSE;
+    const char *opt_decode_cache = 0;
     int gdb_port = 1234;
     const char *cpu_name = 0;
     int i;
@@ -1347,6 +1527,10 @@ int main(int argc, char **argv)
     int usb_port = 3240;
     enum mm_eth_backend_type eth_backend = MM_ETH_BACKEND_NONE;
     const char *eth_spec = 0;
+    const char *sync_path = 0;
+    const char *eth_pcap = 0;
+    const char *replay_path = 0;
+    enum mm_replay_mode replay_mode = MM_REPLAY_OFF;
     struct mm_spiflash_cfg spiflash_cfgs[8];
     int spiflash_count = 0;
 #ifdef M33MU_HAS_LIBTPMS
@@ -1448,6 +1632,45 @@ int main(int argc, char **argv)
             opt_quit_on_faults = MM_TRUE;
         } else if (strcmp(argv[i], "--meminfo") == 0) {
             opt_meminfo = MM_TRUE;
+        } else if (strncmp(argv[i], "--itm:", 6) == 0) {
+            opt_itm = argv[i] + 6;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            opt_trace = argv[i + 1];
+            i++;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            opt_profile = argv[i] + 10;
+        } else if (strncmp(argv[i], "--profile-period=", 17) == 0) {
+            char *end = 0;
+            unsigned long long v = strtoull(argv[i] + 17, &end, 0);
+            if (end == argv[i] + 17 || *end != '\0' || v == 0ull) {
+                fprintf(stderr, "invalid profile period: %s\n", argv[i] + 17);
+                return 1;
+            }
+            opt_profile_period = (mm_u64)v;
+        } else if (strncmp(argv[i], "--intercept=", 12) == 0) {
+            opt_intercept = argv[i] + 12;
+        } else if (strncmp(argv[i], "--decode-cache=", 15) == 0) {
+            opt_decode_cache = argv[i] + 15;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            opt_jit = MM_TRUE;
+        } else if (strcmp(argv[i], "--no-busywait") == 0) {
+            opt_no_busywait = MM_TRUE;
+        } else if (strcmp(argv[i], "--no-fuse") == 0) {
+            opt_no_fuse = MM_TRUE;
+        } else if (strcmp(argv[i], "--intercept-verify") == 0) {
+            opt_intercept_verify = MM_TRUE;
+        } else if (strncmp(argv[i], "--crypto-cycles=", 16) == 0) {
+            struct mm_stm32_crypto_timing ct;
+            mm_stm32_crypto_get_timing(&ct);
+            if (!mm_stm32_crypto_parse_timing(argv[i] + 16, &ct)) {
+                fprintf(stderr, "invalid crypto cycle model: %s\n", argv[i] + 16);
+                return 1;
+            }
+            mm_stm32_crypto_set_timing(&ct);
+        } else if (strcmp(argv[i], "--semihosting") == 0) {
+            opt_semihost = ".";
+        } else if (strncmp(argv[i], "--semihosting=", 14) == 0) {
+            opt_semihost = argv[i] + 14;
         } else if (strncmp(argv[i], "--spiflash:", 11) == 0) {
             if (spiflash_count >= (int)(sizeof(spiflash_cfgs) / sizeof(spiflash_cfgs[0]))) {
                 fprintf(stderr, "too many spiflash configs\n");
@@ -1500,6 +1723,29 @@ int main(int argc, char **argv)
             }
             eth_backend = MM_ETH_BACKEND_TAP;
             eth_spec = argv[i] + 6;
+        } else if ((strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0) && i + 1 < argc) {
+            if (replay_mode != MM_REPLAY_OFF) {
+                fprintf(stderr, "--record and --replay can only be given once\n");
+                return 1;
+            }
+            replay_mode = (strcmp(argv[i], "--record") == 0) ? MM_REPLAY_RECORD : MM_REPLAY_PLAY;
+            replay_path = argv[i + 1];
+            i++;
+        } else if (strncmp(argv[i], "--eth-pcap=", 11) == 0) {
+            eth_pcap = argv[i] + 11;
+        } else if (strncmp(argv[i], "--sync=", 7) == 0) {
+            sync_path = argv[i] + 7;
+            if (sync_path[0] == '\0') {
+                fprintf(stderr, "--sync requires a socket path\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--eth-shm:", 10) == 0) {
+            if (eth_backend != MM_ETH_BACKEND_NONE) {
+                fprintf(stderr, "only one ethernet backend can be selected\n");
+                return 1;
+            }
+            eth_backend = MM_ETH_BACKEND_SHM;
+            eth_spec = argv[i] + 10;
 #ifdef M33MU_HAS_LIBTPMS
         } else if (strncmp(argv[i], "--tpm:", 6) == 0) {
             if (tpm_count >= (int)(sizeof(tpm_cfgs) / sizeof(tpm_cfgs[0]))) {
@@ -1541,9 +1787,17 @@ int main(int argc, char **argv)
                         "[--capstone] [--capstone-verbose] "
 #endif
                         "[--uart-stdout] [--quit-on-faults] [--meminfo] [--gdb-symbols <elf>] "
+                        "[--itm:<file>|-|tcp:<port>|pty] [--trace <file[.zst]>] "
+                        "[--profile=<file>] [--profile-period=<cycles>] "
+                        "[--semihosting[=<dir>]] "
+                        "[--crypto-cycles=hash:<n>,aes:<n>,pka:<pct>] "
+                        "[--intercept=<fn>[:<cycles>[+<per-unit>]],...] [--intercept-verify] "
+                        "[--no-busywait] [--no-fuse] [--jit] [--decode-cache=<dir>] "
                         "[--spiflash:SPIx:file=<path>:size=<n>[:mmap=0xaddr][:cs=GPIONAME]] "
                         "[--usb[:port=<n>]] "
                         "[--tap[:name]] [--vde[:/path/to/vde.ctl]] "
+                        "[--eth-shm:<name>[,latency_us=<n>][,loss=<pct>%%][,pcap=<file>]] [--sync=<socket>] "
+                        "[--eth-pcap=<file>[,rotate=<MiB>]] [--record <log>|--replay <log>] "
 #ifdef M33MU_HAS_LIBTPMS
                         "[--tpm:SPIx:cs=GPIONAME[:file=<path>]] "
 #endif
@@ -1552,6 +1806,16 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (replay_mode != MM_REPLAY_OFF && opt_gdb) {
+        /* GDB can rewrite registers and memory at any point. */
+        fprintf(stderr, "--record/--replay cannot be combined with --gdb\n");
+        return 1;
+    }
+    if (replay_mode == MM_REPLAY_PLAY && (opt_tui || sync_path != 0)) {
+        fprintf(stderr, "--replay runs standalone and cannot be combined with --tui or --sync\n");
+        return 1;
+    }
+
     g_quit_on_faults = opt_quit_on_faults;
     if (opt_tui && opt_uart_stdout) {
         fprintf(stderr, "warning: --uart-stdout disabled while TUI is active\n");
@@ -1617,6 +1881,77 @@ int main(int argc, char **argv)
         }
     }
 
+    mm_itm_sink_init(&g_itm);
+    if (opt_itm != 0 && !mm_itm_sink_open(&g_itm, opt_itm)) {
+        fprintf(stderr, "failed to open ITM output %s\n", opt_itm);
+        return 1;
+    }
+    if (opt_trace != 0) {
+        size_t tlen = strlen(opt_trace);
+        mm_bool zst = (tlen > 4u && strcmp(opt_trace + tlen - 4u, ".zst") == 0) ? MM_TRUE : MM_FALSE;
+        if (zst && !mm_trace_zstd_available()) {
+            fprintf(stderr, "%s: zstd support is not available (libzstd not found at build time)\n", opt_trace);
+            return 1;
+        }
+        if (!mm_trace_open(&g_trace, opt_trace, zst)) {
+            fprintf(stderr, "failed to open trace file %s\n", opt_trace);
+            return 1;
+        }
+        g_trace_on = MM_TRUE;
+        mm_memmap_set_write_observer(trace_mem_observer, &g_trace);
+    }
+    if (replay_mode != MM_REPLAY_OFF && !mm_replay_open(replay_mode, replay_path)) {
+        fprintf(stderr, "failed to open input log %s\n", replay_path);
+        return 1;
+    }
+    mm_profile_init(&g_profile);
+    if (opt_profile != 0) {
+        char prof_elf_path[512];
+        const char *prof_elf = symbol_elf_path(gdb_symbols, images[0].path, prof_elf_path, sizeof(prof_elf_path));
+        if (!mm_profile_start(&g_profile, opt_profile_period, prof_elf)) {
+            fprintf(stderr, "[PROFILE] no function symbols%s%s, reporting raw addresses\n",
+                    (prof_elf != 0) ? " in " : "", (prof_elf != 0) ? prof_elf : "");
+        }
+    }
+
+    mm_semihost_init(&g_semihost);
+    if (opt_semihost != 0 && !mm_semihost_enable(&g_semihost, opt_semihost)) {
+        fprintf(stderr, "invalid semihosting root: %s\n", opt_semihost);
+        return 1;
+    }
+
+    /* Single-stepping and instruction traces need every iteration. */
+    mm_busywait_init(&g_busywait, !opt_no_busywait && !opt_gdb && !g_trace_on);
+    mm_fuse_init(&g_fuse, !opt_no_fuse);
+    memset(&g_jit, 0, sizeof(g_jit));
+    if (opt_jit && !opt_gdb && !g_trace_on && !opt_pc_trace && !opt_strcmp_trace) {
+        if (!mm_jit_init(&g_jit, &map)) {
+            fprintf(stderr, "[JIT] not available in this build or on this host, interpreting\n");
+        }
+    }
+    mm_intercept_init(&g_intercept);
+    if (opt_intercept != 0) {
+        char ic_elf_path[512];
+        const char *ic_elf = symbol_elf_path(gdb_symbols, images[0].path, ic_elf_path, sizeof(ic_elf_path));
+        struct mm_elfsym_table ic_syms;
+        if (!mm_intercept_parse(&g_intercept, opt_intercept)) {
+            fprintf(stderr, "invalid intercept list: %s (routines:", opt_intercept);
+            for (i = 0; mm_intercept_routine_name(i) != 0; ++i) {
+                fprintf(stderr, " %s", mm_intercept_routine_name(i));
+            }
+            fprintf(stderr, ")\n");
+            return 1;
+        }
+        g_intercept.verify = opt_intercept_verify;
+        mm_elfsym_init(&ic_syms);
+        if (ic_elf == 0 || !mm_elfsym_load(&ic_syms, ic_elf)) {
+            fprintf(stderr, "[INTERCEPT] no symbols: pass --gdb-symbols <elf>\n");
+        } else {
+            mm_intercept_bind(&g_intercept, &ic_syms);
+        }
+        mm_elfsym_free(&ic_syms);
+    }
+
     flash = (mm_u8 *)malloc(cfg.flash_size_s);
     ram = (mm_u8 *)malloc(cfg_total_ram(&cfg));
     if (flash == NULL || ram == NULL) {
@@ -1670,6 +2005,9 @@ int main(int argc, char **argv)
         }
         mm_flash_persist_build(&persist, flash, cfg.flash_size_s, paths, offsets, image_count);
     }
+    mm_predecode_init(&g_predecode);
+    predecode_flash(opt_decode_cache, cpu_name, &cfg, flash, loaded_max_end);
+    mm_memmap_set_code_observer(code_changed, 0);
 
     mm_gdb_stub_init(&gdb);
     if (opt_gdb) {
@@ -1709,13 +2047,20 @@ int main(int argc, char **argv)
 
     {
         mm_bool first_start = MM_TRUE;
+        mm_u64 vns_base = 0;
+        mm_u64 cycle_base = 0;
         for (;;) {
             mm_u64 cycle_total = 0;
             mm_bool done = MM_FALSE;
             mm_bool reset_again = MM_FALSE;
             mm_u64 vcycles = 0;
             mm_u64 vcycles_last_sync = 0;
+            /* Wall-clock pacing is replaced by the coordinator under --sync
+             * and skipped entirely on replay. */
+            mm_u64 *pace = (sync_path != 0 || replay_mode == MM_REPLAY_PLAY) ? 0 : &vcycles_last_sync;
+            mm_u64 sync_limit = 0;
             mm_u64 cycles_since_poll = 0;
+            mm_u64 idle_skip = 0;
             const mm_u64 poll_granularity = DEFAULT_BATCH_CYCLES;
             mm_u64 sync_granularity = DEFAULT_SYNC_GRANULARITY;
             mm_u64 host0_ns = host_now_ns();
@@ -1725,6 +2070,16 @@ int main(int argc, char **argv)
             tui_steps_offset = 0;
 
             mm_system_clear_reset();
+            if (g_trace_on) {
+                mm_trace_resync(&g_trace);
+            }
+            mm_profile_rebase(&g_profile, 0);
+            mm_semihost_reset(&g_semihost);
+            mm_intercept_reset(&g_intercept);
+            mm_busywait_reset(&g_busywait);
+            mm_jit_flush(&g_jit);
+            mm_semihost_bind_clock(&g_semihost, &cycle_total, &cpu_hz);
+            mm_replay_bind_clock(&cycle_total, cycle_base);
             mm_memmap_init(&map, regions, sizeof(regions) / sizeof(regions[0]));
             mm_target_soc_reset(&cfg);
             mm_timer_reset(&cfg);
@@ -1742,6 +2097,7 @@ int main(int argc, char **argv)
             map.ram.length = cfg_total_ram(&cfg);
             mm_target_register_mmio(&cfg, &map.mmio);
             mm_spiflash_register_mmap_regions(&map.mmio);
+            mm_spiflash_register_xip_regions(&map);
             mm_target_flash_bind(&cfg, &map, flash, cfg.flash_size_s, opt_persist ? &persist : 0);
             mm_target_usart_reset(&cfg);
             mm_target_usart_init(&cfg, &map.mmio, &nvic);
@@ -1753,6 +2109,9 @@ int main(int argc, char **argv)
 
             mm_scs_init(&scs, 0x410fc241u);
             mm_scs_register_regions(&scs, &map.mmio, 0xE000ED00u, 0xE002ED00u, &nvic);
+            mm_scs_register_debug_regions(&scs, &map.mmio);
+            mm_scs_set_itm_sink(&scs, mm_itm_sink_active(&g_itm) ? &g_itm : 0);
+            mm_scs_set_cpu(&scs, &cpu);
             mm_core_sys_register(&map.mmio);
             mm_prot_init(&prot, &scs, &cfg);
             mm_memmap_set_interceptor(&map, mm_prot_interceptor, &prot);
@@ -1797,6 +2156,7 @@ int main(int argc, char **argv)
                 cpu.tz_depth = 0;
                 cpu.sleeping = MM_FALSE;
                 cpu.event_reg = MM_FALSE;
+                mm_fpu_reset(&cpu);
             }
 
             if (!mm_vector_apply_reset(&cpu, &map, MM_SECURE)) {
@@ -1813,13 +2173,18 @@ int main(int argc, char **argv)
             }
 
             if (first_start) {
+                if (eth_pcap != 0 && !mm_eth_capture_open(eth_pcap)) {
+                    fprintf(stderr, "invalid --eth-pcap spec or unwritable file: %s\n", eth_pcap);
+                    rc = 1;
+                    goto cleanup;
+                }
                 if (eth_backend != MM_ETH_BACKEND_NONE) {
                     if (!mm_eth_backend_config(eth_backend, eth_spec)) {
                         fprintf(stderr, "invalid ethernet backend spec\n");
                         rc = 1;
                         goto cleanup;
                     }
-                    if (!mm_eth_backend_start()) {
+                    if (replay_mode != MM_REPLAY_PLAY && !mm_eth_backend_start()) {
                         fprintf(stderr, "failed to start ethernet backend\n");
                         rc = 1;
                         goto cleanup;
@@ -1832,6 +2197,14 @@ int main(int argc, char **argv)
                         goto cleanup;
                     }
                 }
+                if (sync_path != 0) {
+                    if (!mm_vsync_connect(&g_vsync, sync_path)) {
+                        fprintf(stderr, "failed to join sync coordinator at %s\n", sync_path);
+                        rc = 1;
+                        goto cleanup;
+                    }
+                    mm_eth_backend_set_epoch(g_vsync.epoch);
+                }
                 printf("Initial SP=0x%08lx PC=0x%08lx\n", (unsigned long)mm_cpu_get_active_sp(&cpu), (unsigned long)cpu.r[15]);
                 printf("VTOR_S=0x%08lx VTOR_NS=0x%08lx\n", (unsigned long)cpu.vtor_s, (unsigned long)cpu.vtor_ns);
                 first_start = MM_FALSE;
@@ -1839,6 +2212,9 @@ int main(int argc, char **argv)
                 printf("[RESET] System reset requested, reinitialising core\n");
             }
 
+            if (sync_path != 0) {
+                sync_limit = vsync_limit_cycles(&g_vsync, vns_base, cpu_hz);
+            }
             cpu.r[14] = 0xFFFFFFFFu; /* Initial LR */
             last_running = target_should_run(opt_gdb, &gdb, tui_paused, tui_step);
 
@@ -1856,6 +2232,9 @@ int main(int argc, char **argv)
                     sync_granularity = cpu_hz / 100000u;
                     if (sync_granularity == 0) sync_granularity = 1u;
                     printf("[CLOCK] CPU %llu Hz\n", (unsigned long long)cpu_hz);
+                    if (sync_path != 0) {
+                        sync_limit = vsync_limit_cycles(&g_vsync, vns_base, cpu_hz);
+                    }
                 }
                 if (g_fault_pending) {
                     done = MM_TRUE;
@@ -1898,7 +2277,7 @@ int main(int argc, char **argv)
                     }
                 }
 
-                if (opt_tui) {
+                if (opt_tui || replay_mode == MM_REPLAY_PLAY) {
                     update_tui_steps_latched(opt_gdb, &gdb, tui_paused, tui_step, cycle_total,
                                              &tui_steps_offset, &tui_steps_latched);
                     if (handle_tui(&tui, opt_tui, &opt_capstone, &opt_gdb, &gdb, cpu_name, gdb_symbols, &cpu, &map, cycle_total, &tui_steps_offset, &tui_steps_latched, &tui_paused, &tui_step, &reload_pending, gdb_port)) {
@@ -1930,23 +2309,26 @@ int main(int argc, char **argv)
                     last_running = running_now;
                 }
                 
-                if (!running_now) {
-                    host_sync_if_needed(vcycles, &vcycles_last_sync, host0_ns, sync_granularity, cpu_hz);
+                /* Polls while stopped land at a cycle of the host's choosing;
+                 * a replay repeats them where the log says they happened. */
+                if (!running_now || (replay_mode == MM_REPLAY_PLAY && mm_replay_take(MM_REPLAY_POLL, 0, 0, 0u, 0))) {
+                    mm_replay_put(MM_REPLAY_POLL, 0, 0, 0u);
+                    host_sync_if_needed(vcycles, pace, host0_ns, sync_granularity, cpu_hz);
                     mm_target_usart_poll(&cfg);
                     mm_target_spi_poll(&cfg);
+                    mm_eth_backend_set_now(vns_base + deadline_ns(vcycles, 0, cpu_hz), cycle_total);
                     mm_target_eth_poll(&cfg);
                     mm_usbdev_poll();
+                    mm_itm_sink_poll(&g_itm, vcycles, MM_TRUE);
                     update_tui_steps_latched(opt_gdb, &gdb, tui_paused, tui_step, cycle_total,
                                              &tui_steps_offset, &tui_steps_latched);
                     if (handle_tui(&tui, opt_tui, &opt_capstone, &opt_gdb, &gdb, cpu_name, gdb_symbols, &cpu, &map, cycle_total, &tui_steps_offset, &tui_steps_latched, &tui_paused, &tui_step, &reload_pending, gdb_port)) {
                         done = MM_TRUE;
                         continue;
                     }
-                    {
-                        struct timespec req;
-                        req.tv_sec = 0;
-                        req.tv_nsec = (long)IDLE_SLEEP_NS;
-                        nanosleep(&req, 0);
+                    /* Stopped: nothing moves until GDB, the TUI or a backend fd does. */
+                    if (replay_mode != MM_REPLAY_PLAY) {
+                        (void)mm_hostwait_block(IDLE_RECHECK_NS);
                     }
                     if (mm_system_reset_pending()) {
                         reset_again = MM_TRUE;
@@ -1956,6 +2338,23 @@ int main(int argc, char **argv)
                     continue;
                 }
 
+                if (sync_path != 0 && vcycles >= sync_limit) {
+                    /* End of the quantum: report and wait for the slowest peer. */
+                    enum mm_vsync_status vst = mm_vsync_step(&g_vsync, vns_base + deadline_ns(vcycles, 0, cpu_hz));
+                    if (vst == MM_VSYNC_LOST) {
+                        fprintf(stderr, "[VSYNC] coordinator went away\n");
+                        rc = 1;
+                        done = MM_TRUE;
+                        continue;
+                    }
+                    if (vst == MM_VSYNC_WAITING) {
+                        (void)mm_hostwait_block(IDLE_RECHECK_NS);
+                        continue;
+                    }
+                    sync_limit = vsync_limit_cycles(&g_vsync, vns_base, cpu_hz);
+                    mm_eth_backend_set_epoch(g_vsync.epoch);
+                }
+
                 if (opt_gdb) {
                     if (mm_gdb_stub_breakpoint_hit(&gdb, cpu.r[15] | 1u)) {
                         mm_gdb_stub_notify_stop(&gdb, 5);
@@ -1975,6 +2374,7 @@ int main(int argc, char **argv)
                             }
                             mm_flash_persist_build(&persist, flash, cfg.flash_size_s, paths, offsets, image_count);
                         }
+                        predecode_flash(opt_decode_cache, cpu_name, &cfg, flash, loaded_max_end);
                         mm_system_request_reset();
                     }
                     reload_pending = MM_FALSE;
@@ -1987,14 +2387,11 @@ int main(int argc, char **argv)
                     mm_bool stopped = MM_FALSE;
                     stopped = !target_should_run(opt_gdb, &gdb, tui_paused, tui_step);
                     if (stopped) {
-                        struct timespec req;
-                        req.tv_sec = 0;
-                        req.tv_nsec = (long)IDLE_SLEEP_NS;
-                        nanosleep(&req, 0);
+                        (void)mm_hostwait_block(IDLE_RECHECK_NS);
                         continue;
                     }
                     /* Flush accumulated cycles into virtual time before idling. */
-                    host_sync_if_needed(vcycles, &vcycles_last_sync, host0_ns, sync_granularity, cpu_hz);
+                    host_sync_if_needed(vcycles, pace, host0_ns, sync_granularity, cpu_hz);
                     /* Wake on event register or any pending enabled exception. */
                     if (cpu.event_reg) {
                         wake = MM_TRUE;
@@ -2007,16 +2404,32 @@ int main(int argc, char **argv)
                         cpu.sleeping = MM_FALSE;
                         cpu.event_reg = MM_FALSE;
                     } else {
-                        mm_u64 delta = mm_scs_systick_cycles_until_fire(&scs);
+                        /* Sleep to the first SysTick or SoC timer event; only
+                         * with neither armed does host I/O alone wake the core. */
+                        mm_u64 delta = cycles_until_deadline(&scs, &cfg, MM_FALSE, vcycles, sync_limit);
+                        const mm_u64 full_delta = delta;
+                        if (sync_path != 0) {
+                            /* Idle time counts toward the quantum too; peers
+                             * are waiting on it, so never sleep past the grant. */
+                            mm_u64 room = (sync_limit > vcycles) ? (sync_limit - vcycles) : 0u;
+                            if (delta > room) {
+                                delta = room;
+                            }
+                        }
+                        if (replay_mode == MM_REPLAY_PLAY) {
+                            /* A shortened sleep was logged at its start. */
+                            (void)mm_replay_take_u64(MM_REPLAY_IDLE, 0, &delta);
+                        }
                         if (delta == (mm_u64)-1) {
-                            struct timespec req;
-                            req.tv_sec = 0;
-                            req.tv_nsec = (long)IDLE_SLEEP_NS;
-                            nanosleep(&req, 0);
+                            /* No timer armed: only host I/O can wake the core.
+                             * Poll first so output drained since WFI can raise
+                             * its interrupt, then block on the backend fds. */
                             mm_target_usart_poll(&cfg);
                             mm_target_spi_poll(&cfg);
+                            mm_eth_backend_set_now(vns_base + deadline_ns(vcycles, 0, cpu_hz), cycle_total);
                             mm_target_eth_poll(&cfg);
                             mm_usbdev_poll();
+                            mm_itm_sink_poll(&g_itm, vcycles, MM_TRUE);
                             update_tui_steps_latched(opt_gdb, &gdb, tui_paused, tui_step, cycle_total,
                                                      &tui_steps_offset, &tui_steps_latched);
                             if (handle_tui(&tui, opt_tui, &opt_capstone, &opt_gdb, &gdb, cpu_name, gdb_symbols, &cpu, &map, cycle_total, &tui_steps_offset, &tui_steps_latched, &tui_paused, &tui_step, &reload_pending, gdb_port)) {
@@ -2028,21 +2441,56 @@ int main(int argc, char **argv)
                                 mm_system_clear_reset();
                                 break;
                             }
+                            if (!cpu.event_reg && !scs.pend_st && !scs.pend_sv &&
+                                mm_nvic_select(&nvic, &cpu) < 0) {
+                                if (replay_mode == MM_REPLAY_PLAY) {
+                                    /* Only the log can wake the core now. */
+                                    if (!mm_replay_take(MM_REPLAY_IDLE_POLL, 0, 0, 0u, 0)) {
+                                        (void)mm_replay_finished();
+                                        done = MM_TRUE;
+                                    }
+                                    continue;
+                                }
+                                mm_replay_put(MM_REPLAY_IDLE_POLL, 0, 0, 0u);
+                                (void)mm_hostwait_block(IDLE_RECHECK_NS);
+                            }
                         } else {
+                            /* Wait for the SysTick deadline in host time, or
+                             * less if a backend fd becomes readable; in that
+                             * case only advance to the current host time so
+                             * the input lands at the right virtual cycle. */
+                            mm_u64 due_ns = deadline_ns(vcycles + delta, host0_ns, cpu_hz);
+                            mm_u64 now_ns = host_now_ns();
+                            if (pace != 0 && now_ns < due_ns && mm_hostwait_block(due_ns - now_ns)) {
+                                mm_u64 reached = host_ns_to_vcycles(host_now_ns(), host0_ns, cpu_hz);
+                                mm_u64 step = (reached > vcycles) ? (reached - vcycles) : 0u;
+                                if (step < delta) {
+                                    delta = step;
+                                }
+                            }
+                            if (delta != full_delta) {
+                                mm_replay_put_u64(MM_REPLAY_IDLE, 0, delta);
+                            }
                             mm_scs_systick_advance(&scs, delta);
+                            mm_scs_dwt_sleep(&scs, delta);
                             mm_timer_tick(&cfg, delta);
                             vcycles += delta;
                             cycle_total += delta;
                             cycles_since_poll += delta;
+                            if (g_profile.enabled && cycle_total >= g_profile.next_sample) {
+                                mm_profile_sample(&g_profile, &cpu, &map, cycle_total);
+                            }
                             if (scs.pend_st || scs.pend_sv) {
                                 cpu.sleeping = MM_FALSE;
                                 cpu.event_reg = MM_FALSE;
                             }
-                            host_sync_if_needed(vcycles, &vcycles_last_sync, host0_ns, sync_granularity, cpu_hz);
+                            host_sync_if_needed(vcycles, pace, host0_ns, sync_granularity, cpu_hz);
                             mm_target_usart_poll(&cfg);
                             mm_target_spi_poll(&cfg);
+                            mm_eth_backend_set_now(vns_base + deadline_ns(vcycles, 0, cpu_hz), cycle_total);
                             mm_target_eth_poll(&cfg);
                             mm_usbdev_poll();
+                            mm_itm_sink_poll(&g_itm, vcycles, MM_TRUE);
                             update_tui_steps_latched(opt_gdb, &gdb, tui_paused, tui_step, cycle_total,
                                                      &tui_steps_offset, &tui_steps_latched);
                             if (handle_tui(&tui, opt_tui, &opt_capstone, &opt_gdb, &gdb, cpu_name, gdb_symbols, &cpu, &map, cycle_total, &tui_steps_offset, &tui_steps_latched, &tui_paused, &tui_step, &reload_pending, gdb_port)) {
@@ -2050,6 +2498,10 @@ int main(int argc, char **argv)
                                 continue;
                             }
                             cycles_since_poll = 0;
+                            if (replay_mode == MM_REPLAY_PLAY && mm_replay_finished()) {
+                                done = MM_TRUE;
+                                continue;
+                            }
                             if (mm_system_reset_pending()) {
                                 reset_again = MM_TRUE;
                                 mm_system_clear_reset();
@@ -2110,18 +2562,31 @@ handle_pending:
                     mm_bool execute_it;
                     mm_u32 pc_before_exec = 0;
                     const mm_u32 insn_cycles = 1u;
+                    mm_bool fused = MM_FALSE;
                     (void)pc_before_exec;
+fuse_second:
                     cycles_since_poll += insn_cycles;
                     cycle_total += insn_cycles;
                     vcycles += insn_cycles;
                     mm_scs_systick_advance(&scs, insn_cycles);
                     mm_timer_tick(&cfg, insn_cycles);
 
-                    /* Keep R13 consistent with the active banked SP so that instructions
-                     * like LDR/STR [SP,#imm] and function prologue/epilogue sequences
-                     * operate on the correct stack memory.
-                     */
-                    cpu.r[13] = mm_cpu_get_active_sp(&cpu);
+                    if (g_profile.enabled && cycle_total >= g_profile.next_sample) {
+                        mm_profile_sample(&g_profile, &cpu, &map, cycle_total);
+                    }
+                    if (g_intercept.enabled && it_remaining == 0u) {
+                        mm_u32 native_cycles = mm_intercept_step(&g_intercept, &cpu, &map);
+                        if (native_cycles != 0u) {
+                            /* The call instruction's own cycle was charged above. */
+                            native_cycles--;
+                            cycles_since_poll += native_cycles;
+                            cycle_total += native_cycles;
+                            vcycles += native_cycles;
+                            mm_scs_systick_advance(&scs, native_cycles);
+                            mm_timer_tick(&cfg, native_cycles);
+                            continue;
+                        }
+                    }
 
                     f = mm_fetch_t32_memmap(&cpu, &map, cpu.sec_state);
                     if (f.fault) {
@@ -2139,8 +2604,38 @@ handle_pending:
                         }
                         continue;
                     }
-                    d = mm_decode_t32(&f);
+                    d = mm_predecode_decode(&g_predecode, &f);
                     mm_memmap_set_last_pc(f.pc_fetch);
+                    if (g_jit.enabled && it_remaining == 0u && !opt_gdb && !opt_capstone && !tui_step) {
+                        struct mm_jit_block *blk = mm_jit_lookup(&g_jit, &cpu, f.pc_fetch);
+                        /* Only where the interpreter would not take an exception
+                         * before the block ends: nothing pending after this
+                         * instruction's cycle and no SysTick fire, SoC timer
+                         * event or --sync quantum end inside it.
+                         */
+                        if (blk != 0 && !scs.pend_st && !scs.pend_sv && mm_nvic_select(&nvic, &cpu) < 0 &&
+                            (mm_u64)(blk->insns - 1u) <=
+                                cycles_until_deadline(&scs, &cfg, sync_path != 0, vcycles, sync_limit)) {
+                            mm_u32 retired = mm_jit_exec(&g_jit, &cpu, blk);
+                            if (retired != 0u) {
+                                /* The first instruction's cycle was charged above. */
+                                retired--;
+                                cycles_since_poll += retired;
+                                cycle_total += retired;
+                                vcycles += retired;
+                                mm_scs_systick_advance(&scs, retired);
+                                mm_timer_tick(&cfg, retired);
+                                if (g_jit.last != 0) {
+                                    d = *g_jit.last;
+                                    f.pc_fetch = g_jit.last_pc;
+                                }
+                                goto jit_retired;
+                            }
+                        }
+                    }
+                    if (g_trace_on) {
+                        mm_trace_insn(&g_trace, &cpu, f.pc_fetch, f.insn, f.len);
+                    }
                     if (opt_pc_trace) {
                         mm_u32 pc = f.pc_fetch | 1u;
                         if (pc >= pc_trace_start && pc <= pc_trace_end) {
@@ -2326,6 +2821,7 @@ handle_pending:
                         exec_ctx.dec = &d;
                         exec_ctx.opt_dump = opt_dump;
                         exec_ctx.opt_gdb = opt_gdb;
+                        exec_ctx.semihost = &g_semihost;
                         exec_ctx.it_pattern = &it_pattern;
                         exec_ctx.it_remaining = &it_remaining;
                         exec_ctx.it_cond = &it_cond;
@@ -2338,7 +2834,8 @@ handle_pending:
                         if (mm_execute_decoded(&exec_ctx) == MM_EXEC_CONTINUE) {
                             continue;
                         }
-                        if (opt_tui && !opt_gdb && done && d.kind == MM_OP_BKPT) {
+                        if (opt_tui && !opt_gdb && done && d.kind == MM_OP_BKPT &&
+                            !g_semihost.exit_requested) {
                             done = MM_FALSE;
                             tui_paused = MM_TRUE;
                             tui_step = MM_FALSE;
@@ -2359,13 +2856,60 @@ handle_pending:
                         raw = itstate_advance(raw);
                         cpu.xpsr = itstate_set(cpu.xpsr, raw);
                     }
+
+                    /* Run the second half of a fused pair without a trip around
+                     * the main loop, unless that trip would have done something:
+                     * take an exception, poll peripherals, reset or stop for the
+                     * debugger (GDB and TUI stepping always see single insns).
+                     */
+                    if (g_fuse.enabled && !fused && !done && !opt_gdb && !tui_step && !cpu.sleeping &&
+                        (cpu.r[15] & ~1u) == f.pc_fetch + d.len) {
+                        enum mm_fuse_kind fk = mm_fuse_pair_at(&d, &g_predecode, f.pc_fetch + d.len);
+                        if (fk != MM_FUSE_NONE && cycles_since_poll < poll_granularity &&
+                            !scs.pend_st && !scs.pend_sv && mm_nvic_select(&nvic, &cpu) < 0 &&
+                            !g_fault_pending && !mm_system_reset_pending()) {
+                            const mm_u32 next_pc = f.pc_fetch + d.len;
+                            const struct mm_decoded *nd = mm_predecode_peek(&g_predecode, next_pc);
+                            g_fuse.pairs[fk]++;
+                            fused = MM_TRUE;
+                            if (it_remaining != 0u || g_trace_on || opt_pc_trace || opt_strcmp_trace ||
+                                opt_capstone || opt_dump || g_intercept.enabled ||
+                                !mm_fuse_can_direct(fk, &map, nd, f.pc_fetch, next_pc)) {
+                                goto fuse_second;
+                            }
+                            cycles_since_poll += insn_cycles;
+                            cycle_total += insn_cycles;
+                            vcycles += insn_cycles;
+                            mm_scs_systick_advance(&scs, insn_cycles);
+                            mm_timer_tick(&cfg, insn_cycles);
+                            if (g_profile.enabled && cycle_total >= g_profile.next_sample) {
+                                mm_profile_sample(&g_profile, &cpu, &map, cycle_total);
+                            }
+                            mm_fuse_exec_direct(&cpu, nd, next_pc);
+                            mm_memmap_set_last_pc(next_pc);
+                            d = *nd;
+                            f.pc_fetch = next_pc;
+                            f.insn = nd->raw;
+                            f.len = nd->len;
+                        }
+                    }
+
+jit_retired:
+                    /* Fast-forward a polling loop that provably made no progress;
+                     * applied below, once host input has been polled. */
+                    if (g_busywait.enabled && !tui_step && it_remaining == 0u &&
+                        (cpu.r[15] & ~1u) <= f.pc_fetch) {
+                        idle_skip = mm_busywait_backedge(&g_busywait, &cpu, &map, &d, f.pc_fetch);
+                    }
                 }
 
-                if (cycles_since_poll >= poll_granularity) {
+                if (cycles_since_poll >= poll_granularity || idle_skip != 0u) {
                     mm_target_usart_poll(&cfg);
                     mm_target_spi_poll(&cfg);
+                    mm_eth_backend_set_now(vns_base + deadline_ns(vcycles, 0, cpu_hz), cycle_total);
                     mm_target_eth_poll(&cfg);
                     mm_usbdev_poll();
+                    mm_itm_sink_poll(&g_itm, vcycles, MM_FALSE);
                     update_tui_steps_latched(opt_gdb, &gdb, tui_paused, tui_step, cycle_total,
                                              &tui_steps_offset, &tui_steps_latched);
                     if (handle_tui(&tui, opt_tui, &opt_capstone, &opt_gdb, &gdb, cpu_name, gdb_symbols, &cpu, &map, cycle_total, &tui_steps_offset, &tui_steps_latched, &tui_paused, &tui_step, &reload_pending, gdb_port)) {
@@ -2373,9 +2917,61 @@ handle_pending:
                         continue;
                     }
                     cycles_since_poll = 0;
+                    if (replay_mode == MM_REPLAY_PLAY && mm_replay_finished()) {
+                        done = MM_TRUE;
+                        continue;
+                    }
                 }
 
-                host_sync_if_needed(vcycles, &vcycles_last_sync, host0_ns, sync_granularity, cpu_hz);
+                if (idle_skip != 0u) {
+                    /* Input that arrived before the skip may already have
+                     * raised an interrupt; otherwise stop at the first timer,
+                     * SysTick or sync deadline so no event lands late. */
+                    mm_u64 skip = 0u;
+                    if (!scs.pend_st && !scs.pend_sv && !g_fault_pending &&
+                        mm_nvic_select(&nvic, &cpu) < 0) {
+                        skip = cycles_until_deadline(&scs, &cfg, sync_path != 0, vcycles, sync_limit);
+                        if (skip > idle_skip) {
+                            skip = idle_skip;
+                        }
+                    }
+                    idle_skip = 0u;
+                    if (skip != 0u) {
+                        /* Paced runs spend the skipped span waiting on the
+                         * backend fds, as WFI does, and stop at the host time
+                         * input arrives so the guest does not see it late. */
+                        const mm_u64 full_skip = skip;
+                        if (replay_mode == MM_REPLAY_PLAY) {
+                            (void)mm_replay_take_u64(MM_REPLAY_IDLE, 0, &skip);
+                        } else if (pace != 0) {
+                            mm_u64 due_ns = deadline_ns(vcycles + skip, host0_ns, cpu_hz);
+                            mm_u64 now_ns = host_now_ns();
+                            if (now_ns < due_ns && mm_hostwait_block(due_ns - now_ns)) {
+                                mm_u64 reached = host_ns_to_vcycles(host_now_ns(), host0_ns, cpu_hz);
+                                mm_u64 step = (reached > vcycles) ? (reached - vcycles) : 0u;
+                                if (step < skip) {
+                                    skip = step;
+                                }
+                            }
+                        }
+                        if (skip != full_skip) {
+                            mm_replay_put_u64(MM_REPLAY_IDLE, 0, skip);
+                        }
+                    }
+                    if (skip != 0u) {
+                        mm_scs_systick_advance(&scs, skip);
+                        mm_timer_tick(&cfg, skip);
+                        vcycles += skip;
+                        cycle_total += skip;
+                        cycles_since_poll += skip;
+                        if (g_profile.enabled && cycle_total >= g_profile.next_sample) {
+                            mm_profile_sample(&g_profile, &cpu, &map, cycle_total);
+                        }
+                        mm_busywait_skipped(&g_busywait, skip);
+                    }
+                }
+
+                host_sync_if_needed(vcycles, pace, host0_ns, sync_granularity, cpu_hz);
 
                 if (mm_system_reset_pending()) {
                     reset_again = MM_TRUE;
@@ -2383,7 +2979,7 @@ handle_pending:
                     break;
                 }
                 if (opt_gdb) {
-                    mm_gdb_stub_maybe_rearm(&gdb, &map, cpu.sec_state, cpu.r[15]);
+                    mm_gdb_stub_maybe_rearm(&gdb, cpu.r[15]);
                     if (mm_gdb_stub_should_step(&gdb)) {
                         mm_gdb_stub_notify_stop(&gdb, 5);
                         continue;
@@ -2395,8 +2991,12 @@ handle_pending:
                 }
             }
             if (reset_again) {
+                vns_base += deadline_ns(vcycles, 0, cpu_hz);
+                cycle_base += cycle_total;
                 continue;
             }
+            /* Freeze the log clock: cycle_total goes out of scope here. */
+            mm_replay_bind_clock(0, cycle_base + cycle_total);
             if (!opt_gdb) {
                 mm_u64 wraps = mm_scs_systick_wrap_count(&scs);
                 double avg_cycles_per_wrap = (wraps > 0u) ? ((double)cycle_total / (double)wraps) : 0.0;
@@ -2410,17 +3010,49 @@ handle_pending:
                            avg_cycles_per_wrap);
                 }
             }
+            if (g_semihost.exit_requested) {
+                rc = g_semihost.exit_code;
+            }
             break;
         }
     }
 
 cleanup:
+    mm_itm_sink_close(&g_itm);
+    if (g_trace_on) {
+        mm_memmap_set_write_observer(0, 0);
+        mm_trace_close(&g_trace);
+        g_trace_on = MM_FALSE;
+    }
+    if (g_profile.enabled) {
+        if (mm_profile_write(&g_profile, opt_profile)) {
+            fprintf(stderr, "[PROFILE] %llu samples written to %s and %s.txt\n",
+                    (unsigned long long)g_profile.total_samples, opt_profile, opt_profile);
+        } else {
+            fprintf(stderr, "[PROFILE] failed to write %s\n", opt_profile);
+        }
+        mm_profile_free(&g_profile);
+    }
+    mm_semihost_reset(&g_semihost);
+    if (g_intercept.enabled) {
+        mm_intercept_report(&g_intercept);
+    }
+    mm_intercept_free(&g_intercept);
+    mm_busywait_report(&g_busywait);
+    mm_memmap_set_code_observer(0, 0);
+    mm_jit_report(&g_jit);
+    mm_jit_free(&g_jit);
+    mm_predecode_free(&g_predecode);
     mm_spiflash_shutdown_all();
 #ifdef M33MU_HAS_LIBTPMS
     mm_tpm_tis_shutdown_all();
 #endif
+    mm_vsync_close(&g_vsync);
+    mm_replay_close();
     mm_usbdev_stop();
     mm_eth_backend_stop();
+    mm_eth_capture_close();
+    mm_reactor_stop();
     if (opt_capstone) {
         capstone_shutdown();
     }
@@ -20,13 +20,19 @@
  */
 
 #include "m33mu/memmap.h"
+#include "m33mu/dma.h"
 #include <stdio.h>
+#include <string.h>
 
 static mm_bool g_memwatch_enabled = MM_FALSE;
 static mm_u32 g_memwatch_addr = 0;
 static mm_u32 g_memwatch_size = 0;
 static mm_u32 g_memwatch_pc = 0;
 static struct mm_memmap *g_current_map = 0;
+static mm_memmap_write_observer g_write_observer = 0;
+static void *g_write_observer_opaque = 0;
+static mm_memmap_code_observer g_code_observer = 0;
+static void *g_code_observer_opaque = 0;
 
 static mm_bool read_buf_le(const mm_u8 *buf, mm_u32 offset, mm_u32 size, mm_u32 *value_out)
 {
@@ -104,6 +110,21 @@ static mm_bool ram_offset_for_addr(const struct mm_memmap *map, mm_u32 addr, mm_
     return MM_FALSE;
 }
 
+static const mm_u8 *rom_ptr_for_range(const struct mm_memmap *map, mm_u32 addr, mm_u32 len)
+{
+    mm_u32 i;
+    for (i = 0; i < map->rom_count; ++i) {
+        const struct mm_memmap_rom *r = &map->rom[i];
+        if (addr >= r->base && (mm_u64)(addr - r->base) + len <= r->size) {
+            if (r->locked != 0 && *r->locked) {
+                return 0;
+            }
+            return r->buffer + (addr - r->base);
+        }
+    }
+    return 0;
+}
+
 static mm_bool intercept_ok(const struct mm_memmap *map, enum mm_access_type type, enum mm_sec_state sec, mm_u32 addr, mm_u32 size)
 {
     if (map->interceptor == 0) {
@@ -139,6 +160,7 @@ void mm_memmap_init(struct mm_memmap *map, struct mmio_region *regions, size_t r
     map->flash_size_s = map->flash_size_ns = 0;
     map->ram_base_s = map->ram_base_ns = 0;
     map->ram_size_s = map->ram_size_ns = 0;
+    map->rom_count = 0;
     g_current_map = map;
 }
 
@@ -216,6 +238,23 @@ mm_bool mm_memmap_configure_ram(struct mm_memmap *map, const struct mm_target_cf
     return MM_TRUE;
 }
 
+mm_bool mm_memmap_add_rom(struct mm_memmap *map, mm_u32 base, mm_u32 size, const mm_u8 *buffer, const mm_bool *locked)
+{
+    struct mm_memmap_rom *r;
+    if (map == 0 || buffer == 0 || size == 0u) {
+        return MM_FALSE;
+    }
+    if (map->rom_count >= MM_MEMMAP_ROM_MAX || (mm_u64)base + size > 0x100000000ull) {
+        return MM_FALSE;
+    }
+    r = &map->rom[map->rom_count++];
+    r->base = base;
+    r->size = size;
+    r->buffer = buffer;
+    r->locked = locked;
+    return MM_TRUE;
+}
+
 mm_bool mm_memmap_read(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 size, mm_u32 *value_out)
 {
     mm_u32 base;
@@ -260,6 +299,11 @@ mm_bool mm_memmap_read(const struct mm_memmap *map, enum mm_sec_state sec, mm_u3
             if (read_buf_le(map->ram.buffer, offset, size, &tmp)) { *value_out = tmp; return MM_TRUE; }
         }
     }
+    /* Read-only backings (XIP) */
+    if (map->rom_count != 0u) {
+        const mm_u8 *p = rom_ptr_for_range(map, addr, size);
+        if (p != 0 && read_buf_le(p, 0, size, &tmp)) { *value_out = tmp; return MM_TRUE; }
+    }
     /* MMIO */
     mmio_set_active_sec(sec);
     return mmio_bus_read(&map->mmio, addr, size, value_out);
@@ -284,7 +328,26 @@ void mm_memmap_set_last_pc(mm_u32 pc)
     g_memwatch_pc = pc;
 }
 
-mm_bool mm_memmap_write(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 size, mm_u32 value)
+void mm_memmap_set_write_observer(mm_memmap_write_observer fn, void *opaque)
+{
+    g_write_observer = fn;
+    g_write_observer_opaque = opaque;
+}
+
+void mm_memmap_set_code_observer(mm_memmap_code_observer fn, void *opaque)
+{
+    g_code_observer = fn;
+    g_code_observer_opaque = opaque;
+}
+
+void mm_memmap_code_changed(mm_u32 addr, mm_u32 len)
+{
+    if (g_code_observer != 0 && len != 0u) {
+        g_code_observer(g_code_observer_opaque, addr, len);
+    }
+}
+
+static mm_bool memmap_store(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 size, mm_u32 value)
 {
     mm_u32 base;
     mm_u32 size_limit;
@@ -359,6 +422,18 @@ mm_bool mm_memmap_write(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 add
     return MM_FALSE;
 }
 
+mm_bool mm_memmap_write(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 size, mm_u32 value)
+{
+    if (!memmap_store(map, sec, addr, size, value)) {
+        return MM_FALSE;
+    }
+    /* Only committed stores are reported; faulting or rejected writes are not. */
+    if (g_write_observer != 0) {
+        g_write_observer(g_write_observer_opaque, addr, size, value);
+    }
+    return MM_TRUE;
+}
+
 mm_bool mm_memmap_fetch_read16(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 *value_out)
 {
     mm_u32 base;
@@ -406,6 +481,14 @@ mm_bool mm_memmap_fetch_read16(const struct mm_memmap *map, enum mm_sec_state se
             return MM_FALSE;
         }
     }
+    /* Execute in place from read-only backings. */
+    if (map->rom_count != 0u) {
+        const mm_u8 *p = rom_ptr_for_range(map, addr, 2u);
+        if (p != 0) {
+            *value_out = (mm_u32)p[0] | ((mm_u32)p[1] << 8);
+            return MM_TRUE;
+        }
+    }
     return MM_FALSE;
 }
 
@@ -448,6 +531,13 @@ mm_bool mm_memmap_read8(const struct mm_memmap *map, enum mm_sec_state sec, mm_u
             return MM_TRUE;
         }
     }
+    if (map->rom_count != 0u) {
+        const mm_u8 *p = rom_ptr_for_range(map, addr, 1u);
+        if (p != 0) {
+            *value_out = *p;
+            return MM_TRUE;
+        }
+    }
     {
         mm_u32 tmp;
         if (mmio_bus_read(&map->mmio, addr, 1u, &tmp)) {
@@ -481,3 +571,185 @@ mm_bool mm_memmap_write8(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 ad
     }
     return MM_FALSE;
 }
+
+static const mm_u8 *flash_ptr_for_range(const struct mm_memmap *map, mm_u32 addr, mm_u32 len)
+{
+    mm_u32 base;
+    mm_u32 size_limit;
+    if (map->flash.buffer == 0) {
+        return 0;
+    }
+    base = map->flash_base_s;
+    size_limit = map->flash_size_s;
+    if (size_limit == 0u && map->flash.length > 0u) {
+        base = map->flash.base;
+        size_limit = (mm_u32)map->flash.length;
+    }
+    if (addr >= base && (mm_u64)(addr - base) + len <= size_limit) {
+        return map->flash.buffer + (addr - base);
+    }
+    base = map->flash_base_ns;
+    size_limit = map->flash_size_ns;
+    if (size_limit == 0u && map->flash.length > 0u) {
+        base = map->flash.base;
+        size_limit = (mm_u32)map->flash.length;
+    }
+    if (addr >= base && (mm_u64)(addr - base) + len <= size_limit) {
+        return map->flash.buffer + (addr - base);
+    }
+    return 0;
+}
+
+const mm_u8 *mm_memmap_host_read_ptr(const struct mm_memmap *map, mm_u32 addr, mm_u32 len)
+{
+    const mm_u8 *p;
+    if (map == 0 || len == 0u) {
+        return 0;
+    }
+    p = flash_ptr_for_range(map, addr, len);
+    if (p != 0) {
+        return p;
+    }
+    p = mm_memmap_host_write_ptr(map, addr, len);
+    if (p != 0) {
+        return p;
+    }
+    return rom_ptr_for_range(map, addr, len);
+}
+
+mm_u8 *mm_memmap_host_write_ptr(const struct mm_memmap *map, mm_u32 addr, mm_u32 len)
+{
+    mm_u32 offset = 0;
+    if (map == 0 || len == 0u || map->ram.buffer == 0) {
+        return 0;
+    }
+    if ((mm_u64)addr + len > 0x100000000ull) {
+        return 0;
+    }
+    /* ram_offset_for_addr() also accepts raw offsets; never alias flash. */
+    if (flash_ptr_for_range(map, addr, 1u) != 0 || rom_ptr_for_range(map, addr, 1u) != 0) {
+        return 0;
+    }
+    if (!ram_offset_for_addr(map, addr, len, &offset)) {
+        return 0;
+    }
+    return (mm_u8 *)map->ram.buffer + offset;
+}
+
+mm_bool mm_memmap_access_ok(const struct mm_memmap *map, enum mm_access_type type, enum mm_sec_state sec, mm_u32 addr, mm_u32 len)
+{
+    mm_u64 cur = addr;
+    mm_u64 end = (mm_u64)addr + len;
+    if (map == 0) {
+        return MM_FALSE;
+    }
+    if (end > 0x100000000ull) {
+        return MM_FALSE;
+    }
+    while (cur < end) {
+        mm_u64 chunk = MM_MEMMAP_PROT_GRANULE - (cur & (MM_MEMMAP_PROT_GRANULE - 1u));
+        if (chunk > end - cur) {
+            chunk = end - cur;
+        }
+        if (!intercept_ok(map, type, sec, (mm_u32)cur, (mm_u32)chunk)) {
+            return MM_FALSE;
+        }
+        cur += chunk;
+    }
+    return MM_TRUE;
+}
+
+const mm_u8 *mm_memmap_guest_read_ptr(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 len)
+{
+    const mm_u8 *p = mm_memmap_host_read_ptr(map, addr, len);
+    if (p == 0 || !mm_memmap_access_ok(map, MM_ACCESS_READ, sec, addr, len)) {
+        return 0;
+    }
+    return p;
+}
+
+mm_u8 *mm_memmap_guest_write_ptr(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 len)
+{
+    mm_u8 *p = mm_memmap_host_write_ptr(map, addr, len);
+    if (p == 0 || !mm_memmap_access_ok(map, MM_ACCESS_WRITE, sec, addr, len)) {
+        return 0;
+    }
+    return p;
+}
+
+mm_bool mm_memmap_read_is_pure(const struct mm_memmap *map, mm_u32 addr, mm_u32 len)
+{
+    if (map == 0 || len == 0u) {
+        return MM_FALSE;
+    }
+    if (mm_memmap_host_read_ptr(map, addr, len) != 0) {
+        return MM_TRUE;
+    }
+    return mmio_bus_read_is_pure(&map->mmio, addr, len);
+}
+
+static mm_u8 *dma_resolve(void *opaque, mm_u32 addr, size_t length_bytes, mm_bool write_direction)
+{
+    const struct mm_memmap *map = (opaque != 0) ? (const struct mm_memmap *)opaque : g_current_map;
+    if (length_bytes > 0xFFFFFFFFu) {
+        return 0;
+    }
+    if (write_direction) {
+        return mm_memmap_host_write_ptr(map, addr, (mm_u32)length_bytes);
+    }
+    return (mm_u8 *)mm_memmap_host_read_ptr(map, addr, (mm_u32)length_bytes);
+}
+
+static mm_bool dma_request(void *opaque, mm_u32 addr, void *buffer, size_t length_bytes, mm_bool write_direction)
+{
+    struct mm_memmap *map = (opaque != 0) ? (struct mm_memmap *)opaque : g_current_map;
+    mm_u8 *buf = (mm_u8 *)buffer;
+    mm_u8 *p;
+    if (map == 0) {
+        return MM_FALSE;
+    }
+    if (length_bytes == 0u) {
+        return MM_TRUE;
+    }
+    p = dma_resolve(map, addr, length_bytes, write_direction);
+    if (p != 0) {
+        if (write_direction) {
+            memcpy(p, buf, length_bytes);
+        } else {
+            memcpy(buf, p, length_bytes);
+        }
+        return MM_TRUE;
+    }
+    mmio_set_active_sec((addr & 0x10000000u) != 0u ? MM_SECURE : MM_NONSECURE);
+    while (length_bytes > 0u) {
+        mm_u32 size = (length_bytes >= 4u && (addr & 3u) == 0u) ? 4u :
+                      (length_bytes >= 2u && (addr & 1u) == 0u) ? 2u : 1u;
+        mm_u32 v = 0;
+        mm_u32 i;
+        if (write_direction) {
+            for (i = 0; i < size; ++i) {
+                v |= (mm_u32)buf[i] << (8u * i);
+            }
+            if (!mmio_bus_write(&map->mmio, addr, size, v)) {
+                return MM_FALSE;
+            }
+        } else {
+            if (!mmio_bus_read(&map->mmio, addr, size, &v)) {
+                return MM_FALSE;
+            }
+            for (i = 0; i < size; ++i) {
+                buf[i] = (mm_u8)(v >> (8u * i));
+            }
+        }
+        addr += size;
+        buf += size;
+        length_bytes -= size;
+    }
+    return MM_TRUE;
+}
+
+void mm_memmap_dma_master_init(struct mm_memmap *map, struct mm_dma_master *dma)
+{
+    mm_dma_master_init(dma, dma_request, map);
+    mm_dma_master_set_resolver(dma, dma_resolve);
+}
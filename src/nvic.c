@@ -23,6 +23,7 @@
 #include "m33mu/mmio.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 static int nvic_trace_level(void)
 {
@@ -134,26 +135,30 @@ int mm_nvic_select_routed(const struct mm_nvic *nvic, const struct mm_cpu *cpu,
 {
     mm_u32 best_irq = 0xffffffffu;
     mm_u8 best_prio = 0xffu;
-    mm_u32 irq;
+    mm_u32 word;
 
-    for (irq = 0; irq < MM_MAX_IRQ; ++irq) {
-        mm_u32 word = irq / 32u;
-        mm_u32 bit = irq % 32u;
-        mm_u32 mask = 1u << bit;
-        enum mm_sec_state tsec;
-        if ((nvic->enable_mask[word] & mask) == 0u) {
+    /* Called before every instruction: skip whole words with nothing
+     * both enabled and pending. */
+    for (word = 0; word < (MM_MAX_IRQ + 31u) / 32u; ++word) {
+        mm_u32 live = nvic->enable_mask[word] & nvic->pending_mask[word];
+        mm_u32 bit;
+        if (live == 0u) {
             continue;
         }
-        if ((nvic->pending_mask[word] & mask) == 0u) {
-            continue;
-        }
-        tsec = mm_nvic_irq_target_sec(nvic, irq);
-        if (primask_blocks_target(cpu, tsec)) {
-            continue;
-        }
-        if (best_irq == 0xffffffffu || nvic->priority[irq] < best_prio) {
-            best_prio = nvic->priority[irq];
-            best_irq = irq;
+        for (bit = 0; bit < 32u; ++bit) {
+            mm_u32 irq = word * 32u + bit;
+            enum mm_sec_state tsec;
+            if ((live & (1u << bit)) == 0u || irq >= MM_MAX_IRQ) {
+                continue;
+            }
+            tsec = mm_nvic_irq_target_sec(nvic, irq);
+            if (primask_blocks_target(cpu, tsec)) {
+                continue;
+            }
+            if (best_irq == 0xffffffffu || nvic->priority[irq] < best_prio) {
+                best_prio = nvic->priority[irq];
+                best_irq = irq;
+            }
         }
     }
     if (best_irq == 0xffffffffu) {
@@ -252,6 +257,7 @@ mm_bool mm_nvic_register_mmio(struct mm_nvic *nvic, struct mmio_bus *bus)
     struct mmio_region reg;
 
     ctx.nvic = nvic;
+    memset(&reg, 0, sizeof(reg));
     reg.base = 0xE000E400u;
     reg.size = 0x100u;
     reg.opaque = &ctx;
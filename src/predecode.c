@@ -0,0 +1,316 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "m33mu/predecode.h"
+
+#define MM_PREDECODE_MAGIC 0x4344504du /* "MPDC" */
+#define MM_PREDECODE_VERSION 1u
+
+struct mm_predecode_header {
+    mm_u32 magic;
+    mm_u32 version;
+    mm_u32 entry_size;
+    mm_u32 base_s;
+    mm_u32 base_ns;
+    mm_u32 size;
+    mm_u64 image_hash;
+    mm_u64 exe_size;
+    mm_u64 exe_mtime;
+};
+
+static mm_u64 fnv1a(mm_u64 h, const mm_u8 *p, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static mm_u64 image_hash(const mm_u8 *flash, size_t size)
+{
+    return fnv1a(0xcbf29ce484222325ull, flash, size);
+}
+
+/* The cached entries are the decoder's output, so any rebuild of the
+ * emulator must invalidate them. */
+static mm_bool exe_fingerprint(mm_u64 *size, mm_u64 *mtime)
+{
+    struct stat st;
+    if (stat("/proc/self/exe", &st) != 0) {
+        return MM_FALSE;
+    }
+    *size = (mm_u64)st.st_size;
+    *mtime = (mm_u64)st.st_mtime;
+    return MM_TRUE;
+}
+
+static struct mm_decoded decode_at(const mm_u8 *flash, size_t size, size_t off)
+{
+    struct mm_fetch_result f;
+    mm_u16 hw1;
+    hw1 = (mm_u16)(flash[off] | ((mm_u16)flash[off + 1u] << 8));
+    f.fault = MM_FALSE;
+    f.fault_addr = 0;
+    f.pc_fetch = 0;
+    if (t32_is_32bit_prefix(hw1)) {
+        mm_u16 hw2;
+        if (off + 4u > size) {
+            struct mm_decoded empty;
+            memset(&empty, 0, sizeof(empty));
+            return empty;
+        }
+        hw2 = (mm_u16)(flash[off + 2u] | ((mm_u16)flash[off + 3u] << 8));
+        f.insn = ((mm_u32)hw1 << 16) | hw2;
+        f.len = 4;
+    } else {
+        f.insn = hw1;
+        f.len = 2;
+    }
+    return mm_decode_t32(&f);
+}
+
+void mm_predecode_init(struct mm_predecode *pd)
+{
+    memset(pd, 0, sizeof(*pd));
+}
+
+void mm_predecode_free(struct mm_predecode *pd)
+{
+    free(pd->table);
+    pd->table = 0;
+    pd->size = 0;
+    pd->enabled = MM_FALSE;
+}
+
+static mm_bool predecode_alloc(struct mm_predecode *pd, size_t size, mm_u32 base_s, mm_u32 base_ns)
+{
+    size_t count;
+    mm_predecode_free(pd);
+    size &= ~(size_t)1u;
+    if (size == 0u || size > 0xffffffffu) {
+        return MM_FALSE;
+    }
+    count = size / 2u;
+    pd->table = (struct mm_decoded *)calloc(count, sizeof(struct mm_decoded));
+    if (pd->table == 0) {
+        return MM_FALSE;
+    }
+    pd->size = (mm_u32)size;
+    pd->base_s = base_s;
+    pd->base_ns = base_ns;
+    return MM_TRUE;
+}
+
+mm_bool mm_predecode_build(struct mm_predecode *pd, const mm_u8 *flash, size_t size,
+                           mm_u32 base_s, mm_u32 base_ns)
+{
+    size_t off;
+    if (flash == 0 || !predecode_alloc(pd, size, base_s, base_ns)) {
+        return MM_FALSE;
+    }
+    for (off = 0; off < pd->size; off += 2u) {
+        pd->table[off / 2u] = decode_at(flash, pd->size, off);
+    }
+    pd->enabled = MM_TRUE;
+    return MM_TRUE;
+}
+
+struct mm_decoded mm_predecode_decode(struct mm_predecode *pd, const struct mm_fetch_result *f)
+{
+    mm_u32 off;
+    struct mm_decoded *e;
+    if (!pd->enabled || f->fault) {
+        return mm_decode_t32(f);
+    }
+    off = f->pc_fetch - pd->base_s;
+    if (off >= pd->size) {
+        off = f->pc_fetch - pd->base_ns;
+        if (off >= pd->size) {
+            return mm_decode_t32(f);
+        }
+    }
+    e = &pd->table[off >> 1];
+    if (e->raw == f->insn && e->len == f->len) {
+        pd->hits++;
+        return *e;
+    }
+    pd->misses++;
+    *e = mm_decode_t32(f);
+    return *e;
+}
+
+const struct mm_decoded *mm_predecode_peek(const struct mm_predecode *pd, mm_u32 addr)
+{
+    mm_u32 off;
+    const struct mm_decoded *e;
+    if (!pd->enabled) {
+        return 0;
+    }
+    off = addr - pd->base_s;
+    if (off >= pd->size) {
+        off = addr - pd->base_ns;
+        if (off >= pd->size) {
+            return 0;
+        }
+    }
+    e = &pd->table[off >> 1];
+    return e->len != 0u ? e : 0;
+}
+
+static void predecode_clear(struct mm_predecode *pd, mm_u32 base, mm_u32 addr, mm_u32 len)
+{
+    mm_u32 lo;
+    mm_u32 hi;
+    mm_u64 end = (mm_u64)addr + len;
+    if (end <= base || addr >= base + pd->size) {
+        return;
+    }
+    /* A 32-bit instruction starting one halfword earlier covers addr too. */
+    lo = (addr > base + 2u) ? (addr - base - 2u) >> 1 : 0u;
+    hi = (end - base >= pd->size) ? pd->size >> 1 : (mm_u32)((end - base + 1u) >> 1);
+    memset(&pd->table[lo], 0, (size_t)(hi - lo) * sizeof(pd->table[0]));
+}
+
+void mm_predecode_invalidate(struct mm_predecode *pd, mm_u32 addr, mm_u32 len)
+{
+    if (!pd->enabled || len == 0u) {
+        return;
+    }
+    predecode_clear(pd, pd->base_s, addr, len);
+    if (pd->base_ns != pd->base_s) {
+        predecode_clear(pd, pd->base_ns, addr, len);
+    }
+}
+
+mm_bool mm_predecode_cache_path(char *out, size_t out_len, const char *dir,
+                                const mm_u8 *flash, size_t size, const char *cpu_name)
+{
+    mm_u64 h;
+    int n;
+    if (out == 0 || dir == 0 || flash == 0) {
+        return MM_FALSE;
+    }
+    h = image_hash(flash, size);
+    if (cpu_name != 0) {
+        h = fnv1a(h, (const mm_u8 *)cpu_name, strlen(cpu_name));
+    }
+    n = snprintf(out, out_len, "%s/%016llx.pdc", dir, (unsigned long long)h);
+    return (n > 0 && (size_t)n < out_len) ? MM_TRUE : MM_FALSE;
+}
+
+static void fill_header(struct mm_predecode_header *h, mm_u32 base_s, mm_u32 base_ns,
+                        mm_u32 size, const mm_u8 *flash)
+{
+    memset(h, 0, sizeof(*h));
+    h->magic = MM_PREDECODE_MAGIC;
+    h->version = MM_PREDECODE_VERSION;
+    h->entry_size = (mm_u32)sizeof(struct mm_decoded);
+    h->base_s = base_s;
+    h->base_ns = base_ns;
+    h->size = size;
+    h->image_hash = image_hash(flash, size);
+}
+
+mm_bool mm_predecode_load(struct mm_predecode *pd, const char *path, const mm_u8 *flash,
+                          size_t size, mm_u32 base_s, mm_u32 base_ns)
+{
+    struct mm_predecode_header want;
+    struct mm_predecode_header got;
+    FILE *fp;
+    size_t count;
+    if (path == 0 || flash == 0) {
+        return MM_FALSE;
+    }
+    size &= ~(size_t)1u;
+    if (size == 0u || size > 0xffffffffu) {
+        return MM_FALSE;
+    }
+    fill_header(&want, base_s, base_ns, (mm_u32)size, flash);
+    if (!exe_fingerprint(&want.exe_size, &want.exe_mtime)) {
+        return MM_FALSE;
+    }
+    fp = fopen(path, "rb");
+    if (fp == 0) {
+        return MM_FALSE;
+    }
+    if (fread(&got, sizeof(got), 1, fp) != 1 || memcmp(&got, &want, sizeof(got)) != 0) {
+        fclose(fp);
+        return MM_FALSE;
+    }
+    if (!predecode_alloc(pd, size, base_s, base_ns)) {
+        fclose(fp);
+        return MM_FALSE;
+    }
+    count = pd->size / 2u;
+    if (fread(pd->table, sizeof(struct mm_decoded), count, fp) != count) {
+        fclose(fp);
+        mm_predecode_free(pd);
+        return MM_FALSE;
+    }
+    fclose(fp);
+    pd->enabled = MM_TRUE;
+    return MM_TRUE;
+}
+
+mm_bool mm_predecode_store(const struct mm_predecode *pd, const char *path, const mm_u8 *flash)
+{
+    struct mm_predecode_header h;
+    char tmp[4096];
+    FILE *fp;
+    size_t count;
+    int n;
+    if (pd == 0 || !pd->enabled || path == 0 || flash == 0) {
+        return MM_FALSE;
+    }
+    fill_header(&h, pd->base_s, pd->base_ns, pd->size, flash);
+    if (!exe_fingerprint(&h.exe_size, &h.exe_mtime)) {
+        return MM_FALSE;
+    }
+    /* Write aside and rename so a concurrent run never sees a torn file. */
+    n = snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    if (n <= 0 || (size_t)n >= sizeof(tmp)) {
+        return MM_FALSE;
+    }
+    fp = fopen(tmp, "wb");
+    if (fp == 0) {
+        return MM_FALSE;
+    }
+    count = pd->size / 2u;
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+        fwrite(pd->table, sizeof(struct mm_decoded), count, fp) != count) {
+        fclose(fp);
+        remove(tmp);
+        return MM_FALSE;
+    }
+    if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+        remove(tmp);
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
@@ -0,0 +1,414 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/profile.h"
+#include "m33mu/vector.h"
+
+/* Pseudo-frame keys for active exceptions; this range is never executable. */
+#define PROFILE_EXC_TAG 0xFFFFFE00u
+
+struct profile_func {
+    mm_u32 key;
+    mm_bool used;
+    mm_u64 self;
+    mm_u64 total;
+};
+
+static mm_bool read32(const struct mm_memmap *map, mm_u32 addr, mm_u32 *out)
+{
+    const mm_u8 *p = mm_memmap_host_read_ptr(map, addr, 4u);
+    if (p == 0) return MM_FALSE;
+    *out = (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+    return MM_TRUE;
+}
+
+static mm_u32 frame_key(const struct mm_profile *p, mm_u32 addr)
+{
+    const struct mm_elfsym *s;
+    if (p->have_syms) {
+        s = mm_elfsym_lookup(&p->syms, addr);
+        if (s != 0) return s->addr;
+    }
+    return addr & ~1u;
+}
+
+static mm_bool is_code(const struct mm_profile *p, const struct mm_memmap *map, mm_u32 addr)
+{
+    if ((addr & 1u) == 0u || addr >= 0xF0000000u) return MM_FALSE;
+    if (p->have_syms) return mm_elfsym_lookup(&p->syms, addr) != 0;
+    return mm_memmap_host_read_ptr(map, addr & ~1u, 2u) != 0;
+}
+
+static void push_frame(mm_u32 *frames, int *depth, mm_u32 key)
+{
+    if (*depth >= MM_PROFILE_MAX_DEPTH) return;
+    if (*depth > 0 && frames[*depth - 1] == key) return;
+    frames[(*depth)++] = key;
+}
+
+/* Walk AAPCS frame records {prev_fp, lr} starting at fp; returns callers, innermost first. */
+static int walk_frames(const struct mm_profile *p, const struct mm_memmap *map,
+                       mm_u32 fp, mm_u32 *out, int max)
+{
+    int n = 0;
+    while (n < max && fp != 0u && (fp & 3u) == 0u) {
+        mm_u32 next_fp;
+        mm_u32 lr;
+        if (!read32(map, fp, &next_fp) || !read32(map, fp + 4u, &lr)) break;
+        if (!is_code(p, map, lr)) break;
+        out[n++] = lr;
+        if (next_fp <= fp) break;
+        fp = next_fp;
+    }
+    return n;
+}
+
+static int capture(const struct mm_profile *p, const struct mm_cpu *cpu,
+                   const struct mm_memmap *map, mm_u32 *frames)
+{
+    int depth = 0;
+    int levels = cpu->exc_depth;
+    int lvl;
+    mm_u32 chain7[MM_PROFILE_MAX_DEPTH];
+    mm_u32 chain11[MM_PROFILE_MAX_DEPTH];
+    const mm_u32 *chain;
+    int n7;
+    int n11;
+    int nchain;
+    int i;
+    mm_u32 pc_key;
+    mm_u32 lr = cpu->r[14];
+
+    if (levels > MM_EXC_STACK_MAX) levels = MM_EXC_STACK_MAX;
+    /* Interrupted contexts, outermost first, each followed by the exception taken. */
+    for (lvl = 0; lvl < levels; ++lvl) {
+        mm_u32 sp = cpu->exc_sp[lvl];
+        mm_u32 ret_lr = 0;
+        mm_u32 ret_pc = 0;
+        mm_u32 exc;
+        mm_u32 xpsr = cpu->xpsr;
+        if (read32(map, sp + 20u, &ret_lr) && read32(map, sp + 24u, &ret_pc)) {
+            if (is_code(p, map, ret_lr) && frame_key(p, ret_lr) != frame_key(p, ret_pc)) {
+                push_frame(frames, &depth, frame_key(p, ret_lr));
+            }
+            push_frame(frames, &depth, frame_key(p, ret_pc));
+        }
+        if (lvl + 1 < levels) {
+            (void)read32(map, cpu->exc_sp[lvl + 1] + 28u, &xpsr);
+        }
+        exc = xpsr & 0x1ffu;
+        push_frame(frames, &depth, PROFILE_EXC_TAG | exc);
+    }
+
+    /* Current context: frame-record chain, then LR for leaf functions, then PC. */
+    n7 = walk_frames(p, map, cpu->r[7], chain7, MM_PROFILE_MAX_DEPTH);
+    n11 = walk_frames(p, map, cpu->r[11], chain11, MM_PROFILE_MAX_DEPTH);
+    chain = (n11 > n7) ? chain11 : chain7;
+    nchain = (n11 > n7) ? n11 : n7;
+    pc_key = frame_key(p, cpu->r[15] | 1u);
+    for (i = nchain - 1; i >= 0; --i) {
+        push_frame(frames, &depth, frame_key(p, chain[i]));
+    }
+    if (is_code(p, map, lr) && frame_key(p, lr) != pc_key) {
+        push_frame(frames, &depth, frame_key(p, lr));
+    }
+    push_frame(frames, &depth, pc_key);
+    return depth;
+}
+
+static mm_u32 hash_frames(const mm_u32 *frames, int depth)
+{
+    mm_u32 h = 2166136261u;
+    int i;
+    for (i = 0; i < depth; ++i) {
+        h ^= frames[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static mm_bool grow_index(struct mm_profile *p)
+{
+    mm_u32 cap = p->index_cap ? p->index_cap * 2u : 1024u;
+    mm_u32 *idx = (mm_u32 *)calloc(cap, sizeof(*idx));
+    mm_u32 i;
+    if (idx == 0) return MM_FALSE;
+    for (i = 0; i < p->stack_count; ++i) {
+        mm_u32 slot = p->stacks[i].hash & (cap - 1u);
+        while (idx[slot] != 0u) slot = (slot + 1u) & (cap - 1u);
+        idx[slot] = i + 1u;
+    }
+    free(p->index);
+    p->index = idx;
+    p->index_cap = cap;
+    return MM_TRUE;
+}
+
+static void record(struct mm_profile *p, const mm_u32 *frames, int depth, mm_u64 weight)
+{
+    mm_u32 h = hash_frames(frames, depth);
+    mm_u32 slot;
+    struct mm_profile_stack *st;
+
+    if ((p->stack_count + 1u) * 2u > p->index_cap && !grow_index(p)) return;
+    slot = h & (p->index_cap - 1u);
+    while (p->index[slot] != 0u) {
+        st = &p->stacks[p->index[slot] - 1u];
+        if (st->hash == h && st->depth == (mm_u32)depth &&
+            memcmp(&p->frames[st->off], frames, (size_t)depth * sizeof(*frames)) == 0) {
+            st->samples += weight;
+            return;
+        }
+        slot = (slot + 1u) & (p->index_cap - 1u);
+    }
+    if (p->stack_count == p->stack_cap) {
+        mm_u32 cap = p->stack_cap ? p->stack_cap * 2u : 256u;
+        struct mm_profile_stack *ns = (struct mm_profile_stack *)realloc(p->stacks, cap * sizeof(*ns));
+        if (ns == 0) return;
+        p->stacks = ns;
+        p->stack_cap = cap;
+    }
+    if (p->frame_len + (mm_u32)depth > p->frame_cap) {
+        mm_u32 cap = p->frame_cap ? p->frame_cap : 4096u;
+        mm_u32 *nf;
+        while (cap < p->frame_len + (mm_u32)depth) cap *= 2u;
+        nf = (mm_u32 *)realloc(p->frames, cap * sizeof(*nf));
+        if (nf == 0) return;
+        p->frames = nf;
+        p->frame_cap = cap;
+    }
+    st = &p->stacks[p->stack_count];
+    st->hash = h;
+    st->off = p->frame_len;
+    st->depth = (mm_u32)depth;
+    st->samples = weight;
+    memcpy(&p->frames[p->frame_len], frames, (size_t)depth * sizeof(*frames));
+    p->frame_len += (mm_u32)depth;
+    p->index[slot] = ++p->stack_count;
+}
+
+void mm_profile_init(struct mm_profile *p)
+{
+    if (p == 0) return;
+    memset(p, 0, sizeof(*p));
+    mm_elfsym_init(&p->syms);
+}
+
+mm_bool mm_profile_start(struct mm_profile *p, mm_u64 period, const char *elf)
+{
+    if (p == 0) return MM_FALSE;
+    mm_profile_free(p);
+    p->period = (period != 0u) ? period : MM_PROFILE_DEFAULT_PERIOD;
+    p->next_sample = p->period;
+    if (elf != 0) {
+        p->have_syms = mm_elfsym_load(&p->syms, elf);
+    }
+    p->enabled = MM_TRUE;
+    return p->have_syms;
+}
+
+void mm_profile_rebase(struct mm_profile *p, mm_u64 now_cycles)
+{
+    if (p == 0 || !p->enabled) return;
+    p->next_sample = now_cycles + p->period;
+}
+
+void mm_profile_sample(struct mm_profile *p, const struct mm_cpu *cpu,
+                       const struct mm_memmap *map, mm_u64 now_cycles)
+{
+    mm_u32 frames[MM_PROFILE_MAX_DEPTH];
+    mm_u64 n;
+    int depth;
+    if (p == 0 || !p->enabled || now_cycles < p->next_sample) return;
+    n = (now_cycles - p->next_sample) / p->period + 1u;
+    p->next_sample += n * p->period;
+    depth = capture(p, cpu, map, frames);
+    if (depth > 0) {
+        record(p, frames, depth, n);
+    }
+    p->total_samples += n;
+}
+
+static const char *exc_name(mm_u32 exc, char *buf, size_t cap)
+{
+    switch (exc) {
+    case MM_VECT_RESET: return "[Reset]";
+    case MM_VECT_NMI: return "[NMI]";
+    case MM_VECT_HARDFAULT: return "[HardFault]";
+    case MM_VECT_MEMMANAGE: return "[MemManage]";
+    case MM_VECT_BUSFAULT: return "[BusFault]";
+    case MM_VECT_USAGEFAULT: return "[UsageFault]";
+    case MM_VECT_SECUREFAULT: return "[SecureFault]";
+    case MM_VECT_SVCALL: return "[SVCall]";
+    case MM_VECT_DEBUGMON: return "[DebugMon]";
+    case MM_VECT_PENDSV: return "[PendSV]";
+    case MM_VECT_SYSTICK: return "[SysTick]";
+    default: break;
+    }
+    if (exc >= 16u) {
+        snprintf(buf, cap, "[IRQ%lu]", (unsigned long)(exc - 16u));
+    } else {
+        snprintf(buf, cap, "[exc%lu]", (unsigned long)exc);
+    }
+    return buf;
+}
+
+static const char *key_name(const struct mm_profile *p, mm_u32 key, char *buf, size_t cap)
+{
+    const struct mm_elfsym *s;
+    if ((key & PROFILE_EXC_TAG) == PROFILE_EXC_TAG) {
+        return exc_name(key & 0x1ffu, buf, cap);
+    }
+    if (p->have_syms) {
+        s = mm_elfsym_lookup(&p->syms, key);
+        if (s != 0 && s->addr == key) return s->name;
+    }
+    snprintf(buf, cap, "0x%08lx", (unsigned long)key);
+    return buf;
+}
+
+static int func_cmp(const void *a, const void *b)
+{
+    const struct profile_func *fa = (const struct profile_func *)a;
+    const struct profile_func *fb = (const struct profile_func *)b;
+    if (fa->self != fb->self) return (fa->self > fb->self) ? -1 : 1;
+    if (fa->total != fb->total) return (fa->total > fb->total) ? -1 : 1;
+    return (fa->key < fb->key) ? -1 : (fa->key > fb->key);
+}
+
+static struct profile_func *func_slot(struct profile_func *tab, mm_u32 cap, mm_u32 key, mm_u32 *count)
+{
+    mm_u32 slot = (key * 2654435761u) & (cap - 1u);
+    while (tab[slot].used) {
+        if (tab[slot].key == key) return &tab[slot];
+        slot = (slot + 1u) & (cap - 1u);
+    }
+    tab[slot].key = key;
+    tab[slot].used = MM_TRUE;
+    (*count)++;
+    return &tab[slot];
+}
+
+static mm_bool write_table(const struct mm_profile *p, const char *path)
+{
+    FILE *f;
+    struct profile_func *tab;
+    mm_u32 cap = 64u;
+    mm_u32 nfunc = 0;
+    mm_u32 i;
+    mm_u32 out = 0;
+    mm_u64 total_cycles = p->total_samples * p->period;
+    char buf[32];
+
+    while (cap < p->frame_len * 2u + 2u) cap *= 2u;
+    tab = (struct profile_func *)calloc(cap, sizeof(*tab));
+    if (tab == 0) return MM_FALSE;
+    for (i = 0; i < p->stack_count; ++i) {
+        const struct mm_profile_stack *st = &p->stacks[i];
+        const mm_u32 *fr = &p->frames[st->off];
+        mm_u32 j;
+        for (j = 0; j < st->depth; ++j) {
+            mm_u32 k;
+            mm_bool seen = MM_FALSE;
+            for (k = 0; k < j; ++k) {
+                if (fr[k] == fr[j]) {
+                    seen = MM_TRUE;
+                    break;
+                }
+            }
+            if (!seen) {
+                func_slot(tab, cap, fr[j], &nfunc)->total += st->samples;
+            }
+        }
+        func_slot(tab, cap, fr[st->depth - 1u], &nfunc)->self += st->samples;
+    }
+    for (i = 0; i < cap; ++i) {
+        if (tab[i].used) tab[out++] = tab[i];
+    }
+    qsort(tab, out, sizeof(*tab), func_cmp);
+
+    f = fopen(path, "w");
+    if (f == 0) {
+        free(tab);
+        return MM_FALSE;
+    }
+    fprintf(f, "# %llu samples, %llu cycles/sample, %llu cycles\n",
+            (unsigned long long)p->total_samples, (unsigned long long)p->period,
+            (unsigned long long)total_cycles);
+    fprintf(f, "# %14s %7s %14s %7s  %s\n", "self_cycles", "self%", "total_cycles", "total%", "function");
+    for (i = 0; i < out; ++i) {
+        double den = (p->total_samples != 0u) ? (double)p->total_samples : 1.0;
+        fprintf(f, "  %14llu %6.2f%% %14llu %6.2f%%  %s\n",
+                (unsigned long long)(tab[i].self * p->period), 100.0 * (double)tab[i].self / den,
+                (unsigned long long)(tab[i].total * p->period), 100.0 * (double)tab[i].total / den,
+                key_name(p, tab[i].key, buf, sizeof(buf)));
+    }
+    fclose(f);
+    free(tab);
+    return MM_TRUE;
+}
+
+mm_bool mm_profile_write(const struct mm_profile *p, const char *path)
+{
+    FILE *f;
+    mm_u32 i;
+    char buf[32];
+    char *table_path;
+    size_t len;
+    mm_bool ok;
+
+    if (p == 0 || !p->enabled || path == 0) return MM_FALSE;
+    f = fopen(path, "w");
+    if (f == 0) return MM_FALSE;
+    /* Folded stacks (flamegraph.pl / speedscope), weighted in cycles. */
+    for (i = 0; i < p->stack_count; ++i) {
+        const struct mm_profile_stack *st = &p->stacks[i];
+        mm_u32 j;
+        for (j = 0; j < st->depth; ++j) {
+            fprintf(f, "%s%s", (j != 0u) ? ";" : "", key_name(p, p->frames[st->off + j], buf, sizeof(buf)));
+        }
+        fprintf(f, " %llu\n", (unsigned long long)(st->samples * p->period));
+    }
+    fclose(f);
+
+    len = strlen(path);
+    table_path = (char *)malloc(len + 5u);
+    if (table_path == 0) return MM_FALSE;
+    memcpy(table_path, path, len);
+    memcpy(table_path + len, ".txt", 5u);
+    ok = write_table(p, table_path);
+    free(table_path);
+    return ok;
+}
+
+void mm_profile_free(struct mm_profile *p)
+{
+    if (p == 0) return;
+    mm_elfsym_free(&p->syms);
+    free(p->stacks);
+    free(p->frames);
+    free(p->index);
+    memset(p, 0, sizeof(*p));
+}
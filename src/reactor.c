@@ -0,0 +1,645 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "m33mu/reactor.h"
+#include "m33mu/ring.h"
+#include "m33mu/hostwait.h"
+
+#define REACTOR_EVENTS 32
+#define REACTOR_KICK_TAG (~(mm_u64)0)
+
+struct mm_chan {
+    mm_bool used;
+    mm_u32 gen;
+    enum mm_chan_kind kind;
+    int fd;
+    int listen_fd;
+    mm_bool has_io;
+    struct mm_chan_io io;
+    struct mm_ring rx;
+    struct mm_ring tx;
+    int state;      /* enum mm_chan_state, shared */
+    int rx_blocked; /* shared: reading paused because rx was full */
+    mm_u64 rx_drops;
+    /* Reactor thread only. */
+    mm_u32 fd_events;
+    mm_bool listen_armed;
+    mm_bool want_out;
+    mm_bool parked;
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_thread;
+static mm_bool g_running = MM_FALSE;
+static int g_stop = 0;
+static int g_epfd = -1;
+static int g_evfd = -1;
+static int g_kicked = 0;
+static struct mm_chan g_chans[MM_REACTOR_MAX_CHANS];
+static mm_u8 g_frame_buf[MM_REACTOR_FRAME_MAX];
+
+static mm_u64 chan_tag(const struct mm_chan *ch, mm_bool listen)
+{
+    mm_u64 idx = (mm_u64)(ch - g_chans);
+    return (idx << 40) | ((listen ? 1ull : 0ull) << 32) | (mm_u64)ch->gen;
+}
+
+static void reactor_kick(void)
+{
+    if (__atomic_exchange_n(&g_kicked, 1, __ATOMIC_ACQ_REL) == 0) {
+        mm_u64 one = 1;
+        (void)write(g_evfd, &one, sizeof(one));
+    }
+}
+
+static mm_u64 mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mm_u64)ts.tv_sec * 1000ull + (mm_u64)ts.tv_nsec / 1000000ull;
+}
+
+static void set_interest(int fd, mm_u32 *cur, mm_u32 want, mm_u64 tag)
+{
+    struct epoll_event ev;
+    if (fd < 0 || *cur == want) {
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = want;
+    ev.data.u64 = tag;
+    if (want == 0u) {
+        (void)epoll_ctl(g_epfd, EPOLL_CTL_DEL, fd, &ev);
+    } else if (*cur == 0u) {
+        (void)epoll_ctl(g_epfd, EPOLL_CTL_ADD, fd, &ev);
+    } else {
+        (void)epoll_ctl(g_epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    *cur = want;
+}
+
+static void chan_update_interest(struct mm_chan *ch)
+{
+    mm_u32 want = 0;
+    mm_u32 listen_cur = ch->listen_armed ? (mm_u32)EPOLLIN : 0u;
+    int state = __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE);
+
+    if (state == MM_CHAN_UP && ch->fd >= 0 && !ch->parked) {
+        if (!__atomic_load_n(&ch->rx_blocked, __ATOMIC_ACQUIRE)) want |= (mm_u32)EPOLLIN;
+        if (ch->want_out) want |= (mm_u32)EPOLLOUT;
+    }
+    set_interest(ch->fd, &ch->fd_events, want, chan_tag(ch, MM_FALSE));
+    if (ch->listen_fd >= 0) {
+        set_interest(ch->listen_fd, &listen_cur,
+                     (state == MM_CHAN_LISTENING) ? (mm_u32)EPOLLIN : 0u, chan_tag(ch, MM_TRUE));
+        ch->listen_armed = (listen_cur != 0u) ? MM_TRUE : MM_FALSE;
+    }
+}
+
+/* Client sockets go away; PTYs and links just wait for a peer. Returns
+ * MM_TRUE when the CPU side has a state change to notice. */
+static mm_bool chan_hangup(struct mm_chan *ch)
+{
+    if (ch->listen_fd >= 0) {
+        if (ch->fd < 0) {
+            return MM_FALSE;
+        }
+        set_interest(ch->fd, &ch->fd_events, 0u, 0u);
+        close(ch->fd);
+        ch->fd = -1;
+        ch->want_out = MM_FALSE;
+        __atomic_store_n(&ch->state, MM_CHAN_DOWN, __ATOMIC_RELEASE);
+        return MM_TRUE;
+    }
+    ch->parked = MM_TRUE;
+    return MM_FALSE;
+}
+
+static int chan_recv(struct mm_chan *ch, mm_u8 *buf, mm_u32 len)
+{
+    ssize_t n;
+    if (ch->has_io) {
+        return ch->io.recv(ch->io.ctx, buf, len);
+    }
+    do {
+        n = read(ch->fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    return (int)n;
+}
+
+static int chan_send(struct mm_chan *ch, const mm_u8 *buf, mm_u32 len)
+{
+    ssize_t n;
+    if (ch->has_io) {
+        return ch->io.send(ch->io.ctx, buf, len);
+    }
+    do {
+        if (ch->listen_fd >= 0) {
+            n = send(ch->fd, buf, len, MSG_NOSIGNAL);
+        } else {
+            n = write(ch->fd, buf, len);
+        }
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return (n < 0) ? -1 : (int)n;
+}
+
+static mm_bool chan_do_read(struct mm_chan *ch)
+{
+    mm_bool progress = MM_FALSE;
+    int budget = 64;
+    while (budget-- > 0 && ch->fd >= 0) {
+        int n;
+        if (ch->kind == MM_CHAN_FRAME) {
+            n = chan_recv(ch, g_frame_buf, sizeof(g_frame_buf));
+            if (n > 0) {
+                if (!mm_ring_put_frame(&ch->rx, g_frame_buf, (mm_u32)n)) {
+                    __atomic_add_fetch(&ch->rx_drops, 1u, __ATOMIC_RELAXED);
+                }
+                progress = MM_TRUE;
+            }
+        } else {
+            mm_u8 *p;
+            mm_u32 space = mm_ring_write_ptr(&ch->rx, &p);
+            if (space == 0u) {
+                __atomic_store_n(&ch->rx_blocked, 1, __ATOMIC_RELEASE);
+                break;
+            }
+            n = chan_recv(ch, p, space);
+            if (n > 0) {
+                mm_ring_commit(&ch->rx, (mm_u32)n);
+                progress = MM_TRUE;
+            }
+        }
+        if (n < 0) {
+            if (chan_hangup(ch)) progress = MM_TRUE;
+            break;
+        }
+        /* Hooks may block once the fd is drained; take one unit per event. */
+        if (n == 0 || ch->has_io) {
+            break;
+        }
+    }
+    return progress;
+}
+
+static void chan_flush(struct mm_chan *ch)
+{
+    if (ch->fd < 0) {
+        return;
+    }
+    if (ch->kind == MM_CHAN_FRAME) {
+        mm_u32 len;
+        /* A frame the link cannot take right now is dropped. */
+        while ((len = mm_ring_get_frame(&ch->tx, g_frame_buf, sizeof(g_frame_buf))) != 0u) {
+            if (len <= sizeof(g_frame_buf)) {
+                (void)chan_send(ch, g_frame_buf, len);
+            }
+        }
+        return;
+    }
+    for (;;) {
+        const mm_u8 *p;
+        mm_u32 avail = mm_ring_read_ptr(&ch->tx, &p);
+        int n;
+        if (avail == 0u) {
+            ch->want_out = MM_FALSE;
+            return;
+        }
+        n = chan_send(ch, p, avail);
+        if (n > 0) {
+            mm_ring_consume(&ch->tx, (mm_u32)n);
+            continue;
+        }
+        if (n == 0) {
+            ch->want_out = MM_TRUE;
+            return;
+        }
+        if (ch->listen_fd >= 0) {
+            (void)chan_hangup(ch);
+            return;
+        }
+        /* PTY without a reader: discard, as a wire would. */
+        mm_ring_consume(&ch->tx, avail);
+    }
+}
+
+static void *reactor_main(void *arg)
+{
+    struct epoll_event evs[REACTOR_EVENTS];
+    mm_bool any_parked = MM_FALSE;
+    mm_u64 last_recheck = 0;
+    (void)arg;
+
+    for (;;) {
+        int n;
+        int i;
+        mm_bool progress = MM_FALSE;
+        mm_u64 now;
+
+        n = epoll_wait(g_epfd, evs, REACTOR_EVENTS, any_parked ? MM_REACTOR_RECHECK_MS : -1);
+        pthread_mutex_lock(&g_lock);
+        if (__atomic_load_n(&g_stop, __ATOMIC_ACQUIRE)) {
+            pthread_mutex_unlock(&g_lock);
+            break;
+        }
+        for (i = 0; i < n; ++i) {
+            mm_u64 tag = evs[i].data.u64;
+            struct mm_chan *ch;
+            if (tag == REACTOR_KICK_TAG) {
+                mm_u64 v;
+                (void)read(g_evfd, &v, sizeof(v));
+                continue;
+            }
+            ch = &g_chans[(tag >> 40) & 0xffffffu];
+            if (!ch->used || ch->gen != (mm_u32)tag) {
+                continue;
+            }
+            if (((tag >> 32) & 1u) != 0u) {
+                if (__atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) == MM_CHAN_LISTENING) {
+                    int cfd = accept4(ch->listen_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (cfd >= 0) {
+                        ch->fd = cfd;
+                        ch->fd_events = 0;
+                        ch->want_out = MM_FALSE;
+                        ch->parked = MM_FALSE;
+                        __atomic_store_n(&ch->state, MM_CHAN_UP, __ATOMIC_RELEASE);
+                        progress = MM_TRUE;
+                    }
+                }
+                continue;
+            }
+            if (ch->fd < 0) {
+                continue;
+            }
+            if ((evs[i].events & EPOLLIN) != 0u) {
+                if (chan_do_read(ch)) progress = MM_TRUE;
+            } else if ((evs[i].events & (EPOLLHUP | EPOLLERR)) != 0u) {
+                if (chan_hangup(ch)) progress = MM_TRUE;
+            }
+            if ((evs[i].events & EPOLLOUT) != 0u) {
+                ch->want_out = MM_FALSE;
+            }
+        }
+        now = mono_ms();
+        if (any_parked && now - last_recheck >= (mm_u64)MM_REACTOR_RECHECK_MS) {
+            last_recheck = now;
+            for (i = 0; i < MM_REACTOR_MAX_CHANS; ++i) {
+                g_chans[i].parked = MM_FALSE;
+            }
+        }
+        /* Producers kick again for anything queued after this point. */
+        __atomic_store_n(&g_kicked, 0, __ATOMIC_RELEASE);
+        any_parked = MM_FALSE;
+        for (i = 0; i < MM_REACTOR_MAX_CHANS; ++i) {
+            struct mm_chan *ch = &g_chans[i];
+            int state;
+            if (!ch->used) continue;
+            state = __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE);
+            if (state == MM_CHAN_CLOSING) {
+                if (chan_hangup(ch)) progress = MM_TRUE;
+            } else if (state == MM_CHAN_UP && !ch->want_out) {
+                chan_flush(ch);
+            }
+            chan_update_interest(ch);
+            if (ch->parked) any_parked = MM_TRUE;
+        }
+        pthread_mutex_unlock(&g_lock);
+        if (progress) {
+            mm_hostwait_wake();
+        }
+    }
+    return 0;
+}
+
+/* Called with g_lock held. */
+static mm_bool reactor_start(void)
+{
+    struct epoll_event ev;
+    if (g_running) {
+        return MM_TRUE;
+    }
+    g_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_epfd < 0) {
+        return MM_FALSE;
+    }
+    g_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_evfd < 0) {
+        close(g_epfd);
+        g_epfd = -1;
+        return MM_FALSE;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = REACTOR_KICK_TAG;
+    (void)epoll_ctl(g_epfd, EPOLL_CTL_ADD, g_evfd, &ev);
+    __atomic_store_n(&g_stop, 0, __ATOMIC_RELEASE);
+    g_kicked = 0;
+    if (pthread_create(&g_thread, 0, reactor_main, 0) != 0) {
+        close(g_evfd);
+        close(g_epfd);
+        g_evfd = g_epfd = -1;
+        return MM_FALSE;
+    }
+    g_running = MM_TRUE;
+    return MM_TRUE;
+}
+
+static struct mm_chan *chan_alloc(enum mm_chan_kind kind, mm_u32 rx_size, mm_u32 tx_size)
+{
+    int i;
+    if (!reactor_start()) {
+        return 0;
+    }
+    for (i = 0; i < MM_REACTOR_MAX_CHANS; ++i) {
+        struct mm_chan *ch = &g_chans[i];
+        mm_u32 gen;
+        if (ch->used) continue;
+        gen = ch->gen + 1u;
+        memset(ch, 0, sizeof(*ch));
+        ch->gen = gen;
+        if (!mm_ring_init(&ch->rx, rx_size)) {
+            return 0;
+        }
+        if (!mm_ring_init(&ch->tx, tx_size)) {
+            mm_ring_free(&ch->rx);
+            return 0;
+        }
+        ch->kind = kind;
+        ch->fd = -1;
+        ch->listen_fd = -1;
+        return ch;
+    }
+    return 0;
+}
+
+struct mm_chan *mm_reactor_open(enum mm_chan_kind kind, int fd, const struct mm_chan_io *io,
+                                mm_u32 rx_size, mm_u32 tx_size)
+{
+    struct mm_chan *ch;
+    if (fd < 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&g_lock);
+    ch = chan_alloc(kind, rx_size, tx_size);
+    if (ch != 0) {
+        ch->fd = fd;
+        if (io != 0) {
+            ch->io = *io;
+            ch->has_io = MM_TRUE;
+        }
+        ch->state = MM_CHAN_UP;
+        ch->used = MM_TRUE;
+    }
+    pthread_mutex_unlock(&g_lock);
+    if (ch != 0) {
+        reactor_kick();
+    }
+    return ch;
+}
+
+struct mm_chan *mm_reactor_open_listen(int listen_fd, mm_u32 rx_size, mm_u32 tx_size)
+{
+    struct mm_chan *ch;
+    if (listen_fd < 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&g_lock);
+    ch = chan_alloc(MM_CHAN_STREAM, rx_size, tx_size);
+    if (ch != 0) {
+        ch->listen_fd = listen_fd;
+        ch->state = MM_CHAN_LISTENING;
+        ch->used = MM_TRUE;
+    }
+    pthread_mutex_unlock(&g_lock);
+    if (ch != 0) {
+        reactor_kick();
+    }
+    return ch;
+}
+
+/* Called with g_lock held. */
+static void chan_release(struct mm_chan *ch)
+{
+    mm_u32 listen_cur = ch->listen_armed ? (mm_u32)EPOLLIN : 0u;
+    set_interest(ch->fd, &ch->fd_events, 0u, 0u);
+    set_interest(ch->listen_fd, &listen_cur, 0u, 0u);
+    if (ch->fd >= 0 && !ch->has_io) {
+        close(ch->fd);
+    }
+    if (ch->listen_fd >= 0) {
+        close(ch->listen_fd);
+    }
+    mm_ring_free(&ch->rx);
+    mm_ring_free(&ch->tx);
+    ch->fd = -1;
+    ch->listen_fd = -1;
+    ch->used = MM_FALSE;
+    ch->gen++;
+}
+
+void mm_reactor_close(struct mm_chan *ch)
+{
+    if (ch == 0) {
+        return;
+    }
+    pthread_mutex_lock(&g_lock);
+    if (ch->used) {
+        chan_release(ch);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* Give queued output (UART text printed just before exit) a moment to
+ * reach the host. */
+static void reactor_drain(void)
+{
+    int tries;
+    for (tries = 0; tries < 200; ++tries) {
+        struct timespec ts;
+        mm_bool busy = MM_FALSE;
+        int i;
+        for (i = 0; i < MM_REACTOR_MAX_CHANS; ++i) {
+            struct mm_chan *ch = &g_chans[i];
+            if (__atomic_load_n(&ch->used, __ATOMIC_ACQUIRE) &&
+                __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) == MM_CHAN_UP &&
+                mm_ring_used(&ch->tx) != 0u) {
+                busy = MM_TRUE;
+            }
+        }
+        if (!busy) {
+            return;
+        }
+        reactor_kick();
+        ts.tv_sec = 0;
+        ts.tv_nsec = 1000000L;
+        nanosleep(&ts, 0);
+    }
+}
+
+void mm_reactor_stop(void)
+{
+    int i;
+    if (!g_running) {
+        return;
+    }
+    reactor_drain();
+    __atomic_store_n(&g_stop, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_kicked, 0, __ATOMIC_RELEASE);
+    reactor_kick();
+    pthread_join(g_thread, 0);
+    pthread_mutex_lock(&g_lock);
+    for (i = 0; i < MM_REACTOR_MAX_CHANS; ++i) {
+        if (g_chans[i].used) {
+            chan_release(&g_chans[i]);
+        }
+    }
+    close(g_evfd);
+    close(g_epfd);
+    g_evfd = g_epfd = -1;
+    g_running = MM_FALSE;
+    pthread_mutex_unlock(&g_lock);
+}
+
+mm_u32 mm_chan_write(struct mm_chan *ch, const void *data, mm_u32 len)
+{
+    mm_u32 n;
+    if (ch == 0 || __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) != MM_CHAN_UP) {
+        return 0;
+    }
+    n = mm_ring_write(&ch->tx, data, len);
+    if (n != 0u) {
+        reactor_kick();
+    }
+    return n;
+}
+
+mm_bool mm_chan_send_frame(struct mm_chan *ch, const void *data, mm_u32 len)
+{
+    if (ch == 0 || len > MM_REACTOR_FRAME_MAX ||
+        __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) != MM_CHAN_UP) {
+        return MM_FALSE;
+    }
+    if (!mm_ring_put_frame(&ch->tx, data, len)) {
+        return MM_FALSE;
+    }
+    reactor_kick();
+    return MM_TRUE;
+}
+
+static void chan_rx_released(struct mm_chan *ch)
+{
+    if (__atomic_load_n(&ch->rx_blocked, __ATOMIC_ACQUIRE) &&
+        __atomic_exchange_n(&ch->rx_blocked, 0, __ATOMIC_ACQ_REL)) {
+        reactor_kick();
+    }
+}
+
+mm_u32 mm_chan_read(struct mm_chan *ch, void *data, mm_u32 len)
+{
+    mm_u32 n;
+    if (ch == 0 || __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) == MM_CHAN_DOWN) {
+        return 0;
+    }
+    n = mm_ring_read(&ch->rx, data, len);
+    if (n != 0u) {
+        chan_rx_released(ch);
+    }
+    return n;
+}
+
+mm_u32 mm_chan_recv_frame(struct mm_chan *ch, void *data, mm_u32 max)
+{
+    if (ch == 0) {
+        return 0;
+    }
+    return mm_ring_get_frame(&ch->rx, data, max);
+}
+
+mm_u32 mm_chan_rx_avail(const struct mm_chan *ch)
+{
+    return (ch != 0) ? mm_ring_used(&ch->rx) : 0u;
+}
+
+mm_u32 mm_chan_tx_space(const struct mm_chan *ch)
+{
+    return (ch != 0) ? mm_ring_space(&ch->tx) : 0u;
+}
+
+mm_bool mm_chan_tx_idle(const struct mm_chan *ch)
+{
+    return (ch == 0 || mm_ring_used(&ch->tx) == 0u) ? MM_TRUE : MM_FALSE;
+}
+
+enum mm_chan_state mm_chan_state(const struct mm_chan *ch)
+{
+    if (ch == 0) {
+        return MM_CHAN_DOWN;
+    }
+    return (enum mm_chan_state)__atomic_load_n(&ch->state, __ATOMIC_ACQUIRE);
+}
+
+void mm_chan_drop(struct mm_chan *ch)
+{
+    int expected = MM_CHAN_UP;
+    if (ch == 0 || ch->listen_fd < 0) {
+        return;
+    }
+    if (__atomic_compare_exchange_n(&ch->state, &expected, MM_CHAN_CLOSING, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        reactor_kick();
+    }
+}
+
+void mm_chan_rearm(struct mm_chan *ch)
+{
+    if (ch == 0 || __atomic_load_n(&ch->state, __ATOMIC_ACQUIRE) != MM_CHAN_DOWN) {
+        return;
+    }
+    mm_ring_reset(&ch->rx);
+    mm_ring_reset(&ch->tx);
+    __atomic_store_n(&ch->rx_blocked, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ch->state, MM_CHAN_LISTENING, __ATOMIC_RELEASE);
+    reactor_kick();
+}
+
+mm_u64 mm_chan_rx_drops(const struct mm_chan *ch)
+{
+    return (ch != 0) ? __atomic_load_n(&ch->rx_drops, __ATOMIC_RELAXED) : 0u;
+}
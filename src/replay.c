@@ -0,0 +1,331 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include "m33mu/replay.h"
+
+static const char replay_magic[7] = { 'M', '3', '3', 'M', 'U', 'R', 'R' };
+
+struct replay_state {
+    enum mm_replay_mode mode;
+    FILE *f;
+    char path[256];
+    const mm_u64 *clock;
+    mm_u64 base;
+    mm_u64 last;       /* stamp of the previous record */
+    mm_u64 events;
+    /* Replay: the next record, read ahead. */
+    mm_bool have_next;
+    mm_u8 next_kind;
+    mm_u32 next_chan;
+    mm_u64 next_cycle;
+    mm_u32 next_len;
+    mm_u8 *next_data;
+    mm_u32 next_cap;
+    mm_bool stopped;
+};
+
+static struct replay_state g_rr;
+
+static const char *replay_kind_name(mm_u8 kind)
+{
+    static const char *const names[MM_REPLAY_KIND_COUNT] = {
+        "end", "uart-rx", "uart-busy", "eth-rx", "usb-state", "usb-rx",
+        "random", "console", "poll", "idle-poll", "idle", "control"
+    };
+    return (kind < MM_REPLAY_KIND_COUNT) ? names[kind] : "unknown";
+}
+
+static void replay_put_varint(FILE *f, mm_u64 v)
+{
+    while (v >= 0x80u) {
+        fputc((int)((v & 0x7Fu) | 0x80u), f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+static mm_bool replay_get_varint(FILE *f, mm_u64 *out)
+{
+    mm_u64 v = 0;
+    unsigned shift = 0;
+    for (;;) {
+        int c = fgetc(f);
+        if (c == EOF || shift > 63u) return MM_FALSE;
+        v |= (mm_u64)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) break;
+        shift += 7u;
+    }
+    *out = v;
+    return MM_TRUE;
+}
+
+static mm_u32 replay_encode_u64(mm_u8 *buf, mm_u64 v)
+{
+    mm_u32 n = 0;
+    while (v >= 0x80u) {
+        buf[n++] = (mm_u8)((v & 0x7Fu) | 0x80u);
+        v >>= 7;
+    }
+    buf[n++] = (mm_u8)v;
+    return n;
+}
+
+/* Reads the next record into g_rr; a short or corrupt tail ends the log. */
+static void replay_read_next(void)
+{
+    int kind;
+    mm_u64 delta;
+    mm_u64 chan;
+    mm_u64 len;
+    g_rr.have_next = MM_FALSE;
+    kind = fgetc(g_rr.f);
+    if (kind == EOF) return;
+    if (!replay_get_varint(g_rr.f, &delta) ||
+        !replay_get_varint(g_rr.f, &chan) ||
+        !replay_get_varint(g_rr.f, &len) ||
+        chan > 0xFFFFFFFFu || len > MM_REPLAY_PAYLOAD_MAX) {
+        fprintf(stderr, "[REPLAY] %s: truncated or corrupt record\n", g_rr.path);
+        return;
+    }
+    if (len > g_rr.next_cap) {
+        mm_u8 *p = (mm_u8 *)realloc(g_rr.next_data, (size_t)len);
+        if (p == 0) return;
+        g_rr.next_data = p;
+        g_rr.next_cap = (mm_u32)len;
+    }
+    if (len != 0u && fread(g_rr.next_data, 1, (size_t)len, g_rr.f) != (size_t)len) {
+        fprintf(stderr, "[REPLAY] %s: truncated record\n", g_rr.path);
+        return;
+    }
+    g_rr.next_kind = (mm_u8)kind;
+    g_rr.next_chan = (mm_u32)chan;
+    g_rr.next_cycle = g_rr.last + delta;
+    g_rr.next_len = (mm_u32)len;
+    g_rr.last = g_rr.next_cycle;
+    g_rr.have_next = MM_TRUE;
+}
+
+mm_bool mm_replay_open(enum mm_replay_mode mode, const char *path)
+{
+    mm_u8 hdr[8];
+    mm_replay_close();
+    if (mode == MM_REPLAY_OFF || path == 0 || path[0] == '\0') return MM_FALSE;
+    if (strlen(path) >= sizeof(g_rr.path)) return MM_FALSE;
+    g_rr.f = fopen(path, (mode == MM_REPLAY_RECORD) ? "wb" : "rb");
+    if (g_rr.f == 0) {
+        fprintf(stderr, "[REPLAY] %s: %s\n", path, strerror(errno));
+        return MM_FALSE;
+    }
+    snprintf(g_rr.path, sizeof(g_rr.path), "%s", path);
+    if (mode == MM_REPLAY_RECORD) {
+        memcpy(hdr, replay_magic, sizeof(replay_magic));
+        hdr[7] = (mm_u8)MM_REPLAY_VERSION;
+        if (fwrite(hdr, 1, sizeof(hdr), g_rr.f) != sizeof(hdr)) {
+            fclose(g_rr.f);
+            g_rr.f = 0;
+            return MM_FALSE;
+        }
+    } else {
+        if (fread(hdr, 1, sizeof(hdr), g_rr.f) != sizeof(hdr) ||
+            memcmp(hdr, replay_magic, sizeof(replay_magic)) != 0) {
+            fprintf(stderr, "[REPLAY] %s: not an m33mu input log\n", path);
+            fclose(g_rr.f);
+            g_rr.f = 0;
+            return MM_FALSE;
+        }
+        if (hdr[7] != (mm_u8)MM_REPLAY_VERSION) {
+            fprintf(stderr, "[REPLAY] %s: unsupported log version %u\n", path, (unsigned)hdr[7]);
+            fclose(g_rr.f);
+            g_rr.f = 0;
+            return MM_FALSE;
+        }
+    }
+    g_rr.mode = mode;
+    if (mode == MM_REPLAY_PLAY) {
+        replay_read_next();
+    }
+    return MM_TRUE;
+}
+
+void mm_replay_close(void)
+{
+    if (g_rr.f != 0) {
+        if (g_rr.mode == MM_REPLAY_RECORD) {
+            if (g_rr.clock == 0) {
+                mm_replay_put(MM_REPLAY_END, 0, 0, 0);
+            }
+            fclose(g_rr.f);
+            fprintf(stderr, "[REPLAY] %llu input events recorded to %s\n",
+                    (unsigned long long)g_rr.events, g_rr.path);
+        } else {
+            fclose(g_rr.f);
+            fprintf(stderr, "[REPLAY] %llu input events replayed from %s\n",
+                    (unsigned long long)g_rr.events, g_rr.path);
+        }
+    }
+    free(g_rr.next_data);
+    memset(&g_rr, 0, sizeof(g_rr));
+}
+
+mm_bool mm_replay_recording(void)
+{
+    return (g_rr.mode == MM_REPLAY_RECORD) ? MM_TRUE : MM_FALSE;
+}
+
+mm_bool mm_replay_playing(void)
+{
+    return (g_rr.mode == MM_REPLAY_PLAY) ? MM_TRUE : MM_FALSE;
+}
+
+void mm_replay_bind_clock(const mm_u64 *cycles, mm_u64 base)
+{
+    g_rr.clock = cycles;
+    g_rr.base = base;
+}
+
+mm_u64 mm_replay_now(void)
+{
+    return g_rr.base + ((g_rr.clock != 0) ? *g_rr.clock : 0u);
+}
+
+void mm_replay_put(enum mm_replay_kind kind, mm_u32 chan, const void *data, mm_u32 len)
+{
+    mm_u64 now;
+    if (g_rr.mode != MM_REPLAY_RECORD) return;
+    now = mm_replay_now();
+    if (now < g_rr.last) now = g_rr.last;
+    fputc((int)kind, g_rr.f);
+    replay_put_varint(g_rr.f, now - g_rr.last);
+    replay_put_varint(g_rr.f, chan);
+    replay_put_varint(g_rr.f, len);
+    if (len != 0u) {
+        fwrite(data, 1, len, g_rr.f);
+    }
+    g_rr.last = now;
+    g_rr.events++;
+    /* Idle and control points are where a killed run is most likely to
+     * stop; keep the log complete up to them. */
+    if (kind == MM_REPLAY_POLL || kind == MM_REPLAY_IDLE_POLL || kind == MM_REPLAY_CONTROL) {
+        fflush(g_rr.f);
+    }
+}
+
+void mm_replay_put_u64(enum mm_replay_kind kind, mm_u32 chan, mm_u64 value)
+{
+    mm_u8 buf[10];
+    mm_u32 n;
+    if (g_rr.mode != MM_REPLAY_RECORD) return;
+    n = replay_encode_u64(buf, value);
+    mm_replay_put(kind, chan, buf, n);
+}
+
+static void replay_diverged(const char *why)
+{
+    if (g_rr.stopped) return;
+    g_rr.stopped = MM_TRUE;
+    fprintf(stderr, "[REPLAY] %s at cycle %llu: next record is %s on channel 0x%lx at cycle %llu\n",
+            why, (unsigned long long)mm_replay_now(), replay_kind_name(g_rr.next_kind),
+            (unsigned long)g_rr.next_chan, (unsigned long long)g_rr.next_cycle);
+}
+
+mm_bool mm_replay_take(enum mm_replay_kind kind, mm_u32 chan, void *buf, mm_u32 max, mm_u32 *len_out)
+{
+    mm_u64 now;
+    mm_u32 n;
+    if (g_rr.mode != MM_REPLAY_PLAY || !g_rr.have_next || g_rr.stopped) return MM_FALSE;
+    now = mm_replay_now();
+    if (g_rr.next_cycle < now) {
+        replay_diverged("run diverged");
+        return MM_FALSE;
+    }
+    if (g_rr.next_cycle != now || g_rr.next_kind != (mm_u8)kind || g_rr.next_chan != chan) {
+        return MM_FALSE;
+    }
+    n = (g_rr.next_len < max) ? g_rr.next_len : max;
+    if (n != 0u) {
+        memcpy(buf, g_rr.next_data, n);
+    }
+    if (len_out != 0) *len_out = n;
+    g_rr.events++;
+    replay_read_next();
+    return MM_TRUE;
+}
+
+mm_bool mm_replay_take_u64(enum mm_replay_kind kind, mm_u32 chan, mm_u64 *value)
+{
+    mm_u8 buf[10];
+    mm_u32 len = 0;
+    mm_u32 i;
+    mm_u64 v = 0;
+    if (!mm_replay_take(kind, chan, buf, sizeof(buf), &len)) return MM_FALSE;
+    for (i = 0; i < len; ++i) {
+        v |= (mm_u64)(buf[i] & 0x7Fu) << (7u * i);
+        if ((buf[i] & 0x80u) == 0u) break;
+    }
+    if (value != 0) *value = v;
+    return MM_TRUE;
+}
+
+mm_bool mm_replay_finished(void)
+{
+    mm_u64 now;
+    if (g_rr.mode != MM_REPLAY_PLAY) return MM_FALSE;
+    if (g_rr.stopped) return MM_TRUE;
+    now = mm_replay_now();
+    if (!g_rr.have_next) {
+        g_rr.stopped = MM_TRUE;
+        fprintf(stderr, "[REPLAY] end of log at cycle %llu\n", (unsigned long long)now);
+        return MM_TRUE;
+    }
+    if (g_rr.next_kind == (mm_u8)MM_REPLAY_END && now >= g_rr.next_cycle) {
+        g_rr.stopped = MM_TRUE;
+        fprintf(stderr, "[REPLAY] reached end of recording at cycle %llu\n", (unsigned long long)now);
+        return MM_TRUE;
+    }
+    if (g_rr.next_cycle < now) {
+        replay_diverged("run diverged");
+        return MM_TRUE;
+    }
+    return MM_FALSE;
+}
+
+ssize_t mm_replay_getrandom(void *buf, size_t len, unsigned int flags)
+{
+    ssize_t n;
+    if (g_rr.mode == MM_REPLAY_PLAY) {
+        mm_u32 got = 0;
+        if (!mm_replay_take(MM_REPLAY_RANDOM, 0, buf, (mm_u32)len, &got) || got == 0u) {
+            errno = EAGAIN;
+            return -1;
+        }
+        return (ssize_t)got;
+    }
+    n = getrandom(buf, len, flags);
+    mm_replay_put(MM_REPLAY_RANDOM, 0, buf, (n > 0) ? (mm_u32)n : 0u);
+    return n;
+}
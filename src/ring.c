@@ -0,0 +1,190 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/ring.h"
+
+mm_bool mm_ring_init(struct mm_ring *r, mm_u32 size)
+{
+    if (r == 0 || size < 8u || (size & (size - 1u)) != 0u) {
+        return MM_FALSE;
+    }
+    r->buf = (mm_u8 *)malloc(size);
+    if (r->buf == 0) {
+        return MM_FALSE;
+    }
+    r->size = size;
+    r->head = 0;
+    r->tail = 0;
+    return MM_TRUE;
+}
+
+void mm_ring_free(struct mm_ring *r)
+{
+    if (r == 0) {
+        return;
+    }
+    free(r->buf);
+    r->buf = 0;
+    r->size = 0;
+    r->head = 0;
+    r->tail = 0;
+}
+
+void mm_ring_reset(struct mm_ring *r)
+{
+    __atomic_store_n(&r->head, 0u, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->tail, 0u, __ATOMIC_RELEASE);
+}
+
+mm_u32 mm_ring_used(const struct mm_ring *r)
+{
+    mm_u32 head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    mm_u32 tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
+
+mm_u32 mm_ring_space(const struct mm_ring *r)
+{
+    return r->size - mm_ring_used(r);
+}
+
+static void copy_in(struct mm_ring *r, mm_u32 tail, const mm_u8 *p, mm_u32 n)
+{
+    mm_u32 pos = tail & (r->size - 1u);
+    mm_u32 first = r->size - pos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(&r->buf[pos], p, first);
+    memcpy(&r->buf[0], p + first, n - first);
+}
+
+static void copy_out(const struct mm_ring *r, mm_u32 head, mm_u8 *p, mm_u32 n)
+{
+    mm_u32 pos = head & (r->size - 1u);
+    mm_u32 first = r->size - pos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(p, &r->buf[pos], first);
+    memcpy(p + first, &r->buf[0], n - first);
+}
+
+mm_u32 mm_ring_write(struct mm_ring *r, const void *data, mm_u32 len)
+{
+    mm_u32 tail = r->tail;
+    mm_u32 space = r->size - (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE));
+    if (len > space) {
+        len = space;
+    }
+    if (len == 0u) {
+        return 0;
+    }
+    copy_in(r, tail, (const mm_u8 *)data, len);
+    __atomic_store_n(&r->tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+mm_bool mm_ring_put_frame(struct mm_ring *r, const void *data, mm_u32 len)
+{
+    mm_u32 tail = r->tail;
+    mm_u32 space = r->size - (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE));
+    mm_u8 hdr[4];
+    if (space < 4u || len > space - 4u) {
+        return MM_FALSE;
+    }
+    hdr[0] = (mm_u8)(len & 0xffu);
+    hdr[1] = (mm_u8)((len >> 8) & 0xffu);
+    hdr[2] = (mm_u8)((len >> 16) & 0xffu);
+    hdr[3] = (mm_u8)((len >> 24) & 0xffu);
+    copy_in(r, tail, hdr, 4u);
+    copy_in(r, tail + 4u, (const mm_u8 *)data, len);
+    __atomic_store_n(&r->tail, tail + 4u + len, __ATOMIC_RELEASE);
+    return MM_TRUE;
+}
+
+mm_u32 mm_ring_write_ptr(struct mm_ring *r, mm_u8 **p)
+{
+    mm_u32 tail = r->tail;
+    mm_u32 space = r->size - (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE));
+    mm_u32 pos = tail & (r->size - 1u);
+    if (space > r->size - pos) {
+        space = r->size - pos;
+    }
+    *p = &r->buf[pos];
+    return space;
+}
+
+void mm_ring_commit(struct mm_ring *r, mm_u32 n)
+{
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+}
+
+mm_u32 mm_ring_read(struct mm_ring *r, void *data, mm_u32 len)
+{
+    mm_u32 head = r->head;
+    mm_u32 used = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head;
+    if (len > used) {
+        len = used;
+    }
+    if (len == 0u) {
+        return 0;
+    }
+    copy_out(r, head, (mm_u8 *)data, len);
+    __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+mm_u32 mm_ring_get_frame(struct mm_ring *r, void *data, mm_u32 max)
+{
+    mm_u32 head = r->head;
+    mm_u32 used = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head;
+    mm_u8 hdr[4];
+    mm_u32 len;
+    if (used < 4u) {
+        return 0;
+    }
+    copy_out(r, head, hdr, 4u);
+    len = (mm_u32)hdr[0] | ((mm_u32)hdr[1] << 8) | ((mm_u32)hdr[2] << 16) | ((mm_u32)hdr[3] << 24);
+    copy_out(r, head + 4u, (mm_u8 *)data, (len < max) ? len : max);
+    __atomic_store_n(&r->head, head + 4u + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+mm_u32 mm_ring_read_ptr(struct mm_ring *r, const mm_u8 **p)
+{
+    mm_u32 head = r->head;
+    mm_u32 used = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - head;
+    mm_u32 pos = head & (r->size - 1u);
+    if (used > r->size - pos) {
+        used = r->size - pos;
+    }
+    *p = &r->buf[pos];
+    return used;
+}
+
+void mm_ring_consume(struct mm_ring *r, mm_u32 n)
+{
+    __atomic_store_n(&r->head, r->head + n, __ATOMIC_RELEASE);
+}
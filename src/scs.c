@@ -20,8 +20,10 @@
  */
 
 #include "m33mu/scs.h"
+#include "m33mu/fpu.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 extern void mm_system_request_reset(void);
 
@@ -34,6 +36,16 @@ struct mm_scs_mmio {
 #define SCS_PAGE_SIZE 0x1000u
 #define SCS_SCB_OFFSET 0x0D00u /* SCB window starts at 0xE000ED00 inside SCS page */
 
+#define DEMCR_TRCENA (1u << 24)
+#define DWT_CTRL_CYCCNTENA (1u << 0)
+#define DWT_CTRL_EXCEVTENA (1u << 18)
+#define DWT_CTRL_SLEEPEVTENA (1u << 19)
+/* NUMCOMP in [31:28]; NOTRCPKT and NOEXTTRIG set (no trace packets/triggers). */
+#define DWT_CTRL_RO ((MM_DWT_NUM_COMP << 28) | (1u << 27) | (1u << 26))
+#define DWT_FUNCTION_MATCHED (1u << 24)
+#define DWT_FUNCTION_MATCH_CYCCNT 0x1u
+#define ITM_TCR_ITMENA (1u << 0)
+
 static mm_bool g_meminfo_enabled = MM_FALSE;
 static int g_sau_layout = 0; /* 0=unknown, 1=new(CTRL@0xD0/RNR@0xD4), 2=legacy(RNR@0xD8) */
 #define NVIC_WORDS ((MM_MAX_IRQ + 31u) / 32u)
@@ -151,6 +163,26 @@ void mm_scs_init(struct mm_scs *scs, mm_u32 cpuid_const)
     scs->systick_wraps = 0;
     scs->pend_sv = MM_FALSE;
     scs->pend_st = MM_FALSE;
+    scs->cycles = 0;
+    scs->demcr = 0;
+    scs->dwt_ctrl = DWT_CTRL_RO;
+    scs->dwt_cyccnt = 0;
+    scs->dwt_cyccnt_sync = 0;
+    scs->dwt_cpicnt = 0;
+    scs->dwt_exccnt = 0;
+    scs->dwt_sleepcnt = 0;
+    scs->dwt_lsucnt = 0;
+    scs->dwt_foldcnt = 0;
+    for (i = 0; i < (int)MM_DWT_NUM_COMP; ++i) {
+        scs->dwt_comp[i] = 0;
+        scs->dwt_function[i] = 0;
+    }
+    scs->dwt_match_last = 0;
+    scs->itm_ter = 0;
+    scs->itm_tpr = 0;
+    scs->itm_tcr = 0;
+    scs->itm_sink = 0;
+    scs->cpu = 0;
     {
         const char *env = getenv("SYSTICK_TRACE");
         scs->trace_enabled = (env != 0 && env[0] != '\0') ? MM_TRUE : MM_FALSE;
@@ -354,6 +386,22 @@ static mm_bool scs_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *
         if (eff_sec == MM_SECURE) val = scs->sau_sfar;
         else val = 0;
         break;
+    case 0xFC: val = scs->demcr; break; /* DEMCR */
+    /* Floating-point extension */
+    case 0x88: /* CPACR */
+        if (scs->cpu != 0) val = (eff_sec == MM_NONSECURE) ? scs->cpu->cpacr_ns : scs->cpu->cpacr_s;
+        break;
+    case 0x8C: /* NSACR: Secure-only, NS reads see the value */
+        if (scs->cpu != 0) val = scs->cpu->nsacr;
+        break;
+    case 0x234: if (scs->cpu != 0) val = scs->cpu->fpccr; break;  /* FPCCR */
+    case 0x238: if (scs->cpu != 0) val = scs->cpu->fpcar; break;  /* FPCAR */
+    case 0x23C: /* FPDSCR */
+        if (scs->cpu != 0) val = (eff_sec == MM_NONSECURE) ? scs->cpu->fpdscr_ns : scs->cpu->fpdscr_s;
+        break;
+    case 0x240: val = MM_FPU_MVFR0; break; /* MVFR0 */
+    case 0x244: val = MM_FPU_MVFR1; break; /* MVFR1 */
+    case 0x248: val = MM_FPU_MVFR2; break; /* MVFR2 */
     default:
         /* RAZ/WI for unimplemented SCS slots. */
         val = 0;
@@ -871,6 +919,41 @@ static mm_bool scs_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32
                    (unsigned long)value);
         }
         return MM_TRUE;
+    case 0xFC: /* DEMCR: TRCENA gates CYCCNT, so latch it first */
+        scs->dwt_cyccnt = mm_scs_dwt_cyccnt(scs);
+        scs->dwt_cyccnt_sync = scs->cycles;
+        scs->demcr = value;
+        return MM_TRUE;
+    case 0x88: /* CPACR: only CP10/CP11 are implemented, and they move together */
+        if (scs->cpu != 0) {
+            mm_u32 v = (value >> 20) & 0x3u;
+            v = (v << 20) | (v << 22);
+            if (eff_sec == MM_NONSECURE) scs->cpu->cpacr_ns = v;
+            else scs->cpu->cpacr_s = v;
+        }
+        return MM_TRUE;
+    case 0x8C: /* NSACR */
+        if (scs->cpu != 0 && eff_sec == MM_SECURE) {
+            scs->cpu->nsacr = ((value >> 10) & 1u) ? (3u << 10) : 0u;
+        }
+        return MM_TRUE;
+    case 0x234: /* FPCCR: LSPACT/USER/S/THREAD and the enables; S is Secure-only */
+        if (scs->cpu != 0) {
+            mm_u32 wmask = MM_FPCCR_LSPACT | MM_FPCCR_USER | MM_FPCCR_THREAD |
+                           MM_FPCCR_LSPEN | MM_FPCCR_ASPEN;
+            if (eff_sec == MM_SECURE) wmask |= MM_FPCCR_S;
+            scs->cpu->fpccr = (scs->cpu->fpccr & ~wmask) | (value & wmask);
+        }
+        return MM_TRUE;
+    case 0x238: /* FPCAR */
+        if (scs->cpu != 0) scs->cpu->fpcar = value & ~0x7u;
+        return MM_TRUE;
+    case 0x23C: /* FPDSCR: AHP/DN/FZ/RMode */
+        if (scs->cpu != 0) {
+            if (eff_sec == MM_NONSECURE) scs->cpu->fpdscr_ns = value & 0x07c00000u;
+            else scs->cpu->fpdscr_s = value & 0x07c00000u;
+        }
+        return MM_TRUE;
     default:
         /* Writes to unimplemented SCS offsets are ignored. */
         return MM_TRUE;
@@ -889,6 +972,7 @@ mm_u32 mm_scs_systick_advance(struct mm_scs *scs, mm_u64 cycles)
     if (scs == 0 || cycles == 0u) {
         return 0u;
     }
+    scs->cycles += cycles;
     enable = (scs->systick_ctrl & 0x1u) != 0u;
     tickint = (scs->systick_ctrl & 0x2u) != 0u;
     if (!enable) {
@@ -990,6 +1074,235 @@ void mm_scs_systick_step(struct mm_scs *scs)
     (void)mm_scs_systick_advance(scs, 1u);
 }
 
+/* ---- DWT ----
+ * CYCCNT is derived from scs->cycles on demand rather than incremented per
+ * instruction: dwt_cyccnt holds the value latched at dwt_cyccnt_sync and the
+ * counter runs while DEMCR.TRCENA and DWT_CTRL.CYCCNTENA are both set.
+ * CPICNT/LSUCNT/FOLDCNT stay at their written value: the core model charges
+ * one cycle per instruction, so there are no extra cycles to count.
+ */
+mm_u32 mm_scs_dwt_cyccnt(const struct mm_scs *scs)
+{
+    if (scs == 0) {
+        return 0;
+    }
+    if ((scs->demcr & DEMCR_TRCENA) == 0u || (scs->dwt_ctrl & DWT_CTRL_CYCCNTENA) == 0u) {
+        return scs->dwt_cyccnt;
+    }
+    return scs->dwt_cyccnt + (mm_u32)(scs->cycles - scs->dwt_cyccnt_sync);
+}
+
+static void dwt_latch(struct mm_scs *scs)
+{
+    scs->dwt_cyccnt = mm_scs_dwt_cyccnt(scs);
+    scs->dwt_cyccnt_sync = scs->cycles;
+}
+
+/* Set MATCHED on cycle-count comparators whose value CYCCNT has passed. */
+static void dwt_update_matches(struct mm_scs *scs)
+{
+    mm_u32 now = mm_scs_dwt_cyccnt(scs);
+    mm_u32 last = scs->dwt_match_last;
+    mm_u32 n;
+    if (now == last) {
+        return;
+    }
+    for (n = 0; n < MM_DWT_NUM_COMP; ++n) {
+        if ((scs->dwt_function[n] & 0xFu) == DWT_FUNCTION_MATCH_CYCCNT &&
+            (mm_u32)(scs->dwt_comp[n] - last - 1u) < (mm_u32)(now - last)) {
+            scs->dwt_function[n] |= DWT_FUNCTION_MATCHED;
+        }
+    }
+    scs->dwt_match_last = now;
+}
+
+static mm_bool dwt_active(const struct mm_scs *scs, mm_u32 enable_bit)
+{
+    return ((scs->demcr & DEMCR_TRCENA) != 0u && (scs->dwt_ctrl & enable_bit) != 0u) ? MM_TRUE : MM_FALSE;
+}
+
+void mm_scs_dwt_exception(struct mm_scs *scs)
+{
+    if (scs != 0 && dwt_active(scs, DWT_CTRL_EXCEVTENA)) {
+        scs->dwt_exccnt = (scs->dwt_exccnt + 1u) & 0xFFu;
+    }
+}
+
+void mm_scs_dwt_sleep(struct mm_scs *scs, mm_u64 cycles)
+{
+    if (scs != 0 && dwt_active(scs, DWT_CTRL_SLEEPEVTENA)) {
+        scs->dwt_sleepcnt = (scs->dwt_sleepcnt + (mm_u32)cycles) & 0xFFu;
+    }
+}
+
+static mm_bool dwt_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct mm_scs *scs = (struct mm_scs *)opaque;
+    mm_u32 aligned = offset & ~0x3u;
+    mm_u32 val = 0;
+
+    if (value_out == 0 || (size_bytes != 1u && size_bytes != 2u && size_bytes != 4u)) {
+        return MM_FALSE;
+    }
+    switch (aligned) {
+    case 0x000: val = scs->dwt_ctrl; break;
+    case 0x004: val = mm_scs_dwt_cyccnt(scs); break;
+    case 0x008: val = scs->dwt_cpicnt; break;
+    case 0x00C: val = scs->dwt_exccnt; break;
+    case 0x010: val = scs->dwt_sleepcnt; break;
+    case 0x014: val = scs->dwt_lsucnt; break;
+    case 0x018: val = scs->dwt_foldcnt; break;
+    default:
+        if (aligned >= 0x020u && aligned < 0x020u + MM_DWT_NUM_COMP * 16u) {
+            mm_u32 n = (aligned - 0x020u) / 16u;
+            switch (aligned & 0xFu) {
+            case 0x0: val = scs->dwt_comp[n]; break;
+            case 0x8:
+                /* DWT_FUNCTIONn: MATCHED clears on read. */
+                dwt_update_matches(scs);
+                val = scs->dwt_function[n];
+                scs->dwt_function[n] &= ~DWT_FUNCTION_MATCHED;
+                break;
+            default: break;
+            }
+        }
+        break;
+    }
+    *value_out = (val >> ((offset & 0x3u) * 8u)) & ((size_bytes == 4u) ? 0xFFFFFFFFu : ((1u << (size_bytes * 8u)) - 1u));
+    return MM_TRUE;
+}
+
+static mm_bool dwt_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct mm_scs *scs = (struct mm_scs *)opaque;
+    mm_u32 aligned = offset & ~0x3u;
+
+    if (size_bytes != 4u) {
+        /* Sub-word writes to DWT are UNPREDICTABLE; ignore them. */
+        return (size_bytes == 1u || size_bytes == 2u) ? MM_TRUE : MM_FALSE;
+    }
+    switch (aligned) {
+    case 0x000:
+        dwt_update_matches(scs);
+        dwt_latch(scs);
+        scs->dwt_ctrl = DWT_CTRL_RO | (value & 0x00FFFFFFu);
+        break;
+    case 0x004:
+        scs->dwt_cyccnt = value;
+        scs->dwt_cyccnt_sync = scs->cycles;
+        scs->dwt_match_last = value;
+        break;
+    case 0x008: scs->dwt_cpicnt = value & 0xFFu; break;
+    case 0x00C: scs->dwt_exccnt = value & 0xFFu; break;
+    case 0x010: scs->dwt_sleepcnt = value & 0xFFu; break;
+    case 0x014: scs->dwt_lsucnt = value & 0xFFu; break;
+    case 0x018: scs->dwt_foldcnt = value & 0xFFu; break;
+    default:
+        if (aligned >= 0x020u && aligned < 0x020u + MM_DWT_NUM_COMP * 16u) {
+            mm_u32 n = (aligned - 0x020u) / 16u;
+            dwt_update_matches(scs);
+            switch (aligned & 0xFu) {
+            case 0x0: scs->dwt_comp[n] = value; break;
+            case 0x8: scs->dwt_function[n] = value & ~DWT_FUNCTION_MATCHED; break;
+            default: break;
+            }
+        }
+        break;
+    }
+    return MM_TRUE;
+}
+
+/* ---- ITM ---- */
+static mm_bool itm_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    struct mm_scs *scs = (struct mm_scs *)opaque;
+    mm_u32 aligned = offset & ~0x3u;
+    mm_u32 val = 0;
+
+    if (value_out == 0 || (size_bytes != 1u && size_bytes != 2u && size_bytes != 4u)) {
+        return MM_FALSE;
+    }
+    if (aligned < 0x80u) {
+        val = 1u; /* STIMx: FIFOREADY, the ring never back-pressures */
+    } else if (aligned == 0xE00u) {
+        val = scs->itm_ter;
+    } else if (aligned == 0xE40u) {
+        val = scs->itm_tpr;
+    } else if (aligned == 0xE80u) {
+        val = scs->itm_tcr;
+    }
+    *value_out = (val >> ((offset & 0x3u) * 8u)) & ((size_bytes == 4u) ? 0xFFFFFFFFu : ((1u << (size_bytes * 8u)) - 1u));
+    return MM_TRUE;
+}
+
+static mm_bool itm_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    struct mm_scs *scs = (struct mm_scs *)opaque;
+    mm_u32 aligned = offset & ~0x3u;
+
+    if (size_bytes != 1u && size_bytes != 2u && size_bytes != 4u) {
+        return MM_FALSE;
+    }
+    if (aligned < 0x80u) {
+        mm_u32 port = aligned >> 2;
+        mm_u8 bytes[4];
+        if ((scs->demcr & DEMCR_TRCENA) == 0u || (scs->itm_tcr & ITM_TCR_ITMENA) == 0u ||
+            (scs->itm_ter & (1u << port)) == 0u || scs->itm_sink == 0) {
+            return MM_TRUE;
+        }
+        bytes[0] = (mm_u8)(value & 0xFFu);
+        bytes[1] = (mm_u8)((value >> 8) & 0xFFu);
+        bytes[2] = (mm_u8)((value >> 16) & 0xFFu);
+        bytes[3] = (mm_u8)((value >> 24) & 0xFFu);
+        mm_itm_sink_push(scs->itm_sink, bytes, size_bytes);
+        return MM_TRUE;
+    }
+    if (size_bytes != 4u) {
+        return MM_TRUE;
+    }
+    if (aligned == 0xE00u) {
+        scs->itm_ter = value;
+    } else if (aligned == 0xE40u) {
+        scs->itm_tpr = value & 0xFu;
+    } else if (aligned == 0xE80u) {
+        scs->itm_tcr = value & 0x00FF0F1Fu;
+    }
+    return MM_TRUE;
+}
+
+void mm_scs_set_cpu(struct mm_scs *scs, struct mm_cpu *cpu)
+{
+    if (scs == 0) return;
+    scs->cpu = cpu;
+}
+
+void mm_scs_set_itm_sink(struct mm_scs *scs, struct mm_itm_sink *sink)
+{
+    if (scs != 0) {
+        scs->itm_sink = sink;
+    }
+}
+
+mm_bool mm_scs_register_debug_regions(struct mm_scs *scs, struct mmio_bus *bus)
+{
+    struct mmio_region reg;
+
+    memset(&reg, 0, sizeof(reg));
+    reg.base = 0xE0000000u;
+    reg.size = 0x1000u;
+    reg.opaque = scs;
+    reg.read = itm_read;
+    reg.write = itm_write;
+    if (!mmio_bus_register_region(bus, &reg)) return MM_FALSE;
+
+    reg.base = 0xE0001000u;
+    reg.size = 0x1000u;
+    reg.opaque = scs;
+    reg.read = dwt_read;
+    reg.write = dwt_write;
+    return mmio_bus_register_region(bus, &reg);
+}
+
 mm_bool mm_scs_register_regions(struct mm_scs *scs, struct mmio_bus *bus, mm_u32 base_secure, mm_u32 base_nonsecure, struct mm_nvic *nvic)
 {
     static struct mm_scs_mmio ctx_secure;
@@ -1005,6 +1318,7 @@ mm_bool mm_scs_register_regions(struct mm_scs *scs, struct mmio_bus *bus, mm_u32
 
     /* Convert the SCB base passed by the caller (0xE000ED00) to the SCS page base. */
     page_base_secure = base_secure - SCS_SCB_OFFSET;
+    memset(&reg_s, 0, sizeof(reg_s));
     reg_s.base = page_base_secure;
     reg_s.size = SCS_PAGE_SIZE;
     reg_s.opaque = &ctx_secure;
@@ -1018,6 +1332,7 @@ mm_bool mm_scs_register_regions(struct mm_scs *scs, struct mmio_bus *bus, mm_u32
         ctx_nonsecure.nvic = nvic;
         ctx_nonsecure.sec = MM_NONSECURE;
         page_base_ns = base_nonsecure - SCS_SCB_OFFSET;
+        memset(&reg_ns, 0, sizeof(reg_ns));
         reg_ns.base = page_base_ns;
         reg_ns.size = SCS_PAGE_SIZE;
         reg_ns.opaque = &ctx_nonsecure;
@@ -0,0 +1,652 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "m33mu/semihost.h"
+#include "m33mu/replay.h"
+
+#define SH_NAME_MAX 256u
+#define SH_BOUNCE 1024u
+#define SH_WRITE0_MAX 4096u
+
+/* Extension bytes returned by ":semihosting-features": magic then flags. */
+#define SH_EXT_EXIT_EXTENDED 0x01u
+#define SH_EXT_STDOUT_STDERR 0x02u
+static const mm_u8 sh_features[5] = { 'S', 'H', 'F', 'B',
+                                      SH_EXT_EXIT_EXTENDED | SH_EXT_STDOUT_STDERR };
+
+static mm_u64 sh_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mm_u64)ts.tv_sec * 1000000000ull + (mm_u64)ts.tv_nsec;
+}
+
+/* Console input is host input: recorded with --record, taken from the log
+ * with --replay. Files are assumed to be the same on both runs. */
+static ssize_t sh_read_fd(const struct mm_semihost_file *file, void *buf, mm_u32 len)
+{
+    ssize_t n;
+    mm_u32 got = 0;
+    if (file->kind != MM_SEMIHOST_FILE_CONSOLE) {
+        return read(file->fd, buf, len);
+    }
+    if (mm_replay_playing()) {
+        (void)mm_replay_take(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_READ, buf, len, &got);
+        return (ssize_t)got;
+    }
+    n = read(file->fd, buf, len);
+    if (n >= 0) {
+        mm_replay_put(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_READ, buf, (mm_u32)n);
+    }
+    return n;
+}
+
+static mm_bool sh_read32(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 *out)
+{
+    return mm_memmap_read(map, sec, addr, 4u, out);
+}
+
+static mm_bool sh_write32(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u32 value)
+{
+    return mm_memmap_write(map, sec, addr, 4u, value);
+}
+
+static mm_bool sh_read_args(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block,
+                            mm_u32 *args, mm_u32 count)
+{
+    mm_u32 i;
+    for (i = 0; i < count; ++i) {
+        if (!sh_read32(map, sec, block + i * 4u, &args[i])) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static mm_bool sh_copy_in(const struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, mm_u8 *dst, mm_u32 len)
+{
+    const mm_u8 *src = mm_memmap_guest_read_ptr(map, sec, addr, len);
+    mm_u32 i;
+    if (src != 0) {
+        memcpy(dst, src, len);
+        return MM_TRUE;
+    }
+    for (i = 0; i < len; ++i) {
+        if (!mm_memmap_read8(map, sec, addr + i, &dst[i])) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static mm_bool sh_copy_out(struct mm_memmap *map, enum mm_sec_state sec, mm_u32 addr, const mm_u8 *src, mm_u32 len)
+{
+    mm_u8 *dst = mm_memmap_guest_write_ptr(map, sec, addr, len);
+    mm_u32 i;
+    if (dst != 0) {
+        memcpy(dst, src, len);
+        return MM_TRUE;
+    }
+    for (i = 0; i < len; ++i) {
+        if (!mm_memmap_write8(map, sec, addr + i, src[i])) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+static struct mm_semihost_file *sh_file(struct mm_semihost *sh, mm_u32 handle)
+{
+    if (handle == 0u || handle > (mm_u32)MM_SEMIHOST_MAX_FILES) {
+        return 0;
+    }
+    if (sh->files[handle - 1u].kind == MM_SEMIHOST_FILE_FREE) {
+        return 0;
+    }
+    return &sh->files[handle - 1u];
+}
+
+static int sh_alloc(struct mm_semihost *sh)
+{
+    int i;
+    for (i = 0; i < MM_SEMIHOST_MAX_FILES; ++i) {
+        if (sh->files[i].kind == MM_SEMIHOST_FILE_FREE) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void sh_close_file(struct mm_semihost_file *file)
+{
+    if (file->kind == MM_SEMIHOST_FILE_HOST && file->fd >= 0) {
+        close(file->fd);
+    }
+    file->kind = MM_SEMIHOST_FILE_FREE;
+    file->fd = -1;
+    file->pos = 0;
+}
+
+/* Map a guest file name to a host path under the sandbox root. */
+static mm_bool sh_resolve(struct mm_semihost *sh, const char *name, char *out, size_t out_len)
+{
+    const char *p = name;
+    char dir[PATH_MAX];
+    char real[PATH_MAX];
+    char *slash;
+    size_t rlen;
+
+    if (name[0] == '\0' || name[0] == '/') {
+        return MM_FALSE;
+    }
+    while (*p != '\0') {
+        const char *e = strchr(p, '/');
+        size_t n = (e != 0) ? (size_t)(e - p) : strlen(p);
+        if (n == 2u && p[0] == '.' && p[1] == '.') {
+            return MM_FALSE;
+        }
+        p += n;
+        if (*p == '/') {
+            p++;
+        }
+    }
+    if ((size_t)snprintf(out, out_len, "%s/%s", sh->root, name) >= out_len) {
+        return MM_FALSE;
+    }
+    /* Symlinked directories must not lead out of the root either. */
+    snprintf(dir, sizeof(dir), "%s", out);
+    slash = strrchr(dir, '/');
+    if (slash != 0) {
+        *slash = '\0';
+    }
+    if (realpath(dir, real) == 0) {
+        return MM_FALSE;
+    }
+    rlen = strlen(sh->root);
+    if (strncmp(real, sh->root, rlen) != 0 || (real[rlen] != '\0' && real[rlen] != '/')) {
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_semihost_init(struct mm_semihost *sh)
+{
+    int i;
+    memset(sh, 0, sizeof(*sh));
+    for (i = 0; i < MM_SEMIHOST_MAX_FILES; ++i) {
+        sh->files[i].fd = -1;
+    }
+    sh->host0_ns = sh_now_ns();
+}
+
+mm_bool mm_semihost_enable(struct mm_semihost *sh, const char *root)
+{
+    if (root == 0 || root[0] == '\0') {
+        root = ".";
+    }
+    if (realpath(root, sh->root) == 0) {
+        return MM_FALSE;
+    }
+    sh->enabled = MM_TRUE;
+    sh->host0_ns = sh_now_ns();
+    return MM_TRUE;
+}
+
+void mm_semihost_bind_clock(struct mm_semihost *sh, const mm_u64 *cycles, const mm_u64 *cpu_hz)
+{
+    sh->cycles = cycles;
+    sh->cpu_hz = cpu_hz;
+}
+
+void mm_semihost_reset(struct mm_semihost *sh)
+{
+    int i;
+    for (i = 0; i < MM_SEMIHOST_MAX_FILES; ++i) {
+        sh_close_file(&sh->files[i]);
+    }
+    sh->last_errno = 0;
+    sh->exit_requested = MM_FALSE;
+    sh->exit_code = 0;
+}
+
+static mm_u32 sh_fail(struct mm_semihost *sh, int err)
+{
+    sh->last_errno = err;
+    return 0xFFFFFFFFu;
+}
+
+static mm_u32 sh_open(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 a[3];
+    char name[SH_NAME_MAX + 1u];
+    char path[PATH_MAX];
+    struct mm_semihost_file *file;
+    int slot;
+    int flags;
+    int fd;
+
+    if (!sh_read_args(map, sec, block, a, 3u) || a[2] > SH_NAME_MAX || a[1] > 11u) {
+        return sh_fail(sh, EINVAL);
+    }
+    if (!sh_copy_in(map, sec, a[0], (mm_u8 *)name, a[2])) {
+        return sh_fail(sh, EFAULT);
+    }
+    name[a[2]] = '\0';
+    slot = sh_alloc(sh);
+    if (slot < 0) {
+        return sh_fail(sh, EMFILE);
+    }
+    file = &sh->files[slot];
+    if (strcmp(name, ":tt") == 0) {
+        file->kind = MM_SEMIHOST_FILE_CONSOLE;
+        file->fd = (a[1] < 4u) ? STDIN_FILENO : (a[1] < 8u) ? STDOUT_FILENO : STDERR_FILENO;
+        return (mm_u32)slot + 1u;
+    }
+    if (strcmp(name, ":semihosting-features") == 0) {
+        if (a[1] >= 4u) {
+            return sh_fail(sh, EACCES);
+        }
+        file->kind = MM_SEMIHOST_FILE_FEATURES;
+        file->fd = -1;
+        file->pos = 0;
+        return (mm_u32)slot + 1u;
+    }
+    if (!sh_resolve(sh, name, path, sizeof(path))) {
+        return sh_fail(sh, EACCES);
+    }
+    /* ISO C fopen modes r, rb, r+, r+b, w, wb, w+, w+b, a, ab, a+, a+b */
+    switch (a[1] >> 2) {
+    case 0: flags = (a[1] & 2u) ? O_RDWR : O_RDONLY; break;
+    case 1: flags = ((a[1] & 2u) ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+    default: flags = ((a[1] & 2u) ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND; break;
+    }
+    fd = open(path, flags | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return sh_fail(sh, errno);
+    }
+    file->kind = MM_SEMIHOST_FILE_HOST;
+    file->fd = fd;
+    file->pos = 0;
+    return (mm_u32)slot + 1u;
+}
+
+/* SYS_WRITE: returns the number of bytes that were NOT written. */
+static mm_u32 sh_write(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 a[3];
+    struct mm_semihost_file *file;
+    const mm_u8 *src;
+    mm_u8 bounce[SH_BOUNCE];
+    mm_u32 done = 0;
+
+    if (!sh_read_args(map, sec, block, a, 3u)) {
+        return sh_fail(sh, EFAULT);
+    }
+    file = sh_file(sh, a[0]);
+    if (file == 0 || file->kind == MM_SEMIHOST_FILE_FEATURES) {
+        sh->last_errno = EBADF;
+        return a[2];
+    }
+    if (file->fd == STDOUT_FILENO || file->fd == STDERR_FILENO) {
+        fflush(stdout);
+    }
+    src = mm_memmap_guest_read_ptr(map, sec, a[1], a[2]);
+    while (done < a[2]) {
+        const mm_u8 *p;
+        mm_u32 chunk = a[2] - done;
+        ssize_t n;
+        if (src != 0) {
+            p = src + done;
+        } else {
+            if (chunk > SH_BOUNCE) {
+                chunk = SH_BOUNCE;
+            }
+            if (!sh_copy_in(map, sec, a[1] + done, bounce, chunk)) {
+                sh->last_errno = EFAULT;
+                break;
+            }
+            p = bounce;
+        }
+        n = write(file->fd, p, chunk);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sh->last_errno = errno;
+            break;
+        }
+        done += (mm_u32)n;
+    }
+    return a[2] - done;
+}
+
+/* SYS_READ: returns the number of bytes that were NOT read (len on EOF). */
+static mm_u32 sh_read(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 a[3];
+    struct mm_semihost_file *file;
+    mm_u8 *dst;
+    mm_u8 bounce[SH_BOUNCE];
+    mm_u32 done = 0;
+
+    if (!sh_read_args(map, sec, block, a, 3u)) {
+        return sh_fail(sh, EFAULT);
+    }
+    file = sh_file(sh, a[0]);
+    if (file == 0) {
+        sh->last_errno = EBADF;
+        return a[2];
+    }
+    if (file->kind == MM_SEMIHOST_FILE_FEATURES) {
+        mm_u32 avail = (file->pos < sizeof(sh_features)) ? (mm_u32)sizeof(sh_features) - file->pos : 0u;
+        mm_u32 n = (a[2] < avail) ? a[2] : avail;
+        if (n > 0u && !sh_copy_out(map, sec, a[1], sh_features + file->pos, n)) {
+            sh->last_errno = EFAULT;
+            return a[2];
+        }
+        file->pos += n;
+        return a[2] - n;
+    }
+    dst = mm_memmap_guest_write_ptr(map, sec, a[1], a[2]);
+    while (done < a[2]) {
+        mm_u32 chunk = a[2] - done;
+        ssize_t n;
+        if (dst != 0) {
+            n = sh_read_fd(file, dst + done, chunk);
+        } else {
+            if (chunk > SH_BOUNCE) {
+                chunk = SH_BOUNCE;
+            }
+            n = sh_read_fd(file, bounce, chunk);
+            if (n > 0 && !sh_copy_out(map, sec, a[1] + done, bounce, (mm_u32)n)) {
+                sh->last_errno = EFAULT;
+                break;
+            }
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sh->last_errno = errno;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += (mm_u32)n;
+        /* A console read returns after one line, like the Arm debug agents. */
+        if (file->kind == MM_SEMIHOST_FILE_CONSOLE) {
+            break;
+        }
+    }
+    return a[2] - done;
+}
+
+static mm_u32 sh_seek(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 a[2];
+    struct mm_semihost_file *file;
+
+    if (!sh_read_args(map, sec, block, a, 2u)) {
+        return sh_fail(sh, EFAULT);
+    }
+    file = sh_file(sh, a[0]);
+    if (file == 0 || file->kind == MM_SEMIHOST_FILE_CONSOLE) {
+        return sh_fail(sh, EBADF);
+    }
+    if (file->kind == MM_SEMIHOST_FILE_FEATURES) {
+        if (a[1] > sizeof(sh_features)) {
+            return sh_fail(sh, EINVAL);
+        }
+        file->pos = a[1];
+        return 0u;
+    }
+    if (lseek(file->fd, (off_t)a[1], SEEK_SET) < 0) {
+        return sh_fail(sh, errno);
+    }
+    return 0u;
+}
+
+static mm_u32 sh_flen(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 handle;
+    struct mm_semihost_file *file;
+    struct stat st;
+
+    if (!sh_read32(map, sec, block, &handle)) {
+        return sh_fail(sh, EFAULT);
+    }
+    file = sh_file(sh, handle);
+    if (file == 0 || file->kind == MM_SEMIHOST_FILE_CONSOLE) {
+        return sh_fail(sh, EBADF);
+    }
+    if (file->kind == MM_SEMIHOST_FILE_FEATURES) {
+        return (mm_u32)sizeof(sh_features);
+    }
+    if (fstat(file->fd, &st) != 0) {
+        return sh_fail(sh, errno);
+    }
+    return (mm_u32)st.st_size;
+}
+
+static mm_u32 sh_remove(struct mm_semihost *sh, struct mm_memmap *map, enum mm_sec_state sec, mm_u32 block)
+{
+    mm_u32 a[2];
+    char name[SH_NAME_MAX + 1u];
+    char path[PATH_MAX];
+
+    if (!sh_read_args(map, sec, block, a, 2u) || a[1] > SH_NAME_MAX) {
+        return sh_fail(sh, EINVAL);
+    }
+    if (!sh_copy_in(map, sec, a[0], (mm_u8 *)name, a[1])) {
+        return sh_fail(sh, EFAULT);
+    }
+    name[a[1]] = '\0';
+    if (!sh_resolve(sh, name, path, sizeof(path))) {
+        return sh_fail(sh, EACCES);
+    }
+    if (unlink(path) != 0) {
+        return sh_fail(sh, errno);
+    }
+    return 0u;
+}
+
+static mm_u64 sh_cycles(const struct mm_semihost *sh)
+{
+    return (sh->cycles != 0) ? *sh->cycles : 0u;
+}
+
+static mm_u64 sh_hz(const struct mm_semihost *sh)
+{
+    return (sh->cpu_hz != 0 && *sh->cpu_hz != 0u) ? *sh->cpu_hz : 1000000000ull;
+}
+
+static void sh_exit(struct mm_semihost *sh, mm_u32 reason, mm_u32 subcode)
+{
+    sh->exit_requested = MM_TRUE;
+    if (reason == MM_SEMIHOST_ADP_APPLICATION_EXIT) {
+        sh->exit_code = (int)subcode;
+    } else {
+        sh->exit_code = 1;
+    }
+    fflush(stdout);
+}
+
+mm_bool mm_semihost_call(struct mm_semihost *sh, struct mm_cpu *cpu, struct mm_memmap *map)
+{
+    enum mm_sec_state sec = cpu->sec_state;
+    mm_u32 op = cpu->r[0];
+    mm_u32 arg = cpu->r[1];
+    mm_u32 ret = 0;
+    mm_u32 a[2];
+
+    switch (op) {
+    case MM_SEMIHOST_SYS_OPEN:
+        ret = sh_open(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_CLOSE: {
+        struct mm_semihost_file *file;
+        if (!sh_read32(map, sec, arg, &a[0]) || (file = sh_file(sh, a[0])) == 0) {
+            ret = sh_fail(sh, EBADF);
+            break;
+        }
+        sh_close_file(file);
+    } break;
+    case MM_SEMIHOST_SYS_WRITEC: {
+        mm_u8 c;
+        if (mm_memmap_read8(map, sec, arg, &c)) {
+            fputc(c, stdout);
+            fflush(stdout);
+        }
+    } break;
+    case MM_SEMIHOST_SYS_WRITE0: {
+        mm_u8 c;
+        mm_u32 i;
+        for (i = 0; i < SH_WRITE0_MAX; ++i) {
+            if (!mm_memmap_read8(map, sec, arg + i, &c) || c == 0u) {
+                break;
+            }
+            fputc(c, stdout);
+        }
+        fflush(stdout);
+    } break;
+    case MM_SEMIHOST_SYS_WRITE:
+        ret = sh_write(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_READ:
+        ret = sh_read(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_READC: {
+        mm_u8 b = 0;
+        mm_u32 got = 0;
+        if (mm_replay_playing()) {
+            (void)mm_replay_take(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_READC, &b, 1u, &got);
+            ret = (got == 1u) ? (mm_u32)b : 0xFFFFFFFFu;
+        } else {
+            int c = getchar();
+            b = (mm_u8)c;
+            mm_replay_put(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_READC, &b, (c == EOF) ? 0u : 1u);
+            ret = (c == EOF) ? 0xFFFFFFFFu : (mm_u32)c;
+        }
+    } break;
+    case MM_SEMIHOST_SYS_ISERROR:
+        if (!sh_read32(map, sec, arg, &a[0])) {
+            ret = sh_fail(sh, EFAULT);
+            break;
+        }
+        ret = ((a[0] & 0x80000000u) != 0u) ? 1u : 0u;
+        break;
+    case MM_SEMIHOST_SYS_ISTTY: {
+        struct mm_semihost_file *file;
+        if (!sh_read32(map, sec, arg, &a[0]) || (file = sh_file(sh, a[0])) == 0) {
+            ret = sh_fail(sh, EBADF);
+            break;
+        }
+        ret = (file->kind == MM_SEMIHOST_FILE_CONSOLE) ? 1u : 0u;
+    } break;
+    case MM_SEMIHOST_SYS_SEEK:
+        ret = sh_seek(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_FLEN:
+        ret = sh_flen(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_REMOVE:
+        ret = sh_remove(sh, map, sec, arg);
+        break;
+    case MM_SEMIHOST_SYS_CLOCK:
+        /* Centiseconds of virtual time, so timing loops stay deterministic. */
+        if (sh->cycles != 0) {
+            ret = (mm_u32)((sh_cycles(sh) * 100u) / sh_hz(sh));
+        } else {
+            ret = (mm_u32)((sh_now_ns() - sh->host0_ns) / 10000000ull);
+        }
+        break;
+    case MM_SEMIHOST_SYS_TIME: {
+        mm_u64 t = 0;
+        if (!mm_replay_take_u64(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_TIME, &t)) {
+            t = (mm_u64)time(0);
+            mm_replay_put_u64(MM_REPLAY_CONSOLE, MM_REPLAY_CONSOLE_TIME, t);
+        }
+        ret = (mm_u32)t;
+    } break;
+    case MM_SEMIHOST_SYS_ERRNO:
+        ret = (mm_u32)sh->last_errno;
+        break;
+    case MM_SEMIHOST_SYS_GET_CMDLINE:
+        /* Empty command line: { buffer, length } */
+        if (!sh_read_args(map, sec, arg, a, 2u) || a[1] == 0u ||
+            !mm_memmap_write8(map, sec, a[0], 0u) || !sh_write32(map, sec, arg + 4u, 0u)) {
+            ret = sh_fail(sh, EFAULT);
+        }
+        break;
+    case MM_SEMIHOST_SYS_HEAPINFO: {
+        /* Zeroes tell the C library to use its link-time heap and stack. */
+        mm_u32 i;
+        if (!sh_read32(map, sec, arg, &a[0])) {
+            ret = sh_fail(sh, EFAULT);
+            break;
+        }
+        for (i = 0; i < 4u; ++i) {
+            if (!sh_write32(map, sec, a[0] + i * 4u, 0u)) {
+                ret = sh_fail(sh, EFAULT);
+                break;
+            }
+        }
+    } break;
+    case MM_SEMIHOST_SYS_EXIT:
+        /* AArch32 passes the reason code itself, not a parameter block. */
+        sh_exit(sh, arg, 0u);
+        break;
+    case MM_SEMIHOST_SYS_EXIT_EXTENDED:
+        if (!sh_read_args(map, sec, arg, a, 2u)) {
+            sh_exit(sh, 0u, 0u);
+            break;
+        }
+        sh_exit(sh, a[0], a[1]);
+        break;
+    case MM_SEMIHOST_SYS_ELAPSED: {
+        mm_u64 c = sh_cycles(sh);
+        if (!sh_write32(map, sec, arg, (mm_u32)c) ||
+            !sh_write32(map, sec, arg + 4u, (mm_u32)(c >> 32))) {
+            ret = sh_fail(sh, EFAULT);
+        }
+    } break;
+    case MM_SEMIHOST_SYS_TICKFREQ:
+        ret = (mm_u32)sh_hz(sh);
+        break;
+    default:
+        cpu->r[0] = sh_fail(sh, ENOSYS);
+        return MM_FALSE;
+    }
+    cpu->r[0] = ret;
+    return MM_TRUE;
+}
@@ -29,9 +29,13 @@
 #include <stdlib.h>
 #include <errno.h>
 #include "m33mu/target_hal.h"
+#include "m33mu/reactor.h"
+#include "m33mu/replay.h"
 
 mm_bool mm_tui_is_active(void);
 
+#define UART_RING_SIZE 4096u
+
 static mm_bool g_uart_stdout = MM_FALSE;
 
 static int uart_open_pty(char *out, size_t outlen)
@@ -75,6 +79,7 @@ void mm_uart_io_init(struct mm_uart_io *io)
 mm_bool mm_uart_io_open(struct mm_uart_io *io, mm_u32 base)
 {
     if (io == 0) return MM_FALSE;
+    io->base = base;
     if (g_uart_stdout && !mm_tui_is_active()) {
         io->fd = STDOUT_FILENO;
         io->stdout_only = MM_TRUE;
@@ -84,6 +89,12 @@ mm_bool mm_uart_io_open(struct mm_uart_io *io, mm_u32 base)
     }
     io->fd = uart_open_pty(io->name, sizeof(io->name));
     if (io->fd >= 0) {
+        io->chan = mm_reactor_open(MM_CHAN_STREAM, io->fd, 0, UART_RING_SIZE, UART_RING_SIZE);
+        if (io->chan == 0) {
+            close(io->fd);
+            io->fd = -1;
+            return MM_FALSE;
+        }
         printf("[UART] %08lx attached to %s\n", (unsigned long)base, io->name);
         return MM_TRUE;
     }
@@ -93,8 +104,10 @@ mm_bool mm_uart_io_open(struct mm_uart_io *io, mm_u32 base)
 void mm_uart_io_close(struct mm_uart_io *io)
 {
     if (io == 0) return;
-    if (io->fd >= 0 && !io->stdout_only) {
-        close(io->fd);
+    if (io->chan != 0) {
+        /* The reactor owns and closes the PTY. */
+        mm_reactor_close(io->chan);
+        io->chan = 0;
         io->fd = -1;
     }
     io->rx_pending = MM_FALSE;
@@ -105,6 +118,11 @@ void mm_uart_io_queue_tx(struct mm_uart_io *io, mm_u8 byte)
 {
     size_t next_tail;
     if (io == 0) return;
+    if (io->chan != 0) {
+        /* Dropped when the host is not keeping up; TXE stays low until then. */
+        (void)mm_chan_write(io->chan, &byte, 1u);
+        return;
+    }
     next_tail = (io->tx_tail + 1u) % sizeof(io->tx_buf);
     if (next_tail == io->tx_head) {
         io->tx_head = (io->tx_head + 1u) % sizeof(io->tx_buf);
@@ -116,6 +134,7 @@ void mm_uart_io_queue_tx(struct mm_uart_io *io, mm_u8 byte)
 mm_bool mm_uart_io_flush(struct mm_uart_io *io)
 {
     if (io == 0 || io->fd < 0) return MM_FALSE;
+    if (io->chan != 0) return MM_TRUE;
     while (io->tx_head != io->tx_tail) {
         size_t first_chunk;
         size_t to_write;
@@ -142,11 +161,16 @@ mm_bool mm_uart_io_poll(struct mm_uart_io *io)
     mm_bool new_rx = MM_FALSE;
     if (io == 0 || io->fd < 0) return MM_FALSE;
     if (io->stdout_only) return MM_FALSE;
-    (void)mm_uart_io_flush(io);
     if (!io->rx_pending) {
         mm_u8 b;
-        ssize_t n = read(io->fd, &b, 1);
-        if (n == 1) {
+        mm_bool got;
+        if (mm_replay_playing()) {
+            got = mm_replay_take(MM_REPLAY_UART_RX, io->base, &b, 1u, 0);
+        } else {
+            got = (mm_chan_read(io->chan, &b, 1u) == 1u) ? MM_TRUE : MM_FALSE;
+            if (got) mm_replay_put(MM_REPLAY_UART_RX, io->base, &b, 1u);
+        }
+        if (got) {
             io->rx_byte = b;
             io->rx_pending = MM_TRUE;
             new_rx = MM_TRUE;
@@ -158,6 +182,17 @@ mm_bool mm_uart_io_poll(struct mm_uart_io *io)
 mm_bool mm_uart_io_tx_empty(const struct mm_uart_io *io)
 {
     if (io == 0) return MM_TRUE;
+    if (io->chan != 0) {
+        /* How fast the host drains the PTY is an input like any other. */
+        if (mm_replay_playing()) {
+            return mm_replay_take(MM_REPLAY_UART_BUSY, io->base, 0, 0u, 0) ? MM_FALSE : MM_TRUE;
+        }
+        if (mm_chan_tx_space(io->chan) == 0u) {
+            mm_replay_put(MM_REPLAY_UART_BUSY, io->base, 0, 0u);
+            return MM_FALSE;
+        }
+        return MM_TRUE;
+    }
     return io->tx_head == io->tx_tail;
 }
 
@@ -44,3 +44,11 @@ void mm_timer_tick(const struct mm_target_cfg *cfg, mm_u64 cycles)
     }
     cfg->timer_tick(cycles);
 }
+
+mm_u64 mm_timer_next_event(const struct mm_target_cfg *cfg)
+{
+    if (cfg == 0 || cfg->timer_next_event == 0) {
+        return (mm_u64)-1;
+    }
+    return cfg->timer_next_event();
+}
@@ -0,0 +1,559 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+#include "m33mu/trace.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef M33MU_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#define TRACE_IO_CHUNK 65536u
+
+mm_bool mm_trace_zstd_available(void)
+{
+#ifdef M33MU_HAS_ZSTD
+    return MM_TRUE;
+#else
+    return MM_FALSE;
+#endif
+}
+
+static void put_le16(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v & 0xffu);
+    p[1] = (mm_u8)((v >> 8) & 0xffu);
+}
+
+static void put_le32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)(v & 0xffu);
+    p[1] = (mm_u8)((v >> 8) & 0xffu);
+    p[2] = (mm_u8)((v >> 16) & 0xffu);
+    p[3] = (mm_u8)((v >> 24) & 0xffu);
+}
+
+static mm_u32 get_le16(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8);
+}
+
+static mm_u32 get_le32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static mm_bool write_all(int fd, const mm_u8 *p, size_t n)
+{
+    while (n > 0u) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return MM_FALSE;
+        }
+        p += (size_t)w;
+        n -= (size_t)w;
+    }
+    return MM_TRUE;
+}
+
+static void trace_sleep_us(long us)
+{
+    struct timespec req;
+    req.tv_sec = 0;
+    req.tv_nsec = us * 1000L;
+    nanosleep(&req, 0);
+}
+
+/* ---- Writer: background drain ---- */
+
+static void trace_sink(struct mm_trace_writer *tw, const mm_u8 *p, size_t n, mm_bool end)
+{
+#ifdef M33MU_HAS_ZSTD
+    if (tw->compress) {
+        static mm_u8 out[TRACE_IO_CHUNK];
+        ZSTD_inBuffer in;
+        size_t rem;
+        in.src = p;
+        in.size = n;
+        in.pos = 0;
+        do {
+            ZSTD_outBuffer ob;
+            ob.dst = out;
+            ob.size = sizeof(out);
+            ob.pos = 0;
+            rem = ZSTD_compressStream2((ZSTD_CCtx *)tw->zctx, &ob, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(rem)) {
+                return;
+            }
+            (void)write_all(tw->fd, out, ob.pos);
+        } while (end ? (rem != 0u) : (in.pos < in.size));
+        return;
+    }
+#endif
+    (void)end;
+    (void)write_all(tw->fd, p, n);
+}
+
+static void *trace_thread_main(void *arg)
+{
+    struct mm_trace_writer *tw = (struct mm_trace_writer *)arg;
+    for (;;) {
+        mm_u32 tail = __atomic_load_n(&tw->tail, __ATOMIC_ACQUIRE);
+        mm_u32 head = tw->head;
+        if (head == tail) {
+            if (__atomic_load_n(&tw->stop, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            trace_sleep_us(1000);
+            continue;
+        }
+        while (head != tail) {
+            mm_u32 pos = head & (MM_TRACE_RING_SIZE - 1u);
+            mm_u32 chunk = tail - head;
+            if (chunk > MM_TRACE_RING_SIZE - pos) {
+                chunk = MM_TRACE_RING_SIZE - pos;
+            }
+            trace_sink(tw, &tw->ring[pos], chunk, MM_FALSE);
+            head += chunk;
+            __atomic_store_n(&tw->head, head, __ATOMIC_RELEASE);
+        }
+    }
+    trace_sink(tw, 0, 0, MM_TRUE);
+    return 0;
+}
+
+static void trace_put(struct mm_trace_writer *tw, const mm_u8 *p, mm_u32 n)
+{
+    mm_u32 tail = tw->tail;
+    mm_u32 pos;
+    mm_u32 first;
+    /* Never drop records: wait for the drain thread when the ring is full. */
+    while (MM_TRACE_RING_SIZE - (tail - __atomic_load_n(&tw->head, __ATOMIC_ACQUIRE)) < n) {
+        tw->stalls++;
+        sched_yield();
+    }
+    pos = tail & (MM_TRACE_RING_SIZE - 1u);
+    first = MM_TRACE_RING_SIZE - pos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(&tw->ring[pos], p, first);
+    memcpy(&tw->ring[0], p + first, n - first);
+    __atomic_store_n(&tw->tail, tail + n, __ATOMIC_RELEASE);
+}
+
+mm_bool mm_trace_open(struct mm_trace_writer *tw, const char *path, mm_bool compress)
+{
+    mm_u8 hdr[MM_TRACE_HEADER_SIZE];
+
+    if (tw == 0 || path == 0) {
+        return MM_FALSE;
+    }
+    memset(tw, 0, sizeof(*tw));
+    tw->fd = -1;
+    if (compress && !mm_trace_zstd_available()) {
+        return MM_FALSE;
+    }
+    tw->ring = (mm_u8 *)malloc(MM_TRACE_RING_SIZE);
+    if (tw->ring == 0) {
+        return MM_FALSE;
+    }
+    tw->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tw->fd < 0) {
+        free(tw->ring);
+        tw->ring = 0;
+        return MM_FALSE;
+    }
+    tw->compress = compress;
+#ifdef M33MU_HAS_ZSTD
+    if (compress) {
+        tw->zctx = ZSTD_createCCtx();
+        if (tw->zctx == 0) {
+            close(tw->fd);
+            free(tw->ring);
+            tw->ring = 0;
+            return MM_FALSE;
+        }
+        (void)ZSTD_CCtx_setParameter((ZSTD_CCtx *)tw->zctx, ZSTD_c_compressionLevel, 3);
+    }
+#endif
+    memcpy(hdr, MM_TRACE_MAGIC, 8);
+    put_le16(hdr + 8, MM_TRACE_VERSION);
+    put_le16(hdr + 10, compress ? MM_TRACE_FLAG_ZSTD : 0u);
+    put_le32(hdr + 12, 0u);
+    (void)write_all(tw->fd, hdr, sizeof(hdr));
+    if (pthread_create(&tw->thread, 0, trace_thread_main, tw) != 0) {
+        mm_trace_close(tw);
+        return MM_FALSE;
+    }
+    tw->running = MM_TRUE;
+    return MM_TRUE;
+}
+
+void mm_trace_close(struct mm_trace_writer *tw)
+{
+    if (tw == 0) {
+        return;
+    }
+    if (tw->running) {
+        __atomic_store_n(&tw->stop, 1, __ATOMIC_RELEASE);
+        pthread_join(tw->thread, 0);
+        tw->running = MM_FALSE;
+    }
+#ifdef M33MU_HAS_ZSTD
+    if (tw->zctx != 0) {
+        ZSTD_freeCCtx((ZSTD_CCtx *)tw->zctx);
+    }
+#endif
+    tw->zctx = 0;
+    if (tw->fd >= 0) {
+        close(tw->fd);
+        tw->fd = -1;
+    }
+    free(tw->ring);
+    tw->ring = 0;
+}
+
+static mm_u8 trace_state(const struct mm_cpu *cpu, mm_u8 len)
+{
+    mm_u8 st = (len == 4u) ? MM_TRACE_STATE_T32 : 0u;
+    if (cpu->sec_state == MM_NONSECURE) st |= MM_TRACE_STATE_NS;
+    if (cpu->mode == MM_HANDLER) st |= MM_TRACE_STATE_HANDLER;
+    return st;
+}
+
+static void trace_sync(struct mm_trace_writer *tw, const struct mm_cpu *cpu, mm_u8 state)
+{
+    mm_u8 rec[1 + 8 + 1 + MM_TRACE_NREGS * 4u];
+    mm_u32 i;
+    rec[0] = (mm_u8)MM_TRACE_REC_SYNC;
+    put_le32(rec + 1, (mm_u32)(tw->icount & 0xffffffffu));
+    put_le32(rec + 5, (mm_u32)(tw->icount >> 32));
+    rec[9] = state;
+    for (i = 0; i < 16u; ++i) {
+        tw->regs[i] = cpu->r[i];
+    }
+    tw->regs[MM_TRACE_REG_XPSR] = cpu->xpsr;
+    for (i = 0; i < MM_TRACE_NREGS; ++i) {
+        put_le32(rec + 10 + i * 4u, tw->regs[i]);
+    }
+    trace_put(tw, rec, (mm_u32)sizeof(rec));
+    tw->have_regs = MM_TRUE;
+    tw->since_sync = 0;
+}
+
+void mm_trace_insn(struct mm_trace_writer *tw, const struct mm_cpu *cpu, mm_u32 pc, mm_u32 insn, mm_u8 len)
+{
+    mm_u8 rec[1 + 1 + 4 + 4 + 2 + 16u * 4u];
+    mm_u32 n;
+    mm_u32 mask = 0;
+    mm_u32 mask_pos;
+    mm_u32 i;
+    mm_u8 state;
+
+    if (tw == 0 || !tw->running || cpu == 0) {
+        return;
+    }
+    state = trace_state(cpu, len);
+    if (!tw->have_regs || tw->since_sync >= MM_TRACE_SYNC_INTERVAL) {
+        trace_sync(tw, cpu, state);
+    }
+    rec[0] = (mm_u8)MM_TRACE_REC_INSN;
+    rec[1] = state;
+    put_le32(rec + 2, pc);
+    if (len == 4u) {
+        put_le32(rec + 6, insn);
+        n = 10;
+    } else {
+        put_le16(rec + 6, insn);
+        n = 8;
+    }
+    mask_pos = n;
+    n += 2u;
+    for (i = 0; i < 15u; ++i) {
+        if (cpu->r[i] != tw->regs[i]) {
+            tw->regs[i] = cpu->r[i];
+            put_le32(rec + n, cpu->r[i]);
+            n += 4u;
+            mask |= 1u << i;
+        }
+    }
+    if (cpu->xpsr != tw->regs[MM_TRACE_REG_XPSR]) {
+        tw->regs[MM_TRACE_REG_XPSR] = cpu->xpsr;
+        put_le32(rec + n, cpu->xpsr);
+        n += 4u;
+        mask |= 1u << 15;
+    }
+    tw->regs[15] = pc;
+    put_le16(rec + mask_pos, mask);
+    trace_put(tw, rec, n);
+    tw->icount++;
+    tw->since_sync++;
+}
+
+void mm_trace_mem_write(struct mm_trace_writer *tw, mm_u32 addr, mm_u32 size, mm_u32 value)
+{
+    mm_u8 rec[1 + 1 + 4 + 4];
+    if (tw == 0 || !tw->running || (size != 1u && size != 2u && size != 4u)) {
+        return;
+    }
+    rec[0] = (mm_u8)MM_TRACE_REC_MEMW;
+    rec[1] = (mm_u8)size;
+    put_le32(rec + 2, addr);
+    put_le32(rec + 6, value);
+    trace_put(tw, rec, 6u + size);
+}
+
+void mm_trace_exception(struct mm_trace_writer *tw, mm_u32 exc_num)
+{
+    mm_u8 rec[3];
+    if (tw == 0 || !tw->running) {
+        return;
+    }
+    rec[0] = (mm_u8)MM_TRACE_REC_EXC;
+    put_le16(rec + 1, exc_num);
+    trace_put(tw, rec, 3u);
+}
+
+void mm_trace_resync(struct mm_trace_writer *tw)
+{
+    if (tw != 0) {
+        tw->have_regs = MM_FALSE;
+    }
+}
+
+/* ---- Reader ---- */
+
+static mm_bool reader_fill(struct mm_trace_reader *tr)
+{
+    /* Compact, then append more decoded bytes. */
+    if (tr->buf_pos > 0u) {
+        memmove(tr->buf, tr->buf + tr->buf_pos, tr->buf_len - tr->buf_pos);
+        tr->buf_len -= tr->buf_pos;
+        tr->buf_pos = 0;
+    }
+    if (tr->eof) {
+        return MM_FALSE;
+    }
+#ifdef M33MU_HAS_ZSTD
+    if (tr->compressed) {
+        ZSTD_outBuffer ob;
+        ob.dst = tr->buf + tr->buf_len;
+        ob.size = TRACE_IO_CHUNK * 2u - tr->buf_len;
+        ob.pos = 0;
+        while (ob.pos == 0u) {
+            ZSTD_inBuffer ib;
+            size_t rc;
+            if (tr->in_pos >= tr->in_len) {
+                tr->in_len = fread(tr->in, 1, TRACE_IO_CHUNK, tr->f);
+                tr->in_pos = 0;
+                if (tr->in_len == 0u) {
+                    tr->eof = MM_TRUE;
+                    return MM_FALSE;
+                }
+            }
+            ib.src = tr->in;
+            ib.size = tr->in_len;
+            ib.pos = tr->in_pos;
+            rc = ZSTD_decompressStream((ZSTD_DCtx *)tr->zctx, &ob, &ib);
+            tr->in_pos = ib.pos;
+            if (ZSTD_isError(rc)) {
+                tr->eof = MM_TRUE;
+                return MM_FALSE;
+            }
+        }
+        tr->buf_len += ob.pos;
+        return MM_TRUE;
+    }
+#endif
+    {
+        size_t got = fread(tr->buf + tr->buf_len, 1, TRACE_IO_CHUNK * 2u - tr->buf_len, tr->f);
+        if (got == 0u) {
+            tr->eof = MM_TRUE;
+            return MM_FALSE;
+        }
+        tr->buf_len += got;
+    }
+    return MM_TRUE;
+}
+
+/* Make at least n bytes available at buf_pos. */
+static mm_bool reader_need(struct mm_trace_reader *tr, size_t n)
+{
+    while (tr->buf_len - tr->buf_pos < n) {
+        if (!reader_fill(tr)) {
+            return MM_FALSE;
+        }
+    }
+    return MM_TRUE;
+}
+
+mm_bool mm_trace_reader_open(struct mm_trace_reader *tr, const char *path)
+{
+    mm_u8 hdr[MM_TRACE_HEADER_SIZE];
+    mm_u32 flags;
+
+    if (tr == 0 || path == 0) {
+        return MM_FALSE;
+    }
+    memset(tr, 0, sizeof(*tr));
+    tr->f = fopen(path, "rb");
+    if (tr->f == 0) {
+        return MM_FALSE;
+    }
+    if (fread(hdr, 1, sizeof(hdr), tr->f) != sizeof(hdr) ||
+        memcmp(hdr, MM_TRACE_MAGIC, 8) != 0 || get_le16(hdr + 8) != MM_TRACE_VERSION) {
+        mm_trace_reader_close(tr);
+        return MM_FALSE;
+    }
+    flags = get_le16(hdr + 10);
+    tr->compressed = (flags & MM_TRACE_FLAG_ZSTD) ? MM_TRUE : MM_FALSE;
+    if (tr->compressed) {
+#ifdef M33MU_HAS_ZSTD
+        tr->zctx = ZSTD_createDCtx();
+        tr->in = (mm_u8 *)malloc(TRACE_IO_CHUNK);
+        if (tr->zctx == 0 || tr->in == 0) {
+            mm_trace_reader_close(tr);
+            return MM_FALSE;
+        }
+#else
+        mm_trace_reader_close(tr);
+        return MM_FALSE;
+#endif
+    }
+    tr->buf = (mm_u8 *)malloc(TRACE_IO_CHUNK * 2u);
+    if (tr->buf == 0) {
+        mm_trace_reader_close(tr);
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+void mm_trace_reader_close(struct mm_trace_reader *tr)
+{
+    if (tr == 0) {
+        return;
+    }
+#ifdef M33MU_HAS_ZSTD
+    if (tr->zctx != 0) {
+        ZSTD_freeDCtx((ZSTD_DCtx *)tr->zctx);
+    }
+#endif
+    tr->zctx = 0;
+    if (tr->f != 0) {
+        fclose(tr->f);
+        tr->f = 0;
+    }
+    free(tr->in);
+    free(tr->buf);
+    tr->in = 0;
+    tr->buf = 0;
+}
+
+int mm_trace_reader_next(struct mm_trace_reader *tr, struct mm_trace_event *ev)
+{
+    const mm_u8 *p;
+    mm_u32 i;
+
+    if (tr == 0 || ev == 0 || tr->buf == 0) {
+        return -1;
+    }
+    if (!reader_need(tr, 1u)) {
+        return (tr->buf_len == tr->buf_pos) ? 0 : -1;
+    }
+    memset(ev, 0, sizeof(*ev));
+    ev->kind = tr->buf[tr->buf_pos];
+    switch (ev->kind) {
+    case MM_TRACE_REC_SYNC:
+        if (!reader_need(tr, 10u + MM_TRACE_NREGS * 4u)) return -1;
+        p = tr->buf + tr->buf_pos;
+        tr->icount = (mm_u64)get_le32(p + 1) | ((mm_u64)get_le32(p + 5) << 32);
+        ev->state = p[9];
+        for (i = 0; i < MM_TRACE_NREGS; ++i) {
+            tr->regs[i] = get_le32(p + 10 + i * 4u);
+        }
+        tr->have_regs = MM_TRUE;
+        ev->icount = tr->icount;
+        ev->pc = tr->regs[15];
+        tr->buf_pos += 10u + MM_TRACE_NREGS * 4u;
+        return 1;
+    case MM_TRACE_REC_INSN: {
+        size_t n;
+        mm_u32 mask;
+        if (!reader_need(tr, 2u)) return -1;
+        ev->len = (tr->buf[tr->buf_pos + 1u] & MM_TRACE_STATE_T32) ? 4u : 2u;
+        n = 2u + 4u + ev->len;
+        if (!reader_need(tr, n + 2u)) return -1;
+        p = tr->buf + tr->buf_pos;
+        mask = get_le16(p + n);
+        {
+            size_t total = n + 2u;
+            mm_u32 m = mask;
+            while (m != 0u) {
+                total += 4u;
+                m &= m - 1u;
+            }
+            if (!reader_need(tr, total)) return -1;
+            p = tr->buf + tr->buf_pos;
+            ev->state = p[1];
+            ev->pc = get_le32(p + 2);
+            ev->insn = (ev->len == 4u) ? get_le32(p + 6) : get_le16(p + 6);
+            ev->changed = (mm_u16)mask;
+            n += 2u;
+            for (i = 0; i < 16u; ++i) {
+                if (mask & (1u << i)) {
+                    tr->regs[(i == 15u) ? MM_TRACE_REG_XPSR : i] = get_le32(p + n);
+                    n += 4u;
+                }
+            }
+            tr->regs[15] = ev->pc;
+            ev->icount = tr->icount++;
+            tr->buf_pos += total;
+        }
+        return 1;
+    }
+    case MM_TRACE_REC_MEMW:
+        if (!reader_need(tr, 2u)) return -1;
+        ev->size = tr->buf[tr->buf_pos + 1u];
+        if (ev->size != 1u && ev->size != 2u && ev->size != 4u) return -1;
+        if (!reader_need(tr, 6u + ev->size)) return -1;
+        p = tr->buf + tr->buf_pos;
+        ev->addr = get_le32(p + 2);
+        ev->value = (ev->size == 4u) ? get_le32(p + 6) : (ev->size == 2u) ? get_le16(p + 6) : p[6];
+        tr->buf_pos += 6u + ev->size;
+        return 1;
+    case MM_TRACE_REC_EXC:
+        if (!reader_need(tr, 3u)) return -1;
+        ev->exc_num = get_le16(tr->buf + tr->buf_pos + 1u);
+        tr->buf_pos += 3u;
+        return 1;
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,277 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "m33mu/hostwait.h"
+#include "m33mu/vsync.h"
+
+#define VSYNC_CONNECT_RETRY_MS 5000
+
+enum {
+    VSYNC_HELLO = 1,
+    VSYNC_GRANT = 2,
+    VSYNC_REACHED = 3
+};
+
+/* Both ends run on the same host, so native byte order is fine. */
+struct vsync_msg {
+    mm_u32 type;
+    mm_u32 epoch;
+    mm_u64 time_ns;
+};
+
+static mm_bool vsync_addr(struct sockaddr_un *sa, const char *path)
+{
+    size_t len = strlen(path);
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (len == 0 || len >= sizeof(sa->sun_path)) {
+        fprintf(stderr, "vsync: socket path too long: %s\n", path);
+        return MM_FALSE;
+    }
+    memcpy(sa->sun_path, path, len + 1u);
+    return MM_TRUE;
+}
+
+static mm_bool vsync_send(int fd, mm_u32 type, mm_u32 epoch, mm_u64 time_ns)
+{
+    struct vsync_msg m;
+    memset(&m, 0, sizeof(m));
+    m.type = type;
+    m.epoch = epoch;
+    m.time_ns = time_ns;
+    return (send(fd, &m, sizeof(m), MSG_NOSIGNAL) == (ssize_t)sizeof(m)) ? MM_TRUE : MM_FALSE;
+}
+
+static void vsync_sleep_ms(long ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, 0);
+}
+
+mm_bool mm_vsync_connect(struct mm_vsync *vs, const char *path)
+{
+    struct sockaddr_un sa;
+    struct vsync_msg m;
+    int waited = 0;
+    ssize_t n;
+    if (vs == 0 || path == 0) return MM_FALSE;
+    memset(vs, 0, sizeof(*vs));
+    vs->fd = -1;
+    if (!vsync_addr(&sa, path)) return MM_FALSE;
+    for (;;) {
+        vs->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (vs->fd < 0) {
+            perror("vsync socket");
+            return MM_FALSE;
+        }
+        if (connect(vs->fd, (struct sockaddr *)&sa, sizeof(sa)) == 0) break;
+        close(vs->fd);
+        vs->fd = -1;
+        /* The coordinator may not be up yet. */
+        if ((errno != ENOENT && errno != ECONNREFUSED) || waited >= VSYNC_CONNECT_RETRY_MS) {
+            perror("vsync connect");
+            return MM_FALSE;
+        }
+        vsync_sleep_ms(10);
+        waited += 10;
+    }
+    if (!vsync_send(vs->fd, VSYNC_HELLO, 0, 0)) {
+        mm_vsync_close(vs);
+        return MM_FALSE;
+    }
+    /* Blocks until every node has joined. */
+    n = recv(vs->fd, &m, sizeof(m), 0);
+    if (n != (ssize_t)sizeof(m) || m.type != VSYNC_GRANT) {
+        fprintf(stderr, "vsync: coordinator closed before the first grant\n");
+        mm_vsync_close(vs);
+        return MM_FALSE;
+    }
+    vs->epoch = m.epoch;
+    vs->limit_ns = m.time_ns;
+    (void)fcntl(vs->fd, F_SETFL, fcntl(vs->fd, F_GETFL) | O_NONBLOCK);
+    (void)mm_hostwait_watch(&vs->fd);
+    return MM_TRUE;
+}
+
+enum mm_vsync_status mm_vsync_step(struct mm_vsync *vs, mm_u64 now_ns)
+{
+    struct vsync_msg m;
+    ssize_t n;
+    if (vs == 0 || vs->fd < 0) return MM_VSYNC_LOST;
+    if (!vs->reported) {
+        if (!vsync_send(vs->fd, VSYNC_REACHED, vs->epoch, now_ns)) return MM_VSYNC_LOST;
+        vs->reported = MM_TRUE;
+    }
+    n = recv(vs->fd, &m, sizeof(m), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return MM_VSYNC_WAITING;
+    }
+    if (n != (ssize_t)sizeof(m) || m.type != VSYNC_GRANT) return MM_VSYNC_LOST;
+    vs->epoch = m.epoch;
+    vs->limit_ns = m.time_ns;
+    vs->reported = MM_FALSE;
+    return MM_VSYNC_GRANTED;
+}
+
+void mm_vsync_close(struct mm_vsync *vs)
+{
+    if (vs == 0 || vs->fd < 0) return;
+    mm_hostwait_unwatch(&vs->fd);
+    close(vs->fd);
+    vs->fd = -1;
+}
+
+struct vsync_node {
+    int fd;
+    mm_bool reached;
+    mm_u64 time_ns;
+};
+
+static void vsync_grant_all(struct vsync_node *nodes, mm_u32 count, mm_u32 epoch, mm_u64 limit_ns)
+{
+    mm_u32 i;
+    for (i = 0; i < count; ++i) {
+        nodes[i].reached = MM_FALSE;
+        /* A node that vanished is noticed on its next read. */
+        (void)vsync_send(nodes[i].fd, VSYNC_GRANT, epoch, limit_ns);
+    }
+}
+
+static void vsync_drop(struct vsync_node *nodes, mm_u32 *count, mm_u32 i)
+{
+    close(nodes[i].fd);
+    nodes[i] = nodes[*count - 1u];
+    (*count)--;
+}
+
+int mm_vsync_coordinate(const char *path, mm_u32 nodes_wanted, mm_u64 quantum_ns)
+{
+    struct sockaddr_un sa;
+    struct vsync_node nodes[MM_VSYNC_MAX_NODES];
+    struct pollfd pfd[MM_VSYNC_MAX_NODES + 1u];
+    mm_u32 count = 0;
+    mm_u32 epoch = 1;
+    mm_bool started = MM_FALSE;
+    int lfd;
+    int rc = 0;
+    if (path == 0 || nodes_wanted == 0 || nodes_wanted > MM_VSYNC_MAX_NODES || quantum_ns == 0) {
+        return 1;
+    }
+    if (!vsync_addr(&sa, path)) return 1;
+    lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        perror("vsync socket");
+        return 1;
+    }
+    (void)unlink(path);
+    if (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(lfd, (int)nodes_wanted) < 0) {
+        perror("vsync bind");
+        close(lfd);
+        return 1;
+    }
+    for (;;) {
+        mm_u32 i;
+        mm_u32 polled = count;
+        mm_u32 reached = 0;
+        mm_u64 min_ns = (mm_u64)-1;
+        pfd[0].fd = lfd;
+        pfd[0].events = POLLIN;
+        pfd[0].revents = 0;
+        for (i = 0; i < count; ++i) {
+            pfd[i + 1u].fd = nodes[i].fd;
+            pfd[i + 1u].events = POLLIN;
+            pfd[i + 1u].revents = 0;
+        }
+        if (poll(pfd, (nfds_t)(count + 1u), -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("vsync poll");
+            rc = 1;
+            break;
+        }
+        if (pfd[0].revents & POLLIN) {
+            int cfd = accept4(lfd, 0, 0, SOCK_CLOEXEC);
+            if (cfd >= 0) {
+                if (started || count >= nodes_wanted) {
+                    /* The node set is fixed once time starts moving. */
+                    fprintf(stderr, "vsync: rejecting late node\n");
+                    close(cfd);
+                } else {
+                    nodes[count].fd = cfd;
+                    nodes[count].reached = MM_FALSE;
+                    nodes[count].time_ns = 0;
+                    count++;
+                }
+            }
+        }
+        /* Walk backwards so vsync_drop() can swap in the last entry. */
+        for (i = polled; i > 0u; --i) {
+            mm_u32 k = i - 1u;
+            struct vsync_msg m;
+            ssize_t n;
+            if ((pfd[k + 1u].revents & (POLLIN | POLLHUP | POLLERR)) == 0) continue;
+            n = recv(nodes[k].fd, &m, sizeof(m), MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (n != (ssize_t)sizeof(m)) {
+                vsync_drop(nodes, &count, k);
+                continue;
+            }
+            if (m.type == VSYNC_REACHED && m.epoch == epoch) {
+                nodes[k].reached = MM_TRUE;
+                nodes[k].time_ns = m.time_ns;
+            }
+        }
+        if (!started) {
+            if (count < nodes_wanted) continue;
+            started = MM_TRUE;
+            vsync_grant_all(nodes, count, epoch, quantum_ns);
+            continue;
+        }
+        if (count == 0) break;
+        for (i = 0; i < count; ++i) {
+            if (!nodes[i].reached) break;
+            reached++;
+            if (nodes[i].time_ns < min_ns) min_ns = nodes[i].time_ns;
+        }
+        if (reached == count) {
+            epoch++;
+            vsync_grant_all(nodes, count, epoch, min_ns + quantum_ns);
+        }
+    }
+    for (; count > 0u; --count) {
+        close(nodes[count - 1u].fd);
+    }
+    close(lfd);
+    (void)unlink(path);
+    return rc;
+}
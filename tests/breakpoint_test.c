@@ -0,0 +1,111 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include "m33mu/breakpoint.h"
+
+static int test_add_lookup_remove(void)
+{
+    struct mm_bp_set set;
+    mm_bp_set_init(&set);
+    if (mm_bp_set_lookup(&set, 0x08000100u)) return 1;
+    if (!mm_bp_set_add(&set, 0x08000100u)) return 1;
+    /* Thumb bit is ignored both ways. */
+    if (!mm_bp_set_lookup(&set, 0x08000101u)) return 1;
+    if (!mm_bp_set_lookup(&set, 0x08000100u)) return 1;
+    if (mm_bp_set_lookup(&set, 0x08000102u)) return 1;
+    if (!mm_bp_set_add(&set, 0x08000101u)) return 1;
+    if (mm_bp_set_count(&set) != 1u) return 1;
+    if (!mm_bp_set_remove(&set, 0x08000101u)) return 1;
+    if (mm_bp_set_lookup(&set, 0x08000100u)) return 1;
+    if (mm_bp_set_remove(&set, 0x08000100u)) return 1;
+    mm_bp_set_free(&set);
+    return 0;
+}
+
+static int test_no_fixed_limit(void)
+{
+    struct mm_bp_set set;
+    mm_u32 i;
+    int rc = 0;
+    mm_bp_set_init(&set);
+    for (i = 0; i < 1000u; ++i) {
+        if (!mm_bp_set_add(&set, 0x08000000u + i * 2u)) rc = 1;
+    }
+    if (mm_bp_set_count(&set) != 1000u) rc = 1;
+    for (i = 0; i < 1000u; ++i) {
+        if (!mm_bp_set_lookup(&set, 0x08000000u + i * 2u)) rc = 1;
+    }
+    /* Remove every other entry; the survivors must still be found. */
+    for (i = 0; i < 1000u; i += 2u) {
+        if (!mm_bp_set_remove(&set, 0x08000000u + i * 2u)) rc = 1;
+    }
+    for (i = 0; i < 1000u; ++i) {
+        mm_bool want = (i & 1u) != 0u;
+        if (mm_bp_set_lookup(&set, 0x08000000u + i * 2u) != want) rc = 1;
+    }
+    mm_bp_set_free(&set);
+    return rc;
+}
+
+static int test_filter_collision(void)
+{
+    struct mm_bp_set set;
+    mm_u32 a = 0x08000010u;
+    mm_u32 b = a + (MM_BP_FILTER_BITS * 2u); /* same filter bit */
+    mm_bp_set_init(&set);
+    if (!mm_bp_set_add(&set, a)) return 1;
+    if (mm_bp_set_lookup(&set, b)) return 1;
+    if (!mm_bp_set_add(&set, b)) return 1;
+    if (!mm_bp_set_remove(&set, a)) return 1;
+    if (!mm_bp_set_lookup(&set, b)) return 1;
+    if (mm_bp_set_lookup(&set, a)) return 1;
+    mm_bp_set_clear(&set);
+    if (mm_bp_set_lookup(&set, b)) return 1;
+    mm_bp_set_free(&set);
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "add_lookup_remove", test_add_lookup_remove },
+        { "no_fixed_limit", test_no_fixed_limit },
+        { "filter_collision", test_filter_collision },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("breakpoint_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/busywait.h"
+#include "m33mu/fetch.h"
+#include "stm32h563/stm32h563_mmio.h"
+#include "stm32h563/stm32h563_usart.h"
+
+#define CODE_BASE 0x08000000u
+#define DATA_BASE 0x20000000u
+#define MMIO_BASE 0x40000000u
+#define USART1_BASE 0x40013800u
+#define RCC_BASE 0x44020c00u
+
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[128];
+static mm_u8 g_code[64];
+static mm_u8 g_data[16];
+
+static void load_code(const mm_u16 *insns, int count)
+{
+    int i;
+    memset(g_code, 0, sizeof(g_code));
+    for (i = 0; i < count; ++i) {
+        g_code[i * 2] = (mm_u8)(insns[i] & 0xffu);
+        g_code[i * 2 + 1] = (mm_u8)(insns[i] >> 8);
+    }
+    mm_memmap_init(&g_map, g_regions, 128);
+    mm_memmap_add_rom(&g_map, CODE_BASE, sizeof(g_code), g_code, 0);
+    mm_memmap_add_rom(&g_map, DATA_BASE, sizeof(g_data), g_data, 0);
+}
+
+/* Retire the taken branch at 'tail' back to 'head' and consult the detector. */
+static mm_u32 take_branch(struct mm_busywait *bw, struct mm_cpu *cpu, mm_u32 tail, mm_u32 head)
+{
+    struct mm_fetch_result f;
+    struct mm_decoded d;
+    mm_u32 hw = 0;
+
+    mm_memmap_fetch_read16(&g_map, MM_SECURE, tail, &hw);
+    memset(&f, 0, sizeof(f));
+    f.insn = hw;
+    f.len = 2;
+    f.pc_fetch = tail;
+    d = mm_decode_t32(&f);
+    cpu->r[15] = head | 1u;
+    return mm_busywait_backedge(bw, cpu, &g_map, &d, tail);
+}
+
+static void cpu_setup(struct mm_cpu *cpu)
+{
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->sec_state = MM_SECURE;
+    cpu->mode = MM_THREAD;
+    cpu->r[2] = DATA_BASE;
+}
+
+static int test_poll_loop(void)
+{
+    /* loop: ldr r3,[r2]; cmp r3,#0; beq loop */
+    static const mm_u16 prog[] = { 0x6813u, 0x2b00u, 0xd0fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+
+    load_code(prog, 3);
+    cpu_setup(&cpu);
+    mm_busywait_init(&bw, MM_TRUE);
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != MM_BUSYWAIT_CHUNK_MIN) return 1;
+    mm_busywait_skipped(&bw, MM_BUSYWAIT_CHUNK_MIN);
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != MM_BUSYWAIT_CHUNK_MIN * 2u) return 1;
+    mm_busywait_skipped(&bw, MM_BUSYWAIT_CHUNK_MIN * 2u);
+    if (bw.skips != 2u || bw.skipped_cycles != MM_BUSYWAIT_CHUNK_MIN * 3u) return 1;
+
+    /* Any register change means the loop made progress. */
+    cpu.r[3] = 1u;
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != MM_BUSYWAIT_CHUNK_MIN) return 1;
+    return 0;
+}
+
+static int test_chunk_saturates(void)
+{
+    static const mm_u16 prog[] = { 0xe7feu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+    int i;
+
+    load_code(prog, 1);
+    cpu_setup(&cpu);
+    mm_busywait_init(&bw, MM_TRUE);
+    take_branch(&bw, &cpu, CODE_BASE, CODE_BASE);
+    for (i = 0; i < 32; ++i) {
+        mm_busywait_skipped(&bw, take_branch(&bw, &cpu, CODE_BASE, CODE_BASE));
+    }
+    if (take_branch(&bw, &cpu, CODE_BASE, CODE_BASE) != MM_BUSYWAIT_CHUNK_MAX) return 1;
+    mm_busywait_reset(&bw);
+    if (take_branch(&bw, &cpu, CODE_BASE, CODE_BASE) != 0u) return 1;
+    return 0;
+}
+
+static int test_store_loop_not_skipped(void)
+{
+    /* loop: ldr r3,[r2]; str r3,[r2,#4]; b loop */
+    static const mm_u16 prog[] = { 0x6813u, 0x6053u, 0xe7fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+    int i;
+
+    load_code(prog, 3);
+    cpu_setup(&cpu);
+    mm_busywait_init(&bw, MM_TRUE);
+    for (i = 0; i < 4; ++i) {
+        if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    }
+    return 0;
+}
+
+static int test_mmio_poll_not_skipped(void)
+{
+    /* loop: ldr r3,[r2]; cmp r3,#0; beq loop -- with r2 pointing at MMIO */
+    static const mm_u16 prog[] = { 0x6813u, 0x2b00u, 0xd0fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+    int i;
+
+    load_code(prog, 3);
+    cpu_setup(&cpu);
+    cpu.r[2] = MMIO_BASE;
+    mm_busywait_init(&bw, MM_TRUE);
+    for (i = 0; i < 4; ++i) {
+        if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    }
+    return 0;
+}
+
+/* Load the loop on top of the STM32H563 RCC, FLASH and USART models. */
+static int load_code_h563(const mm_u16 *insns, int count)
+{
+    load_code(insns, count);
+    if (!mm_stm32h563_register_mmio(&g_map.mmio)) return 1;
+    mm_stm32h563_usart_reset();
+    mm_stm32h563_usart_init(&g_map.mmio, 0);
+    return 0;
+}
+
+static int test_usart_txe_poll_skipped(void)
+{
+    /* loop: ldr r3,[r2,#0x1c]; lsls r3,r3,#24; bpl loop -- USART1 ISR.TXE */
+    static const mm_u16 prog[] = { 0x69d3u, 0x061bu, 0xd5fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+
+    if (load_code_h563(prog, 3) != 0) return 1;
+    cpu_setup(&cpu);
+    cpu.r[2] = USART1_BASE;
+    mm_busywait_init(&bw, MM_TRUE);
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != MM_BUSYWAIT_CHUNK_MIN) return 1;
+    return 0;
+}
+
+static int test_rcc_ready_poll_skipped(void)
+{
+    /* loop: ldr r3,[r2]; lsls r3,r3,#6; bpl loop -- RCC CR.PLL1RDY */
+    static const mm_u16 prog[] = { 0x6813u, 0x019bu, 0xd5fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+
+    if (load_code_h563(prog, 3) != 0) return 1;
+    cpu_setup(&cpu);
+    cpu.r[2] = RCC_BASE;
+    mm_busywait_init(&bw, MM_TRUE);
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != MM_BUSYWAIT_CHUNK_MIN) return 1;
+    return 0;
+}
+
+static int test_usart_rdr_poll_not_skipped(void)
+{
+    /* loop: ldr r3,[r2,#0x24]; cmp r3,#0; beq loop -- RDR pops the RX FIFO */
+    static const mm_u16 prog[] = { 0x6a53u, 0x2b00u, 0xd0fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+    int i;
+
+    if (load_code_h563(prog, 3) != 0) return 1;
+    cpu_setup(&cpu);
+    cpu.r[2] = USART1_BASE;
+    mm_busywait_init(&bw, MM_TRUE);
+    for (i = 0; i < 4; ++i) {
+        if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    }
+    return 0;
+}
+
+static int test_moving_base_not_skipped(void)
+{
+    /* loop: ldr r3,[r2]; movs r2,#0; b loop -- the load address is rewritten */
+    static const mm_u16 prog[] = { 0x6813u, 0x2200u, 0xe7fcu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+    int i;
+
+    load_code(prog, 3);
+    cpu_setup(&cpu);
+    mm_busywait_init(&bw, MM_TRUE);
+    for (i = 0; i < 4; ++i) {
+        if (take_branch(&bw, &cpu, CODE_BASE + 4u, CODE_BASE) != 0u) return 1;
+    }
+    return 0;
+}
+
+static int test_disabled(void)
+{
+    static const mm_u16 prog[] = { 0xe7feu };
+    struct mm_busywait bw;
+    struct mm_cpu cpu;
+
+    load_code(prog, 1);
+    cpu_setup(&cpu);
+    mm_busywait_init(&bw, MM_FALSE);
+    if (take_branch(&bw, &cpu, CODE_BASE, CODE_BASE) != 0u) return 1;
+    if (take_branch(&bw, &cpu, CODE_BASE, CODE_BASE) != 0u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "poll_loop", test_poll_loop },
+        { "chunk_saturates", test_chunk_saturates },
+        { "store_loop_not_skipped", test_store_loop_not_skipped },
+        { "mmio_poll_not_skipped", test_mmio_poll_not_skipped },
+        { "usart_txe_poll_skipped", test_usart_txe_poll_skipped },
+        { "rcc_ready_poll_skipped", test_rcc_ready_poll_skipped },
+        { "usart_rdr_poll_not_skipped", test_usart_rdr_poll_not_skipped },
+        { "moving_base_not_skipped", test_moving_base_not_skipped },
+        { "disabled", test_disabled },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("busywait_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -45,15 +45,16 @@ static void init_cpu(struct mm_cpu *cpu)
     cpu->basepri_s = cpu->basepri_ns = 0;
     cpu->faultmask_s = cpu->faultmask_ns = 0;
     cpu->vtor_s = cpu->vtor_ns = 0;
+    mm_cpu_sp_rebank(cpu);
 }
 
 static int test_thread_sp_sel(void)
 {
     struct mm_cpu cpu;
     init_cpu(&cpu);
-    cpu.control_s = 0; /* use MSP */
+    mm_cpu_set_control(&cpu, MM_SECURE, 0); /* use MSP */
     if (mm_cpu_get_active_sp(&cpu) != cpu.msp_s) return 1;
-    cpu.control_s = 0x2u; /* SPSEL -> PSP */
+    mm_cpu_set_control(&cpu, MM_SECURE, 0x2u); /* SPSEL -> PSP */
     if (mm_cpu_get_active_sp(&cpu) != cpu.psp_s) return 1;
     return 0;
 }
@@ -62,8 +63,8 @@ static int test_handler_uses_msp(void)
 {
     struct mm_cpu cpu;
     init_cpu(&cpu);
-    cpu.control_s = 0x2u; /* would select PSP in Thread */
-    cpu.mode = MM_HANDLER;
+    mm_cpu_set_control(&cpu, MM_SECURE, 0x2u); /* would select PSP in Thread */
+    mm_cpu_set_mode(&cpu, MM_HANDLER);
     if (mm_cpu_get_active_sp(&cpu) != cpu.msp_s) return 1;
     return 0;
 }
@@ -72,14 +73,38 @@ static int test_ns_banks(void)
 {
     struct mm_cpu cpu;
     init_cpu(&cpu);
-    cpu.sec_state = MM_NONSECURE;
-    cpu.control_ns = 0;
+    mm_cpu_set_security(&cpu, MM_NONSECURE);
+    mm_cpu_set_control(&cpu, MM_NONSECURE, 0);
     if (mm_cpu_get_active_sp(&cpu) != cpu.msp_ns) return 1;
-    cpu.control_ns = 0x2u;
+    mm_cpu_set_control(&cpu, MM_NONSECURE, 0x2u);
     if (mm_cpu_get_active_sp(&cpu) != cpu.psp_ns) return 1;
     return 0;
 }
 
+/* r13 is the live SP: writes land in the active bank and survive a round
+ * trip through another bank. */
+static int test_bank_switch_keeps_sp(void)
+{
+    struct mm_cpu cpu;
+    init_cpu(&cpu);
+    mm_cpu_set_active_sp(&cpu, 0x1ff0u);
+    if (cpu.r[13] != 0x1ff0u || cpu.msp_s != 0x1ff0u) return 1;
+    mm_cpu_set_control(&cpu, MM_SECURE, 0x2u);
+    if (cpu.r[13] != cpu.psp_s) return 1;
+    mm_cpu_set_active_sp(&cpu, 0x1f00u);
+    mm_cpu_set_mode(&cpu, MM_HANDLER);
+    if (cpu.r[13] != 0x1ff0u || cpu.psp_s != 0x1f00u) return 1;
+    mm_cpu_set_mode(&cpu, MM_THREAD);
+    if (cpu.r[13] != 0x1f00u) return 1;
+    /* MSR PSP while PSP is active updates r13 as well. */
+    mm_cpu_set_psp(&cpu, MM_SECURE, 0x1e00u);
+    if (mm_cpu_get_active_sp(&cpu) != 0x1e00u) return 1;
+    cpu.psplim_s = 0x1800u;
+    mm_cpu_sp_rebank(&cpu);
+    if (mm_cpu_get_active_splim(&cpu) != 0x1800u) return 1;
+    return 0;
+}
+
 static int test_privileged_flag(void)
 {
     struct mm_cpu cpu;
@@ -101,6 +126,7 @@ int main(void)
         { "thread_sp_sel", test_thread_sp_sel },
         { "handler_msp", test_handler_uses_msp },
         { "ns_banks", test_ns_banks },
+        { "bank_switch", test_bank_switch_keeps_sp },
         { "privileged_flag", test_privileged_flag },
     };
     int failures = 0;
@@ -0,0 +1,371 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "m33mu/eth_shm.h"
+
+static const mm_u8 mac_a[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0a };
+static const mm_u8 mac_b[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0b };
+static const mm_u8 mac_c[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0c };
+static const mm_u8 mac_x[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x99 };
+static const mm_u8 mac_bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+static int g_switch_seq;
+
+static void new_cfg(struct mm_eth_shm_cfg *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    snprintf(cfg->name, sizeof(cfg->name), "test%ld-%d", (long)getpid(), g_switch_seq++);
+    mm_eth_shm_unlink(cfg->name);
+}
+
+static mm_u32 make_frame(mm_u8 *f, const mm_u8 *dst, const mm_u8 *src, mm_u32 tag)
+{
+    memset(f, 0, 64);
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[12] = 0x88;
+    f[13] = 0xb5;
+    f[14] = (mm_u8)(tag & 0xffu);
+    f[15] = (mm_u8)((tag >> 8) & 0xffu);
+    return 64u;
+}
+
+static mm_u32 frame_tag(const mm_u8 *f)
+{
+    return (mm_u32)f[14] | ((mm_u32)f[15] << 8);
+}
+
+static int test_parse(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    if (!mm_eth_shm_parse("lab", &cfg)) return 1;
+    if (strcmp(cfg.name, "lab") != 0 || cfg.latency_ns != 0 || cfg.loss_ppm != 0 || cfg.pcap[0] != '\0') return 1;
+    if (!mm_eth_shm_parse("lab-1,latency_us=250,loss=1.5%,pcap=/tmp/x.pcap", &cfg)) return 1;
+    if (strcmp(cfg.name, "lab-1") != 0) return 1;
+    if (cfg.latency_ns != 250000u || cfg.loss_ppm != 15000u) return 1;
+    if (strcmp(cfg.pcap, "/tmp/x.pcap") != 0) return 1;
+    if (mm_eth_shm_parse("", &cfg)) return 1;
+    if (mm_eth_shm_parse("a/b", &cfg)) return 1;
+    if (mm_eth_shm_parse("lab,speed=1", &cfg)) return 1;
+    if (mm_eth_shm_parse("lab,loss=120%", &cfg)) return 1;
+    if (mm_eth_shm_parse("lab,latency_us=x", &cfg)) return 1;
+    return 0;
+}
+
+static int test_unicast(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    mm_u32 len;
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    if (mm_eth_shm_port(a) == mm_eth_shm_port(b)) rc = 1;
+    len = make_frame(f, mac_b, mac_a, 7u);
+    if (!mm_eth_shm_send(a, f, len, 10u)) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 20u) != len || memcmp(got, f, len) != 0) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 30u) != 0) rc = 1;
+    /* A sender never sees its own frames. */
+    if (mm_eth_shm_recv(a, got, sizeof(got), 30u) != 0) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_broadcast(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *sw[3];
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    int rc = 0;
+    int i;
+    new_cfg(&cfg);
+    for (i = 0; i < 3; ++i) {
+        sw[i] = mm_eth_shm_attach(&cfg);
+        if (sw[i] == 0) return 1;
+    }
+    (void)mm_eth_shm_send(sw[0], f, make_frame(f, mac_bcast, mac_a, 1u), 1u);
+    if (mm_eth_shm_recv(sw[1], got, sizeof(got), 2u) != 64u || frame_tag(got) != 1u) rc = 1;
+    if (mm_eth_shm_recv(sw[2], got, sizeof(got), 2u) != 64u || frame_tag(got) != 1u) rc = 1;
+    for (i = 0; i < 3; ++i) mm_eth_shm_detach(sw[i]);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_learning(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    struct mm_eth_shm *c;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    b = mm_eth_shm_attach(&cfg);
+    c = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0 || c == 0) return 1;
+    /* B and C announce themselves; everyone else drains the floods. */
+    (void)mm_eth_shm_send(b, f, make_frame(f, mac_bcast, mac_b, 1u), 1u);
+    (void)mm_eth_shm_send(c, f, make_frame(f, mac_bcast, mac_c, 2u), 1u);
+    while (mm_eth_shm_recv(a, got, sizeof(got), 2u) != 0) {
+    }
+    while (mm_eth_shm_recv(b, got, sizeof(got), 2u) != 0) {
+    }
+    while (mm_eth_shm_recv(c, got, sizeof(got), 2u) != 0) {
+    }
+    /* Known unicast reaches only its port. */
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 3u), 3u);
+    if (mm_eth_shm_recv(b, got, sizeof(got), 4u) != 64u || frame_tag(got) != 3u) rc = 1;
+    if (mm_eth_shm_recv(c, got, sizeof(got), 4u) != 0) rc = 1;
+    /* Unknown unicast is flooded. */
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_x, mac_a, 4u), 5u);
+    if (mm_eth_shm_recv(b, got, sizeof(got), 6u) != 64u || frame_tag(got) != 4u) rc = 1;
+    if (mm_eth_shm_recv(c, got, sizeof(got), 6u) != 64u || frame_tag(got) != 4u) rc = 1;
+    /* Once B leaves, its address is flooded again. */
+    mm_eth_shm_detach(b);
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 5u), 7u);
+    if (mm_eth_shm_recv(c, got, sizeof(got), 8u) != 64u || frame_tag(got) != 5u) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(c);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_latency(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    cfg.latency_ns = 1000u;
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 1u), 100u);
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 2u), 400u);
+    if (mm_eth_shm_recv(b, got, sizeof(got), 500u) != 0) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1099u) != 0) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1100u) != 64u || frame_tag(got) != 1u) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1300u) != 0) rc = 1;
+    /* Virtual time standing still releases what is held. */
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1300u) != 64u || frame_tag(got) != 2u) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_epoch(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    mm_eth_shm_set_epoch(a, 1u);
+    mm_eth_shm_set_epoch(b, 1u);
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 1u), 100u);
+    /* Same quantum: not visible, however far b's clock has run. */
+    if (mm_eth_shm_recv(b, got, sizeof(got), 900u) != 0) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 900u) != 0) rc = 1;
+    mm_eth_shm_set_epoch(a, 2u);
+    mm_eth_shm_set_epoch(b, 2u);
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 2u), 1100u);
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1000u) != 64u || frame_tag(got) != 1u) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1200u) != 0) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int run_loss(int *received)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    mm_u32 i;
+    int n = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    cfg.loss_ppm = 250000u;
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    for (i = 0; i < 400u; ++i) {
+        (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, i), i + 1u);
+        while (mm_eth_shm_recv(b, got, sizeof(got), i + 2u) != 0) ++n;
+    }
+    if (mm_eth_shm_drops(b) != (mm_u64)(400 - n)) n = -1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    *received = n;
+    return 0;
+}
+
+static int test_loss(void)
+{
+    int first = 0;
+    int second = 0;
+    if (run_loss(&first) != 0 || run_loss(&second) != 0) return 1;
+    if (first < 240 || first > 360) return 1;
+    /* Same ports, same sequence numbers: same frames lost. */
+    return (first == second) ? 0 : 1;
+}
+
+static int test_lapped(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    mm_u32 i;
+    mm_u32 n = 0;
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    for (i = 0; i < MM_ETH_SHM_SLOTS + 72u; ++i) {
+        (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, i), 1u);
+    }
+    while (mm_eth_shm_recv(b, got, sizeof(got), 2u) != 0) {
+        if (frame_tag(got) != 72u + n) rc = 1;
+        ++n;
+    }
+    if (n != MM_ETH_SHM_SLOTS || mm_eth_shm_drops(b) != 72u) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_doorbell(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    struct mm_eth_shm *b;
+    struct pollfd pfd;
+    mm_u8 f[64];
+    mm_u8 got[MM_ETH_SHM_FRAME_MAX];
+    int rc = 0;
+    new_cfg(&cfg);
+    a = mm_eth_shm_attach(&cfg);
+    b = mm_eth_shm_attach(&cfg);
+    if (a == 0 || b == 0) return 1;
+    pfd.fd = *mm_eth_shm_bell_fd(b);
+    pfd.events = POLLIN;
+    if (pfd.fd < 0) rc = 1;
+    /* Idle receiver arms its bell; the next send rings it. */
+    if (mm_eth_shm_recv(b, got, sizeof(got), 1u) != 0) rc = 1;
+    if (poll(&pfd, 1, 0) != 0) rc = 1;
+    (void)mm_eth_shm_send(a, f, make_frame(f, mac_b, mac_a, 1u), 2u);
+    if (poll(&pfd, 1, 1000) != 1) rc = 1;
+    if (mm_eth_shm_recv(b, got, sizeof(got), 3u) != 64u) rc = 1;
+    if (poll(&pfd, 1, 0) != 0) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_detach(b);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+static int test_reclaim(void)
+{
+    struct mm_eth_shm_cfg cfg;
+    struct mm_eth_shm *a;
+    pid_t pid;
+    int status = 0;
+    int rc = 0;
+    new_cfg(&cfg);
+    pid = fork();
+    if (pid < 0) return 1;
+    if (pid == 0) {
+        /* Exit while still holding port 0. */
+        _exit(mm_eth_shm_attach(&cfg) != 0 ? 0 : 1);
+    }
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    a = mm_eth_shm_attach(&cfg);
+    if (a == 0 || mm_eth_shm_port(a) != 0) rc = 1;
+    mm_eth_shm_detach(a);
+    mm_eth_shm_unlink(cfg.name);
+    return rc;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "parse", test_parse },
+        { "unicast", test_unicast },
+        { "broadcast", test_broadcast },
+        { "learning", test_learning },
+        { "latency", test_latency },
+        { "epoch", test_epoch },
+        { "loss", test_loss },
+        { "lapped", test_lapped },
+        { "doorbell", test_doorbell },
+        { "reclaim", test_reclaim },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("eth_shm_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "m33mu/fetch.h"
+#include "m33mu/decode.h"
+#include "m33mu/mem.h"
+#include "m33mu/cpu.h"
+#include "m33mu/dsp.h"
+
+struct kind_map {
+    const char *name;
+    enum mm_op_kind kind;
+};
+
+static const struct kind_map KIND_MAP[] = {
+    { "MM_OP_PAS", MM_OP_PAS },
+    { "MM_OP_QADDSUB", MM_OP_QADDSUB },
+    { "MM_OP_SEL", MM_OP_SEL },
+    { "MM_OP_SSAT", MM_OP_SSAT },
+    { "MM_OP_USAT", MM_OP_USAT },
+    { "MM_OP_SSAT16", MM_OP_SSAT16 },
+    { "MM_OP_USAT16", MM_OP_USAT16 },
+    { "MM_OP_PKH", MM_OP_PKH },
+    { "MM_OP_SXTB16", MM_OP_SXTB16 },
+    { "MM_OP_UXTB16", MM_OP_UXTB16 },
+    { "MM_OP_SMLA", MM_OP_SMLA },
+    { "MM_OP_SMLAD", MM_OP_SMLAD },
+    { "MM_OP_SMLALD", MM_OP_SMLALD },
+    { "MM_OP_SMLAW", MM_OP_SMLAW },
+    { "MM_OP_SMMLA", MM_OP_SMMLA },
+    { "MM_OP_SMLAL_XY", MM_OP_SMLAL_XY },
+    { "MM_OP_USAD8", MM_OP_USAD8 },
+    { NULL, MM_OP_UNDEFINED }
+};
+
+static int parse_hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
+    return -1;
+}
+
+static int parse_hex_bytes(const char *hex, mm_u8 *out, size_t out_cap, size_t *out_len)
+{
+    size_t len = strlen(hex);
+    size_t i;
+    if ((len & 1u) != 0u) return 1;
+    if ((len / 2u) > out_cap) return 1;
+    for (i = 0; i < len; i += 2) {
+        int hi = parse_hex_nibble(hex[i]);
+        int lo = parse_hex_nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0) return 1;
+        out[i / 2u] = (mm_u8)((hi << 4) | lo);
+    }
+    *out_len = len / 2u;
+    return 0;
+}
+
+static int kind_from_string(const char *name, enum mm_op_kind *out)
+{
+    size_t i = 0;
+    while (KIND_MAP[i].name != NULL) {
+        if (strcmp(KIND_MAP[i].name, name) == 0) {
+            *out = KIND_MAP[i].kind;
+            return 0;
+        }
+        i++;
+    }
+    return 1;
+}
+
+static int decode_from_bytes(const mm_u8 *bytes, size_t len_bytes, struct mm_decoded *out_dec)
+{
+    struct mm_mem mem;
+    struct mm_cpu cpu;
+    struct mm_fetch_result fetch;
+    size_t i;
+
+    mem.buffer = bytes;
+    mem.length = len_bytes;
+    mem.base = 0;
+    for (i = 0; i < 16; ++i) {
+        cpu.r[i] = 0;
+    }
+    cpu.r[15] = 1u;
+    cpu.xpsr = 0;
+
+    fetch = mm_fetch_t32(&cpu, &mem);
+    if (fetch.fault) {
+        return 1;
+    }
+    *out_dec = mm_decode_t32(&fetch);
+    return 0;
+}
+
+/* Vectors use Rd=r0, Rn=r1, Rm=r2, Ra=r3 (RdLo=r0, RdHi=r3 for long forms). */
+static int run_vectors(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int failures = 0;
+    int total = 0;
+
+    if (!f) {
+        printf("exec_dsp_vectors_test: failed to open %s\n", path);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char hex[128];
+        char kind_name[64];
+        unsigned long len_ul;
+        unsigned long rn_ul, rm_ul, ra_ul, ge_in_ul;
+        unsigned long res_ul, res_hi_ul, ge_out_ul;
+        unsigned long lo_ul = 0;
+        long q_l;
+        int fields;
+        const char *lo_tag;
+        mm_u8 bytes[4];
+        size_t bytes_len = 0;
+        struct mm_decoded dec;
+        enum mm_op_kind kind;
+        struct mm_cpu cpu;
+        mm_bool is_long;
+        mm_u32 ge;
+        mm_u32 q;
+
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\0') {
+            continue;
+        }
+
+        fields = sscanf(line, "%127s %lu %63s %lx %lx %lx %lx %lx %lx %lx %ld",
+                        hex, &len_ul, kind_name, &rn_ul, &rm_ul, &ra_ul, &ge_in_ul,
+                        &res_ul, &res_hi_ul, &ge_out_ul, &q_l);
+        if (fields != 11) {
+            printf("exec_dsp_vectors_test: bad line: %s", line);
+            failures++;
+            continue;
+        }
+        lo_tag = strstr(line, "lo=");
+        if (lo_tag != NULL) {
+            lo_ul = strtoul(lo_tag + 3, NULL, 16);
+        }
+        if (parse_hex_bytes(hex, bytes, sizeof(bytes), &bytes_len) != 0 || bytes_len != len_ul) {
+            printf("exec_dsp_vectors_test: bad hex: %s\n", hex);
+            failures++;
+            continue;
+        }
+        if (kind_from_string(kind_name, &kind) != 0) {
+            printf("exec_dsp_vectors_test: unknown kind %s\n", kind_name);
+            failures++;
+            continue;
+        }
+        if (decode_from_bytes(bytes, bytes_len, &dec) != 0) {
+            printf("exec_dsp_vectors_test: decode failed %s\n", hex);
+            failures++;
+            continue;
+        }
+
+        total++;
+        if (dec.kind != kind || dec.undefined) {
+            printf("exec_dsp_vectors_test: kind mismatch %s got=%d expected=%d\n", hex, (int)dec.kind, (int)kind);
+            failures++;
+            continue;
+        }
+
+        is_long = (kind == MM_OP_SMLALD || kind == MM_OP_SMLAL_XY);
+        memset(&cpu, 0, sizeof(cpu));
+        cpu.r[1] = (mm_u32)rn_ul;
+        cpu.r[2] = (mm_u32)rm_ul;
+        cpu.r[3] = (mm_u32)ra_ul;
+        if (is_long) cpu.r[0] = (mm_u32)lo_ul;
+        cpu.xpsr = 0x01000000u | (((mm_u32)ge_in_ul & 0xfu) << MM_XPSR_GE_SHIFT);
+        if (!mm_dsp_execute(&cpu, &dec)) {
+            printf("exec_dsp_vectors_test: not executed %s\n", hex);
+            failures++;
+            continue;
+        }
+        ge = (cpu.xpsr & MM_XPSR_GE_MASK) >> MM_XPSR_GE_SHIFT;
+        q = (cpu.xpsr & MM_XPSR_Q) ? 1u : 0u;
+        if (cpu.r[0] != (mm_u32)res_ul || (is_long && cpu.r[3] != (mm_u32)res_hi_ul)) {
+            printf("exec_dsp_vectors_test: res mismatch %s %s got=0x%08lx:%08lx expected=0x%08lx:%08lx\n",
+                   hex, kind_name, (unsigned long)(is_long ? cpu.r[3] : 0u), (unsigned long)cpu.r[0],
+                   res_hi_ul, res_ul);
+            failures++;
+            continue;
+        }
+        if (ge != (mm_u32)ge_out_ul || q != (mm_u32)q_l) {
+            printf("exec_dsp_vectors_test: flags mismatch %s %s ge=%lx q=%lu expected ge=%lx q=%ld\n",
+                   hex, kind_name, (unsigned long)ge, (unsigned long)q, ge_out_ul, q_l);
+            failures++;
+            continue;
+        }
+    }
+
+    fclose(f);
+    printf("exec_dsp_vectors_test: %d vectors, backend %s\n", total, mm_dsp_backend());
+    if (failures != 0) {
+        printf("exec_dsp_vectors_test: %d failure(s) out of %d\n", failures, total);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return run_vectors("tests/vectors/dsp_vectors.txt");
+}
@@ -174,6 +174,7 @@ static int test_msplim_fault(void)
     cpu.msp_s = 0x20001000u;
     cpu.r[13] = 0x20001000u;
     cpu.msplim_s = 0x20001000u;
+    mm_cpu_sp_rebank(&cpu);
 
     dec.kind = MM_OP_SUB_SP_IMM;
     dec.rd = 13u;
@@ -221,6 +222,7 @@ static int test_psplim_ok(void)
     cpu.psp_ns = 0x20001000u;
     cpu.r[13] = 0x20001000u;
     cpu.psplim_ns = 0x20000000u;
+    mm_cpu_sp_rebank(&cpu);
 
     dec.kind = MM_OP_SUB_SP_IMM;
     dec.rd = 13u;
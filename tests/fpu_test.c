@@ -0,0 +1,291 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#include <fenv.h>
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/fetch.h"
+#include "m33mu/decode.h"
+#include "m33mu/mem.h"
+#include "m33mu/memmap.h"
+#include "m33mu/cpu.h"
+#include "m33mu/fpu.h"
+
+#define RAM_BASE 0x20000000u
+
+static mm_u8 g_ram[0x400];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[4];
+static struct mm_cpu g_cpu;
+
+static mm_u32 fbits(float v)
+{
+    mm_u32 u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+static int decode_insn(mm_u16 hw1, mm_u16 hw2, struct mm_decoded *out_dec)
+{
+    mm_u8 bytes[4];
+    struct mm_mem mem;
+    struct mm_cpu cpu;
+    struct mm_fetch_result fetch;
+
+    bytes[0] = (mm_u8)(hw1 & 0xffu);
+    bytes[1] = (mm_u8)((hw1 >> 8) & 0xffu);
+    bytes[2] = (mm_u8)(hw2 & 0xffu);
+    bytes[3] = (mm_u8)((hw2 >> 8) & 0xffu);
+    mem.buffer = bytes;
+    mem.length = sizeof(bytes);
+    mem.base = 0;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[15] = 1u;
+    fetch = mm_fetch_t32(&cpu, &mem);
+    if (fetch.fault) return 1;
+    *out_dec = mm_decode_t32(&fetch);
+    return 0;
+}
+
+static void setup(void)
+{
+    struct mm_target_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    memset(g_ram, 0, sizeof(g_ram));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    mm_memmap_init(&g_map, g_regions, 4);
+    (void)mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE);
+    memset(&g_cpu, 0, sizeof(g_cpu));
+    mm_fpu_reset(&g_cpu);
+    g_cpu.sec_state = MM_SECURE;
+    g_cpu.mode = MM_THREAD;
+    g_cpu.cpacr_s = 0x00f00000u;
+}
+
+static enum mm_fpu_status run(mm_u16 hw1, mm_u16 hw2)
+{
+    struct mm_decoded d;
+    mm_u32 fault = 0;
+    if (decode_insn(hw1, hw2, &d) != 0 || d.undefined) return MM_FPU_UNDEFINED;
+    return mm_fpu_execute(&g_cpu, &g_map, &d, 0u, &fault);
+}
+
+static int test_arith(void)
+{
+    setup();
+    g_cpu.s[1] = fbits(1.5f);
+    g_cpu.s[2] = fbits(2.25f);
+    if (run(0xee30u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != fbits(3.75f)) return 1;   /* vadd s0,s1,s2 */
+    if (run(0xee20u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != fbits(3.375f)) return 1;  /* vmul */
+    if (run(0xee80u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != fbits(1.5f / 2.25f)) return 1; /* vdiv */
+    if ((g_cpu.fpscr & MM_FPSCR_IXC) == 0u) return 1;
+    g_cpu.s[0] = fbits(1.0f);
+    if (run(0xeea0u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != fbits(4.375f)) return 1;  /* vfma */
+    g_cpu.s[1] = fbits(2.0f);
+    if (run(0xeeb1u, 0x0ae0u) != MM_FPU_OK || g_cpu.s[0] != fbits(1.41421353816986083984375f)) return 1; /* vsqrt s0,s1 */
+    if (run(0xeeb7u, 0x0a00u) != MM_FPU_OK || g_cpu.s[0] != fbits(1.0f)) return 1;    /* vmov.f32 s0,#1.0 */
+    /* The secure CONTROL.FPCA is set by the first FP instruction. */
+    if ((g_cpu.control_s & 0x4u) == 0u) return 1;
+    return 0;
+}
+
+static int test_nan_handling(void)
+{
+    setup();
+    g_cpu.s[1] = 0u;
+    g_cpu.s[2] = 0u;
+    if (run(0xee80u, 0x0a81u) != MM_FPU_OK) return 1;                   /* 0/0 */
+    if (g_cpu.s[0] != 0x7fc00000u || (g_cpu.fpscr & MM_FPSCR_IOC) == 0u) return 1;
+    g_cpu.fpscr = 0;
+    g_cpu.s[1] = fbits(1.0f);
+    g_cpu.s[2] = 0x7f800001u;                                            /* SNaN */
+    if (run(0xee30u, 0x0a81u) != MM_FPU_OK) return 1;
+    if (g_cpu.s[0] != 0x7fc00001u || (g_cpu.fpscr & MM_FPSCR_IOC) == 0u) return 1;
+    g_cpu.fpscr = MM_FPSCR_DN;
+    if (run(0xee30u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != 0x7fc00000u) return 1;
+    /* Flush-to-zero on a denormal input. */
+    g_cpu.fpscr = MM_FPSCR_FZ;
+    g_cpu.s[1] = 0x00000001u;
+    g_cpu.s[2] = fbits(1.0f);
+    if (run(0xee20u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != 0u) return 1;
+    if ((g_cpu.fpscr & MM_FPSCR_IDC) == 0u) return 1;
+    return 0;
+}
+
+static int test_sticky_flags_and_host_rounding(void)
+{
+    setup();
+    /* The first FP instruction loads FPSCR from FPDSCR; get that out of the way. */
+    if (run(0xeeb7u, 0x0a00u) != MM_FPU_OK) return 1;                    /* vmov.f32 s0,#1.0 */
+    /* A flushed result suppresses its own IXC, not one raised earlier. */
+    g_cpu.fpscr = MM_FPSCR_FZ | MM_FPSCR_IXC;
+    g_cpu.s[1] = 0x00800001u;                                            /* just above FLT_MIN */
+    g_cpu.s[2] = fbits(0.5f);
+    if (run(0xee20u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != 0u) return 1; /* vmul -> denormal -> 0 */
+    if ((g_cpu.fpscr & MM_FPSCR_UFC) == 0u || (g_cpu.fpscr & MM_FPSCR_IXC) == 0u) return 1;
+    /* The guest rounding mode applies to the guest op only. */
+    g_cpu.fpscr = 3u << MM_FPSCR_RMODE_SHIFT;                             /* RZ */
+    g_cpu.s[1] = fbits(1.0f);
+    g_cpu.s[2] = fbits(3.0f);
+    if (run(0xee80u, 0x0a81u) != MM_FPU_OK || g_cpu.s[0] != 0x3eaaaaaau) return 1; /* vdiv 1/3 truncated */
+    if (fegetround() != FE_TONEAREST) return 1;
+    return 0;
+}
+
+static int test_compare_vmrs(void)
+{
+    setup();
+    g_cpu.s[0] = fbits(1.0f);
+    g_cpu.s[1] = fbits(2.0f);
+    if (run(0xeeb4u, 0x0a60u) != MM_FPU_OK) return 1;                   /* vcmp s0,s1 */
+    if ((g_cpu.fpscr >> 28) != 0x8u) return 1;
+    if (run(0xeef1u, 0xfa10u) != MM_FPU_OK) return 1;                   /* vmrs APSR_nzcv,fpscr */
+    if ((g_cpu.xpsr >> 28) != 0x8u) return 1;
+    g_cpu.s[1] = 0x7fc00000u;
+    if (run(0xeeb4u, 0x0a60u) != MM_FPU_OK || (g_cpu.fpscr >> 28) != 0x3u) return 1;
+    if ((g_cpu.fpscr & MM_FPSCR_IOC) != 0u) return 1;                   /* quiet compare */
+    if (run(0xeeb4u, 0x0ae0u) != MM_FPU_OK || (g_cpu.fpscr & MM_FPSCR_IOC) == 0u) return 1; /* vcmpe */
+    g_cpu.r[0] = 0x00c00000u;                                            /* RMode = RZ */
+    if (run(0xeee1u, 0x0a10u) != MM_FPU_OK || g_cpu.fpscr != 0x00c00000u) return 1; /* vmsr fpscr,r0 */
+    return 0;
+}
+
+static int test_convert(void)
+{
+    setup();
+    g_cpu.s[0] = fbits(-2.5f);
+    if (run(0xeebdu, 0x0ac0u) != MM_FPU_OK || g_cpu.s[0] != 0xfffffffeu) return 1; /* vcvt.s32.f32 */
+    if ((g_cpu.fpscr & MM_FPSCR_IXC) == 0u) return 1;
+    g_cpu.s[0] = fbits(3.0e10f);
+    if (run(0xeebdu, 0x0ac0u) != MM_FPU_OK || g_cpu.s[0] != 0x7fffffffu) return 1;
+    if ((g_cpu.fpscr & MM_FPSCR_IOC) == 0u) return 1;
+    g_cpu.s[0] = 0xfffffff9u;
+    if (run(0xeeb8u, 0x0ac0u) != MM_FPU_OK || g_cpu.s[0] != fbits(-7.0f)) return 1; /* vcvt.f32.s32 */
+    /* VCVTB.F16.F32 then back. */
+    g_cpu.s[1] = fbits(0.333333333f);
+    if (run(0xeeb3u, 0x0a60u) != MM_FPU_OK || (g_cpu.s[0] & 0xffffu) != 0x3555u) return 1;
+    if (run(0xeeb2u, 0x0a40u) != MM_FPU_OK || g_cpu.s[0] != fbits(0.333251953125f)) return 1;
+    return 0;
+}
+
+static int test_load_store_transfer(void)
+{
+    mm_u32 v = 0;
+    setup();
+    g_cpu.r[0] = RAM_BASE;
+    g_ram[4] = 0x00; g_ram[5] = 0x00; g_ram[6] = 0x80; g_ram[7] = 0x3f;  /* 1.0f */
+    if (run(0xed90u, 0x0a01u) != MM_FPU_OK || g_cpu.s[0] != fbits(1.0f)) return 1; /* vldr s0,[r0,#4] */
+    if (run(0xed80u, 0x0a02u) != MM_FPU_OK) return 1;                              /* vstr s0,[r0,#8] */
+    if (!mm_memmap_read(&g_map, MM_SECURE, RAM_BASE + 8u, 4u, &v) || v != fbits(1.0f)) return 1;
+    if (run(0xee10u, 0x0a10u) != MM_FPU_OK || g_cpu.r[0] != fbits(1.0f)) return 1;  /* vmov r0,s0 */
+    g_cpu.r[0] = 0x12345678u;
+    if (run(0xee00u, 0x0a90u) != MM_FPU_OK || g_cpu.s[1] != 0x12345678u) return 1;  /* vmov s1,r0 */
+    /* vpush {s0-s1}: the store happens below SP, writeback is the caller's. */
+    g_cpu.r[13] = RAM_BASE + 0x100u;
+    if (run(0xed2du, 0x0a02u) != MM_FPU_OK) return 1;
+    if (!mm_memmap_read(&g_map, MM_SECURE, RAM_BASE + 0xfcu, 4u, &v) || v != 0x12345678u) return 1;
+    return 0;
+}
+
+static int test_access_control(void)
+{
+    setup();
+    g_cpu.cpacr_s = 0;
+    if (run(0xee30u, 0x0a81u) != MM_FPU_NOCP) return 1;
+    g_cpu.cpacr_s = 0x00500000u;                                         /* privileged only */
+    mm_cpu_set_privileged(&g_cpu, MM_TRUE);                             /* unprivileged thread */
+    if (run(0xee30u, 0x0a81u) != MM_FPU_NOCP) return 1;
+    g_cpu.mode = MM_HANDLER;
+    if (run(0xee30u, 0x0a81u) != MM_FPU_OK) return 1;
+    /* Non-secure needs NSACR.CP10 as well as its own CPACR. */
+    g_cpu.sec_state = MM_NONSECURE;
+    g_cpu.cpacr_ns = 0x00f00000u;
+    if (run(0xee30u, 0x0a81u) != MM_FPU_NOCP) return 1;
+    g_cpu.nsacr = 0x00000c00u;
+    if (run(0xee30u, 0x0a81u) != MM_FPU_OK) return 1;
+    return 0;
+}
+
+static int test_lazy_stacking(void)
+{
+    mm_u32 sp = RAM_BASE + 0x200u;
+    mm_u32 exc_ret = 0xfffffff9u;
+    mm_u32 frame_sp;
+    mm_u32 v = 0;
+    setup();
+    g_cpu.s[0] = fbits(5.0f);
+    if (run(0xeeb0u, 0x0a40u) != MM_FPU_OK) return 1;                   /* vmov.f32 s0,s0: opens FP context */
+    if (!mm_fpu_exception_entry(&g_cpu, &g_map, MM_SECURE, &sp, &exc_ret)) return 1;
+    if (sp != RAM_BASE + 0x200u - MM_FPU_FRAME_EXT || exc_ret != 0xffffffe9u) return 1;
+    if ((g_cpu.fpccr & MM_FPCCR_LSPACT) == 0u || g_cpu.fpcar != sp) return 1;
+    if ((g_cpu.control_s & 0x4u) != 0u) return 1;
+    frame_sp = sp - 32u;                                                 /* basic frame below */
+
+    /* Handler uses the FPU: the caller's S0 is saved first. */
+    g_cpu.mode = MM_HANDLER;
+    g_cpu.s[1] = fbits(9.0f);
+    if (run(0xeeb0u, 0x0a60u) != MM_FPU_OK || g_cpu.s[0] != fbits(9.0f)) return 1; /* vmov.f32 s0,s1 */
+    if ((g_cpu.fpccr & MM_FPCCR_LSPACT) != 0u) return 1;
+    if (!mm_memmap_read(&g_map, MM_SECURE, sp, 4u, &v) || v != fbits(5.0f)) return 1;
+
+    if (!mm_fpu_exception_return(&g_cpu, &g_map, MM_SECURE, frame_sp, MM_FALSE)) return 1;
+    if (g_cpu.s[0] != fbits(5.0f) || (g_cpu.control_s & 0x4u) == 0u) return 1;
+
+    /* A handler that never touches the FPU leaves nothing to restore. */
+    sp = RAM_BASE + 0x200u;
+    exc_ret = 0xfffffff9u;
+    if (!mm_fpu_exception_entry(&g_cpu, &g_map, MM_SECURE, &sp, &exc_ret)) return 1;
+    g_cpu.s[0] = fbits(7.0f);                                            /* still live in registers */
+    if (!mm_fpu_exception_return(&g_cpu, &g_map, MM_SECURE, sp - 32u, MM_FALSE)) return 1;
+    if (g_cpu.s[0] != fbits(7.0f) || (g_cpu.fpccr & MM_FPCCR_LSPACT) != 0u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "fpu_arith", test_arith },
+        { "fpu_nan_handling", test_nan_handling },
+        { "fpu_sticky_flags_and_host_rounding", test_sticky_flags_and_host_rounding },
+        { "fpu_compare_vmrs", test_compare_vmrs },
+        { "fpu_convert", test_convert },
+        { "fpu_load_store_transfer", test_load_store_transfer },
+        { "fpu_access_control", test_access_control },
+        { "fpu_lazy_stacking", test_lazy_stacking },
+    };
+    int failures = 0;
+    int i;
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("fpu_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/fuse.h"
+#include "m33mu/fetch.h"
+
+#define CODE_BASE 0x08000000u
+
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[4];
+static mm_u8 g_code[64];
+static struct mm_predecode g_pd;
+
+static void load_code(const mm_u16 *hw, int count)
+{
+    int i;
+    memset(g_code, 0, sizeof(g_code));
+    for (i = 0; i < count; ++i) {
+        g_code[i * 2] = (mm_u8)(hw[i] & 0xffu);
+        g_code[i * 2 + 1] = (mm_u8)(hw[i] >> 8);
+    }
+    mm_memmap_init(&g_map, g_regions, 4);
+    mm_memmap_add_rom(&g_map, CODE_BASE, sizeof(g_code), g_code, 0);
+    mm_predecode_free(&g_pd);
+    mm_predecode_build(&g_pd, g_code, sizeof(g_code), CODE_BASE, CODE_BASE);
+}
+
+static const struct mm_decoded *at(mm_u32 off)
+{
+    return mm_predecode_peek(&g_pd, CODE_BASE + off);
+}
+
+static int test_classify(void)
+{
+    /* movw r0,#0x5678; movt r0,#0x1234; cmp r0,#3; bne .; ite eq; it eq; movs r1,#1;
+     * ldr r2,[r1]; adds r3,r3,r2; subs r4,#1; bne .; movw r1,#1; movt r2,#1 */
+    static const mm_u16 hw[] = {
+        0xf245u, 0x6078u, 0xf2c1u, 0x2034u, 0x2803u, 0xd1feu, 0xbf0cu, 0xbf08u, 0x2101u,
+        0x680au, 0x189bu, 0x3c01u, 0xd1feu, 0xf240u, 0x0101u, 0xf2c0u, 0x0201u
+    };
+    load_code(hw, (int)(sizeof(hw) / sizeof(hw[0])));
+    if (mm_fuse_classify(at(0), at(4)) != MM_FUSE_MOVW_MOVT) return 1;
+    if (mm_fuse_classify(at(8), at(10)) != MM_FUSE_CMP_BCC) return 1;
+    if (mm_fuse_classify(at(12), at(14)) != MM_FUSE_NONE) return 1;   /* ITE: two-insn block */
+    if (mm_fuse_classify(at(14), at(16)) != MM_FUSE_IT_OP) return 1;
+    if (mm_fuse_classify(at(18), at(20)) != MM_FUSE_LDR_ADDS) return 1;
+    if (mm_fuse_classify(at(22), at(24)) != MM_FUSE_SUBS_BNE) return 1;
+    if (mm_fuse_classify(at(26), at(30)) != MM_FUSE_NONE) return 1;   /* MOVT to another reg */
+    if (mm_fuse_classify(at(20), at(22)) != MM_FUSE_NONE) return 1;
+    if (mm_fuse_pair_at(at(8), &g_pd, CODE_BASE + 10u) != MM_FUSE_CMP_BCC) return 1;
+    if (mm_fuse_pair_at(at(8), &g_pd, CODE_BASE + 0x1000u) != MM_FUSE_NONE) return 1;
+    return 0;
+}
+
+static int test_exec_direct(void)
+{
+    /* movw r0,#0x5678; movt r0,#0x1234; cmp r0,#3; bne .-4 */
+    static const mm_u16 hw[] = { 0xf245u, 0x6078u, 0xf2c1u, 0x2034u, 0x2803u, 0xd1fdu };
+    struct mm_cpu cpu;
+    load_code(hw, (int)(sizeof(hw) / sizeof(hw[0])));
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[0] = 0x5678u;
+    if (!mm_fuse_can_direct(MM_FUSE_MOVW_MOVT, &g_map, at(4), CODE_BASE, CODE_BASE + 4u)) return 1;
+    mm_fuse_exec_direct(&cpu, at(4), CODE_BASE + 4u);
+    if (cpu.r[0] != 0x12345678u || cpu.r[15] != ((CODE_BASE + 8u) | 1u)) return 1;
+    /* Z clear: bne taken back to the cmp. */
+    cpu.xpsr = 0;
+    mm_fuse_exec_direct(&cpu, at(10), CODE_BASE + 10u);
+    if (cpu.r[15] != ((CODE_BASE + 8u) | 1u)) return 1;
+    /* Z set: falls through. */
+    cpu.xpsr = 1u << 30;
+    mm_fuse_exec_direct(&cpu, at(10), CODE_BASE + 10u);
+    if (cpu.r[15] != ((CODE_BASE + 12u) | 1u)) return 1;
+    return 0;
+}
+
+static int test_direct_refused(void)
+{
+    static const mm_u16 hw[] = { 0x2803u, 0xd1fcu, 0x680au, 0x189bu };
+    load_code(hw, (int)(sizeof(hw) / sizeof(hw[0])));
+    /* ADDS goes through the interpreter. */
+    if (mm_fuse_can_direct(MM_FUSE_LDR_ADDS, &g_map, at(6), CODE_BASE + 4u, CODE_BASE + 6u)) return 1;
+    /* Second half in another protection granule. */
+    if (mm_fuse_can_direct(MM_FUSE_CMP_BCC, &g_map, at(2), CODE_BASE - 2u, CODE_BASE + 2u)) return 1;
+    /* Memory rewritten since the table was built. */
+    if (!mm_fuse_can_direct(MM_FUSE_CMP_BCC, &g_map, at(2), CODE_BASE, CODE_BASE + 2u)) return 1;
+    g_code[2] = 0xfbu;
+    if (mm_fuse_can_direct(MM_FUSE_CMP_BCC, &g_map, at(2), CODE_BASE, CODE_BASE + 2u)) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "classify", test_classify },
+        { "exec_direct", test_exec_direct },
+        { "direct_refused", test_direct_refused },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    mm_predecode_init(&g_pd);
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    mm_predecode_free(&g_pd);
+    if (failures != 0) {
+        printf("fuse_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
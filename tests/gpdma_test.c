@@ -0,0 +1,346 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/gpdma.h"
+#include "m33mu/stm32_dma.h"
+#include "m33mu/memmap.h"
+
+#define RAM_BASE 0x20000000u
+#define DMA_BASE 0x40020000u
+#define PERIPH_BASE 0x40004400u
+#define PERIPH_TDR 0x28u
+#define PERIPH_RDR 0x24u
+
+#define CH(x, r) (DMA_BASE + 0x50u + 0x80u * (x) + (r))
+#define CLBAR 0x00u
+#define CFCR 0x0Cu
+#define CSR 0x10u
+#define CCR 0x14u
+#define CTR1 0x40u
+#define CTR2 0x44u
+#define CBR1 0x48u
+#define CSAR 0x4Cu
+#define CDAR 0x50u
+#define CTR3 0x54u
+#define CLLR 0x7Cu
+
+#define REQ_TX 7u
+#define REQ_RX 6u
+
+static mm_u8 g_ram[8192];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[4];
+static struct mm_dma_master g_bus;
+static struct mm_gpdma g_gpdma;
+static struct mm_stm32_dma g_dma;
+static mm_u8 g_tx[64];
+static mm_u32 g_tx_len;
+static const mm_u8 *g_rx;
+static mm_u32 g_rx_len;
+static mm_bool g_tx_ready;
+static mm_u32 g_done_req;
+
+static mm_bool periph_read(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 *value_out)
+{
+    (void)opaque;
+    (void)size_bytes;
+    *value_out = 0;
+    if (offset == PERIPH_RDR && g_rx_len > 0u) {
+        *value_out = *g_rx++;
+        g_rx_len--;
+    }
+    return MM_TRUE;
+}
+
+static mm_bool periph_write(void *opaque, mm_u32 offset, mm_u32 size_bytes, mm_u32 value)
+{
+    (void)opaque;
+    (void)size_bytes;
+    if (offset == PERIPH_TDR && g_tx_len < sizeof(g_tx)) {
+        g_tx[g_tx_len++] = (mm_u8)value;
+    }
+    return MM_TRUE;
+}
+
+static mm_bool dreq(void *opaque, mm_u32 reqsel)
+{
+    (void)opaque;
+    if (reqsel == REQ_TX) return g_tx_ready;
+    if (reqsel == REQ_RX) return g_rx_len > 0u ? MM_TRUE : MM_FALSE;
+    return MM_FALSE;
+}
+
+static void done(void *opaque, mm_u32 reqsel)
+{
+    (void)opaque;
+    g_done_req = reqsel;
+}
+
+static void wr(mm_u32 addr, mm_u32 v)
+{
+    mmio_bus_write(&g_map.mmio, addr, 4u, v);
+}
+
+static mm_u32 rd(mm_u32 addr)
+{
+    mm_u32 v = 0;
+    mmio_bus_read(&g_map.mmio, addr, 4u, &v);
+    return v;
+}
+
+static void put32(mm_u32 addr, mm_u32 v)
+{
+    mm_u8 *p = g_ram + (addr - RAM_BASE);
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+    p[2] = (mm_u8)(v >> 16);
+    p[3] = (mm_u8)(v >> 24);
+}
+
+static int setup(mm_bool classic)
+{
+    struct mm_target_cfg cfg;
+    struct mmio_region reg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    memset(g_ram, 0, sizeof(g_ram));
+    mm_memmap_init(&g_map, g_regions, 4);
+    if (!mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE)) return 1;
+    mm_memmap_dma_master_init(&g_map, &g_bus);
+    memset(&reg, 0, sizeof(reg));
+    reg.base = PERIPH_BASE;
+    reg.size = 0x400u;
+    reg.read = periph_read;
+    reg.write = periph_write;
+    if (!mmio_bus_register_region(&g_map.mmio, &reg)) return 1;
+    g_tx_len = 0;
+    g_rx_len = 0;
+    g_tx_ready = MM_FALSE;
+    g_done_req = 0xFFFFFFFFu;
+    if (classic) {
+        struct mm_stm32_dma_cfg dcfg;
+        memset(&dcfg, 0, sizeof(dcfg));
+        dcfg.base = DMA_BASE;
+        dcfg.dreq = dreq;
+        dcfg.bus = &g_bus;
+        return mm_stm32_dma_register(&g_map.mmio, &g_dma, &dcfg) ? 0 : 1;
+    } else {
+        struct mm_gpdma_cfg gcfg;
+        memset(&gcfg, 0, sizeof(gcfg));
+        gcfg.base = DMA_BASE;
+        gcfg.channels = 8u;
+        gcfg.first_2d = 6u;
+        gcfg.dreq = dreq;
+        gcfg.done = done;
+        gcfg.bus = &g_bus;
+        return mm_gpdma_register(&g_map.mmio, &g_gpdma, &gcfg) ? 0 : 1;
+    }
+}
+
+static int test_mem2mem(void)
+{
+    mm_u32 i;
+    if (setup(MM_FALSE) != 0) return 1;
+    for (i = 0; i < 1000u; ++i) g_ram[i] = (mm_u8)(i * 7u);
+    wr(CH(0, CTR1), 2u | (1u << 3) | (2u << 16) | (1u << 19)); /* word, SINC, DINC */
+    wr(CH(0, CTR2), 1u << 9);                                  /* SWREQ */
+    wr(CH(0, CBR1), 1000u);
+    wr(CH(0, CSAR), RAM_BASE);
+    wr(CH(0, CDAR), RAM_BASE + 0x1000u);
+    wr(CH(0, CCR), 1u | (1u << 8) | (1u << 9));
+    if (memcmp(g_ram, g_ram + 0x1000, 1000u) != 0) return 1;
+    if ((rd(CH(0, CSR)) & 0x301u) != 0x301u) return 1; /* IDLEF, TCF, HTF */
+    if ((rd(CH(0, CCR)) & 1u) != 0u) return 1;
+    if ((rd(CH(0, CBR1)) & 0xFFFFu) != 0u) return 1;
+    if (rd(CH(0, CDAR)) != RAM_BASE + 0x1000u + 1000u) return 1;
+    if (rd(DMA_BASE + 0x0Cu) != 1u) return 1; /* MISR */
+    wr(CH(0, CFCR), 0x7F00u);
+    if ((rd(CH(0, CSR)) & 0x7F00u) != 0u) return 1;
+    return 0;
+}
+
+static int test_width_conversion(void)
+{
+    static const mm_u8 src[4] = { 0x81u, 0x02u, 0x03u, 0x04u };
+    if (setup(MM_FALSE) != 0) return 1;
+    memcpy(g_ram, src, sizeof(src));
+    /* byte -> word, sign extended (PAM=1) */
+    wr(CH(1, CTR1), 0u | (1u << 3) | (1u << 11) | (2u << 16) | (1u << 19));
+    wr(CH(1, CTR2), 1u << 9);
+    wr(CH(1, CBR1), 2u);
+    wr(CH(1, CSAR), RAM_BASE);
+    wr(CH(1, CDAR), RAM_BASE + 0x100u);
+    wr(CH(1, CCR), 1u);
+    if (memcmp(g_ram + 0x100, "\x81\xff\xff\xff\x02\x00\x00\x00", 8u) != 0) return 1;
+    /* byte -> word, packed (PAM=2) */
+    wr(CH(1, CTR1), 0u | (1u << 3) | (2u << 11) | (2u << 16) | (1u << 19));
+    wr(CH(1, CBR1), 4u);
+    wr(CH(1, CSAR), RAM_BASE);
+    wr(CH(1, CDAR), RAM_BASE + 0x200u);
+    wr(CH(1, CCR), 1u);
+    if (memcmp(g_ram + 0x200, src, 4u) != 0) return 1;
+    return 0;
+}
+
+static int test_linked_list(void)
+{
+    mm_u32 lli = RAM_BASE + 0x800u;
+    if (setup(MM_FALSE) != 0) return 1;
+    memcpy(g_ram, "first", 5u);
+    memcpy(g_ram + 0x10, "second", 6u);
+    /* LLI: CBR1, CSAR, CDAR, CLLR (UB1|USA|UDA|ULL) ending the list */
+    put32(lli + 0u, 6u);
+    put32(lli + 4u, RAM_BASE + 0x10u);
+    put32(lli + 8u, RAM_BASE + 0x110u);
+    put32(lli + 12u, 0u);
+    wr(CH(2, CLBAR), RAM_BASE);
+    wr(CH(2, CTR1), (1u << 3) | (1u << 19));
+    wr(CH(2, CTR2), (1u << 9) | (3u << 30)); /* TC at the end of the list */
+    wr(CH(2, CBR1), 5u);
+    wr(CH(2, CSAR), RAM_BASE);
+    wr(CH(2, CDAR), RAM_BASE + 0x100u);
+    wr(CH(2, CLLR), (1u << 29) | (1u << 28) | (1u << 27) | (1u << 16) | 0x800u);
+    wr(CH(2, CCR), 1u);
+    if (memcmp(g_ram + 0x100, "first", 5u) != 0) return 1;
+    if (memcmp(g_ram + 0x110, "second", 6u) != 0) return 1;
+    if ((rd(CH(2, CSR)) & 0x301u) != 0x101u) return 1; /* IDLEF|TCF, no HTF */
+    if (rd(CH(2, CLLR)) != 0u) return 1;
+    return 0;
+}
+
+static int test_2d_offsets(void)
+{
+    if (setup(MM_FALSE) != 0) return 1;
+    memcpy(g_ram, "ab..cd..ef", 10u);
+    /* byte, SINC, SBL=2 beats, DINC; SAO=2 skips the dots */
+    wr(CH(6, CTR1), (1u << 3) | (1u << 4) | (1u << 19));
+    wr(CH(6, CTR2), 1u << 9);
+    wr(CH(6, CTR3), 2u);
+    wr(CH(6, CBR1), 6u);
+    wr(CH(6, CSAR), RAM_BASE);
+    wr(CH(6, CDAR), RAM_BASE + 0x100u);
+    wr(CH(6, CCR), 1u);
+    if (memcmp(g_ram + 0x100, "abcdef", 6u) != 0) return 1;
+    if (rd(CH(6, CSAR)) != RAM_BASE + 12u) return 1;
+    /* DBL=1 beat, DAO=1 spreads the bytes out */
+    wr(CH(7, CTR1), (1u << 3) | (1u << 19));
+    wr(CH(7, CTR2), 1u << 9);
+    wr(CH(7, CTR3), 1u << 16);
+    wr(CH(7, CBR1), 3u);
+    wr(CH(7, CSAR), RAM_BASE);
+    wr(CH(7, CDAR), RAM_BASE + 0x200u);
+    wr(CH(7, CCR), 1u);
+    if (memcmp(g_ram + 0x200, "a\0b\0.\0", 6u) != 0) return 1;
+    /* CTR3 is not implemented on the linear channels */
+    wr(CH(0, CTR3), 2u);
+    if (rd(CH(0, CTR3)) != 0u) return 1;
+    return 0;
+}
+
+static int test_periph_tx_rx(void)
+{
+    static const mm_u8 rx[4] = { 'p', 'o', 'n', 'g' };
+    if (setup(MM_FALSE) != 0) return 1;
+    memcpy(g_ram, "ping", 4u);
+    wr(CH(3, CTR1), (1u << 3));                 /* byte, SINC, fixed TDR */
+    wr(CH(3, CTR2), REQ_TX | (1u << 10));       /* destination request */
+    wr(CH(3, CBR1), 4u);
+    wr(CH(3, CSAR), RAM_BASE);
+    wr(CH(3, CDAR), PERIPH_BASE + PERIPH_TDR);
+    wr(CH(3, CCR), 1u);
+    mm_gpdma_service(&g_gpdma);
+    if (g_tx_len != 0u) return 1;               /* request not asserted yet */
+    g_tx_ready = MM_TRUE;
+    mm_gpdma_service(&g_gpdma);
+    if (g_tx_len != 4u || memcmp(g_tx, "ping", 4u) != 0) return 1;
+    if (g_done_req != REQ_TX) return 1;
+    g_rx = rx;
+    g_rx_len = sizeof(rx);
+    wr(CH(4, CTR1), (1u << 19));                /* fixed RDR, DINC */
+    wr(CH(4, CTR2), REQ_RX);
+    wr(CH(4, CBR1), 4u);
+    wr(CH(4, CSAR), PERIPH_BASE + PERIPH_RDR);
+    wr(CH(4, CDAR), RAM_BASE + 0x40u);
+    wr(CH(4, CCR), 1u);
+    mm_gpdma_service(&g_gpdma);
+    if (memcmp(g_ram + 0x40, rx, 4u) != 0) return 1;
+    if ((rd(CH(4, CSR)) & 0x101u) != 0x101u) return 1;
+    return 0;
+}
+
+static int test_classic_dma(void)
+{
+    mm_u32 i;
+    if (setup(MM_TRUE) != 0) return 1;
+    for (i = 0; i < 64u; ++i) g_ram[i] = (mm_u8)(0xA0u + i);
+    /* DMA1 channel 1: MEM2MEM, word, PINC|MINC, 16 items from CPAR */
+    wr(DMA_BASE + 0x0Cu, 16u);
+    wr(DMA_BASE + 0x10u, RAM_BASE);
+    wr(DMA_BASE + 0x14u, RAM_BASE + 0x400u);
+    wr(DMA_BASE + 0x08u, 1u | (1u << 6) | (1u << 7) | (2u << 8) | (2u << 10) | (1u << 14));
+    if (memcmp(g_ram, g_ram + 0x400, 64u) != 0) return 1;
+    if ((rd(DMA_BASE) & 0x7u) != 0x7u) return 1; /* GIF, TCIF, HTIF */
+    wr(DMA_BASE + 0x04u, 1u);
+    if (rd(DMA_BASE) != 0u) return 1;
+    /* DMA2 channel 3 via DMAMUX channel 10: memory -> TDR */
+    wr(DMA_BASE + 0x800u + 4u * 10u, REQ_TX);
+    wr(DMA_BASE + 0x400u + 0x08u + 0x14u * 2u + 0x04u, 3u);
+    wr(DMA_BASE + 0x400u + 0x08u + 0x14u * 2u + 0x08u, PERIPH_BASE + PERIPH_TDR);
+    wr(DMA_BASE + 0x400u + 0x08u + 0x14u * 2u + 0x0Cu, RAM_BASE);
+    wr(DMA_BASE + 0x400u + 0x08u + 0x14u * 2u, 1u | (1u << 4) | (1u << 7));
+    g_tx_ready = MM_TRUE;
+    mm_stm32_dma_service(&g_dma);
+    if (g_tx_len != 3u || memcmp(g_tx, g_ram, 3u) != 0) return 1;
+    if ((rd(DMA_BASE + 0x400u) & (0x2u << 8)) == 0u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "mem2mem", test_mem2mem },
+        { "width_conversion", test_width_conversion },
+        { "linked_list", test_linked_list },
+        { "2d_offsets", test_2d_offsets },
+        { "periph_tx_rx", test_periph_tx_rx },
+        { "classic_dma", test_classic_dma },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("gpdma_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "m33mu/hostwait.h"
+
+static mm_u64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mm_u64)ts.tv_sec * 1000000000ull + (mm_u64)ts.tv_nsec;
+}
+
+static int test_timeout(void)
+{
+    int fds[2];
+    int rfd;
+    mm_u64 t0;
+    mm_bool woke;
+    if (pipe(fds) != 0) return 1;
+    rfd = fds[0];
+    mm_hostwait_clear();
+    mm_hostwait_watch(&rfd);
+    t0 = now_ns();
+    woke = mm_hostwait_block(20000000ull);
+    mm_hostwait_clear();
+    close(fds[0]);
+    close(fds[1]);
+    if (woke) return 1;
+    return (now_ns() - t0 >= 15000000ull) ? 0 : 1;
+}
+
+static int test_readable_wakes(void)
+{
+    int fds[2];
+    int rfd;
+    int closed = -1;
+    mm_bool woke;
+    if (pipe(fds) != 0) return 1;
+    rfd = fds[0];
+    mm_hostwait_clear();
+    mm_hostwait_watch(&closed);
+    mm_hostwait_watch(&rfd);
+    mm_hostwait_watch(&rfd);
+    if (write(fds[1], "x", 1) != 1) return 1;
+    woke = mm_hostwait_block(MM_HOSTWAIT_FOREVER);
+    mm_hostwait_clear();
+    close(fds[0]);
+    close(fds[1]);
+    return woke ? 0 : 1;
+}
+
+static int test_unwatch(void)
+{
+    int fds[2];
+    int rfd;
+    mm_bool woke;
+    if (pipe(fds) != 0) return 1;
+    rfd = fds[0];
+    mm_hostwait_clear();
+    mm_hostwait_watch(&rfd);
+    mm_hostwait_unwatch(&rfd);
+    if (write(fds[1], "x", 1) != 1) return 1;
+    woke = mm_hostwait_block(5000000ull);
+    close(fds[0]);
+    close(fds[1]);
+    return woke ? 1 : 0;
+}
+
+static int test_wake(void)
+{
+    mm_hostwait_clear();
+    mm_hostwait_wake();
+    if (!mm_hostwait_block(MM_HOSTWAIT_FOREVER)) return 1;
+    /* The wakeup is consumed. */
+    return mm_hostwait_block(1000000ull) ? 1 : 0;
+}
+
+/* A hung-up descriptor (PTY without a reader) must not turn the wait into
+ * a spin, nor make it sleep past the recheck interval. */
+static int test_hangup_not_busy(void)
+{
+    int fds[2];
+    int rfd;
+    mm_u64 t0;
+    mm_u64 dt;
+    mm_bool woke;
+    if (pipe(fds) != 0) return 1;
+    rfd = fds[0];
+    close(fds[1]);
+    mm_hostwait_clear();
+    mm_hostwait_watch(&rfd);
+    t0 = now_ns();
+    woke = mm_hostwait_block(MM_HOSTWAIT_FOREVER);
+    dt = now_ns() - t0;
+    mm_hostwait_clear();
+    close(fds[0]);
+    if (woke) return 1;
+    return (dt >= MM_HOSTWAIT_HUP_RECHECK_NS / 2u && dt < 5u * MM_HOSTWAIT_HUP_RECHECK_NS) ? 0 : 1;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "timeout", test_timeout },
+        { "readable_wakes", test_readable_wakes },
+        { "unwatch", test_unwatch },
+        { "wake", test_wake },
+        { "hangup_not_busy", test_hangup_not_busy },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("hostwait_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
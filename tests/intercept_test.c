@@ -0,0 +1,221 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/intercept.h"
+#include "m33mu/memmap.h"
+#include "m33mu/mem.h"
+
+#define RAM_BASE 0x20000000u
+#define RAM_LOCKED 0x20000800u
+#define CALLER 0x08000050u
+
+static mm_u8 g_ram[4096];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[4];
+static struct mm_cpu g_cpu;
+static struct mm_intercept g_ic;
+
+static mm_bool deny_locked_writes(void *opaque, enum mm_access_type type, enum mm_sec_state sec,
+                                  mm_u32 addr, mm_u32 size_bytes)
+{
+    (void)opaque;
+    (void)sec;
+    if (type == MM_ACCESS_WRITE && addr + size_bytes > RAM_LOCKED) {
+        return MM_FALSE;
+    }
+    return MM_TRUE;
+}
+
+static void wr32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+    p[2] = (mm_u8)(v >> 16);
+    p[3] = (mm_u8)(v >> 24);
+}
+
+static int setup(const char *spec)
+{
+    static struct mm_elfsym syms[] = {
+        { 0x08000100u, 0x40u, "memcpy" },
+        { 0x08000200u, 0x20u, "strlen" },
+        { 0x08000300u, 0x80u, "sp_256_mont_mul_8" },
+    };
+    struct mm_elfsym_table table;
+    struct mm_target_cfg cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    memset(g_ram, 0, sizeof(g_ram));
+    mm_memmap_init(&g_map, g_regions, 4);
+    if (!mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE)) return 1;
+    mm_memmap_set_interceptor(&g_map, deny_locked_writes, 0);
+    memset(&g_cpu, 0, sizeof(g_cpu));
+    g_cpu.sec_state = MM_SECURE;
+    g_cpu.mode = MM_THREAD;
+    mm_cpu_set_msp(&g_cpu, MM_SECURE, RAM_BASE + 0xF00u);
+    mm_intercept_free(&g_ic);
+    mm_intercept_init(&g_ic);
+    if (!mm_intercept_parse(&g_ic, spec)) return 1;
+    table.syms = syms;
+    table.count = (int)(sizeof(syms) / sizeof(syms[0]));
+    table.strtab = 0;
+    if (mm_intercept_bind(&g_ic, &table) != g_ic.count) return 1;
+    return 0;
+}
+
+static void enter(mm_u32 fn, mm_u32 r0, mm_u32 r1, mm_u32 r2, mm_u32 r3)
+{
+    g_cpu.r[0] = r0;
+    g_cpu.r[1] = r1;
+    g_cpu.r[2] = r2;
+    g_cpu.r[3] = r3;
+    g_cpu.r[14] = CALLER | 1u;
+    g_cpu.r[15] = fn | 1u;
+}
+
+static int test_parse(void)
+{
+    mm_intercept_init(&g_ic);
+    if (!mm_intercept_parse(&g_ic, "memcpy,strlen:5+0.5,__aeabi_memclr4")) return 1;
+    if (g_ic.count != 3 || g_ic.entries[1].base_cycles != 5u ||
+        g_ic.entries[1].unit_q16 != 0x8000u) return 1;
+    mm_intercept_init(&g_ic);
+    if (mm_intercept_parse(&g_ic, "memcpy,not_a_routine")) return 1;
+    mm_intercept_init(&g_ic);
+    if (mm_intercept_parse(&g_ic, "memcpy:fast")) return 1;
+    return 0;
+}
+
+static int test_native_calls(void)
+{
+    mm_u32 i;
+    mm_u32 cost;
+
+    if (setup("memcpy,strlen:5+1") != 0) return 1;
+    for (i = 0; i < 100u; ++i) {
+        g_ram[0x100 + i] = (mm_u8)(i + 1u);
+    }
+    enter(0x08000100u, RAM_BASE + 0x400u, RAM_BASE + 0x100u, 100u, 0);
+    cost = mm_intercept_step(&g_ic, &g_cpu, &g_map);
+    if (cost != 16u + 50u) return 1;
+    if (memcmp(g_ram + 0x400, g_ram + 0x100, 100) != 0) return 1;
+    if (g_cpu.r[0] != RAM_BASE + 0x400u || g_cpu.r[15] != (CALLER | 1u)) return 1;
+
+    memcpy(g_ram + 0x200, "semihosted", 11);
+    enter(0x08000200u, RAM_BASE + 0x200u, 0, 0, 0);
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 15u || g_cpu.r[0] != 10u) return 1;
+
+    /* Not an entry point, an EXC_RETURN caller, or a protected buffer: emulate. */
+    g_cpu.r[15] = 0x08000103u;
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 0u) return 1;
+    enter(0x08000100u, RAM_BASE + 0x400u, RAM_BASE + 0x100u, 4u, 0);
+    g_cpu.r[14] = 0xFFFFFFF9u;
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 0u) return 1;
+    enter(0x08000100u, RAM_LOCKED - 8u, RAM_BASE + 0x100u, 16u, 0);
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 0u) return 1;
+    if (g_ram[0x7F8] != 0u || g_cpu.r[15] != (0x08000100u | 1u)) return 1;
+    if (g_ic.entries[0].calls != 1u || g_ic.entries[1].calls != 1u) return 1;
+    return 0;
+}
+
+static int test_mont_mul(void)
+{
+    static const mm_u32 a[8] = { 0x9f767c45u, 0x4164d839u, 0xbde5c099u, 0x5bc8fbbcu,
+                                 0xcb91ce37u, 0xb0c11fdeu, 0xf1446beau, 0x6bb6a198u };
+    static const mm_u32 b[8] = { 0xbd69fe29u, 0xa6eb8c9eu, 0xec1d7da0u, 0x87b0b125u,
+                                 0x076ce2efu, 0xd7210dffu, 0x77330bdbu, 0x63529c3bu };
+    static const mm_u32 p[8] = { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0x00000000u,
+                                 0x00000000u, 0x00000000u, 0x00000001u, 0xffffffffu };
+    static const mm_u32 r[8] = { 0xfe131d53u, 0x13d29abfu, 0x670b4dd7u, 0xf314aa04u,
+                                 0x8cca0f8fu, 0xb9871b8cu, 0x21ab0922u, 0x14867f03u };
+    int i;
+
+    if (setup("sp_256_mont_mul_8") != 0) return 1;
+    for (i = 0; i < 8; ++i) {
+        wr32(g_ram + 0x100 + 4 * i, a[i]);
+        wr32(g_ram + 0x140 + 4 * i, b[i]);
+        wr32(g_ram + 0x180 + 4 * i, p[i]);
+        wr32(g_ram + 0x400 + 4 * i, r[i]);
+    }
+    wr32(g_ram + 0xF00, 1u); /* mp for P-256, passed on the stack */
+    enter(0x08000300u, RAM_BASE + 0x200u, RAM_BASE + 0x100u, RAM_BASE + 0x140u, RAM_BASE + 0x180u);
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 650u) return 1;
+    if (memcmp(g_ram + 0x200, g_ram + 0x400, 32) != 0) return 1;
+    return 0;
+}
+
+static int test_verify(void)
+{
+    if (setup("memcpy") != 0) return 1;
+    g_ic.verify = MM_TRUE;
+    memcpy(g_ram + 0x100, "0123456789abcdef", 16);
+
+    /* The native result is recorded, the guest runs the real routine. */
+    enter(0x08000100u, RAM_BASE + 0x300u, RAM_BASE + 0x100u, 16u, 0);
+    if (mm_intercept_step(&g_ic, &g_cpu, &g_map) != 0u || !g_ic.pending) return 1;
+    if (g_ram[0x300] != 0u || g_cpu.r[0] != RAM_BASE + 0x300u) return 1;
+    memcpy(g_ram + 0x300, g_ram + 0x100, 16);
+    g_cpu.r[15] = CALLER | 1u;
+    mm_intercept_step(&g_ic, &g_cpu, &g_map);
+    if (g_ic.pending || g_ic.entries[0].verified != 1u || g_ic.entries[0].mismatches != 0u) return 1;
+
+    /* A guest routine that disagrees is counted. */
+    enter(0x08000100u, RAM_BASE + 0x300u, RAM_BASE + 0x108u, 8u, 0);
+    mm_intercept_step(&g_ic, &g_cpu, &g_map);
+    g_ram[0x303] ^= 0xFFu;
+    g_cpu.r[15] = CALLER | 1u;
+    mm_intercept_step(&g_ic, &g_cpu, &g_map);
+    if (g_ic.entries[0].verified != 2u || g_ic.entries[0].mismatches != 1u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "parse", test_parse },
+        { "native_calls", test_native_calls },
+        { "mont_mul", test_mont_mul },
+        { "verify", test_verify },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    mm_intercept_free(&g_ic);
+    if (failures != 0) {
+        printf("intercept_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
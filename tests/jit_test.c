@@ -0,0 +1,459 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/fetch.h"
+#include "m33mu/decode.h"
+#include "m33mu/memmap.h"
+#include "m33mu/scs.h"
+#include "m33mu/cpu.h"
+#include "m33mu/execute.h"
+#include "m33mu/jit.h"
+
+#ifdef M33MU_HAS_JIT
+
+#define RAM_BASE 0x20000000u
+#define DATA_OFF 0x100u
+#define RAM_LEN 0x200u
+
+static mm_bool stub_handle_pc_write(struct mm_cpu *cpu, struct mm_memmap *map, mm_u32 value,
+                                    mm_u8 *it_pattern, mm_u8 *it_remaining, mm_u8 *it_cond)
+{
+    (void)map;
+    (void)it_pattern;
+    (void)it_remaining;
+    (void)it_cond;
+    cpu->r[15] = value | 1u;
+    return MM_TRUE;
+}
+
+static mm_bool stub_raise_mem_fault(struct mm_cpu *cpu, struct mm_memmap *map, struct mm_scs *scs,
+                                    mm_u32 fault_pc, mm_u32 fault_xpsr, mm_u32 addr, mm_bool is_exec)
+{
+    (void)cpu;
+    (void)map;
+    (void)scs;
+    (void)fault_pc;
+    (void)fault_xpsr;
+    (void)addr;
+    (void)is_exec;
+    return MM_FALSE;
+}
+
+static mm_bool stub_raise_usage_fault(struct mm_cpu *cpu, struct mm_memmap *map, struct mm_scs *scs,
+                                      mm_u32 fault_pc, mm_u32 fault_xpsr, mm_u32 ufsr_bits)
+{
+    (void)cpu;
+    (void)map;
+    (void)scs;
+    (void)fault_pc;
+    (void)fault_xpsr;
+    (void)ufsr_bits;
+    return MM_FALSE;
+}
+
+static mm_bool stub_exc_return_unstack(struct mm_cpu *cpu, struct mm_memmap *map, mm_u32 exc_ret)
+{
+    (void)cpu;
+    (void)map;
+    (void)exc_ret;
+    return MM_FALSE;
+}
+
+static mm_bool stub_enter_exception(struct mm_cpu *cpu, struct mm_memmap *map, struct mm_scs *scs,
+                                    mm_u32 exc_num, mm_u32 return_pc, mm_u32 xpsr_in)
+{
+    (void)cpu;
+    (void)map;
+    (void)scs;
+    (void)exc_num;
+    (void)return_pc;
+    (void)xpsr_in;
+    return MM_FALSE;
+}
+
+static struct mmio_region g_regions[2];
+
+static void setup_map(struct mm_memmap *map, mm_u8 *ram)
+{
+    struct mm_target_cfg cfg;
+
+    memset(g_regions, 0, sizeof(g_regions));
+    mm_memmap_init(map, g_regions, 1u);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = RAM_BASE;
+    cfg.ram_size_s = RAM_LEN;
+    cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_ns = RAM_LEN;
+    (void)mm_memmap_configure_ram(map, &cfg, ram, MM_FALSE);
+}
+
+/* Interpret 'count' instructions starting at R15. */
+static int interpret(struct mm_cpu *cpu, struct mm_memmap *map, int count)
+{
+    struct mm_scs scs;
+    mm_u8 it_pattern = 0;
+    mm_u8 it_remaining = 0;
+    mm_u8 it_cond = 0;
+    mm_bool done = MM_FALSE;
+    int i;
+
+    memset(&scs, 0, sizeof(scs));
+    for (i = 0; i < count; ++i) {
+        struct mm_fetch_result fetch = mm_fetch_t32_memmap(cpu, map, cpu->sec_state);
+        struct mm_decoded dec;
+        struct mm_execute_ctx ctx;
+
+        if (fetch.fault) {
+            return 1;
+        }
+        dec = mm_decode_t32(&fetch);
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.cpu = cpu;
+        ctx.map = map;
+        ctx.scs = &scs;
+        ctx.fetch = &fetch;
+        ctx.dec = &dec;
+        ctx.it_pattern = &it_pattern;
+        ctx.it_remaining = &it_remaining;
+        ctx.it_cond = &it_cond;
+        ctx.done = &done;
+        ctx.handle_pc_write = stub_handle_pc_write;
+        ctx.raise_mem_fault = stub_raise_mem_fault;
+        ctx.raise_usage_fault = stub_raise_usage_fault;
+        ctx.exc_return_unstack = stub_exc_return_unstack;
+        ctx.enter_exception = stub_enter_exception;
+        if (mm_execute_decoded(&ctx) != MM_EXEC_OK || done) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Warm the block at R15 up and run it the way the main loop does: the
+ * first instruction has been fetched, so R15 already points past it.
+ */
+static mm_u32 jit_run(struct mm_jit *jit, struct mm_cpu *cpu)
+{
+    struct mm_jit_block *blk = 0;
+    mm_u32 pc = cpu->r[15] & ~1u;
+    mm_u32 i;
+
+    for (i = 0; i < MM_JIT_HOT_COUNT && blk == 0; ++i) {
+        blk = mm_jit_lookup(jit, cpu, pc);
+    }
+    if (blk == 0) {
+        return 0xffffffffu;
+    }
+    cpu->r[15] = (pc + 2u) | 1u;
+    return mm_jit_exec(jit, cpu, blk);
+}
+
+static void put16(mm_u8 *p, mm_u32 hw)
+{
+    p[0] = (mm_u8)(hw & 0xffu);
+    p[1] = (mm_u8)(hw >> 8);
+}
+
+static mm_u32 g_seed = 0x12345678u;
+
+static mm_u32 rnd(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed;
+}
+
+/* A random translatable instruction; r7 stays the data pointer. */
+static mm_u32 random_insn(void)
+{
+    mm_u32 rd = rnd() % 7u;
+    mm_u32 rn = rnd() % 8u;
+    mm_u32 rm = rnd() % 8u;
+    mm_u32 imm8 = rnd() & 0xffu;
+    mm_u32 imm3 = rnd() & 7u;
+    static const mm_u32 alu_ops[] = { 0x0u, 0x1u, 0x8u, 0xau, 0xcu };
+    switch (rnd() % 16u) {
+    case 0: return 0x2000u | (rd << 8) | imm8;                 /* movs rd, #imm8 */
+    case 1: return 0x1c00u | (imm3 << 6) | (rn << 3) | rd;     /* adds rd, rn, #imm3 */
+    case 2: return 0x1e00u | (imm3 << 6) | (rn << 3) | rd;     /* subs rd, rn, #imm3 */
+    case 3: return 0x3000u | (rd << 8) | imm8;                 /* adds rd, #imm8 */
+    case 4: return 0x3800u | (rd << 8) | imm8;                 /* subs rd, #imm8 */
+    case 5: return 0x1800u | (rm << 6) | (rn << 3) | rd;       /* adds rd, rn, rm */
+    case 6: return 0x1a00u | (rm << 6) | (rn << 3) | rd;       /* subs rd, rn, rm */
+    case 7: return 0x2800u | (rn << 8) | imm8;                 /* cmp rn, #imm8 */
+    case 8: return 0x4000u | (alu_ops[rnd() % 5u] << 6) | (rm << 3) | rd; /* ands/eors/tst/cmp/orrs */
+    case 9: return 0x4400u | (rm << 3) | rd;                   /* add rd, rm */
+    case 10: return 0x4600u | (rm << 3) | rd;                  /* mov rd, rm */
+    case 11: return 0x6800u | ((rnd() % 8u) << 6) | (7u << 3) | rd; /* ldr rd, [r7, #n] */
+    case 12: return 0x6000u | ((rnd() % 8u) << 6) | (7u << 3) | rm; /* str rm, [r7, #n] */
+    case 13: return 0x7800u | ((rnd() % 32u) << 6) | (7u << 3) | rd; /* ldrb */
+    case 14: return 0x7000u | ((rnd() % 32u) << 6) | (7u << 3) | rm; /* strb */
+    default: return ((rnd() & 1u) ? 0x8800u : 0x8000u) | ((rnd() % 16u) << 6) | (7u << 3) | rd; /* ldrh/strh */
+    }
+}
+
+static void random_state(struct mm_cpu *cpu, mm_u8 *ram)
+{
+    static const mm_u32 edges[] = { 0u, 1u, 0x7fffffffu, 0x80000000u, 0xffffffffu, 0xffu };
+    int i;
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->sec_state = MM_SECURE;
+    cpu->mode = MM_THREAD;
+    for (i = 0; i < 7; ++i) {
+        cpu->r[i] = (rnd() & 1u) ? edges[rnd() % 6u] : rnd();
+    }
+    cpu->r[7] = RAM_BASE + DATA_OFF;
+    cpu->xpsr = (rnd() & 0xf0000000u) | 0x01000000u;
+    cpu->r[15] = RAM_BASE | 1u;
+    for (i = DATA_OFF; i < (int)RAM_LEN; ++i) {
+        ram[i] = (mm_u8)rnd();
+    }
+}
+
+static int test_differential(void)
+{
+    static mm_u8 ram_i[RAM_LEN];
+    static mm_u8 ram_j[RAM_LEN];
+    struct mm_memmap map_i;
+    struct mm_memmap map_j;
+    struct mm_jit jit;
+    int iter;
+    int rc = 0;
+
+    setup_map(&map_i, ram_i);
+    setup_map(&map_j, ram_j);
+    if (!mm_jit_init(&jit, &map_j)) return 1;
+    for (iter = 0; iter < 2000 && rc == 0; ++iter) {
+        struct mm_cpu cpu_i;
+        struct mm_cpu cpu_j;
+        mm_u32 retired;
+        int i;
+
+        random_state(&cpu_i, ram_i);
+        for (i = 0; i < 15; ++i) {
+            put16(ram_i + 2 * i, random_insn());
+        }
+        /* A b<cond>, b or cbz/cbnz closes the block. */
+        switch (rnd() % 3u) {
+        case 0: put16(ram_i + 30, 0xd000u | ((rnd() % 14u) << 8) | (rnd() & 0xffu)); break;
+        case 1: put16(ram_i + 30, 0xe000u | (rnd() & 0x7ffu)); break;
+        default: put16(ram_i + 30, 0xb100u | (rnd() & 0x0800u) | (rnd() & 0x02f8u) | (rnd() % 7u)); break;
+        }
+        memcpy(ram_j, ram_i, RAM_LEN);
+        cpu_j = cpu_i;
+
+        if (interpret(&cpu_i, &map_i, 16) != 0) rc = 1;
+        retired = jit_run(&jit, &cpu_j);
+        if (retired != 16u) rc = 1;
+        if (memcmp(cpu_i.r, cpu_j.r, sizeof(cpu_i.r)) != 0) rc = 1;
+        if (cpu_i.xpsr != cpu_j.xpsr) rc = 1;
+        if (memcmp(ram_i, ram_j, RAM_LEN) != 0) rc = 1;
+        if (rc != 0) {
+            printf("  mismatch at iteration %d (retired %u)\n", iter, (unsigned)retired);
+            for (i = 0; i < 16; ++i) {
+                if (cpu_i.r[i] != cpu_j.r[i]) {
+                    printf("  r%d interp=0x%08x jit=0x%08x\n", i, (unsigned)cpu_i.r[i], (unsigned)cpu_j.r[i]);
+                }
+            }
+            printf("  xpsr interp=0x%08x jit=0x%08x\n", (unsigned)cpu_i.xpsr, (unsigned)cpu_j.xpsr);
+        }
+    }
+    /* Every iteration rewrote the block: each one had to be retranslated. */
+    if (rc == 0 && jit.blocks_built != 2000u) rc = 1;
+    mm_jit_free(&jit);
+    return rc;
+}
+
+static int test_mmio_access_exits(void)
+{
+    static mm_u8 ram[RAM_LEN];
+    struct mm_memmap map;
+    struct mm_jit jit;
+    struct mm_cpu cpu;
+    mm_u32 retired;
+
+    memset(ram, 0, sizeof(ram));
+    setup_map(&map, ram);
+    put16(ram + 0, 0x2005u);   /* movs r0, #5 */
+    put16(ram + 2, 0x6839u);   /* ldr r1, [r7, #0] */
+    put16(ram + 4, 0x3001u);   /* adds r0, #1 */
+    put16(ram + 6, 0xe7fbu);   /* b . - 6 */
+    if (!mm_jit_init(&jit, &map)) return 1;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[15] = RAM_BASE | 1u;
+    cpu.r[7] = 0x40000000u;    /* not backed: MMIO/fault path */
+    cpu.r[1] = 0x1234u;
+    retired = jit_run(&jit, &cpu);
+    if (retired != 1u || cpu.r[0] != 5u || cpu.r[1] != 0x1234u) return 1;
+    if (cpu.r[15] != ((RAM_BASE + 2u) | 1u)) return 1;
+
+    /* With the load backed by RAM the whole block runs. */
+    cpu.r[15] = RAM_BASE | 1u;
+    cpu.r[7] = RAM_BASE + DATA_OFF;
+    ram[DATA_OFF] = 0x42u;
+    retired = jit_run(&jit, &cpu);
+    if (retired != 4u || cpu.r[0] != 6u || cpu.r[1] != 0x42u) return 1;
+    if (cpu.r[15] != (RAM_BASE | 1u) || jit.last == 0 || jit.last_pc != RAM_BASE + 6u) return 1;
+    mm_jit_free(&jit);
+    return 0;
+}
+
+static int test_self_modifying_store(void)
+{
+    static mm_u8 ram[RAM_LEN];
+    struct mm_memmap map;
+    struct mm_jit jit;
+    struct mm_cpu cpu;
+    mm_u32 retired;
+
+    memset(ram, 0, sizeof(ram));
+    setup_map(&map, ram);
+    put16(ram + 0, 0x80b9u);   /* strh r1, [r7, #4] */
+    put16(ram + 2, 0x3001u);   /* adds r0, #1 */
+    put16(ram + 4, 0x3001u);   /* adds r0, #1 (patched to adds r0, #2) */
+    put16(ram + 6, 0xe7fbu);   /* b . - 6 */
+    if (!mm_jit_init(&jit, &map)) return 1;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[15] = RAM_BASE | 1u;
+    cpu.r[7] = RAM_BASE + DATA_OFF;
+    retired = jit_run(&jit, &cpu);
+    if (retired != 4u || cpu.r[0] != 2u) return 1;
+
+    /* A store into the running block ends it right after the store... */
+    cpu.r[7] = RAM_BASE;
+    cpu.r[1] = 0x3002u;
+    cpu.r[15] = (RAM_BASE + 2u) | 1u;
+    retired = mm_jit_exec(&jit, &cpu, mm_jit_lookup(&jit, &cpu, RAM_BASE));
+    if (retired != 1u || cpu.r[15] != ((RAM_BASE + 2u) | 1u)) return 1;
+    /* ...and the stale translation is never entered again. */
+    if (mm_jit_lookup(&jit, &cpu, RAM_BASE) != 0) return 1;
+    cpu.r[7] = RAM_BASE + DATA_OFF;
+    cpu.r[15] = RAM_BASE | 1u;
+    cpu.r[0] = 0;
+    retired = jit_run(&jit, &cpu);
+    if (retired != 4u || cpu.r[0] != 3u) return 1;
+    mm_jit_free(&jit);
+    return 0;
+}
+
+/* Explicit invalidation drops a hot block even when the bytes match again. */
+static int test_invalidate(void)
+{
+    static mm_u8 ram[RAM_LEN];
+    struct mm_memmap map;
+    struct mm_jit jit;
+    struct mm_cpu cpu;
+
+    memset(ram, 0, sizeof(ram));
+    setup_map(&map, ram);
+    put16(ram + 0, 0x3001u);   /* adds r0, #1 */
+    put16(ram + 2, 0xe7fdu);   /* b . - 2 */
+    if (!mm_jit_init(&jit, &map)) return 1;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[15] = RAM_BASE | 1u;
+    if (jit_run(&jit, &cpu) != 2u) return 1;
+    if (mm_jit_lookup(&jit, &cpu, RAM_BASE) == 0) return 1;
+    mm_jit_invalidate(&jit, RAM_BASE + 0x100u, 4u);
+    if (mm_jit_lookup(&jit, &cpu, RAM_BASE) == 0) return 1;
+    mm_jit_invalidate(&jit, RAM_BASE + 2u, 1u);
+    if (mm_jit_lookup(&jit, &cpu, RAM_BASE) != 0) return 1;
+    mm_jit_free(&jit);
+    return 0;
+}
+
+/* The code cache is written and executed through different views, and no
+ * mapping in the process is writable and executable at once. */
+static int test_wx_mapping(void)
+{
+    static mm_u8 ram[RAM_LEN];
+    struct mm_memmap map;
+    struct mm_jit jit;
+    struct mm_cpu cpu;
+    struct mm_jit_block *blk;
+    char line[512];
+    FILE *maps;
+    int rwx = 0;
+
+    memset(ram, 0, sizeof(ram));
+    setup_map(&map, ram);
+    put16(ram + 0, 0x3001u);   /* adds r0, #1 */
+    put16(ram + 2, 0xe7fdu);   /* b . - 2 */
+    if (!mm_jit_init(&jit, &map)) return 1;
+    if (jit.exec == 0 || jit.exec == jit.code) return 1;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[15] = RAM_BASE | 1u;
+    if (jit_run(&jit, &cpu) != 2u) return 1;
+    blk = mm_jit_lookup(&jit, &cpu, RAM_BASE);
+    if (blk == 0) return 1;
+    if ((mm_u8 *)blk->host < jit.exec || (mm_u8 *)blk->host >= jit.exec + MM_JIT_CODE_SIZE) return 1;
+    maps = fopen("/proc/self/maps", "r");
+    if (maps != 0) {
+        while (fgets(line, sizeof(line), maps) != 0) {
+            char perms[8];
+            if (sscanf(line, "%*s %7s", perms) == 1 && perms[1] == 'w' && perms[2] == 'x') {
+                rwx++;
+            }
+        }
+        fclose(maps);
+    }
+    mm_jit_free(&jit);
+    return rwx == 0 ? 0 : 1;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "differential", test_differential },
+        { "mmio_access_exits", test_mmio_access_exits },
+        { "self_modifying_store", test_self_modifying_store },
+        { "invalidate", test_invalidate },
+        { "wx_mapping", test_wx_mapping },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("jit_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int main(void)
+{
+    printf("jit_test: built without M33MU_HAS_JIT, nothing to test\n");
+    return 0;
+}
+
+#endif
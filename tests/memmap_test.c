@@ -49,6 +49,7 @@ static int test_banked_flash_same_backing(void)
     cfg.ram_base_s = cfg.ram_base_ns = 0;
     cfg.ram_size_s = cfg.ram_size_ns = 0;
 
+    memset(flash, 0, sizeof(flash));
     flash[0] = 0x12;
     flash[1] = 0x34;
     mm_memmap_init(&map, regions, 4);
@@ -106,12 +107,86 @@ static int test_interceptor_blocks_write(void)
     return 0;
 }
 
+static int test_host_ptr_bulk(void)
+{
+    struct mm_memmap map;
+    struct mmio_region regions[4];
+    struct mm_target_cfg cfg;
+    mm_u8 flash[64];
+    mm_u8 ram[64];
+    const mm_u8 *rp;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.flash_base_s = cfg.flash_base_ns = 0x0u;
+    cfg.flash_size_s = cfg.flash_size_ns = sizeof(flash);
+    cfg.ram_base_s = cfg.ram_base_ns = 0x20000000u;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(ram);
+    memset(flash, 0xa5, sizeof(flash));
+    memset(ram, 0, sizeof(ram));
+
+    mm_memmap_init(&map, regions, 4);
+    if (!mm_memmap_configure_flash(&map, &cfg, flash, MM_TRUE)) return 1;
+    if (!mm_memmap_configure_ram(&map, &cfg, ram, MM_TRUE)) return 1;
+    map.flash.base = 0x0u;
+    map.ram.base = 0x20000000u;
+
+    rp = mm_memmap_host_read_ptr(&map, 0x10u, 32u);
+    if (rp != flash + 0x10) return 1;
+    if (mm_memmap_host_write_ptr(&map, 0x10u, 4u) != 0) return 1;
+    if (mm_memmap_host_read_ptr(&map, 0x30u, 32u) != 0) return 1;
+    if (mm_memmap_host_write_ptr(&map, 0x20000008u, 16u) != ram + 8) return 1;
+    if (mm_memmap_host_write_ptr(&map, 0x20000038u, 16u) != 0) return 1;
+
+    if (!mm_memmap_access_ok(&map, MM_ACCESS_WRITE, MM_SECURE, 0x20000000u, 64u)) return 1;
+    mm_memmap_set_interceptor(&map, deny_write, 0);
+    if (mm_memmap_access_ok(&map, MM_ACCESS_WRITE, MM_SECURE, 0x20000000u, 64u)) return 1;
+    if (!mm_memmap_access_ok(&map, MM_ACCESS_READ, MM_SECURE, 0x20000000u, 64u)) return 1;
+    if (mm_memmap_access_ok(&map, MM_ACCESS_READ, MM_SECURE, 0xfffffff0u, 32u)) return 1;
+    return 0;
+}
+
+static int test_rom_xip(void)
+{
+    struct mm_memmap map;
+    struct mmio_region regions[4];
+    mm_u8 rom[64];
+    mm_bool locked = MM_FALSE;
+    mm_u32 val = 0;
+    mm_u8 b = 0;
+    mm_u32 i;
+
+    for (i = 0; i < sizeof(rom); ++i) {
+        rom[i] = (mm_u8)(0x40u + i);
+    }
+    mm_memmap_init(&map, regions, 4);
+    if (!mm_memmap_add_rom(&map, 0x90000000u, sizeof(rom), rom, &locked)) return 1;
+    if (!mm_memmap_read(&map, MM_SECURE, 0x90000004u, 4u, &val)) return 1;
+    if (val != 0x47464544u) return 1;
+    if (!mm_memmap_read8(&map, MM_NONSECURE, 0x9000003fu, &b) || b != 0x7fu) return 1;
+    if (!mm_memmap_fetch_read16(&map, MM_SECURE, 0x90000010u, &val)) return 1;
+    if (val != 0x5150u) return 1;
+    if (mm_memmap_fetch_read16(&map, MM_SECURE, 0x9000003fu, &val)) return 1;
+    if (mm_memmap_host_read_ptr(&map, 0x90000020u, 32u) != rom + 32) return 1;
+    if (mm_memmap_host_write_ptr(&map, 0x90000020u, 4u) != 0) return 1;
+    if (mm_memmap_write(&map, MM_SECURE, 0x90000000u, 4u, 0u)) return 1;
+    if (rom[0] != 0x40u) return 1;
+
+    /* A locked window behaves as if the backing were absent. */
+    locked = MM_TRUE;
+    if (mm_memmap_read(&map, MM_SECURE, 0x90000004u, 4u, &val)) return 1;
+    if (mm_memmap_fetch_read16(&map, MM_SECURE, 0x90000010u, &val)) return 1;
+    if (mm_memmap_host_read_ptr(&map, 0x90000020u, 4u) != 0) return 1;
+    return 0;
+}
+
 int main(void)
 {
     struct { const char *name; int (*fn)(void); } tests[] = {
         { "banked_flash", test_banked_flash_same_backing },
         { "ram_write_read", test_ram_write_read },
         { "interceptor_blocks", test_interceptor_blocks_write },
+        { "host_ptr_bulk", test_host_ptr_bulk },
+        { "rom_xip", test_rom_xip },
     };
     const int count = (int)(sizeof(tests) / sizeof(tests[0]));
     int failures = 0;
@@ -0,0 +1,176 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/memmap.h"
+#include "m33mu/nvic.h"
+#include "nrf5340/nrf5340_mmio.h"
+#include "nrf5340/nrf5340_uart_spi.h"
+
+#define RAM_BASE 0x20000000u
+#define UARTE0 0x40008000u
+#define UARTE0_IRQ 8u
+
+#define TASKS_STARTTX 0x008u
+#define TASKS_STOPTX 0x00Cu
+#define EVENTS_ENDTX 0x120u
+#define EVENTS_TXSTARTED 0x150u
+#define EVENTS_TXSTOPPED 0x158u
+#define INTENSET 0x304u
+#define ENABLE 0x500u
+#define BAUDRATE 0x524u
+#define TXD_PTR 0x544u
+#define TXD_MAXCNT 0x548u
+#define TXD_AMOUNT 0x54Cu
+
+#define BAUD_115200 0x01D7E000u
+
+static mm_u8 g_ram[1024];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[16];
+static struct mm_nvic g_nvic;
+static mm_u64 g_frame;
+
+static void wr(mm_u32 off, mm_u32 v)
+{
+    mmio_bus_write(&g_map.mmio, UARTE0 + off, 4u, v);
+}
+
+static mm_u32 rd(mm_u32 off)
+{
+    mm_u32 v = 0;
+    mmio_bus_read(&g_map.mmio, UARTE0 + off, 4u, &v);
+    return v;
+}
+
+static int setup(void)
+{
+    struct mm_target_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    memset(g_ram, 0, sizeof(g_ram));
+    mm_nrf5340_usart_reset();
+    mm_nrf5340_mmio_reset();
+    mm_memmap_init(&g_map, g_regions, 16);
+    if (!mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE)) return 1;
+    mm_nvic_init(&g_nvic);
+    mm_nrf5340_usart_init(&g_map.mmio, &g_nvic);
+    /* 115200 baud, 8N1: ten bits per character */
+    g_frame = (10u * mm_nrf5340_cpu_hz() + 115203u - 1u) / 115203u;
+    memcpy(g_ram, "hello", 5u);
+    wr(ENABLE, 8u);
+    wr(BAUDRATE, BAUD_115200);
+    wr(INTENSET, 1u << 8);
+    return 0;
+}
+
+static void start_tx(mm_u32 len)
+{
+    wr(TXD_PTR, RAM_BASE);
+    wr(TXD_MAXCNT, len);
+    wr(TASKS_STARTTX, 1u);
+}
+
+static int test_endtx_timing(void)
+{
+    if (setup() != 0) return 1;
+    start_tx(4u);
+    if (rd(EVENTS_TXSTARTED) != 1u || rd(EVENTS_ENDTX) != 0u) return 1;
+    mm_nrf5340_serial_tick(4u * g_frame - 8u);
+    if (rd(EVENTS_ENDTX) != 0u || mm_nvic_is_pending(&g_nvic, UARTE0_IRQ)) return 1;
+    mm_nrf5340_serial_tick(8u);
+    if (rd(EVENTS_ENDTX) != 1u || rd(TXD_AMOUNT) != 4u) return 1;
+    if (!mm_nvic_is_pending(&g_nvic, UARTE0_IRQ)) return 1;
+    return 0;
+}
+
+static int test_stoptx(void)
+{
+    if (setup() != 0) return 1;
+    start_tx(4u);
+    mm_nrf5340_serial_tick(g_frame + g_frame / 2u);
+    wr(TASKS_STOPTX, 1u);
+    /* ENDTX is forced with the bytes that reached the wire, then TXSTOPPED */
+    if (rd(EVENTS_ENDTX) != 1u || rd(EVENTS_TXSTOPPED) != 1u) return 1;
+    if (rd(TXD_AMOUNT) != 2u) return 1;
+    wr(EVENTS_ENDTX, 0u);
+    mm_nrf5340_serial_tick(8u * g_frame);
+    if (rd(EVENTS_ENDTX) != 0u) return 1;
+    /* STOPTX while idle still reports TXSTOPPED, without ENDTX */
+    wr(EVENTS_TXSTOPPED, 0u);
+    wr(TASKS_STOPTX, 1u);
+    if (rd(EVENTS_TXSTOPPED) != 1u || rd(EVENTS_ENDTX) != 0u) return 1;
+    return 0;
+}
+
+static int test_restart(void)
+{
+    if (setup() != 0) return 1;
+    start_tx(4u);
+    wr(EVENTS_TXSTARTED, 0u);
+    start_tx(2u);
+    /* The second buffer waits for the first one to leave the wire */
+    if (rd(EVENTS_TXSTARTED) != 0u) return 1;
+    mm_nrf5340_serial_tick(4u * g_frame);
+    if (rd(EVENTS_ENDTX) != 1u || rd(TXD_AMOUNT) != 4u) return 1;
+    if (rd(EVENTS_TXSTARTED) != 1u) return 1;
+    wr(EVENTS_ENDTX, 0u);
+    mm_nrf5340_serial_tick(2u * g_frame - 8u);
+    if (rd(EVENTS_ENDTX) != 0u) return 1;
+    mm_nrf5340_serial_tick(8u);
+    if (rd(EVENTS_ENDTX) != 1u || rd(TXD_AMOUNT) != 2u) return 1;
+    /* One tick spanning both buffers delivers both ENDTX */
+    wr(EVENTS_ENDTX, 0u);
+    start_tx(1u);
+    start_tx(1u);
+    mm_nrf5340_serial_tick(2u * g_frame);
+    if (rd(EVENTS_ENDTX) != 1u || rd(TXD_AMOUNT) != 1u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "endtx_timing", test_endtx_timing },
+        { "stoptx", test_stoptx },
+        { "restart", test_restart },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    mm_nrf5340_usart_reset();
+    if (failures != 0) {
+        printf("nrf5340_uarte_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "m33mu/pcap.h"
+
+struct epb_info {
+    mm_u64 ts;
+    mm_u32 cap_len;
+    mm_u32 orig_len;
+    mm_u8 data[MM_PCAP_SNAPLEN];
+    mm_u32 dir;
+    char comment[128];
+};
+
+static mm_u32 get16(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8);
+}
+
+static mm_u32 get32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static mm_u8 *slurp(const char *path, long *len)
+{
+    FILE *f = fopen(path, "rb");
+    mm_u8 *buf;
+    if (f == 0) return 0;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (mm_u8 *)malloc((size_t)*len + 1u);
+    if (buf != 0 && fread(buf, 1, (size_t)*len, f) != (size_t)*len) {
+        free(buf);
+        buf = 0;
+    }
+    fclose(f);
+    return buf;
+}
+
+/* Check the section/interface headers and decode up to max EPBs.
+ * Returns the number of EPBs, or -1 on a malformed file. */
+static int parse_file(const char *path, struct epb_info *out, int max)
+{
+    long len = 0;
+    mm_u8 *buf = slurp(path, &len);
+    long off = 0;
+    int count = 0;
+    int blocks = 0;
+    if (buf == 0) return -1;
+    while (off + 12 <= len) {
+        mm_u32 type = get32(buf + off);
+        mm_u32 blen = get32(buf + off + 4);
+        if (blen < 12u || off + (long)blen > len || get32(buf + off + blen - 4u) != blen) {
+            count = -1;
+            break;
+        }
+        if (blocks == 0 && (type != 0x0a0d0d0au || get32(buf + off + 8) != 0x1a2b3c4du)) {
+            count = -1;
+            break;
+        }
+        if (blocks == 1 && (type != 1u || get16(buf + off + 8) != 1u)) {
+            count = -1;
+            break;
+        }
+        if (type == 6u && count < max) {
+            struct epb_info *e = &out[count];
+            const mm_u8 *b = buf + off;
+            mm_u32 o;
+            memset(e, 0, sizeof(*e));
+            e->ts = ((mm_u64)get32(b + 12) << 32) | get32(b + 16);
+            e->cap_len = get32(b + 20);
+            e->orig_len = get32(b + 24);
+            memcpy(e->data, b + 28, e->cap_len);
+            o = 28u + ((e->cap_len + 3u) & ~3u);
+            while (o + 4u <= blen - 4u) {
+                mm_u32 code = get16(b + o);
+                mm_u32 olen = get16(b + o + 2u);
+                if (code == 0u) break;
+                if (code == 2u) e->dir = get32(b + o + 4u) & 3u;
+                if (code == 1u && olen < sizeof(e->comment)) memcpy(e->comment, b + o + 4u, olen);
+                o += 4u + ((olen + 3u) & ~3u);
+            }
+            count++;
+        }
+        blocks++;
+        off += (long)blen;
+    }
+    if (off != len) count = -1;
+    free(buf);
+    return count;
+}
+
+static void tmp_path(char *out, size_t len, const char *tag)
+{
+    snprintf(out, len, "/tmp/m33mu-pcap-%ld-%s.pcapng", (long)getpid(), tag);
+}
+
+static int test_blocks(void)
+{
+    struct mm_pcap p;
+    struct epb_info e[4];
+    char path[128];
+    mm_u8 frame[60];
+    int rc = 0;
+    mm_u32 i;
+    for (i = 0; i < sizeof(frame); ++i) frame[i] = (mm_u8)i;
+    tmp_path(path, sizeof(path), "blocks");
+    if (!mm_pcap_open(&p, path, 0)) return 1;
+    mm_pcap_record(&p, 5000000123ull, 100u, MM_PCAP_OUT, 0, frame, 60u);
+    mm_pcap_record(&p, 5000000456ull, 200u, MM_PCAP_IN, 0, frame, 42u);
+    mm_pcap_record(&p, 6000000000ull, 300u, MM_PCAP_IN | MM_PCAP_DROPPED, "no rx descriptor", frame, 60u);
+    mm_pcap_record(&p, 7u, MM_PCAP_NO_CYCLES, MM_PCAP_IN, 0, frame, 14u);
+    mm_pcap_close(&p);
+    if (p.frames != 4u || p.lost != 0u) rc = 1;
+    if (parse_file(path, e, 4) != 4) {
+        unlink(path);
+        return 1;
+    }
+    if (e[0].ts != 5000000123ull || e[0].dir != 2u || e[0].cap_len != 60u) rc = 1;
+    if (memcmp(e[0].data, frame, 60u) != 0 || strcmp(e[0].comment, "cycle=100") != 0) rc = 1;
+    if (e[1].dir != 1u || e[1].cap_len != 42u || e[1].orig_len != 42u) rc = 1;
+    if (strcmp(e[2].comment, "cycle=300 dropped: no rx descriptor") != 0) rc = 1;
+    if (e[3].ts != 7u || e[3].comment[0] != '\0') rc = 1;
+    unlink(path);
+    return rc;
+}
+
+static int test_snaplen(void)
+{
+    struct mm_pcap p;
+    struct epb_info e[1];
+    char path[128];
+    static mm_u8 big[3000];
+    int rc = 0;
+    tmp_path(path, sizeof(path), "snap");
+    if (!mm_pcap_open(&p, path, 0)) return 1;
+    mm_pcap_record(&p, 1u, 1u, MM_PCAP_OUT, 0, big, sizeof(big));
+    mm_pcap_close(&p);
+    if (parse_file(path, e, 1) != 1) rc = 1;
+    else if (e[0].cap_len != MM_PCAP_SNAPLEN || e[0].orig_len != sizeof(big)) rc = 1;
+    unlink(path);
+    return rc;
+}
+
+static int test_rotate(void)
+{
+    struct mm_pcap p;
+    struct epb_info e[16];
+    char path[128];
+    char name[160];
+    mm_u8 frame[100];
+    int total = 0;
+    int rc = 0;
+    mm_u32 i;
+    memset(frame, 0xab, sizeof(frame));
+    tmp_path(path, sizeof(path), "rot");
+    if (!mm_pcap_open(&p, path, 400u)) return 1;
+    for (i = 0; i < 10u; ++i) {
+        mm_pcap_record(&p, i, i, MM_PCAP_OUT, 0, frame, sizeof(frame));
+    }
+    mm_pcap_close(&p);
+    if (p.file_index == 0u) rc = 1;
+    for (i = 0; i <= p.file_index; ++i) {
+        long len = 0;
+        mm_u8 *buf;
+        int n;
+        if (i == 0u) snprintf(name, sizeof(name), "%s", path);
+        else snprintf(name, sizeof(name), "%s.%u", path, (unsigned)i);
+        buf = slurp(name, &len);
+        /* Every file stays within the limit and is a complete section. */
+        if (buf == 0 || len > 400) rc = 1;
+        free(buf);
+        n = parse_file(name, e, 16);
+        if (n <= 0) rc = 1;
+        else total += n;
+        unlink(name);
+    }
+    if (total != 10) rc = 1;
+    return rc;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "blocks", test_blocks },
+        { "snaplen", test_snaplen },
+        { "rotate", test_rotate },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("pcap_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/predecode.h"
+
+#define BASE_S 0x0c000000u
+#define BASE_NS 0x08000000u
+
+static const char *k_cache_dir = ".";
+static mm_u8 g_flash[64];
+
+static void load_code(void)
+{
+    /* movs r0,#1; movw r1,#0x1234; adds r0,r0,r1; bne.n .-4; bx lr; ldr.w r2,[r3,#4] */
+    static const mm_u16 hw[] = {
+        0x2001u, 0xf241u, 0x2134u, 0x1840u, 0xd1fcu, 0x4770u, 0xf8d3u, 0x2004u
+    };
+    size_t i;
+    memset(g_flash, 0xff, sizeof(g_flash));
+    for (i = 0; i < sizeof(hw) / sizeof(hw[0]); ++i) {
+        g_flash[i * 2u] = (mm_u8)(hw[i] & 0xffu);
+        g_flash[i * 2u + 1u] = (mm_u8)(hw[i] >> 8);
+    }
+}
+
+static struct mm_fetch_result fetch_at(mm_u32 addr, mm_u32 base)
+{
+    struct mm_fetch_result f;
+    mm_u32 off = addr - base;
+    mm_u16 hw1 = (mm_u16)(g_flash[off] | (g_flash[off + 1u] << 8));
+    memset(&f, 0, sizeof(f));
+    f.pc_fetch = addr;
+    if (t32_is_32bit_prefix(hw1)) {
+        f.insn = ((mm_u32)hw1 << 16) | (mm_u16)(g_flash[off + 2u] | (g_flash[off + 3u] << 8));
+        f.len = 4;
+    } else {
+        f.insn = hw1;
+        f.len = 2;
+    }
+    return f;
+}
+
+static int same_decode(const struct mm_decoded *a, const struct mm_decoded *b)
+{
+    return a->kind == b->kind && a->cond == b->cond && a->rd == b->rd && a->rn == b->rn &&
+           a->rm == b->rm && a->ra == b->ra && a->imm == b->imm && a->len == b->len &&
+           a->raw == b->raw && a->undefined == b->undefined;
+}
+
+/* Every halfword, in either alias, decodes exactly as mm_decode_t32 does. */
+static int test_matches_decoder(void)
+{
+    struct mm_predecode pd;
+    mm_u32 off;
+    load_code();
+    mm_predecode_init(&pd);
+    if (!mm_predecode_build(&pd, g_flash, sizeof(g_flash) - 2u, BASE_S, BASE_NS)) return 1;
+    for (off = 0; off + 4u <= sizeof(g_flash) - 2u; off += 2u) {
+        struct mm_fetch_result f = fetch_at(BASE_S + off, BASE_S);
+        struct mm_decoded want = mm_decode_t32(&f);
+        struct mm_decoded got = mm_predecode_decode(&pd, &f);
+        if (!same_decode(&want, &got)) return 1;
+        f.pc_fetch = BASE_NS + off;
+        got = mm_predecode_decode(&pd, &f);
+        if (!same_decode(&want, &got)) return 1;
+    }
+    if (pd.misses != 0u || pd.hits == 0u) return 1;
+    mm_predecode_free(&pd);
+    return 0;
+}
+
+/* Reprogrammed flash misses and is decoded from the fetched bits. */
+static int test_stale_entry(void)
+{
+    struct mm_predecode pd;
+    struct mm_fetch_result f;
+    struct mm_decoded d;
+    load_code();
+    mm_predecode_init(&pd);
+    if (!mm_predecode_build(&pd, g_flash, sizeof(g_flash), BASE_S, BASE_NS)) return 1;
+    g_flash[0] = 0x02u; /* movs r0,#2 */
+    f = fetch_at(BASE_S, BASE_S);
+    d = mm_predecode_decode(&pd, &f);
+    if (d.raw != 0x2002u || d.imm != 2u || pd.misses != 1u) return 1;
+    d = mm_predecode_decode(&pd, &f);
+    if (d.imm != 2u || pd.hits != 1u) return 1;
+    mm_predecode_free(&pd);
+    return 0;
+}
+
+/* Invalidated entries stop feeding peek() hints, in both aliases. */
+static int test_invalidate(void)
+{
+    struct mm_predecode pd;
+    load_code();
+    mm_predecode_init(&pd);
+    if (!mm_predecode_build(&pd, g_flash, sizeof(g_flash), BASE_S, BASE_NS)) return 1;
+    if (mm_predecode_peek(&pd, BASE_S + 4u) == 0 || mm_predecode_peek(&pd, BASE_S + 8u) == 0) return 1;
+    mm_predecode_invalidate(&pd, BASE_NS + 6u, 1u);
+    if (mm_predecode_peek(&pd, BASE_S + 6u) != 0) return 1;
+    if (mm_predecode_peek(&pd, BASE_S + 4u) != 0) return 1; /* may be a T32 over +6 */
+    if (mm_predecode_peek(&pd, BASE_S + 2u) == 0 || mm_predecode_peek(&pd, BASE_S + 8u) == 0) return 1;
+    mm_predecode_invalidate(&pd, BASE_S - 16u, 8u);
+    if (mm_predecode_peek(&pd, BASE_S) == 0) return 1;
+    mm_predecode_free(&pd);
+    return 0;
+}
+
+static int test_outside_range(void)
+{
+    struct mm_predecode pd;
+    struct mm_fetch_result f;
+    struct mm_decoded d;
+    load_code();
+    mm_predecode_init(&pd);
+    if (!mm_predecode_build(&pd, g_flash, 8u, BASE_S, BASE_NS)) return 1;
+    f = fetch_at(BASE_S + 10u, BASE_S);
+    d = mm_predecode_decode(&pd, &f);
+    if (d.raw != 0x4770u || pd.hits != 0u || pd.misses != 0u) return 1;
+    mm_predecode_free(&pd);
+    return 0;
+}
+
+static int test_cache_roundtrip(void)
+{
+    struct mm_predecode pd;
+    struct mm_predecode loaded;
+    char path[256];
+    char other[256];
+    mm_u32 off;
+    load_code();
+    mm_predecode_init(&pd);
+    mm_predecode_init(&loaded);
+    if (!mm_predecode_cache_path(path, sizeof(path), k_cache_dir, g_flash, sizeof(g_flash), "stm32h563")) return 1;
+    if (!mm_predecode_cache_path(other, sizeof(other), k_cache_dir, g_flash, sizeof(g_flash), "stm32u585")) return 1;
+    if (strcmp(path, other) == 0) return 1;
+    if (!mm_predecode_build(&pd, g_flash, sizeof(g_flash), BASE_S, BASE_NS)) return 1;
+    if (!mm_predecode_store(&pd, path, g_flash)) return 1;
+    if (!mm_predecode_load(&loaded, path, g_flash, sizeof(g_flash), BASE_S, BASE_NS)) return 1;
+    for (off = 0; off < sizeof(g_flash) / 2u; ++off) {
+        if (!same_decode(&pd.table[off], &loaded.table[off])) return 1;
+    }
+    mm_predecode_free(&loaded);
+    /* A different image or layout must not reuse the table. */
+    if (mm_predecode_load(&loaded, path, g_flash, sizeof(g_flash), BASE_NS, BASE_NS)) return 1;
+    g_flash[0] ^= 1u;
+    if (mm_predecode_load(&loaded, path, g_flash, sizeof(g_flash), BASE_S, BASE_NS)) return 1;
+    if (loaded.enabled) return 1;
+    remove(path);
+    mm_predecode_free(&pd);
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "matches_decoder", test_matches_decoder },
+        { "stale_entry", test_stale_entry },
+        { "invalidate", test_invalidate },
+        { "outside_range", test_outside_range },
+        { "cache_roundtrip", test_cache_roundtrip },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("predecode_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/profile.h"
+#include "m33mu/memmap.h"
+#include "m33mu/mem.h"
+
+static const char *k_elf = "profile_test.elf";
+static const char *k_out = "profile_test.folded";
+static const char *k_table = "profile_test.folded.txt";
+
+static void wr16(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+}
+
+static void wr32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+    p[2] = (mm_u8)(v >> 16);
+    p[3] = (mm_u8)(v >> 24);
+}
+
+static void put_sym(mm_u8 *s, mm_u32 name, mm_u32 value, mm_u32 size, mm_u8 info)
+{
+    wr32(s, name);
+    wr32(s + 4, value);
+    wr32(s + 8, size);
+    s[12] = info;
+    s[13] = 0;
+    wr16(s + 14, 1u);
+}
+
+/* Minimal ELF32 with .symtab/.strtab only: main, isr, leaf (size 0) and one object. */
+static int write_elf(void)
+{
+    static const char strtab[] = "\0main\0isr\0leaf\0table";
+    mm_u8 img[52 + 32 + 5 * 16 + 3 * 40];
+    mm_u32 str_off = 52u;
+    mm_u32 sym_off = 52u + 32u;
+    mm_u32 sh_off = sym_off + 5u * 16u;
+    mm_u8 *sh;
+    FILE *f;
+
+    memset(img, 0, sizeof(img));
+    memcpy(img, "\177ELF", 4);
+    img[4] = 1; /* ELFCLASS32 */
+    img[5] = 1; /* little-endian */
+    img[6] = 1;
+    wr16(img + 16, 2u);
+    wr16(img + 18, 40u);
+    wr32(img + 32, sh_off);
+    wr16(img + 40, 52u);
+    wr16(img + 46, 40u);
+    wr16(img + 48, 3u);
+    memcpy(img + str_off, strtab, sizeof(strtab));
+    put_sym(img + sym_off + 16, 1u, 0x08000101u, 0x40u, 0x12u);
+    put_sym(img + sym_off + 32, 6u, 0x08000201u, 0x20u, 0x12u);
+    put_sym(img + sym_off + 48, 10u, 0x08000301u, 0u, 0x02u);
+    put_sym(img + sym_off + 64, 15u, 0x08000400u, 0x10u, 0x11u);
+    sh = img + sh_off + 40;            /* [1] .symtab */
+    wr32(sh + 4, 2u);
+    wr32(sh + 16, sym_off);
+    wr32(sh + 20, 5u * 16u);
+    wr32(sh + 24, 2u);
+    wr32(sh + 36, 16u);
+    sh = img + sh_off + 80;            /* [2] .strtab */
+    wr32(sh + 4, 3u);
+    wr32(sh + 16, str_off);
+    wr32(sh + 20, sizeof(strtab));
+
+    f = fopen(k_elf, "wb");
+    if (f == 0) return 1;
+    if (fwrite(img, 1, sizeof(img), f) != sizeof(img)) {
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int file_contains(const char *path, const char *needle)
+{
+    static char buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "r");
+    if (f == 0) return 0;
+    n = fread(buf, 1, sizeof(buf) - 1u, f);
+    fclose(f);
+    buf[n] = '\0';
+    return strstr(buf, needle) != 0;
+}
+
+static int test_elfsym_lookup(void)
+{
+    struct mm_elfsym_table t;
+    const struct mm_elfsym *s;
+
+    if (write_elf() != 0) return 1;
+    mm_elfsym_init(&t);
+    if (!mm_elfsym_load(&t, k_elf)) return 1;
+    remove(k_elf);
+    if (t.count != 3) return 1;
+    s = mm_elfsym_lookup(&t, 0x08000121u);
+    if (s == 0 || strcmp(s->name, "main") != 0 || s->addr != 0x08000100u) return 1;
+    if (mm_elfsym_lookup(&t, 0x08000140u) != 0) return 1;   /* past main's size */
+    s = mm_elfsym_lookup(&t, 0x08000380u);                  /* unsized: runs to end */
+    if (s == 0 || strcmp(s->name, "leaf") != 0) return 1;
+    if (mm_elfsym_lookup(&t, 0x080000fcu) != 0) return 1;
+    s = mm_elfsym_find(&t, "isr");
+    if (s == 0 || s->addr != 0x08000200u) return 1;
+    if (mm_elfsym_find(&t, "table") != 0) return 1;
+    mm_elfsym_free(&t);
+    return 0;
+}
+
+static int test_profile_stacks(void)
+{
+    struct mm_memmap map;
+    struct mmio_region regions[4];
+    struct mm_target_cfg cfg;
+    static mm_u8 ram[256];
+    static struct mm_profile prof;
+    struct mm_cpu cpu;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = 0x20000000u;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(ram);
+    mm_memmap_init(&map, regions, 4);
+    if (!mm_memmap_configure_ram(&map, &cfg, ram, MM_TRUE)) return 1;
+    if (write_elf() != 0) return 1;
+
+    mm_profile_init(&prof);
+    if (!mm_profile_start(&prof, 100u, k_elf)) return 1;
+    remove(k_elf);
+
+    /* SysTick handler interrupting leaf(), which main() called. */
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.exc_depth = 1;
+    cpu.exc_sp[0] = 0x20000080u;
+    wr32(ram + 0x80 + 20, 0x08000111u);
+    wr32(ram + 0x80 + 24, 0x08000302u);
+    cpu.r[14] = 0xFFFFFFF9u;
+    cpu.r[15] = 0x08000210u;
+    cpu.xpsr = 15u;
+    mm_profile_sample(&prof, &cpu, &map, 99u);
+    if (prof.total_samples != 0u) return 1;
+    mm_profile_sample(&prof, &cpu, &map, 100u);
+    if (prof.total_samples != 1u || prof.next_sample != 200u) return 1;
+
+    /* Thread mode: leaf() with LR into isr(), and a frame record into main(). */
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.r[7] = 0x20000040u;
+    wr32(ram + 0x40, 0x20000050u);
+    wr32(ram + 0x44, 0x08000115u);
+    wr32(ram + 0x50, 0u);
+    wr32(ram + 0x54, 0u);
+    cpu.r[14] = 0x08000211u;
+    cpu.r[15] = 0x08000304u;
+    /* A fast-forward spanning three sample points carries weight 3. */
+    mm_profile_sample(&prof, &cpu, &map, 450u);
+    if (prof.total_samples != 4u || prof.next_sample != 500u) return 1;
+
+    if (!mm_profile_write(&prof, k_out)) return 1;
+    mm_profile_free(&prof);
+    if (!file_contains(k_out, "main;leaf;[SysTick];isr 100\n")) return 1;
+    if (!file_contains(k_out, "main;isr;leaf 300\n")) return 1;
+    if (!file_contains(k_table, "leaf")) return 1;
+    remove(k_out);
+    remove(k_table);
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "elfsym_lookup", test_elfsym_lookup },
+        { "profile_stacks", test_profile_stacks },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("profile_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "m33mu/reactor.h"
+#include "m33mu/ring.h"
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, 0);
+}
+
+/* Poll the CPU side until n bytes arrived or about a second passed. */
+static mm_u32 read_wait(struct mm_chan *ch, mm_u8 *buf, mm_u32 n)
+{
+    mm_u32 got = 0;
+    int tries;
+    for (tries = 0; tries < 1000 && got < n; ++tries) {
+        got += mm_chan_read(ch, buf + got, n - got);
+        if (got < n) sleep_ms(1);
+    }
+    return got;
+}
+
+static mm_bool state_wait(struct mm_chan *ch, enum mm_chan_state want)
+{
+    int tries;
+    for (tries = 0; tries < 1000; ++tries) {
+        if (mm_chan_state(ch) == want) return MM_TRUE;
+        sleep_ms(1);
+    }
+    return MM_FALSE;
+}
+
+static int test_ring_wrap(void)
+{
+    struct mm_ring r;
+    mm_u8 out[16];
+    mm_u32 i;
+    if (mm_ring_init(&r, 12u)) return 1; /* not a power of two */
+    if (!mm_ring_init(&r, 16u)) return 1;
+    for (i = 0; i < 5u; ++i) {
+        if (mm_ring_write(&r, "abcdefghij", 10u) != 10u) return 1;
+        if (mm_ring_read(&r, out, 10u) != 10u || memcmp(out, "abcdefghij", 10u) != 0) return 1;
+    }
+    if (mm_ring_write(&r, "0123456789abcdefXYZ", 19u) != 16u) return 1;
+    if (mm_ring_space(&r) != 0u) return 1;
+    if (mm_ring_read(&r, out, 16u) != 16u || memcmp(out, "0123456789abcdef", 16u) != 0) return 1;
+    mm_ring_free(&r);
+    return 0;
+}
+
+static int test_ring_frames(void)
+{
+    struct mm_ring r;
+    mm_u8 out[8];
+    if (!mm_ring_init(&r, 32u)) return 1;
+    if (!mm_ring_put_frame(&r, "hello", 5u)) return 1;
+    if (!mm_ring_put_frame(&r, "world!!", 7u)) return 1;
+    if (mm_ring_put_frame(&r, "toolargeforthering", 18u)) return 1;
+    if (mm_ring_get_frame(&r, out, sizeof(out)) != 5u || memcmp(out, "hello", 5u) != 0) return 1;
+    /* Truncated copy still consumes the whole frame. */
+    if (mm_ring_get_frame(&r, out, 3u) != 7u || memcmp(out, "wor", 3u) != 0) return 1;
+    if (mm_ring_get_frame(&r, out, sizeof(out)) != 0u) return 1;
+    mm_ring_free(&r);
+    return 0;
+}
+
+static int test_stream(void)
+{
+    int sv[2];
+    struct mm_chan *ch;
+    mm_u8 buf[64];
+    ssize_t n;
+    int rc = 0;
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) != 0) return 1;
+    ch = mm_reactor_open(MM_CHAN_STREAM, sv[0], 0, 256u, 256u);
+    if (ch == 0) return 1;
+    if (write(sv[1], "ping", 4) != 4) rc = 1;
+    if (read_wait(ch, buf, 4u) != 4u || memcmp(buf, "ping", 4u) != 0) rc = 1;
+    if (mm_chan_write(ch, "pong", 4u) != 4u) rc = 1;
+    fcntl(sv[1], F_SETFL, 0);
+    n = read(sv[1], buf, sizeof(buf));
+    if (n != 4 || memcmp(buf, "pong", 4u) != 0) rc = 1;
+    mm_reactor_close(ch);
+    close(sv[1]);
+    return rc;
+}
+
+/* Input larger than the receive ring pauses reading instead of losing data. */
+static int test_stream_backpressure(void)
+{
+    int sv[2];
+    struct mm_chan *ch;
+    mm_u8 src[1024];
+    mm_u8 dst[1024];
+    mm_u32 i;
+    int rc = 0;
+    for (i = 0; i < sizeof(src); ++i) src[i] = (mm_u8)(i * 7u);
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) != 0) return 1;
+    ch = mm_reactor_open(MM_CHAN_STREAM, sv[0], 0, 64u, 64u);
+    if (ch == 0) return 1;
+    if (write(sv[1], src, sizeof(src)) != (ssize_t)sizeof(src)) rc = 1;
+    if (read_wait(ch, dst, sizeof(dst)) != sizeof(dst) || memcmp(src, dst, sizeof(src)) != 0) rc = 1;
+    mm_reactor_close(ch);
+    close(sv[1]);
+    return rc;
+}
+
+static int test_frames(void)
+{
+    int sv[2];
+    struct mm_chan *ch;
+    mm_u8 buf[64];
+    mm_u32 n = 0;
+    int tries;
+    int rc = 0;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, sv) != 0) return 1;
+    ch = mm_reactor_open(MM_CHAN_FRAME, sv[0], 0, 1024u, 1024u);
+    if (ch == 0) return 1;
+    if (write(sv[1], "frame-one", 9) != 9) rc = 1;
+    if (write(sv[1], "two", 3) != 3) rc = 1;
+    for (tries = 0; tries < 1000 && n == 0u; ++tries) {
+        n = mm_chan_recv_frame(ch, buf, sizeof(buf));
+        if (n == 0u) sleep_ms(1);
+    }
+    if (n != 9u || memcmp(buf, "frame-one", 9u) != 0) rc = 1;
+    for (n = 0, tries = 0; tries < 1000 && n == 0u; ++tries) {
+        n = mm_chan_recv_frame(ch, buf, sizeof(buf));
+        if (n == 0u) sleep_ms(1);
+    }
+    if (n != 3u || memcmp(buf, "two", 3u) != 0) rc = 1;
+    if (!mm_chan_send_frame(ch, "out", 3u)) rc = 1;
+    fcntl(sv[1], F_SETFL, 0);
+    if (read(sv[1], buf, sizeof(buf)) != 3 || memcmp(buf, "out", 3u) != 0) rc = 1;
+    mm_reactor_close(ch);
+    close(sv[1]);
+    return rc;
+}
+
+static int connect_to(int port)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int test_listen_cycle(void)
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof(addr);
+    struct mm_chan *ch;
+    mm_u8 buf[8];
+    int lfd;
+    int cfd;
+    int port;
+    int rc = 0;
+
+    lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 2) != 0) return 1;
+    if (getsockname(lfd, (struct sockaddr *)&addr, &alen) != 0) return 1;
+    port = ntohs(addr.sin_port);
+    ch = mm_reactor_open_listen(lfd, 256u, 256u);
+    if (ch == 0 || mm_chan_state(ch) != MM_CHAN_LISTENING) return 1;
+
+    cfd = connect_to(port);
+    if (cfd < 0 || !state_wait(ch, MM_CHAN_UP)) rc = 1;
+    if (write(cfd, "abc", 3) != 3 || read_wait(ch, buf, 3u) != 3u) rc = 1;
+    close(cfd);
+    if (!state_wait(ch, MM_CHAN_DOWN)) rc = 1;
+    mm_chan_rearm(ch);
+    if (mm_chan_state(ch) != MM_CHAN_LISTENING) rc = 1;
+
+    /* Second client; the CPU side drops it. */
+    cfd = connect_to(port);
+    if (cfd < 0 || !state_wait(ch, MM_CHAN_UP)) rc = 1;
+    if (mm_chan_rx_avail(ch) != 0u) rc = 1;
+    mm_chan_drop(ch);
+    if (!state_wait(ch, MM_CHAN_DOWN)) rc = 1;
+    if (read(cfd, buf, sizeof(buf)) != 0) rc = 1;
+    close(cfd);
+    mm_reactor_close(ch);
+    return rc;
+}
+
+/* A PTY nobody opened hangs up continuously; it must neither spin the
+ * reactor nor keep input from arriving once a reader shows up. */
+static int test_pty_parked(void)
+{
+    struct mm_chan *ch;
+    struct timespec c0;
+    struct timespec c1;
+    mm_u8 buf[4];
+    const char *name;
+    long cpu_us;
+    int mfd;
+    int sfd;
+    int rc = 0;
+
+    mfd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (mfd < 0 || grantpt(mfd) != 0 || unlockpt(mfd) != 0 || (name = ptsname(mfd)) == 0) {
+        return 0; /* no PTYs in this environment */
+    }
+    ch = mm_reactor_open(MM_CHAN_STREAM, mfd, 0, 256u, 256u);
+    if (ch == 0) return 1;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c0);
+    sleep_ms(300);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c1);
+    cpu_us = (long)(c1.tv_sec - c0.tv_sec) * 1000000L + (c1.tv_nsec - c0.tv_nsec) / 1000L;
+    if (cpu_us > 50000L) {
+        printf("pty_parked: reactor used %ld us of CPU while idle\n", cpu_us);
+        rc = 1;
+    }
+    sfd = open(name, O_RDWR | O_NOCTTY);
+    if (sfd < 0) return 1;
+    if (write(sfd, "k\n", 2) != 2) rc = 1;
+    if (read_wait(ch, buf, 1u) != 1u || buf[0] != 'k') rc = 1;
+    close(sfd);
+    mm_reactor_close(ch);
+    return rc;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "ring_wrap", test_ring_wrap },
+        { "ring_frames", test_ring_frames },
+        { "stream", test_stream },
+        { "stream_backpressure", test_stream_backpressure },
+        { "frames", test_frames },
+        { "listen_cycle", test_listen_cycle },
+        { "pty_parked", test_pty_parked },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    mm_reactor_stop();
+    if (failures != 0) {
+        printf("reactor_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
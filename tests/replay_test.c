@@ -0,0 +1,195 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "m33mu/replay.h"
+
+static void tmp_path(char *out, size_t len, const char *tag)
+{
+    snprintf(out, len, "/tmp/m33mu-replay-%ld-%s.log", (long)getpid(), tag);
+}
+
+static int test_roundtrip(void)
+{
+    char path[128];
+    mm_u64 cycles = 0;
+    mm_u8 buf[16];
+    mm_u32 len = 0;
+    mm_u64 v = 0;
+    int rc = 0;
+
+    tmp_path(path, sizeof(path), "rt");
+    if (!mm_replay_open(MM_REPLAY_RECORD, path)) return 1;
+    mm_replay_bind_clock(&cycles, 0);
+    cycles = 100;
+    mm_replay_put(MM_REPLAY_UART_RX, 0x40004400u, "a", 1u);
+    mm_replay_put(MM_REPLAY_UART_RX, 0x40004800u, "b", 1u);
+    cycles = 5000000000ull;
+    mm_replay_put_u64(MM_REPLAY_IDLE, 0, 123456789ull);
+    /* A reset restarts the cycle counter; the base keeps stamps monotonic. */
+    cycles = 7;
+    mm_replay_bind_clock(&cycles, 5000000000ull);
+    mm_replay_put(MM_REPLAY_ETH_RX, 0, "frame", 5u);
+    mm_replay_bind_clock(0, 5000000000ull + 20u);
+    mm_replay_close();
+
+    if (!mm_replay_open(MM_REPLAY_PLAY, path)) return 1;
+    cycles = 0;
+    mm_replay_bind_clock(&cycles, 0);
+    /* Nothing is due before its cycle. */
+    if (mm_replay_take(MM_REPLAY_UART_RX, 0x40004400u, buf, sizeof(buf), &len)) rc = 1;
+    cycles = 100;
+    /* Wrong channel, then wrong kind, are left in place. */
+    if (mm_replay_take(MM_REPLAY_UART_RX, 0x40004800u, buf, sizeof(buf), &len)) rc = 1;
+    if (mm_replay_take(MM_REPLAY_ETH_RX, 0, buf, sizeof(buf), &len)) rc = 1;
+    if (!mm_replay_take(MM_REPLAY_UART_RX, 0x40004400u, buf, sizeof(buf), &len) || len != 1u || buf[0] != 'a') rc = 1;
+    if (!mm_replay_take(MM_REPLAY_UART_RX, 0x40004800u, buf, sizeof(buf), &len) || len != 1u || buf[0] != 'b') rc = 1;
+    cycles = 5000000000ull;
+    if (!mm_replay_take_u64(MM_REPLAY_IDLE, 0, &v) || v != 123456789ull) rc = 1;
+    if (mm_replay_finished()) rc = 1;
+    cycles = 7;
+    mm_replay_bind_clock(&cycles, 5000000000ull);
+    if (!mm_replay_take(MM_REPLAY_ETH_RX, 0, buf, 3u, &len) || len != 3u || memcmp(buf, "fra", 3) != 0) rc = 1;
+    cycles = 19;
+    if (mm_replay_finished()) rc = 1;
+    cycles = 20;
+    if (!mm_replay_finished()) rc = 1;
+    mm_replay_close();
+    unlink(path);
+    return rc;
+}
+
+static int test_diverged(void)
+{
+    char path[128];
+    mm_u64 cycles = 0;
+    mm_u8 b = 0;
+    int rc = 0;
+
+    tmp_path(path, sizeof(path), "div");
+    if (!mm_replay_open(MM_REPLAY_RECORD, path)) return 1;
+    mm_replay_bind_clock(&cycles, 0);
+    cycles = 64;
+    mm_replay_put(MM_REPLAY_UART_RX, 1u, "x", 1u);
+    cycles = 128;
+    mm_replay_put(MM_REPLAY_UART_RX, 1u, "y", 1u);
+    mm_replay_bind_clock(0, 200u);
+    mm_replay_close();
+
+    if (!mm_replay_open(MM_REPLAY_PLAY, path)) return 1;
+    mm_replay_bind_clock(&cycles, 0);
+    cycles = 64;
+    if (!mm_replay_take(MM_REPLAY_UART_RX, 1u, &b, 1u, 0) || b != 'x') rc = 1;
+    /* The byte due at 128 was never asked for. */
+    cycles = 192;
+    if (!mm_replay_finished()) rc = 1;
+    if (mm_replay_take(MM_REPLAY_UART_RX, 1u, &b, 1u, 0)) rc = 1;
+    mm_replay_close();
+    unlink(path);
+    return rc;
+}
+
+static int test_truncated(void)
+{
+    char path[128];
+    mm_u64 cycles = 0;
+    FILE *f;
+    long size;
+    mm_u8 b = 0;
+    int rc = 0;
+
+    tmp_path(path, sizeof(path), "trunc");
+    if (!mm_replay_open(MM_REPLAY_RECORD, path)) return 1;
+    mm_replay_bind_clock(&cycles, 0);
+    cycles = 10;
+    mm_replay_put(MM_REPLAY_RANDOM, 0, "\x01\x02\x03\x04", 4u);
+    cycles = 20;
+    mm_replay_put(MM_REPLAY_UART_RX, 0, "z", 1u);
+    /* Killed: no END record, and the last record is cut short. */
+    mm_replay_close();
+    f = fopen(path, "rb");
+    if (f == 0) return 1;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    if (truncate(path, size - 1) != 0) return 1;
+
+    if (!mm_replay_open(MM_REPLAY_PLAY, path)) return 1;
+    mm_replay_bind_clock(&cycles, 0);
+    cycles = 10;
+    {
+        mm_u8 r[4];
+        if (mm_replay_getrandom(r, sizeof(r), 0) != 4 || r[3] != 0x04u) rc = 1;
+    }
+    if (!mm_replay_finished()) rc = 1;
+    cycles = 20;
+    if (mm_replay_take(MM_REPLAY_UART_RX, 0, &b, 1u, 0)) rc = 1;
+    mm_replay_close();
+    unlink(path);
+    return rc;
+}
+
+static int test_bad_header(void)
+{
+    char path[128];
+    FILE *f;
+    int rc = 0;
+    tmp_path(path, sizeof(path), "hdr");
+    f = fopen(path, "wb");
+    if (f == 0) return 1;
+    fputs("not a log", f);
+    fclose(f);
+    if (mm_replay_open(MM_REPLAY_PLAY, path)) rc = 1;
+    if (mm_replay_playing()) rc = 1;
+    mm_replay_close();
+    unlink(path);
+    return rc;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "roundtrip", test_roundtrip },
+        { "diverged", test_diverged },
+        { "truncated", test_truncated },
+        { "bad_header", test_bad_header },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("replay_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
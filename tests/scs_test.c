@@ -20,6 +20,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "m33mu/scs.h"
 #include "m33mu/mmio.h"
 
@@ -183,6 +184,112 @@ static int test_sau_region_bank(void)
     return 0;
 }
 
+static int test_dwt_cyccnt(void)
+{
+    struct mm_scs scs;
+    struct mmio_bus bus;
+    struct mmio_region regions[3];
+    mm_u32 val = 0;
+
+    mm_scs_init(&scs, 0x0u);
+    mmio_bus_init(&bus, regions, 3);
+    if (!mm_scs_register_regions(&scs, &bus, 0xE000ED00u, 0xE000ED00u, 0)) return 1;
+    if (!mm_scs_register_debug_regions(&scs, &bus)) return 1;
+
+    /* CYCCNT does not run until DEMCR.TRCENA and CYCCNTENA are both set. */
+    if (!mmio_bus_write(&bus, 0xE0001000u, 4u, 1u)) return 1;
+    (void)mm_scs_systick_advance(&scs, 100u);
+    if (!mmio_bus_read(&bus, 0xE0001004u, 4u, &val) || val != 0u) return 1;
+    if (!mmio_bus_write(&bus, 0xE000EDFCu, 4u, 1u << 24)) return 1;
+    (void)mm_scs_systick_advance(&scs, 250u);
+    if (!mmio_bus_read(&bus, 0xE0001004u, 4u, &val) || val != 250u) return 1;
+
+    /* Writes preload the counter; disabling freezes it. */
+    if (!mmio_bus_write(&bus, 0xE0001004u, 4u, 0xfffffff0u)) return 1;
+    (void)mm_scs_systick_advance(&scs, 0x20u);
+    if (mm_scs_dwt_cyccnt(&scs) != 0x10u) return 1;
+    if (!mmio_bus_write(&bus, 0xE0001000u, 4u, 0u)) return 1;
+    (void)mm_scs_systick_advance(&scs, 5u);
+    if (mm_scs_dwt_cyccnt(&scs) != 0x10u) return 1;
+
+    /* NUMCOMP is read-only. */
+    if (!mmio_bus_read(&bus, 0xE0001000u, 4u, &val)) return 1;
+    if ((val >> 28) != MM_DWT_NUM_COMP) return 1;
+    return 0;
+}
+
+static int test_dwt_cycle_comparator(void)
+{
+    struct mm_scs scs;
+    struct mmio_bus bus;
+    struct mmio_region regions[3];
+    mm_u32 val = 0;
+
+    mm_scs_init(&scs, 0x0u);
+    mmio_bus_init(&bus, regions, 3);
+    if (!mm_scs_register_regions(&scs, &bus, 0xE000ED00u, 0xE000ED00u, 0)) return 1;
+    if (!mm_scs_register_debug_regions(&scs, &bus)) return 1;
+    if (!mmio_bus_write(&bus, 0xE000EDFCu, 4u, 1u << 24)) return 1;
+    if (!mmio_bus_write(&bus, 0xE0001000u, 4u, 1u)) return 1;
+    if (!mmio_bus_write(&bus, 0xE0001020u, 4u, 1000u)) return 1; /* COMP0 */
+    if (!mmio_bus_write(&bus, 0xE0001028u, 4u, 0x1u)) return 1;  /* FUNCTION0: CYCCNT match */
+
+    (void)mm_scs_systick_advance(&scs, 999u);
+    if (!mmio_bus_read(&bus, 0xE0001028u, 4u, &val)) return 1;
+    if ((val & (1u << 24)) != 0u) return 1;
+    (void)mm_scs_systick_advance(&scs, 1u);
+    if (!mmio_bus_read(&bus, 0xE0001028u, 4u, &val)) return 1;
+    if ((val & (1u << 24)) == 0u) return 1;
+    /* MATCHED clears on read. */
+    if (!mmio_bus_read(&bus, 0xE0001028u, 4u, &val)) return 1;
+    if ((val & (1u << 24)) != 0u) return 1;
+    return 0;
+}
+
+static int test_itm_stimulus(void)
+{
+    struct mm_scs scs;
+    struct mmio_bus bus;
+    struct mmio_region regions[3];
+    static struct mm_itm_sink sink;
+    const char *path = "itm_test.out";
+    char buf[16];
+    FILE *f;
+    size_t n;
+    mm_u32 val = 0;
+
+    mm_scs_init(&scs, 0x0u);
+    mmio_bus_init(&bus, regions, 3);
+    if (!mm_scs_register_regions(&scs, &bus, 0xE000ED00u, 0xE000ED00u, 0)) return 1;
+    if (!mm_scs_register_debug_regions(&scs, &bus)) return 1;
+    mm_itm_sink_init(&sink);
+    if (!mm_itm_sink_open(&sink, path)) return 1;
+    mm_scs_set_itm_sink(&scs, &sink);
+
+    /* Dropped while ITM is disabled. */
+    if (!mmio_bus_write(&bus, 0xE0000000u, 1u, 'x')) return 1;
+    if (!mmio_bus_write(&bus, 0xE000EDFCu, 4u, 1u << 24)) return 1;
+    if (!mmio_bus_write(&bus, 0xE0000E80u, 4u, 1u)) return 1; /* TCR.ITMENA */
+    if (!mmio_bus_write(&bus, 0xE0000E00u, 4u, 1u)) return 1; /* TER: port 0 only */
+    if (!mmio_bus_read(&bus, 0xE0000000u, 4u, &val) || val != 1u) return 1;
+    if (!mmio_bus_write(&bus, 0xE0000000u, 1u, 'h')) return 1;
+    if (!mmio_bus_write(&bus, 0xE0000000u, 4u, 0x6c6c6569u)) return 1; /* "iell" */
+    if (!mmio_bus_write(&bus, 0xE0000004u, 1u, 'z')) return 1; /* port 1 disabled */
+    if (!mmio_bus_write(&bus, 0xE0000000u, 2u, 0x216fu)) return 1; /* "o!" */
+    if (mm_itm_sink_pending(&sink) != 7u) return 1;
+    mm_itm_sink_poll(&sink, 0, MM_FALSE);
+    if (mm_itm_sink_pending(&sink) != 7u) return 1; /* below threshold: still buffered */
+    mm_itm_sink_close(&sink);
+
+    f = fopen(path, "rb");
+    if (f == 0) return 1;
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    remove(path);
+    if (n != 7u || memcmp(buf, "hiello!", 7) != 0) return 1;
+    return 0;
+}
+
 int main(void)
 {
     struct { const char *name; int (*fn)(void); } tests[] = {
@@ -192,6 +299,9 @@ int main(void)
         { "mpu_bank", test_mpu_bank },
         { "sau_secure_only", test_sau_secure_only },
         { "sau_region_bank", test_sau_region_bank },
+        { "dwt_cyccnt", test_dwt_cyccnt },
+        { "dwt_cycle_comparator", test_dwt_cycle_comparator },
+        { "itm_stimulus", test_itm_stimulus },
     };
     int failures = 0;
     int i;
@@ -0,0 +1,196 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "m33mu/semihost.h"
+#include "m33mu/memmap.h"
+#include "m33mu/mem.h"
+
+#define RAM_BASE 0x20000000u
+
+static const char *k_root = "semihost_test.d";
+static mm_u8 g_ram[4096];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[4];
+static struct mm_cpu g_cpu;
+static struct mm_semihost g_sh;
+
+static void wr32(mm_u8 *p, mm_u32 v)
+{
+    p[0] = (mm_u8)v;
+    p[1] = (mm_u8)(v >> 8);
+    p[2] = (mm_u8)(v >> 16);
+    p[3] = (mm_u8)(v >> 24);
+}
+
+static mm_u32 rd32(const mm_u8 *p)
+{
+    return (mm_u32)p[0] | ((mm_u32)p[1] << 8) | ((mm_u32)p[2] << 16) | ((mm_u32)p[3] << 24);
+}
+
+static int setup(void)
+{
+    struct mm_target_cfg cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    memset(g_ram, 0, sizeof(g_ram));
+    mm_memmap_init(&g_map, g_regions, 4);
+    if (!mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE)) return 1;
+    memset(&g_cpu, 0, sizeof(g_cpu));
+    g_cpu.sec_state = MM_SECURE;
+    mkdir(k_root, 0755);
+    mm_semihost_init(&g_sh);
+    if (!mm_semihost_enable(&g_sh, k_root)) return 1;
+    return 0;
+}
+
+/* Parameter block at RAM offset 0x00, strings at 0x40, data from 0x100. */
+static mm_u32 call(mm_u32 op, mm_u32 a0, mm_u32 a1, mm_u32 a2)
+{
+    wr32(g_ram + 0, a0);
+    wr32(g_ram + 4, a1);
+    wr32(g_ram + 8, a2);
+    g_cpu.r[0] = op;
+    g_cpu.r[1] = RAM_BASE;
+    mm_semihost_call(&g_sh, &g_cpu, &g_map);
+    return g_cpu.r[0];
+}
+
+static mm_u32 open_name(const char *name, mm_u32 mode)
+{
+    mm_u32 len = (mm_u32)strlen(name);
+    memcpy(g_ram + 0x40, name, len + 1u);
+    return call(MM_SEMIHOST_SYS_OPEN, RAM_BASE + 0x40u, mode, len);
+}
+
+static int test_file_roundtrip(void)
+{
+    mm_u32 h;
+    mm_u32 i;
+
+    if (setup() != 0) return 1;
+    for (i = 0; i < 600u; ++i) {
+        g_ram[0x100 + i] = (mm_u8)(i * 7u);
+    }
+    h = open_name("data.bin", 5u); /* "wb" */
+    if (h == 0xFFFFFFFFu) return 1;
+    if (call(MM_SEMIHOST_SYS_WRITE, h, RAM_BASE + 0x100u, 600u) != 0u) return 1;
+    if (call(MM_SEMIHOST_SYS_CLOSE, h, 0, 0) != 0u) return 1;
+
+    h = open_name("data.bin", 1u); /* "rb" */
+    if (h == 0xFFFFFFFFu) return 1;
+    if (call(MM_SEMIHOST_SYS_FLEN, h, 0, 0) != 600u) return 1;
+    if (call(MM_SEMIHOST_SYS_ISTTY, h, 0, 0) != 0u) return 1;
+    if (call(MM_SEMIHOST_SYS_SEEK, h, 500u, 0) != 0u) return 1;
+    /* Short read near EOF reports the bytes not transferred. */
+    if (call(MM_SEMIHOST_SYS_READ, h, RAM_BASE + 0x800u, 150u) != 50u) return 1;
+    for (i = 0; i < 100u; ++i) {
+        if (g_ram[0x800 + i] != (mm_u8)((500u + i) * 7u)) return 1;
+    }
+    if (call(MM_SEMIHOST_SYS_READ, h, RAM_BASE + 0x800u, 4u) != 4u) return 1;
+    if (call(MM_SEMIHOST_SYS_CLOSE, h, 0, 0) != 0u) return 1;
+    if (call(MM_SEMIHOST_SYS_CLOSE, h, 0, 0) != 0xFFFFFFFFu) return 1;
+
+    memcpy(g_ram + 0x40, "data.bin", 8);
+    if (call(MM_SEMIHOST_SYS_REMOVE, RAM_BASE + 0x40u, 8u, 0) != 0u) return 1;
+    if (access("semihost_test.d/data.bin", F_OK) == 0) return 1;
+    return 0;
+}
+
+static int test_sandbox(void)
+{
+    if (setup() != 0) return 1;
+    if (open_name("../escape.txt", 4u) != 0xFFFFFFFFu) return 1;
+    if (open_name("sub/../../escape.txt", 4u) != 0xFFFFFFFFu) return 1;
+    if (open_name("/tmp/escape.txt", 4u) != 0xFFFFFFFFu) return 1;
+    if (call(MM_SEMIHOST_SYS_ERRNO, 0, 0, 0) == 0u) return 1;
+    if (access("escape.txt", F_OK) == 0) return 1;
+    /* Console and feature pseudo-files need no host path. */
+    if (open_name(":tt", 4u) == 0xFFFFFFFFu) return 1;
+    return 0;
+}
+
+static int test_features_and_exit(void)
+{
+    mm_u64 cycles = 0x123456789ull;
+    mm_u64 hz = 64000000ull;
+    mm_u32 h;
+
+    if (setup() != 0) return 1;
+    mm_semihost_bind_clock(&g_sh, &cycles, &hz);
+    h = open_name(":semihosting-features", 0u);
+    if (h == 0xFFFFFFFFu) return 1;
+    if (call(MM_SEMIHOST_SYS_FLEN, h, 0, 0) != 5u) return 1;
+    if (call(MM_SEMIHOST_SYS_READ, h, RAM_BASE + 0x100u, 5u) != 0u) return 1;
+    if (memcmp(g_ram + 0x100, "SHFB", 4) != 0 || (g_ram[0x104] & 1u) == 0u) return 1;
+
+    if (call(MM_SEMIHOST_SYS_TICKFREQ, 0, 0, 0) != 64000000u) return 1;
+    if (call(MM_SEMIHOST_SYS_ELAPSED, 0, 0, 0) != 0u) return 1;
+    if (rd32(g_ram) != 0x23456789u || rd32(g_ram + 4) != 1u) return 1;
+    cycles = 128000000ull;
+    if (call(MM_SEMIHOST_SYS_CLOCK, 0, 0, 0) != 200u) return 1;
+    if (call(0x7Fu, 0, 0, 0) != 0xFFFFFFFFu) return 1;
+
+    if (g_sh.exit_requested) return 1;
+    call(MM_SEMIHOST_SYS_EXIT_EXTENDED, MM_SEMIHOST_ADP_APPLICATION_EXIT, 3u, 0);
+    if (!g_sh.exit_requested || g_sh.exit_code != 3) return 1;
+    mm_semihost_reset(&g_sh);
+    if (g_sh.exit_requested) return 1;
+    g_cpu.r[0] = MM_SEMIHOST_SYS_EXIT;
+    g_cpu.r[1] = MM_SEMIHOST_ADP_APPLICATION_EXIT;
+    mm_semihost_call(&g_sh, &g_cpu, &g_map);
+    if (!g_sh.exit_requested || g_sh.exit_code != 0) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "file_roundtrip", test_file_roundtrip },
+        { "sandbox", test_sandbox },
+        { "features_and_exit", test_features_and_exit },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+        mm_semihost_reset(&g_sh);
+    }
+    rmdir(k_root);
+    if (failures != 0) {
+        printf("semihost_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
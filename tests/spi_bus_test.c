@@ -0,0 +1,299 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/memmap.h"
+#include "m33mu/spi_bus.h"
+#include "m33mu/spiflash.h"
+#include "m33mu/tpm_tis.h"
+
+#define FLASH_BUS 3
+#define FLASH_SIZE 4096u
+#define TPM_BUS 4
+#define ECHO_BUS 5
+#define XIP_BUS 6
+#define XIP_BASE 0x90000000u
+
+static const char *g_flash_path = "spi_bus_test_flash.bin";
+static const char *g_xip_path = "spi_bus_test_xip.bin";
+static mm_u8 g_image[FLASH_SIZE];
+static mm_u32 g_code_lo;
+static mm_u32 g_code_hi;
+
+static mm_u8 echo_xfer(void *opaque, mm_u8 out)
+{
+    int *count = (int *)opaque;
+    (*count)++;
+    return (mm_u8)(out ^ 0x5Au);
+}
+
+static void code_changed(void *opaque, mm_u32 addr, mm_u32 len)
+{
+    (void)opaque;
+    if (addr < g_code_lo) g_code_lo = addr;
+    if (addr + len > g_code_hi) g_code_hi = addr + len;
+}
+
+static int setup_flash(void)
+{
+    struct mm_spiflash_cfg cfg;
+    FILE *f;
+    mm_u32 i;
+    for (i = 0; i < FLASH_SIZE; ++i) {
+        g_image[i] = (mm_u8)((i * 7u) ^ (i >> 8));
+    }
+    f = fopen(g_flash_path, "wb");
+    if (f == 0) return 1;
+    if (fwrite(g_image, 1u, sizeof(g_image), f) != sizeof(g_image)) {
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bus = FLASH_BUS;
+    cfg.size = FLASH_SIZE;
+    snprintf(cfg.path, sizeof(cfg.path), "%s", g_flash_path);
+    return mm_spiflash_register_cfg(&cfg) ? 0 : 1;
+}
+
+static int test_flash_read_burst(void)
+{
+    mm_u8 cmd[4];
+    mm_u8 buf[300];
+    mm_u32 addr = FLASH_SIZE - 100u;
+    mm_u32 i;
+    cmd[0] = 0x03u;
+    cmd[1] = (mm_u8)(addr >> 16);
+    cmd[2] = (mm_u8)(addr >> 8);
+    cmd[3] = (mm_u8)addr;
+    mm_spi_bus_xfer_buf(FLASH_BUS, cmd, 0xFFu, 0, sizeof(cmd));
+    memset(buf, 0, sizeof(buf));
+    mm_spi_bus_xfer_buf(FLASH_BUS, 0, 0xFFu, buf, 200u);
+    /* Continue the same READ byte by byte: the address must carry on. */
+    for (i = 200u; i < sizeof(buf); ++i) {
+        buf[i] = mm_spi_bus_xfer(FLASH_BUS, 0xFFu);
+    }
+    mm_spi_bus_end(FLASH_BUS);
+    for (i = 0; i < sizeof(buf); ++i) {
+        if (buf[i] != g_image[(addr + i) % FLASH_SIZE]) return 1;
+    }
+    return 0;
+}
+
+static int test_flash_fast_read_burst(void)
+{
+    mm_u8 out[5 + 64];
+    mm_u8 in[5 + 64];
+    mm_u32 i;
+    memset(out, 0xFF, sizeof(out));
+    out[0] = 0x0Bu;
+    out[1] = 0x00u;
+    out[2] = 0x01u;
+    out[3] = 0x10u;
+    mm_spi_bus_xfer_buf(FLASH_BUS, out, 0xFFu, in, sizeof(out));
+    mm_spi_bus_end(FLASH_BUS);
+    for (i = 0; i < 64u; ++i) {
+        if (in[5 + i] != g_image[0x110u + i]) return 1;
+    }
+    return 0;
+}
+
+static int test_flash_program_burst(void)
+{
+    mm_u8 out[4 + 16];
+    mm_u8 in[8];
+    mm_u32 i;
+    mm_spi_bus_xfer(FLASH_BUS, 0x06u);
+    mm_spi_bus_end(FLASH_BUS);
+    out[0] = 0x02u;
+    out[1] = 0x00u;
+    out[2] = 0x02u;
+    out[3] = 0x00u;
+    for (i = 0; i < 16u; ++i) {
+        out[4 + i] = 0x00u;
+    }
+    mm_spi_bus_xfer_buf(FLASH_BUS, out, 0xFFu, 0, sizeof(out));
+    mm_spi_bus_end(FLASH_BUS);
+    out[0] = 0x03u;
+    mm_spi_bus_xfer_buf(FLASH_BUS, out, 0xFFu, 0, 4u);
+    mm_spi_bus_xfer_buf(FLASH_BUS, 0, 0xFFu, in, sizeof(in));
+    mm_spi_bus_end(FLASH_BUS);
+    for (i = 0; i < sizeof(in); ++i) {
+        if (in[i] != 0x00u) return 1;
+    }
+    return 0;
+}
+
+static int test_fallback_bytewise(void)
+{
+    struct mm_spi_device dev;
+    static int count = 0;
+    mm_u8 out[3];
+    mm_u8 in[3];
+    memset(&dev, 0, sizeof(dev));
+    dev.bus = ECHO_BUS;
+    dev.xfer = echo_xfer;
+    dev.opaque = &count;
+    if (!mm_spi_bus_register_device(&dev)) return 1;
+    out[0] = 0x00u;
+    out[1] = 0x5Au;
+    out[2] = 0xA5u;
+    mm_spi_bus_xfer_buf(ECHO_BUS, out, 0xFFu, in, sizeof(out));
+    if (count != 3 || in[0] != 0x5Au || in[1] != 0x00u || in[2] != 0xFFu) return 1;
+    mm_spi_bus_xfer_buf(ECHO_BUS, 0, 0x11u, in, 2u);
+    if (count != 5 || in[0] != 0x4Bu || in[1] != 0x4Bu) return 1;
+    /* Nothing on the bus reads back as an idle line. */
+    mm_spi_bus_xfer_buf(9, out, 0xFFu, in, sizeof(out));
+    if (in[0] != 0xFFu || in[2] != 0xFFu) return 1;
+    return 0;
+}
+
+static int test_tpm_fifo_burst(void)
+{
+    static const mm_u8 startup[12] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x01, 0x44, 0x00, 0x00
+    };
+    struct mm_tpm_tis_cfg cfg;
+    mm_u8 hdr[4];
+    mm_u8 rsp[16];
+    mm_u8 sts;
+    mm_u32 size;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bus = TPM_BUS;
+    if (!mm_tpm_tis_register_cfg(&cfg)) return 1;
+    /* Write the command into the FIFO, then STS.GO. */
+    hdr[0] = (mm_u8)(sizeof(startup) - 1u);
+    hdr[1] = 0xD4u;
+    hdr[2] = 0x00u;
+    hdr[3] = 0x24u;
+    mm_spi_bus_xfer_buf(TPM_BUS, hdr, 0xFFu, 0, sizeof(hdr));
+    mm_spi_bus_xfer_buf(TPM_BUS, 0, 0xFFu, 0, 1u);
+    mm_spi_bus_xfer_buf(TPM_BUS, startup, 0xFFu, 0, sizeof(startup));
+    hdr[0] = 0x00u;
+    hdr[3] = 0x18u;
+    mm_spi_bus_xfer_buf(TPM_BUS, hdr, 0xFFu, 0, sizeof(hdr));
+    mm_spi_bus_xfer_buf(TPM_BUS, 0, 0xFFu, 0, 1u);
+    sts = 0x20u;
+    mm_spi_bus_xfer_buf(TPM_BUS, &sts, 0xFFu, 0, 1u);
+    /* Read the 10-byte response header in one burst. */
+    hdr[0] = (mm_u8)(0x80u | (10u - 1u));
+    hdr[3] = 0x24u;
+    mm_spi_bus_xfer_buf(TPM_BUS, hdr, 0xFFu, 0, sizeof(hdr));
+    mm_spi_bus_xfer_buf(TPM_BUS, 0, 0xFFu, rsp, 1u);
+    if (rsp[0] != 0x01u) return 1;
+    mm_spi_bus_xfer_buf(TPM_BUS, 0, 0xFFu, rsp, 10u);
+    if (rsp[0] != 0x80u || rsp[1] != 0x01u) return 1;
+    size = ((mm_u32)rsp[2] << 24) | ((mm_u32)rsp[3] << 16) |
+           ((mm_u32)rsp[4] << 8) | (mm_u32)rsp[5];
+    if (size != 10u) return 1;
+    /* The transaction is over: the next byte is a fresh header. */
+    hdr[0] = 0x80u;
+    hdr[3] = 0x18u;
+    mm_spi_bus_xfer_buf(TPM_BUS, hdr, 0xFFu, 0, sizeof(hdr));
+    mm_spi_bus_xfer_buf(TPM_BUS, 0, 0xFFu, rsp, 2u);
+    if (rsp[0] != 0x01u || (rsp[1] & 0x80u) == 0u || (rsp[1] & 0x10u) != 0u) return 1;
+    return 0;
+}
+
+static int test_xip_program_invalidates(void)
+{
+    struct mm_spiflash_cfg cfg;
+    struct mm_memmap map;
+    struct mmio_region regions[4];
+    mm_u8 cmd[6];
+    mm_u32 val = 0;
+    remove(g_xip_path);
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bus = XIP_BUS;
+    cfg.size = FLASH_SIZE;
+    cfg.mmap = MM_TRUE;
+    cfg.mmap_base = XIP_BASE;
+    snprintf(cfg.path, sizeof(cfg.path), "%s", g_xip_path);
+    if (!mm_spiflash_register_cfg(&cfg)) return 1;
+    mm_memmap_init(&map, regions, 4);
+    mm_spiflash_register_xip_regions(&map);
+    if (!mm_memmap_fetch_read16(&map, MM_SECURE, XIP_BASE + 0x100u, &val) || val != 0xFFFFu) return 1;
+
+    mm_memmap_set_code_observer(code_changed, 0);
+    g_code_lo = 0xFFFFFFFFu;
+    g_code_hi = 0;
+    mm_spi_bus_xfer(XIP_BUS, 0x06u);
+    mm_spi_bus_end(XIP_BUS);
+    cmd[0] = 0x02u;
+    cmd[1] = 0x00u;
+    cmd[2] = 0x01u;
+    cmd[3] = 0x00u;
+    cmd[4] = 0x70u;
+    cmd[5] = 0x47u;
+    mm_spi_bus_xfer_buf(XIP_BUS, cmd, 0xFFu, 0, sizeof(cmd));
+    mm_spi_bus_end(XIP_BUS);
+    if (g_code_lo != XIP_BASE + 0x100u || g_code_hi != XIP_BASE + 0x102u) return 1;
+    if (!mm_memmap_fetch_read16(&map, MM_SECURE, XIP_BASE + 0x100u, &val) || val != 0x4770u) return 1;
+
+    g_code_lo = 0xFFFFFFFFu;
+    g_code_hi = 0;
+    mm_spi_bus_xfer(XIP_BUS, 0x06u);
+    mm_spi_bus_end(XIP_BUS);
+    cmd[0] = 0x20u;
+    mm_spi_bus_xfer_buf(XIP_BUS, cmd, 0xFFu, 0, 4u);
+    mm_spi_bus_end(XIP_BUS);
+    mm_memmap_set_code_observer(0, 0);
+    if (g_code_lo != XIP_BASE || g_code_hi != XIP_BASE + 0x1000u) return 1;
+    if (!mm_memmap_read(&map, MM_SECURE, XIP_BASE + 0x100u, 2u, &val) || val != 0xFFFFu) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "flash_read_burst", test_flash_read_burst },
+        { "flash_fast_read_burst", test_flash_fast_read_burst },
+        { "flash_program_burst", test_flash_program_burst },
+        { "fallback_bytewise", test_fallback_bytewise },
+        { "tpm_fifo_burst", test_tpm_fifo_burst },
+        { "xip_program_invalidates", test_xip_program_invalidates },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    if (setup_flash() != 0) {
+        printf("spi_bus_test: cannot create %s\n", g_flash_path);
+        return 1;
+    }
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    mm_spiflash_shutdown_all();
+    remove(g_flash_path);
+    remove(g_xip_path);
+    if (failures != 0) {
+        printf("spi_bus_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,324 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/stm32_crypto.h"
+#include "m33mu/mmio.h"
+
+#define AES_BASE 0x420c0000u
+#define HASH_BASE 0x420c0400u
+#define SAES_BASE 0x420c0c00u
+#define PKA_BASE 0x420c2000u
+
+static struct mmio_bus g_bus;
+static struct mmio_region g_regions[8];
+static mm_u32 g_ahb2enr;
+
+static const mm_u32 k_p256_p[8] = { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0x00000000u,
+                                    0x00000000u, 0x00000000u, 0x00000001u, 0xffffffffu };
+static const mm_u32 k_p256_n[8] = { 0xfc632551u, 0xf3b9cac2u, 0xa7179e84u, 0xbce6faadu,
+                                    0xffffffffu, 0xffffffffu, 0x00000000u, 0xffffffffu };
+static const mm_u32 k_p256_gx[8] = { 0xd898c296u, 0xf4a13945u, 0x2deb33a0u, 0x77037d81u,
+                                     0x63a440f2u, 0xf8bce6e5u, 0xe12c4247u, 0x6b17d1f2u };
+static const mm_u32 k_p256_gy[8] = { 0x37bf51f5u, 0xcbb64068u, 0x6b315eceu, 0x2bce3357u,
+                                     0x7c0f9e16u, 0x8ee7eb4au, 0xfe1a7f9bu, 0x4fe342e2u };
+static const mm_u32 k_qx[8] = { 0xe2bcfac1u, 0x8e889e0du, 0xf8095218u, 0x15b14017u,
+                                0x1f4c8db7u, 0x9368d4ecu, 0x22bfe088u, 0x6a1918d9u };
+static const mm_u32 k_qy[8] = { 0xdbb3e8cbu, 0x6f4ee151u, 0xcfd25a55u, 0x7941b48cu,
+                                0xa6ed67b1u, 0xe8cd49b6u, 0x51861817u, 0xd9c3b56cu };
+static const mm_u32 k_e[8] = { 0xaad321e0u, 0x0324c922u, 0xd54e7181u, 0x30328463u,
+                               0x2835de80u, 0xc117aa11u, 0xa527f9a5u, 0xba32663au };
+static const mm_u32 k_r[8] = { 0xe1f88c94u, 0x2429c302u, 0xd6f73626u, 0x04b5aafdu,
+                               0x349abd93u, 0xd8419ee9u, 0x7629339bu, 0xd40cf39cu };
+static const mm_u32 k_s[8] = { 0xa91636f1u, 0xd2421c77u, 0xd515462cu, 0x672f222du,
+                               0x8d1fe865u, 0xad7419d0u, 0x0c9fbe96u, 0x421d1dc3u };
+
+static void wr(mm_u32 addr, mm_u32 v)
+{
+    mmio_bus_write(&g_bus, addr, 4u, v);
+}
+
+static mm_u32 rd(mm_u32 addr)
+{
+    mm_u32 v = 0;
+    mmio_bus_read(&g_bus, addr, 4u, &v);
+    return v;
+}
+
+static void wr_words(mm_u32 addr, const mm_u32 *w, mm_u32 n)
+{
+    mm_u32 i;
+    for (i = 0; i < n; ++i) {
+        wr(addr + 4u * i, w[i]);
+    }
+}
+
+static void set_timing(mm_u32 hash, mm_u32 aes, mm_u32 pka)
+{
+    struct mm_stm32_crypto_timing t;
+    t.hash_block = hash;
+    t.aes_block = aes;
+    t.pka_pct = pka;
+    mm_stm32_crypto_set_timing(&t);
+}
+
+static int setup(enum mm_stm32_crypto_variant variant)
+{
+    struct mm_stm32_crypto_cfg cfg;
+
+    mmio_bus_init(&g_bus, g_regions, sizeof(g_regions) / sizeof(g_regions[0]));
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.variant = variant;
+    cfg.aes_base = AES_BASE;
+    cfg.hash_base = HASH_BASE;
+    cfg.saes_base = SAES_BASE;
+    cfg.pka_base = PKA_BASE;
+    cfg.aes_irq = -1;
+    cfg.hash_irq = -1;
+    cfg.saes_irq = -1;
+    cfg.pka_irq = -1;
+    cfg.clk_reg = &g_ahb2enr;
+    g_ahb2enr = (1u << 16) | (1u << 17) | (1u << 19) | (1u << 20);
+    set_timing(66u, 14u, 100u);
+    return mm_stm32_crypto_register(&g_bus, &cfg) ? 0 : 1;
+}
+
+static int test_sha256(void)
+{
+    static const mm_u32 expect[8] = { 0xba7816bfu, 0x8f01cfeau, 0x414140deu, 0x5dae2223u,
+                                      0xb00361a3u, 0x96177a9cu, 0xb410ff61u, 0xf20015adu };
+    mm_u32 i;
+
+    if (setup(MM_STM32_CRYPTO_U5) != 0) return 1;
+    /* Clock gated: registers read as zero and ignore writes. */
+    g_ahb2enr = 0;
+    wr(HASH_BASE + 0x20u, 3u);
+    g_ahb2enr = 1u << 17;
+    if (rd(HASH_BASE + 0x20u) != 0u) return 1;
+    /* SHA-256 (ALGO bits 18 and 7), byte-swapped data, "abc" */
+    wr(HASH_BASE + 0x00u, (1u << 18) | (1u << 7) | (2u << 4) | (1u << 2));
+    wr(HASH_BASE + 0x04u, 0x00636261u);
+    wr(HASH_BASE + 0x08u, 24u | (1u << 8));
+    if ((rd(HASH_BASE + 0x24u) & ((1u << 3) | (1u << 1))) != (1u << 3)) return 1;
+    mm_stm32_crypto_tick(65u);
+    if ((rd(HASH_BASE + 0x24u) & (1u << 1)) != 0u) return 1;
+    mm_stm32_crypto_tick(1u);
+    if ((rd(HASH_BASE + 0x24u) & ((1u << 3) | (1u << 1))) != (1u << 1)) return 1;
+    for (i = 0; i < 8u; ++i) {
+        if (rd(HASH_BASE + 0x310u + 4u * i) != expect[i]) return 1;
+    }
+    if (rd(HASH_BASE + 0x0Cu) != expect[0]) return 1;
+    return 0;
+}
+
+static void hash_bytes(const char *s)
+{
+    size_t len = strlen(s);
+    size_t i;
+    for (i = 0; i + 4u <= len; i += 4u) {
+        wr(HASH_BASE + 0x04u, (mm_u32)(mm_u8)s[i] | ((mm_u32)(mm_u8)s[i + 1] << 8) |
+                                  ((mm_u32)(mm_u8)s[i + 2] << 16) | ((mm_u32)(mm_u8)s[i + 3] << 24));
+    }
+    if (i < len) {
+        mm_u32 w = 0;
+        mm_u32 n = 0;
+        for (; i < len; ++i, ++n) {
+            w |= (mm_u32)(mm_u8)s[i] << (8u * n);
+        }
+        wr(HASH_BASE + 0x04u, w);
+    }
+    wr(HASH_BASE + 0x08u, (mm_u32)((len % 4u) * 8u) | (1u << 8));
+}
+
+static int test_hmac(void)
+{
+    static const mm_u32 expect[8] = { 0xf7bc83f4u, 0x30538424u, 0xb13298e6u, 0xaa6fb143u,
+                                      0xef4d59a1u, 0x49461759u, 0x97479dbcu, 0x2d1a3cd8u };
+    mm_u32 i;
+
+    if (setup(MM_STM32_CRYPTO_H5) != 0) return 1;
+    set_timing(0u, 0u, 0u);
+    /* H5 ALGO field 20:17 = 3 (SHA-256), HMAC mode, byte data */
+    wr(HASH_BASE + 0x00u, (3u << 17) | (1u << 6) | (2u << 4) | (1u << 2));
+    hash_bytes("key");
+    if ((rd(HASH_BASE + 0x24u) & 3u) != 1u) return 1;
+    hash_bytes("The quick brown fox jumps over the lazy dog");
+    hash_bytes("key");
+    if ((rd(HASH_BASE + 0x24u) & 2u) == 0u) return 1;
+    for (i = 0; i < 8u; ++i) {
+        if (rd(HASH_BASE + 0x310u + 4u * i) != expect[i]) return 1;
+    }
+    return 0;
+}
+
+static int test_aes(void)
+{
+    /* FIPS-197 C.1 */
+    static const mm_u32 ct[4] = { 0x69c4e0d8u, 0x6a7b0430u, 0xd8cdb780u, 0x70b4c55au };
+    /* GCM, zero key/IV/plaintext (test case 2) */
+    static const mm_u32 gcm_ct[4] = { 0x0388daceu, 0x60b6a392u, 0xf328c2b9u, 0x71b2fe78u };
+    static const mm_u32 gcm_tag[4] = { 0xab6e47d4u, 0x2cec13bdu, 0xf53a67b2u, 0x1257bddfu };
+    mm_u32 i;
+
+    if (setup(MM_STM32_CRYPTO_U5) != 0) return 1;
+    /* ECB encrypt, 32-bit data, key 000102..0f: KEYR3 holds the first word */
+    wr(AES_BASE + 0x1Cu, 0x00010203u);
+    wr(AES_BASE + 0x18u, 0x04050607u);
+    wr(AES_BASE + 0x14u, 0x08090a0bu);
+    if ((rd(AES_BASE + 0x04u) & (1u << 7)) != 0u) return 1;
+    wr(AES_BASE + 0x10u, 0x0c0d0e0fu);
+    if ((rd(AES_BASE + 0x04u) & (1u << 7)) == 0u) return 1;
+    wr(AES_BASE + 0x00u, 1u);
+    wr(AES_BASE + 0x08u, 0x00112233u);
+    wr(AES_BASE + 0x08u, 0x44556677u);
+    wr(AES_BASE + 0x08u, 0x8899aabbu);
+    wr(AES_BASE + 0x08u, 0xccddeeffu);
+    if ((rd(AES_BASE + 0x304u) & 1u) != 0u || (rd(AES_BASE + 0x04u) & (1u << 3)) == 0u) return 1;
+    mm_stm32_crypto_tick(14u);
+    if ((rd(AES_BASE + 0x304u) & 1u) == 0u) return 1;
+    for (i = 0; i < 4u; ++i) {
+        if (rd(AES_BASE + 0x0Cu) != ct[i]) return 1;
+    }
+    wr(AES_BASE + 0x308u, 1u);
+    if ((rd(AES_BASE + 0x304u) & 1u) != 0u) return 1;
+
+    /* GCM: init phase computes H, payload, final phase returns the tag */
+    set_timing(0u, 0u, 0u);
+    wr(AES_BASE + 0x00u, 1u << 31);
+    wr(AES_BASE + 0x00u, 0u);
+    for (i = 0; i < 4u; ++i) {
+        wr(AES_BASE + 0x10u + 4u * i, 0u);
+    }
+    wr(AES_BASE + 0x20u, 2u);
+    wr(AES_BASE + 0x24u, 0u);
+    wr(AES_BASE + 0x28u, 0u);
+    wr(AES_BASE + 0x2Cu, 0u);
+    wr(AES_BASE + 0x00u, (3u << 5) | 1u);
+    if ((rd(AES_BASE + 0x00u) & 1u) != 0u || (rd(AES_BASE + 0x304u) & 1u) == 0u) return 1;
+    wr(AES_BASE + 0x308u, 1u);
+    wr(AES_BASE + 0x00u, (2u << 13) | (3u << 5) | 1u);
+    for (i = 0; i < 4u; ++i) {
+        wr(AES_BASE + 0x08u, 0u);
+    }
+    for (i = 0; i < 4u; ++i) {
+        if (rd(AES_BASE + 0x0Cu) != gcm_ct[i]) return 1;
+    }
+    wr(AES_BASE + 0x308u, 1u);
+    wr(AES_BASE + 0x00u, (3u << 13) | (3u << 5) | 1u);
+    wr(AES_BASE + 0x08u, 0u);
+    wr(AES_BASE + 0x08u, 0u);
+    wr(AES_BASE + 0x08u, 0u);
+    wr(AES_BASE + 0x08u, 128u);
+    for (i = 0; i < 4u; ++i) {
+        if (rd(AES_BASE + 0x0Cu) != gcm_tag[i]) return 1;
+    }
+    return 0;
+}
+
+static int test_pka_modexp(void)
+{
+    mm_u32 base = 4u;
+    mm_u32 exp = 13u;
+    mm_u32 mod = 497u;
+
+    if (setup(MM_STM32_CRYPTO_H5) != 0) return 1;
+    wr(PKA_BASE + 0x00u, 1u);
+    if ((rd(PKA_BASE + 0x04u) & 1u) == 0u) return 1;
+    wr(PKA_BASE + 0x400u, 4u);          /* exponent bits */
+    wr(PKA_BASE + 0x408u, 9u);          /* operand bits */
+    wr_words(PKA_BASE + 0xC68u, &base, 1u);
+    wr_words(PKA_BASE + 0xE78u, &exp, 1u);
+    wr_words(PKA_BASE + 0x1088u, &mod, 1u);
+    wr(PKA_BASE + 0x00u, 1u | 2u | (0x00u << 8));
+    if ((rd(PKA_BASE + 0x04u) & (1u << 16)) == 0u) return 1;
+    mm_stm32_crypto_tick(1000000u);
+    if ((rd(PKA_BASE + 0x04u) & ((1u << 16) | (1u << 17))) != (1u << 17)) return 1;
+    if (rd(PKA_BASE + 0x838u) != 445u || rd(PKA_BASE + 0x1298u) != 0xD60Du) return 1;
+    wr(PKA_BASE + 0x08u, 1u << 17);
+    if ((rd(PKA_BASE + 0x04u) & (1u << 17)) != 0u) return 1;
+    /* Unsupported mode reports OPERRF */
+    wr(PKA_BASE + 0x00u, 1u | 2u | (0x3Eu << 8));
+    if ((rd(PKA_BASE + 0x04u) & (1u << 21)) == 0u) return 1;
+    return 0;
+}
+
+static int test_pka_ecdsa_verify(void)
+{
+    mm_u32 three = 3u;
+    mm_u32 bad[8];
+
+    if (setup(MM_STM32_CRYPTO_U5) != 0) return 1;
+    set_timing(0u, 0u, 0u);
+    wr(PKA_BASE + 0x00u, 1u);
+    wr(PKA_BASE + 0x408u, 256u);
+    wr(PKA_BASE + 0x4C8u, 256u);
+    wr(PKA_BASE + 0x468u, 1u);          /* a = -3 */
+    wr_words(PKA_BASE + 0x470u, &three, 1u);
+    wr_words(PKA_BASE + 0x4D0u, k_p256_p, 8u);
+    wr_words(PKA_BASE + 0x678u, k_p256_gx, 8u);
+    wr_words(PKA_BASE + 0x6D0u, k_p256_gy, 8u);
+    wr_words(PKA_BASE + 0x12F8u, k_qx, 8u);
+    wr_words(PKA_BASE + 0x1350u, k_qy, 8u);
+    wr_words(PKA_BASE + 0x10E0u, k_r, 8u);
+    wr_words(PKA_BASE + 0xC68u, k_s, 8u);
+    wr_words(PKA_BASE + 0x13A8u, k_e, 8u);
+    wr_words(PKA_BASE + 0x1088u, k_p256_n, 8u);
+    wr(PKA_BASE + 0x00u, 1u | 2u | (0x26u << 8));
+    if ((rd(PKA_BASE + 0x04u) & (1u << 17)) == 0u) return 1;
+    if (rd(PKA_BASE + 0x5D0u) != 0xD60Du) return 1;
+    wr(PKA_BASE + 0x08u, 1u << 17);
+    memcpy(bad, k_e, sizeof(bad));
+    bad[0] ^= 1u;
+    wr_words(PKA_BASE + 0x13A8u, bad, 8u);
+    wr(PKA_BASE + 0x00u, 1u | 2u | (0x26u << 8));
+    if (rd(PKA_BASE + 0x5D0u) == 0xD60Du) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "sha256", test_sha256 },
+        { "hmac", test_hmac },
+        { "aes", test_aes },
+        { "pka_modexp", test_pka_modexp },
+        { "pka_ecdsa_verify", test_pka_ecdsa_verify },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("stm32_crypto_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
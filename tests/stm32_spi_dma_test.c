@@ -0,0 +1,229 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/memmap.h"
+#include "m33mu/nvic.h"
+#include "m33mu/spi_bus.h"
+#include "stm32h563/stm32h563_mmio.h"
+#include "stm32h563/stm32h563_spi.h"
+
+#define RAM_BASE 0x20000000u
+#define SPI1_BASE 0x40013000u
+#define SPI1_BUS 1
+#define GPDMA1_BASE 0x40020000u
+
+#define SPI_CR1 0x00u
+#define SPI_CR2 0x04u
+#define SPI_CFG1 0x08u
+#define SPI_SR 0x14u
+#define SPI_TXDR 0x20u
+#define SPI_RXDR 0x30u
+
+#define CH(x, r) (GPDMA1_BASE + 0x50u + 0x80u * (x) + (r))
+#define CCR 0x14u
+#define CTR1 0x40u
+#define CTR2 0x44u
+#define CBR1 0x48u
+#define CSAR 0x4Cu
+#define CDAR 0x50u
+
+#define REQ_SPI1_RX 6u
+#define REQ_SPI1_TX 7u
+
+#define LEN 200u
+
+static mm_u8 g_ram[4096];
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[128];
+static struct mm_nvic g_nvic;
+static int g_bytes;
+static int g_bursts;
+static size_t g_longest;
+static mm_u8 g_seen[LEN];
+
+static mm_u8 dev_byte(mm_u8 out)
+{
+    if (g_bytes < (int)LEN) g_seen[g_bytes] = out;
+    g_bytes++;
+    return (mm_u8)(out ^ 0x5Au);
+}
+
+static mm_u8 dev_xfer(void *opaque, mm_u8 out)
+{
+    (void)opaque;
+    return dev_byte(out);
+}
+
+static void dev_xfer_buf(void *opaque, const mm_u8 *out, mm_u8 fill, mm_u8 *in, size_t len)
+{
+    size_t i;
+    (void)opaque;
+    g_bursts++;
+    if (len > g_longest) g_longest = len;
+    for (i = 0; i < len; ++i) {
+        mm_u8 b = dev_byte(out != 0 ? out[i] : fill);
+        if (in != 0) in[i] = b;
+    }
+}
+
+static void wr(mm_u32 addr, mm_u32 v)
+{
+    mmio_bus_write(&g_map.mmio, addr, 4u, v);
+}
+
+static mm_u32 rd(mm_u32 addr)
+{
+    mm_u32 v = 0;
+    mmio_bus_read(&g_map.mmio, addr, 4u, &v);
+    return v;
+}
+
+static int setup(void)
+{
+    static mm_bool dev_done = MM_FALSE;
+    struct mm_target_cfg cfg;
+    struct mm_spi_device dev;
+    mm_u32 i;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ram_base_s = cfg.ram_base_ns = RAM_BASE;
+    cfg.ram_size_s = cfg.ram_size_ns = sizeof(g_ram);
+    memset(g_ram, 0, sizeof(g_ram));
+    for (i = 0; i < LEN; ++i) g_ram[i] = (mm_u8)(i * 3u + 1u);
+    mm_stm32h563_spi_reset();
+    mm_memmap_init(&g_map, g_regions, 128);
+    if (!mm_memmap_configure_ram(&g_map, &cfg, g_ram, MM_TRUE)) return 1;
+    mm_nvic_init(&g_nvic);
+    if (!mm_stm32h563_register_mmio(&g_map.mmio)) return 1;
+    mm_stm32h563_spi_init(&g_map.mmio, &g_nvic);
+    if (!dev_done) {
+        memset(&dev, 0, sizeof(dev));
+        dev.bus = SPI1_BUS;
+        dev.xfer = dev_xfer;
+        dev.xfer_buf = dev_xfer_buf;
+        if (!mm_spi_bus_register_device(&dev)) return 1;
+        dev_done = MM_TRUE;
+    }
+    mm_stm32h563_rcc_regs()[0x88u / 4u] |= 1u; /* GPDMA1EN */
+    g_bytes = 0;
+    g_bursts = 0;
+    g_longest = 0;
+    return 0;
+}
+
+static void spi_start(mm_u32 cfg1)
+{
+    wr(SPI1_BASE + SPI_CFG1, 7u | cfg1);
+    wr(SPI1_BASE + SPI_CR2, LEN);
+    wr(SPI1_BASE + SPI_CR1, 1u);
+    wr(SPI1_BASE + SPI_CR1, 1u | (1u << 9));
+}
+
+static void dma_tx(mm_u32 ch)
+{
+    wr(CH(ch, CTR1), 1u << 3);                  /* byte, SINC */
+    wr(CH(ch, CTR2), REQ_SPI1_TX | (1u << 10));
+    wr(CH(ch, CBR1), LEN);
+    wr(CH(ch, CSAR), RAM_BASE);
+    wr(CH(ch, CDAR), SPI1_BASE + SPI_TXDR);
+    wr(CH(ch, CCR), 1u);
+}
+
+static int test_full_duplex(void)
+{
+    mm_u32 i;
+    int pass;
+    if (setup() != 0) return 1;
+    spi_start((1u << 14) | (1u << 15));         /* RXDMAEN, TXDMAEN */
+    /* RX on the lower channel so it is polled before TX every round */
+    wr(CH(0, CTR1), 1u << 19);                  /* byte, DINC */
+    wr(CH(0, CTR2), REQ_SPI1_RX);
+    wr(CH(0, CBR1), LEN);
+    wr(CH(0, CSAR), SPI1_BASE + SPI_RXDR);
+    wr(CH(0, CDAR), RAM_BASE + 0x400u);
+    wr(CH(0, CCR), 1u);
+    dma_tx(1u);
+    for (pass = 0; pass < 4; ++pass) {
+        mm_stm32h563_dma_service();
+    }
+    if (g_bytes != (int)LEN) return 1;
+    for (i = 0; i < LEN; ++i) {
+        if (g_seen[i] != g_ram[i]) return 1;
+        if (g_ram[0x400u + i] != (mm_u8)(g_ram[i] ^ 0x5Au)) return 1;
+    }
+    /* Bursts bounded by the RX FIFO, not one per byte */
+    if (g_longest != 31u || g_bursts > 8) return 1;
+    if ((rd(SPI1_BASE + SPI_SR) & (1u << 3)) == 0u) return 1; /* EOT */
+    return 0;
+}
+
+static int test_tx_only(void)
+{
+    mm_u32 i;
+    if (setup() != 0) return 1;
+    spi_start(1u << 15);                        /* TXDMAEN */
+    dma_tx(2u);
+    mm_stm32h563_dma_service();
+    if (g_bytes != (int)LEN || g_bursts != 1) return 1;
+    for (i = 0; i < LEN; ++i) {
+        if (g_seen[i] != g_ram[i]) return 1;
+    }
+    if ((rd(SPI1_BASE + SPI_SR) & (1u << 3)) == 0u) return 1;
+    return 0;
+}
+
+static int test_cpu_writes_unbatched(void)
+{
+    if (setup() != 0) return 1;
+    spi_start(1u << 15);
+    /* Outside a DMA pass every TXDR write reaches the bus at once */
+    wr(SPI1_BASE + SPI_TXDR, 0xA5u);
+    if (g_bytes != 1 || g_seen[0] != 0xA5u) return 1;
+    if ((rd(SPI1_BASE + SPI_RXDR) & 0xFFu) != (0xA5u ^ 0x5Au)) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "full_duplex", test_full_duplex },
+        { "tx_only", test_tx_only },
+        { "cpu_writes_unbatched", test_cpu_writes_unbatched },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("stm32_spi_dma_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
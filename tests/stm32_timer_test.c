@@ -0,0 +1,126 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/memmap.h"
+#include "m33mu/nvic.h"
+#include "stm32h563/stm32h563_mmio.h"
+#include "stm32h563/stm32h563_timers.h"
+
+#define TIM2_BASE 0x40000000u
+#define TIM2_IRQ 45u
+#define RCC_APB1LENR 0x9Cu
+
+#define TIM_CR1 0x00u
+#define TIM_DIER 0x0Cu
+#define TIM_CNT 0x24u
+#define TIM_PSC 0x28u
+#define TIM_ARR 0x2Cu
+
+static struct mm_memmap g_map;
+static struct mmio_region g_regions[128];
+static struct mm_nvic g_nvic;
+
+static void wr(mm_u32 addr, mm_u32 v)
+{
+    mmio_bus_write(&g_map.mmio, addr, 4u, v);
+}
+
+static int setup(void)
+{
+    mm_memmap_init(&g_map, g_regions, 128);
+    mm_nvic_init(&g_nvic);
+    if (!mm_stm32h563_register_mmio(&g_map.mmio)) return 1;
+    mm_stm32h563_timers_reset();
+    mm_stm32h563_timers_init(&g_map.mmio, &g_nvic);
+    mm_stm32h563_rcc_regs()[RCC_APB1LENR / 4u] |= 1u;
+    return 0;
+}
+
+static int test_idle(void)
+{
+    if (setup() != 0) return 1;
+    if (mm_stm32h563_timers_next_event() != (mm_u64)-1) return 1;
+    /* UDIS suppresses the update event altogether. */
+    wr(TIM2_BASE + TIM_CR1, 1u | 2u);
+    if (mm_stm32h563_timers_next_event() != (mm_u64)-1) return 1;
+    return 0;
+}
+
+static int test_update_deadline(void)
+{
+    if (setup() != 0) return 1;
+    wr(TIM2_BASE + TIM_PSC, 3u);
+    wr(TIM2_BASE + TIM_ARR, 99u);
+    wr(TIM2_BASE + TIM_DIER, 1u);
+    wr(TIM2_BASE + TIM_CR1, 1u);
+    if (mm_stm32h563_timers_next_event() != 400u) return 1;
+    mm_stm32h563_timers_tick(399u);
+    if (mm_nvic_is_pending(&g_nvic, TIM2_IRQ)) return 1;
+    if (mm_stm32h563_timers_next_event() != 1u) return 1;
+    mm_stm32h563_timers_tick(1u);
+    if (!mm_nvic_is_pending(&g_nvic, TIM2_IRQ)) return 1;
+    if (mm_stm32h563_timers_next_event() != 400u) return 1;
+    return 0;
+}
+
+static int test_down_counter(void)
+{
+    if (setup() != 0) return 1;
+    wr(TIM2_BASE + TIM_ARR, 99u);
+    wr(TIM2_BASE + TIM_CNT, 9u);
+    wr(TIM2_BASE + TIM_DIER, 1u);
+    wr(TIM2_BASE + TIM_CR1, 1u | 0x10u);
+    if (mm_stm32h563_timers_next_event() != 10u) return 1;
+    mm_stm32h563_timers_tick(9u);
+    if (mm_nvic_is_pending(&g_nvic, TIM2_IRQ)) return 1;
+    mm_stm32h563_timers_tick(1u);
+    if (!mm_nvic_is_pending(&g_nvic, TIM2_IRQ)) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "idle", test_idle },
+        { "update_deadline", test_update_deadline },
+        { "down_counter", test_down_counter },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("stm32_timer_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "m33mu/trace.h"
+
+static const char *k_path = "trace_test.bin";
+
+static void cpu_reset(struct mm_cpu *cpu)
+{
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->sec_state = MM_SECURE;
+    cpu->mode = MM_THREAD;
+}
+
+static int test_roundtrip_reconstruct(void)
+{
+    static struct mm_trace_writer tw;
+    struct mm_trace_reader tr;
+    struct mm_trace_event ev;
+    struct mm_cpu cpu;
+    int insns = 0;
+    int memw = 0;
+    int excs = 0;
+    int rc;
+
+    cpu_reset(&cpu);
+    if (!mm_trace_open(&tw, k_path, MM_FALSE)) return 1;
+    cpu.r[13] = 0x20001000u;
+    cpu.r[15] = 0x100u;
+    mm_trace_insn(&tw, &cpu, 0x100u, 0x2001u, 2u);          /* movs r0, #1 */
+    cpu.r[0] = 1u;
+    mm_trace_insn(&tw, &cpu, 0x102u, 0xf8c10000u, 4u);      /* str r0, [r1] */
+    mm_trace_mem_write(&tw, 0x20000000u, 4u, 1u);
+    mm_trace_exception(&tw, 15u);
+    cpu.r[13] = 0x20000fe0u;
+    cpu.xpsr = 0x0000000fu;
+    cpu.mode = MM_HANDLER;
+    mm_trace_insn(&tw, &cpu, 0x200u, 0x4770u, 2u);          /* bx lr */
+    mm_trace_close(&tw);
+
+    if (!mm_trace_reader_open(&tr, k_path)) return 1;
+    while ((rc = mm_trace_reader_next(&tr, &ev)) > 0) {
+        if (ev.kind == MM_TRACE_REC_INSN) {
+            if (ev.icount != (mm_u64)insns) return 1;
+            if (insns == 0 && (ev.pc != 0x100u || ev.len != 2u || ev.insn != 0x2001u ||
+                               tr.regs[13] != 0x20001000u || ev.changed != 0u)) return 1;
+            if (insns == 1 && (ev.pc != 0x102u || ev.len != 4u || ev.insn != 0xf8c10000u ||
+                               tr.regs[0] != 1u || ev.changed != 0x0001u)) return 1;
+            if (insns == 2 && (ev.pc != 0x200u || tr.regs[13] != 0x20000fe0u ||
+                               tr.regs[MM_TRACE_REG_XPSR] != 0xfu || tr.regs[0] != 1u ||
+                               (ev.state & MM_TRACE_STATE_HANDLER) == 0u)) return 1;
+            insns++;
+        } else if (ev.kind == MM_TRACE_REC_MEMW) {
+            if (ev.addr != 0x20000000u || ev.size != 4u || ev.value != 1u) return 1;
+            memw++;
+        } else if (ev.kind == MM_TRACE_REC_EXC) {
+            if (ev.exc_num != 15u) return 1;
+            excs++;
+        }
+    }
+    mm_trace_reader_close(&tr);
+    remove(k_path);
+    if (rc != 0 || insns != 3 || memw != 1 || excs != 1) return 1;
+    return 0;
+}
+
+static int test_large_trace_syncs(void)
+{
+    static struct mm_trace_writer tw;
+    struct mm_trace_reader tr;
+    struct mm_trace_event ev;
+    struct mm_cpu cpu;
+    const mm_u32 total = MM_TRACE_SYNC_INTERVAL * 3u + 17u;
+    mm_u32 i;
+    mm_u32 insns = 0;
+    mm_u32 syncs = 0;
+    int rc;
+
+    cpu_reset(&cpu);
+    if (!mm_trace_open(&tw, k_path, MM_FALSE)) return 1;
+    for (i = 0; i < total; ++i) {
+        cpu.r[i % 13u] = i;
+        mm_trace_insn(&tw, &cpu, 0x1000u + (i & 0xffu) * 2u, 0xbf00u, 2u);
+    }
+    mm_trace_close(&tw);
+
+    if (!mm_trace_reader_open(&tr, k_path)) return 1;
+    while ((rc = mm_trace_reader_next(&tr, &ev)) > 0) {
+        if (ev.kind == MM_TRACE_REC_SYNC) {
+            syncs++;
+        } else if (ev.kind == MM_TRACE_REC_INSN) {
+            /* Reconstructed r[i % 13] must hold the value written before insn i. */
+            if (tr.regs[insns % 13u] != insns) return 1;
+            insns++;
+        }
+    }
+    mm_trace_reader_close(&tr);
+    remove(k_path);
+    if (rc != 0 || insns != total || syncs != 4u) return 1;
+    return 0;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "roundtrip_reconstruct", test_roundtrip_reconstruct },
+        { "large_trace_syncs", test_large_trace_syncs },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("trace_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+#define _GNU_SOURCE 1
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "m33mu/vsync.h"
+
+struct coord_args {
+    char path[108];
+    mm_u32 nodes;
+    int rc;
+};
+
+struct node_args {
+    const char *path;
+    mm_u64 reports[2];
+    mm_u64 limits[2];
+    mm_u32 epochs[2];
+    int rc;
+};
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, 0);
+}
+
+static void *coord_thread(void *arg)
+{
+    struct coord_args *c = (struct coord_args *)arg;
+    c->rc = mm_vsync_coordinate(c->path, c->nodes, 1000u);
+    return 0;
+}
+
+static mm_bool wait_grant(struct mm_vsync *vs, mm_u64 now_ns)
+{
+    int tries;
+    for (tries = 0; tries < 2000; ++tries) {
+        enum mm_vsync_status st = mm_vsync_step(vs, now_ns);
+        if (st == MM_VSYNC_GRANTED) return MM_TRUE;
+        if (st == MM_VSYNC_LOST) return MM_FALSE;
+        sleep_ms(1);
+    }
+    return MM_FALSE;
+}
+
+/* Connect, then report the scripted times one barrier at a time. */
+static void *node_thread(void *arg)
+{
+    struct node_args *n = (struct node_args *)arg;
+    struct mm_vsync vs;
+    int i;
+    n->rc = 1;
+    if (!mm_vsync_connect(&vs, n->path)) return 0;
+    if (vs.epoch != 1u || vs.limit_ns != 1000u) {
+        mm_vsync_close(&vs);
+        return 0;
+    }
+    for (i = 0; i < 2; ++i) {
+        if (!wait_grant(&vs, n->reports[i])) {
+            mm_vsync_close(&vs);
+            return 0;
+        }
+        n->limits[i] = vs.limit_ns;
+        n->epochs[i] = vs.epoch;
+    }
+    mm_vsync_close(&vs);
+    n->rc = 0;
+    return 0;
+}
+
+static void coord_path(struct coord_args *c, const char *tag)
+{
+    snprintf(c->path, sizeof(c->path), "/tmp/m33mu-vsync-%ld-%s.sock", (long)getpid(), tag);
+}
+
+static int test_barriers(void)
+{
+    struct coord_args c;
+    struct node_args a;
+    struct node_args b;
+    pthread_t ct;
+    pthread_t bt;
+    int rc = 0;
+    memset(&c, 0, sizeof(c));
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    coord_path(&c, "barriers");
+    c.nodes = 2;
+    a.path = c.path;
+    b.path = c.path;
+    /* b overshoots the first grant; the next one follows the slower a. */
+    a.reports[0] = 1000u;
+    a.reports[1] = 2000u;
+    b.reports[0] = 1500u;
+    b.reports[1] = 2600u;
+    if (pthread_create(&ct, 0, coord_thread, &c) != 0) return 1;
+    if (pthread_create(&bt, 0, node_thread, &b) != 0) return 1;
+    node_thread(&a);
+    pthread_join(bt, 0);
+    pthread_join(ct, 0);
+    if (a.rc != 0 || b.rc != 0 || c.rc != 0) rc = 1;
+    if (a.limits[0] != 2000u || b.limits[0] != 2000u) rc = 1;
+    if (a.limits[1] != 3000u || b.limits[1] != 3000u) rc = 1;
+    if (a.epochs[0] != 2u || b.epochs[1] != 3u) rc = 1;
+    if (access(c.path, F_OK) == 0) rc = 1;
+    return rc;
+}
+
+static int test_waiting(void)
+{
+    struct coord_args c;
+    struct mm_vsync a;
+    struct node_args b;
+    pthread_t ct;
+    pthread_t bt;
+    int rc = 0;
+    memset(&c, 0, sizeof(c));
+    memset(&b, 0, sizeof(b));
+    coord_path(&c, "waiting");
+    c.nodes = 2;
+    b.path = c.path;
+    b.reports[0] = 1000u;
+    b.reports[1] = 2000u;
+    if (pthread_create(&ct, 0, coord_thread, &c) != 0) return 1;
+    if (pthread_create(&bt, 0, node_thread, &b) != 0) return 1;
+    if (!mm_vsync_connect(&a, c.path)) return 1;
+    /* Until a reports, b cannot be granted anything. */
+    sleep_ms(20);
+    if (b.limits[0] != 0u) rc = 1;
+    if (!wait_grant(&a, 1000u) || a.limit_ns != 2000u) rc = 1;
+    if (!wait_grant(&a, 2000u) || a.limit_ns != 3000u) rc = 1;
+    mm_vsync_close(&a);
+    pthread_join(bt, 0);
+    pthread_join(ct, 0);
+    if (b.rc != 0 || c.rc != 0) rc = 1;
+    return rc;
+}
+
+static int test_late_node(void)
+{
+    struct coord_args c;
+    struct mm_vsync a;
+    struct mm_vsync late;
+    pthread_t ct;
+    int rc = 0;
+    memset(&c, 0, sizeof(c));
+    coord_path(&c, "late");
+    c.nodes = 1;
+    if (pthread_create(&ct, 0, coord_thread, &c) != 0) return 1;
+    if (!mm_vsync_connect(&a, c.path)) return 1;
+    if (mm_vsync_connect(&late, c.path)) rc = 1;
+    /* A lone node is granted quantum after quantum. */
+    if (!wait_grant(&a, 1000u) || a.limit_ns != 2000u || a.epoch != 2u) rc = 1;
+    mm_vsync_close(&a);
+    pthread_join(ct, 0);
+    if (c.rc != 0) rc = 1;
+    return rc;
+}
+
+int main(void)
+{
+    struct { const char *name; int (*fn)(void); } tests[] = {
+        { "barriers", test_barriers },
+        { "waiting", test_waiting },
+        { "late_node", test_late_node },
+    };
+    const int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    int failures = 0;
+    int i;
+    for (i = 0; i < count; ++i) {
+        if (tests[i].fn() != 0) {
+            ++failures;
+            printf("FAIL: %s\n", tests[i].name);
+        } else {
+            printf("PASS: %s\n", tests[i].name);
+        }
+    }
+    if (failures != 0) {
+        printf("vsync_test: %d failure(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+/* m33mu-sync: virtual-time coordinator for `m33mu --sync=<socket>`. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/vsync.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--nodes <n>] [--quantum-us <n>] <socket>\n"
+            "  --nodes <n>       instances to wait for before time starts (default 2)\n"
+            "  --quantum-us <n>  lookahead: how far any instance may run ahead of the\n"
+            "                    slowest one, in virtual microseconds (default %llu)\n",
+            argv0, (unsigned long long)(MM_VSYNC_DEFAULT_QUANTUM_NS / 1000ull));
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = 0;
+    unsigned long nodes = 2;
+    unsigned long long quantum_us = MM_VSYNC_DEFAULT_QUANTUM_NS / 1000ull;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            nodes = strtoul(argv[++i], 0, 0);
+        } else if (strcmp(argv[i], "--quantum-us") == 0 && i + 1 < argc) {
+            quantum_us = strtoull(argv[++i], 0, 0);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == 0 || nodes == 0 || nodes > MM_VSYNC_MAX_NODES || quantum_us == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return mm_vsync_coordinate(path, (mm_u32)nodes, (mm_u64)quantum_us * 1000ull);
+}
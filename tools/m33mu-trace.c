@@ -0,0 +1,191 @@
+/* m33mu -- an ARMv8-M Emulator
+ *
+ * Copyright (C) 2025  Daniele Lacamera <root@danielinux.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+
+/* m33mu-trace: decode binary execution traces written by `m33mu --trace`. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "m33mu/trace.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--pc <start:end>] [--regs] [--mem] [--from <n>] [--count <n>] [--state-at <n>] <trace>\n"
+            "  --pc <start:end>  only show instructions whose PC is in [start, end] (hex)\n"
+            "  --regs            print the reconstructed register state before each instruction\n"
+            "  --mem             print memory writes and exception entries\n"
+            "  --from <n>        skip instructions before index n\n"
+            "  --count <n>       stop after printing n instructions\n"
+            "  --state-at <n>    print only the register state before instruction n\n",
+            argv0);
+}
+
+static mm_bool parse_range(const char *s, mm_u32 *start, mm_u32 *end)
+{
+    char *colon = 0;
+    unsigned long a = strtoul(s, &colon, 16);
+    unsigned long b;
+    if (colon == 0 || *colon != ':') {
+        return MM_FALSE;
+    }
+    b = strtoul(colon + 1, 0, 16);
+    *start = (mm_u32)a;
+    *end = (mm_u32)b;
+    return MM_TRUE;
+}
+
+static void print_regs(const mm_u32 *regs)
+{
+    static const char *const names[MM_TRACE_NREGS] = {
+        "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12",
+        "sp", "lr", "pc", "xpsr"
+    };
+    mm_u32 i;
+    for (i = 0; i < MM_TRACE_NREGS; ++i) {
+        printf("%s%s=0x%08lx", (i == 0u) ? "    " : " ", names[i], (unsigned long)regs[i]);
+        if (i == 8u) {
+            printf("\n   ");
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct mm_trace_reader tr;
+    struct mm_trace_event ev;
+    const char *path = 0;
+    mm_bool opt_pc = MM_FALSE;
+    mm_bool opt_regs = MM_FALSE;
+    mm_bool opt_mem = MM_FALSE;
+    mm_bool opt_state_at = MM_FALSE;
+    mm_u32 pc_start = 0;
+    mm_u32 pc_end = 0xffffffffu;
+    unsigned long long from = 0;
+    unsigned long long count = 0;
+    unsigned long long state_at = 0;
+    unsigned long long shown = 0;
+    mm_bool in_range = MM_FALSE;
+    int rc;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--pc") == 0 && i + 1 < argc) {
+            if (!parse_range(argv[++i], &pc_start, &pc_end)) {
+                usage(argv[0]);
+                return 1;
+            }
+            opt_pc = MM_TRUE;
+        } else if (strcmp(argv[i], "--regs") == 0) {
+            opt_regs = MM_TRUE;
+        } else if (strcmp(argv[i], "--mem") == 0) {
+            opt_mem = MM_TRUE;
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = strtoull(argv[++i], 0, 0);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], 0, 0);
+        } else if (strcmp(argv[i], "--state-at") == 0 && i + 1 < argc) {
+            state_at = strtoull(argv[++i], 0, 0);
+            opt_state_at = MM_TRUE;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!mm_trace_reader_open(&tr, path)) {
+        fprintf(stderr, "%s: cannot read trace %s%s\n", argv[0], path,
+                mm_trace_zstd_available() ? "" : " (zstd traces need a zstd-enabled build)");
+        return 1;
+    }
+
+    while ((rc = mm_trace_reader_next(&tr, &ev)) > 0) {
+        if (ev.kind == MM_TRACE_REC_INSN) {
+            if (opt_state_at) {
+                if (ev.icount == state_at) {
+                    printf("#%llu PC=0x%08lx\n", (unsigned long long)ev.icount, (unsigned long)ev.pc);
+                    print_regs(tr.regs);
+                    break;
+                }
+                continue;
+            }
+            /* Compare on the Thumb address, as M33MU_PC_TRACE does. */
+            in_range = (ev.icount >= from) &&
+                       (!opt_pc || ((ev.pc | 1u) >= pc_start && (ev.pc | 1u) <= pc_end));
+            if (!in_range) {
+                continue;
+            }
+            printf("#%llu %c%c PC=0x%08lx %s=0x%0*lx",
+                   (unsigned long long)ev.icount,
+                   (ev.state & MM_TRACE_STATE_NS) ? 'N' : 'S',
+                   (ev.state & MM_TRACE_STATE_HANDLER) ? 'H' : 'T',
+                   (unsigned long)ev.pc,
+                   (ev.len == 4u) ? "insn" : "hw",
+                   (ev.len == 4u) ? 8 : 4,
+                   (unsigned long)ev.insn);
+            if (!opt_regs && ev.changed != 0u) {
+                mm_u32 r;
+                for (r = 0; r < 16u; ++r) {
+                    if (ev.changed & (1u << r)) {
+                        mm_u32 idx = (r == 15u) ? MM_TRACE_REG_XPSR : r;
+                        if (r == 15u) printf(" xpsr=0x%08lx", (unsigned long)tr.regs[idx]);
+                        else if (r == 13u) printf(" sp=0x%08lx", (unsigned long)tr.regs[idx]);
+                        else if (r == 14u) printf(" lr=0x%08lx", (unsigned long)tr.regs[idx]);
+                        else printf(" r%lu=0x%08lx", (unsigned long)r, (unsigned long)tr.regs[idx]);
+                    }
+                }
+            }
+            printf("\n");
+            if (opt_regs) {
+                print_regs(tr.regs);
+            }
+            shown++;
+            if (count != 0u && shown >= count) {
+                break;
+            }
+        } else if (ev.kind == MM_TRACE_REC_MEMW) {
+            if (opt_mem && in_range && !opt_state_at) {
+                printf("    mem[0x%08lx].%lu <- 0x%0*lx\n",
+                       (unsigned long)ev.addr,
+                       (unsigned long)ev.size,
+                       (int)(ev.size * 2u),
+                       (unsigned long)ev.value);
+            }
+        } else if (ev.kind == MM_TRACE_REC_EXC) {
+            if (opt_mem && !opt_state_at) {
+                printf("    exception %lu\n", (unsigned long)ev.exc_num);
+            }
+        }
+    }
+    mm_trace_reader_close(&tr);
+    if (rc < 0) {
+        fprintf(stderr, "%s: truncated or malformed trace\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
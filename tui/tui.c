@@ -44,6 +44,7 @@
 #include "m33mu/usbdev.h"
 #include "m33mu/gpio.h"
 #include "m33mu/eth_backend.h"
+#include "m33mu/hostwait.h"
 #include "m33mu/memmap.h"
 #include "stm32h563/stm32h563_eth.h"
 #include "tui.h"
@@ -1107,8 +1108,15 @@ static void tui_draw(struct mm_tui *tui)
                 y++;
             } else {
                 const char *spec = mm_eth_backend_spec();
-                const char *backend_name = (eth_backend == MM_ETH_BACKEND_TAP) ? "tap" : "vde";
-                const char *spec_label = (eth_backend == MM_ETH_BACKEND_TAP) ? "iface" : "sock";
+                const char *backend_name = "vde";
+                const char *spec_label = "sock";
+                if (eth_backend == MM_ETH_BACKEND_TAP) {
+                    backend_name = "tap";
+                    spec_label = "iface";
+                } else if (eth_backend == MM_ETH_BACKEND_SHM) {
+                    backend_name = "shm";
+                    spec_label = "switch";
+                }
                 snprintf(buf, sizeof(buf), "ETH: backend=%s %s=%s link=%s mac=%s",
                          backend_name,
                          spec_label,
@@ -1486,6 +1494,9 @@ static void *tui_thread_main(void *arg)
     tui->active = MM_TRUE;
     while (!tui->thread_stop) {
         mm_tui_poll(tui);
+        if (tui->actions != 0u) {
+            mm_hostwait_wake();
+        }
         {
             struct timespec ts;
             ts.tv_sec = 0;